@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Microbenchmarks of libvsensors hot paths, run by 'make bench'.
+ * libvsensors sources are built with malloc, calloc and realloc renamed to
+ * bench_{malloc,calloc,realloc} (BENCH_ALLOC_HOOKS), in order to count the
+ * allocations done by libvsensors itself (not by libc or vlib) per operation.
+ * The Linux parsers read the recorded files of bench/fixtures.
+ */
+/* this file must call the real allocator */
+#undef malloc
+#undef calloc
+#undef realloc
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "libvsensors/sensor.h"
+
+/** minimum duration of one benchmark, overridable with VSENSORS_BENCH_MS */
+#define BENCH_MIN_MS            200
+#define BENCH_MS_ENV            "VSENSORS_BENCH_MS"
+#define BENCH_SYNTH_MAX         10000
+#define BENCH_VALUES_N          1000
+#ifdef __linux__
+# define BENCH_PARSERS_INPUT    "fixtures"
+#else
+# define BENCH_PARSERS_INPUT    "system"
+#endif
+
+typedef void (*bench_fun_t)(void * data, unsigned long iters);
+
+static unsigned long    s_bench_allocs = 0;
+static unsigned long    s_bench_min_ns = BENCH_MIN_MS * 1000000UL;
+static unsigned int     s_bench_synth_nb = 0;
+static unsigned int     s_bench_synth_counter = 0;
+static sensor_status_t  s_bench_synth_status = SENSOR_UPDATED;
+
+/* ************************************************************************ */
+void * bench_malloc(size_t size) {
+    ++s_bench_allocs;
+    return malloc(size);
+}
+void * bench_calloc(size_t nmemb, size_t size) {
+    ++s_bench_allocs;
+    return calloc(nmemb, size);
+}
+void * bench_realloc(void * ptr, size_t size) {
+    ++s_bench_allocs;
+    return realloc(ptr, size);
+}
+
+/* ************************************************************************ */
+static unsigned long bench_now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/* ************************************************************************ */
+/** run fun with doubling iterations until it lasts s_bench_min_ns, then report */
+static void bench_run(const char * name, bench_fun_t fun, void * data) {
+    unsigned long   iters = 1, start, elapsed, allocs;
+
+    if (data == NULL) {
+        fprintf(stdout, "%-40s %12s\n", name, "unavailable");
+        return ;
+    }
+    fun(data, 1); /* warm up */
+    while (1) {
+        allocs = s_bench_allocs;
+        start = bench_now_ns();
+        fun(data, iters);
+        elapsed = bench_now_ns() - start;
+        allocs = s_bench_allocs - allocs;
+        if (elapsed >= s_bench_min_ns || iters >= (1UL << 30))
+            break ;
+        iters = elapsed < s_bench_min_ns / 64 ? iters * 8 : iters * 2;
+    }
+    fprintf(stdout, "%-40s %12.1f ns/op %10.2f allocs/op %12lu iters\n",
+            name, (double) elapsed / iters, (double) allocs / iters, iters);
+}
+
+/* ************************************************************************
+ * synthetic family: s_bench_synth_nb sensors updated on each call
+ * ************************************************************************ */
+static slist_t * bench_synth_list(sensor_family_t * family) {
+    slist_t * list = NULL;
+
+    for (unsigned int i = 0; i < s_bench_synth_nb; ++i) {
+        sensor_desc_t * desc = calloc(1, sizeof(*desc));
+        char            label[32];
+
+        if (desc == NULL)
+            break ;
+        snprintf(label, sizeof(label), "sensor%05u", i);
+        desc->label = strdup(label);
+        desc->type = SENSOR_VALUE_UINT;
+        desc->family = family;
+        list = slist_prepend(list, desc);
+    }
+    return list;
+}
+static sensor_status_t bench_synth_update(sensor_sample_t * sensor, const struct timeval * now) {
+    (void) now;
+    sensor->value.data.ui = ++s_bench_synth_counter;
+    return s_bench_synth_status;
+}
+static void bench_synth_free_desc(void * vdesc) {
+    sensor_desc_t * desc = (sensor_desc_t *) vdesc;
+
+    free((char *) desc->label);
+    free(desc);
+}
+static const sensor_family_info_t s_bench_synth_info = {
+    .name = "bench",
+    .list = bench_synth_list,
+    .update = bench_synth_update,
+    .free_desc = bench_synth_free_desc,
+};
+
+typedef struct {
+    sensor_ctx_t *  sctx;
+    struct timeval  now;
+} bench_update_t;
+
+/* ************************************************************************ */
+static sensor_ctx_t * bench_synth_ctx(unsigned int nb) {
+    sensor_ctx_t * sctx = sensor_init_families(NULL, SIF_NONE, "common");
+
+    s_bench_synth_nb = nb;
+    if (sctx != NULL && sensor_family_register(sctx, &s_bench_synth_info) != SENSOR_SUCCESS) {
+        sensor_free(sctx);
+        return NULL;
+    }
+    return sctx;
+}
+
+/* ************************************************************************ */
+static void bench_update_get(void * vdata, unsigned long iters) {
+    bench_update_t * data = (bench_update_t *) vdata;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        /* the watches interval is 1ms: all of them are due on each call */
+        data->now.tv_usec += 1000;
+        if (data->now.tv_usec >= 1000000) {
+            ++data->now.tv_sec;
+            data->now.tv_usec -= 1000000;
+        }
+        sensor_update_free(sensor_update_get(data->sctx, &data->now));
+    }
+}
+
+/* ************************************************************************ */
+static void bench_updates(void) {
+    static const unsigned int   sizes[] = { 10, 1000, BENCH_SYNTH_MAX };
+    sensor_watch_t              watch = SENSOR_WATCH_INITIALIZER(1, NULL);
+    char                        name[64];
+
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        bench_update_t  data = { .sctx = bench_synth_ctx(sizes[i]), .now = { 1, 0 } };
+
+        snprintf(name, sizeof(name), "sensor_update_get(%u watches)", sizes[i]);
+        if (data.sctx != NULL && sensor_watch_add(data.sctx, "bench/*", SSF_DEFAULT, &watch)
+                                 == SENSOR_SUCCESS) {
+            bench_run(name, bench_update_get, &data);
+        } else {
+            bench_run(name, bench_update_get, NULL);
+        }
+        sensor_free(data.sctx);
+    }
+
+    /* SENSOR_SUCCESS: the library compares the values before and after update() */
+    s_bench_synth_status = SENSOR_SUCCESS;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        bench_update_t  data = { .sctx = bench_synth_ctx(sizes[i]), .now = { 1, 0 } };
+
+        snprintf(name, sizeof(name), "sensor_update_get(%u watches, compared)", sizes[i]);
+        if (data.sctx != NULL && sensor_watch_add(data.sctx, "bench/*", SSF_DEFAULT, &watch)
+                                 == SENSOR_SUCCESS) {
+            bench_run(name, bench_update_get, &data);
+        } else {
+            bench_run(name, bench_update_get, NULL);
+        }
+        sensor_free(data.sctx);
+    }
+    s_bench_synth_status = SENSOR_UPDATED;
+}
+
+/* ************************************************************************ */
+typedef struct {
+    sensor_ctx_t *  sctx;
+    const char *    pattern;
+} bench_find_t;
+
+static void bench_find(void * vdata, unsigned long iters) {
+    bench_find_t *  data = (bench_find_t *) vdata;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        slist_t * matchs = NULL;
+
+        sensor_find(data->sctx, data->pattern, SSF_DEFAULT, &matchs);
+        slist_free(matchs, NULL);
+    }
+}
+
+static void bench_watch_add(void * vdata, unsigned long iters) {
+    bench_find_t *  data = (bench_find_t *) vdata;
+    sensor_watch_t  watch = SENSOR_WATCH_INITIALIZER(1000, NULL);
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        /* watches already added are replaced */
+        sensor_watch_add(data->sctx, data->pattern, SSF_DEFAULT, &watch);
+    }
+}
+
+/* ************************************************************************ */
+static void bench_lookups(void) {
+    static const char * patterns[] = {
+        "bench/sensor05000", "bench/sensor0500?", "bench/*5*", "*/sensor0*", "bench/*",
+    };
+    bench_find_t        data = { .sctx = bench_synth_ctx(BENCH_SYNTH_MAX) };
+    char                name[64];
+
+    for (unsigned int i = 0; i < sizeof(patterns) / sizeof(*patterns); ++i) {
+        data.pattern = patterns[i];
+        snprintf(name, sizeof(name), "sensor_find(%s)", patterns[i]);
+        bench_run(name, bench_find, data.sctx ? &data : NULL);
+    }
+    for (unsigned int i = 0; i < sizeof(patterns) / sizeof(*patterns); ++i) {
+        data.pattern = patterns[i];
+        snprintf(name, sizeof(name), "sensor_watch_add(%s)", patterns[i]);
+        bench_run(name, bench_watch_add, data.sctx ? &data : NULL);
+    }
+    sensor_free(data.sctx);
+}
+
+/* ************************************************************************ */
+typedef struct {
+    sensor_value_t  v1;
+    sensor_value_t  v2;
+    char            buf[128];
+} bench_value_t;
+
+static void bench_value_equal(void * vdata, unsigned long iters) {
+    bench_value_t * data = (bench_value_t *) vdata;
+    int             eq = 0;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        data->v2.data.d = (double) (i & 1);
+        eq += sensor_value_equal(&data->v1, &data->v2);
+    }
+    data->buf[0] = (char) eq;
+}
+
+static void bench_value_copy(void * vdata, unsigned long iters) {
+    bench_value_t * data = (bench_value_t *) vdata;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        data->v1.data.d = (double) i;
+        sensor_value_copy(&data->v2, &data->v1);
+    }
+}
+
+static void bench_value_tostring(void * vdata, unsigned long iters) {
+    bench_value_t * data = (bench_value_t *) vdata;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        data->v1.data.d = (double) i / 7.0;
+        sensor_value_tostring(&data->v1, data->buf, sizeof(data->buf));
+    }
+}
+
+/* ************************************************************************ */
+typedef struct {
+    sensor_value_t  v1[BENCH_VALUES_N];
+    sensor_value_t  v2[BENCH_VALUES_N];
+    unsigned char   equal[BENCH_VALUES_N];
+} bench_values_n_t;
+
+static void bench_values_equal_loop(void * vdata, unsigned long iters) {
+    bench_values_n_t *  data = (bench_values_n_t *) vdata;
+    size_t              eq = 0;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        data->v2[i % BENCH_VALUES_N].data.d = (double) (i & 1);
+        for (unsigned int j = 0; j < BENCH_VALUES_N; ++j) {
+            eq += (data->equal[j] = sensor_value_equal(&data->v1[j], &data->v2[j]) != 0);
+        }
+    }
+    data->equal[0] = (unsigned char) eq;
+}
+
+static void bench_values_equal_n(void * vdata, unsigned long iters) {
+    bench_values_n_t *  data = (bench_values_n_t *) vdata;
+    size_t              eq = 0;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        data->v2[i % BENCH_VALUES_N].data.d = (double) (i & 1);
+        eq += sensor_values_equal_n(data->v1, data->v2, BENCH_VALUES_N, data->equal);
+    }
+    data->equal[0] = (unsigned char) eq;
+}
+
+/* ************************************************************************ */
+static void bench_values(void) {
+    bench_value_t       data;
+    bench_values_n_t *  data_n = calloc(1, sizeof(*data_n));
+    char                name[64];
+
+    memset(&data, 0, sizeof(data));
+    SENSOR_VALUE_INIT(data.v1, SENSOR_VALUE_DOUBLE, 0.0);
+    SENSOR_VALUE_INIT(data.v2, SENSOR_VALUE_DOUBLE, 0.0);
+    bench_run("sensor_value_equal(double)", bench_value_equal, &data);
+    bench_run("sensor_value_copy(double)", bench_value_copy, &data);
+    bench_run("sensor_value_tostring(double)", bench_value_tostring, &data);
+
+    /* change detection of BENCH_VALUES_N samples, one comparison each or in batch */
+    for (unsigned int i = 0; data_n != NULL && i < BENCH_VALUES_N; ++i) {
+        SENSOR_VALUE_INIT(data_n->v1[i], SENSOR_VALUE_DOUBLE, (double) (i & 1));
+        SENSOR_VALUE_INIT(data_n->v2[i], SENSOR_VALUE_DOUBLE, (double) (i & 1));
+    }
+    snprintf(name, sizeof(name), "sensor_value_equal(double x%u)", BENCH_VALUES_N);
+    bench_run(name, bench_values_equal_loop, data_n);
+    snprintf(name, sizeof(name), "sensor_values_equal_n(double x%u)", BENCH_VALUES_N);
+    bench_run(name, bench_values_equal_n, data_n);
+    free(data_n);
+}
+
+/* ************************************************************************ */
+/** forced update of one sample: the family parses all its data again */
+static void bench_family_update(void * vdata, unsigned long iters) {
+    sensor_sample_t * sample = (sensor_sample_t *) vdata;
+
+    for (unsigned long i = 0; i < iters; ++i) {
+        sample->desc->family->info->update(sample, NULL);
+    }
+}
+
+/* ************************************************************************ */
+static void bench_parsers(void) {
+    static const char * families[] = { "cpu", "memory", "disk", "network" };
+    sensor_watch_t      watch = SENSOR_WATCH_INITIALIZER(1000, NULL);
+    char                name[64], pattern[64];
+
+    for (unsigned int i = 0; i < sizeof(families) / sizeof(*families); ++i) {
+        sensor_ctx_t *      sctx = sensor_init_families(NULL, SIF_NONE, families[i]);
+        sensor_sample_t *   sample = NULL;
+
+        snprintf(pattern, sizeof(pattern), "%s/*", families[i]);
+        if (sctx != NULL && sensor_watch_add(sctx, pattern, SSF_DEFAULT, &watch) == SENSOR_SUCCESS) {
+            SLISTC_FOREACH_DATA(sensor_watch_list_get(sctx), s, sensor_sample_t *) {
+                if (strcmp(s->desc->family->info->name, families[i]) == 0) {
+                    sample = s;
+                    break ;
+                }
+            }
+        }
+        snprintf(name, sizeof(name), "%s update (%s)", families[i], BENCH_PARSERS_INPUT);
+        bench_run(name, bench_family_update, sample);
+        sensor_free(sctx);
+    }
+}
+
+/* ************************************************************************ */
+int main(int argc, const char *const* argv) {
+    const char * env = getenv(BENCH_MS_ENV);
+
+    (void) argc;
+    (void) argv;
+    if (env != NULL && atol(env) > 0) {
+        s_bench_min_ns = (unsigned long) atol(env) * 1000000UL;
+    }
+#ifndef BENCH_ALLOC_HOOKS
+    fprintf(stdout, "warning: built without BENCH_ALLOC_HOOKS, allocs/op are not counted\n");
+#endif
+    bench_updates();
+    bench_lookups();
+    bench_values();
+    bench_parsers();
+
+    return 0;
+}
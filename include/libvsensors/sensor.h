@@ -32,12 +32,12 @@
  *         (clean with sensor_watch_free(sensor_context))
  *
  *    3. Optionally save the watch_list to file
- *       watch_list_save(watch_list)
+ *       sensor_watch_save(watch_list, path)
  *
  * (B) from config
  *     1. Get watch list from saved config
- *        watch_list = sensor_watch_load()
- *          (clean with sensor_watch_free(watchlist))
+ *        watch_list = sensor_watch_load_ctx(sensor_context, path, callback, callback_data)
+ *          (clean with sensor_watch_free(sensor_context))
  * (C) Watch
  *     update_list = sensor_update_get(watch_list, NULL)
  *       (clean with sensor_update_free(update_list))
@@ -95,10 +95,16 @@ typedef struct sensor_sample_s sensor_sample_t;
 
 /** sensor init flags (for sensor_init()) */
 typedef enum {
-    SIF_NONE        = 0,
-    //SIF_...       = 1 << 0
-    SIF_RESERVED    = 1 << 16, // last
-    SIF_DEFAULT     = SIF_NONE
+    SIF_NONE            = 0,
+    SIF_PARALLEL_UPDATE = 1 << 0,   /* sensor_update_{get,fill}(): families updated in vjobs */
+    SIF_CLOCK_MONOTONIC = 1 << 1,   /* sctx clock is CLOCK_MONOTONIC instead of CLOCK_MONOTONIC_RAW */
+    SIF_CLOCK_COARSE    = 1 << 2,   /* sctx clock is CLOCK_MONOTONIC_COARSE (cheaper, tick precision) */
+    SIF_LAZY_INIT       = 1 << 3,   /* families initialized by the first sensor_find(), sensor_visit(),
+                                       sensor_watch_add(), sensor_pattern_compile() or
+                                       sensor_list_get() which can match them */
+    SIF_PARALLEL_INIT   = 1 << 4,   /* families initialized concurrently in vjobs */
+    SIF_RESERVED        = 1 << 16, // last
+    SIF_DEFAULT         = SIF_NONE
 } sensor_init_flag_t;
 
 /** RFU/TBD/TODO sensor sample watch events
@@ -110,6 +116,7 @@ typedef enum {
     SWE_WATCH_ADDED     = 1 << 3,
     SWE_WATCH_REPLACED  = 1 << 4,
     SWE_WATCH_DELETING  = 1 << 5,
+    SWE_WATCH_LEVEL     = 1 << 6,   /* sample->level changed, see sensor_watch_t */
     SWE_FAMILY_WAIT_LOAD= 1 << 10,
     SWE_RESERVED        = 1 << 16 // last, custom events for families.
 } sensor_watch_event_t;
@@ -117,10 +124,18 @@ typedef enum {
 /** RFU/TBD event_data type for sensor_watch_callback_t and sensor_family_t.notify() */
 typedef union {
     sensor_family_t *   family; /* for SWE_FAMILY_RELOADED */
+    unsigned int        level;  /* for SWE_WATCH_LEVEL: previous sample->level */
     /** RFU */
     void *              data;
 } sensor_watch_ev_data_t;
 
+/** sensor_family_info_t capability flags */
+typedef enum {
+    SFF_NONE            = 0,
+    SFF_PRECISE_UPDATE  = 1 << 0,   /* update() always returns UPDATED or UNCHANGED */
+    SFF_DEFAULT         = SFF_NONE
+} sensor_family_flag_t;
+
 /**
  * Structure identifying a sensor family/plugin.
  * private to sensor files and plugins. TODO
@@ -138,7 +153,9 @@ typedef struct {
     /** list(): return a new allocated list, which will be freed by libvsensors:
      * The content of list (sensor_desc_t*) is created by the family, but belongs
      * to libvsensors which will free it using the (*free_desc) function defined below.
-     * The list itself belongs to libvsensors too, and must NOT be used anymore by the family. */
+     * The list itself belongs to libvsensors too, and must NOT be used anymore by the family.
+     * On SENSOR_RELOAD_FAMILY, list() is called under the read lock while the previous
+     * descs are still listed: the family must keep them valid until its next list(). */
     slist_t *           (*list)(struct sensor_family_s *f);
 
     /** update(): called by libvsensors when the update_interval_ms has been reached.
@@ -163,6 +180,30 @@ typedef struct {
     /** free_desc(): free a single sensor_desc_t for this family. See list() above. */
     void                (*free_desc)(void * /*struct sensor_desc_s* */ vdesc);
 
+    /** flags: bit combination of sensor_family_flag_t. With SFF_PRECISE_UPDATE,
+     * libvsensors does not snapshot the previous value before calling update(). */
+    unsigned int        flags;
+
+    /** update_batch(): optional, called by sensor_update_get() and sensor_update_fill()
+     * with all due samples of the family, in order to retrieve family data only once.
+     * results[i] is set as update() would return it for samples[i], with the
+     * SFF_PRECISE_UPDATE semantics. Return SENSOR_SUCCESS, or SENSOR_ERROR if nothing
+     * could be updated. update() is still used by sensor_update_check(). */
+    sensor_status_t     (*update_batch)(struct sensor_family_s *f,
+                                        struct sensor_sample_s ** samples, unsigned int n,
+                                        const struct timeval * now, sensor_status_t * results);
+
+    /** list_delta(): optional, called instead of list() when the family returned
+     * SENSOR_RELOAD_FAMILY. The family sets *p_added to a new list of descs to add,
+     * owned by libvsensors as with list(), and *p_removed to a new list of descs
+     * previously listed which are gone, unwatched then released with free_desc(),
+     * and kept valid until the next list_delta() or list().
+     * Other descs stay listed, their keys must remain valid, and their samples keep
+     * their values and history. Return SENSOR_SUCCESS, or SENSOR_NOT_SUPPORTED to
+     * have all the family descs listed again with list(). */
+    sensor_status_t     (*list_delta)(struct sensor_family_s *f,
+                                      slist_t ** p_added, slist_t ** p_removed);
+
 } sensor_family_info_t;
 
 
@@ -198,8 +239,20 @@ struct sensor_desc_s {
     sensor_value_type_t     type;
     /** family: BOF TODO */
     sensor_family_t *       family;
+    /** fullname: interned '<family>/<label>', set by libvsensors when the sensor
+     *            is listed, families must leave it NULL. see sensor_desc_fullname() */
+    const struct sensor_name_s * fullname;
+    /** ops: typed value operations of type (see sensor_value_ops()), bound by
+     *       libvsensors when the sensor is listed, families can leave it NULL */
+    const sensor_value_ops_t * ops;
 };
 
+/** copy a raw value in the value of a sample of desc, as sensor_value_fromraw(),
+ * with the typed desc->ops->fromraw() when it is bound for the type of value */
+#define SENSOR_DESC_FROMRAW(_desc, _src, _value) \
+            ((_desc)->ops != NULL && (_desc)->ops->type == (_value)->type \
+             ? (_desc)->ops->fromraw((_src), (_value)) : sensor_value_fromraw((_src), (_value)))
+
 /** Type: call back on sensor update : RFU/TBD/TODO */
 typedef sensor_status_t (*sensor_watch_callback_t)(
             unsigned int                event, /* bit combination of sensor_watch_event_t */
@@ -216,15 +269,47 @@ enum {
     SENSOR_LEVEL_NB
 };
 
+/** Sensor watch flags for sensor_watch_t */
+typedef enum {
+    SWF_NONE            = 0,
+    SWF_LEVEL_ONLY      = 1 << 0,   /* callback on SWE_WATCH_LEVEL, not on SWE_WATCH_UPDATED */
+} sensor_watch_flag_t;
+
 /**
  * Type: Sensor watch properties
  */
 typedef struct {
     struct timeval          update_interval;
+    /** update_interval_max: adaptive interval if greater than update_interval:
+     *  the interval doubles at each SENSOR_UNCHANGED update, up to this maximum,
+     *  and it is reset to update_interval when the value changes. */
+    struct timeval          update_interval_max;
+    /** update_slack: tolerated delay of updates. Deadlines are delayed to the next
+     *  multiple of update_slack, so that watches with the same (or multiple)
+     *  slacks share their wakeups, see sensor_update_next_timeout(). */
+    struct timeval          update_slack;
+    /** update_levels: ascending thresholds (SENSOR_VALUE_NULL if unused), evaluated
+     *  by libvsensors after each value change to set sample->level. A level is
+     *  left when the value goes below it minus level_hysteresis, and each
+     *  change is notified to callback with SWE_WATCH_LEVEL. */
     sensor_value_t          update_levels[SENSOR_LEVEL_NB];
+    double                  level_hysteresis;
+    /** deadband_abs, deadband_pct: a changed numeric value is reported as
+     *  SENSOR_UPDATED only if it differs from the last reported one by more than
+     *  deadband_abs and by more than deadband_pct percent of it (0 to disable) */
+    double                  deadband_abs;
+    double                  deadband_pct;
+    /** flags: bit combination of sensor_watch_flag_t */
+    unsigned int            flags;
     sensor_property_t *     properties;
     sensor_watch_callback_t callback;
     void *                  callback_data;
+    /** history_size: number of points kept in sample history, 0 for none,
+     *                see sensor_history_get() */
+    unsigned int            history_size;
+    /** archive_size: number of points kept compressed in sample archive,
+     *                0 for none, see sensor_archive_query() */
+    unsigned int            archive_size;
 } sensor_watch_t;
 
 #define SENSOR_WATCH_INITIALIZER(_interval_ms, _callback)                   \
@@ -232,11 +317,16 @@ typedef struct {
         .update_interval = (struct timeval) {                               \
             .tv_sec     = _interval_ms / 1000,                              \
             .tv_usec    = (_interval_ms % 1000) * 1000 },                   \
+        .update_interval_max = (struct timeval) { .tv_sec = 0, .tv_usec = 0 }, \
+        .update_slack = (struct timeval) { .tv_sec = 0, .tv_usec = 0 },     \
         .callback = _callback,                                              \
         .update_levels = { (sensor_value_t) { .type = SENSOR_VALUE_NULL},   \
                            (sensor_value_t) { .type = SENSOR_VALUE_NULL},   \
                            (sensor_value_t) { .type = SENSOR_VALUE_NULL} }, \
-        .properties = NULL, .callback_data = NULL                           \
+        .level_hysteresis = 0.0, .flags = SWF_NONE,                         \
+        .deadband_abs = 0.0, .deadband_pct = 0.0,                           \
+        .properties = NULL, .callback_data = NULL, .history_size = 0,       \
+        .archive_size = 0                                                   \
     }
 
 /**
@@ -250,8 +340,120 @@ struct sensor_sample_s {
     void *                  user_data; /* for MMIs */
     /** userfreefun() : essentially used to clean user data contained in user_data */
     void                    (*userfreefun)(void* /* (sensor_sample_t *) */);
+    /** private to libvsensors: position+1 in update scheduler, 0 if not scheduled */
+    unsigned int            sched_idx;
+    /** private to libvsensors: history ring if watch->history_size > 0 */
+    struct sensor_history_s * history;
+    /** private to libvsensors: compressed archive if watch->archive_size > 0 */
+    struct sensor_archive_s * archive;
+    /** level: number of watch->update_levels reached by value (0 if below all,
+     *         SENSOR_LEVEL_CRITICAL + 1 if critical), see SWE_WATCH_LEVEL */
+    unsigned int            level;
+    /** private to libvsensors: last reported value for watch deadbands */
+    long double             deadband_ref;
+    /** private to libvsensors: current adaptive interval, see update_interval_max */
+    struct timeval          interval;
+    /** acquired_ns: nano-seconds time (sctx clock, see sensor_now_ns()) at which
+     *               value was last read by the family, 0 if never read */
+    uint64_t                acquired_ns;
+    /** private to libvsensors: incremented when the sample is freed, kept by its
+     *  slab slot, so that deferred events of freed samples are recognized */
+    unsigned int            generation;
 };
 
+/**
+ * Type: one point of a sample history, see sensor_history_get()
+ */
+typedef struct {
+    struct timeval          time;       /* time given to sensor_update_get() */
+    sensor_value_t          value;
+} sensor_history_point_t;
+
+/**
+ * Type: aggregates over the points of a sample history, see sensor_history_stats()
+ */
+typedef struct {
+    unsigned int            count;      /* number of points in history */
+    unsigned int            capacity;   /* watch history_size */
+    sensor_value_t          min;
+    sensor_value_t          max;
+    long double             sum;
+    long double             avg;
+    struct timeval          first;      /* time of oldest point */
+    struct timeval          last;       /* time of newest point */
+} sensor_history_stats_t;
+
+/**
+ * Type: iterator on the points of a sample archive, see sensor_archive_query()
+ */
+typedef struct sensor_archive_iter_s sensor_archive_iter_t;
+
+/**
+ * Type: size of a sample archive, see sensor_archive_stats()
+ */
+typedef struct {
+    unsigned int            count;      /* number of points in archive */
+    unsigned int            chunks;     /* number of chunks holding them */
+    size_t                  bytes;      /* memory used by archive */
+    struct timeval          first;      /* time of oldest point */
+    struct timeval          last;       /* time of newest point */
+} sensor_archive_stats_t;
+
+/**
+ * Type: caller-owned array of updated samples, for sensor_update_fill()
+ */
+typedef struct {
+    sensor_sample_t **      samples;    /* array of at least 'capacity' elements */
+    unsigned int            capacity;
+    unsigned int            count;      /* number of samples stored */
+    unsigned int            overflow;   /* updated samples not stored (array full) */
+} sensor_update_array_t;
+
+#define SENSOR_UPDATE_ARRAY_INITIALIZER(_samples, _capacity)                \
+    (sensor_update_array_t) {                                               \
+        .samples = (_samples), .capacity = (_capacity),                     \
+        .count = 0, .overflow = 0                                           \
+    }
+
+/**
+ * Type: value of a watched sample in a snapshot, see sensor_snapshot_take()
+ */
+typedef struct {
+    uint32_t                id;         /* id of '<family>/<label>', see sensor_snapshot_name() */
+    uint32_t                reserved;
+    uint64_t                time_ns;    /* acquisition time (sctx clock, see sensor_now_ns()),
+                                         * 0 if never read */
+    sensor_value_t          value;      /* strings and bytes point into snapshot bytes */
+} sensor_snapshot_entry_t;
+
+/**
+ * Type: caller-owned snapshot of watched samples, reused between sensor_snapshot_take()
+ * calls and released by sensor_snapshot_free(). Fields are read-only for caller.
+ */
+typedef struct {
+    sensor_snapshot_entry_t *   entries;    /* 'count' entries, in watch order */
+    unsigned int                count;
+    uint64_t                    time_ns;    /* time of snapshot (sctx clock) */
+    /** private to libvsensors */
+    unsigned int                max_entries;
+    char *                      bytes;      /* data of strings and bytes values */
+    size_t                      bytes_size;
+    size_t                      bytes_max;
+    char *                      names;      /* '<family>/<label>\0' of ids */
+    size_t                      names_size;
+    size_t                      names_max;
+    uint32_t *                  name_offsets; /* offset in names of id */
+    size_t                      name_offsets_max;
+    unsigned int                n_ids;
+    uint32_t *                  ids;        /* hash table of (id + 1, name hash) */
+    unsigned int                ids_size;   /* power of 2, or 0 */
+} sensor_snapshot_t;
+
+#define SENSOR_SNAPSHOT_INITIALIZER                                         \
+    (sensor_snapshot_t) { .entries = NULL, .count = 0, .max_entries = 0,    \
+                          .bytes = NULL, .names = NULL, .name_offsets = NULL, \
+                          .ids = NULL, .ids_size = 0 }
+
 /**
  * Type: sensor_{,watch_}{add*,del*} flags
  */
@@ -263,6 +465,12 @@ typedef enum {
     SSF_DEFAULT         = SSF_CASEFOLD
 } sensor_search_flags_t;
 
+/**
+ * Type: sensor_pattern_t
+ *   Opaque compiled pattern, see sensor_pattern_compile().
+ */
+typedef struct sensor_pattern_s sensor_pattern_t;
+
 /**
  * Types: sensor_{,watch_}visit_t
  *   Functions visiting sensors or watchs for sensor_visit() and sensor_watch_visit().
@@ -270,6 +478,34 @@ typedef enum {
 typedef sensor_status_t (*sensor_visitfun_t)(const sensor_desc_t * desc, void * user_data);
 typedef sensor_status_t (*sensor_watch_visitfun_t)(sensor_sample_t * sample, void * user_data);
 
+/**
+ * Types: sensor_export_t, opaque exporter of updated samples, see sensor_export_create().
+ */
+typedef enum {
+    SEF_LINE_PROTOCOL = 0,  /* InfluxDB line protocol */
+    SEF_BINARY,             /* compact binary frames */
+} sensor_export_format_t;
+
+typedef struct sensor_export_s sensor_export_t;
+
+/**
+ * Type: sensor_shm_t, opaque shared memory segment of published values,
+ *       see sensor_shm_publish() and sensor_shm_open().
+ */
+typedef struct sensor_shm_s sensor_shm_t;
+
+/**
+ * Type: sensor_replay_t, opaque root directory of system file snapshots,
+ *       see sensor_replay_create() and sensor_init_sysroot().
+ */
+typedef struct sensor_replay_s sensor_replay_t;
+
+/**
+ * Type: sensor_stream_t, opaque server of watched samples to remote mirror
+ *       contexts, see sensor_stream_serve() and sensor_stream_connect().
+ */
+typedef struct sensor_stream_s sensor_stream_t;
+
 /**
  * LOG prefix used for libvsensors
  */
@@ -296,6 +532,23 @@ extern "C" {
  */
 sensor_ctx_t *  sensor_init(logpool_t * logs, unsigned int flags);
 
+/**
+ * sensor_init() with only some families.
+ * @param families comma separated names allowed, the common family is always included.
+ *        If NULL, VSENSORS_FAMILIES environment variable is used, or all families if unset.
+ */
+sensor_ctx_t *  sensor_init_families(logpool_t * logs, unsigned int flags, const char * families);
+
+/**
+ * sensor_init_families() reading the system files of sysdeps (/proc, /sys) under
+ * another root, for recorded or synthesized snapshots (see sensor_replay_create()).
+ * Live sources (netlink, udev) are then not used.
+ * @param sysroot the root directory. If NULL, VSENSORS_SYSROOT environment variable
+ *        is used, or the live system if unset.
+ */
+sensor_ctx_t *  sensor_init_sysroot(logpool_t * logs, unsigned int flags,
+                                    const char * families, const char * sysroot);
+
 /** Clean the sensor handle */
 sensor_status_t sensor_free(sensor_ctx_t * sctx);
 
@@ -376,6 +629,47 @@ sensor_status_t sensor_desc_match(
                         unsigned int            flags,
                         const sensor_desc_t *   sensor);
 
+/** get the canonical name '<family>/<label>' of a listed sensor, without formatting it.
+ * @param sensor the sensor
+ * @param p_len if not NULL, set to the name length.
+ * @param p_hash if not NULL, set to the name hash (FNV-1a, case-sensitive).
+ * @return the interned name, valid until the sensor is released on family reload
+ *         or sensor_list_free(), or NULL if the sensor is not listed. */
+const char *        sensor_desc_fullname(
+                        const sensor_desc_t *   sensor,
+                        size_t *                p_len,
+                        unsigned int *          p_hash);
+
+/**
+ * Compile a pattern for repeated use with the *_compiled() functions, which
+ * avoids the pattern analysis and search range computing on each call.
+ * The compiled pattern does not depend on sensors and stays valid on family reloads.
+ * @param sctx the sensor context
+ * @param pattern fnmatch(3) pattern with format '<family>/<label>'.
+ * @param flags, bit combination of sensor_search_flags_t
+ * @return the compiled pattern to be freed with sensor_pattern_free(), or NULL on error.
+ */
+sensor_pattern_t *  sensor_pattern_compile(
+                        sensor_ctx_t *          sctx,
+                        const char *            pattern,
+                        unsigned int            flags);
+
+/** free a pattern compiled with sensor_pattern_compile() */
+void                sensor_pattern_free(sensor_pattern_t * cpattern);
+
+/** sensor_find() with a compiled pattern */
+sensor_desc_t *     sensor_find_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        slist_t **              matchs);
+
+/** sensor_visit() with a compiled pattern */
+sensor_status_t     sensor_visit_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        sensor_visitfun_t       visit,
+                        void *                  user_data);
+
 /* ************************************************************************
  * SENSOR_WATCHS : operation on sensors watch list
  * ************************************************************************ */
@@ -410,6 +704,12 @@ sensor_status_t sensor_watch_add(
                         unsigned int            flags,
                         sensor_watch_t *        watch);
 
+/** sensor_watch_add() with a compiled pattern */
+sensor_status_t sensor_watch_add_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        sensor_watch_t *        watch);
+
 /**
  * delete sensors from watch list.
  * User can clean the watch_list with sensor_watch_free() and watchs will be canceled.
@@ -423,6 +723,11 @@ sensor_status_t sensor_watch_del(
                         const char *            pattern,
                         unsigned int            flags);
 
+/** sensor_watch_del() with a compiled pattern */
+sensor_status_t sensor_watch_del_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern);
+
 /**
  * look for a sensor in watch list.
  * @param sctx the sensor context
@@ -454,6 +759,19 @@ sensor_status_t sensor_watch_visit(
                         sensor_watch_visitfun_t visit,
                         void *                  user_data);
 
+/** sensor_watch_find() with a compiled pattern */
+sensor_sample_t *   sensor_watch_find_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        slist_t **              matchs);
+
+/** sensor_watch_visit() with a compiled pattern */
+sensor_status_t     sensor_watch_visit_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        sensor_watch_visitfun_t visit,
+                        void *                  user_data);
+
 /** return watch list.
  * User has to bound call between [sensor_lock(),sensor_unlock()] if needed.
  * @return list of watched sensors (slist_t of sensor_sample_t *) */
@@ -477,17 +795,34 @@ unsigned long   sensor_watch_pgcd(sensor_ctx_t *sctx,
 
 /**
  * Save the list of watchs to file
+ * The file is a versioned binary file in native byte order, storing the resolved
+ * labels with their intervals, update_levels and properties (not the callbacks).
+ * @param watch_list the list given by sensor_watch_list_get()
  * @return status of operation
  */
 sensor_status_t sensor_watch_save(slist_t * watch_list, const char * path);
 
 /**
  * Load the list of watchs from File.
- * User must clean the watch_list with sensor_watch_free().
- * @return slist_t *<sensor_sample_t*>
+ * Kept for compatibility: watchs cannot be added without a context,
+ * use sensor_watch_load_ctx().
+ * @return NULL
  */
 const slist_t * sensor_watch_load(const char * path);
 
+/**
+ * Load the list of watchs from File saved by sensor_watch_save(), and add
+ * them, looking up the saved labels without pattern matching.
+ * User must clean the watch_list with sensor_watch_free().
+ * @param callback, callback_data the callback of loaded watchs (sensor_watch_t).
+ * @return slist_t *<sensor_sample_t*>, as sensor_watch_list_get(), or NULL on error.
+ */
+const slist_t * sensor_watch_load_ctx(
+                        sensor_ctx_t *          sctx,
+                        const char *            path,
+                        sensor_watch_callback_t callback,
+                        void *                  callback_data);
+
 
 /* ************************************************************************
  * SENSOR_UPDATES : handle and check sensors updates
@@ -496,9 +831,16 @@ const slist_t * sensor_watch_load(const char * path);
 /** get the current time.
  * this is not mandatory to use this time, user can have its own way to get
  * current time, it important thing is to have realistic relative time
- * between calls */
+ * between calls.
+ * This uses CLOCK_MONOTONIC_RAW: with SIF_CLOCK_* init flags, prefer
+ * sensor_now_ns() or give now=NULL to sensor_update functions. */
 sensor_status_t sensor_now(struct timeval * now);
 
+/** get the current time in nano-seconds, with the clock selected by sensor_init()
+ * flags (CLOCK_MONOTONIC_RAW if sctx is NULL). This is the clock of
+ * sensor_sample_t.acquired_ns. */
+sensor_status_t sensor_now_ns(sensor_ctx_t * sctx, uint64_t * now_ns);
+
 /**
  * Update a given sensor, according to its update interval.
  * @param sensor the sensor to update: undefined behavior if NULL.
@@ -527,12 +869,468 @@ sensor_status_t sensor_update_check(sensor_sample_t * sensor, const struct timev
  * @return slist_t *<sensor_sample_t*>
  * @note: Prefer sensor_update_check() to avoid mallocs/frees .
  *        Calling this function will require <nb_updates> malloc and free.
+ * @note: only the samples whose next_update_time is reached are visited,
+ *        the scheduler keeps watchs ordered by deadline.
  */
 slist_t *       sensor_update_get(sensor_ctx_t * sctx, const struct timeval * now);
 
 /** Clean the list of updated watched sensors */
 void            sensor_update_free(slist_t * updates);
 
+/**
+ * Allocation-free variant of sensor_update_get(): updated samples are
+ * stored in the caller-owned array, in order of their deadline.
+ * @param sctx the sensor context
+ * @param now current time or NULL, see sensor_update_get().
+ * @param updates the array to fill. count and overflow are reset on each call.
+ * @return SENSOR_UPDATED if at least one sample was updated,
+ *         SENSOR_UNCHANGED if none, SENSOR_RELOAD_FAMILY if a family has been
+ *         reloaded (updates->count is then 0), SENSOR_ERROR on error.
+ */
+sensor_status_t sensor_update_fill(
+                        sensor_ctx_t *          sctx,
+                        const struct timeval *  now,
+                        sensor_update_array_t * updates);
+
+/**
+ * Get the time of the next scheduled update among watched sensors.
+ * @param sctx the sensor context
+ * @param deadline the nearest next_update_time, in the time base of
+ *        sensor_now() or of the 'now' given to sensor_update_get().
+ * @return SENSOR_SUCCESS, SENSOR_NOT_SUPPORTED if nothing is scheduled,
+ *         or SENSOR_ERROR.
+ */
+sensor_status_t sensor_update_next_deadline(sensor_ctx_t * sctx, struct timeval * deadline);
+
+/**
+ * Get the delay until the next scheduled update, suitable for poll(2).
+ * @param sctx the sensor context
+ * @param now the current time, or NULL to let libvsensors evaluate it.
+ * @return milli-seconds (rounded up) until next update, 0 if an update is due,
+ *         -1 if nothing is scheduled or on error.
+ */
+long            sensor_update_next_timeout(sensor_ctx_t * sctx, const struct timeval * now);
+
+/**
+ * Get a file descriptor for event loops (poll, epoll, kqueue), becoming readable
+ * when a family calls sensor_family_signal(). It must be polled with the
+ * sensor_update_next_timeout() timeout, and it is drained by sensor_update_get()
+ * and sensor_update_fill(). It belongs to libvsensors and is closed by sensor_free().
+ * @return the file descriptor, or -1 on error.
+ */
+int             sensor_update_fd(sensor_ctx_t * sctx);
+
+/**
+ * Wait until the next scheduled update is due or a family signaled an event.
+ * @param sctx the sensor context
+ * @param timeout_ms maximum milli-seconds to wait, -1 for no limit.
+ * @return SENSOR_SUCCESS if sensor_update_get() should be called,
+ *         SENSOR_WAIT_TIMER if timeout_ms expired before, or SENSOR_ERROR.
+ */
+sensor_status_t sensor_update_wait(sensor_ctx_t * sctx, long timeout_ms);
+
+/* ************************************************************************
+ * SENSOR_EXPORT : serialization of updated samples to a file descriptor
+ * ************************************************************************ */
+
+/**
+ * Create an exporter, called at the end of each sensor_update_get() or
+ * sensor_update_fill() pass: all the samples updated by the pass are serialized
+ * into one buffer reused between passes, written with one writev() to fd.
+ * With sensor_update_fill(), only samples stored in the array are exported.
+ *
+ * SEF_LINE_PROTOCOL writes one line per sample, with CLOCK_REALTIME nano-seconds:
+ *   <measurement>,family=<family>,label=<label> value=<value> <timestamp>
+ * SEF_BINARY writes, per pass, a frame header (native byte order):
+ *   "VSXB", u8 version, u8 flags, u16 header_size, u32 byteorder(0x01020304),
+ *   u32 n_records, u32 size, u32 reserved, u64 time_ns
+ * followed by 'size' bytes of records, each being:
+ *   u32 id, u8 type, u8 reserved, u16 size, then 'size' bytes of data:
+ *   the raw sensor_value_t data of type sensor_value_type_t, or if type is 0xff,
+ *   the '<family>/<label>' name given to id, sent once before its first value.
+ *   Frame flag 0x01 means that previously defined ids are no longer valid.
+ *
+ * @param sctx the sensor context
+ * @param fd the file descriptor, not owned by the exporter
+ * @param format the output format
+ * @param measurement the line protocol measurement, NULL for "sensors"
+ * @return the exporter, to be freed with sensor_export_free(), or with sensor_free().
+ */
+sensor_export_t * sensor_export_create(
+                    sensor_ctx_t *              sctx,
+                    int                         fd,
+                    sensor_export_format_t      format,
+                    const char *                measurement);
+
+/** stop and free an exporter created with sensor_export_create() */
+sensor_status_t sensor_export_free(sensor_export_t * exporter);
+
+/**
+ * Render the watched samples in OpenMetrics (Prometheus) text format, as gauges:
+ *   sensors{family="<family>",label="<label>"[,<property>="<value>"...]} <value>
+ * Properties of sensors become labels, rendered once per sensor and cached.
+ * Strings and bytes sensors are not rendered.
+ * @param sctx the sensor context
+ * @param buf the destination buffer, always 0-terminated if cap > 0
+ * @param cap the size of buf
+ * @return the length of the rendering, as snprintf: if it is >= cap, buf is
+ *         truncated and a buffer of at least return value + 1 can be retried.
+ *         -1 on error.
+ */
+int             sensor_render_openmetrics(sensor_ctx_t * sctx, char * buf, size_t cap);
+
+/* ************************************************************************
+ * SENSOR_SNAPSHOT : consistent copy of the watched values, read without lock
+ * ************************************************************************ */
+
+/**
+ * Copy the value, acquisition time and name id of every watched sample into
+ * snap, in one pass under write lock: no update is running meanwhile, and the
+ * snapshot is then read without any lock, at leisure. Buffers of snap are kept
+ * and only grown, so that taking snapshots regularly does not allocate.
+ * Loading sensors are not copied.
+ * @param sctx the sensor context
+ * @param snap the snapshot, initialized with SENSOR_SNAPSHOT_INITIALIZER
+ * @return SENSOR_SUCCESS or SENSOR_ERROR.
+ */
+sensor_status_t sensor_snapshot_take(sensor_ctx_t * sctx, sensor_snapshot_t * snap);
+
+/** '<family>/<label>' name of a snapshot entry id, or NULL. Ids are given to
+ * names by snap, they are kept across sensor_snapshot_take() and family reloads. */
+const char *    sensor_snapshot_name(const sensor_snapshot_t * snap, uint32_t id);
+
+/** release the buffers of a snapshot, which can be reused as initialized */
+void            sensor_snapshot_free(sensor_snapshot_t * snap);
+
+/* ************************************************************************
+ * SENSOR_SHM : publication of sampled values to other processes
+ * ************************************************************************ */
+
+/**
+ * Publish the values of watched samples into a shared file (eg: in /dev/shm),
+ * written at each update, so that any number of processes can read them with
+ * sensor_shm_open() and without syscalls. Each value has a seqlock and a
+ * '<family>/<label>' name. The file is kept when publication stops.
+ * @param sctx the sensor context
+ * @param path the file to create or replace (readers of a replaced segment keep
+ *        it), NULL to stop the publication
+ * @param max_slots the maximum number of published sensors
+ * @return SENSOR_SUCCESS or SENSOR_ERROR
+ */
+sensor_status_t sensor_shm_publish(sensor_ctx_t * sctx, const char * path, unsigned int max_slots);
+
+/** map read-only a file published with sensor_shm_publish(), NULL on error.
+ * It must be released with sensor_shm_close() */
+sensor_shm_t *  sensor_shm_open(const char * path);
+
+/** unmap a segment opened with sensor_shm_open() */
+void            sensor_shm_close(sensor_shm_t * shm);
+
+/** number of published values: indexes are stable and can be cached */
+unsigned int    sensor_shm_count(const sensor_shm_t * shm);
+
+/** '<family>/<label>' name of value idx, or NULL */
+const char *    sensor_shm_name(const sensor_shm_t * shm, unsigned int idx);
+
+/** index of value having this '<family>/<label>' name, or -1 */
+int             sensor_shm_find(const sensor_shm_t * shm, const char * name);
+
+/**
+ * Read a published value, consistent thanks to its seqlock.
+ * @param shm the segment opened with sensor_shm_open()
+ * @param idx the index of value
+ * @param value the value, for strings and bytes, its type and buffer must be
+ *        initialized (see SENSOR_VALUE_INIT_BUF), published buffers being
+ *        truncated to 39 bytes.
+ * @param time if not NULL, the acquisition time of value (publisher clock,
+ *        see sensor_now_ns())
+ * @return SENSOR_SUCCESS, SENSOR_LOADING if not yet updated, or SENSOR_ERROR.
+ */
+sensor_status_t sensor_shm_read(const sensor_shm_t *    shm,
+                                unsigned int            idx,
+                                sensor_value_t *        value,
+                                struct timeval *        time);
+
+/* ************************************************************************
+ * SENSOR_REPLAY : system files snapshots, read by sysdeps with sensor_init_sysroot(
+ *                 ..., sensor_replay_root(replay)) for deterministic tests
+ * ************************************************************************ */
+
+/**
+ * Create a root of system files snapshots.
+ * @param root the directory to use (eg: recorded /proc and /sys files), created
+ *        if needed, or NULL for a new private directory in memory (/dev/shm, or
+ *        in $TMPDIR), removed by sensor_replay_free().
+ * @return the replay root, or NULL on error.
+ */
+sensor_replay_t * sensor_replay_create(const char * root);
+
+/**
+ * Set the content of a system file of the replay root, parent directories
+ * being created. It can be called between updates to serve the next snapshot:
+ * files kept opened by sysdeps read the new content.
+ * @param replay the replay root
+ * @param path the absolute system path, eg: "/proc/stat"
+ * @param data the content, or NULL to only create the directory path
+ * @param size the size of data
+ * @return SENSOR_SUCCESS or SENSOR_ERROR
+ */
+sensor_status_t sensor_replay_put(
+                    sensor_replay_t *   replay,
+                    const char *        path,
+                    const void *        data,
+                    size_t              size);
+
+/** directory to give to sensor_init_sysroot() */
+const char *    sensor_replay_root(const sensor_replay_t * replay);
+
+/** free a replay root, removing it if it was created by sensor_replay_create(NULL) */
+sensor_status_t sensor_replay_free(sensor_replay_t * replay);
+
+/* ************************************************************************
+ * SENSOR_STREAM : watched samples streamed to mirror contexts of other hosts
+ * ************************************************************************ */
+
+/**
+ * Serve the watched samples on a listening socket. Clients are accepted and
+ * served at the end of each sensor_update_get() or sensor_update_fill() pass:
+ * a new client receives the catalog of watched sensors with their current
+ * values, then one frame per pass with only the samples changed by the pass.
+ *
+ * Frames are: u8 kind, u32 little-endian payload size, payload. Integers are
+ * LEB128 varints, signed ones zigzag-encoded (svarint):
+ *   'H' hello:  "VSXS", u8 version (1), first frame of a connection
+ *   'R' reset:  ids previously defined are no longer valid
+ *   'D' define: per id: varint id, u8 sensor_value_type_t, varint size and
+ *               '<family>/<label>', varint n_properties, per property:
+ *               varint size and name, u8 type, value against 0.
+ *   'V' data:   svarint CLOCK_REALTIME ns delta with the previous 'V' frame,
+ *               varint n, per sample: varint id, svarint acquisition time delta
+ *               with the frame time, value against the previous value of id.
+ * A value against the previous one is: for integers, the svarint of their
+ * difference; for float and double, u8 0 if the bits are unchanged, or u8
+ * shift + 1 and varint (bits xor previous bits) >> shift; for long double its
+ * raw bytes; for strings and bytes, varint size and data. The first value of
+ * an id after its definition is sent against 0.
+ *
+ * @param sctx the sensor context
+ * @param address "unix:<path>" or a path with a '/' for a unix socket, else
+ *        "<host>:<port>", "[<ipv6>]:<port>" or ":<port>" (all addresses) for TCP.
+ * @return the server, to be freed with sensor_stream_free() or sensor_free().
+ */
+sensor_stream_t * sensor_stream_serve(sensor_ctx_t * sctx, const char * address);
+
+/** stop a server, closing its connections */
+sensor_status_t sensor_stream_free(sensor_stream_t * stream);
+
+/**
+ * Create a mirror context of a remote sensor_stream_serve(): its families are
+ * named as the remote ones and it is used with the usual find, visit, watch and
+ * update functions, updates applying the frames received since the previous pass.
+ * Sensors watched remotely later are added to these families (SENSOR_RELOAD_FAMILY),
+ * sensors of families not in the initial catalog are not mirrored.
+ * Values stop changing when the connection is closed.
+ * @param logs, flags see sensor_init()
+ * @param address see sensor_stream_serve()
+ * @param timeout_ms maximum time to wait for the catalog, sent by the next
+ *        update pass of the server, -1 for no limit.
+ * @return the mirror context, to be freed with sensor_free(), or NULL on error.
+ */
+sensor_ctx_t *  sensor_stream_connect(logpool_t * logs, unsigned int flags,
+                                      const char * address, long timeout_ms);
+
+/**
+ * Get the remote acquisition time of the last value of a mirrored sensor.
+ * @param desc a sensor of a sensor_stream_connect() context
+ * @param realtime_ns the CLOCK_REALTIME nano-seconds time given by the server
+ * @return SENSOR_SUCCESS or SENSOR_ERROR if desc is not mirrored.
+ */
+sensor_status_t sensor_stream_time(const sensor_desc_t * desc, uint64_t * realtime_ns);
+
+/* ************************************************************************
+ * SENSOR_HISTORY : values kept by samples watched with history_size > 0
+ * Strings and bytes sensors have no history.
+ * ************************************************************************ */
+
+/**
+ * Copy points of a sample history, from oldest to newest.
+ * @param sctx the sensor context
+ * @param sample the watched sample
+ * @param start index of first point to copy, 0 being the oldest point kept
+ * @param points the array receiving the points
+ * @param max_points the capacity of points array
+ * @return number of points copied, or -1 if the sample has no history.
+ */
+int             sensor_history_get(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    unsigned int                start,
+                    sensor_history_point_t *    points,
+                    unsigned int                max_points);
+
+/**
+ * Get min, max, sum and average of a sample history, maintained in O(1)
+ * at each update.
+ * @param sctx the sensor context
+ * @param sample the watched sample
+ * @param stats the aggregates, with count 0 if history is empty.
+ * @return SENSOR_SUCCESS or SENSOR_ERROR if the sample has no history.
+ */
+sensor_status_t sensor_history_stats(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    sensor_history_stats_t *    stats);
+
+/* ************************************************************************
+ * SENSOR_ARCHIVE : compressed values kept by samples watched with archive_size > 0,
+ * in chunks of bit-packed points sealed when full: times as delta-of-delta,
+ * float and double as xor with previous value, integers as zigzag delta.
+ * Times are kept with a milli-second resolution, long doubles as doubles.
+ * The oldest chunks are dropped as soon as archive_size points are kept without them.
+ * Strings and bytes sensors have no archive.
+ * ************************************************************************ */
+
+/**
+ * Start a query of the points of a sample archive, from oldest to newest.
+ * Points are decoded by sensor_archive_next(), one chunk at a time.
+ * @param sctx the sensor context
+ * @param sample the watched sample
+ * @param from the time of first point, NULL for the oldest one
+ * @param to the time of last point, NULL for the newest one
+ * @return the iterator to free with sensor_archive_iter_free(), valid even
+ *         after sample is freed, or NULL if the sample has no archive.
+ */
+sensor_archive_iter_t * sensor_archive_query(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    const struct timeval *      from,
+                    const struct timeval *      to);
+
+/**
+ * Decode the next point of an archive query.
+ * @param iter the iterator returned by sensor_archive_query()
+ * @param point the decoded point
+ * @return 1 if point is set, 0 at the end of query, -1 on error.
+ */
+int             sensor_archive_next(
+                    sensor_archive_iter_t *     iter,
+                    sensor_history_point_t *    point);
+
+/**
+ * Free an iterator returned by sensor_archive_query().
+ */
+void            sensor_archive_iter_free(sensor_archive_iter_t * iter);
+
+/**
+ * Get the number of points, chunks and bytes of a sample archive.
+ * @param sctx the sensor context
+ * @param sample the watched sample
+ * @param stats the archive size, with count 0 if archive is empty.
+ * @return SENSOR_SUCCESS or SENSOR_ERROR if the sample has no archive.
+ */
+sensor_status_t sensor_archive_stats(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    sensor_archive_stats_t *    stats);
+
+
+/* ************************************************************************
+ * SENSOR_DISPATCH : watch events delivered by a dedicated thread
+ * ************************************************************************ */
+
+/** what to do with a watch event when the dispatch ring is full */
+typedef enum {
+    SDO_DROP_NEW = 0,       /* the new event is dropped */
+    SDO_DROP_OLD,           /* the oldest event of the ring is dropped */
+    SDO_BLOCK,              /* the updating thread waits for the dispatcher, at most
+                               100ms per update pass, then drops the events of
+                               the pass */
+} sensor_dispatch_overflow_t;
+
+/** a deferred watch event, see sensor_dispatch_start() */
+typedef struct {
+    sensor_sample_t *       sample;
+    unsigned int            event;      /* SWE_WATCH_UPDATED or SWE_WATCH_LEVEL */
+    unsigned int            level;      /* SWE_WATCH_LEVEL: previous level, else sample level */
+    uint64_t                time_ns;    /* acquisition time of value (sctx clock) */
+    sensor_value_t          value;      /* value at event time. For strings and bytes,
+                                         * only type is set: read sample->value */
+} sensor_dispatch_event_t;
+
+/** batch delivery of the events of the last update passes, under read lock,
+ * dropped being the number of events lost since the previous call */
+typedef void    (*sensor_dispatch_batch_t)(
+                    sensor_ctx_t *                  sctx,
+                    const sensor_dispatch_event_t * events,
+                    unsigned int                    n_events,
+                    unsigned long                   dropped,
+                    void *                          user_data);
+
+/**
+ * Defer the SWE_WATCH_UPDATED and SWE_WATCH_LEVEL events out of the sampling
+ * path: update passes only enqueue (sample, event, value) records into a
+ * lock-free ring, and a dedicated thread delivers them at the end of each pass.
+ * Delivery is done under read lock, as the inline callbacks were, so that
+ * samples are valid. Events of samples freed by sensor_watch_del() or a family
+ * reload before their delivery are forgotten, and counted as dropped.
+ * With SDO_BLOCK, callbacks must not acquire the write lock.
+ * @param sctx the sensor context
+ * @param capacity number of events kept in the ring (rounded to a power of 2)
+ * @param overflow the policy when the ring is full
+ * @param batch the function receiving the events of each pass as one array,
+ *        or NULL to call the watch callback of each sample, one event at a time.
+ * @param user_data given to batch
+ * @return SENSOR_SUCCESS, or SENSOR_ERROR on error or if a dispatcher is running.
+ */
+sensor_status_t sensor_dispatch_start(
+                    sensor_ctx_t *              sctx,
+                    unsigned int                capacity,
+                    sensor_dispatch_overflow_t  overflow,
+                    sensor_dispatch_batch_t     batch,
+                    void *                      user_data);
+
+/** stop the dispatcher after delivery of its pending events: callbacks are
+ * called inline again. It is done by sensor_free(). */
+sensor_status_t sensor_dispatch_stop(sensor_ctx_t * sctx);
+
+/* ************************************************************************
+ * SENSOR_TRACE : tracepoints, compiled only with -DSENSOR_ENABLE_TRACE.
+ * With -DSENSOR_ENABLE_USDT too, they are also <sys/sdt.h> USDT probes
+ * libvsensors:begin and libvsensors:end (tracepoint, family, samples, duration_ns).
+ * ************************************************************************ */
+
+/** tracepoints, begin and end of each operation */
+typedef enum {
+    STP_UPDATE_GET = 0,     /* sensor_update_get(), sensor_update_fill() */
+    STP_FAMILY_UPDATE,      /* family update() or update_batch() */
+    STP_FAMILY_RELOAD,      /* SENSOR_RELOAD_FAMILY handling */
+    STP_SMC_LIST,           /* smc background listing job */
+    STP_NB
+} sensor_tracepoint_t;
+
+typedef enum {
+    STP_BEGIN = 0,
+    STP_END
+} sensor_trace_phase_t;
+
+/** trace hook, called from the tracing thread, it must be fast and must not
+ * call libvsensors. family is NULL for STP_UPDATE_GET, samples is the number
+ * of samples of the operation (due samples, known at STP_UPDATE_GET end, 0 for
+ * reloads and listing), and duration_ns is 0 at STP_BEGIN. */
+typedef void    (*sensor_trace_hook_t)(
+                        sensor_tracepoint_t     tracepoint,
+                        sensor_trace_phase_t    phase,
+                        const char *            family,
+                        unsigned int            samples,
+                        uint64_t                duration_ns,
+                        void *                  user_data);
+
+/**
+ * Register the process-wide trace hook, replacing the previous one.
+ * @param hook the hook or NULL to remove it
+ * @return SENSOR_SUCCESS, or SENSOR_NOT_SUPPORTED without SENSOR_ENABLE_TRACE
+ */
+sensor_status_t sensor_trace_register(sensor_trace_hook_t hook, void * user_data);
 
 /* ************************************************************************
  * SENSOR_PLUGIN : internal helpers for families/plugins
@@ -548,7 +1346,8 @@ sensor_status_t sensor_family_register(
  * SENSOR_RELOAD_FAMILY. sensor_family_t.notify can be used to wait readyness. */
 slist_t *       sensor_family_loading_list(sensor_family_t * family);
 
-/** RFU: send a signal to the libvsensors from families/plugins */
+/** send a signal to the libvsensors from families/plugins: wakes up
+ * sensor_update_wait() and makes sensor_update_fd() readable */
 sensor_status_t sensor_family_signal(sensor_family_t * family);
 
 /** COMMON FAMILY providing utilities for other sensors
@@ -567,6 +1366,30 @@ void                sensor_property_free(sensor_property_t * property);
 void                sensor_properties_free(sensor_property_t * properties);
 sensor_status_t     sensor_property_init(sensor_property_t * property, const char * name);
 
+/* ************************************************************************
+ * SENSOR_ARENA : internal helpers for families/plugins
+ * Bump allocator for the descs, keys, properties and strings of a family
+ * listing, all released with one sensor_arena_free() on reload or free.
+ * Nothing allocated from an arena must be given to free(): descs built this
+ * way need a free_desc() which does not release them one by one.
+ * ************************************************************************ */
+
+/** Type: sensor_arena_t, opaque arena */
+typedef struct sensor_arena_s sensor_arena_t;
+
+/** create an arena allocating chunks of chunk_size bytes (0 for default) */
+sensor_arena_t *    sensor_arena_create(size_t chunk_size);
+/** allocate size zeroed bytes, aligned for any sensor value, NULL on error */
+void *              sensor_arena_alloc(sensor_arena_t * arena, size_t size);
+/** duplicate a string in the arena */
+char *              sensor_arena_strdup(sensor_arena_t * arena, const char * str);
+/** sensor_properties_create() in the arena: not for sensor_properties_free() */
+sensor_property_t * sensor_arena_properties(sensor_arena_t * arena, unsigned int count);
+/** memory used by the arena */
+size_t              sensor_arena_size(const sensor_arena_t * arena);
+/** release the arena and everything allocated from it */
+void                sensor_arena_free(sensor_arena_t * arena);
+
 
 /* ************************************************************************
  * SENSOR_VALUE: see sensor_value.h
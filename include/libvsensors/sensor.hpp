@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Generic Sensor Management Library.
+ * Header-only C++20 wrapper of sensor.h.
+ *
+ * The wrapper only forwards to the C functions: it does not allocate, and
+ * views borrow the library buffers (labels, string values, update arrays,
+ * snapshots), with the lifetime rules of the C API.
+ *
+ * Usage:
+ *   vsensors::context                      sctx(SIF_DEFAULT);
+ *   sensor_watch_t                         props = vsensors::watch_props(1000);
+ *   vsensors::watch                        w = sctx.watch_add("cpu/load*", props);
+ *   std::array<sensor_sample_t *, 64>      storage;
+ *   vsensors::update_batch                 batch(storage);
+ *
+ *   while (sctx.wait(-1) == SENSOR_SUCCESS) {
+ *       vsensors::scoped_lock lock(sctx, SENSOR_LOCK_READ);
+ *       if (sctx.update_fill(batch) == SENSOR_RELOAD_FAMILY)
+ *           continue ;
+ *       for (vsensors::sample_view s : batch.samples())
+ *           use(s.fullname(), s.value().todouble());
+ *   }
+ *   (w is destroyed, unwatching "cpu/load*", before sctx which calls sensor_free())
+ */
+#ifndef LIBVSENSORS_SENSOR_HPP
+#define LIBVSENSORS_SENSOR_HPP
+
+#if !defined(__cplusplus) || __cplusplus < 202002L
+# error "libvsensors/sensor.hpp requires C++20"
+#endif
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#include "sensor.h"
+
+namespace vsensors {
+
+/* ************************************************************************
+ * Values
+ * ************************************************************************ */
+
+/** value_traits<SENSOR_VALUE_xxx>::type: the C type of a scalar sensor value type */
+template <sensor_value_type_t T> struct value_traits;
+
+#define VSENSORS_VALUE_TRAITS(_type, _name, _toint)                                 \
+    template <> struct value_traits<SENSOR_VALUE_##_type> {                          \
+        using type = TYPE_SENSOR_VALUE_##_type;                                      \
+        static type get(const sensor_value_t & v) noexcept {                        \
+            return SENSOR_VALUE_GET(v, SENSOR_VALUE_##_type);                        \
+        }                                                                            \
+    };
+SENSOR_VALUE_SCALARS_X(VSENSORS_VALUE_TRAITS)
+#undef VSENSORS_VALUE_TRAITS
+
+/**
+ * value_view: borrowed sensor_value_t, valid as long as the value is.
+ * Conversions use the typed operations given (desc->ops), if they match the
+ * value type, as libvsensors does in its update loop.
+ */
+class value_view {
+public:
+    value_view(const sensor_value_t & value,
+               const sensor_value_ops_t * ops = nullptr) noexcept
+        : m_value(&value), m_ops(ops != nullptr && ops->type == value.type ? ops : nullptr) {}
+
+    const sensor_value_t &  raw() const noexcept { return *m_value; }
+    sensor_value_type_t     type() const noexcept {
+        return static_cast<sensor_value_type_t>(m_value->type);
+    }
+    std::string_view        type_name() const noexcept {
+        return sensor_value_type_name(type());
+    }
+    bool                    is_buffer() const noexcept { return SENSOR_VALUE_IS_BUFFER(type()); }
+    bool                    is_floating() const noexcept { return SENSOR_VALUE_IS_FLOATING(type()); }
+
+    template <sensor_value_type_t T>
+    bool                    holds() const noexcept { return type() == T; }
+
+    /** scalar of type T, undefined if !holds<T>(), as SENSOR_VALUE_GET() */
+    template <sensor_value_type_t T>
+    typename value_traits<T>::type get() const noexcept {
+        return value_traits<T>::get(*m_value);
+    }
+
+    /** SENSOR_VALUE_STRING or SENSOR_VALUE_BYTES content, empty for other types */
+    std::string_view        str() const noexcept {
+        return is_buffer() && m_value->data.b.buf != nullptr
+               ? std::string_view(m_value->data.b.buf, m_value->data.b.size)
+               : std::string_view();
+    }
+    std::span<const unsigned char> bytes() const noexcept {
+        std::string_view s = str();
+        return { reinterpret_cast<const unsigned char *>(s.data()), s.size() };
+    }
+
+    long double             todouble() const noexcept {
+        return m_ops != nullptr ? m_ops->todouble(m_value) : sensor_value_todouble(m_value);
+    }
+    intmax_t                toint() const noexcept {
+        return m_ops != nullptr ? m_ops->toint(m_value) : sensor_value_toint(m_value);
+    }
+
+    /** sensor_value_tostring() into dst: the written string, truncated if dst is
+     * too small, or empty on error */
+    std::string_view        tostring(std::span<char> dst) const noexcept {
+        int len = sensor_value_tostring(m_value, dst.data(), dst.size());
+        if (len < 0 || dst.empty())
+            return {};
+        return { dst.data(), static_cast<size_t>(len) < dst.size()
+                             ? static_cast<size_t>(len) : dst.size() - 1 };
+    }
+
+    friend bool operator==(const value_view & v1, const value_view & v2) noexcept {
+        return v1.m_ops != nullptr ? v1.m_ops->equal(v1.m_value, v2.m_value) != 0
+                                   : sensor_value_equal(v1.m_value, v2.m_value) != 0;
+    }
+
+private:
+    const sensor_value_t *      m_value;
+    const sensor_value_ops_t *  m_ops;
+};
+
+/* ************************************************************************
+ * Descs and samples
+ * ************************************************************************ */
+
+/** label of desc, without family */
+inline std::string_view label(const sensor_desc_t & desc) noexcept {
+    return desc.label != nullptr ? std::string_view(desc.label) : std::string_view();
+}
+
+/** interned '<family>/<label>' of a listed desc (see sensor_desc_fullname()),
+ * empty if not listed */
+inline std::string_view fullname(const sensor_desc_t & desc) noexcept {
+    size_t          len;
+    const char *    name = sensor_desc_fullname(&desc, &len, nullptr);
+
+    return name != nullptr ? std::string_view(name, len) : std::string_view();
+}
+
+/**
+ * sample_view: borrowed watched sample, valid until it is unwatched or its
+ * family reloaded. Implicitly built from sensor_sample_t *, so that arrays of
+ * samples are iterated as views without conversion.
+ */
+class sample_view {
+public:
+    sample_view(sensor_sample_t * sample) noexcept : m_sample(sample) {}
+
+    sensor_sample_t *       get() const noexcept { return m_sample; }
+    const sensor_desc_t &   desc() const noexcept { return *m_sample->desc; }
+    std::string_view        label() const noexcept { return vsensors::label(*m_sample->desc); }
+    std::string_view        fullname() const noexcept { return vsensors::fullname(*m_sample->desc); }
+    value_view              value() const noexcept {
+        return value_view(m_sample->value, m_sample->desc->ops);
+    }
+    uint64_t                acquired_ns() const noexcept { return m_sample->acquired_ns; }
+    unsigned int            level() const noexcept { return m_sample->level; }
+
+private:
+    sensor_sample_t *       m_sample;
+};
+
+/**
+ * list_view<T>: borrowed slist_t of T *, as given by sensor_list_get() or
+ * sensor_watch_list_get(), to be iterated under sensor lock.
+ */
+template <typename T>
+class list_view {
+public:
+    class iterator {
+    public:
+        using value_type        = T *;
+        using difference_type   = std::ptrdiff_t;
+
+        iterator(const slist_t * elt = nullptr) noexcept : m_elt(elt) {}
+        T *         operator*() const noexcept { return static_cast<T *>(m_elt->data); }
+        iterator &  operator++() noexcept { m_elt = m_elt->next; return *this; }
+        iterator    operator++(int) noexcept { iterator it = *this; ++(*this); return it; }
+        bool        operator==(const iterator & other) const noexcept = default;
+    private:
+        const slist_t * m_elt;
+    };
+
+    list_view(const slist_t * list) noexcept : m_list(list) {}
+    iterator    begin() const noexcept { return iterator(m_list); }
+    iterator    end() const noexcept { return iterator(); }
+    bool        empty() const noexcept { return m_list == nullptr; }
+
+private:
+    const slist_t * m_list;
+};
+
+/** C++ counterpart of SENSOR_WATCH_INITIALIZER() */
+inline sensor_watch_t watch_props(unsigned long interval_ms,
+                                  sensor_watch_callback_t callback = nullptr,
+                                  void * callback_data = nullptr) noexcept {
+    sensor_watch_t props{}; /* update_levels are SENSOR_VALUE_NULL */
+
+    props.update_interval.tv_sec = interval_ms / 1000;
+    props.update_interval.tv_usec = (interval_ms % 1000) * 1000;
+    props.callback = callback;
+    props.callback_data = callback_data;
+    return props;
+}
+
+/* ************************************************************************
+ * Update batch and snapshot
+ * ************************************************************************ */
+
+/**
+ * update_batch: sensor_update_array_t over caller storage (eg: std::array),
+ * filled by context::update_fill(). Samples are valid under sensor lock.
+ */
+class update_batch {
+public:
+    explicit update_batch(std::span<sensor_sample_t *> storage) noexcept
+        : m_array{ storage.data(), static_cast<unsigned int>(storage.size()), 0, 0 } {}
+
+    /** samples updated by the last update_fill(), in order of their deadline */
+    std::span<sensor_sample_t * const>  samples() const noexcept {
+        return { m_array.samples, m_array.count };
+    }
+    /** updated samples not stored by the last update_fill() */
+    unsigned int                        overflow() const noexcept { return m_array.overflow; }
+    sensor_update_array_t *             get() noexcept { return &m_array; }
+
+private:
+    sensor_update_array_t   m_array;
+};
+
+/**
+ * snapshot: move-only owner of a sensor_snapshot_t, whose buffers are reused
+ * by each take() and released by the destructor. It is read without lock.
+ */
+class snapshot {
+public:
+    snapshot() noexcept : m_snap{} {} /* as SENSOR_SNAPSHOT_INITIALIZER */
+    ~snapshot() { sensor_snapshot_free(&m_snap); }
+    snapshot(const snapshot &) = delete;
+    snapshot & operator=(const snapshot &) = delete;
+    snapshot(snapshot && other) noexcept : m_snap(other.m_snap) {
+        other.m_snap = sensor_snapshot_t{};
+    }
+    snapshot & operator=(snapshot && other) noexcept {
+        std::swap(m_snap, other.m_snap);
+        return *this;
+    }
+
+    std::span<const sensor_snapshot_entry_t> entries() const noexcept {
+        return { m_snap.entries, m_snap.count };
+    }
+    /** '<family>/<label>' of an entry id, empty if unknown */
+    std::string_view        name(uint32_t id) const noexcept {
+        const char * name = sensor_snapshot_name(&m_snap, id);
+        return name != nullptr ? std::string_view(name) : std::string_view();
+    }
+    uint64_t                time_ns() const noexcept { return m_snap.time_ns; }
+    sensor_snapshot_t *     get() noexcept { return &m_snap; }
+
+private:
+    sensor_snapshot_t       m_snap;
+};
+
+/* ************************************************************************
+ * Context and watchs
+ * ************************************************************************ */
+
+class context;
+
+/**
+ * watch: move-only handle of the watchs added by context::watch_add().
+ * The watchs are deleted by the destructor, which must run before the
+ * destruction of the context.
+ */
+class watch {
+public:
+    watch() noexcept : m_sctx(nullptr), m_pattern(nullptr) {}
+    ~watch() { reset(); }
+    watch(const watch &) = delete;
+    watch & operator=(const watch &) = delete;
+    watch(watch && other) noexcept
+        : m_sctx(std::exchange(other.m_sctx, nullptr)),
+          m_pattern(std::exchange(other.m_pattern, nullptr)) {}
+    watch & operator=(watch && other) noexcept {
+        if (this != &other) {
+            reset();
+            m_sctx = std::exchange(other.m_sctx, nullptr);
+            m_pattern = std::exchange(other.m_pattern, nullptr);
+        }
+        return *this;
+    }
+
+    explicit operator bool() const noexcept { return m_pattern != nullptr; }
+
+    /** delete the watchs now */
+    void reset() noexcept {
+        if (m_pattern != nullptr) {
+            sensor_watch_del_compiled(m_sctx, m_pattern);
+            sensor_pattern_free(m_pattern);
+            m_pattern = nullptr;
+        }
+        m_sctx = nullptr;
+    }
+    /** keep the watchs, until sensor_watch_del() or sensor_watch_free() */
+    void release() noexcept {
+        sensor_pattern_free(m_pattern);
+        m_pattern = nullptr;
+        m_sctx = nullptr;
+    }
+
+private:
+    friend class context;
+    watch(sensor_ctx_t * sctx, sensor_pattern_t * pattern) noexcept
+        : m_sctx(sctx), m_pattern(pattern) {}
+
+    sensor_ctx_t *          m_sctx;
+    sensor_pattern_t *      m_pattern;
+};
+
+/**
+ * context: move-only owner of a sensor_ctx_t, released with sensor_free().
+ * Errors are reported as by the C functions: check the context with
+ * operator bool after construction, and the returned sensor_status_t.
+ */
+class context {
+public:
+    explicit context(unsigned int flags = SIF_DEFAULT, logpool_t * logs = nullptr) noexcept
+        : m_sctx(sensor_init(logs, flags)) {}
+    /** see sensor_init_families() */
+    context(const char * families, unsigned int flags, logpool_t * logs = nullptr) noexcept
+        : m_sctx(sensor_init_families(logs, flags, families)) {}
+    /** adopt a context, eg: of sensor_stream_connect() */
+    explicit context(sensor_ctx_t * sctx) noexcept : m_sctx(sctx) {}
+
+    ~context() {
+        if (m_sctx != nullptr)
+            sensor_free(m_sctx);
+    }
+    context(const context &) = delete;
+    context & operator=(const context &) = delete;
+    context(context && other) noexcept : m_sctx(std::exchange(other.m_sctx, nullptr)) {}
+    context & operator=(context && other) noexcept {
+        std::swap(m_sctx, other.m_sctx);
+        return *this;
+    }
+
+    explicit operator bool() const noexcept { return m_sctx != nullptr; }
+    sensor_ctx_t *          get() const noexcept { return m_sctx; }
+    sensor_ctx_t *          release() noexcept { return std::exchange(m_sctx, nullptr); }
+
+    sensor_status_t         lock(sensor_lock_type_t type) noexcept { return sensor_lock(m_sctx, type); }
+    sensor_status_t         unlock() noexcept { return sensor_unlock(m_sctx); }
+
+    /** sensor_list_get() and sensor_watch_list_get(), under sensor lock */
+    list_view<const sensor_desc_t>  descs() const noexcept { return sensor_list_get(m_sctx); }
+    list_view<sensor_sample_t>      samples() const noexcept { return sensor_watch_list_get(m_sctx); }
+
+    const sensor_desc_t *   find(const char * pattern, unsigned int flags = SSF_DEFAULT) noexcept {
+        return sensor_find(m_sctx, pattern, flags, nullptr);
+    }
+
+    /** watch the sensors matching pattern with props (duplicated), the returned
+     * handle is empty on error */
+    watch                   watch_add(const char * pattern, sensor_watch_t & props,
+                                      unsigned int flags = SSF_DEFAULT) noexcept {
+        sensor_pattern_t * cpattern = sensor_pattern_compile(m_sctx, pattern, flags);
+
+        if (cpattern == nullptr || sensor_watch_add_compiled(m_sctx, cpattern, &props)
+                                   != SENSOR_SUCCESS) {
+            sensor_pattern_free(cpattern);
+            return watch();
+        }
+        return watch(m_sctx, cpattern);
+    }
+
+    /** sensor_update_fill(), see update_batch */
+    sensor_status_t         update_fill(update_batch & batch,
+                                        const struct timeval * now = nullptr) noexcept {
+        return sensor_update_fill(m_sctx, now, batch.get());
+    }
+    sensor_status_t         snapshot_take(snapshot & snap) noexcept {
+        return sensor_snapshot_take(m_sctx, snap.get());
+    }
+
+    long                    next_timeout(const struct timeval * now = nullptr) noexcept {
+        return sensor_update_next_timeout(m_sctx, now);
+    }
+    int                     fd() noexcept { return sensor_update_fd(m_sctx); }
+    sensor_status_t         wait(long timeout_ms) noexcept { return sensor_update_wait(m_sctx, timeout_ms); }
+    uint64_t                now_ns() const noexcept {
+        uint64_t now = 0;
+        sensor_now_ns(m_sctx, &now);
+        return now;
+    }
+
+    /**
+     * sensor_dispatch_start() delivering each batch as a span to f, called as
+     * f(std::span<const sensor_dispatch_event_t>, unsigned long dropped).
+     * f is not copied and must outlive the dispatcher (dispatch_stop() or ~context()).
+     */
+    template <typename F>
+    sensor_status_t         dispatch_start(unsigned int capacity, sensor_dispatch_overflow_t overflow,
+                                           F & f) noexcept {
+        return sensor_dispatch_start(m_sctx, capacity, overflow, &dispatch_trampoline<F>, &f);
+    }
+    sensor_status_t         dispatch_stop() noexcept { return sensor_dispatch_stop(m_sctx); }
+
+private:
+    template <typename F>
+    static void             dispatch_trampoline(sensor_ctx_t *, const sensor_dispatch_event_t * events,
+                                                unsigned int n_events, unsigned long dropped,
+                                                void * user_data) {
+        (*static_cast<F *>(user_data))(std::span<const sensor_dispatch_event_t>(events, n_events),
+                                       dropped);
+    }
+
+    sensor_ctx_t *          m_sctx;
+};
+
+/** scoped sensor_lock()/sensor_unlock() */
+class scoped_lock {
+public:
+    scoped_lock(context & sctx, sensor_lock_type_t type) noexcept
+        : m_sctx(sctx.get()), m_locked(sensor_lock(m_sctx, type) == SENSOR_SUCCESS) {}
+    ~scoped_lock() {
+        if (m_locked)
+            sensor_unlock(m_sctx);
+    }
+    scoped_lock(const scoped_lock &) = delete;
+    scoped_lock & operator=(const scoped_lock &) = delete;
+
+    explicit operator bool() const noexcept { return m_locked; }
+
+private:
+    sensor_ctx_t *          m_sctx;
+    bool                    m_locked;
+};
+
+} /* namespace vsensors */
+
+#endif /* ! LIBVSENSORS_SENSOR_HPP */
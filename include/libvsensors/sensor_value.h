@@ -200,6 +200,44 @@ typedef struct {
 #define GET_SENSOR_VALUE_STRING     b.buf
 #define GET_SENSOR_VALUE_NULL       b.buf
 
+/**
+ * X-macro table of scalar types: X(<SENSOR_VALUE_ suffix>, <name>, <toint conversion>),
+ * generating the typed operations sensor_value_<op>_<name>() declared below.
+ * toint conversion: INT (plain cast), UMAX (unsigned, EOVERFLOW above INTMAX_MAX)
+ * or LDOUBLE (EOVERFLOW/ERANGE out of intmax_t), as sensor_value_toint().
+ */
+#define SENSOR_VALUE_SCALARS_X(X)   \
+    X(UCHAR,    uchar,      INT)    \
+    X(CHAR,     char,       INT)    \
+    X(UINT16,   uint16,     INT)    \
+    X(INT16,    int16,      INT)    \
+    X(UINT32,   uint32,     INT)    \
+    X(INT32,    int32,      INT)    \
+    X(UINT,     uint,       INT)    \
+    X(INT,      int,        INT)    \
+    X(ULONG,    ulong,      UMAX)   \
+    X(LONG,     long,       INT)    \
+    X(FLOAT,    float,      INT)    \
+    X(DOUBLE,   double,     INT)    \
+    X(LDOUBLE,  ldouble,    LDOUBLE)\
+    X(UINT64,   uint64,     UMAX)   \
+    X(INT64,    int64,      INT)
+
+/**
+ * Type: operations on values of one type, without switch on the type.
+ * Given by sensor_value_ops(), and bound to sensor_desc_t.ops when the sensor is
+ * listed: families and the update loop can call desc->ops->fromraw(), ...
+ * Each operation has the semantics of the generic sensor_value_<op>() one,
+ * for values of the bound type only.
+ */
+typedef struct sensor_value_ops_s {
+    sensor_value_type_t type;
+    sensor_status_t     (*fromraw)(const void * src, sensor_value_t * value);
+    int                 (*equal)(const sensor_value_t * v1, const sensor_value_t * v2);
+    long double         (*todouble)(const sensor_value_t * value);
+    intmax_t            (*toint)(const sensor_value_t * value);
+} sensor_value_ops_t;
+
 /* ************************************************************************ */
 #ifdef __cplusplus
 extern "C" {
@@ -220,8 +258,7 @@ const char *    sensor_value_type_name(sensor_value_type_t type);
  * value.data.b.buf must point to a valid buffer of max size value->data.b.maxsize.
  * @notes: for the type SENSOR_VALUE_BYTES, value->data.b.size must be set
  * to the desired amount of bytes to copy from src, before calling this function.
- * @return SENSOR_SUCCESS on successful operation without knowing if value was changed
- *         SENSOR_UPDATED, if the value changed
+ * @return SENSOR_UPDATED, if the value changed
  *         SENSOR_UNCHANGED, if the value was not changed
  *         SENSOR_ERROR on error.
  */
@@ -248,6 +285,12 @@ sensor_status_t sensor_value_frombuffer(const char * src, unsigned int size,
  *         * -1 or negative value on error */
 int             sensor_value_tostring(const sensor_value_t * value, char *dst, size_t maxlen);
 
+/** Put n sensor values into a string, separated by sep (can be NULL)
+ * @param maxlen behaves as sensor_value_tostring(), dst always 0 terminated
+ * @return the length of result string, or -1 on error. */
+int             sensor_values_tostring_n(const sensor_value_t * values, size_t n,
+                                         const char * sep, char * dst, size_t maxlen);
+
 /** convert a sensor value to greatest floating point type */
 long double     sensor_value_todouble(const sensor_value_t * value);
 
@@ -274,6 +317,53 @@ int             sensor_value_compare(const sensor_value_t * v1, const sensor_val
  * @return SENSOR_SUCCESS if ok or SENSOR_ERROR on error. */
 sensor_status_t sensor_value_copy(sensor_value_t * dst, const sensor_value_t * src);
 
+/* ************************************************************************
+ * SENSOR_VALUE typed operations, see SENSOR_VALUE_SCALARS_X
+ * ************************************************************************ */
+
+/** typed operations of type: the generic functions for buffers, SENSOR_VALUE_NULL
+ * and invalid types (with .type SENSOR_VALUE_NB for the latter). Never NULL. */
+const sensor_value_ops_t *  sensor_value_ops(sensor_value_type_t type);
+
+#define SENSOR_VALUE_OPS_DECLARE(_type, _name, _toint)                                    \
+    sensor_status_t sensor_value_fromraw_##_name(const void * src, sensor_value_t * value);  \
+    int             sensor_value_equal_##_name(const sensor_value_t * v1,                     \
+                                               const sensor_value_t * v2);                    \
+    long double     sensor_value_todouble_##_name(const sensor_value_t * value);              \
+    intmax_t        sensor_value_toint_##_name(const sensor_value_t * value);
+SENSOR_VALUE_SCALARS_X(SENSOR_VALUE_OPS_DECLARE)
+
+/* ************************************************************************
+ * SENSOR_VALUES : batch comparisons and copies
+ * ************************************************************************ */
+
+/** size of the scalar of given type (eg: sizeof(uint16_t) for SENSOR_VALUE_UINT16),
+ * or 0 for SENSOR_VALUE_NULL, buffers and invalid types */
+size_t          sensor_value_type_size(sensor_value_type_t type);
+
+/**
+ * Compare two compact arrays of n scalars of the same type, each one being
+ * stored as its TYPE_SENSOR_VALUE_<type> (eg: uint64_t[] for SENSOR_VALUE_UINT64).
+ * The loop has no branch, and it is vectorized by the compiler.
+ * @param equal if not NULL, equal[i] is set to 1 if a[i] == b[i], 0 otherwise.
+ * @return the number of equal elements, 0 for buffers or invalid types.
+ */
+size_t          sensor_scalars_equal_n(sensor_value_type_t type, const void * a, const void * b,
+                                       size_t n, unsigned char * equal);
+
+/**
+ * sensor_value_equal() on n pairs (v1[i], v2[i]): the type is switched once per
+ * run of same-typed values instead of once per value.
+ * @param equal if not NULL, equal[i] is set as sensor_value_equal(&v1[i], &v2[i]) != 0.
+ * @return the number of equal pairs.
+ */
+size_t          sensor_values_equal_n(const sensor_value_t * v1, const sensor_value_t * v2,
+                                      size_t n, unsigned char * equal);
+
+/** sensor_value_copy() of the n values of src to dst, see sensor_value_copy() for buffers.
+ * @return the number of copied values. */
+size_t          sensor_values_copy_n(sensor_value_t * dst, const sensor_value_t * src, size_t n);
+
 /* ************************************************************************ */
 #ifdef __cplusplus
 }
@@ -0,0 +1,557 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * cgroup v2 monitoring - Generic Sensor Management Library.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <errno.h>
+#include <fnmatch.h>
+
+#include "vlib/util.h"
+
+#include "cgroup_private.h"
+
+/** sensors of a cgroup: file read, type and field of cgroupinfo_t */
+static const struct {
+    cgroup_file_t           file;
+    sensor_value_type_t     type;
+    size_t                  offset;
+    const char *            label;
+} s_cgroup_sensors[CGROUP_SENSOR_NB] = {
+    { CGROUP_FILE_CPU_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, cpu_usage), "cpu usage usec" },
+    { CGROUP_FILE_CPU_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, cpu_user), "cpu user usec" },
+    { CGROUP_FILE_CPU_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, cpu_system), "cpu system usec" },
+    { CGROUP_FILE_CPU_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, cpu_throttled), "cpu throttled usec" },
+    { CGROUP_FILE_CPU_STAT, SENSOR_VALUE_DOUBLE, offsetof(cgroupinfo_t, cpu_percent), "cpu %" },
+    { CGROUP_FILE_MEMORY_CURRENT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, memory_current), "memory current" },
+    { CGROUP_FILE_MEMORY_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, memory_anon), "memory anon" },
+    { CGROUP_FILE_MEMORY_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, memory_file), "memory file" },
+    { CGROUP_FILE_IO_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, io_rbytes), "io read bytes" },
+    { CGROUP_FILE_IO_STAT, SENSOR_VALUE_UINT64, offsetof(cgroupinfo_t, io_wbytes), "io written bytes" },
+    { CGROUP_FILE_CPU_PRESSURE, SENSOR_VALUE_DOUBLE, offsetof(cgroupinfo_t, cpu_pressure), "cpu pressure %" },
+    { CGROUP_FILE_MEMORY_PRESSURE, SENSOR_VALUE_DOUBLE, offsetof(cgroupinfo_t, memory_pressure),
+      "memory pressure %" },
+    { CGROUP_FILE_MEMORY_PRESSURE, SENSOR_VALUE_DOUBLE, offsetof(cgroupinfo_t, memory_pressure_full),
+      "memory pressure full %" },
+};
+
+/* ************************************************************************ */
+static void cgroup_info_free(void * vinfo) {
+    cgroupinfo_t * info = (cgroupinfo_t *) vinfo;
+
+    if (info != NULL) {
+        sysdep_cgroup_info_free(info);
+        for (unsigned int i = 0; i < CGROUP_SENSOR_NB; ++i) {
+            if (info->descs[i].label != NULL)
+                free((void *) info->descs[i].label);
+        }
+        if (info->path != NULL)
+            free(info->path);
+        free(info);
+    }
+}
+
+/* ************************************************************************ */
+/** family-specific free */
+static sensor_status_t family_free(sensor_family_t *family) {
+    if (family->priv != NULL) {
+        cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+
+        /* no more discovery from the common thread before cgroups are freed */
+        sysdep_cgroup_destroy(family);
+
+        slist_free(priv->cgroups, cgroup_info_free);
+        slist_free(priv->added, cgroup_info_free);
+        slist_free(priv->dropped, cgroup_info_free);
+        slist_free(priv->filters, free);
+
+        pthread_mutex_destroy(&priv->mutex);
+        family->priv = NULL;
+        free(priv);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family private data creation: filters of CGROUP_FILTERS_ENV, then discovery */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+    const char *    env = getenv(CGROUP_FILTERS_ENV);
+    char *          filters, * filter, * saveptr = NULL;
+
+    if (pthread_mutex_init(&priv->mutex, NULL) != 0) {
+        return SENSOR_ERROR;
+    }
+    if ((filters = strdup(env != NULL ? env : CGROUP_FILTERS_DEFAULT)) == NULL) {
+        return SENSOR_ERROR;
+    }
+    for (filter = strtok_r(filters, ":", &saveptr); filter != NULL; filter = strtok_r(NULL, ":", &saveptr)) {
+        unsigned int    depth = 1;
+        char *          dup;
+
+        while (*filter == '/')
+            ++filter;
+        if (*filter == 0 || (dup = strdup(filter)) == NULL)
+            continue ;
+        for (const char * s = dup; (s = strchr(s, '/')) != NULL; ++s)
+            ++depth;
+        if (depth > priv->max_depth)
+            priv->max_depth = depth;
+        priv->filters = slist_prepend(priv->filters, dup);
+        LOG_VERBOSE(family->log, "cgroup filter '%s'", dup);
+    }
+    free(filters);
+
+    if (priv->filters == NULL) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    return sysdep_cgroup_init(family);
+}
+
+/* ************************************************************************ */
+/** family-specific init */
+static sensor_status_t family_init(sensor_family_t *family) {
+    sensor_status_t ret;
+
+    // Sanity checks done before in sensor_init()
+    if (family->priv != NULL) {
+        LOG_ERROR(family->log, "error: %s data already initialized", family->info->name);
+        return SENSOR_ERROR;
+    }
+    if (sysdep_cgroup_support(family, NULL) != SENSOR_SUCCESS) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if ((family->priv = calloc(1, sizeof(cgroup_priv_t))) == NULL) {
+        LOG_ERROR(family->log, "cannot allocate private %s data", family->info->name);
+        return SENSOR_ERROR;
+    }
+    if ((ret = init_private_data(family)) != SENSOR_SUCCESS) {
+        if (ret != SENSOR_NOT_SUPPORTED)
+            LOG_ERROR(family->log, "cannot initialize private %s data", family->info->name);
+        family_free(family);
+        return ret;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the descs of a cgroup listed the first time, for the files it has */
+static void cgroup_init_descs(sensor_family_t * family, cgroupinfo_t * info) {
+    unsigned int has_file = 0;
+
+    for (unsigned int i = 0; i < CGROUP_FILE_NB; ++i) {
+        if (sysdep_cgroup_has_file(family, info, i) == SENSOR_SUCCESS)
+            has_file |= 1U << i;
+    }
+    for (unsigned int i = 0; i < CGROUP_SENSOR_NB; ++i) {
+        sensor_desc_t * desc = &(info->descs[i]);
+        char *          label;
+
+        if ((has_file & (1U << s_cgroup_sensors[i].file)) == 0
+        ||  asprintf(&label, "cgroup %s %s", info->path, s_cgroup_sensors[i].label) < 0) {
+            continue ;
+        }
+        desc->label = label;
+        desc->type = s_cgroup_sensors[i].type;
+        desc->family = family;
+        desc->key = info;
+        desc->properties = NULL;
+    }
+}
+
+/* ************************************************************************ */
+/** prepend the descs of a cgroup to list */
+static slist_t * cgroup_list_descs(cgroupinfo_t * info, slist_t * list) {
+    for (unsigned int i = 0; i < CGROUP_SENSOR_NB; ++i) {
+        if (info->descs[i].label != NULL)
+            list = slist_prepend(list, &(info->descs[i]));
+    }
+    return list;
+}
+
+/* ************************************************************************ */
+/** move the discovered cgroups to the listed ones, under priv->mutex.
+ * Returns list with the descs of new cgroups prepended. */
+static slist_t * cgroup_take_added(sensor_family_t * family, slist_t * list) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+
+    while (priv->added != NULL) {
+        slist_t *       node = priv->added;
+        cgroupinfo_t *  info = (cgroupinfo_t *) node->data;
+
+        priv->added = node->next;
+        cgroup_init_descs(family, info);
+        list = cgroup_list_descs(info, list);
+        node->next = priv->cgroups;
+        priv->cgroups = node;
+    }
+    return list;
+}
+
+/* ************************************************************************ */
+/** family-specific list */
+static slist_t * family_list(sensor_family_t *family) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+    slist_t *       list = NULL;
+
+    pthread_mutex_lock(&priv->mutex);
+    /* descs of cgroups dropped by previous list have been released */
+    slist_free(priv->dropped, cgroup_info_free);
+    priv->dropped = NULL;
+    for (slist_t * node = priv->cgroups, * prev = NULL; node != NULL; /* no_incr */) {
+        cgroupinfo_t * info = (cgroupinfo_t *) node->data;
+
+        if ((info->flags & CGF_REMOVED) != 0) {
+            slist_t * to_drop = node;
+
+            /* its descs are listed until libvsensors replaces them */
+            node = node->next;
+            if (prev == NULL)
+                priv->cgroups = node;
+            else
+                prev->next = node;
+            to_drop->next = priv->dropped;
+            priv->dropped = to_drop;
+            continue ;
+        }
+        list = cgroup_list_descs(info, list);
+        prev = node;
+        node = node->next;
+    }
+    list = cgroup_take_added(family, list);
+    __atomic_store_n(&(priv->changed), 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&priv->mutex);
+
+    return list;
+}
+
+/* ************************************************************************ */
+/** family-specific list_delta: descs of created and removed cgroups */
+static sensor_status_t family_list_delta(sensor_family_t *family,
+                                         slist_t ** p_added, slist_t ** p_removed) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+
+    pthread_mutex_lock(&priv->mutex);
+    /* descs of cgroups dropped by previous delta have been released */
+    slist_free(priv->dropped, cgroup_info_free);
+    priv->dropped = NULL;
+    for (slist_t * node = priv->cgroups, * prev = NULL; node != NULL; /* no_incr */) {
+        cgroupinfo_t * info = (cgroupinfo_t *) node->data;
+
+        if ((info->flags & CGF_REMOVED) != 0) {
+            slist_t * to_drop = node;
+
+            node = node->next;
+            if (prev == NULL)
+                priv->cgroups = node;
+            else
+                prev->next = node;
+            *p_removed = cgroup_list_descs(info, *p_removed);
+            to_drop->next = priv->dropped;
+            priv->dropped = to_drop;
+            continue ;
+        }
+        prev = node;
+        node = node->next;
+    }
+    *p_added = cgroup_take_added(family, *p_added);
+    __atomic_store_n(&(priv->changed), 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&priv->mutex);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** value of a pressure line "<kind> avg10=<pct> avg60=..." */
+static double cgroup_parse_pressure(const char * buf, const char * kind) {
+    size_t len = strlen(kind);
+
+    for (const char * line = buf; line != NULL && *line != 0; ) {
+        if (strncmp(line, kind, len) == 0 && strncmp(line + len, " avg10=", 7) == 0) {
+            return strtod(line + len + 7, NULL);
+        }
+        if ((line = strchr(line, '\n')) != NULL)
+            ++line;
+    }
+    return 0.0;
+}
+
+/* ************************************************************************ */
+/** parse in place a flat keyed file ("<key> <value>" lines) */
+static void cgroup_parse_keyed(const char * buf, const char * const * keys,
+                               TYPE_SENSOR_VALUE_UINT64 * const * values, unsigned int nb) {
+    for (const char * line = buf; line != NULL && *line != 0; ) {
+        for (unsigned int i = 0; i < nb; ++i) {
+            size_t len = strlen(keys[i]);
+
+            if (strncmp(line, keys[i], len) == 0 && line[len] == ' ') {
+                *(values[i]) = strtoull(line + len + 1, NULL, 10);
+                break ;
+            }
+        }
+        if ((line = strchr(line, '\n')) != NULL)
+            ++line;
+    }
+}
+
+/* ************************************************************************ */
+/** read and parse a file of the cgroup, once per update time */
+static sensor_status_t cgroup_read(sensor_family_t * family, cgroupinfo_t * info,
+                                   cgroup_file_t file, const struct timeval * now) {
+    char        buf[CGROUP_FILE_BUFSZ];
+    ssize_t     n;
+
+    if (now != NULL && timercmp(now, &(info->read_time[file]), ==)) {
+        return SENSOR_SUCCESS;
+    }
+    if ((n = sysdep_cgroup_read(family, info, file, buf, sizeof(buf))) < 0) {
+        return SENSOR_ERROR;
+    }
+    if (now != NULL) {
+        info->read_time[file] = *now;
+    } else {
+        timerclear(&(info->read_time[file]));
+    }
+
+    switch (file) {
+        case CGROUP_FILE_CPU_STAT: {
+            static const char * const   keys[] = { "usage_usec", "user_usec", "system_usec", "throttled_usec" };
+            TYPE_SENSOR_VALUE_UINT64 *  values[] = { &info->cpu_usage, &info->cpu_user,
+                                                     &info->cpu_system, &info->cpu_throttled };
+            uint64_t                    now_ns;
+
+            cgroup_parse_keyed(buf, keys, values, PTR_COUNT(keys));
+            if (sensor_now_ns(family->sctx, &now_ns) == SENSOR_SUCCESS
+            &&  sensor_rate_update(&(info->cpu_rate), &g_sensor_rate_conf64,
+                                   info->cpu_usage, now_ns) == SENSOR_SUCCESS) {
+                /* usec per second */
+                info->cpu_percent = info->cpu_rate.rate / 10000.0;
+            }
+            break ;
+        }
+        case CGROUP_FILE_MEMORY_CURRENT:
+            info->memory_current = strtoull(buf, NULL, 10);
+            break ;
+        case CGROUP_FILE_MEMORY_STAT: {
+            static const char * const   keys[] = { "anon", "file" };
+            TYPE_SENSOR_VALUE_UINT64 *  values[] = { &info->memory_anon, &info->memory_file };
+
+            cgroup_parse_keyed(buf, keys, values, PTR_COUNT(keys));
+            break ;
+        }
+        case CGROUP_FILE_IO_STAT: {
+            /* "<major>:<minor> rbytes=<n> wbytes=<n> rios=<n> ..." per device */
+            uint64_t rbytes = 0, wbytes = 0;
+
+            for (const char * line = buf; line != NULL && *line != 0; ) {
+                const char * s;
+
+                if ((s = strstr(line, " rbytes=")) != NULL)
+                    rbytes += strtoull(s + 8, NULL, 10);
+                if ((s = strstr(line, " wbytes=")) != NULL)
+                    wbytes += strtoull(s + 8, NULL, 10);
+                if ((line = strchr(line, '\n')) != NULL)
+                    ++line;
+            }
+            info->io_rbytes = rbytes;
+            info->io_wbytes = wbytes;
+            break ;
+        }
+        case CGROUP_FILE_CPU_PRESSURE:
+            info->cpu_pressure = cgroup_parse_pressure(buf, "some");
+            break ;
+        case CGROUP_FILE_MEMORY_PRESSURE:
+            info->memory_pressure = cgroup_parse_pressure(buf, "some");
+            info->memory_pressure_full = cgroup_parse_pressure(buf, "full");
+            break ;
+        default:
+            return SENSOR_ERROR;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family-specific update: a file is read once for all the sensors of a same
+ * update time */
+static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
+    /* Sanity checks are done in sensor_init and sensor_update_check() */
+    cgroup_priv_t * priv = (cgroup_priv_t *) sensor->desc->family->priv;
+    cgroupinfo_t *  info = (cgroupinfo_t *) sensor->desc->key;
+    unsigned int    i_sensor = sensor->desc - info->descs;
+
+    /* cgroups were created or removed */
+    if (__atomic_load_n(&(priv->changed), __ATOMIC_ACQUIRE) != 0) {
+        return SENSOR_RELOAD_FAMILY;
+    }
+    if (cgroup_read(sensor->desc->family, info, s_cgroup_sensors[i_sensor].file, now)
+            != SENSOR_SUCCESS) {
+        return SENSOR_ERROR;
+    }
+    return SENSOR_DESC_FROMRAW(sensor->desc, (char *) info + s_cgroup_sensors[i_sensor].offset,
+                               &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    struct timeval  tv;
+
+    /* a same time for all samples: each file is read once */
+    if (now == NULL) {
+        if (gettimeofday(&tv, NULL) != 0)
+            timerclear(&tv);
+        now = &tv;
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        results[i] = family_update(samples[i], now);
+    }
+    (void) family;
+    return SENSOR_SUCCESS;
+}
+
+// ***************************************************************************
+const sensor_family_info_t g_sensor_family_cgroup = {
+    .name = "cgroup",
+    .init = family_init,
+    .free = family_free,
+    .update = family_update,
+    .list = family_list,
+    .notify = NULL,
+    .write = NULL,
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch,
+    .list_delta = family_list_delta
+};
+
+/* ************************************************************************ */
+int cgroup_filter_match(cgroup_priv_t * priv, const char * path,
+                        unsigned int depth, int b_prefix) {
+    SLIST_FOREACH_DATA(priv->filters, filter, const char *) {
+        char            prefix[PATH_MAX];
+        const char *    end = filter;
+        unsigned int    i;
+
+        if (!b_prefix) {
+            if (fnmatch(filter, path, FNM_PATHNAME) == 0)
+                return 1;
+            continue ;
+        }
+        /* first depth components of filter, which must have more */
+        for (i = 0; i < depth && (end = strchr(end, '/')) != NULL; ++i)
+            ++end;
+        if (i < depth || (size_t) (end - filter) > sizeof(prefix))
+            continue ;
+        memcpy(prefix, filter, end - filter - 1);
+        prefix[end - filter - 1] = 0;
+        if (fnmatch(prefix, path, FNM_PATHNAME) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+/** forget the discovered cgroups of path and its sub-cgroups, or with a NULL path,
+ * the ones not found by the current scan, under priv->mutex */
+static void cgroup_added_drop(cgroup_priv_t * priv, const char * path, size_t len) {
+    for (slist_t * node = priv->added, * prev = NULL; node != NULL; /* no_incr */) {
+        cgroupinfo_t * info = (cgroupinfo_t *) node->data;
+
+        if (path == NULL ? info->scan_gen != priv->scan_gen
+                         : (strncmp(info->path, path, len) == 0
+                            && (info->path[len] == 0 || info->path[len] == '/'))) {
+            slist_t * to_free = node;
+
+            node = node->next;
+            if (prev == NULL)
+                priv->added = node;
+            else
+                prev->next = node;
+            slist_free_1(to_free, cgroup_info_free);
+            continue ;
+        }
+        prev = node;
+        node = node->next;
+    }
+}
+
+/* ************************************************************************ */
+void cgroup_found(sensor_family_t * family, const char * path, unsigned int depth) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+    cgroupinfo_t *  info;
+
+    if (!cgroup_filter_match(priv, path, depth, 0)) {
+        return ;
+    }
+    for (unsigned int i = 0; i < 2; ++i) {
+        SLIST_FOREACH_DATA(i == 0 ? priv->cgroups : priv->added, known, cgroupinfo_t *) {
+            if ((known->flags & CGF_REMOVED) == 0 && strcmp(known->path, path) == 0) {
+                known->scan_gen = priv->scan_gen;
+                return ;
+            }
+        }
+    }
+    if ((info = calloc(1, sizeof(*info))) == NULL || (info->path = strdup(path)) == NULL) {
+        LOG_WARN(family->log, "cannot allocate cgroup %s: %s", path, strerror(errno));
+        if (info != NULL)
+            free(info);
+        return ;
+    }
+    info->scan_gen = priv->scan_gen;
+    priv->added = slist_prepend(priv->added, info);
+    __atomic_store_n(&(priv->changed), 1, __ATOMIC_RELEASE);
+    LOG_VERBOSE(family->log, "cgroup %s found", path);
+}
+
+/* ************************************************************************ */
+void cgroup_lost(sensor_family_t * family, const char * path) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+    size_t          len = strlen(path);
+
+    SLIST_FOREACH_DATA(priv->cgroups, info, cgroupinfo_t *) {
+        if ((info->flags & CGF_REMOVED) == 0 && strncmp(info->path, path, len) == 0
+        &&  (info->path[len] == 0 || info->path[len] == '/')) {
+            LOG_VERBOSE(family->log, "cgroup %s removed", info->path);
+            info->flags |= CGF_REMOVED;
+            __atomic_store_n(&(priv->changed), 1, __ATOMIC_RELEASE);
+        }
+    }
+    /* not listed yet: forget it */
+    cgroup_added_drop(priv, path, len);
+}
+
+/* ************************************************************************ */
+void cgroup_scan_end(sensor_family_t * family) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+
+    SLIST_FOREACH_DATA(priv->cgroups, info, cgroupinfo_t *) {
+        if ((info->flags & CGF_REMOVED) == 0 && info->scan_gen != priv->scan_gen) {
+            LOG_VERBOSE(family->log, "cgroup %s not found", info->path);
+            info->flags |= CGF_REMOVED;
+            __atomic_store_n(&(priv->changed), 1, __ATOMIC_RELEASE);
+        }
+    }
+    cgroup_added_drop(priv, NULL, 0);
+}
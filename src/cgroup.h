@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * cgroup v2 sensors for Generic Sensor Management Library.
+ */
+#ifndef SENSOR_CGROUP_H
+#define SENSOR_CGROUP_H
+
+#include "libvsensors/sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const sensor_family_info_t g_sensor_family_cgroup;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Generic Sensor Management Library.
+ */
+#ifndef SENSOR_CGROUP_PRIVATE_H
+#define SENSOR_CGROUP_PRIVATE_H
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "vlib/slist.h"
+
+#include "cgroup.h"
+#include "sensor_rate.h"
+
+/** glob filters of the cgroup paths getting sensors, relative to the cgroup root and
+ * separated by ':'. '*' does not match '/': "system.slice/docker-*.scope:kubepods.slice" */
+#define CGROUP_FILTERS_ENV      "VSENSORS_CGROUPS"
+/** default filters: the top level cgroups */
+#define CGROUP_FILTERS_DEFAULT  "*"
+
+/** maximum size of a cgroup stat file read at once */
+#define CGROUP_FILE_BUFSZ       8192
+
+/** cgroup files read by the family, kept opened once read */
+typedef enum {
+    CGROUP_FILE_CPU_STAT = 0,
+    CGROUP_FILE_MEMORY_CURRENT,
+    CGROUP_FILE_MEMORY_STAT,
+    CGROUP_FILE_IO_STAT,
+    CGROUP_FILE_CPU_PRESSURE,
+    CGROUP_FILE_MEMORY_PRESSURE,
+    CGROUP_FILE_NB
+} cgroup_file_t;
+
+/** sensors of a cgroup */
+typedef enum {
+    CGROUP_SENSOR_CPU_USAGE = 0,
+    CGROUP_SENSOR_CPU_USER,
+    CGROUP_SENSOR_CPU_SYSTEM,
+    CGROUP_SENSOR_CPU_THROTTLED,
+    CGROUP_SENSOR_CPU_PERCENT,
+    CGROUP_SENSOR_MEMORY_CURRENT,
+    CGROUP_SENSOR_MEMORY_ANON,
+    CGROUP_SENSOR_MEMORY_FILE,
+    CGROUP_SENSOR_IO_RBYTES,
+    CGROUP_SENSOR_IO_WBYTES,
+    CGROUP_SENSOR_CPU_PRESSURE,
+    CGROUP_SENSOR_MEMORY_PRESSURE,
+    CGROUP_SENSOR_MEMORY_PRESSURE_FULL,
+    CGROUP_SENSOR_NB
+} cgroup_sensor_t;
+
+/** cgroupinfo_t flags */
+typedef enum {
+    CGF_NONE        = 0,
+    CGF_REMOVED     = 1 << 0,   /* directory removed, descs to be unlisted */
+} cgroup_flag_t;
+
+/** per cgroup info */
+typedef struct {
+    char *                      path;       /* relative to the cgroup root */
+    /* written by the sysdep discovery under cgroup_priv_t.mutex */
+    unsigned int                flags;
+    unsigned int                scan_gen;
+    /* family side */
+    sensor_desc_t               descs[CGROUP_SENSOR_NB];
+    struct timeval              read_time[CGROUP_FILE_NB];
+    TYPE_SENSOR_VALUE_UINT64    cpu_usage;          /* usec */
+    TYPE_SENSOR_VALUE_UINT64    cpu_user;
+    TYPE_SENSOR_VALUE_UINT64    cpu_system;
+    TYPE_SENSOR_VALUE_UINT64    cpu_throttled;
+    TYPE_SENSOR_VALUE_DOUBLE    cpu_percent;        /* of one cpu */
+    TYPE_SENSOR_VALUE_UINT64    memory_current;     /* bytes */
+    TYPE_SENSOR_VALUE_UINT64    memory_anon;
+    TYPE_SENSOR_VALUE_UINT64    memory_file;
+    TYPE_SENSOR_VALUE_UINT64    io_rbytes;          /* sum of devices */
+    TYPE_SENSOR_VALUE_UINT64    io_wbytes;
+    TYPE_SENSOR_VALUE_DOUBLE    cpu_pressure;       /* some avg10, % */
+    TYPE_SENSOR_VALUE_DOUBLE    memory_pressure;    /* some avg10, % */
+    TYPE_SENSOR_VALUE_DOUBLE    memory_pressure_full;
+    sensor_rate_t               cpu_rate;
+    void *                      sysdep;
+} cgroupinfo_t;
+
+/** private/specific cgroup family structure */
+typedef struct {
+    slist_t *       filters;    /* of char *, see CGROUP_FILTERS_ENV */
+    unsigned int    max_depth;  /* maximum number of path components of filters */
+    /* under mutex: listed cgroups, and the ones discovered since last listing */
+    pthread_mutex_t mutex;
+    slist_t *       cgroups;    /* of cgroupinfo_t * */
+    slist_t *       added;      /* of cgroupinfo_t * */
+    unsigned int    scan_gen;
+    int             changed;    /* read without lock, set by the sysdep */
+    /* cgroups unlisted by the last list() or list_delta(), freed on the next reload */
+    slist_t *       dropped;
+    void *          sysdep;
+} cgroup_priv_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* family side, called by the sysdep under cgroup_priv_t.mutex */
+/** return 1 if path (depth components) is matched by a filter, or with b_prefix,
+ * if it is the parent of paths which can be matched */
+int             cgroup_filter_match(cgroup_priv_t * priv, const char * path,
+                                    unsigned int depth, int b_prefix);
+/** a cgroup directory was found, it is added if it is matched and not known yet */
+void            cgroup_found(sensor_family_t * family, const char * path, unsigned int depth);
+/** a cgroup directory was removed, with its sub-cgroups */
+void            cgroup_lost(sensor_family_t * family, const char * path);
+/** end of a whole scan started with ++scan_gen: cgroups not found are removed */
+void            cgroup_scan_end(sensor_family_t * family);
+
+sensor_status_t sysdep_cgroup_support(sensor_family_t * family, const char * label);
+sensor_status_t sysdep_cgroup_init(sensor_family_t * family);
+sensor_status_t sysdep_cgroup_destroy(sensor_family_t * family);
+void            sysdep_cgroup_info_free(cgroupinfo_t * info);
+/** check that a file of the cgroup can be read */
+sensor_status_t sysdep_cgroup_has_file(sensor_family_t * family, cgroupinfo_t * info,
+                                       cgroup_file_t file);
+/** read a file of the cgroup from its start, with a 0 terminator, -1 on error */
+ssize_t         sysdep_cgroup_read(sensor_family_t * family, cgroupinfo_t * info,
+                                   cgroup_file_t file, char * buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifdef SENSOR_CGROUP_PRIVATE_H
@@ -44,6 +44,69 @@ static void common_event_free(void * vevent) {
     }
 }
 
+/** move the events of the ring at the end of the consumer event_queue.
+ * consumer only, under priv->mutex or at free. */
+static void common_queue_drain_ring(common_priv_t * priv) {
+    slist_t *   elt;
+
+    while (1) {
+        common_queue_cell_t *   cell = &(priv->ring[priv->ring_tail & (COMMON_QUEUE_SIZE - 1)]);
+        sensor_common_event_t * event;
+
+        if (__atomic_load_n(&(cell->seq), __ATOMIC_ACQUIRE) != priv->ring_tail + 1)
+            break ; /* empty */
+        event = cell->event;
+        __atomic_store_n(&(cell->seq), priv->ring_tail + COMMON_QUEUE_SIZE, __ATOMIC_RELEASE);
+        ++(priv->ring_tail);
+
+        if ((elt = slist_prepend(NULL, event)) == NULL) {
+            common_event_free(event);
+            continue ;
+        }
+        if (priv->event_queue == NULL) {
+            priv->event_queue = elt;
+        } else {
+            priv->event_queue_last->next = elt;
+        }
+        priv->event_queue_last = elt;
+    }
+}
+
+/** move the events of the ring, then of the overflow list, at the end of
+ * the consumer event_queue. consumer only, under priv->mutex. */
+static void common_queue_drain(common_priv_t * priv) {
+    slist_t *   overflow;
+    slist_t *   elt;
+
+    common_queue_drain_ring(priv);
+
+    /* producers use the overflow list while it is not empty, to keep order */
+    pthread_mutex_lock(&priv->overflow_mutex);
+    overflow = priv->overflow;
+    priv->overflow = NULL;
+    __atomic_store_n(&(priv->overflow_used), 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&priv->overflow_mutex);
+
+    if (overflow != NULL) {
+        slist_t * rev = NULL, * next;
+
+        /* the overflow list was prepended to, restore the event order */
+        for (; overflow != NULL; overflow = next) {
+            next = overflow->next;
+            overflow->next = rev;
+            rev = overflow;
+        }
+        if (priv->event_queue == NULL) {
+            priv->event_queue = rev;
+        } else {
+            priv->event_queue_last->next = rev;
+        }
+        for (elt = rev; elt->next != NULL; elt = elt->next)
+            ; /* nothing but loop */
+        priv->event_queue_last = elt;
+    }
+}
+
 /** family-specific free */
 static sensor_status_t family_free(sensor_family_t *family) {
     if (family->priv != NULL) {
@@ -54,6 +117,8 @@ static sensor_status_t family_free(sensor_family_t *family) {
         if (priv->thread != NULL) {
             vthread_stop(priv->thread);
         }
+        common_queue_drain_ring(priv);
+        slist_free(priv->overflow, common_event_free);
         slist_free(priv->event_queue, common_event_free);
 
         family->priv = NULL;
@@ -81,7 +146,11 @@ static sensor_status_t family_init(sensor_family_t *family) {
         family_free(family);
         return SENSOR_ERROR;
     }
-    if (pthread_mutex_init(&priv->mutex, NULL) != 0) {
+    for (unsigned int i = 0; i < COMMON_QUEUE_SIZE; ++i) {
+        priv->ring[i].seq = i;
+    }
+    if (pthread_mutex_init(&priv->mutex, NULL) != 0
+    ||  pthread_mutex_init(&priv->overflow_mutex, NULL) != 0) {
         LOG_ERROR(family->log, "cannot initialize the %s mutex", family->info->name);
         family_free(family);
         return SENSOR_ERROR;
@@ -109,48 +178,9 @@ const sensor_family_info_t g_sensor_family_common = {
     .free_desc = NULL
 };
 
-/** get common event queue under lock
-  * when queue is not NULL, common_queue_release() must be called */
-static sensor_common_queue_t common_queue_get(sensor_family_t * common_fam) {
-    if (common_fam != NULL && common_fam->priv != NULL) {
-        common_priv_t * priv = (common_priv_t *) common_fam->priv;
-        if (priv->event_queue != NULL) {
-            pthread_mutex_lock(&priv->mutex);
-            if (priv->event_queue == NULL) {
-                pthread_mutex_unlock(&priv->mutex);
-                return NULL;
-            }
-            return priv->event_queue;
-        }
-    }
-    return NULL;
-}
-
-/** set common event queue : (no lock done here)) */
-static sensor_status_t common_queue_set(sensor_family_t * common_fam, sensor_common_queue_t queue) {
-    if (common_fam != NULL && common_fam->priv != NULL) {
-        common_priv_t * priv = (common_priv_t *) common_fam->priv;
-
-        priv->event_queue = queue;
-        return SENSOR_SUCCESS;
-    }
-    return SENSOR_ERROR;
-}
-
-/** release common event queue given by common_queue_get() */
-static sensor_status_t common_queue_release(sensor_family_t * common_fam) {
-    if (common_fam != NULL && common_fam->priv != NULL) {
-        common_priv_t * priv = (common_priv_t *) common_fam->priv;
-        int             ret;
-
-        ret = pthread_mutex_unlock(&priv->mutex);
-        return ret == 0 ? SENSOR_SUCCESS : SENSOR_ERROR;
-    }
-    return SENSOR_ERROR;
-}
-
 /** add an event to the common event queue
- *  event must be allocated and will be freed with common_event_free() */
+ *  event must be allocated and will be freed with common_event_free().
+ *  lock-free unless the ring is full (bounded MPSC queue, D.Vyukov's algorithm) */
 sensor_status_t     sensor_common_queue_add(sensor_ctx_t * sctx, sensor_common_event_t * event) {
     sensor_family_t * common = sensor_family_common(sctx);
 
@@ -158,34 +188,73 @@ sensor_status_t     sensor_common_queue_add(sensor_ctx_t * sctx, sensor_common_e
         return SENSOR_ERROR;
     }
     common_priv_t *     priv = (common_priv_t *) common->priv;
-    sensor_status_t     ret;
+    sensor_status_t     ret = SENSOR_SUCCESS;
+    unsigned long       pos = __atomic_load_n(&(priv->ring_head), __ATOMIC_RELAXED);
 
-    pthread_mutex_lock(&priv->mutex);
-    // LOCKED
-    priv->event_queue = slist_append(priv->event_queue, event);
-    ret = priv->event_queue != NULL ? SENSOR_SUCCESS : SENSOR_ERROR;
-    // UNLOCKING
-    pthread_mutex_unlock(&priv->mutex);
+    while (__atomic_load_n(&(priv->overflow_used), __ATOMIC_ACQUIRE) == 0) {
+        common_queue_cell_t *   cell = &(priv->ring[pos & (COMMON_QUEUE_SIZE - 1)]);
+        long                    dif  = (long) (__atomic_load_n(&(cell->seq), __ATOMIC_ACQUIRE) - pos);
 
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&(priv->ring_head), &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->event = event;
+                __atomic_store_n(&(cell->seq), pos + 1, __ATOMIC_RELEASE);
+                event = NULL;
+                break ;
+            }
+        } else if (dif < 0) {
+            break ; /* ring full */
+        } else {
+            pos = __atomic_load_n(&(priv->ring_head), __ATOMIC_RELAXED);
+        }
+    }
+
+    if (event != NULL) {
+        slist_t * new;
+
+        LOG_SCREAM(common->log, "event ring full, using overflow list");
+        pthread_mutex_lock(&priv->overflow_mutex);
+        if ((new = slist_prepend(priv->overflow, event)) == NULL) {
+            ret = SENSOR_ERROR;
+        } else {
+            priv->overflow = new;
+            __atomic_store_n(&(priv->overflow_used), 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&priv->overflow_mutex);
+    }
+
+    /* wake up sensor_update_wait() / sensor_update_fd() pollers */
+    if (ret == SENSOR_SUCCESS) {
+        sensor_family_signal(common);
+    }
     return ret;
 }
 
 /** apply function to event queue events. the process function can return:
   * + SENSOR_NOT_SUPPORTED: event is skipped and kept
   * + SENSOR_ERROR: event skipped and kept, loop stopped
-  * + SENSOR_SUCCESS: event is deleted from the queue */
+  * + SENSOR_SUCCESS: event is deleted from the queue
+  * Producers are never blocked by this function. */
 sensor_status_t sensor_common_queue_process(
                     sensor_ctx_t * sctx,
                     sensor_status_t (*fun)(sensor_common_event_t * event, void * user_data),
                     void * user_data) {
     sensor_family_t *       common = sensor_family_common(sctx);
+    common_priv_t *         priv;
     sensor_common_queue_t   queue;
     sensor_status_t         ret = SENSOR_SUCCESS;
 
-    // get common queue and LOCK IT
-    queue = common_queue_get(common);
+    if (common == NULL || (priv = (common_priv_t *) common->priv) == NULL) {
+        return SENSOR_SUCCESS;
+    }
+
+    /* consumer lock, then batch drain of the ring */
+    pthread_mutex_lock(&priv->mutex);
+    common_queue_drain(priv);
 
-    if (queue == NULL) {
+    if ((queue = priv->event_queue) == NULL) {
+        pthread_mutex_unlock(&priv->mutex);
         return SENSOR_SUCCESS;
     }
 
@@ -221,8 +290,14 @@ sensor_status_t sensor_common_queue_process(
             break ;
         }
     }
-    common_queue_set(common, queue);
-    common_queue_release(common);
+    /* update the consumer queue and its last element */
+    priv->event_queue = queue;
+    for (priv->event_queue_last = queue;
+         priv->event_queue_last != NULL && priv->event_queue_last->next != NULL;
+         priv->event_queue_last = priv->event_queue_last->next)
+        ; /* nothing but loop */
+    pthread_mutex_unlock(&priv->mutex);
+
     return ret;
 }
 
@@ -28,13 +28,31 @@
 #include "vlib/thread.h"
 #include "libvsensors/sensor.h"
 
+/** size of the lock-free event ring, must be a power of 2 */
+#define COMMON_QUEUE_SIZE       1024
+
 /** internal common queue type */
 typedef slist_t * sensor_common_queue_t;
 
+/** cell of the bounded multi-producer/single-consumer event ring */
+typedef struct {
+    unsigned long           seq;
+    sensor_common_event_t * event;
+} common_queue_cell_t;
+
 typedef struct {
     void *                  sysdep;
     vthread_t *             thread;
+    /* producers: lock-free ring, overflow list used only when the ring is full */
+    common_queue_cell_t     ring[COMMON_QUEUE_SIZE];
+    unsigned long           ring_head;
+    sensor_common_queue_t   overflow;
+    int                     overflow_used;
+    pthread_mutex_t         overflow_mutex;
+    /* consumer: events drained from the ring and kept by process functions */
+    unsigned long           ring_tail;
     sensor_common_queue_t   event_queue;
+    slist_t *               event_queue_last;
     pthread_mutex_t         mutex;
 } common_priv_t;
 
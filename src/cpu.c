@@ -24,15 +24,19 @@
 #include <string.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include "vlib/util.h"
 
 #include "cpu.h"
 #include "cpu_private.h"
+#include "sensor_rate.h"
 
 /* ************************************************************************ */
-/* use sysconf instead of deprecated CLK_TCK */
+/* use sysconf instead of deprecated CLK_TCK, shared by all sensor contexts */
 static unsigned long s_clk_tck = 0;
+static pthread_once_t s_clk_tck_once = PTHREAD_ONCE_INIT;
 
 static void cpu_init_clktck() {
     long clk_tck = sysconf(_SC_CLK_TCK);
@@ -49,12 +53,31 @@ static void cpu_init_clktck() {
     }
 }
 unsigned long cpu_clktck() {
-    if (s_clk_tck > 0)
-        return s_clk_tck;
-    cpu_init_clktck();
+    pthread_once(&s_clk_tck_once, cpu_init_clktck);
     return s_clk_tck;
 }
 
+/* ************************************************************************ */
+/** labels of cpu_tick_class_t */
+static const char * const s_cpu_tick_class_names[CPU_TICK_NB] = {
+    "nice", "iowait", "irq", "softirq", "steal", "guest", "guest nice"
+};
+
+/** number of descs for one cpu_tick_t, and additional ones for a single cpu */
+#define CPU_NB_TICK_DESCS       (7 + CPU_TICK_NB + 2)
+#define CPU_NB_EXTRA_DESCS      3
+
+/* ************************************************************************ */
+static void cpu_free_descs(sensor_desc_t ** pdescs) {
+    if (*pdescs != NULL) {
+        sensor_desc_t * desc;
+        for (desc = *pdescs; desc->label != NULL; ++desc)
+            free((void*) desc->label);
+        free(*pdescs);
+        *pdescs = NULL;
+    }
+}
+
 /* ************************************************************************ */
 /** family-specific free */
 static sensor_status_t family_free(sensor_family_t *family) {
@@ -62,12 +85,12 @@ static sensor_status_t family_free(sensor_family_t *family) {
         cpu_priv_t *priv = (cpu_priv_t *) family->priv;
         if (priv->cpu_data.ticks != NULL)
             free(priv->cpu_data.ticks);
-        if (priv->sensors_desc != NULL) {
-            sensor_desc_t * desc;
-            for (desc = priv->sensors_desc; desc->label != NULL; ++desc)
-                free((void*) desc->label);
-            free(priv->sensors_desc);
-        }
+        if (priv->cpu_data.nodes != NULL)
+            free(priv->cpu_data.nodes);
+        if (priv->cpu_data.packages != NULL)
+            free(priv->cpu_data.packages);
+        cpu_free_descs(&(priv->sensors_desc));
+        cpu_free_descs(&(priv->retired_desc));
         sysdep_cpu_destroy(family);
         family->priv = NULL;
         free(priv);
@@ -115,25 +138,73 @@ static sensor_status_t init_one_desc(
 }
 
 /* ************************************************************************ */
-/** family private data creation, including the sensor_desc_t data */
-static sensor_status_t init_private_data(sensor_family_t *family) {
+/** create the descs of one cpu_tick_t (all cpus, one cpu, node or package) */
+static sensor_desc_t * init_tick_descs(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            cpu_tick_t *            ticks,
+                            const char *            name) {
     cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
-    unsigned        nb_cpus;
-    unsigned        i;
-    const unsigned  nb_desc_per_cpu = 7;
-    sensor_desc_t * desc;
 
-    priv->last_update_time.tv_usec = INT_MAX;
-    priv->cpu_data.nb_cpus = nb_cpus = sysdep_cpu_nb(family);
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &ticks->sys,
+                      "%s sys", name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &ticks->user,
+                      "%s user", name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &ticks->activity,
+                      "%s activity", name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &ticks->total,
+                      "%s total", name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &ticks->sys_percent,
+                      "%s sys %%", name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &ticks->user_percent,
+                      "%s user %%", name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &ticks->activity_percent,
+                      "%s total %%", name) == SENSOR_SUCCESS)
+        ++desc;
 
-    if ((priv->cpu_data.ticks = calloc(nb_cpus + 1, sizeof(cpu_tick_t))) == NULL) {
-        LOG_ERROR(family->log, "%s/%s(): cannot allocate cpu_ticks", __FILE__, __func__);
-        return SENSOR_ERROR;
+    for (unsigned int i_class = 0; i_class < CPU_TICK_NB; ++i_class) {
+        if ((priv->tick_classes & (1U << i_class)) != 0
+        &&  init_one_desc(family, desc, SENSOR_VALUE_ULONG, &ticks->classes[i_class],
+                          "%s %s", name, s_cpu_tick_class_names[i_class]) == SENSOR_SUCCESS)
+            ++desc;
     }
+    if ((priv->tick_classes & (1U << CPU_TICK_IOWAIT)) != 0
+    &&  init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &ticks->iowait_percent,
+                      "%s iowait %%", name) == SENSOR_SUCCESS)
+        ++desc;
+    if ((priv->tick_classes & (1U << CPU_TICK_STEAL)) != 0
+    &&  init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &ticks->steal_percent,
+                      "%s steal %%", name) == SENSOR_SUCCESS)
+        ++desc;
 
-    if ((priv->sensors_desc
-            = calloc(nb_desc_per_cpu * (nb_cpus + 1) + 1/*nb_cpus*/ + 1/*NULL*/,
-                     sizeof(*priv->sensors_desc))) == NULL) {
+    return desc;
+}
+
+/* ************************************************************************ */
+/** (re)create the sensor_desc_t data for the current set of online cpus.
+ * This is done when sensors are listed, at init and on SENSOR_RELOAD_FAMILY */
+static sensor_status_t init_descs(sensor_family_t *family) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+    cpu_data_t *    data = &(priv->cpu_data);
+    unsigned int    i, nb_desc;
+    sensor_desc_t * desc;
+    char            name[32];
+
+    /* the listed descs are used until libvsensors replaces them during a reload,
+     * they are freed by the next list() */
+    cpu_free_descs(&(priv->retired_desc));
+    priv->retired_desc = priv->sensors_desc;
+    priv->sensors_desc = NULL;
+
+    nb_desc = (1 + data->nb_cpus + data->nb_nodes + data->nb_packages) * CPU_NB_TICK_DESCS
+              + data->nb_cpus * CPU_NB_EXTRA_DESCS + 1/*nb_cpus*/ + 1/*NULL*/;
+    if ((priv->sensors_desc = calloc(nb_desc, sizeof(*priv->sensors_desc))) == NULL) {
         return SENSOR_ERROR;
     }
 
@@ -143,63 +214,47 @@ static sensor_status_t init_private_data(sensor_family_t *family) {
                       "number of cpus") == SENSOR_SUCCESS)
         ++desc;
 
-    for (i = 0; i <= priv->cpu_data.nb_cpus; i++) {
-        char cpu_name[10];
+    desc = init_tick_descs(family, desc, &(data->ticks[0]), "cpus");
 
-        if (i == 0)
-            str0cpy(cpu_name, "s", sizeof(cpu_name) / sizeof(*cpu_name));
-        else
-            snprintf(cpu_name, sizeof(cpu_name) / sizeof(*cpu_name), "%d", i);
+    for (i = 1; i <= data->max_cpus; i++) {
+        if (!CPU_IS_ONLINE(data, i))
+            continue ;
 
-        if (init_one_desc(
-                    family, desc,
-                    SENSOR_VALUE_ULONG,
-                    &priv->cpu_data.ticks[i].sys,
-                    "cpu%s sys", cpu_name) == SENSOR_SUCCESS)
-            ++desc;
+        snprintf(name, sizeof(name) / sizeof(*name), "cpu%u", i);
+        desc = init_tick_descs(family, desc, &(data->ticks[i]), name);
 
-        if (init_one_desc(
+        if ((priv->extras & CPU_EXTRA_FREQ) != 0
+        &&  init_one_desc(
                     family, desc,
                     SENSOR_VALUE_ULONG,
-                    &priv->cpu_data.ticks[i].user,
-                    "cpu%s user", cpu_name) == SENSOR_SUCCESS)
+                    &data->ticks[i].freq,
+                    "%s freq", name) == SENSOR_SUCCESS)
             ++desc;
 
-        if (init_one_desc(
+        if ((priv->extras & CPU_EXTRA_THROTTLE) != 0
+        &&  init_one_desc(
                     family, desc,
                     SENSOR_VALUE_ULONG,
-                    &priv->cpu_data.ticks[i].activity,
-                    "cpu%s activity", cpu_name) == SENSOR_SUCCESS)
+                    &data->ticks[i].core_throttles,
+                    "%s core throttles", name) == SENSOR_SUCCESS)
             ++desc;
 
-        if (init_one_desc(
+        if ((priv->extras & CPU_EXTRA_THROTTLE) != 0
+        &&  init_one_desc(
                     family, desc,
                     SENSOR_VALUE_ULONG,
-                    &priv->cpu_data.ticks[i].total,
-                    "cpu%s total", cpu_name) == SENSOR_SUCCESS)
-            ++desc;
-
-        if (init_one_desc(
-                    family, desc,
-                    SENSOR_VALUE_UCHAR,
-                    &priv->cpu_data.ticks[i].sys_percent,
-                    "cpu%s sys %%", cpu_name) == SENSOR_SUCCESS)
-            ++desc;
-
-        if (init_one_desc(
-                    family, desc,
-                    SENSOR_VALUE_UCHAR,
-                    &priv->cpu_data.ticks[i].user_percent,
-                    "cpu%s user %%", cpu_name) == SENSOR_SUCCESS)
-            ++desc;
-
-        if (init_one_desc(
-                    family, desc,
-                    SENSOR_VALUE_UCHAR,
-                    &priv->cpu_data.ticks[i].activity_percent,
-                    "cpu%s total %%", cpu_name) == SENSOR_SUCCESS)
+                    &data->ticks[i].package_throttles,
+                    "%s package throttles", name) == SENSOR_SUCCESS)
             ++desc;
     }
+    for (i = 0; i < data->nb_nodes; ++i) {
+        snprintf(name, sizeof(name) / sizeof(*name), "node%u", i);
+        desc = init_tick_descs(family, desc, &(data->nodes[i]), name);
+    }
+    for (i = 0; i < data->nb_packages; ++i) {
+        snprintf(name, sizeof(name) / sizeof(*name), "package%u", i);
+        desc = init_tick_descs(family, desc, &(data->packages[i]), name);
+    }
     desc->label = NULL;
     desc->key = NULL;
     desc->family = NULL;
@@ -207,6 +262,79 @@ static sensor_status_t init_private_data(sensor_family_t *family) {
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+/** number of groups (highest id + 1) in a node_of or package_of array */
+static unsigned int cpu_group_count(const cpu_data_t * data, const int * group_of) {
+    int max = -1;
+
+    if (group_of == NULL)
+        return 0;
+    for (unsigned int i = 1; i <= data->max_cpus; ++i) {
+        if (CPU_IS_ONLINE(data, i) && group_of[i] > max)
+            max = group_of[i];
+    }
+    return max + 1;
+}
+
+/* ************************************************************************ */
+/** (re)allocate a groups array if the number of groups changed */
+static void cpu_alloc_groups(sensor_family_t * family, cpu_tick_t ** groups,
+                             unsigned int * nb_groups, unsigned int nb) {
+    if (nb == *nb_groups)
+        return ;
+    if (*groups != NULL)
+        free(*groups);
+    if (nb > 0 && (*groups = calloc(nb, sizeof(**groups))) == NULL) {
+        LOG_WARN(family->log, "%s(): cannot allocate cpu groups", __func__);
+        nb = 0;
+    } else if (nb == 0) {
+        *groups = NULL;
+    }
+    *nb_groups = nb;
+}
+
+/* ************************************************************************ */
+/** (re)allocate the cpu ticks according to what sysdep_cpu_nb() or a
+ * sysdep_cpu_get() returning SENSOR_RELOAD_FAMILY gave.
+ * Existing ticks are kept so that percents of remaining cpus are still valid */
+static sensor_status_t alloc_cpu_data(sensor_family_t *family) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+    cpu_data_t *    data = &(priv->cpu_data);
+
+    if (data->max_cpus < data->nb_cpus)
+        data->max_cpus = data->nb_cpus;
+
+    if (data->nb_ticks < data->max_cpus + 1) {
+        cpu_tick_t * ticks;
+
+        if ((ticks = realloc(data->ticks, (data->max_cpus + 1) * sizeof(*ticks))) == NULL) {
+            LOG_ERROR(family->log, "%s/%s(): cannot allocate cpu_ticks", __FILE__, __func__);
+            return SENSOR_ERROR;
+        }
+        memset(ticks + data->nb_ticks, 0,
+               (data->max_cpus + 1 - data->nb_ticks) * sizeof(*ticks));
+        data->ticks = ticks;
+        data->nb_ticks = data->max_cpus + 1;
+    }
+    cpu_alloc_groups(family, &(data->nodes), &(data->nb_nodes),
+                     cpu_group_count(data, data->node_of));
+    cpu_alloc_groups(family, &(data->packages), &(data->nb_packages),
+                     cpu_group_count(data, data->package_of));
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family private data creation, sensor_desc_t are created by family_list() */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+
+    priv->last_update_time.tv_usec = INT_MAX;
+    priv->cpu_data.nb_cpus = sysdep_cpu_nb(family);
+
+    return alloc_cpu_data(family);
+}
+
 /* ************************************************************************ */
 /** family-specific init */
 static sensor_status_t family_init(sensor_family_t *family) {
@@ -234,17 +362,84 @@ static sensor_status_t family_init(sensor_family_t *family) {
 }
 
 /* ************************************************************************ */
-/** family-specific list */
+/** family-specific list: descs follow the online cpus */
 static slist_t * family_list(sensor_family_t *family) {
     cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
     slist_t *       list = NULL;
 
+    if (alloc_cpu_data(family) != SENSOR_SUCCESS || init_descs(family) != SENSOR_SUCCESS) {
+        LOG_ERROR(family->log, "cannot initialize %s sensors", family->info->name);
+        return NULL;
+    }
+    /* cpus could have been added: next update must not compute percents */
+    priv->last_update_time.tv_usec = INT_MAX;
+    priv->read_ns = 0;
+
     for (unsigned int i_desc = 0; priv->sensors_desc[i_desc].label; i_desc++) {
         list = slist_prepend(list, &priv->sensors_desc[i_desc]);
     }
     return list;
 }
 
+/* ************************************************************************ */
+/** percent of elapsed time represented by the ticks elapsed from last to ticks.
+ * A decreasing counter (wrap of 32 bits ticks, offline cpu leaving a group) is 0%. */
+static inline TYPE_SENSOR_VALUE_UCHAR cpu_tick_percent(unsigned long last, unsigned long ticks,
+                                                       const struct timeval * elapsed) {
+    uint64_t delta, elapsed_us, percent;
+
+    if (!sensor_rate_delta(sizeof(unsigned long) * CHAR_BIT, last, ticks, &delta))
+        return 0;
+    elapsed_us = (uint64_t) elapsed->tv_sec * 1000000 + elapsed->tv_usec;
+    if (elapsed_us == 0)
+        return 0;
+    percent = (delta * 100 * 1000000) / (s_clk_tck * elapsed_us);
+    return percent > 100 ? 100 : percent;
+}
+
+/* ************************************************************************ */
+static void cpu_tick_store_classes(cpu_tick_t * ticks, const unsigned long * classes,
+                                   const struct timeval * elapsed) {
+    if (elapsed != NULL) {
+        ticks->iowait_percent = cpu_tick_percent(
+                    ticks->classes[CPU_TICK_IOWAIT], classes[CPU_TICK_IOWAIT], elapsed);
+        ticks->steal_percent = cpu_tick_percent(
+                    ticks->classes[CPU_TICK_STEAL], classes[CPU_TICK_STEAL], elapsed);
+    }
+    memcpy(ticks->classes, classes, sizeof(ticks->classes));
+}
+
+/* ************************************************************************ */
+static void cpu_tick_store(cpu_tick_t * ticks, unsigned long sys, unsigned long user,
+                           unsigned long activity, unsigned long total,
+                           const struct timeval * elapsed) {
+    if (elapsed != NULL) {
+        ticks->activity_percent = cpu_tick_percent(ticks->activity, activity, elapsed);
+        ticks->user_percent = cpu_tick_percent(ticks->user, user, elapsed);
+        ticks->sys_percent = cpu_tick_percent(ticks->sys, sys, elapsed);
+    }
+
+    /* finally stores the tick values */
+    ticks->activity    = activity;
+    ticks->user        = user;
+    ticks->sys         = sys;
+    ticks->total       = total;
+}
+
+/* ************************************************************************ */
+/** called by sysdeps to store optional tick classes of one cpu, before cpu_store_ticks() */
+int cpu_store_ticks_classes(sensor_family_t * family, int cpu_idx,
+                            const unsigned long * classes, struct timeval * elapsed) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+
+    if (cpu_idx < 0 || (unsigned int) cpu_idx > priv->cpu_data.max_cpus) {
+        return SENSOR_ERROR;
+    }
+    cpu_tick_store_classes(&(priv->cpu_data.ticks[cpu_idx]), classes, elapsed);
+
+    return SENSOR_SUCCESS;
+}
+
 /* ************************************************************************ */
 /** called by sysdeps to store cpu ticks and compute percents or global values */
 int cpu_store_ticks(sensor_family_t * family,
@@ -253,7 +448,7 @@ int cpu_store_ticks(sensor_family_t * family,
                     struct timeval * elapsed) {
 
     cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
-    cpu_tick_t *    ticks;
+    cpu_data_t *    data = &(priv->cpu_data);
 
     /* compute global (all cpus) values */
     if (cpu_idx == CPU_COMPUTE_GLOBAL) {
@@ -262,9 +457,15 @@ int cpu_store_ticks(sensor_family_t * family,
         unsigned long   global_user = 0;
         unsigned long   global_sys = 0;
 
+        if (data->nb_cpus == 0)
+            return SENSOR_ERROR;
+
         cpu_idx = 0;
-        for (int i_cpu = priv->cpu_data.nb_cpus; i_cpu > 0; --i_cpu) {
-            ticks = &(priv->cpu_data.ticks[i_cpu]);
+        for (unsigned int i_cpu = data->max_cpus; i_cpu > 0; --i_cpu) {
+            cpu_tick_t * ticks = &(data->ticks[i_cpu]);
+
+            if (!CPU_IS_ONLINE(data, i_cpu))
+                continue ;
 
             /* accumulate global cpu data */
             global_total    += ticks->total;
@@ -274,81 +475,133 @@ int cpu_store_ticks(sensor_family_t * family,
         }
 
         /* set global cpu data */
-        total       = global_total      / priv->cpu_data.nb_cpus;
-        activity    = global_activity   / priv->cpu_data.nb_cpus;
-        user        = global_user       / priv->cpu_data.nb_cpus;
-        sys         = global_sys        / priv->cpu_data.nb_cpus;
-    } else if (cpu_idx < 0 || cpu_idx > priv->cpu_data.nb_cpus) {
+        total       = global_total      / data->nb_cpus;
+        activity    = global_activity   / data->nb_cpus;
+        user        = global_user       / data->nb_cpus;
+        sys         = global_sys        / data->nb_cpus;
+    } else if (cpu_idx < 0 || (unsigned int) cpu_idx > data->max_cpus) {
         return SENSOR_ERROR;
     }
 
-    ticks = &(priv->cpu_data.ticks[cpu_idx]);
+    cpu_tick_store(&(data->ticks[cpu_idx]), sys, user, activity, total, elapsed);
 
-    if (elapsed != NULL) {
-        unsigned long   activity_percent
-                            = (10 * 100 * (activity - ticks->activity)) / s_clk_tck;
-
-        unsigned long   user_percent
-                            = (10 * 100 * (user - ticks->user)) / s_clk_tck;
-
-        unsigned long   sys_percent
-                            = (10 * 100 * (sys - ticks->sys)) / s_clk_tck;
-
-        ticks->activity_percent
-                    = (100 * activity_percent)
-                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000);
-        if (ticks->activity_percent > 100)
-            ticks->activity_percent = 100;
-
-        ticks->user_percent
-                    = (100 * user_percent)
-                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000);
-        if (ticks->user_percent > 100)
-            ticks->user_percent = 100;
-
-        ticks->sys_percent
-                    = (100 * sys_percent)
-                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000);
-        if (ticks->sys_percent > 100)
-            ticks->sys_percent = 100;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** average the ticks of online cpus belonging to group id */
+static void cpu_store_group(cpu_data_t * data, cpu_tick_t * group, const int * group_of,
+                            int id, struct timeval * elapsed) {
+    unsigned long   sys = 0, user = 0, activity = 0, total = 0;
+    unsigned long   classes[CPU_TICK_NB] = { 0, };
+    unsigned int    i, i_class, n = 0;
+
+    for (i = 1; i <= data->max_cpus; ++i) {
+        const cpu_tick_t * ticks = &(data->ticks[i]);
+
+        if (group_of[i] != id || !CPU_IS_ONLINE(data, i))
+            continue ;
+        sys         += ticks->sys;
+        user        += ticks->user;
+        activity    += ticks->activity;
+        total       += ticks->total;
+        for (i_class = 0; i_class < CPU_TICK_NB; ++i_class)
+            classes[i_class] += ticks->classes[i_class];
+        ++n;
     }
+    if (n == 0)
+        return ;
+    for (i_class = 0; i_class < CPU_TICK_NB; ++i_class)
+        classes[i_class] /= n;
+    cpu_tick_store_classes(group, classes, elapsed);
+    cpu_tick_store(group, sys / n, user / n, activity / n, total / n, elapsed);
+}
 
-    /* finally stores the tick values */
-    ticks->activity    = activity;
-    ticks->user        = user;
-    ticks->sys         = sys;
-    ticks->total       = total;
+/* ************************************************************************ */
+int cpu_store_groups(sensor_family_t * family, struct timeval * elapsed) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+    cpu_data_t *    data = &(priv->cpu_data);
+    unsigned int    i;
 
+    for (i = 0; i < data->nb_nodes; ++i) {
+        cpu_store_group(data, &(data->nodes[i]), data->node_of, i, elapsed);
+    }
+    for (i = 0; i < data->nb_packages; ++i) {
+        cpu_store_group(data, &(data->packages[i]), data->package_of, i, elapsed);
+    }
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+/** retrieve all cpu datas at once, percents are computed on the time elapsed since
+ * the previous retrieval, read on the sensor clock */
+static sensor_status_t cpu_get(sensor_family_t * family) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+    struct timeval  elapsed, * pelapsed = NULL;
+    uint64_t        now_ns;
+
+    if (sensor_now_ns(family->sctx, &now_ns) != SENSOR_SUCCESS) {
+        now_ns = 0;
+    } else if (priv->read_ns != 0 && now_ns > priv->read_ns) {
+        elapsed.tv_sec = (now_ns - priv->read_ns) / 1000000000;
+        elapsed.tv_usec = ((now_ns - priv->read_ns) % 1000000000) / 1000;
+        pelapsed = &elapsed;
+    }
+    priv->read_ns = now_ns;
+
+    return sysdep_cpu_get(family, pelapsed);
+}
+
 /* ************************************************************************ */
 /** family-specific update */
 static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
     /* Sanity checks are done in sensor_init() and sensor_update_check() */
     cpu_priv_t *    priv = (cpu_priv_t *) sensor->desc->family->priv;
+    sensor_status_t ret = SENSOR_SUCCESS;
 
     if (now == NULL) {
-        sysdep_cpu_get(sensor->desc->family, NULL);
+        ret = cpu_get(sensor->desc->family);
     } else if (priv->last_update_time.tv_usec == INT_MAX) {
-        sysdep_cpu_get(sensor->desc->family, NULL);
+        ret = cpu_get(sensor->desc->family);
         priv->last_update_time = *now;
     } else {
         /* Because all cpu datas are retrieved at once, don't repeat it for each sensor */
-        struct timeval  elapsed, * pelapsed = &elapsed;
+        struct timeval  elapsed;
 
         timersub(now, &(priv->last_update_time), &elapsed);
-        if (elapsed.tv_sec == 0 && elapsed.tv_usec < 1000)
-            pelapsed = NULL;
         if (timercmp(&elapsed, &(sensor->watch->update_interval), >=)) {
-            sysdep_cpu_get(sensor->desc->family, pelapsed);
+            ret = cpu_get(sensor->desc->family);
             priv->last_update_time = *now;
         }
     }
+    /* the set of online cpus changed, descs must be listed again */
+    if (ret == SENSOR_RELOAD_FAMILY) {
+        return ret;
+    }
 
     /* Always update the sensor Value: we are called because sensor timeout expired.
      * and another sensor with different timeout could have updated global data */
-    return sensor_value_fromraw(sensor->desc->key, &(sensor->value));
+    return SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->key, &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    sensor_status_t ret;
+    unsigned int    i;
+    (void) now;
+
+    /* all due samples of the family are given at once: retrieve cpu datas only once */
+    ret = cpu_get(family);
+
+    for (i = 0; i < n; ++i) {
+        results[i] = ret == SENSOR_RELOAD_FAMILY ? SENSOR_RELOAD_FAMILY
+                     : SENSOR_DESC_FROMRAW(samples[i]->desc, samples[i]->desc->key,
+                                           &(samples[i]->value));
+    }
+    return SENSOR_SUCCESS;
 }
 
 /* ************************************************************************ */
@@ -359,6 +612,8 @@ const sensor_family_info_t g_sensor_family_cpu = {
     .update = family_update,
     .list = family_list,
     .notify = NULL,
-    .write = NULL
+    .write = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch
 };
 
@@ -47,6 +47,38 @@ int             cpu_store_ticks(
                     unsigned long           total,
                     struct timeval *        elapsed);
 
+/** optional tick classes, stored with cpu_store_ticks_classes() before
+ * cpu_store_ticks(), by sysdeps setting (1 << class) in cpu_priv_t.tick_classes */
+typedef enum {
+    CPU_TICK_NICE = 0,      /* already accounted in user */
+    CPU_TICK_IOWAIT,
+    CPU_TICK_IRQ,
+    CPU_TICK_SOFTIRQ,
+    CPU_TICK_STEAL,
+    CPU_TICK_GUEST,         /* already accounted in user */
+    CPU_TICK_GUEST_NICE,    /* already accounted in nice */
+    CPU_TICK_NB             /* last */
+} cpu_tick_class_t;
+
+/** compute nodes and packages averages from online cpus (after cpu_store_ticks()) */
+int             cpu_store_groups(
+                    sensor_family_t *       family,
+                    struct timeval *        elapsed);
+
+int             cpu_store_ticks_classes(
+                    sensor_family_t *       family,
+                    int                     cpu_idx,
+                    const unsigned long *   classes, /* CPU_TICK_NB values */
+                    struct timeval *        elapsed);
+
+/** optional per-cpu data, filled by sysdep_cpu_get() for sysdeps setting them
+ * in cpu_priv_t.extras */
+typedef enum {
+    CPU_EXTRA_NONE      = 0,
+    CPU_EXTRA_FREQ      = 1 << 0,   /* cpu_tick_t.freq */
+    CPU_EXTRA_THROTTLE  = 1 << 1    /* cpu_tick_t.{core,package}_throttles */
+} cpu_extra_t;
+
 /** Internal struct where data for one cpu is kept */
 typedef struct {
     TYPE_SENSOR_VALUE_ULONG sys;
@@ -56,19 +88,44 @@ typedef struct {
     TYPE_SENSOR_VALUE_UCHAR sys_percent;
     TYPE_SENSOR_VALUE_UCHAR user_percent;
     TYPE_SENSOR_VALUE_UCHAR activity_percent;
+    TYPE_SENSOR_VALUE_UCHAR iowait_percent;
+    TYPE_SENSOR_VALUE_UCHAR steal_percent;
+    TYPE_SENSOR_VALUE_ULONG classes[CPU_TICK_NB];
+    TYPE_SENSOR_VALUE_ULONG freq;               /* current frequency, kHz */
+    TYPE_SENSOR_VALUE_ULONG core_throttles;     /* thermal throttling events */
+    TYPE_SENSOR_VALUE_ULONG package_throttles;
 } cpu_tick_t;
 
-/** Internal struct where all cpu info is kept */
+/** Internal struct where all cpu info is kept.
+ * ticks[0] is for all cpus, ticks[i] for cpu index i (i in 1..max_cpus).
+ * sysdep_cpu_nb() sets nb_cpus and optionally max_cpus (nb_cpus if 0), online,
+ * node_of and package_of, which it owns (max_cpus + 1 elements) and can update
+ * in sysdep_cpu_get() before returning SENSOR_RELOAD_FAMILY. */
 typedef struct {
-    TYPE_SENSOR_VALUE_UINT16    nb_cpus;
+    TYPE_SENSOR_VALUE_UINT16    nb_cpus;    /* online cpus */
     cpu_tick_t *                ticks;
+    unsigned int                nb_ticks;   /* allocated ticks */
+    unsigned int                max_cpus;   /* highest cpu index */
+    const unsigned char *       online;     /* online[i] for cpu index i, NULL if all online */
+    const int *                 node_of;    /* numa node of cpu index i or -1, NULL if unknown */
+    const int *                 package_of; /* package of cpu index i or -1, NULL if unknown */
+    cpu_tick_t *                nodes;      /* per numa node averages, see cpu_store_groups() */
+    unsigned int                nb_nodes;
+    cpu_tick_t *                packages;   /* per package averages */
+    unsigned int                nb_packages;
 } cpu_data_t;
 
+#define CPU_IS_ONLINE(data, i)  ((data)->online == NULL || (data)->online[i] != 0)
+
 /** private/specific network family structure */
 typedef struct {
     sensor_desc_t *     sensors_desc;
+    sensor_desc_t *     retired_desc;   /* descs of previous list(), see init_descs() */
     cpu_data_t          cpu_data;
     struct timeval      last_update_time;
+    uint64_t            read_ns;        /* sensor clock of last sysdep_cpu_get(), 0 if none */
+    unsigned int        tick_classes;   /* (1 << cpu_tick_class_t), set by sysdep_cpu_nb() */
+    unsigned int        extras;         /* cpu_extra_t, set by sysdep_cpu_nb() */
     void *              sysdep;
 } cpu_priv_t;
 
@@ -22,54 +22,244 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
+#include <limits.h>
 
 #include "disk.h"
 
 #include "disk_private.h"
 
+/** widths of raw device counters: ops are unsigned long and ms are unsigned int
+ * in /proc/diskstats, other systems use at least these widths */
+static const sensor_rate_conf_t s_disk_rate_ops = { .bits = sizeof(unsigned long) * CHAR_BIT, };
+static const sensor_rate_conf_t s_disk_rate_ms  = { .bits = 32, };
+
+/* ************************************************************************ */
+static void disk_free_descs(disk_priv_t * priv) {
+    if (priv->sensors_desc != NULL) {
+        sensor_desc_t * desc;
+        for (desc = priv->sensors_desc; desc->label != NULL; ++desc)
+            free((void*) desc->label);
+        free(priv->sensors_desc);
+        priv->sensors_desc = NULL;
+    }
+}
+
+/* ************************************************************************ */
+static void disk_device_free(disk_device_t * dev) {
+    for (unsigned int i = 0; i < dev->nb_descs; ++i)
+        free((void *) dev->descs[i].label);
+    free(dev);
+}
+
+/* ************************************************************************ */
+static int disk_devices_has(disk_device_t ** devices, unsigned int nb_devices,
+                            const disk_device_t * dev) {
+    for (unsigned int i = 0; i < nb_devices; ++i) {
+        if (devices[i] == dev)
+            return 1;
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+static void disk_free_dropped(disk_priv_t * priv) {
+    for (unsigned int i = 0; i < priv->nb_devices_dropped; ++i)
+        disk_device_free(priv->devices_dropped[i]);
+    if (priv->devices_dropped != NULL)
+        free(priv->devices_dropped);
+    priv->devices_dropped = NULL;
+    priv->nb_devices_dropped = 0;
+}
+
+/* ************************************************************************ */
+void disk_devices_set_next(disk_priv_t * priv,
+                           disk_device_t ** devices, unsigned int nb_devices) {
+    /* free the devices of a previous pending set which are not used anymore */
+    if (priv->devices_next != NULL) {
+        for (unsigned int i = 0; i < priv->nb_devices_next; ++i) {
+            disk_device_t * dev = priv->devices_next[i];
+            if (!disk_devices_has(devices, nb_devices, dev)
+            &&  !disk_devices_has(priv->devices, priv->nb_devices, dev))
+                disk_device_free(dev);
+        }
+        free(priv->devices_next);
+    }
+    priv->devices_next = devices;
+    priv->nb_devices_next = nb_devices;
+}
+
+/* ************************************************************************ */
+/** replace the devices by the pending set. The devices which are not in the new set
+ * are freed, or moved to devices_dropped if b_keep_dropped is set because their descs
+ * are still listed. Returns 1 on success, 0 if there was no pending set, -1 on error. */
+static int disk_devices_swap(disk_priv_t * priv, int b_keep_dropped) {
+    if (priv->devices_next == NULL)
+        return 0;
+
+    disk_free_dropped(priv);
+    if (b_keep_dropped && priv->nb_devices > 0
+    &&  (priv->devices_dropped = calloc(priv->nb_devices, sizeof(*priv->devices_dropped))) == NULL) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < priv->nb_devices; ++i) {
+        if (disk_devices_has(priv->devices_next, priv->nb_devices_next, priv->devices[i]))
+            continue ;
+        if (b_keep_dropped)
+            priv->devices_dropped[priv->nb_devices_dropped++] = priv->devices[i];
+        else
+            disk_device_free(priv->devices[i]);
+    }
+    if (priv->devices != NULL)
+        free(priv->devices);
+    priv->devices = priv->devices_next;
+    priv->nb_devices = priv->nb_devices_next;
+    priv->devices_next = NULL;
+    priv->nb_devices_next = 0;
+    ++(priv->devices_gen);
+
+    return 1;
+}
+
+/* ************************************************************************ */
 /** family-specific free */
 static sensor_status_t family_free(sensor_family_t *family) {
     if (family->priv != NULL) {
         disk_priv_t * priv = (disk_priv_t *) family->priv;
 
         sysdep_disk_destroy(family);
-        if (priv->sensors_desc != NULL)
-            free (priv->sensors_desc);
+        disk_free_descs(priv);
+        disk_devices_set_next(priv, NULL, 0);
+        disk_free_dropped(priv);
+        for (unsigned int i = 0; i < priv->nb_devices; ++i)
+            disk_device_free(priv->devices[i]);
+        if (priv->devices != NULL)
+            free(priv->devices);
         family->priv = NULL;
         free(priv);
     }
     return SENSOR_SUCCESS;
 }
 
-/** family private data creation, including the sensor_desc_t data */
-static sensor_status_t init_private_data(sensor_family_t *family) {
-    disk_priv_t * priv = (disk_priv_t *) family->priv;;
-    // Not Pretty but allows to have an initiliazed array with dynamic values.
-    sensor_desc_t sensors_desc[] = {
-        { &priv->disk_data.obytes,           "disk all written bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.ibytes,           "disk all read bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.phy_obytes,       "disk written bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.phy_ibytes,       "disk read bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.obytespersec,     "disk all written bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.ibytespersec,     "disk all read bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.phy_obytespersec, "disk written bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->disk_data.phy_ibytespersec, "disk read bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { NULL, NULL, NULL, 0, NULL },
+/* ************************************************************************ */
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            sensor_value_type_t     type,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) __attribute__((format(printf, 5, 6)));
+
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            sensor_value_type_t     type,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) {
+    va_list valist;
+    char *  label = NULL;
+
+    va_start(valist, fmt_label);
+    if (vasprintf(&label, fmt_label, valist) < 0)
+        label = NULL;
+    va_end(valist);
+
+    if (label == NULL || sysdep_disk_support(family, label) != SENSOR_SUCCESS) {
+        if (label != NULL)
+            free(label);
+        return SENSOR_ERROR;
+    }
+
+    desc->label = label;
+    desc->type = type;
+    desc->family = family;
+    desc->key = key;
+    desc->properties = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the sensor_desc_t data for the global counters, once */
+static sensor_status_t init_descs(sensor_family_t *family) {
+    disk_priv_t *       priv = (disk_priv_t *) family->priv;
+    disk_data_t *       data = &(priv->disk_data);
+    sensor_desc_t *     desc;
+    const struct { void * key; const char * label; } globals[] = {
+        { &data->obytes,            "disk all written bytes" },
+        { &data->ibytes,            "disk all read bytes" },
+        { &data->phy_obytes,        "disk written bytes" },
+        { &data->phy_ibytes,        "disk read bytes" },
+        { &data->obytespersec,      "disk all written bytes/sec" },
+        { &data->ibytespersec,      "disk all read bytes/sec" },
+        { &data->phy_obytespersec,  "disk written bytes/sec" },
+        { &data->phy_ibytespersec,  "disk read bytes/sec" },
     };
-    priv->last_update_time.tv_usec = INT_MAX;
-    if ((priv->sensors_desc
-            = calloc(sizeof(sensors_desc) / sizeof(*sensors_desc), sizeof(*sensors_desc))) == NULL) {
+
+    if (priv->sensors_desc != NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if ((priv->sensors_desc = calloc(sizeof(globals) / sizeof(*globals) + 1/*NULL*/,
+                                     sizeof(*priv->sensors_desc))) == NULL) {
         return SENSOR_ERROR;
     }
-    memcpy(priv->sensors_desc, sensors_desc, sizeof(sensors_desc));
+
+    desc = priv->sensors_desc;
+
+    for (unsigned int i = 0; i < sizeof(globals) / sizeof(*globals); ++i) {
+        if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, globals[i].key,
+                          "%s", globals[i].label) == SENSOR_SUCCESS)
+            ++desc;
+    }
+    desc->label = NULL;
+    desc->key = NULL;
+    desc->family = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the sensor_desc_t data of a device listed the first time.
+ * Returns 1 if they were created, 0 if they already exist. */
+static int init_device_descs(sensor_family_t *family, disk_device_t * dev) {
+    sensor_desc_t * desc = dev->descs;
+
+    if (dev->nb_descs > 0) {
+        return 0;
+    }
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &dev->read_iops,
+                      "disk %s read iops", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &dev->write_iops,
+                      "disk %s write iops", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &dev->read_latency,
+                      "disk %s read latency ms", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &dev->write_latency,
+                      "disk %s write latency ms", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &dev->utilization,
+                      "disk %s utilization %%", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &dev->queue_depth,
+                      "disk %s queue depth", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    if (init_one_desc(family, desc, SENSOR_VALUE_ULONG, &dev->inflight,
+                      "disk %s ios in progress", dev->name) == SENSOR_SUCCESS)
+        ++desc;
+    dev->nb_descs = desc - dev->descs;
+
+    return 1;
+}
+
+/* ************************************************************************ */
+/** family private data creation, sensor_desc_t are created by family_list() */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    disk_priv_t *   priv = (disk_priv_t *) family->priv;
+
+    priv->last_update_time.tv_usec = INT_MAX;
 
     if (sysdep_disk_init(family) != SENSOR_SUCCESS) {
         return SENSOR_ERROR;
@@ -78,6 +268,7 @@ static sensor_status_t init_private_data(sensor_family_t *family) {
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
 /** family-specific init */
 static sensor_status_t family_init(sensor_family_t *family) {
     // Sanity checks done before in sensor_init()
@@ -101,26 +292,132 @@ static sensor_status_t family_init(sensor_family_t *family) {
     return SENSOR_SUCCESS;
 }
 
-/** family-specific list */
+/* ************************************************************************ */
+/** family-specific list: descs follow the devices given by the sysdep */
 static slist_t * family_list(sensor_family_t *family) {
-    disk_priv_t *    priv = (disk_priv_t *) family->priv;
-    slist_t *           list = NULL;
+    disk_priv_t *   priv = (disk_priv_t *) family->priv;
+    slist_t *       list = NULL;
+
+    /* descs of devices dropped by previous list have been released. The ones of
+     * the new set of devices given by the sysdep are listed until libvsensors
+     * replaces them */
+    disk_free_dropped(priv);
+    disk_devices_swap(priv, 1);
+
+    if (init_descs(family) != SENSOR_SUCCESS) {
+        LOG_ERROR(family->log, "cannot initialize %s sensors", family->info->name);
+        return NULL;
+    }
 
     for (unsigned int i_desc = 0; priv->sensors_desc[i_desc].label; i_desc++) {
         list = slist_prepend(list, &priv->sensors_desc[i_desc]);
     }
+    for (unsigned int i = 0; i < priv->nb_devices; ++i) {
+        disk_device_t * dev = priv->devices[i];
+
+        init_device_descs(family, dev);
+        for (unsigned int i_desc = 0; i_desc < dev->nb_descs; ++i_desc) {
+            list = slist_prepend(list, &dev->descs[i_desc]);
+        }
+    }
     return list;
 }
 
+/* ************************************************************************ */
+/** family-specific list_delta: only the descs of plugged and unplugged devices
+ * are given, the ones of other devices and the global ones stay listed */
+static sensor_status_t family_list_delta(sensor_family_t *family,
+                                         slist_t ** p_added, slist_t ** p_removed) {
+    disk_priv_t *   priv = (disk_priv_t *) family->priv;
+    int             ret;
+
+    if (priv->sensors_desc == NULL) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if ((ret = disk_devices_swap(priv, 1)) <= 0) {
+        return ret == 0 ? SENSOR_SUCCESS : SENSOR_ERROR;
+    }
+    for (unsigned int i = 0; i < priv->nb_devices_dropped; ++i) {
+        disk_device_t * dev = priv->devices_dropped[i];
+
+        for (unsigned int i_desc = 0; i_desc < dev->nb_descs; ++i_desc) {
+            *p_removed = slist_prepend(*p_removed, &dev->descs[i_desc]);
+        }
+    }
+    for (unsigned int i = 0; i < priv->nb_devices; ++i) {
+        disk_device_t * dev = priv->devices[i];
+
+        if (init_device_descs(family, dev) == 0)
+            continue ;
+        for (unsigned int i_desc = 0; i_desc < dev->nb_descs; ++i_desc) {
+            *p_added = slist_prepend(*p_added, &dev->descs[i_desc]);
+        }
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** compute the rates of a device from its raw counters */
+static void disk_device_update(disk_device_t * dev, uint64_t now_ns) {
+    sensor_rate_t * rates = dev->rates;
+    double          ms_per_sec;
+
+    for (unsigned int i = 0; i < DISK_RATE_NB; ++i) {
+        sensor_rate_update(&(rates[i]), i <= DISK_RATE_WRITES ? &s_disk_rate_ops : &s_disk_rate_ms,
+                           dev->counters[i], now_ns);
+    }
+    dev->read_iops = sensor_rate_value(&(rates[DISK_RATE_READS]));
+    dev->write_iops = sensor_rate_value(&(rates[DISK_RATE_WRITES]));
+    /* ms spent per second divided by ops per second */
+    dev->read_latency = rates[DISK_RATE_READS].rate > 0.0
+                        ? rates[DISK_RATE_READ_MS].rate / rates[DISK_RATE_READS].rate : 0.0;
+    dev->write_latency = rates[DISK_RATE_WRITES].rate > 0.0
+                         ? rates[DISK_RATE_WRITE_MS].rate / rates[DISK_RATE_WRITES].rate : 0.0;
+    ms_per_sec = rates[DISK_RATE_IO_MS].rate;
+    dev->utilization = ms_per_sec >= 1000.0 ? 100 : (TYPE_SENSOR_VALUE_UCHAR) (ms_per_sec / 10.0 + 0.5);
+    dev->queue_depth = rates[DISK_RATE_WEIGHTED_MS].rate / 1000.0;
+}
+
+/* ************************************************************************ */
+/** retrieve all disk datas at once and compute their rates */
+static sensor_status_t disk_get(sensor_family_t * family, struct timeval * elapsed) {
+    disk_priv_t *       priv = (disk_priv_t *) family->priv;
+    disk_data_t *       data = &(priv->disk_data);
+    sensor_status_t     ret;
+    uint64_t            now_ns;
+
+    if ((ret = sysdep_disk_get(family, data, elapsed)) == SENSOR_ERROR
+    ||  sensor_now_ns(family->sctx, &now_ns) != SENSOR_SUCCESS) {
+        return ret;
+    }
+
+    sensor_rate_update(&(priv->rates[0]), &g_sensor_rate_conf64, data->ibytes, now_ns);
+    sensor_rate_update(&(priv->rates[1]), &g_sensor_rate_conf64, data->obytes, now_ns);
+    sensor_rate_update(&(priv->rates[2]), &g_sensor_rate_conf64, data->phy_ibytes, now_ns);
+    sensor_rate_update(&(priv->rates[3]), &g_sensor_rate_conf64, data->phy_obytes, now_ns);
+    data->ibytespersec      = sensor_rate_value(&(priv->rates[0]));
+    data->obytespersec      = sensor_rate_value(&(priv->rates[1]));
+    data->phy_ibytespersec  = sensor_rate_value(&(priv->rates[2]));
+    data->phy_obytespersec  = sensor_rate_value(&(priv->rates[3]));
+
+    for (unsigned int i = 0; i < priv->nb_devices; ++i) {
+        disk_device_update(priv->devices[i], now_ns);
+    }
+
+    return ret;
+}
+
+/* ************************************************************************ */
 /** family-specific update */
 static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
     /* Sanity checks are done in sensor_init and sensor_update_check() */
-    disk_priv_t * priv = (disk_priv_t *) sensor->desc->family->priv;
+    disk_priv_t *   priv = (disk_priv_t *) sensor->desc->family->priv;
+    sensor_status_t ret = SENSOR_SUCCESS;
 
     if (now == NULL) {
-        sysdep_disk_get(sensor->desc->family, &(priv->disk_data), NULL);
+        ret = disk_get(sensor->desc->family, NULL);
     } else if (priv->last_update_time.tv_usec == INT_MAX) {
-        sysdep_disk_get(sensor->desc->family, &(priv->disk_data), NULL);
+        ret = disk_get(sensor->desc->family, NULL);
         priv->last_update_time = *now;
     } else {
         /* Because all network datas are retrieved at once, don't repeat it for each sensor */
@@ -130,14 +427,39 @@ static sensor_status_t family_update(sensor_sample_t *sensor, const struct timev
         if (elapsed.tv_sec == 0 && elapsed.tv_usec < 1000)
             pelapsed = NULL;
         if (timercmp(&elapsed, &(sensor->watch->update_interval), >=)) {
-            sysdep_disk_get(sensor->desc->family, &(priv->disk_data), pelapsed);
+            ret = disk_get(sensor->desc->family, pelapsed);
             priv->last_update_time = *now;
         }
     }
+    /* the set of devices changed, descs must be listed again */
+    if (ret == SENSOR_RELOAD_FAMILY) {
+        return ret;
+    }
 
     /* Always update the sensor Value: we are called because sensor timeout expired.
      * and another sensor with different timeout could have updated global data */
-    return sensor_value_fromraw(sensor->desc->key, &sensor->value);
+    return SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->key, &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    sensor_status_t ret;
+    unsigned int    i;
+    (void) now;
+
+    /* all due samples of the family are given at once: retrieve disk datas only once,
+     * rates are computed on the sensor clock */
+    ret = disk_get(family, NULL);
+
+    for (i = 0; i < n; ++i) {
+        results[i] = ret == SENSOR_RELOAD_FAMILY ? SENSOR_RELOAD_FAMILY
+                     : SENSOR_DESC_FROMRAW(samples[i]->desc, samples[i]->desc->key,
+                                           &(samples[i]->value));
+    }
+    return SENSOR_SUCCESS;
 }
 
 const sensor_family_info_t g_sensor_family_disk = {
@@ -148,6 +470,9 @@ const sensor_family_info_t g_sensor_family_disk = {
     .list = family_list,
     .notify = NULL,
     .write = NULL,
-    .free_desc = NULL
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch,
+    .list_delta = family_list_delta
 };
 
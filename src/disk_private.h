@@ -23,6 +23,7 @@
 #define SENSOR_DISK_PRIVATE_H
 
 #include "disk.h"
+#include "sensor_rate.h"
 
 /** Internal struct where all network info is kept */
 typedef struct {
@@ -36,11 +37,61 @@ typedef struct {
     TYPE_SENSOR_VALUE_ULONG     phy_obytespersec;
 } disk_data_t;
 
+/** maximum size of a device name, including the terminating 0 */
+#define DISK_NAME_SZ            32
+
+/** number of descs for one disk_device_t */
+#define DISK_NB_DEVICE_DESCS    7
+
+/** raw counters of a device used to compute its rates */
+typedef enum {
+    DISK_RATE_READS = 0,
+    DISK_RATE_WRITES,
+    DISK_RATE_READ_MS,
+    DISK_RATE_WRITE_MS,
+    DISK_RATE_IO_MS,
+    DISK_RATE_WEIGHTED_MS,
+    DISK_RATE_NB
+} disk_rate_t;
+
+/** statistics of one disk device */
+typedef struct {
+    char                        name[DISK_NAME_SZ];
+    /* raw counters given by the sysdep (disk_rate_t): ops and ms spent */
+    uint64_t                    counters[DISK_RATE_NB];
+    TYPE_SENSOR_VALUE_ULONG     inflight;
+    /* computed by the family */
+    TYPE_SENSOR_VALUE_ULONG     read_iops;
+    TYPE_SENSOR_VALUE_ULONG     write_iops;
+    TYPE_SENSOR_VALUE_DOUBLE    read_latency;       /* ms per op */
+    TYPE_SENSOR_VALUE_DOUBLE    write_latency;      /* ms per op */
+    TYPE_SENSOR_VALUE_UCHAR     utilization;        /* % of time doing I/O */
+    TYPE_SENSOR_VALUE_DOUBLE    queue_depth;        /* average number of I/O in flight */
+    sensor_rate_t               rates[DISK_RATE_NB];
+    /* descs of the device, created when it is listed the first time: they
+     * point to this device which is not moved when the set of devices changes */
+    sensor_desc_t               descs[DISK_NB_DEVICE_DESCS];
+    unsigned int                nb_descs;
+} disk_device_t;
+
 /** private/specific disk family structure */
 typedef struct {
     sensor_desc_t *     sensors_desc;
     disk_data_t         disk_data;
-    disk_data_t *       partition_data;
+    disk_device_t **    devices;
+    unsigned int        nb_devices;
+    /* new set of devices given by the sysdep with SENSOR_RELOAD_FAMILY, sharing the
+     * devices kept from the current set. It replaces devices when sensors are
+     * listed again, incrementing devices_gen */
+    disk_device_t **    devices_next;
+    unsigned int        nb_devices_next;
+    unsigned int        devices_gen;
+    /* devices left by the last list_delta(): libvsensors releases their descs
+     * after it, they are freed on the next reload */
+    disk_device_t **    devices_dropped;
+    unsigned int        nb_devices_dropped;
+    /* rates of ibytes, obytes, phy_ibytes, phy_obytes */
+    sensor_rate_t       rates[4];
     struct timeval      last_update_time;
     void *              sysdep;
 } disk_priv_t;
@@ -55,6 +106,11 @@ sensor_status_t sysdep_disk_get (sensor_family_t * family,
 sensor_status_t sysdep_disk_init(sensor_family_t * family);
 sensor_status_t sysdep_disk_destroy(sensor_family_t * family);
 
+/** give a new set of devices to the family (see devices_next), the devices of the
+ * current set can be kept, other ones must be allocated with calloc() */
+void            disk_devices_set_next(disk_priv_t * priv,
+                                      disk_device_t ** devices, unsigned int nb_devices);
+
 #ifdef __cplusplus
 }
 #endif
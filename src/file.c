@@ -28,9 +28,6 @@
 
 /****************************************************************************/
 static void             file_watch_free(void * vfile);
-static sensor_status_t  file_watch_del(
-                            sensor_family_t * family,
-                            const char * path);
 static sensor_status_t  file_watch_add(
                             sensor_family_t * family,
                             const char * path,
@@ -42,36 +39,65 @@ static sensor_status_t family_free(sensor_family_t *family) {
     if (family->priv != NULL) {
         file_priv_t * priv = (file_priv_t *) family->priv;
 
-        slist_free(priv->files, file_watch_free);
-
+        /* no more events from the common thread before files are freed */
         sysdep_file_destroy(family);
 
+        slist_free(priv->files, file_watch_free);
+
+        pthread_mutex_destroy(&priv->mutex);
         family->priv = NULL;
         free(priv);
     }
     return SENSOR_SUCCESS;
 }
 
-/** family private data creation, including the sensor_desc_t data */
+/** family private data creation: files of FILE_PATHS_ENV are watched */
 static sensor_status_t init_private_data(sensor_family_t *family) {
-    file_priv_t * priv = (file_priv_t *) family->priv;;
-    (void)priv;
+    file_priv_t *   priv = (file_priv_t *) family->priv;
+    char *          paths, * path, * saveptr = NULL;
 
+    if (pthread_mutex_init(&priv->mutex, NULL) != 0) {
+        return SENSOR_ERROR;
+    }
     if (sysdep_file_init(family) != SENSOR_SUCCESS) {
         return SENSOR_ERROR;
     }
 
+    for (unsigned int i = 0; i < 2; ++i) {
+        const char *    env = getenv(i == 0 ? FILE_PATHS_ENV : FILE_TAIL_PATHS_ENV);
+        unsigned int    flags = i == 0 ? FF_NONE : FF_TAIL;
+
+        if (env == NULL)
+            continue ;
+        if ((paths = strdup(env)) == NULL) {
+            return SENSOR_ERROR;
+        }
+        for (path = strtok_r(paths, ":", &saveptr); path != NULL; path = strtok_r(NULL, ":", &saveptr)) {
+            if (*path != 0 && file_watch_add(family, path, flags) == SENSOR_SUCCESS) {
+                LOG_VERBOSE(family->log, "watching file %s%s", path, (flags & FF_TAIL) ? " (tail)" : "");
+            }
+        }
+        free(paths);
+    }
+
+    if (priv->files == NULL) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+
     return SENSOR_SUCCESS;
 }
 
 /** family-specific init */
 static sensor_status_t family_init(sensor_family_t *family) {
+    sensor_status_t ret;
+
     // Sanity checks done before in sensor_init()
     if (family->priv != NULL) {
         LOG_ERROR(family->log, "error: %s data already initialized", family->info->name);
         return SENSOR_ERROR;
     }
-    if (sysdep_file_support(family, NULL) != SENSOR_SUCCESS) {
+    if ((getenv(FILE_PATHS_ENV) == NULL && getenv(FILE_TAIL_PATHS_ENV) == NULL)
+    ||  sysdep_file_support(family, NULL) != SENSOR_SUCCESS) {
         return SENSOR_NOT_SUPPORTED;
     }
     if ((family->priv = calloc(1, sizeof(file_priv_t))) == NULL) {
@@ -79,49 +105,129 @@ static sensor_status_t family_init(sensor_family_t *family) {
         family_free(family);
         return SENSOR_ERROR;
     }
-    if (init_private_data(family) != SENSOR_SUCCESS) {
-        LOG_ERROR(family->log, "cannot initialize private %s data", family->info->name);
+    if ((ret = init_private_data(family)) != SENSOR_SUCCESS) {
+        if (ret != SENSOR_NOT_SUPPORTED)
+            LOG_ERROR(family->log, "cannot initialize private %s data", family->info->name);
         family_free(family);
-        return SENSOR_ERROR;
+        return ret;
     }
     return SENSOR_SUCCESS;
 }
 
 /** family-specific list */
 static slist_t * family_list(sensor_family_t *family) {
-    file_priv_t *    priv = (file_priv_t *) family->priv;
-    (void)priv;
-    return NULL;
+    file_priv_t *   priv = (file_priv_t *) family->priv;
+    slist_t *       list = NULL;
+
+    SLIST_FOREACH_DATA(priv->files, info, fileinfo_t *) {
+        for (unsigned int i = 0; i < FILE_SENSOR_NB; ++i) {
+            if (info->descs[i].label != NULL) {
+                list = slist_prepend(list, &(info->descs[i]));
+            }
+        }
+    }
+    return list;
 }
 
-/** family-specific update */
+/** give the bytes appended since last sample in the sample buffer, read in place.
+ * The tail follows the path: it starts again at 0 when the file was truncated,
+ * or when it was rotated (other inode). */
+static sensor_status_t file_tail_update(sensor_sample_t * sensor, fileinfo_t * info,
+                                        uint64_t size, uint64_t ino) {
+    sensor_value_t *    value = &(sensor->value);
+    uint64_t            len;
+    ssize_t             n;
+
+    if (ino != info->tail_ino) {
+        LOG_VERBOSE(sensor->desc->family->log, "%s rotated", info->name);
+        info->tail_ino = ino;
+        info->tail_offset = 0;
+    } else if (size < info->tail_offset) {
+        LOG_VERBOSE(sensor->desc->family->log, "%s truncated", info->name);
+        info->tail_offset = 0;
+    }
+    if ((len = size - info->tail_offset) > FILE_TAIL_MAXSZ) {
+        /* large jump: only the last bytes are read */
+        info->tail_offset = size - FILE_TAIL_MAXSZ;
+        len = FILE_TAIL_MAXSZ;
+    }
+    if (len == 0) {
+        if (value->data.b.size == 0)
+            return SENSOR_UNCHANGED;
+        value->data.b.size = 0;
+        return SENSOR_UPDATED;
+    }
+    /* previous content is not needed: no realloc() copy */
+    if (value->data.b.buf == NULL || value->data.b.maxsize < len) {
+        unsigned int maxsize = len < FILE_TAIL_BUFSZ_MIN ? FILE_TAIL_BUFSZ_MIN : len;
+
+        if (value->data.b.buf != NULL && value->data.b.maxsize > 0)
+            free(value->data.b.buf);
+        value->data.b.size = 0;
+        if ((value->data.b.buf = malloc(maxsize)) == NULL) {
+            value->data.b.maxsize = 0;
+            return SENSOR_ERROR;
+        }
+        value->data.b.maxsize = maxsize;
+    }
+    if ((n = sysdep_file_read(sensor->desc->family, info, value->data.b.buf, len, info->tail_offset)) < 0) {
+        value->data.b.size = 0;
+        return SENSOR_ERROR;
+    }
+    info->tail_offset += n;
+    value->data.b.size = n;
+
+    return SENSOR_UPDATED;
+}
+
+/** family-specific update: values only change when the sysdep got events */
 static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
     /* Sanity checks are done in sensor_init and sensor_update_check() */
-    file_priv_t * priv = (file_priv_t *) sensor->desc->family->priv;
-    (void)priv;
+    file_priv_t *   priv = (file_priv_t *) sensor->desc->family->priv;
+    fileinfo_t *    info = (fileinfo_t *) sensor->desc->key;
+    unsigned int    i_sensor = sensor->desc - info->descs;
+    unsigned int    gen = __atomic_load_n(&(info->gen), __ATOMIC_ACQUIRE);
+    uint64_t        size, ino;
+    int64_t         mtime;
     (void)now;
-    return SENSOR_ERROR;
-}
-
-/** family-specific notify */
-static sensor_status_t sensor_family_notify(
-                    unsigned int event, struct sensor_family_s * family,
-                    struct sensor_sample_s * sample, sensor_watch_ev_data_t * ev_data) {
-    sensor_status_t ret = SENSOR_SUCCESS;
-    (void)sample;
-    (void)ev_data;
 
-    if ((event & (SWE_WATCH_DELETING | SWE_WATCH_REPLACED)) != 0) {
-        // TODO
-        ret = file_watch_del(family, NULL); // TODO
+    if (gen == info->seen[i_sensor]) {
+        /* nothing appended since last sample */
+        if (i_sensor == FILE_SENSOR_APPENDED && info->appended != 0) {
+            info->appended = 0;
+            return sensor_value_fromraw(&(info->appended), &sensor->value);
+        }
+        if (i_sensor == FILE_SENSOR_TAIL && sensor->value.data.b.size != 0) {
+            sensor->value.data.b.size = 0;
+            return SENSOR_UPDATED;
+        }
+        return SENSOR_UNCHANGED;
     }
+    info->seen[i_sensor] = gen;
 
-    if ((event & (SWE_WATCH_ADDED | SWE_WATCH_REPLACED)) != 0) {
-        // TODO
-        ret = file_watch_add(family, NULL, 0); // TODO
-    }
+    pthread_mutex_lock(&priv->mutex);
+    size = info->size;
+    mtime = info->mtime;
+    ino = info->ino;
+    pthread_mutex_unlock(&priv->mutex);
 
-    return ret;
+    switch (i_sensor) {
+        case FILE_SENSOR_SIZE:
+            info->sample_size = size;
+            return sensor_value_fromraw(&(info->sample_size), &sensor->value);
+        case FILE_SENSOR_MTIME:
+            info->sample_mtime = mtime;
+            return sensor_value_fromraw(&(info->sample_mtime), &sensor->value);
+        case FILE_SENSOR_APPENDED:
+            /* a truncated file starts again from its new size */
+            info->appended = size >= info->appended_base ? size - info->appended_base : 0;
+            info->appended_base = size;
+            return sensor_value_fromraw(&(info->appended), &sensor->value);
+        case FILE_SENSOR_TAIL:
+            return file_tail_update(sensor, info, size, ino);
+        default:
+            return SENSOR_ERROR;
+    }
 }
 
 // ***************************************************************************
@@ -131,7 +237,7 @@ const sensor_family_info_t g_sensor_family_file = {
     .free = family_free,
     .update = family_update,
     .list = family_list,
-    .notify = sensor_family_notify,
+    .notify = NULL,
     .write = NULL,
     .free_desc = NULL
 };
@@ -142,17 +248,43 @@ static void file_watch_free(void * vfile) {
 
     if (file) {
         sysdep_file_watch_free(file);
+        for (unsigned int i = 0; i < FILE_SENSOR_NB; ++i) {
+            if (file->descs[i].label != NULL)
+                free((void *) file->descs[i].label);
+        }
         if (file->name)
             free(file->name);
         free(file);
     }
 }
 
+// ***************************************************************************
+static sensor_status_t file_init_desc(
+                            sensor_family_t *       family,
+                            fileinfo_t *            info,
+                            file_sensor_t           i_sensor,
+                            sensor_value_type_t     type,
+                            const char *            fmt_label) {
+    sensor_desc_t * desc = &(info->descs[i_sensor]);
+    char *          label;
+
+    if (asprintf(&label, fmt_label, info->name) < 0) {
+        return SENSOR_ERROR;
+    }
+    desc->label = label;
+    desc->type = type;
+    desc->family = family;
+    desc->key = info;
+    desc->properties = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
 // ***************************************************************************
 static sensor_status_t file_watch_add(sensor_family_t * family, const char * path, unsigned int flags) {
     file_priv_t *   priv = (family->priv);
     fileinfo_t *    info;
-    (void)flags;
+    slist_t *       files;
 
     if ((info = calloc(1, sizeof(*info))) == NULL) {
         return SENSOR_ERROR;
@@ -161,35 +293,37 @@ static sensor_status_t file_watch_add(sensor_family_t * family, const char * pat
     info->flags = flags;
     info->name = NULL;
 
-    if (path == NULL || (info->name = strdup(path)) == NULL) {
+    if (path == NULL || (info->name = strdup(path)) == NULL
+    ||  file_init_desc(family, info, FILE_SENSOR_SIZE, SENSOR_VALUE_UINT64, "file %s size") != SENSOR_SUCCESS
+    ||  file_init_desc(family, info, FILE_SENSOR_MTIME, SENSOR_VALUE_INT64, "file %s mtime") != SENSOR_SUCCESS
+    ||  file_init_desc(family, info, FILE_SENSOR_APPENDED, SENSOR_VALUE_UINT64,
+                       "file %s appended bytes") != SENSOR_SUCCESS
+    ||  ((flags & FF_TAIL) != 0
+         && file_init_desc(family, info, FILE_SENSOR_TAIL, SENSOR_VALUE_BYTES,
+                           "file %s tail") != SENSOR_SUCCESS)) {
         file_watch_free(info);
         return SENSOR_ERROR;
     }
+    /* the sysdep thread looks up files by their watch: add it under the lock */
+    pthread_mutex_lock(&priv->mutex);
     if (sysdep_file_watch_add(family, info) != SENSOR_SUCCESS) {
+        pthread_mutex_unlock(&priv->mutex);
         LOG_WARN(family->log, "%s(%s): %s", __func__, info->name, strerror(errno));
         file_watch_free(info);
         return SENSOR_ERROR;
     }
-    if ((priv->files = slist_prepend(priv->files, info)) == NULL) {
+    /* the tail starts at the end of the file */
+    info->appended_base = info->size;
+    info->tail_offset = info->size;
+    info->tail_ino = info->ino;
+    if ((files = slist_prepend(priv->files, info)) == NULL) {
+        sysdep_file_watch_del(family, info);
+        pthread_mutex_unlock(&priv->mutex);
         file_watch_free(info);
         return SENSOR_ERROR;
     }
-    return SENSOR_SUCCESS;
-}
-
-// ***************************************************************************
-static sensor_status_t  file_watch_del(
-                            sensor_family_t * family,
-                            const char * path) {
-    file_priv_t *   priv = (family->priv);
-    fileinfo_t      ref_info;
-
-    ref_info.name = (char *) path;
-    errno = 0;
-    priv->files = slist_remove(priv->files, &ref_info, NULL, file_watch_free); // TODO
-    if (errno != 0) {
-        return SENSOR_ERROR;
-    }
+    priv->files = files;
+    pthread_mutex_unlock(&priv->mutex);
 
     return SENSOR_SUCCESS;
 }
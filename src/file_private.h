@@ -22,21 +22,66 @@
 #ifndef SENSOR_FILE_PRIVATE_H
 #define SENSOR_FILE_PRIVATE_H
 
+#include <pthread.h>
+
 #include "vlib/slist.h"
 
 #include "file.h"
 
+/** list of paths to watch, separated by ':' */
+#define FILE_PATHS_ENV      "VSENSORS_FILES"
+/** list of paths to watch and follow (tail sensor), separated by ':' */
+#define FILE_TAIL_PATHS_ENV "VSENSORS_TAIL_FILES"
+
+/** maximum bytes given by a tail sample, older appended bytes are skipped */
+#ifndef FILE_TAIL_MAXSZ
+#define FILE_TAIL_MAXSZ     (64 * 1024)
+#endif
+/** minimum size of the tail sample buffer */
+#define FILE_TAIL_BUFSZ_MIN 4096
+
+/** fileinfo_t flags */
+typedef enum {
+    FF_NONE         = 0,
+    FF_TAIL         = 1 << 0,   /* appended bytes are given by the tail sensor */
+} file_flag_t;
+
+/** sensors of a watched file */
+typedef enum {
+    FILE_SENSOR_SIZE = 0,
+    FILE_SENSOR_MTIME,
+    FILE_SENSOR_APPENDED,
+    FILE_SENSOR_TAIL,
+    FILE_SENSOR_NB
+} file_sensor_t;
+
 /** per file watch info */
 typedef struct {
-    char *          name;
-    unsigned int    flags;
-    void *          sysdep;
+    char *                      name;
+    unsigned int                flags;
+    /* written by the sysdep under file_priv_t.mutex when events changed the file,
+     * gen is incremented after that and can be read without lock */
+    uint64_t                    size;
+    int64_t                     mtime;
+    uint64_t                    ino;        /* changes when the path is rotated */
+    unsigned int                gen;
+    /* family side: values of samples, gen of last update of each sensor */
+    sensor_desc_t               descs[FILE_SENSOR_NB];
+    TYPE_SENSOR_VALUE_UINT64    sample_size;
+    TYPE_SENSOR_VALUE_INT64     sample_mtime;
+    TYPE_SENSOR_VALUE_UINT64    appended;   /* bytes appended since last sample */
+    uint64_t                    appended_base;
+    uint64_t                    tail_offset;
+    uint64_t                    tail_ino;
+    unsigned int                seen[FILE_SENSOR_NB];
+    void *                      sysdep;
 } fileinfo_t;
 
 /** private/specific file family structure */
 typedef struct {
-    slist_t *   files; /* of fileinfo_t * */
-    void *      sysdep;
+    slist_t *       files; /* of fileinfo_t * */
+    pthread_mutex_t mutex;
+    void *          sysdep;
 } file_priv_t;
 
 #ifdef __cplusplus
@@ -49,6 +94,9 @@ sensor_status_t sysdep_file_destroy(sensor_family_t * family);
 void            sysdep_file_watch_free(void * vfile);
 sensor_status_t sysdep_file_watch_add(sensor_family_t * family, fileinfo_t * file);
 sensor_status_t sysdep_file_watch_del(sensor_family_t * family, fileinfo_t * file);
+/** read the current file at offset, -1 on error */
+ssize_t         sysdep_file_read(sensor_family_t * family, fileinfo_t * file,
+                                 void * buf, size_t size, uint64_t offset);
 
 #ifdef __cplusplus
 }
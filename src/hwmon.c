@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * hwmon sensors for Generic Sensor Management Library.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+
+#include "hwmon.h"
+#include "hwmon_private.h"
+
+/** label suffix and divisor of raw sysfs values, indexed by hwmon_kind_t:
+ * temp in millidegree Celsius, fan in RPM, in in mV, power in uW, curr in mA */
+static const struct {
+    const char *    unit;
+    double          divisor;
+} s_hwmon_kinds[HWMON_NB] = {
+    { "celsius",    1000.0 },
+    { "rpm",        1.0 },
+    { "volts",      1000.0 },
+    { "watts",      1000000.0 },
+    { "amps",       1000.0 },
+};
+
+/* ************************************************************************ */
+static void hwmon_free_descs(hwmon_priv_t * priv) {
+    if (priv->sensors_desc != NULL) {
+        sensor_desc_t * desc;
+        for (desc = priv->sensors_desc; desc->label != NULL; ++desc)
+            free((void*) desc->label);
+        free(priv->sensors_desc);
+        priv->sensors_desc = NULL;
+    }
+}
+
+/* ************************************************************************ */
+/** family-specific free */
+static sensor_status_t family_free(sensor_family_t *family) {
+    if (family->priv != NULL) {
+        hwmon_priv_t * priv = (hwmon_priv_t *) family->priv;
+
+        sysdep_hwmon_destroy(family);
+        hwmon_free_descs(priv);
+        if (priv->sensors != NULL)
+            free(priv->sensors);
+        family->priv = NULL;
+        free(priv);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            sensor_value_type_t     type,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) __attribute__((format(printf, 5, 6)));
+
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            sensor_value_type_t     type,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) {
+    va_list valist;
+    char *  label = NULL;
+
+    va_start(valist, fmt_label);
+    if (vasprintf(&label, fmt_label, valist) < 0)
+        label = NULL;
+    va_end(valist);
+
+    if (label == NULL || sysdep_hwmon_support(family, label) != SENSOR_SUCCESS) {
+        if (label != NULL)
+            free(label);
+        return SENSOR_ERROR;
+    }
+
+    desc->label = label;
+    desc->type = type;
+    desc->family = family;
+    desc->key = key;
+    desc->properties = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the sensor_desc_t data of inputs given by the sysdep */
+static sensor_status_t init_descs(sensor_family_t *family) {
+    hwmon_priv_t *      priv = (hwmon_priv_t *) family->priv;
+    sensor_desc_t *     desc;
+
+    hwmon_free_descs(priv);
+
+    if ((priv->sensors_desc = calloc(priv->nb_sensors + 1/*NULL*/,
+                                     sizeof(*priv->sensors_desc))) == NULL) {
+        return SENSOR_ERROR;
+    }
+
+    desc = priv->sensors_desc;
+
+    for (unsigned int i = 0; i < priv->nb_sensors; ++i) {
+        hwmon_sensor_t * sensor = &(priv->sensors[i]);
+
+        if (init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &sensor->value,
+                          "%s %s", sensor->name, s_hwmon_kinds[sensor->kind].unit) == SENSOR_SUCCESS)
+            ++desc;
+    }
+    desc->label = NULL;
+    desc->key = NULL;
+    desc->family = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family private data creation, including the sensor_desc_t data */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    hwmon_priv_t *  priv = (hwmon_priv_t *) family->priv;
+
+    priv->last_update_time.tv_usec = INT_MAX;
+
+    if (sysdep_hwmon_init(family) != SENSOR_SUCCESS) {
+        return SENSOR_ERROR;
+    }
+    if (priv->nb_sensors == 0) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+
+    return init_descs(family);
+}
+
+/* ************************************************************************ */
+/** family-specific init */
+static sensor_status_t family_init(sensor_family_t *family) {
+    sensor_status_t ret;
+
+    // Sanity checks done before in sensor_init()
+    if (family->priv != NULL) {
+        LOG_ERROR(family->log, "error: %s data already initialized", family->info->name);
+        return SENSOR_ERROR;
+    }
+    if (sysdep_hwmon_support(family, NULL) != SENSOR_SUCCESS) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if ((family->priv = calloc(1, sizeof(hwmon_priv_t))) == NULL) {
+        LOG_ERROR(family->log, "cannot allocate private %s data", family->info->name);
+        family_free(family);
+        return SENSOR_ERROR;
+    }
+    if ((ret = init_private_data(family)) != SENSOR_SUCCESS) {
+        if (ret != SENSOR_NOT_SUPPORTED)
+            LOG_ERROR(family->log, "cannot initialize private %s data", family->info->name);
+        family_free(family);
+        return ret;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family-specific list */
+static slist_t * family_list(sensor_family_t *family) {
+    hwmon_priv_t *  priv = (hwmon_priv_t *) family->priv;
+    slist_t *       list = NULL;
+
+    for (unsigned int i_desc = 0; priv->sensors_desc[i_desc].label; i_desc++) {
+        list = slist_prepend(list, &priv->sensors_desc[i_desc]);
+    }
+    return list;
+}
+
+/* ************************************************************************ */
+/** read all hwmon inputs at once and convert them */
+static sensor_status_t hwmon_get(sensor_family_t * family) {
+    hwmon_priv_t *      priv = (hwmon_priv_t *) family->priv;
+    sensor_status_t     ret;
+
+    if ((ret = sysdep_hwmon_get(family)) == SENSOR_ERROR) {
+        return ret;
+    }
+
+    for (unsigned int i = 0; i < priv->nb_sensors; ++i) {
+        hwmon_sensor_t * sensor = &(priv->sensors[i]);
+
+        sensor->value = sensor->raw / s_hwmon_kinds[sensor->kind].divisor;
+    }
+
+    return ret;
+}
+
+/* ************************************************************************ */
+/** family-specific update */
+static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
+    /* Sanity checks are done in sensor_init and sensor_update_check() */
+    hwmon_priv_t *  priv = (hwmon_priv_t *) sensor->desc->family->priv;
+
+    if (now == NULL || priv->last_update_time.tv_usec == INT_MAX) {
+        hwmon_get(sensor->desc->family);
+        if (now != NULL)
+            priv->last_update_time = *now;
+    } else {
+        /* all hwmon inputs are retrieved at once, don't repeat it for each sensor */
+        struct timeval  elapsed;
+
+        timersub(now, &(priv->last_update_time), &elapsed);
+        if (timercmp(&elapsed, &(sensor->watch->update_interval), >=)) {
+            hwmon_get(sensor->desc->family);
+            priv->last_update_time = *now;
+        }
+    }
+
+    /* Always update the sensor Value: we are called because sensor timeout expired.
+     * and another sensor with different timeout could have updated global data */
+    return SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->key, &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    hwmon_priv_t *  priv = (hwmon_priv_t *) family->priv;
+
+    /* all due samples are given at once: read hwmon inputs only once */
+    hwmon_get(family);
+    if (now != NULL) {
+        priv->last_update_time = *now;
+    }
+
+    for (unsigned int i = 0; i < n; ++i) {
+        results[i] = SENSOR_DESC_FROMRAW(samples[i]->desc, samples[i]->desc->key,
+                                         &(samples[i]->value));
+    }
+    return SENSOR_SUCCESS;
+}
+
+const sensor_family_info_t g_sensor_family_hwmon = {
+    .name = "hwmon",
+    .init = family_init,
+    .free = family_free,
+    .update = family_update,
+    .list = family_list,
+    .notify = NULL,
+    .write = NULL,
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch
+};
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * hwmon sensors for Generic Sensor Management Library.
+ */
+#ifndef SENSOR_HWMON_PRIVATE_H
+#define SENSOR_HWMON_PRIVATE_H
+
+#include "hwmon.h"
+
+/** maximum size of a hwmon sensor name ("<chip> <label>"), including the terminating 0 */
+#define HWMON_NAME_SZ           96
+
+/** kinds of hwmon inputs, see hwmon.c for units */
+typedef enum {
+    HWMON_TEMP = 0,
+    HWMON_FAN,
+    HWMON_IN,
+    HWMON_POWER,
+    HWMON_CURR,
+    HWMON_NB
+} hwmon_kind_t;
+
+/** one hwmon input, raw is set by the sysdep */
+typedef struct {
+    char                        name[HWMON_NAME_SZ];
+    hwmon_kind_t                kind;
+    long long                   raw;
+    TYPE_SENSOR_VALUE_DOUBLE    value;
+} hwmon_sensor_t;
+
+/** private/specific hwmon family structure */
+typedef struct {
+    sensor_desc_t *     sensors_desc;
+    /* set built by sysdep_hwmon_init() */
+    hwmon_sensor_t *    sensors;
+    unsigned int        nb_sensors;
+    struct timeval      last_update_time;
+    void *              sysdep;
+} hwmon_priv_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sensor_status_t sysdep_hwmon_support(sensor_family_t * family, const char * label);
+sensor_status_t sysdep_hwmon_init(sensor_family_t * family);
+sensor_status_t sysdep_hwmon_get(sensor_family_t * family);
+sensor_status_t sysdep_hwmon_destroy(sensor_family_t * family);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifdef SENSOR_HWMON_PRIVATE_H
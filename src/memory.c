@@ -54,42 +54,61 @@ static sensor_status_t family_free(sensor_family_t *family) {
 /** family private data creation, including the sensor_desc_t data */
 static sensor_status_t init_private_data(sensor_family_t *family) {
     memory_priv_t * priv = (memory_priv_t *) family->priv;
+    memory_data_t * data = &(priv->memory_data);
     unsigned int    n_desc = 0;
     // Not Pretty but allows to have an initiliazed array with dynamic values.
-    sensor_desc_t   sensors_desc[] = {
-        { &priv->memory_data.active,    "active memory",    NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.inactive,  "inactive memory",  NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.wired,     "wired memory",     NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.free,      "free memory",      NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.used,      "used memory",      NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.total,     "total memory",     NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.used_percent,"used memory %",  NULL, SENSOR_VALUE_UCHAR, family },
-        { &priv->memory_data.total_swap,"swap total",       NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.used_swap, "swap used",        NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.free_swap, "swap free",        NULL, SENSOR_VALUE_ULONG, family },
-        { &priv->memory_data.used_swap_percent,"swap used %",NULL,SENSOR_VALUE_UCHAR, family },
-        { NULL, NULL, NULL, 0, NULL },
+    struct { sensor_desc_t desc; unsigned int extra; } sensors_desc[] = {
+        { { &data->active,          "active memory",    NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->inactive,        "inactive memory",  NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->wired,           "wired memory",     NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->free,            "free memory",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->used,            "used memory",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->total,           "total memory",     NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->used_percent,    "used memory %",    NULL, SENSOR_VALUE_UCHAR, family, NULL, NULL }, 0 },
+        { { &data->total_swap,      "swap total",       NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->used_swap,       "swap used",        NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->free_swap,       "swap free",        NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, 0 },
+        { { &data->used_swap_percent,"swap used %",     NULL, SENSOR_VALUE_UCHAR, family, NULL, NULL }, 0 },
+        { { &data->available,       "available memory", NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_DETAILS },
+        { { &data->cached,          "cached memory",    NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_DETAILS },
+        { { &data->buffers,         "buffers memory",   NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_DETAILS },
+        { { &data->slab,            "slab memory",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_DETAILS },
+        { { &data->hugepages_total, "hugepages total",  NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_HUGEPAGES },
+        { { &data->hugepages_free,  "hugepages free",   NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_HUGEPAGES },
+        { { &data->hugepages_reserved,"hugepages reserved",NULL,SENSOR_VALUE_ULONG,family, NULL, NULL }, MEM_EXTRA_HUGEPAGES },
+        { { &data->hugepages_surplus,"hugepages surplus",NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_HUGEPAGES },
+        { { &data->hugepage_size,   "hugepage size",    NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_HUGEPAGES },
+        { { &data->cgroup_current,  "cgroup memory",    NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_max,      "cgroup memory max",NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_used_percent,"cgroup memory %",NULL,SENSOR_VALUE_UCHAR, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_anon,     "cgroup anon",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_file,     "cgroup file",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_kernel,   "cgroup kernel",    NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_slab,     "cgroup slab",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_shmem,    "cgroup shmem",     NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
+        { { &data->cgroup_sock,     "cgroup sock",      NULL, SENSOR_VALUE_ULONG, family, NULL, NULL }, MEM_EXTRA_CGROUP },
     };
     priv->last_update_time.tv_usec = INT_MAX;
 
+    /* sysdep is initialized first as it tells which memory_extra_t are available */
+    if (sysdep_memory_init(family) != SENSOR_SUCCESS) {
+        LOG_ERROR(family->log, "cannot initialize sysdep %s data", family->info->name);
+        family_free(family);
+        return SENSOR_ERROR;
+    }
+
     if ((priv->sensors_desc
-            = calloc(sizeof(sensors_desc) / sizeof(*sensors_desc), sizeof(*sensors_desc))) == NULL) {
+            = calloc(sizeof(sensors_desc) / sizeof(*sensors_desc) + 1, sizeof(*priv->sensors_desc))) == NULL) {
         return SENSOR_ERROR;
     }
-    for (unsigned i = 0; i < sizeof(sensors_desc) / sizeof(*sensors_desc)
-                && sensors_desc[i].label != NULL; ++i) {
-        if (sysdep_memory_support(family, sensors_desc[i].label) == SENSOR_SUCCESS) {
-            priv->sensors_desc[n_desc++] = sensors_desc[i];
+    for (unsigned i = 0; i < sizeof(sensors_desc) / sizeof(*sensors_desc); ++i) {
+        if ((sensors_desc[i].extra & ~priv->extras) == 0
+        &&  sysdep_memory_support(family, sensors_desc[i].desc.label) == SENSOR_SUCCESS) {
+            priv->sensors_desc[n_desc++] = sensors_desc[i].desc;
         }
     }
     memset(&(priv->sensors_desc[n_desc]), 0, sizeof(priv->sensors_desc[n_desc]));
 
-    if (sysdep_memory_init(family) != SENSOR_SUCCESS) {
-        LOG_ERROR(family->log, "cannot initialize sysdep %s data", family->info->name);
-        family_free(family);
-        return SENSOR_ERROR;
-    }
-
     return SENSOR_SUCCESS;
 }
 
@@ -151,7 +170,28 @@ static sensor_status_t family_update(sensor_sample_t *sensor,
 
     /* Always update the sensor Value: we are called because sensor timeout expired.
      * and another sensor with different timeout could have updated global data */
-    return sensor_value_fromraw(sensor->desc->key, &sensor->value);
+    return SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->key, &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    memory_priv_t * priv = (memory_priv_t *) family->priv;
+    unsigned int    i;
+
+    /* all due samples are given at once: retrieve memory datas only once */
+    sysdep_memory_get(family, &(priv->memory_data));
+    if (now != NULL) {
+        priv->last_update_time = *now;
+    }
+
+    for (i = 0; i < n; ++i) {
+        results[i] = SENSOR_DESC_FROMRAW(samples[i]->desc, samples[i]->desc->key,
+                                         &(samples[i]->value));
+    }
+    return SENSOR_SUCCESS;
 }
 
 /** family-specific information */
@@ -163,7 +203,9 @@ const sensor_family_info_t g_sensor_family_memory = {
     .list = family_list,
     .notify = NULL,
     .write = NULL,
-    .free_desc = NULL
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch
 };
 
 #if 0
@@ -41,13 +41,43 @@ typedef struct {
     TYPE_SENSOR_VALUE_ULONG     used_swap;
     TYPE_SENSOR_VALUE_ULONG     free_swap;
     TYPE_SENSOR_VALUE_UCHAR     used_swap_percent;
+    /* MEM_EXTRA_DETAILS */
+    TYPE_SENSOR_VALUE_ULONG     available;
+    TYPE_SENSOR_VALUE_ULONG     cached;
+    TYPE_SENSOR_VALUE_ULONG     buffers;
+    TYPE_SENSOR_VALUE_ULONG     slab;
+    /* MEM_EXTRA_HUGEPAGES */
+    TYPE_SENSOR_VALUE_ULONG     hugepages_total;    /* number of pages */
+    TYPE_SENSOR_VALUE_ULONG     hugepages_free;
+    TYPE_SENSOR_VALUE_ULONG     hugepages_reserved;
+    TYPE_SENSOR_VALUE_ULONG     hugepages_surplus;
+    TYPE_SENSOR_VALUE_ULONG     hugepage_size;      /* bytes */
+    /* MEM_EXTRA_CGROUP: memory controller of our cgroup */
+    TYPE_SENSOR_VALUE_ULONG     cgroup_current;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_max;         /* total if unlimited */
+    TYPE_SENSOR_VALUE_UCHAR     cgroup_used_percent;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_anon;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_file;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_kernel;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_slab;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_shmem;
+    TYPE_SENSOR_VALUE_ULONG     cgroup_sock;
 } memory_data_t;
 
+/** optional memory_data_t fields, set by sysdep_memory_init() in memory_priv_t.extras */
+typedef enum {
+    MEM_EXTRA_NONE      = 0,
+    MEM_EXTRA_DETAILS   = 1 << 0,
+    MEM_EXTRA_HUGEPAGES = 1 << 1,
+    MEM_EXTRA_CGROUP    = 1 << 2
+} memory_extra_t;
+
 /** private/specific family structure */
 typedef struct {
     sensor_desc_t *     sensors_desc;
     memory_data_t       memory_data;
     struct timeval      last_update_time;
+    unsigned int        extras;         /* memory_extra_t */
     void *              sysdep;
 } memory_priv_t;
 
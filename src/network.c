@@ -23,53 +23,151 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdarg.h>
 
 #include "network.h"
 #include "network_private.h"
 
+/** number of descs for one network_iface_t */
+#define NETWORK_NB_IFACE_DESCS  8
+
+/* ************************************************************************ */
+static void network_free_descs(sensor_desc_t ** pdescs) {
+    if (*pdescs != NULL) {
+        sensor_desc_t * desc;
+        for (desc = *pdescs; desc->label != NULL; ++desc)
+            free((void*) desc->label);
+        free(*pdescs);
+        *pdescs = NULL;
+    }
+}
+
+/* ************************************************************************ */
 /** family-specific free */
 static sensor_status_t family_free(sensor_family_t *family) {
     if (family->priv != NULL) {
         network_priv_t * priv = (network_priv_t *) family->priv;
 
         sysdep_network_destroy(family);
-        if (priv->sensors_desc != NULL)
-            free (priv->sensors_desc);
+        network_free_descs(&(priv->sensors_desc));
+        network_free_descs(&(priv->retired_desc));
+        if (priv->iface_data != NULL)
+            free(priv->iface_data);
+        if (priv->iface_next != NULL)
+            free(priv->iface_next);
         family->priv = NULL;
         free(priv);
     }
     return SENSOR_SUCCESS;
 }
 
-/** family private data creation, including the sensor_desc_t data */
-static sensor_status_t init_private_data(sensor_family_t *family) {
-    network_priv_t * priv = (network_priv_t *) family->priv;;
-    // Not Pretty but allows to have an initiliazed array with dynamic values.
-    sensor_desc_t sensors_desc[] = {
-        { &priv->network_data.obytes,           "network all out bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.ibytes,           "network all in bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.phy_obytes,       "network out bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.phy_ibytes,       "network in bytes",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.obytespersec,     "network all out bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.ibytespersec,     "network all in bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.phy_obytespersec, "network out bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { &priv->network_data.phy_ibytespersec, "network in bytes/sec",
-          NULL, SENSOR_VALUE_ULONG,  family },
-        { NULL, NULL, NULL, 0, NULL },
+/* ************************************************************************ */
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) __attribute__((format(printf, 4, 5)));
+
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) {
+    va_list valist;
+    char *  label = NULL;
+
+    va_start(valist, fmt_label);
+    if (vasprintf(&label, fmt_label, valist) < 0)
+        label = NULL;
+    va_end(valist);
+
+    if (label == NULL || sysdep_network_support(family, label) != SENSOR_SUCCESS) {
+        if (label != NULL)
+            free(label);
+        return SENSOR_ERROR;
+    }
+
+    desc->label = label;
+    desc->type = SENSOR_VALUE_ULONG;
+    desc->family = family;
+    desc->key = key;
+    desc->properties = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** (re)create the sensor_desc_t data for the global counters and the current
+ * set of interfaces. This is done when sensors are listed, at init and
+ * on SENSOR_RELOAD_FAMILY */
+static sensor_status_t init_descs(sensor_family_t *family) {
+    network_priv_t *    priv = (network_priv_t *) family->priv;
+    network_data_t *    data = &(priv->network_data);
+    sensor_desc_t *     desc;
+    const struct { void * key; const char * label; } globals[] = {
+        { &data->obytes,            "network all out bytes" },
+        { &data->ibytes,            "network all in bytes" },
+        { &data->phy_obytes,        "network out bytes" },
+        { &data->phy_ibytes,        "network in bytes" },
+        { &data->obytespersec,      "network all out bytes/sec" },
+        { &data->ibytespersec,      "network all in bytes/sec" },
+        { &data->phy_obytespersec,  "network out bytes/sec" },
+        { &data->phy_ibytespersec,  "network in bytes/sec" },
     };
-    priv->last_update_time.tv_usec = INT_MAX;
-    if ((priv->sensors_desc
-            = calloc(sizeof(sensors_desc) / sizeof(*sensors_desc), sizeof(*sensors_desc))) == NULL) {
+
+    /* the listed descs are used until libvsensors replaces them during a reload,
+     * they are freed by the next list() */
+    network_free_descs(&(priv->retired_desc));
+    priv->retired_desc = priv->sensors_desc;
+    priv->sensors_desc = NULL;
+
+    if ((priv->sensors_desc = calloc(sizeof(globals) / sizeof(*globals)
+                                     + priv->nb_ifaces * NETWORK_NB_IFACE_DESCS + 1/*NULL*/,
+                                     sizeof(*priv->sensors_desc))) == NULL) {
         return SENSOR_ERROR;
     }
-    memcpy(priv->sensors_desc, sensors_desc, sizeof(sensors_desc));
+
+    desc = priv->sensors_desc;
+
+    for (unsigned int i = 0; i < sizeof(globals) / sizeof(*globals); ++i) {
+        if (init_one_desc(family, desc, globals[i].key, "%s", globals[i].label) == SENSOR_SUCCESS)
+            ++desc;
+    }
+    for (unsigned int i = 0; i < priv->nb_ifaces; ++i) {
+        network_iface_t * iface = &(priv->iface_data[i]);
+
+        if (init_one_desc(family, desc, &iface->obytes, "network %s out bytes", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->ibytes, "network %s in bytes", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->opackets, "network %s out packets", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->ipackets, "network %s in packets", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->oerrors, "network %s out errors", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->ierrors, "network %s in errors", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->odrops, "network %s out drops", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, &iface->idrops, "network %s in drops", iface->name) == SENSOR_SUCCESS)
+            ++desc;
+    }
+    desc->label = NULL;
+    desc->key = NULL;
+    desc->family = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family private data creation, sensor_desc_t are created by family_list() */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    network_priv_t * priv = (network_priv_t *) family->priv;
+
+    priv->last_update_time.tv_usec = INT_MAX;
 
     if (sysdep_network_init(family) != SENSOR_SUCCESS) {
         return SENSOR_ERROR;
@@ -78,6 +176,7 @@ static sensor_status_t init_private_data(sensor_family_t *family) {
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
 /** family-specific init */
 static sensor_status_t family_init(sensor_family_t *family) {
     // Sanity checks done before in sensor_init()
@@ -101,26 +200,68 @@ static sensor_status_t family_init(sensor_family_t *family) {
     return SENSOR_SUCCESS;
 }
 
-/** family-specific list */
+/* ************************************************************************ */
+/** family-specific list: descs follow the interfaces given by the sysdep */
 static slist_t * family_list(sensor_family_t *family) {
     network_priv_t *    priv = (network_priv_t *) family->priv;
     slist_t *           list = NULL;
 
+    /* the sysdep gave a new set of interfaces, old descs are not used anymore */
+    if (priv->iface_next != NULL) {
+        if (priv->iface_data != NULL)
+            free(priv->iface_data);
+        priv->iface_data = priv->iface_next;
+        priv->nb_ifaces = priv->nb_ifaces_next;
+        priv->iface_next = NULL;
+        priv->nb_ifaces_next = 0;
+    }
+    if (init_descs(family) != SENSOR_SUCCESS) {
+        LOG_ERROR(family->log, "cannot initialize %s sensors", family->info->name);
+        return NULL;
+    }
+
     for (unsigned int i_desc = 0; priv->sensors_desc[i_desc].label; i_desc++) {
         list = slist_prepend(list, &priv->sensors_desc[i_desc]);
     }
     return list;
 }
 
+/* ************************************************************************ */
+/** retrieve all network datas at once and compute their rates */
+static sensor_status_t network_get(sensor_family_t * family, struct timeval * elapsed) {
+    network_priv_t *    priv = (network_priv_t *) family->priv;
+    network_data_t *    data = &(priv->network_data);
+    sensor_status_t     ret;
+    uint64_t            now_ns;
+
+    if ((ret = sysdep_network_get(family, data, elapsed)) == SENSOR_ERROR
+    ||  sensor_now_ns(family->sctx, &now_ns) != SENSOR_SUCCESS) {
+        return ret;
+    }
+
+    sensor_rate_update(&(priv->rates[0]), &g_sensor_rate_conf64, data->ibytes, now_ns);
+    sensor_rate_update(&(priv->rates[1]), &g_sensor_rate_conf64, data->obytes, now_ns);
+    sensor_rate_update(&(priv->rates[2]), &g_sensor_rate_conf64, data->phy_ibytes, now_ns);
+    sensor_rate_update(&(priv->rates[3]), &g_sensor_rate_conf64, data->phy_obytes, now_ns);
+    data->ibytespersec      = sensor_rate_value(&(priv->rates[0]));
+    data->obytespersec      = sensor_rate_value(&(priv->rates[1]));
+    data->phy_ibytespersec  = sensor_rate_value(&(priv->rates[2]));
+    data->phy_obytespersec  = sensor_rate_value(&(priv->rates[3]));
+
+    return ret;
+}
+
+/* ************************************************************************ */
 /** family-specific update */
 static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
     /* Sanity checks are done in sensor_init and sensor_update_check() */
     network_priv_t * priv = (network_priv_t *) sensor->desc->family->priv;
+    sensor_status_t  ret = SENSOR_SUCCESS;
 
     if (now == NULL) {
-        sysdep_network_get(sensor->desc->family, &(priv->network_data), NULL);
+        ret = network_get(sensor->desc->family, NULL);
     } else if (priv->last_update_time.tv_usec == INT_MAX) {
-        sysdep_network_get(sensor->desc->family, &(priv->network_data), NULL);
+        ret = network_get(sensor->desc->family, NULL);
         priv->last_update_time = *now;
     } else {
         /* Because all network datas are retrieved at once, don't repeat it for each sensor */
@@ -130,14 +271,39 @@ static sensor_status_t family_update(sensor_sample_t *sensor, const struct timev
         if (elapsed.tv_sec == 0 && elapsed.tv_usec < 1000)
             pelapsed = NULL;
         if (timercmp(&elapsed, &(sensor->watch->update_interval), >=)) {
-            sysdep_network_get(sensor->desc->family, &(priv->network_data), pelapsed);
+            ret = network_get(sensor->desc->family, pelapsed);
             priv->last_update_time = *now;
         }
     }
+    /* the set of interfaces changed, descs must be listed again */
+    if (ret == SENSOR_RELOAD_FAMILY) {
+        return ret;
+    }
 
     /* Always update the sensor Value: we are called because sensor timeout expired.
      * and another sensor with different timeout could have updated global data */
-    return sensor_value_fromraw(sensor->desc->key, &sensor->value);
+    return SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->key, &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    sensor_status_t     ret;
+    unsigned int        i;
+    (void) now;
+
+    /* all due samples of the family are given at once: retrieve network datas only once,
+     * rates are computed on the sensor clock */
+    ret = network_get(family, NULL);
+
+    for (i = 0; i < n; ++i) {
+        results[i] = ret == SENSOR_RELOAD_FAMILY ? SENSOR_RELOAD_FAMILY
+                     : SENSOR_DESC_FROMRAW(samples[i]->desc, samples[i]->desc->key,
+                                           &(samples[i]->value));
+    }
+    return SENSOR_SUCCESS;
 }
 
 const sensor_family_info_t g_sensor_family_network = {
@@ -148,6 +314,8 @@ const sensor_family_info_t g_sensor_family_network = {
     .list = family_list,
     .notify = NULL,
     .write = NULL,
-    .free_desc = NULL
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch
 };
 
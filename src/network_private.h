@@ -23,6 +23,7 @@
 #define SENSOR_NETWORK_PRIVATE_H
 
 #include "network.h"
+#include "sensor_rate.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,11 +41,36 @@ typedef struct {
     TYPE_SENSOR_VALUE_ULONG     phy_obytespersec;
 } network_data_t;
 
+/** maximum size of an interface name, including the terminating 0 (IFNAMSIZ) */
+#define NETWORK_IFNAME_SZ       16
+
+/** counters of one network interface */
+typedef struct {
+    char                        name[NETWORK_IFNAME_SZ];
+    int                         ifindex;        /* 0 if unknown */
+    TYPE_SENSOR_VALUE_ULONG     ibytes;
+    TYPE_SENSOR_VALUE_ULONG     obytes;
+    TYPE_SENSOR_VALUE_ULONG     ipackets;
+    TYPE_SENSOR_VALUE_ULONG     opackets;
+    TYPE_SENSOR_VALUE_ULONG     ierrors;
+    TYPE_SENSOR_VALUE_ULONG     oerrors;
+    TYPE_SENSOR_VALUE_ULONG     idrops;
+    TYPE_SENSOR_VALUE_ULONG     odrops;
+} network_iface_t;
+
 /** private/specific network family structure */
 typedef struct {
     sensor_desc_t *     sensors_desc;
+    sensor_desc_t *     retired_desc;   /* descs of previous list(), see init_descs() */
     network_data_t      network_data;
-    network_data_t *    iface_data;
+    network_iface_t *   iface_data;
+    unsigned int        nb_ifaces;
+    /* new set of interfaces given by the sysdep with SENSOR_RELOAD_FAMILY,
+     * it replaces iface_data when sensors are listed again */
+    network_iface_t *   iface_next;
+    unsigned int        nb_ifaces_next;
+    /* rates of ibytes, obytes, phy_ibytes, phy_obytes */
+    sensor_rate_t       rates[4];
     struct timeval      last_update_time;
     void *              sysdep;
 } network_priv_t;
@@ -22,54 +22,272 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
+#include <limits.h>
 
 #include "power.h"
+#include "power_private.h"
 
-sensor_status_t sysdep_power_support(sensor_family_t * family, const char * label);
+/** maximum number of descs for one power_supply_t / power_energy_t */
+#define POWER_NB_SUPPLY_DESCS   4
+#define POWER_NB_ENERGY_DESCS   2
 
+/* ************************************************************************ */
+static void power_free_descs(power_priv_t * priv) {
+    if (priv->sensors_desc != NULL) {
+        sensor_desc_t * desc;
+        for (desc = priv->sensors_desc; desc->label != NULL; ++desc)
+            free((void*) desc->label);
+        free(priv->sensors_desc);
+        priv->sensors_desc = NULL;
+    }
+}
+
+/* ************************************************************************ */
+/** family-specific free */
 static sensor_status_t family_free(sensor_family_t *family) {
-    (void)family; //TODO
-    if (1) {
-       return SENSOR_SUCCESS;
-    } else {
-       LOG_ERROR(family->log, "%s(): failed!", __func__);
-       return SENSOR_ERROR;
+    if (family->priv != NULL) {
+        power_priv_t * priv = (power_priv_t *) family->priv;
+
+        sysdep_power_destroy(family);
+        power_free_descs(priv);
+        if (priv->supplies != NULL)
+            free(priv->supplies);
+        if (priv->energies != NULL)
+            free(priv->energies);
+        family->priv = NULL;
+        free(priv);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            sensor_value_type_t     type,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) __attribute__((format(printf, 5, 6)));
+
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            sensor_value_type_t     type,
+                            void *                  key,
+                            const char *            fmt_label,
+                            ...) {
+    va_list valist;
+    char *  label = NULL;
+
+    va_start(valist, fmt_label);
+    if (vasprintf(&label, fmt_label, valist) < 0)
+        label = NULL;
+    va_end(valist);
+
+    if (label == NULL || sysdep_power_support(family, label) != SENSOR_SUCCESS) {
+        if (label != NULL)
+            free(label);
+        return SENSOR_ERROR;
+    }
+
+    desc->label = label;
+    desc->type = type;
+    desc->family = family;
+    desc->key = key;
+    desc->properties = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the sensor_desc_t data of supplies and energy counters given by the sysdep */
+static sensor_status_t init_descs(sensor_family_t *family) {
+    power_priv_t *      priv = (power_priv_t *) family->priv;
+    sensor_desc_t *     desc;
+
+    power_free_descs(priv);
+
+    if ((priv->sensors_desc = calloc(priv->nb_supplies * POWER_NB_SUPPLY_DESCS
+                                     + priv->nb_energies * POWER_NB_ENERGY_DESCS + 1/*NULL*/,
+                                     sizeof(*priv->sensors_desc))) == NULL) {
+        return SENSOR_ERROR;
+    }
+
+    desc = priv->sensors_desc;
+
+    for (unsigned int i = 0; i < priv->nb_supplies; ++i) {
+        power_supply_t * supply = &(priv->supplies[i]);
+
+        if ((supply->flags & PSF_ONLINE) != 0
+        &&  init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &supply->online,
+                          "power %s online", supply->name) == SENSOR_SUCCESS)
+            ++desc;
+        if ((supply->flags & PSF_CAPACITY) != 0
+        &&  init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &supply->capacity,
+                          "power %s capacity %%", supply->name) == SENSOR_SUCCESS)
+            ++desc;
+        if ((supply->flags & PSF_CHARGING) != 0
+        &&  init_one_desc(family, desc, SENSOR_VALUE_UCHAR, &supply->charging,
+                          "power %s charging", supply->name) == SENSOR_SUCCESS)
+            ++desc;
+        if ((supply->flags & PSF_WATTS) != 0
+        &&  init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &supply->watts,
+                          "power %s watts", supply->name) == SENSOR_SUCCESS)
+            ++desc;
+    }
+    for (unsigned int i = 0; i < priv->nb_energies; ++i) {
+        power_energy_t * energy = &(priv->energies[i]);
+
+        if (init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &energy->watts,
+                          "power %s watts", energy->name) == SENSOR_SUCCESS)
+            ++desc;
+        if (init_one_desc(family, desc, SENSOR_VALUE_DOUBLE, &energy->joules,
+                          "power %s joules", energy->name) == SENSOR_SUCCESS)
+            ++desc;
+    }
+    desc->label = NULL;
+    desc->key = NULL;
+    desc->family = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family private data creation, including the sensor_desc_t data */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    power_priv_t *  priv = (power_priv_t *) family->priv;
+
+    priv->last_update_time.tv_usec = INT_MAX;
+
+    if (sysdep_power_init(family) != SENSOR_SUCCESS) {
+        return SENSOR_ERROR;
+    }
+    if (priv->nb_supplies == 0 && priv->nb_energies == 0) {
+        return SENSOR_NOT_SUPPORTED;
     }
+
+    return init_descs(family);
 }
 
+/* ************************************************************************ */
+/** family-specific init */
 static sensor_status_t family_init(sensor_family_t *family) {
+    sensor_status_t ret;
+
+    // Sanity checks done before in sensor_init()
+    if (family->priv != NULL) {
+        LOG_ERROR(family->log, "error: %s data already initialized", family->info->name);
+        return SENSOR_ERROR;
+    }
     if (sysdep_power_support(family, NULL) != SENSOR_SUCCESS) {
-        family_free(family);
         return SENSOR_NOT_SUPPORTED;
     }
-    if (1) {
-        return SENSOR_SUCCESS;
-    } else {
-        LOG_ERROR(family->log, "%s(): failed!", __func__);
+    if ((family->priv = calloc(1, sizeof(power_priv_t))) == NULL) {
+        LOG_ERROR(family->log, "cannot allocate private %s data", family->info->name);
         family_free(family);
         return SENSOR_ERROR;
     }
+    if ((ret = init_private_data(family)) != SENSOR_SUCCESS) {
+        if (ret != SENSOR_NOT_SUPPORTED)
+            LOG_ERROR(family->log, "cannot initialize private %s data", family->info->name);
+        family_free(family);
+        return ret;
+    }
+    return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+/** family-specific list */
 static slist_t * family_list(sensor_family_t *family) {
-    (void)family; //TODO
-    if (1) {
-       return NULL;
-    } else {
-       LOG_ERROR(family->log, "%s(): failed!", __func__);
-       return NULL;
+    power_priv_t *  priv = (power_priv_t *) family->priv;
+    slist_t *       list = NULL;
+
+    for (unsigned int i_desc = 0; priv->sensors_desc[i_desc].label; i_desc++) {
+        list = slist_prepend(list, &priv->sensors_desc[i_desc]);
     }
+    return list;
 }
 
+/* ************************************************************************ */
+/** retrieve all power datas at once and compute watts from energy counters */
+static sensor_status_t power_get(sensor_family_t * family) {
+    power_priv_t *      priv = (power_priv_t *) family->priv;
+    sensor_status_t     ret;
+    uint64_t            now_ns;
+
+    if ((ret = sysdep_power_get(family)) == SENSOR_ERROR
+    ||  sensor_now_ns(family->sctx, &now_ns) != SENSOR_SUCCESS) {
+        return ret;
+    }
+
+    for (unsigned int i = 0; i < priv->nb_energies; ++i) {
+        power_energy_t *    energy = &(priv->energies[i]);
+        uint64_t            counter = energy->energy_uj;
+
+        /* counters wrap after max_energy_uj, which is not a power of 2: they
+         * are unwrapped here and the rate engine gets a 64 bits counter */
+        if (energy->started) {
+            if (counter >= energy->last_uj) {
+                energy->total_uj += counter - energy->last_uj;
+            } else if (energy->max_energy_uj >= energy->last_uj) {
+                energy->total_uj += energy->max_energy_uj - energy->last_uj + counter + 1;
+            }
+        }
+        energy->started = 1;
+        energy->last_uj = counter;
+        sensor_rate_update(&(energy->rate), &g_sensor_rate_conf64, energy->total_uj, now_ns);
+        energy->watts = energy->rate.rate / 1000000.0;
+        energy->joules = energy->total_uj / 1000000.0;
+    }
+
+    return ret;
+}
+
+/* ************************************************************************ */
+/** family-specific update */
 static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
-    (void)sensor; //TODO
-    (void)now; //TODO
-    if (1) {
-       return SENSOR_SUCCESS;
+    /* Sanity checks are done in sensor_init and sensor_update_check() */
+    power_priv_t *  priv = (power_priv_t *) sensor->desc->family->priv;
+
+    if (now == NULL || priv->last_update_time.tv_usec == INT_MAX) {
+        power_get(sensor->desc->family);
+        if (now != NULL)
+            priv->last_update_time = *now;
     } else {
-       LOG_ERROR(sensor->desc->family->log, "%s(): failed!", __func__);
-       return SENSOR_ERROR;
+        /* all power datas are retrieved at once, don't repeat it for each sensor */
+        struct timeval  elapsed;
+
+        timersub(now, &(priv->last_update_time), &elapsed);
+        if (timercmp(&elapsed, &(sensor->watch->update_interval), >=)) {
+            power_get(sensor->desc->family);
+            priv->last_update_time = *now;
+        }
+    }
+
+    /* Always update the sensor Value: we are called because sensor timeout expired.
+     * and another sensor with different timeout could have updated global data */
+    return SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->key, &(sensor->value));
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    power_priv_t *  priv = (power_priv_t *) family->priv;
+
+    /* all due samples are given at once: retrieve power datas only once */
+    power_get(family);
+    if (now != NULL) {
+        priv->last_update_time = *now;
+    }
+
+    for (unsigned int i = 0; i < n; ++i) {
+        results[i] = SENSOR_DESC_FROMRAW(samples[i]->desc, samples[i]->desc->key,
+                                         &(samples[i]->value));
     }
+    return SENSOR_SUCCESS;
 }
 
 const sensor_family_info_t g_sensor_family_power = {
@@ -80,6 +298,8 @@ const sensor_family_info_t g_sensor_family_power = {
     .list = family_list,
     .notify = NULL,
     .write = NULL,
-    .free_desc = NULL
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch
 };
 
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * power sensors for Generic Sensor Management Library.
+ */
+#ifndef SENSOR_POWER_PRIVATE_H
+#define SENSOR_POWER_PRIVATE_H
+
+#include "power.h"
+#include "sensor_rate.h"
+
+/** maximum size of a supply or energy domain name, including the terminating 0 */
+#define POWER_NAME_SZ           64
+
+/** values available for a power supply */
+typedef enum {
+    PSF_NONE        = 0,
+    PSF_ONLINE      = 1 << 0,
+    PSF_CAPACITY    = 1 << 1,
+    PSF_CHARGING    = 1 << 2,
+    PSF_WATTS       = 1 << 3,
+} power_supply_flag_t;
+
+/** a power supply (AC adapter, battery, ...), values are set by the sysdep */
+typedef struct {
+    char                        name[POWER_NAME_SZ];
+    unsigned int                flags;          /* power_supply_flag_t */
+    TYPE_SENSOR_VALUE_UCHAR     online;
+    TYPE_SENSOR_VALUE_UCHAR     capacity;       /* % */
+    TYPE_SENSOR_VALUE_UCHAR     charging;
+    TYPE_SENSOR_VALUE_DOUBLE    watts;
+} power_supply_t;
+
+/** an energy counter (cpu package, cores, dram, ...) */
+typedef struct {
+    char                        name[POWER_NAME_SZ];
+    /* raw counter given by the sysdep, wrapping after max_energy_uj */
+    uint64_t                    energy_uj;
+    uint64_t                    max_energy_uj;
+    /* computed by the family */
+    uint64_t                    last_uj;
+    uint64_t                    total_uj;       /* energy without wraps since init */
+    int                         started;
+    TYPE_SENSOR_VALUE_DOUBLE    joules;
+    TYPE_SENSOR_VALUE_DOUBLE    watts;
+    sensor_rate_t               rate;
+} power_energy_t;
+
+/** private/specific power family structure */
+typedef struct {
+    sensor_desc_t *     sensors_desc;
+    /* sets built by sysdep_power_init() */
+    power_supply_t *    supplies;
+    unsigned int        nb_supplies;
+    power_energy_t *    energies;
+    unsigned int        nb_energies;
+    struct timeval      last_update_time;
+    void *              sysdep;
+} power_priv_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sensor_status_t sysdep_power_support(sensor_family_t * family, const char * label);
+sensor_status_t sysdep_power_init(sensor_family_t * family);
+sensor_status_t sysdep_power_get(sensor_family_t * family);
+sensor_status_t sysdep_power_destroy(sensor_family_t * family);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifdef SENSOR_POWER_PRIVATE_H
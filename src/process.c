@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * per-process top-N monitoring - Generic Sensor Management Library.
+ * Each scan ranks all processes in bounded min-heaps, the slots of the
+ * rankings have stable descs: "proc/top1_cpu", "proc/top1_cpu_pid", ...
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "vlib/util.h"
+
+#include "process_private.h"
+
+/** names of rankings, used in labels and PROCESS_TOP_BY_ENV */
+static const char * s_process_rank_names[PROCESS_RANK_NB] = { "cpu", "rss" };
+
+/** label suffix and type of slot sensors, by process_slot_sensor_t */
+static const struct {
+    const char *            suffix;
+    sensor_value_type_t     type;
+} s_process_slot_sensors[PROCESS_SLOT_NB] = {
+    { "",       SENSOR_VALUE_NULL },    /* type of the ranking */
+    { "_pid",   SENSOR_VALUE_INT },
+    { "_name",  SENSOR_VALUE_STRING },
+};
+
+/* ************************************************************************ */
+/** family-specific free */
+static sensor_status_t family_free(sensor_family_t *family) {
+    if (family->priv != NULL) {
+        process_priv_t * priv = (process_priv_t *) family->priv;
+
+        sysdep_process_destroy(family);
+
+        for (unsigned int rank = 0; rank < PROCESS_RANK_NB; ++rank) {
+            if (priv->slots[rank] != NULL) {
+                for (unsigned int i = 0; i < priv->top; ++i) {
+                    for (unsigned int s = 0; s < PROCESS_SLOT_NB; ++s) {
+                        if (priv->slots[rank][i].descs[s].label != NULL)
+                            free((void *) priv->slots[rank][i].descs[s].label);
+                    }
+                }
+                free(priv->slots[rank]);
+            }
+            if (priv->heaps[rank] != NULL)
+                free(priv->heaps[rank]);
+        }
+        pthread_mutex_destroy(&priv->mutex);
+        family->priv = NULL;
+        free(priv);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the slots of a ranking and their descs */
+static sensor_status_t init_rank(sensor_family_t * family, process_rank_t rank) {
+    process_priv_t * priv = (process_priv_t *) family->priv;
+
+    if ((priv->heaps[rank] = calloc(priv->top, sizeof(*priv->heaps[rank]))) == NULL
+    ||  (priv->slots[rank] = calloc(priv->top, sizeof(*priv->slots[rank]))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    for (unsigned int i = 0; i < priv->top; ++i) {
+        process_slot_t * slot = &(priv->slots[rank][i]);
+
+        for (unsigned int s = 0; s < PROCESS_SLOT_NB; ++s) {
+            sensor_desc_t * desc = &(slot->descs[s]);
+            char *          label;
+
+            if (asprintf(&label, "top%u_%s%s", i + 1, s_process_rank_names[rank],
+                         s_process_slot_sensors[s].suffix) < 0) {
+                return SENSOR_ERROR;
+            }
+            desc->label = label;
+            desc->type = s != PROCESS_SLOT_VALUE ? s_process_slot_sensors[s].type
+                         : rank == PROCESS_RANK_CPU ? SENSOR_VALUE_DOUBLE : SENSOR_VALUE_UINT64;
+            desc->family = family;
+            desc->key = slot;
+            desc->properties = NULL;
+        }
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family private data creation: rankings of PROCESS_TOP_BY_ENV with
+ * PROCESS_TOP_ENV slots each */
+static sensor_status_t init_private_data(sensor_family_t *family) {
+    process_priv_t *    priv = (process_priv_t *) family->priv;
+    const char *        env;
+    char *              ranks, * rank, * saveptr = NULL;
+
+    if (pthread_mutex_init(&priv->mutex, NULL) != 0) {
+        return SENSOR_ERROR;
+    }
+    priv->top = PROCESS_TOP_DEFAULT;
+    if ((env = getenv(PROCESS_TOP_ENV)) != NULL) {
+        unsigned long top = strtoul(env, NULL, 0);
+
+        priv->top = top > PROCESS_TOP_MAX ? PROCESS_TOP_MAX : top;
+    }
+    if (priv->top == 0) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+
+    env = getenv(PROCESS_TOP_BY_ENV);
+    if ((ranks = strdup(env != NULL ? env : PROCESS_TOP_BY_DEFAULT)) == NULL) {
+        return SENSOR_ERROR;
+    }
+    for (rank = strtok_r(ranks, ":", &saveptr); rank != NULL; rank = strtok_r(NULL, ":", &saveptr)) {
+        unsigned int i;
+
+        for (i = 0; i < PROCESS_RANK_NB && strcmp(rank, s_process_rank_names[i]) != 0; ++i)
+            ; /* nothing but loop */
+        if (i == PROCESS_RANK_NB) {
+            LOG_WARN(family->log, "unknown process ranking '%s'", rank);
+            continue ;
+        }
+        priv->ranks |= 1U << i;
+    }
+    free(ranks);
+    if (priv->ranks == 0) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    for (unsigned int i = 0; i < PROCESS_RANK_NB; ++i) {
+        if ((priv->ranks & (1U << i)) != 0 && init_rank(family, i) != SENSOR_SUCCESS) {
+            return SENSOR_ERROR;
+        }
+    }
+    LOG_VERBOSE(family->log, "top %u processes by %s%s%s", priv->top,
+                (priv->ranks & (1U << PROCESS_RANK_CPU)) != 0 ? "cpu" : "",
+                priv->ranks == ((1U << PROCESS_RANK_CPU) | (1U << PROCESS_RANK_RSS)) ? " and " : "",
+                (priv->ranks & (1U << PROCESS_RANK_RSS)) != 0 ? "rss" : "");
+
+    return sysdep_process_init(family);
+}
+
+/* ************************************************************************ */
+/** family-specific init */
+static sensor_status_t family_init(sensor_family_t *family) {
+    sensor_status_t ret;
+
+    // Sanity checks done before in sensor_init()
+    if (family->priv != NULL) {
+        LOG_ERROR(family->log, "error: %s data already initialized", family->info->name);
+        return SENSOR_ERROR;
+    }
+    if (sysdep_process_support(family, NULL) != SENSOR_SUCCESS) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if ((family->priv = calloc(1, sizeof(process_priv_t))) == NULL) {
+        LOG_ERROR(family->log, "cannot allocate private %s data", family->info->name);
+        return SENSOR_ERROR;
+    }
+    if ((ret = init_private_data(family)) != SENSOR_SUCCESS) {
+        if (ret != SENSOR_NOT_SUPPORTED)
+            LOG_ERROR(family->log, "cannot initialize private %s data", family->info->name);
+        family_free(family);
+        return ret;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family-specific list: the slots of all rankings */
+static slist_t * family_list(sensor_family_t *family) {
+    process_priv_t *    priv = (process_priv_t *) family->priv;
+    slist_t *           list = NULL;
+
+    for (unsigned int rank = 0; rank < PROCESS_RANK_NB; ++rank) {
+        if (priv->slots[rank] == NULL)
+            continue ;
+        for (unsigned int i = 0; i < priv->top; ++i) {
+            for (unsigned int s = 0; s < PROCESS_SLOT_NB; ++s) {
+                list = slist_prepend(list, &(priv->slots[rank][i].descs[s]));
+            }
+        }
+    }
+    return list;
+}
+
+/* ************************************************************************ */
+/** compare processes by the metric of a ranking */
+static inline int process_cmp(process_rank_t rank, const process_stat_t * a,
+                              const process_stat_t * b) {
+    if (rank == PROCESS_RANK_CPU && a->cpu_percent != b->cpu_percent) {
+        return a->cpu_percent < b->cpu_percent ? -1 : 1;
+    }
+    if (a->rss != b->rss) {
+        return a->rss < b->rss ? -1 : 1;
+    }
+    /* the oldest process first for a same metric */
+    return a->pid > b->pid ? -1 : (a->pid < b->pid);
+}
+
+/* ************************************************************************ */
+/** move down the root of a min-heap of nb entries */
+static void process_heap_down(process_rank_t rank, process_stat_t * heap, unsigned int nb) {
+    process_stat_t  tmp = heap[0];
+    unsigned int    i = 0, child;
+
+    while ((child = 2 * i + 1) < nb) {
+        if (child + 1 < nb && process_cmp(rank, &heap[child + 1], &heap[child]) < 0)
+            ++child;
+        if (process_cmp(rank, &heap[child], &tmp) >= 0)
+            break ;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = tmp;
+}
+
+/* ************************************************************************ */
+void process_found(sensor_family_t * family, process_stat_t * stat) {
+    process_priv_t * priv = (process_priv_t *) family->priv;
+
+    stat->cpu_percent = priv->elapsed_ns == 0 ? 0.0
+                        : (stat->cpu_ns * 100.0) / priv->elapsed_ns;
+
+    for (unsigned int rank = 0; rank < PROCESS_RANK_NB; ++rank) {
+        process_stat_t *    heap = priv->heaps[rank];
+        unsigned int        i;
+
+        if (heap == NULL) {
+            continue ;
+        }
+        if (priv->nb_heap[rank] == priv->top) {
+            /* full: replace the least of the top if stat is greater */
+            if (process_cmp(rank, stat, &heap[0]) > 0) {
+                heap[0] = *stat;
+                process_heap_down(rank, heap, priv->top);
+            }
+            continue ;
+        }
+        for (i = (priv->nb_heap[rank])++; i > 0 && process_cmp(rank, stat, &heap[(i - 1) / 2]) < 0;
+             i = (i - 1) / 2) {
+            heap[i] = heap[(i - 1) / 2];
+        }
+        heap[i] = *stat;
+    }
+}
+
+/* ************************************************************************ */
+/** scan the processes and fill the slots of each ranking, under priv->mutex */
+static sensor_status_t process_scan(sensor_family_t * family, const struct timeval * now) {
+    process_priv_t *    priv = (process_priv_t *) family->priv;
+    uint64_t            now_ns;
+    sensor_status_t     ret;
+
+    if (now != NULL && timercmp(now, &(priv->scan_time), ==)) {
+        return SENSOR_SUCCESS;
+    }
+    if (sensor_now_ns(family->sctx, &now_ns) != SENSOR_SUCCESS) {
+        return SENSOR_ERROR;
+    }
+    if (priv->scan_ns != 0 && now_ns - priv->scan_ns < PROCESS_SCAN_MIN_MS * 1000000ULL) {
+        /* too close to the previous one for a meaningful cpu usage */
+        return SENSOR_SUCCESS;
+    }
+    priv->elapsed_ns = priv->scan_ns == 0 ? 0 : now_ns - priv->scan_ns;
+    priv->scan_ns = now_ns;
+    if (now != NULL) {
+        priv->scan_time = *now;
+    } else {
+        timerclear(&(priv->scan_time));
+    }
+
+    ret = sysdep_process_scan(family);
+
+    /* pop the heaps in slots, the greatest first, and clear slots not filled */
+    for (unsigned int rank = 0; rank < PROCESS_RANK_NB; ++rank) {
+        process_stat_t *    heap = priv->heaps[rank];
+        process_slot_t *    slots = priv->slots[rank];
+        unsigned int        nb = priv->nb_heap[rank];
+
+        if (heap == NULL) {
+            continue ;
+        }
+        for (unsigned int i = nb; i < priv->top; ++i) {
+            memset(&(slots[i].stat), 0, sizeof(slots[i].stat));
+        }
+        while (nb > 0) {
+            slots[--nb].stat = heap[0];
+            heap[0] = heap[nb];
+            process_heap_down(rank, heap, nb);
+        }
+        priv->nb_heap[rank] = 0;
+    }
+    return ret;
+}
+
+/* ************************************************************************ */
+/** family-specific update: all processes are scanned once for all the sensors
+ * of a same update time */
+static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
+    /* Sanity checks are done in sensor_init and sensor_update_check() */
+    process_priv_t *    priv = (process_priv_t *) sensor->desc->family->priv;
+    process_slot_t *    slot = (process_slot_t *) sensor->desc->key;
+    sensor_status_t     ret;
+
+    pthread_mutex_lock(&priv->mutex);
+    if (process_scan(sensor->desc->family, now) != SENSOR_SUCCESS) {
+        pthread_mutex_unlock(&priv->mutex);
+        return SENSOR_ERROR;
+    }
+    switch (sensor->desc - slot->descs) {
+        case PROCESS_SLOT_VALUE:
+            ret = SENSOR_DESC_FROMRAW(sensor->desc, sensor->desc->type == SENSOR_VALUE_DOUBLE
+                                      ? (void *) &(slot->stat.cpu_percent)
+                                      : (void *) &(slot->stat.rss), &(sensor->value));
+            break ;
+        case PROCESS_SLOT_PID:
+            ret = SENSOR_DESC_FROMRAW(sensor->desc, &(slot->stat.pid), &(sensor->value));
+            break ;
+        case PROCESS_SLOT_NAME:
+            ret = sensor_value_frombuffer(slot->stat.name, strlen(slot->stat.name) + 1,
+                                          &sensor->value);
+            break ;
+        default:
+            ret = SENSOR_ERROR;
+            break ;
+    }
+    pthread_mutex_unlock(&priv->mutex);
+
+    return ret;
+}
+
+/* ************************************************************************ */
+static sensor_status_t family_update_batch(sensor_family_t * family,
+                                           sensor_sample_t ** samples, unsigned int n,
+                                           const struct timeval * now,
+                                           sensor_status_t * results) {
+    struct timeval  tv;
+
+    /* a same time for all samples: processes are scanned once */
+    if (now == NULL) {
+        if (gettimeofday(&tv, NULL) != 0)
+            timerclear(&tv);
+        now = &tv;
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        results[i] = family_update(samples[i], now);
+    }
+    (void) family;
+    return SENSOR_SUCCESS;
+}
+
+// ***************************************************************************
+const sensor_family_info_t g_sensor_family_process = {
+    .name = "proc",
+    .init = family_init,
+    .free = family_free,
+    .update = family_update,
+    .list = family_list,
+    .notify = NULL,
+    .write = NULL,
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = family_update_batch,
+    .list_delta = NULL
+};
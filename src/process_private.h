@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Generic Sensor Management Library.
+ */
+#ifndef SENSOR_PROCESS_PRIVATE_H
+#define SENSOR_PROCESS_PRIVATE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "process.h"
+
+/** number of top-N slots of each ranking */
+#define PROCESS_TOP_ENV         "VSENSORS_PROC_TOP"
+#define PROCESS_TOP_DEFAULT     20
+#define PROCESS_TOP_MAX         256
+/** rankings given, separated by ':' among "cpu" and "rss" */
+#define PROCESS_TOP_BY_ENV      "VSENSORS_PROC_TOP_BY"
+#define PROCESS_TOP_BY_DEFAULT  "cpu:rss"
+/** updates closer than this reuse the previous scan */
+#define PROCESS_SCAN_MIN_MS     500
+/** process name size, as the linux TASK_COMM_LEN */
+#define PROCESS_NAME_SZ         16
+
+/** process rankings */
+typedef enum {
+    PROCESS_RANK_CPU = 0,
+    PROCESS_RANK_RSS,
+    PROCESS_RANK_NB
+} process_rank_t;
+
+/** sensors of a top-N slot */
+typedef enum {
+    PROCESS_SLOT_VALUE = 0,     /* value of the ranking metric */
+    PROCESS_SLOT_PID,
+    PROCESS_SLOT_NAME,
+    PROCESS_SLOT_NB
+} process_slot_sensor_t;
+
+/** a process given by the sysdep scan */
+typedef struct {
+    TYPE_SENSOR_VALUE_DOUBLE    cpu_percent;    /* of one cpu, computed by the family */
+    TYPE_SENSOR_VALUE_UINT64    rss;            /* bytes */
+    TYPE_SENSOR_VALUE_INT       pid;
+    uint64_t                    cpu_ns;         /* cpu time since the previous scan */
+    char                        name[PROCESS_NAME_SZ];
+} process_stat_t;
+
+/** a top-N slot: its descs stay the same whatever the process in it */
+typedef struct {
+    process_stat_t              stat;
+    sensor_desc_t               descs[PROCESS_SLOT_NB];
+} process_slot_t;
+
+/** private/specific process family structure */
+typedef struct {
+    unsigned int        top;
+    unsigned int        ranks;                          /* bits of process_rank_t */
+    /* the scan state and slots are shared by samples updated concurrently */
+    pthread_mutex_t     mutex;
+    struct timeval      scan_time;
+    uint64_t            scan_ns;                        /* sctx clock of last scan, 0: none */
+    uint64_t            elapsed_ns;                     /* since the previous scan */
+    process_stat_t *    heaps[PROCESS_RANK_NB];         /* min-heaps of top entries */
+    unsigned int        nb_heap[PROCESS_RANK_NB];
+    process_slot_t *    slots[PROCESS_RANK_NB];         /* top entries, greatest first */
+    void *              sysdep;
+} process_priv_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** a process was scanned: it is ranked, stat is copied */
+void            process_found(sensor_family_t * family, process_stat_t * stat);
+
+sensor_status_t sysdep_process_support(sensor_family_t * family, const char * label);
+sensor_status_t sysdep_process_init(sensor_family_t * family);
+sensor_status_t sysdep_process_destroy(sensor_family_t * family);
+/** give each process to process_found(), under process_priv_t.mutex */
+sensor_status_t sysdep_process_scan(sensor_family_t * family);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifdef SENSOR_PROCESS_PRIVATE_H
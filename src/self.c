@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * libvsensors self-instrumentation sensors for Generic Sensor Management Library:
+ * update latency, updated samples per tick, reads and reloads of each family,
+ * and sensor_lock() waits.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "vlib/slist.h"
+#include "vlib/log.h"
+
+#include "libvsensors/sensor.h"
+
+#include "sensor_private.h"
+
+typedef enum {
+    SELF_UPDATE_P50 = 0,
+    SELF_UPDATE_P99,
+    SELF_UPDATED_TICK,
+    SELF_UNCHANGED_TICK,
+    SELF_READS,
+    SELF_RELOADS,
+    SELF_RELOAD_MS,
+    SELF_FAMILY_NB,
+    /* sensor context metrics */
+    SELF_LOCK_WAITS = SELF_FAMILY_NB,
+    SELF_LOCK_WAIT_MS,
+    SELF_NB
+} self_metric_t;
+
+/** label (prefixed by family name for family metrics) and type, by self_metric_t */
+static const struct {
+    const char *            label;
+    sensor_value_type_t     type;
+} s_self_metrics[SELF_NB] = {
+    { "update p50 us",      SENSOR_VALUE_DOUBLE },
+    { "update p99 us",      SENSOR_VALUE_DOUBLE },
+    { "updated per tick",   SENSOR_VALUE_DOUBLE },
+    { "unchanged per tick", SENSOR_VALUE_DOUBLE },
+    { "reads",              SENSOR_VALUE_UINT64 },
+    { "reloads",            SENSOR_VALUE_UINT64 },
+    { "reload ms",          SENSOR_VALUE_DOUBLE },
+    { "lock waits",         SENSOR_VALUE_UINT64 },
+    { "lock wait ms",       SENSOR_VALUE_DOUBLE },
+};
+
+/** type of sensor_desc_t.key, value first for sensor_value_fromraw() */
+typedef struct {
+    union {
+        double              d;
+        uint64_t            u64;
+    } value;
+    const sensor_family_t * family;     /* NULL for sensor context metrics */
+    self_metric_t           metric;
+    uint64_t                prev_ticks; /* SELF_*_TICK: counters at previous update */
+    uint64_t                prev_count;
+} self_key_t;
+
+typedef struct {
+    sensor_desc_t *         sensors_desc;
+    self_key_t *            keys;
+    sensor_desc_t *         retired_desc;   /* descs of previous list(), see init_descs() */
+    self_key_t *            retired_keys;
+    unsigned int            nb_families;    /* families when descs were created */
+} self_priv_t;
+
+/* ************************************************************************ */
+static void self_free_descs(sensor_desc_t ** pdescs, self_key_t ** pkeys) {
+    if (*pdescs != NULL) {
+        sensor_desc_t * desc;
+        for (desc = *pdescs; desc->label != NULL; ++desc)
+            free((void*) desc->label);
+        free(*pdescs);
+        *pdescs = NULL;
+    }
+    if (*pkeys != NULL) {
+        free(*pkeys);
+        *pkeys = NULL;
+    }
+}
+
+/* ************************************************************************ */
+/** family-specific free */
+static sensor_status_t family_free(sensor_family_t *family) {
+    if (family->priv != NULL) {
+        self_priv_t * priv = (self_priv_t *) family->priv;
+
+        self_free_descs(&(priv->sensors_desc), &(priv->keys));
+        self_free_descs(&(priv->retired_desc), &(priv->retired_keys));
+        family->priv = NULL;
+        free(priv);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static sensor_status_t init_one_desc(
+                            sensor_family_t *       family,
+                            sensor_desc_t *         desc,
+                            self_key_t *            key,
+                            const sensor_family_t * metric_family,
+                            self_metric_t           metric) {
+    if (metric_family != NULL) {
+        if (asprintf((char **) &(desc->label), "%s %s",
+                     metric_family->info->name, s_self_metrics[metric].label) < 0)
+            desc->label = NULL;
+    } else {
+        desc->label = strdup(s_self_metrics[metric].label);
+    }
+    if (desc->label == NULL) {
+        return SENSOR_ERROR;
+    }
+    memset(key, 0, sizeof(*key));
+    key->family = metric_family;
+    key->metric = metric;
+    desc->type = s_self_metrics[metric].type;
+    desc->family = family;
+    desc->key = key;
+    desc->properties = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** create the sensor_desc_t data of families currently registered */
+static sensor_status_t init_descs(sensor_family_t *family) {
+    self_priv_t *       priv = (self_priv_t *) family->priv;
+    const slist_t *     families = sensor_family_list_get(family->sctx);
+    unsigned int        nb_descs, i_desc = 0;
+
+    /* the listed descs are used until libvsensors replaces them during a reload,
+     * they are freed by the next list() */
+    self_free_descs(&(priv->retired_desc), &(priv->retired_keys));
+    priv->retired_desc = priv->sensors_desc;
+    priv->retired_keys = priv->keys;
+    priv->sensors_desc = NULL;
+    priv->keys = NULL;
+
+    priv->nb_families = slist_length(families);
+    nb_descs = priv->nb_families * SELF_FAMILY_NB + (SELF_NB - SELF_FAMILY_NB);
+    if ((priv->sensors_desc = calloc(nb_descs + 1/*NULL*/, sizeof(*priv->sensors_desc))) == NULL
+    ||  (priv->keys = calloc(nb_descs, sizeof(*priv->keys))) == NULL) {
+        self_free_descs(&(priv->sensors_desc), &(priv->keys));
+        return SENSOR_ERROR;
+    }
+
+    SLISTC_FOREACH_DATA(families, fam, const sensor_family_t *) {
+        if (fam == family)
+            continue ;
+        for (unsigned int metric = 0; metric < SELF_FAMILY_NB; ++metric) {
+            if (init_one_desc(family, &(priv->sensors_desc[i_desc]), &(priv->keys[i_desc]),
+                              fam, metric) == SENSOR_SUCCESS)
+                ++i_desc;
+        }
+    }
+    for (unsigned int metric = SELF_FAMILY_NB; metric < SELF_NB; ++metric) {
+        if (init_one_desc(family, &(priv->sensors_desc[i_desc]), &(priv->keys[i_desc]),
+                          NULL, metric) == SENSOR_SUCCESS)
+            ++i_desc;
+    }
+    priv->sensors_desc[i_desc].label = NULL;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family-specific init */
+static sensor_status_t family_init(sensor_family_t *family) {
+    // Sanity checks done before in sensor_init()
+    if (family->priv != NULL) {
+        LOG_ERROR(family->log, "error: %s data already initialized", family->info->name);
+        return SENSOR_ERROR;
+    }
+    if ((family->priv = calloc(1, sizeof(self_priv_t))) == NULL) {
+        LOG_ERROR(family->log, "cannot allocate private %s data", family->info->name);
+        return SENSOR_ERROR;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** family-specific list: families are all registered when the list is built */
+static slist_t * family_list(sensor_family_t *family) {
+    self_priv_t *   priv = (self_priv_t *) family->priv;
+    slist_t *       list = NULL;
+
+    if (init_descs(family) != SENSOR_SUCCESS) {
+        LOG_ERROR(family->log, "cannot create %s sensors", family->info->name);
+        return NULL;
+    }
+    for (unsigned int i_desc = 0; priv->sensors_desc[i_desc].label; i_desc++) {
+        list = slist_prepend(list, &priv->sensors_desc[i_desc]);
+    }
+    return list;
+}
+
+/* ************************************************************************ */
+/** mean of (count - key->prev_count) per tick since previous update */
+static void self_per_tick(self_key_t * key, uint64_t ticks, uint64_t count) {
+    if (ticks > key->prev_ticks) {
+        key->value.d = (double) (count - key->prev_count) / (ticks - key->prev_ticks);
+        key->prev_ticks = ticks;
+        key->prev_count = count;
+    }
+}
+
+/* ************************************************************************ */
+/** family-specific update */
+static sensor_status_t family_update(sensor_sample_t *sensor, const struct timeval * now) {
+    /* Sanity checks are done in sensor_init and sensor_update_check() */
+    sensor_family_t *       family = sensor->desc->family;
+    self_priv_t *           priv = (self_priv_t *) family->priv;
+    self_key_t *            key = (self_key_t *) sensor->desc->key;
+    sensor_family_stats_t   stats;
+    sensor_ctx_stats_t      ctx_stats;
+    (void) now;
+
+    /* families loaded later (SIF_LAZY_INIT) need new sensors */
+    if (slist_length(sensor_family_list_get(family->sctx)) != priv->nb_families) {
+        return SENSOR_RELOAD_FAMILY;
+    }
+
+    if (key->family == NULL) {
+        sensor_ctx_stats_get(family->sctx, &ctx_stats);
+        if (key->metric == SELF_LOCK_WAITS)
+            key->value.u64 = ctx_stats.lock_waits;
+        else
+            key->value.d = ctx_stats.lock_wait_ns / 1000000.0;
+        return sensor_value_fromraw(key, &(sensor->value));
+    }
+
+    sensor_family_stats_get(key->family, &stats);
+    switch (key->metric) {
+        case SELF_UPDATE_P50:
+            key->value.d = sensor_family_stats_percentile(&stats, 50) / 1000.0;
+            break ;
+        case SELF_UPDATE_P99:
+            key->value.d = sensor_family_stats_percentile(&stats, 99) / 1000.0;
+            break ;
+        case SELF_UPDATED_TICK:
+            self_per_tick(key, stats.ticks, stats.updated);
+            break ;
+        case SELF_UNCHANGED_TICK:
+            self_per_tick(key, stats.ticks, stats.unchanged);
+            break ;
+        case SELF_READS:
+            key->value.u64 = stats.reads;
+            break ;
+        case SELF_RELOADS:
+            key->value.u64 = stats.reloads;
+            break ;
+        case SELF_RELOAD_MS:
+            key->value.d = stats.reload_ns / 1000000.0;
+            break ;
+        default:
+            return SENSOR_ERROR;
+    }
+    return sensor_value_fromraw(key, &(sensor->value));
+}
+
+const sensor_family_info_t g_sensor_family_self = {
+    .name = "libvsensors",
+    .init = family_init,
+    .free = family_free,
+    .update = family_update,
+    .list = family_list,
+    .notify = NULL,
+    .write = NULL,
+    .free_desc = NULL,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = NULL
+};
@@ -19,14 +19,24 @@
 /* ------------------------------------------------------------------------
  * Generic Sensor Management Library.
  */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <float.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <fnmatch.h>
 #include <pthread.h>
 #include <math.h>
+#include <limits.h>
 #include <stdint.h>
 #include <inttypes.h>
 
@@ -36,6 +46,7 @@
 #include "vlib/slist.h"
 #include "vlib/logpool.h"
 #include "vlib/avltree.h"
+#include "vlib/job.h"
 
 #include "libvsensors/sensor.h"
 
@@ -48,6 +59,9 @@
 #include "network.h"
 #include "cpu.h"
 #include "power.h"
+#include "hwmon.h"
+#include "cgroup.h"
+#include "process.h"
 #include "sensor_private.h"
 
 /* locking */
@@ -61,6 +75,10 @@
                                         == 0 ? SENSOR_SUCCESS : SENSOR_ERROR)
 #define SENSOR_WRITE_LOCK(_sctx)    (pthread_rwlock_wrlock(&((_sctx)->rwlock)) \
                                         == 0 ? SENSOR_SUCCESS : SENSOR_ERROR)
+#define SENSOR_TRYREAD_LOCK(_sctx)  (pthread_rwlock_tryrdlock(&((_sctx)->rwlock)) \
+                                        == 0 ? SENSOR_SUCCESS : SENSOR_ERROR)
+#define SENSOR_TRYWRITE_LOCK(_sctx) (pthread_rwlock_trywrlock(&((_sctx)->rwlock)) \
+                                        == 0 ? SENSOR_SUCCESS : SENSOR_ERROR)
 #define SENSOR_UNLOCK(_sctx)        (pthread_rwlock_unlock(&((_sctx)->rwlock)) \
                                         == 0 ? SENSOR_SUCCESS : SENSOR_ERROR)
 #define SENSOR_NO_WRITE_OWNER       ((pthread_t) ((void*) -1L))
@@ -69,6 +87,10 @@
 #define SENSOR_LABEL_SIZE           256
 #define SENSOR_VALUE_BYTES_WORKSZ   512
 
+/* update scheduler */
+#define SENSOR_SCHED_MINSIZE        64
+#define SENSOR_SCHED_BATCH          128     /* due samples of an update without malloc */
+
 #define SENSOR_FAM_NAME(_family)    ((_family)->info->name)
 
 #define SENSOR_DESC_LABEL(_desc)    (STR_CHECKNULL((_desc)->label))
@@ -86,24 +108,101 @@ static const sensor_family_info_t * s_families_info[] = {
     &g_sensor_family_disk,
     &g_sensor_family_file,
     &g_sensor_family_power,
+    &g_sensor_family_hwmon,
+    &g_sensor_family_cgroup,
+    &g_sensor_family_process,
     &g_sensor_family_smc,
+    &g_sensor_family_self,
     NULL
 };
 
 typedef enum {
     SPF_FREE_LOGPOOL    = SIF_RESERVED << 0,
+    SPF_LIST_BUILT      = SIF_RESERVED << 1,    /* sensor_list_build() done, even if empty */
 } sensors_priv_flag_t;
 
+/** VSENSORS_FAMILIES: default family allowlist of sensor_init_families() */
+#define SENSOR_FAMILIES_ENV         "VSENSORS_FAMILIES"
+#define SENSOR_FAMILIES_NB          (PTR_COUNT(s_families_info) - 1)
+/** VSENSORS_SYSROOT: default root directory of sensor_init_sysroot() */
+#define SENSOR_SYSROOT_ENV          "VSENSORS_SYSROOT"
+
+/** min-heap of watched samples, ordered by next_update_time */
+typedef struct {
+    sensor_sample_t **  heap;
+    unsigned int        count;
+    unsigned int        size;
+} sensor_sched_t;
+
+/** chunk of SENSOR_SLAB_CHUNK contiguous samples, see sensor_sample_alloc() */
+#ifndef SENSOR_SLAB_CHUNK
+# define SENSOR_SLAB_CHUNK  64
+#endif
+typedef struct sensor_slab_chunk_s {
+    struct sensor_slab_chunk_s *    next;
+    unsigned int                    used;
+    sensor_sample_t                 samples[SENSOR_SLAB_CHUNK];
+} sensor_slab_chunk_t;
+
+/** slab of samples of a family, freed samples are chained by their first bytes */
+typedef struct {
+    sensor_slab_chunk_t *   chunks;
+    void *                  free_list;
+    unsigned int            count;
+} sensor_slab_t;
+
+/** thread shards of self-instrumentation counters, see sensor_stats_shard() */
+#ifndef SENSOR_STATS_SHARDS
+# define SENSOR_STATS_SHARDS 4
+#endif
+
+/** private family data, allocated by libvsensors around the public sensor_family_t */
+typedef struct {
+    sensor_family_t     family;     /* must be first */
+    pthread_mutex_t     mutex;      /* serializes update()/update_batch() and list() */
+    int                 reloading;  /* new descs are staged, see sensor_family_reload() */
+    sensor_slab_t       slab;       /* watched samples of family, under write lock */
+    sensor_family_stats_t stats[SENSOR_STATS_SHARDS];
+} sensor_family_priv_t;
+
+/** exact-name index entry of a sensor_desc_t, chained in both hash tables */
+typedef struct sensor_index_entry_s {
+    const sensor_desc_t *           desc;
+    sensor_sample_t *               sample;     /* watch of desc, if any */
+    unsigned int                    hash;       /* desc->fullname->hash */
+    unsigned int                    hash_ci;    /* desc->fullname->hash_ci */
+    struct sensor_index_entry_s *   next;
+    struct sensor_index_entry_s *   next_ci;
+} sensor_index_entry_t;
+
+/** hash index of 'family/label': buckets[0..size-1] are case-sensitive chains,
+ * buckets[size..2*size-1] are casefolded chains. size is a power of 2. */
+typedef struct {
+    sensor_index_entry_t ** buckets;
+    unsigned int            size;
+    unsigned int            count;
+} sensor_index_t;
+
+#define SENSOR_FAMILY_LOCK(_fam)    pthread_mutex_lock(&(((sensor_family_priv_t *) (_fam))->mutex))
+#define SENSOR_FAMILY_UNLOCK(_fam)  pthread_mutex_unlock(&(((sensor_family_priv_t *) (_fam))->mutex))
+
 struct sensor_ctx_s {
     sensor_family_t *   common;
     slist_t *           families;
     slist_t *           sensorlist;
     slist_t *           watchlist;
+    slist_t *           watchfiles;
+    slist_t *           exporters;
+    slist_t *           streams;    /* servers of sensor_stream_serve() */
+    sensor_stream_mirror_t * mirror; /* remote families of sensor_stream_connect() */
+    sensor_shm_t *      publisher;
+    sensor_dispatch_t * dispatcher; /* deferred watch events, see sensor_dispatch_start() */
     avltree_t *         watch_params;
     avltree_t *         watchs;
     avltree_t *         sensors;
     avltree_t *         properties;
     unsigned int        flags;
+    int                 clock_id;   /* clock of sensor_now_ns(), from SIF_CLOCK_* */
     log_t *             log;
     logpool_t *         logpool;
     pthread_rwlock_t    rwlock;
@@ -111,9 +210,13 @@ struct sensor_ctx_s {
     pthread_t           write_lock_owner;
     int                 write_lock_counter;
     pthread_cond_t      cond;
-    sensor_value_t      work_buffer;
-    sensor_value_t      work_value;
     sensor_watch_ev_data_t * evdata;
+    sensor_sched_t      sched;
+    sensor_index_t      index;
+    int                 wakeup_fds[2];
+    uint32_t            lazy_families;  /* bits of s_families_info not initialized yet */
+    char *              sysroot;        /* prefix of system files, see sensor_sysroot() */
+    sensor_ctx_stats_t  stats[SENSOR_STATS_SHARDS];
 };
 
 typedef struct {
@@ -139,8 +242,312 @@ static sensor_property_t s_sensor_loading_properties[] = {
     { NULL, { .type = SENSOR_VALUE_NULL, } }
 };
 
+/* ************************************************************************
+ * SENSOR STATS : self-instrumentation counters, read by the libvsensors family
+ * ************************************************************************ */
+
+#define SENSOR_STATS_ADD(_counter, _n)  __atomic_fetch_add(&(_counter), (_n), __ATOMIC_RELAXED)
+#define SENSOR_STATS_LOAD(_counter)     __atomic_load_n(&(_counter), __ATOMIC_RELAXED)
+
+static __thread unsigned int    s_sensor_stats_shard = UINT_MAX;
+static unsigned int             s_sensor_stats_next_shard = 0;
+
+/* ************************************************************************ */
+/** counters shard of current thread: threads rarely write the same counters */
+static inline unsigned int sensor_stats_shard() {
+    if (s_sensor_stats_shard == UINT_MAX) {
+        s_sensor_stats_shard = __atomic_fetch_add(&s_sensor_stats_next_shard, 1, __ATOMIC_RELAXED)
+                               % SENSOR_STATS_SHARDS;
+    }
+    return s_sensor_stats_shard;
+}
+
+/* ************************************************************************ */
+/** monotonic time of stats, independent of coarse sensor context clocks */
+static inline uint64_t sensor_stats_now_ns() {
+    struct timespec ts;
+
+    if (vclock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+/* ************************************************************************ */
+static inline sensor_family_stats_t * sensor_family_stats(sensor_family_t * family) {
+    return &(((sensor_family_priv_t *) family)->stats[sensor_stats_shard()]);
+}
+
+/* ************************************************************************ */
+/** account one update call of family started at start_ns */
+static inline void sensor_family_stats_update(sensor_family_t * family, uint64_t start_ns) {
+    sensor_family_stats_t * stats;
+    uint64_t                ns = sensor_stats_now_ns();
+    unsigned int            bucket;
+
+    if (start_ns == 0 || ns < start_ns) {
+        return ;
+    }
+    ns -= start_ns;
+    bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+    if (bucket >= SENSOR_STATS_HIST_NB)
+        bucket = SENSOR_STATS_HIST_NB - 1;
+
+    stats = sensor_family_stats(family);
+    SENSOR_STATS_ADD(stats->updates, 1);
+    SENSOR_STATS_ADD(stats->update_ns, ns);
+    SENSOR_STATS_ADD(stats->update_hist[bucket], 1);
+}
+
+/* ************************************************************************
+ * SENSOR TRACE : optional tracepoints, see SENSOR_TRACE_BEGIN() in sensor_private.h
+ * ************************************************************************ */
+
+#ifdef SENSOR_ENABLE_TRACE
+# ifdef SENSOR_ENABLE_USDT
+#  include <sys/sdt.h>
+#  define SENSOR_TRACE_USDT(_name, _tp, _fam, _n, _ns) \
+            DTRACE_PROBE4(libvsensors, _name, (int) (_tp), (_fam), (_n), (_ns))
+# else
+#  define SENSOR_TRACE_USDT(_name, _tp, _fam, _n, _ns)
+# endif
+
+sensor_trace_hook_t     g_sensor_trace_hook = NULL;
+static void *           s_sensor_trace_data = NULL;
+
+/* ************************************************************************ */
+uint64_t sensor_trace_begin(sensor_tracepoint_t tracepoint, const char * family,
+                            unsigned int samples) {
+    sensor_trace_hook_t hook = __atomic_load_n(&g_sensor_trace_hook, __ATOMIC_ACQUIRE);
+    uint64_t            start_ns = sensor_stats_now_ns();
+
+    SENSOR_TRACE_USDT(begin, tracepoint, family, samples, 0);
+    if (hook != NULL) {
+        hook(tracepoint, STP_BEGIN, family, samples, 0,
+             __atomic_load_n(&s_sensor_trace_data, __ATOMIC_RELAXED));
+    }
+    /* 0 means not traced for SENSOR_TRACE_END() */
+    return start_ns == 0 ? 1 : start_ns;
+}
+
+/* ************************************************************************ */
+void sensor_trace_end(sensor_tracepoint_t tracepoint, const char * family,
+                      unsigned int samples, uint64_t start_ns) {
+    sensor_trace_hook_t hook = __atomic_load_n(&g_sensor_trace_hook, __ATOMIC_ACQUIRE);
+    uint64_t            ns = sensor_stats_now_ns();
+
+    ns = ns > start_ns ? ns - start_ns : 0;
+    SENSOR_TRACE_USDT(end, tracepoint, family, samples, ns);
+    if (hook != NULL) {
+        hook(tracepoint, STP_END, family, samples, ns,
+             __atomic_load_n(&s_sensor_trace_data, __ATOMIC_RELAXED));
+    }
+}
+#endif
+
+/* ************************************************************************ */
+sensor_status_t sensor_trace_register(sensor_trace_hook_t hook, void * user_data) {
+#ifdef SENSOR_ENABLE_TRACE
+    /* user_data is published before its hook */
+    __atomic_store_n(&s_sensor_trace_data, user_data, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_sensor_trace_hook, hook, __ATOMIC_RELEASE);
+    return SENSOR_SUCCESS;
+#else
+    (void) hook;
+    (void) user_data;
+    return SENSOR_NOT_SUPPORTED;
+#endif
+}
+
+/* ************************************************************************ */
+void sensor_family_stats_reads(sensor_family_t * family, unsigned int n) {
+    SENSOR_STATS_ADD(sensor_family_stats(family)->reads, n);
+}
+
+/* ************************************************************************ */
+void sensor_family_stats_get(const sensor_family_t * family, sensor_family_stats_t * stats) {
+    const sensor_family_priv_t * priv = (const sensor_family_priv_t *) family;
+
+    memset(stats, 0, sizeof(*stats));
+    for (unsigned int i = 0; i < SENSOR_STATS_SHARDS; ++i) {
+        const sensor_family_stats_t * shard = &(priv->stats[i]);
+
+        stats->updates += SENSOR_STATS_LOAD(shard->updates);
+        stats->update_ns += SENSOR_STATS_LOAD(shard->update_ns);
+        for (unsigned int b = 0; b < SENSOR_STATS_HIST_NB; ++b) {
+            stats->update_hist[b] += SENSOR_STATS_LOAD(shard->update_hist[b]);
+        }
+        stats->ticks += SENSOR_STATS_LOAD(shard->ticks);
+        stats->updated += SENSOR_STATS_LOAD(shard->updated);
+        stats->unchanged += SENSOR_STATS_LOAD(shard->unchanged);
+        stats->reads += SENSOR_STATS_LOAD(shard->reads);
+        stats->reloads += SENSOR_STATS_LOAD(shard->reloads);
+        stats->reload_ns += SENSOR_STATS_LOAD(shard->reload_ns);
+    }
+}
+
+/* ************************************************************************ */
+void sensor_ctx_stats_get(sensor_ctx_t * sctx, sensor_ctx_stats_t * stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (unsigned int i = 0; i < SENSOR_STATS_SHARDS; ++i) {
+        stats->lock_waits += SENSOR_STATS_LOAD(sctx->stats[i].lock_waits);
+        stats->lock_wait_ns += SENSOR_STATS_LOAD(sctx->stats[i].lock_wait_ns);
+    }
+}
+
+/* ************************************************************************ */
+uint64_t sensor_family_stats_percentile(const sensor_family_stats_t * stats,
+                                        unsigned int percent) {
+    uint64_t total = 0, rank, count = 0;
+
+    for (unsigned int b = 0; b < SENSOR_STATS_HIST_NB; ++b) {
+        total += stats->update_hist[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    rank = (total * percent + 99) / 100;
+    for (unsigned int b = 0; b < SENSOR_STATS_HIST_NB; ++b) {
+        if ((count += stats->update_hist[b]) >= rank) {
+            /* middle of bucket [2^b, 2^(b+1)[ */
+            return b == 0 ? 1 : (UINT64_C(3) << b) / 2;
+        }
+    }
+    return UINT64_C(1) << SENSOR_STATS_HIST_NB;
+}
+
 /* ************************************************************************ */
 static sensor_status_t sensor_list_build(sensor_ctx_t *sctx);
+static sensor_status_t sensor_family_list_sensors(sensor_family_t * fam, slist_t ** p_last);
+static void            sensor_export_free_one(void * vdata);
+static void            sensor_shm_free_one(sensor_shm_t * shm);
+
+
+/* ************************************************************************
+ * SENSOR NAMES : interned '<family>/<label>' of listed sensor_desc_t
+ * ************************************************************************ */
+
+/** type of sensor_desc_t.fullname, allocated in one block with its name */
+struct sensor_name_s {
+    unsigned int        hash;       /* sensor_name_hash() of name */
+    unsigned int        hash_ci;    /* sensor_name_hash() of casefolded name */
+    size_t              len;
+    char *              render_prefix; /* see sensor_render_getprefix() */
+    size_t              render_len;
+    char                name[];
+};
+
+/* ************************************************************************ */
+/** FNV-1a hash of 'fam/label', without formatting it, casefolded if requested */
+static unsigned int sensor_name_hash(const char * fam, size_t fam_len,
+                                      const char * label, int casefold) {
+    unsigned int hash = 2166136261U;
+
+    for (const char * end = fam + fam_len; fam < end; ++fam) {
+        hash = (hash ^ (unsigned char) (casefold ? tolower((unsigned char) *fam) : *fam))
+               * 16777619U;
+    }
+    hash = (hash ^ '/') * 16777619U;
+    for ( ; *label != 0; ++label) {
+        hash = (hash ^ (unsigned char) (casefold ? tolower((unsigned char) *label) : *label))
+               * 16777619U;
+    }
+    return hash;
+}
+
+/* ************************************************************************ */
+/** set desc->fullname, done when the desc is listed, desc->fullname left NULL on error */
+static sensor_status_t sensor_name_intern(sensor_desc_t * desc) {
+    const char *            fam_name    = SENSOR_DESC_FAMNAME(desc);
+    const char *            label       = SENSOR_DESC_LABEL(desc);
+    size_t                  fam_len     = strlen(fam_name);
+    size_t                  label_len   = strlen(label);
+    struct sensor_name_s *  fullname;
+
+    if ((fullname = malloc(sizeof(*fullname) + fam_len + label_len + 2)) == NULL) {
+        desc->fullname = NULL;
+        return SENSOR_ERROR;
+    }
+    memcpy(fullname->name, fam_name, fam_len);
+    fullname->name[fam_len] = '/';
+    memcpy(fullname->name + fam_len + 1, label, label_len + 1);
+    fullname->len = fam_len + label_len + 1;
+    fullname->hash = sensor_name_hash(fam_name, fam_len, label, 0);
+    fullname->hash_ci = sensor_name_hash(fam_name, fam_len, label, 1);
+    fullname->render_prefix = NULL;
+    fullname->render_len = 0;
+    desc->fullname = fullname;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static void sensor_name_release(sensor_desc_t * desc) {
+    if (desc->fullname != NULL) {
+        if (desc->fullname->render_prefix != NULL)
+            free(desc->fullname->render_prefix);
+        free((void *) desc->fullname);
+        desc->fullname = NULL;
+    }
+}
+
+/* ************************************************************************ */
+/** strcasecmp() of '<family>/<label>[/<suffix>]' of two descs, without formatting them */
+static int sensor_name_casecmp(const sensor_desc_t * d1, const char * suffix1,
+                               const sensor_desc_t * d2, const char * suffix2) {
+    const char *    pieces1[6], * pieces2[6];
+    const char **   it1 = pieces1, ** it2 = pieces2;
+    const char *    s1, * s2;
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        const sensor_desc_t *   desc    = i == 0 ? d1 : d2;
+        const char *            suffix  = i == 0 ? suffix1 : suffix2;
+        const char **           pieces  = i == 0 ? pieces1 : pieces2;
+        unsigned int            n       = 0;
+
+        if (desc->fullname != NULL) {
+            pieces[n++] = desc->fullname->name;
+        } else {
+            pieces[n++] = SENSOR_DESC_FAMNAME(desc);
+            pieces[n++] = "/";
+            pieces[n++] = SENSOR_DESC_LABEL(desc);
+        }
+        if (suffix != NULL) {
+            pieces[n++] = "/";
+            pieces[n++] = suffix;
+        }
+        pieces[n] = NULL;
+    }
+    for (s1 = *it1, s2 = *it2; ; ++s1, ++s2) {
+        int c1, c2;
+        while (s1 != NULL && *s1 == 0)
+            s1 = *(++it1);
+        while (s2 != NULL && *s2 == 0)
+            s2 = *(++it2);
+        if (s1 == NULL || s2 == NULL) {
+            return (s1 != NULL) - (s2 != NULL);
+        }
+        if ((c1 = tolower((unsigned char) *s1)) != (c2 = tolower((unsigned char) *s2))) {
+            return c1 - c2;
+        }
+    }
+}
+
+/* ************************************************************************ */
+const char * sensor_desc_fullname(
+                        const sensor_desc_t *   sensor,
+                        size_t *                p_len,
+                        unsigned int *          p_hash) {
+    if (sensor == NULL || sensor->fullname == NULL) {
+        return NULL;
+    }
+    if (p_len != NULL) {
+        *p_len = sensor->fullname->len;
+    }
+    if (p_hash != NULL) {
+        *p_hash = sensor->fullname->hash;
+    }
+    return sensor->fullname->name;
+}
 
 
 /* ************************************************************************
@@ -162,6 +569,13 @@ static int sensorwatchparam_cmp(const void * vw1, const void * vw2) {
                       - w2->watch.update_interval.tv_usec)) != 0) {
         return ret;
     }
+    if (timercmp(&(w1->watch.update_interval_max), &(w2->watch.update_interval_max), !=)) {
+        return timercmp(&(w1->watch.update_interval_max),
+                        &(w2->watch.update_interval_max), <) ? -1 : 1;
+    }
+    if (timercmp(&(w1->watch.update_slack), &(w2->watch.update_slack), !=)) {
+        return timercmp(&(w1->watch.update_slack), &(w2->watch.update_slack), <) ? -1 : 1;
+    }
     if ((ret = memcmp(&(w1->watch.callback), &(w2->watch.callback),
                       sizeof(sensor_watch_callback_t))) != 0) {
         return ret;
@@ -169,6 +583,24 @@ static int sensorwatchparam_cmp(const void * vw1, const void * vw2) {
     if ((ret = (size_t) w1->watch.callback_data - (size_t) w2->watch.callback_data) != 0) {
         return ret;
     }
+    if (w1->watch.history_size != w2->watch.history_size) {
+        return w1->watch.history_size < w2->watch.history_size ? -1 : 1;
+    }
+    if (w1->watch.archive_size != w2->watch.archive_size) {
+        return w1->watch.archive_size < w2->watch.archive_size ? -1 : 1;
+    }
+    if (w1->watch.flags != w2->watch.flags) {
+        return w1->watch.flags < w2->watch.flags ? -1 : 1;
+    }
+    if (w1->watch.level_hysteresis != w2->watch.level_hysteresis) {
+        return w1->watch.level_hysteresis < w2->watch.level_hysteresis ? -1 : 1;
+    }
+    if (w1->watch.deadband_abs != w2->watch.deadband_abs) {
+        return w1->watch.deadband_abs < w2->watch.deadband_abs ? -1 : 1;
+    }
+    if (w1->watch.deadband_pct != w2->watch.deadband_pct) {
+        return w1->watch.deadband_pct < w2->watch.deadband_pct ? -1 : 1;
+    }
     for (unsigned int i = 0; i < SENSOR_LEVEL_NB; ++i) {
         if ((ret = w1->watch.update_levels[i].type
                  - w2->watch.update_levels[i].type) != 0) {
@@ -179,16 +611,19 @@ static int sensorwatchparam_cmp(const void * vw1, const void * vw2) {
             return ret;
         }
     }
-    for (sensor_property_t * prop1 = w1->watch.properties; prop1; ++prop1, ++len1)
+    for (sensor_property_t * prop1 = w1->watch.properties;
+            SENSOR_PROPERTY_VALID(prop1); ++prop1, ++len1)
         ; /* nothing */
-    for (sensor_property_t * prop2 = w2->watch.properties; prop2; ++prop2, ++len2)
+    for (sensor_property_t * prop2 = w2->watch.properties;
+            SENSOR_PROPERTY_VALID(prop2); ++prop2, ++len2)
         ; /* nothing */
     if (len1 != len2)
         return len1 - len2;
-    for (sensor_property_t * prop1 = w1->watch.properties, *prop2; prop1; ++prop1) {
+    for (sensor_property_t * prop1 = w1->watch.properties, *prop2;
+            SENSOR_PROPERTY_VALID(prop1); ++prop1) {
         ret = 0;
-        for (prop2 = w2->watch.properties; prop2; ++prop2) {
-            int cmp = strcmp(prop1->name, prop2->name);
+        for (prop2 = w2->watch.properties; SENSOR_PROPERTY_VALID(prop2); ++prop2) {
+            int cmp = strcmp(SENSOR_PROP_NAME(prop1), SENSOR_PROP_NAME(prop2));
             if (cmp != 0) {
                 if (ret == 0)
                     ret = cmp; // keep first name compare value, will be cmp return if not found.
@@ -199,7 +634,7 @@ static int sensorwatchparam_cmp(const void * vw1, const void * vw2) {
                 break ;
             return cmp; // same name but different value: compare failed.
         }
-        if (prop2 == NULL)
+        if (!SENSOR_PROPERTY_VALID(prop2))
             return ret ? ret : 1;
     }
     return 0;
@@ -287,21 +722,10 @@ static int sensorprop_alphacmp(const void * vp1, const void * vp2) {
     } else if (p1->property == NULL || p2->property == NULL) {
         return p1->property - p2->property;
     } else {
-        char    label1[SENSOR_LABEL_SIZE*2];
-        char    label2[SENSOR_LABEL_SIZE*2];
         int     ret;
 
-        snprintf(label1, sizeof(label1) / sizeof(*label1), "%s/%s/%s",
-                 SENSOR_DESC_FAMNAME(p1->desc),
-                 SENSOR_DESC_LABEL(p1->desc),
-                 SENSOR_PROP_NAME(p1->property));
-
-        snprintf(label2, sizeof(label2) / sizeof(*label2), "%s/%s/%s",
-                 SENSOR_DESC_FAMNAME(p2->desc),
-                 SENSOR_DESC_LABEL(p2->desc),
-                 SENSOR_PROP_NAME(p2->property));
-
-        ret = strcasecmp(label1, label2);
+        ret = sensor_name_casecmp(p1->desc, SENSOR_PROP_NAME(p1->property),
+                                  p2->desc, SENSOR_PROP_NAME(p2->property));
         if (ret == 0 && p1 != p2
             && (p1->property->value.type != SENSOR_VALUE_NB
                 && p2->property->value.type != SENSOR_VALUE_NB)) {
@@ -312,6 +736,255 @@ static int sensorprop_alphacmp(const void * vp1, const void * vp2) {
     }
 }
 
+/* ************************************************************************
+ * SENSOR HISTORY : fixed-capacity ring of the last points of a sample,
+ * with monotonic deques giving min/max and a running sum in O(1).
+ * Pushed under read lock + Lock Lock, as samples of different families are
+ * updated concurrently, and as sensor_history_get() can run meanwhile.
+ * ************************************************************************ */
+
+typedef struct sensor_history_s sensor_history_t;
+
+struct sensor_history_s {
+    unsigned int            capacity;
+    unsigned int            count;
+    unsigned long           seq;        /* number of points pushed since (re)allocation */
+    long double             sum;
+    unsigned int            min_first, min_count;
+    unsigned int            max_first, max_count;
+    unsigned long *         min_seqs;   /* ring of point seqs, values increasing */
+    unsigned long *         max_seqs;   /* ring of point seqs, values decreasing */
+    sensor_history_point_t  points[];
+};
+
+#define SENSOR_HISTORY_POINT(_h, _seq)  (&((_h)->points[(_seq) % (_h)->capacity]))
+
+/* ************************************************************************ */
+static sensor_history_t * sensor_history_create(unsigned int capacity) {
+    sensor_history_t * history;
+
+    if (capacity == 0 || capacity > (UINT_MAX / 2) / sizeof(sensor_history_point_t)) {
+        return NULL;
+    }
+    if ((history = calloc(1, sizeof(*history) + capacity * sizeof(*history->points)
+                             + 2 * capacity * sizeof(*history->min_seqs))) == NULL) {
+        return NULL;
+    }
+    history->capacity = capacity;
+    history->min_seqs = (unsigned long *) (history->points + capacity);
+    history->max_seqs = history->min_seqs + capacity;
+    return history;
+}
+
+/* ************************************************************************ */
+/** pop the front of a deque if it holds the evicted point seq */
+static inline void sensor_history_deque_evict(
+                        unsigned long * seqs, unsigned int * p_first, unsigned int * p_count,
+                        unsigned int capacity, unsigned long seq) {
+    if (*p_count > 0 && seqs[*p_first] == seq) {
+        *p_first = (*p_first + 1) % capacity;
+        --(*p_count);
+    }
+}
+
+/* ************************************************************************ */
+/** push seq at deque back, after dropping points which can no longer be the
+ * min (sign > 0: drop values >= new) or the max (sign < 0: drop values <= new) */
+static inline void sensor_history_deque_push(
+                        sensor_history_t * h, unsigned long * seqs,
+                        unsigned int first, unsigned int * p_count,
+                        unsigned long seq, int sign) {
+    const sensor_value_t * value = &(SENSOR_HISTORY_POINT(h, seq)->value);
+
+    while (*p_count > 0) {
+        unsigned long last = seqs[(first + *p_count - 1) % h->capacity];
+
+        if (sensor_value_compare(&(SENSOR_HISTORY_POINT(h, last)->value), value) * sign < 0)
+            break ;
+        --(*p_count);
+    }
+    seqs[(first + *p_count) % h->capacity] = seq;
+    ++(*p_count);
+}
+
+/* ************************************************************************ */
+static void sensor_history_push(sensor_sample_t * sample, const struct timeval * now) {
+    sensor_ctx_t *           sctx = sample->desc->family->sctx;
+    sensor_history_t *       h;
+    sensor_history_point_t * point;
+    unsigned long            seq;
+
+    if (SENSOR_VALUE_IS_BUFFER(sample->value.type) || sample->value.type == SENSOR_VALUE_NULL
+    ||  sample->desc->properties == s_sensor_loading_properties
+    ||  sample->desc->label == s_sensor_loading_label) {
+        return ;
+    }
+    SENSOR_LOCK_LOCK(sctx);
+    if ((h = sample->history) == NULL || h->capacity != sample->watch->history_size
+    ||  (h->count > 0 && SENSOR_HISTORY_POINT(h, h->seq - 1)->value.type != sample->value.type)) {
+        /* new watch history size or value type: restart history */
+        if (h != NULL)
+            free(h);
+        if ((h = sample->history = sensor_history_create(sample->watch->history_size)) == NULL) {
+            SENSOR_LOCK_UNLOCK(sctx);
+            LOG_WARN(sctx->log, "cannot allocate history of '%s/%s'",
+                     SENSOR_DESC_FAMNAME(sample->desc), SENSOR_DESC_LABEL(sample->desc));
+            return ;
+        }
+    }
+    seq = h->seq++;
+    if (h->count == h->capacity) {
+        /* ring full: evict the oldest point */
+        unsigned long old = seq - h->capacity;
+
+        sensor_history_deque_evict(h->min_seqs, &h->min_first, &h->min_count, h->capacity, old);
+        sensor_history_deque_evict(h->max_seqs, &h->max_first, &h->max_count, h->capacity, old);
+        h->sum -= sensor_value_todouble(&(SENSOR_HISTORY_POINT(h, old)->value));
+    } else {
+        ++(h->count);
+    }
+    point = SENSOR_HISTORY_POINT(h, seq);
+    point->time = *now;
+    point->value = sample->value;
+    h->sum += sensor_value_todouble(&(point->value));
+
+    sensor_history_deque_push(h, h->min_seqs, h->min_first, &h->min_count, seq, +1);
+    sensor_history_deque_push(h, h->max_seqs, h->max_first, &h->max_count, seq, -1);
+
+    if (seq % h->capacity == h->capacity - 1) {
+        /* recompute the sum at each ring turn to avoid floating point drift */
+        h->sum = 0.0L;
+        for (unsigned int i = 0; i < h->count; ++i) {
+            h->sum += sensor_value_todouble(&(h->points[i].value));
+        }
+    }
+    SENSOR_LOCK_UNLOCK(sctx);
+}
+
+/* ************************************************************************ */
+int sensor_history_get(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    unsigned int                start,
+                    sensor_history_point_t *    points,
+                    unsigned int                max_points) {
+    const sensor_history_t *    h;
+    unsigned long               oldest;
+    unsigned int                n = 0;
+
+    if (sctx == NULL || sample == NULL || (points == NULL && max_points > 0)) {
+        return -1;
+    }
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    SENSOR_LOCK_LOCK(sctx);
+    if ((h = sample->history) == NULL) {
+        SENSOR_LOCK_UNLOCK(sctx);
+        sensor_unlock(sctx);
+        return -1;
+    }
+    oldest = h->seq - h->count;
+    for (unsigned int i = start; i < h->count && n < max_points; ++i) {
+        points[n++] = *SENSOR_HISTORY_POINT(h, oldest + i);
+    }
+    SENSOR_LOCK_UNLOCK(sctx);
+    sensor_unlock(sctx);
+
+    return n;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_history_stats(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    sensor_history_stats_t *    stats) {
+    const sensor_history_t * h;
+
+    if (sctx == NULL || sample == NULL || stats == NULL) {
+        return SENSOR_ERROR;
+    }
+    memset(stats, 0, sizeof(*stats));
+    stats->min.type = stats->max.type = SENSOR_VALUE_NULL;
+
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    SENSOR_LOCK_LOCK(sctx);
+    if ((h = sample->history) == NULL) {
+        SENSOR_LOCK_UNLOCK(sctx);
+        sensor_unlock(sctx);
+        return SENSOR_ERROR;
+    }
+    stats->capacity = h->capacity;
+    if ((stats->count = h->count) > 0) {
+        stats->min = SENSOR_HISTORY_POINT(h, h->min_seqs[h->min_first])->value;
+        stats->max = SENSOR_HISTORY_POINT(h, h->max_seqs[h->max_first])->value;
+        stats->sum = h->sum;
+        stats->avg = h->sum / h->count;
+        stats->first = SENSOR_HISTORY_POINT(h, h->seq - h->count)->time;
+        stats->last = SENSOR_HISTORY_POINT(h, h->seq - 1)->time;
+    }
+    SENSOR_LOCK_UNLOCK(sctx);
+    sensor_unlock(sctx);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************
+ * SENSOR SAMPLE SLAB : samples of a family are allocated in contiguous chunks,
+ * so that update passes, mostly done family by family, walk linear memory.
+ * Samples are never moved: their addresses are stable handles.
+ * Modified under write lock only.
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+static sensor_sample_t * sensor_sample_alloc(sensor_family_t * family) {
+    sensor_slab_t *     slab = &(((sensor_family_priv_t *) family)->slab);
+    sensor_sample_t *   sample;
+    unsigned int        generation = 0;
+
+    if (slab->free_list != NULL) {
+        sample = slab->free_list;
+        slab->free_list = *((void **) sample);
+        generation = sample->generation;
+    } else {
+        sensor_slab_chunk_t * chunk = slab->chunks;
+
+        if (chunk == NULL || chunk->used >= SENSOR_SLAB_CHUNK) {
+            if ((chunk = malloc(sizeof(*chunk))) == NULL) {
+                return NULL;
+            }
+            chunk->used = 0;
+            chunk->next = slab->chunks;
+            slab->chunks = chunk;
+        }
+        sample = &(chunk->samples[chunk->used++]);
+    }
+    memset(sample, 0, sizeof(*sample));
+    sample->generation = generation;
+    ++slab->count;
+    return sample;
+}
+
+/* ************************************************************************ */
+static void sensor_sample_release(sensor_sample_t * sample) {
+    sensor_slab_t * slab = &(((sensor_family_priv_t *) sample->desc->family)->slab);
+
+    /* pending dispatcher events of this sample are now stale */
+    ++(sample->generation);
+    *((void **) sample) = slab->free_list;
+    slab->free_list = sample;
+    --slab->count;
+}
+
+/* ************************************************************************ */
+static void sensor_slab_free(sensor_slab_t * slab) {
+    for (sensor_slab_chunk_t * chunk = slab->chunks, * next; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    slab->chunks = NULL;
+    slab->free_list = NULL;
+    slab->count = 0;
+}
+
 /* ************************************************************************
  * TREES : FREEING FUNCTIONS
  * ************************************************************************ */
@@ -326,12 +999,17 @@ static void sensor_watch_free_one(void * vdata) {
     if (sensor->userfreefun != NULL) {
         sensor->userfreefun(sensor);
     }
-    free(sensor);
+    if (sensor->history != NULL) {
+        free(sensor->history);
+    }
+    sensor_archive_free(sensor->archive);
+    sensor_sample_release(sensor);
 }
 
 /* ************************************************************************ */
 static void sensor_desc_free_one(void * vdata) {
     sensor_desc_t * sensor = (sensor_desc_t *) vdata;
+    sensor_name_release(sensor);
     if (sensor->properties == s_sensor_loading_properties) {
         if (sensor->label != NULL)
             free((void *) (sensor->label));
@@ -351,64 +1029,398 @@ static void sensor_desc_free_one(void * vdata) {
 
 
 /* ************************************************************************
- * SENSOR / FAMILY INIT/FREE FUNCTIONS
+ * SENSOR SCHEDULER : watched samples ordered by next_update_time
+ * Modified under write lock, or under Lock Lock when only read lock is held.
  * ************************************************************************ */
 
 /* ************************************************************************ */
-static sensor_status_t sensor_family_free(sensor_family_t * fam, sensor_ctx_t * sctx) {
-    sensor_status_t ret = SENSOR_SUCCESS;
+static inline int sensor_sched_before(const sensor_sample_t * s1, const sensor_sample_t * s2) {
+    return timercmp(&(s1->next_update_time), &(s2->next_update_time), <);
+}
 
-    if (fam == NULL) {
-        return SENSOR_ERROR;
-    }
-    if (fam->info->free && fam->info->free(fam) != SENSOR_SUCCESS) {
-        LOG_ERROR(sctx->log, "sensor family %s cannot be freed", fam->info->name);
-        ret = SENSOR_NOT_SUPPORTED;
-    }
-    logpool_release(sctx->logpool, fam->log);
-    free(fam);
-    return ret;
+/* ************************************************************************ */
+static inline void sensor_sched_set(sensor_sched_t * sched, unsigned int idx,
+                                    sensor_sample_t * sample) {
+    sched->heap[idx] = sample;
+    sample->sched_idx = idx + 1;
 }
 
 /* ************************************************************************ */
-static sensor_status_t sensor_family_register_unlocked(
-                            sensor_ctx_t *              sctx,
-                            const sensor_family_info_t *fam_info,
-                            sensor_family_t **          p_fam) {
-    sensor_family_t *   fam;
-    sensor_status_t     ret;
+static void sensor_sched_siftup(sensor_sched_t * sched, unsigned int idx) {
+    sensor_sample_t * sample = sched->heap[idx];
 
-    /* sanity check on family_info_t * and its name */
-    if (fam_info == NULL || fam_info->name == NULL) {
-        return SENSOR_ERROR ;
-    }
-    if ((fam = calloc(1, sizeof(sensor_family_t))) == NULL) {
-        LOG_WARN(sctx->log, "sensor family %s cannot be allocated", fam_info->name);
-        return SENSOR_ERROR;
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) / 2;
+        if (!sensor_sched_before(sample, sched->heap[parent]))
+            break ;
+        sensor_sched_set(sched, idx, sched->heap[parent]);
+        idx = parent;
     }
-    fam->sctx = sctx;
-    fam->info = fam_info;
-    fam->log = logpool_getlog(sctx->logpool, fam->info->name, LPG_TRUEPREFIX);
+    sensor_sched_set(sched, idx, sample);
+}
 
-    /* run family init() if provided */
-    if (fam->info->init && (ret = fam->info->init(fam)) != SENSOR_SUCCESS) {
-        if (ret == SENSOR_NOT_SUPPORTED)
-            LOG_INFO(sctx->log, "%s sensors not supported on this system", fam->info->name);
-        else
-            LOG_ERROR(sctx->log, "sensor family %s cannot be initialized", fam->info->name);
-        logpool_release(sctx->logpool, fam->log);
+/* ************************************************************************ */
+static void sensor_sched_siftdown(sensor_sched_t * sched, unsigned int idx) {
+    sensor_sample_t * sample = sched->heap[idx];
+
+    while (1) {
+        unsigned int child = idx * 2 + 1;
+        if (child >= sched->count)
+            break ;
+        if (child + 1 < sched->count
+        &&  sensor_sched_before(sched->heap[child + 1], sched->heap[child]))
+            ++child;
+        if (!sensor_sched_before(sched->heap[child], sample))
+            break ;
+        sensor_sched_set(sched, idx, sched->heap[child]);
+        idx = child;
+    }
+    sensor_sched_set(sched, idx, sample);
+}
+
+/* ************************************************************************ */
+static sensor_status_t sensor_sched_reserve(sensor_sched_t * sched, unsigned int count) {
+    sensor_sample_t **  heap;
+    unsigned int        size;
+
+    if (count <= sched->size)
+        return SENSOR_SUCCESS;
+
+    for (size = sched->size ? sched->size : SENSOR_SCHED_MINSIZE; size < count; size *= 2)
+        ; /* nothing but loop */
+    if ((heap = realloc(sched->heap, size * sizeof(*heap))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    sched->heap = heap;
+    sched->size = size;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** re-order a scheduled sample after a change of its next_update_time */
+static void sensor_sched_fix(sensor_sched_t * sched, sensor_sample_t * sample) {
+    unsigned int idx = sample->sched_idx - 1;
+
+    if (idx > 0 && sensor_sched_before(sample, sched->heap[(idx - 1) / 2])) {
+        sensor_sched_siftup(sched, idx);
+    } else {
+        sensor_sched_siftdown(sched, idx);
+    }
+}
+
+/* ************************************************************************ */
+/** schedule a sample, or re-order it if already scheduled */
+static sensor_status_t sensor_sched_push(sensor_ctx_t * sctx, sensor_sample_t * sample) {
+    sensor_sched_t * sched = &(sctx->sched);
+
+    if (sample->sched_idx != 0) {
+        sensor_sched_fix(sched, sample);
+        return SENSOR_SUCCESS;
+    }
+    /* samples of families without update() are never due */
+    if (sample->desc->family->info->update == NULL) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if (sensor_sched_reserve(sched, sched->count + 1) != SENSOR_SUCCESS) {
+        LOG_WARN(sctx->log, "%s(): cannot grow scheduler: %s", __func__, strerror(errno));
+        return SENSOR_ERROR;
+    }
+    sensor_sched_set(sched, sched->count++, sample);
+    sensor_sched_siftup(sched, sched->count - 1);
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** unschedule a sample, nothing done if not scheduled */
+static void sensor_sched_remove(sensor_ctx_t * sctx, sensor_sample_t * sample) {
+    sensor_sched_t *    sched   = &(sctx->sched);
+    unsigned int        idx     = sample->sched_idx;
+
+    if (idx == 0) {
+        return ;
+    }
+    sample->sched_idx = 0;
+    if (--idx == --(sched->count)) {
+        return ;
+    }
+    sensor_sched_set(sched, idx, sched->heap[sched->count]);
+    sensor_sched_fix(sched, sched->heap[idx]);
+}
+
+/* ************************************************************************ */
+/** get the nearest sample from the scheduler if it is due, NULL otherwise */
+static inline sensor_sample_t * sensor_sched_pop_due(sensor_ctx_t * sctx,
+                                                     const struct timeval * now) {
+    sensor_sched_t *    sched = &(sctx->sched);
+    sensor_sample_t *   sample;
+
+    if (sched->count == 0
+    ||  timercmp(now, &(sched->heap[0]->next_update_time), <)) {
+        return NULL;
+    }
+    sample = sched->heap[0];
+    sensor_sched_remove(sctx, sample);
+    return sample;
+}
+
+/* ************************************************************************ */
+/** rebuild the scheduler from the watch list (after a family reload) */
+static sensor_status_t sensor_sched_rebuild(sensor_ctx_t * sctx) {
+    sensor_sched_t * sched = &(sctx->sched);
+
+    sched->count = 0;
+    if (sensor_sched_reserve(sched, slist_length(sctx->watchlist)) != SENSOR_SUCCESS) {
+        LOG_WARN(sctx->log, "%s(): cannot grow scheduler: %s", __func__, strerror(errno));
+        SLIST_FOREACH_DATA(sctx->watchlist, sample, sensor_sample_t *) {
+            sample->sched_idx = 0;
+        }
+        return SENSOR_ERROR;
+    }
+    SLIST_FOREACH_DATA(sctx->watchlist, sample, sensor_sample_t *) {
+        if (sample->desc->family->info->update == NULL) {
+            sample->sched_idx = 0;
+            continue ;
+        }
+        sensor_sched_set(sched, sched->count++, sample);
+    }
+    for (unsigned int idx = sched->count / 2; idx > 0; --idx) {
+        sensor_sched_siftdown(sched, idx - 1);
+    }
+    return SENSOR_SUCCESS;
+}
+
+
+/* ************************************************************************
+ * SENSOR NAME INDEX : sensor_desc_t.fullname hash tables of sctx->sensorlist.
+ * Modified under write lock, with sctx->sensors.
+ * ************************************************************************ */
+
+#define SENSOR_INDEX_MINSIZE    64
+
+/* ************************************************************************ */
+static sensor_status_t sensor_index_grow(sensor_index_t * index) {
+    unsigned int            size = index->size == 0 ? SENSOR_INDEX_MINSIZE : index->size * 2;
+    sensor_index_entry_t ** buckets;
+
+    if ((buckets = calloc(2 * size, sizeof(*buckets))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    for (unsigned int i = 0; i < index->size; ++i) {
+        sensor_index_entry_t * next;
+        for (sensor_index_entry_t * entry = index->buckets[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            entry->next = buckets[entry->hash & (size - 1)];
+            buckets[entry->hash & (size - 1)] = entry;
+        }
+        for (sensor_index_entry_t * entry = index->buckets[index->size + i];
+                entry != NULL; entry = next) {
+            next = entry->next_ci;
+            entry->next_ci = buckets[size + (entry->hash_ci & (size - 1))];
+            buckets[size + (entry->hash_ci & (size - 1))] = entry;
+        }
+    }
+    if (index->buckets != NULL) {
+        free(index->buckets);
+    }
+    index->buckets = buckets;
+    index->size = size;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static sensor_index_entry_t ** sensor_index_lookup_desc(
+                                    sensor_index_t *        index,
+                                    const sensor_desc_t *   desc) {
+    sensor_index_entry_t ** pentry;
+
+    if (index->size == 0 || desc->fullname == NULL) {
+        return NULL;
+    }
+    for (pentry = &(index->buckets[desc->fullname->hash & (index->size - 1)]);
+            *pentry != NULL; pentry = &((*pentry)->next)) {
+        if ((*pentry)->desc == desc) {
+            return pentry;
+        }
+    }
+    return NULL;
+}
+
+/* ************************************************************************ */
+static sensor_status_t sensor_index_insert(sensor_ctx_t * sctx, const sensor_desc_t * desc) {
+    sensor_index_t *        index = &(sctx->index);
+    sensor_index_entry_t *  entry;
+
+    if (desc->fullname == NULL) {
+        return SENSOR_ERROR;
+    }
+    /* a failed grow only lengthens the chains */
+    if (index->count >= index->size && sensor_index_grow(index) != SENSOR_SUCCESS
+    &&  index->size == 0) {
+        return SENSOR_ERROR;
+    }
+    if ((entry = malloc(sizeof(*entry))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    entry->desc = desc;
+    entry->sample = NULL;
+    entry->hash = desc->fullname->hash;
+    entry->hash_ci = desc->fullname->hash_ci;
+    entry->next = index->buckets[entry->hash & (index->size - 1)];
+    index->buckets[entry->hash & (index->size - 1)] = entry;
+    entry->next_ci = index->buckets[index->size + (entry->hash_ci & (index->size - 1))];
+    index->buckets[index->size + (entry->hash_ci & (index->size - 1))] = entry;
+    ++(index->count);
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static void sensor_index_remove(sensor_ctx_t * sctx, const sensor_desc_t * desc) {
+    sensor_index_t *        index = &(sctx->index);
+    sensor_index_entry_t ** pentry;
+    sensor_index_entry_t *  entry;
+
+    if ((pentry = sensor_index_lookup_desc(index, desc)) == NULL) {
+        return ; /* not indexed (loading desc) */
+    }
+    entry = *pentry;
+    *pentry = entry->next;
+    for (pentry = &(index->buckets[index->size + (entry->hash_ci & (index->size - 1))]);
+            *pentry != NULL; pentry = &((*pentry)->next_ci)) {
+        if (*pentry == entry) {
+            *pentry = entry->next_ci;
+            break ;
+        }
+    }
+    free(entry);
+    --(index->count);
+}
+
+/* ************************************************************************ */
+/** record the watch of desc, NULL when the watch is deleted */
+static void sensor_index_set_sample(sensor_ctx_t *          sctx,
+                                    const sensor_desc_t *   desc,
+                                    sensor_sample_t *       sample) {
+    sensor_index_entry_t ** pentry;
+
+    if ((pentry = sensor_index_lookup_desc(&(sctx->index), desc)) != NULL) {
+        (*pentry)->sample = sample;
+    }
+}
+
+/* ************************************************************************ */
+/** forget all samples (b_entries=0), or free all entries (b_entries=1) */
+static void sensor_index_clear(sensor_ctx_t * sctx, int b_entries) {
+    sensor_index_t * index = &(sctx->index);
+
+    for (unsigned int i = 0; i < index->size; ++i) {
+        sensor_index_entry_t * next;
+        for (sensor_index_entry_t * entry = index->buckets[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            if (b_entries) {
+                free(entry);
+            } else {
+                entry->sample = NULL;
+            }
+        }
+    }
+    if (b_entries && index->buckets != NULL) {
+        free(index->buckets);
+        index->buckets = NULL;
+        index->size = index->count = 0;
+    }
+}
+
+
+/* ************************************************************************
+ * SENSOR / FAMILY INIT/FREE FUNCTIONS
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+static sensor_status_t sensor_family_free(sensor_family_t * fam, sensor_ctx_t * sctx) {
+    sensor_status_t ret = SENSOR_SUCCESS;
+
+    if (fam == NULL) {
+        return SENSOR_ERROR;
+    }
+    if (fam->info->free && fam->info->free(fam) != SENSOR_SUCCESS) {
+        LOG_ERROR(sctx->log, "sensor family %s cannot be freed", fam->info->name);
+        ret = SENSOR_NOT_SUPPORTED;
+    }
+    logpool_release(sctx->logpool, fam->log);
+    if (((sensor_family_priv_t *) fam)->slab.count > 0) {
+        LOG_WARN(sctx->log, "sensor family %s: %u samples still watched",
+                 fam->info->name, ((sensor_family_priv_t *) fam)->slab.count);
+    }
+    sensor_slab_free(&(((sensor_family_priv_t *) fam)->slab));
+    pthread_mutex_destroy(&(((sensor_family_priv_t *) fam)->mutex));
+    free(fam);
+    return ret;
+}
+
+/* ************************************************************************ */
+/** allocate a family, without running its init() */
+static sensor_family_t * sensor_family_create(
+                            sensor_ctx_t *              sctx,
+                            const sensor_family_info_t *fam_info) {
+    sensor_family_t *   fam;
+
+    /* sanity check on family_info_t * and its name */
+    if (fam_info == NULL || fam_info->name == NULL) {
+        return NULL;
+    }
+    if ((fam = calloc(1, sizeof(sensor_family_priv_t))) == NULL) {
+        LOG_WARN(sctx->log, "sensor family %s cannot be allocated", fam_info->name);
+        return NULL;
+    }
+    if (pthread_mutex_init(&(((sensor_family_priv_t *) fam)->mutex), NULL) != 0) {
+        LOG_WARN(sctx->log, "sensor family %s mutex cannot be initialized", fam_info->name);
         free(fam);
+        return NULL;
+    }
+    fam->sctx = sctx;
+    fam->info = fam_info;
+    fam->log = logpool_getlog(sctx->logpool, fam->info->name, LPG_TRUEPREFIX);
+
+    return fam;
+}
+
+/* ************************************************************************ */
+/** free a family created by sensor_family_create() whose init() failed */
+static void sensor_family_destroy(sensor_family_t * fam) {
+    logpool_release(fam->sctx->logpool, fam->log);
+    pthread_mutex_destroy(&(((sensor_family_priv_t *) fam)->mutex));
+    free(fam);
+}
+
+/* ************************************************************************ */
+/** run family init() if provided, this can run in a vjob for SIF_PARALLEL_INIT */
+static sensor_status_t sensor_family_init_one(sensor_family_t * fam) {
+    sensor_ctx_t *  sctx = fam->sctx;
+    sensor_status_t ret;
+
+    if (fam->info->init && (ret = fam->info->init(fam)) != SENSOR_SUCCESS) {
+        if (ret == SENSOR_NOT_SUPPORTED)
+            LOG_INFO(sctx->log, "%s sensors not supported on this system", fam->info->name);
+        else
+            LOG_ERROR(sctx->log, "sensor family %s cannot be initialized", fam->info->name);
         return ret;
     }
+    return SENSOR_SUCCESS;
+}
 
-    /* finally register family */
+/* ************************************************************************ */
+/** finally register a family successfully initialized */
+static sensor_status_t sensor_family_add_unlocked(
+                            sensor_ctx_t *              sctx,
+                            sensor_family_t *           fam,
+                            sensor_family_t **          p_fam) {
     if ((sctx->families = slist_prepend(sctx->families, fam)) == NULL) {
         LOG_ERROR(sctx->log, "sensor family %s cannot be registered", fam->info->name);
         sensor_family_free(fam, sctx);
         return SENSOR_ERROR;
     }
 
-    if (sctx->common == NULL && fam_info == &g_sensor_family_common) {
+    if (sctx->common == NULL && fam->info == &g_sensor_family_common) {
         sctx->common = fam;
     }
 
@@ -419,9 +1431,177 @@ static sensor_status_t sensor_family_register_unlocked(
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+static sensor_status_t sensor_family_register_unlocked(
+                            sensor_ctx_t *              sctx,
+                            const sensor_family_info_t *fam_info,
+                            sensor_family_t **          p_fam) {
+    sensor_family_t *   fam;
+    sensor_status_t     ret;
+
+    if ((fam = sensor_family_create(sctx, fam_info)) == NULL) {
+        return SENSOR_ERROR;
+    }
+    if ((ret = sensor_family_init_one(fam)) != SENSOR_SUCCESS) {
+        sensor_family_destroy(fam);
+        return ret;
+    }
+    return sensor_family_add_unlocked(sctx, fam, p_fam);
+}
+
+/* ************************************************************************ */
+static void * sensor_family_init_job(void * vdata) {
+    return (void *) ((long) sensor_family_init_one((sensor_family_t *) vdata));
+}
+
+/* ************************************************************************ */
+/** initialize the pending families of mask (bits of s_families_info), concurrently
+ * with SIF_PARALLEL_INIT. The common family, needed by others, is initialized first.
+ * With b_list, sensors of new families are added to the sensor list. */
+static void sensor_families_load_unlocked(sensor_ctx_t * sctx, uint32_t mask, int b_list) {
+    sensor_family_t *   fams[SENSOR_FAMILIES_NB];
+    vjob_t *            jobs[SENSOR_FAMILIES_NB];
+    sensor_status_t     ret;
+
+    if ((mask &= sctx->lazy_families) == 0) {
+        return ;
+    }
+    mask |= (sctx->lazy_families & 1U); /* s_families_info[0] is common */
+    __atomic_store_n(&(sctx->lazy_families), sctx->lazy_families & ~mask, __ATOMIC_RELEASE);
+
+    for (unsigned int i = 0; i < SENSOR_FAMILIES_NB; ++i) {
+        fams[i] = NULL;
+        jobs[i] = NULL;
+        if ((mask & (1U << i)) == 0
+        ||  (fams[i] = sensor_family_create(sctx, s_families_info[i])) == NULL) {
+            continue ;
+        }
+        if (i > 0 && (sctx->flags & SIF_PARALLEL_INIT) != 0
+        &&  (jobs[i] = vjob_run(sensor_family_init_job, fams[i])) != NULL) {
+            continue ;
+        }
+        /* serial init: the family is registered before the next one is initialized */
+        if ((ret = sensor_family_init_one(fams[i])) != SENSOR_SUCCESS) {
+            sensor_family_destroy(fams[i]);
+        } else if (sensor_family_add_unlocked(sctx, fams[i], NULL) == SENSOR_SUCCESS && b_list) {
+            sensor_family_list_sensors(fams[i], NULL);
+        }
+    }
+    for (unsigned int i = 0; i < SENSOR_FAMILIES_NB; ++i) {
+        if (jobs[i] == NULL) {
+            continue ;
+        }
+        if ((ret = (sensor_status_t) ((long) vjob_waitandfree(jobs[i]))) != SENSOR_SUCCESS) {
+            sensor_family_destroy(fams[i]);
+        } else if (sensor_family_add_unlocked(sctx, fams[i], NULL) == SENSOR_SUCCESS && b_list) {
+            sensor_family_list_sensors(fams[i], NULL);
+        }
+    }
+}
+
+/* ************************************************************************ */
+/** SIF_LAZY_INIT: initialize the pending families which can match pattern.
+ * Only a literal family name before the first '/' selects one family,
+ * any other pattern can match all of them. */
+static void sensor_families_load_pattern(sensor_ctx_t * sctx, const char * pattern,
+                                         unsigned int flags) {
+    const char *    slash;
+    uint32_t        mask = 0;
+    size_t          len;
+
+    if (__atomic_load_n(&(sctx->lazy_families), __ATOMIC_ACQUIRE) == 0) {
+        return ;
+    }
+    if (pattern == NULL || (slash = strchr(pattern, '/')) == NULL
+    ||  strpbrk(pattern, "*?[\\") < slash) {
+        mask = UINT32_MAX;
+    } else {
+        len = slash - pattern;
+        for (unsigned int i = 0; i < SENSOR_FAMILIES_NB; ++i) {
+            const char * name = s_families_info[i]->name;
+
+            if (strlen(name) == len
+            &&  ((flags & SSF_CASEFOLD) != 0 ? strncasecmp(name, pattern, len)
+                                             : strncmp(name, pattern, len)) == 0) {
+                mask |= 1U << i;
+            }
+        }
+    }
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    sensor_families_load_unlocked(sctx, mask, 1);
+    sensor_unlock(sctx);
+}
+
+/* ************************************************************************ */
+/** bits of s_families_info in comma or space separated allowlist, all if NULL */
+static uint32_t sensor_families_allowed(sensor_ctx_t * sctx, const char * families) {
+    uint32_t    mask = 1U; /* common */
+
+    if (families == NULL && (families = getenv(SENSOR_FAMILIES_ENV)) == NULL) {
+        return (1U << SENSOR_FAMILIES_NB) - 1;
+    }
+    for (const char * name = families; *name != 0; ) {
+        size_t len = strcspn(name, ", ");
+
+        for (unsigned int i = 0; len > 0 && i < SENSOR_FAMILIES_NB; ++i) {
+            if (strlen(s_families_info[i]->name) == len
+            &&  strncasecmp(s_families_info[i]->name, name, len) == 0) {
+                mask |= 1U << i;
+                break ;
+            }
+        }
+        name += len;
+        name += strspn(name, ", ");
+    }
+    LOG_VERBOSE(sctx->log, "families allowlist '%s': mask %x", families, mask);
+    return mask;
+}
+
+/* ************************************************************************ */
+/** clock of sensor context according to SIF_CLOCK_* init flags */
+static int sensor_clock_id(unsigned int flags) {
+    if ((flags & SIF_CLOCK_COARSE) != 0) {
+#ifdef CLOCK_MONOTONIC_COARSE
+        return CLOCK_MONOTONIC_COARSE;
+#else
+        return CLOCK_MONOTONIC;
+#endif
+    }
+    if ((flags & SIF_CLOCK_MONOTONIC) != 0) {
+        return CLOCK_MONOTONIC;
+    }
+    return CLOCK_MONOTONIC_RAW;
+}
+
+/* ************************************************************************ */
+/** current time of sensor context clock, in nano-seconds, 0 on error */
+static inline uint64_t sensor_clock_ns(const sensor_ctx_t * sctx) {
+    struct timespec ts;
+
+    if (vclock_gettime(sctx->clock_id, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
 /* ************************************************************************ */
 sensor_ctx_t * sensor_init(logpool_t * logs, unsigned int flags) {
-    size_t          nb_fam  = sizeof(s_families_info) / sizeof(*s_families_info);
+    return sensor_init_families(logs, flags, NULL);
+}
+
+/* ************************************************************************ */
+sensor_ctx_t * sensor_init_families(logpool_t * logs, unsigned int flags, const char * families) {
+    return sensor_init_sysroot(logs, flags, families, NULL);
+}
+
+/* ************************************************************************ */
+const char * sensor_sysroot(const sensor_family_t * family) {
+    return family->sctx->sysroot != NULL ? family->sctx->sysroot : "";
+}
+
+/* ************************************************************************ */
+sensor_ctx_t * sensor_init_sysroot(logpool_t * logs, unsigned int flags,
+                                   const char * families, const char * sysroot) {
     sensor_ctx_t *  sctx;
 
     /* alloc main context */
@@ -429,6 +1609,8 @@ sensor_ctx_t * sensor_init(logpool_t * logs, unsigned int flags) {
         return NULL;
     }
     sctx->flags = (flags & (SIF_RESERVED-1));
+    sctx->clock_id = sensor_clock_id(sctx->flags);
+    sctx->wakeup_fds[0] = sctx->wakeup_fds[1] = -1;
 
     /* alloc mutexes */
     if (pthread_rwlock_init(&(sctx->rwlock), NULL) != 0
@@ -442,17 +1624,13 @@ sensor_ctx_t * sensor_init(logpool_t * logs, unsigned int flags) {
     sctx->write_lock_owner = SENSOR_NO_WRITE_OWNER;
     sctx->write_lock_counter = 0;
 
-    /* alloc sensor_value work buffer (for sensor_update_check) */
-    if ((sctx->work_buffer.data.b.buf = calloc(1, SENSOR_VALUE_BYTES_WORKSZ)) == NULL
-    ||  (sctx->evdata = malloc(sizeof(*(sctx->evdata)))) == NULL) {
-        LOG_WARN(sctx->log, "%s(): cannot malloc sensor work buffer: %s",
+    /* alloc event data (for watch callbacks) */
+    if ((sctx->evdata = malloc(sizeof(*(sctx->evdata)))) == NULL) {
+        LOG_WARN(sctx->log, "%s(): cannot malloc sensor event data: %s",
                  __func__, strerror(errno));
         sensor_free(sctx);
         return NULL;
     }
-    sctx->work_buffer.type = SENSOR_VALUE_BYTES;
-    sctx->work_buffer.data.b.size = 0;
-    sctx->work_buffer.data.b.maxsize = SENSOR_VALUE_BYTES_WORKSZ;
 
     /* init logpool / log */
     if (logs == NULL) {
@@ -486,13 +1664,27 @@ sensor_ctx_t * sensor_init(logpool_t * logs, unsigned int flags) {
     /* init sensor_value info cache */
     sensor_value_info_init();
 
-    /* init families */
-    for (unsigned i_fam = 0; i_fam < nb_fam && s_families_info[i_fam]; i_fam++) {
-        const sensor_family_info_t *    fam_info    = s_families_info[i_fam];
-
-        sensor_family_register_unlocked(sctx, fam_info, NULL);
+    /* system files root, "/" is the live system */
+    if (sysroot == NULL)
+        sysroot = getenv(SENSOR_SYSROOT_ENV);
+    if (sysroot != NULL && *sysroot != 0 && strcmp(sysroot, "/") != 0) {
+        size_t len = strlen(sysroot);
+
+        while (len > 1 && sysroot[len - 1] == '/')
+            --len;
+        if ((sctx->sysroot = strndup(sysroot, len)) == NULL) {
+            LOG_ERROR(sctx->log, "cannot allocate sysroot '%s'", sysroot);
+            sensor_free(sctx);
+            return NULL;
+        }
+        LOG_VERBOSE(sctx->log, "system files are read from '%s'", sctx->sysroot);
     }
 
+    /* init families, SIF_LAZY_INIT: on first use */
+    sctx->lazy_families = sensor_families_allowed(sctx, families);
+    sensor_families_load_unlocked(sctx, (sctx->flags & SIF_LAZY_INIT) == 0
+                                        ? sctx->lazy_families : 1U /* common */, 0);
+
     /* build sensor_list */
     sensor_list_build(sctx);
 
@@ -615,6 +1807,9 @@ sensor_status_t sensor_free(sensor_ctx_t * sctx) {
     sensor_lock(sctx, SENSOR_LOCK_WRITE);
     sensor_unlock(sctx);
 
+    /* deliver the pending watch events while samples are valid */
+    sensor_dispatch_destroy(sensor_dispatch_detach(sctx));
+
     n_fam = slist_length(sctx->families);
     LOG_VERBOSE(sctx->log, "%s(): "
               "%zu familie%s (>%zu bytes), %zu sensor%s (>%zu bytes), %zu watch%s (>%zu bytes).",
@@ -670,6 +1865,16 @@ sensor_status_t sensor_free(sensor_ctx_t * sctx) {
     }
     slist_free(checkhead, NULL);
 
+    /* free exporters and stream servers */
+    slist_free(sctx->exporters, sensor_export_free_one);
+    sctx->exporters = NULL;
+    slist_free(sctx->streams, sensor_stream_destroy);
+    sctx->streams = NULL;
+    if (sctx->publisher != NULL) {
+        sensor_shm_free_one(sctx->publisher);
+        sctx->publisher = NULL;
+    }
+
     /* free trees */
     avltree_free(sctx->watchs);
     avltree_free(sctx->properties);
@@ -689,6 +1894,10 @@ sensor_status_t sensor_free(sensor_ctx_t * sctx) {
     sensor_family_free(sctx->common, sctx);
     slist_free(sctx->families, NULL);
 
+    /* the remote families are freed, their mirror can be */
+    sensor_stream_mirror_free(sctx->mirror);
+    sctx->mirror = NULL;
+
     /* release / free logs & logpool */
     logpool_release(sctx->logpool, sctx->log);
     if ((sctx->flags & SPF_FREE_LOGPOOL) != 0) {
@@ -696,12 +1905,19 @@ sensor_status_t sensor_free(sensor_ctx_t * sctx) {
     }
 
     /* free work buffers */
-    if (sctx->work_buffer.data.b.buf != NULL) {
-        free(sctx->work_buffer.data.b.buf);
-    }
     if (sctx->evdata != NULL) {
         free(sctx->evdata);
     }
+    if (sctx->sched.heap != NULL) {
+        free(sctx->sched.heap);
+    }
+    if (sctx->wakeup_fds[0] >= 0) {
+        close(sctx->wakeup_fds[0]);
+        close(sctx->wakeup_fds[1]);
+    }
+    if (sctx->sysroot != NULL) {
+        free(sctx->sysroot);
+    }
 
     /* free mutexes */
     pthread_rwlock_destroy(&(sctx->rwlock));
@@ -714,106 +1930,151 @@ sensor_status_t sensor_free(sensor_ctx_t * sctx) {
 }
 
 /* ************************************************************************ */
-static sensor_status_t sensor_family_list_sensors(
-                            sensor_family_t *       fam,
-                            slist_t **              p_last) {
-    sensor_ctx_t *sctx = fam->sctx;
-    slist_t * last;
-    if (p_last == NULL) {
-        last = NULL;
-        if (sctx->sensorlist != NULL) {
-            /* go to last and remove the sensors of given family */
-            for (slist_t * list = sctx->sensorlist; list != NULL; /*no_incr*/) {
-                sensor_desc_t * sensor = (sensor_desc_t *) (list->data);
-                if (sensor->family == fam) {
-                    slist_t * to_free = list;
-
-                    /* remove sensor properties from tree */
-                    for (sensor_property_t * property = sensor->properties;
-                           SENSOR_PROPERTY_VALID(property); ++property ) {
-                        sensor_propentry_t prop;
-                        prop.property = property;
-                        prop.desc = sensor;
-                        if (avltree_remove(sctx->properties, &prop) == NULL) {
-                            LOG_WARN(sctx->log,
-                                     "cannot remove property '%s/%s/%s' from the tree",
-                                     SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor),
-                                     SENSOR_PROP_NAME(property));
-                        }
-                    }
-                    /* remove sensor from tree */
-                    if (avltree_remove(sctx->sensors, sensor) != sensor) {
-                        LOG_WARN(sctx->log, "cannot remove sensor '%s/%s' from the tree",
-                                 SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor));
-                    }
-                    /* remove from list */
-                    list = list->next;
-                    if (last == NULL) {
-                        sctx->sensorlist = list;
-                    } else {
-                        last->next = list;
-                    }
-                    slist_free_1(to_free, sensor_desc_free_one);
-                } else {
-                    last = list;
-                    list = list->next;
-                }
+/** remove a listed desc from the sensors, properties trees and from the index */
+static void sensor_family_unlist_desc(sensor_ctx_t * sctx, sensor_desc_t * sensor) {
+    sensor_family_t * fam = sensor->family;
+
+    /* remove sensor properties from tree */
+    for (sensor_property_t * property = sensor->properties;
+           SENSOR_PROPERTY_VALID(property); ++property ) {
+        sensor_propentry_t prop;
+        prop.property = property;
+        prop.desc = sensor;
+        if (avltree_remove(sctx->properties, &prop) == NULL) {
+            LOG_WARN(sctx->log,
+                     "cannot remove property '%s/%s/%s' from the tree",
+                     SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor),
+                     SENSOR_PROP_NAME(property));
+        }
+    }
+    /* remove sensor from tree and index */
+    if (avltree_remove(sctx->sensors, sensor) != sensor) {
+        LOG_WARN(sctx->log, "cannot remove sensor '%s/%s' from the tree",
+                 SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor));
+    }
+    sensor_index_remove(sctx, sensor);
+}
+
+/* ************************************************************************ */
+/** add a desc given by the family to the sensors, properties trees and to the index */
+static void sensor_family_list_desc(sensor_family_t * fam, sensor_desc_t * sensor) {
+    sensor_ctx_t * sctx = fam->sctx;
+
+    if (sensor->family == NULL)
+        sensor->family = fam;
+    /* binding the typed value operations */
+    sensor->ops = sensor_value_ops(sensor->type);
+    /* interning its name */
+    if (sensor_name_intern(sensor) != SENSOR_SUCCESS) {
+        LOG_WARN(sctx->log, "cannot intern sensor name '%s/%s'",
+                 SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor));
+    }
+    /* adding it in the tree */
+    if (avltree_insert(sctx->sensors, sensor) != sensor) {
+        LOG_WARN(sctx->log, "cannot add sensor '%s/%s' in the tree",
+                 SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor));
+    }
+    /* adding it in the name index */
+    if (sensor_index_insert(sctx, sensor) != SENSOR_SUCCESS) {
+        LOG_WARN(sctx->log, "cannot add sensor '%s/%s' in the index",
+                 SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor));
+    }
+    /* adding its properties in the tree */
+    for (sensor_property_t * property = sensor->properties;
+            SENSOR_PROPERTY_VALID(property); ++property ) {
+        sensor_propentry_t * prop;
+        if ((prop = malloc(sizeof(*prop))) == NULL) {
+            LOG_WARN(sctx->log, "cannot malloc property tree entry !");
+            break ;
+        }
+        prop->property = property;
+        prop->desc = sensor;
+        if (avltree_insert(sctx->properties, prop) == NULL) {
+            LOG_WARN(sctx->log,
+                     "cannot add property '%s/%s/%s' to the tree",
+                     SENSOR_FAM_NAME(fam),
+                     SENSOR_DESC_LABEL(sensor), SENSOR_PROP_NAME(property));
+        }
+    }
+}
+
+/* ************************************************************************ */
+/** remove the descs of family from the sensor list, returns the last node of list */
+static slist_t * sensor_family_unlist_sensors(sensor_family_t * fam) {
+    sensor_ctx_t *  sctx = fam->sctx;
+    slist_t *       last = NULL;
+
+    /* go to last and remove the sensors of given family */
+    for (slist_t * list = sctx->sensorlist; list != NULL; /*no_incr*/) {
+        sensor_desc_t * sensor = (sensor_desc_t *) (list->data);
+        if (sensor->family == fam) {
+            slist_t * to_free = list;
+
+            sensor_family_unlist_desc(sctx, sensor);
+            /* remove from list */
+            list = list->next;
+            if (last == NULL) {
+                sctx->sensorlist = list;
+            } else {
+                last->next = list;
             }
+            slist_free_1(to_free, sensor_desc_free_one);
+        } else {
+            last = list;
+            list = list->next;
         }
-        p_last = &last;
     }
-    if (fam->info->list != NULL) {
-        slist_t * famlist = fam->info->list(fam);
-        while (famlist != NULL) {
-            sensor_desc_t * sensor = (sensor_desc_t *) famlist->data;
-            /* check each sensor before adding it to list */
-            if (sensor != NULL) {
-                /* checks done: adding it */
-                if (sensor->family == NULL)
-                    sensor->family = fam;
-                /* adding it in the tree */
-                if (avltree_insert(sctx->sensors, sensor) != sensor) {
-                    LOG_WARN(sctx->log, "cannot add sensor '%s/%s' in the tree",
-                             SENSOR_FAM_NAME(fam), SENSOR_DESC_LABEL(sensor));
-                }
-                /* adding its properties in the tree */
-                for (sensor_property_t * property = sensor->properties;
-                        SENSOR_PROPERTY_VALID(property); ++property ) {
-                    sensor_propentry_t * prop;
-                    if ((prop = malloc(sizeof(*prop))) == NULL) {
-                        LOG_WARN(sctx->log, "cannot malloc property tree entry !");
-                        break ;
-                    }
-                    prop->property = property;
-                    prop->desc = sensor;
-                    if (avltree_insert(sctx->properties, prop) == NULL) {
-                        LOG_WARN(sctx->log,
-                                 "cannot add property '%s/%s/%s' to the tree",
-                                 SENSOR_FAM_NAME(fam),
-                                 SENSOR_DESC_LABEL(sensor), SENSOR_PROP_NAME(property));
-                    }
-                }
+    return last;
+}
 
-                /* adding it in the list */
-                if (*(p_last) == NULL) {
-                    *(p_last) = sctx->sensorlist = famlist;
-                } else {
-                    (*(p_last))->next = famlist;
-                    *(p_last) = famlist;
-                }
-                famlist = famlist->next;
+/* ************************************************************************ */
+/** add the descs given by the family list() after *p_last, which is updated */
+static void sensor_family_add_sensors(
+                            sensor_family_t *       fam,
+                            slist_t *               famlist,
+                            slist_t **              p_last) {
+    sensor_ctx_t *sctx = fam->sctx;
 
+    while (famlist != NULL) {
+        sensor_desc_t * sensor = (sensor_desc_t *) famlist->data;
+        /* check each sensor before adding it to list */
+        if (sensor != NULL) {
+            /* checks done: adding it */
+            sensor_family_list_desc(fam, sensor);
+
+            /* adding it in the list */
+            if (*(p_last) == NULL) {
+                *(p_last) = sctx->sensorlist = famlist;
             } else {
-                slist_t * to_free = famlist;
-                LOG_WARN(sctx->log, "ignoring sensor '%s/%s': wrong data",
-                         SENSOR_FAM_NAME(fam),
-                         sensor == NULL ? STR_NULL : SENSOR_DESC_LABEL(sensor));
-                famlist = famlist->next;
-                slist_free_1(to_free, sensor_desc_free_one);
+                (*(p_last))->next = famlist;
+                *(p_last) = famlist;
             }
+            famlist = famlist->next;
+
+        } else {
+            slist_t * to_free = famlist;
+            LOG_WARN(sctx->log, "ignoring sensor '%s/%s': wrong data",
+                     SENSOR_FAM_NAME(fam),
+                     sensor == NULL ? STR_NULL : SENSOR_DESC_LABEL(sensor));
+            famlist = famlist->next;
+            slist_free_1(to_free, sensor_desc_free_one);
         }
-        if (*(p_last) != NULL)
-            (*(p_last))->next = NULL;
+    }
+    if (*(p_last) != NULL)
+        (*(p_last))->next = NULL;
+}
+
+/* ************************************************************************ */
+static sensor_status_t sensor_family_list_sensors(
+                            sensor_family_t *       fam,
+                            slist_t **              p_last) {
+    slist_t * last;
+    if (p_last == NULL) {
+        last = sensor_family_unlist_sensors(fam);
+        p_last = &last;
+    }
+    if (fam->info->list != NULL) {
+        sensor_family_add_sensors(fam, fam->info->list(fam), p_last);
         return SENSOR_SUCCESS;
     }
     return SENSOR_NOT_SUPPORTED;
@@ -832,8 +2093,8 @@ sensor_status_t sensor_family_register(
 
     sensor_lock(sctx, SENSOR_LOCK_WRITE);
     ret = sensor_family_register_unlocked(sctx, fam_info, &fam);
-    /* if sensor_list is already initialized, new family sensors must be addee to it */
-    if (ret == SENSOR_SUCCESS && sctx->sensorlist != NULL) {
+    /* if sensor_list is already initialized, new family sensors must be added to it */
+    if (ret == SENSOR_SUCCESS && (sctx->flags & SPF_LIST_BUILT) != 0) {
         sensor_family_list_sensors(fam, NULL);
     }
     sensor_unlock(sctx);
@@ -841,6 +2102,14 @@ sensor_status_t sensor_family_register(
     return ret;
 }
 
+const slist_t * sensor_family_list_get(sensor_ctx_t * sctx) {
+    return sctx ? sctx->families : NULL;
+}
+
+log_t * sensor_ctx_log(sensor_ctx_t * sctx) {
+    return sctx ? sctx->log : NULL;
+}
+
 sensor_family_t *   sensor_family_common(sensor_ctx_t * sctx) {
     return sctx ? sctx->common : NULL;
 }
@@ -849,6 +2118,11 @@ sensor_status_t sensor_family_signal(sensor_family_t * family) {
     int ret;
     SENSOR_LOCK_LOCK(family->sctx);
     ret = pthread_cond_signal(&family->sctx->cond);
+    if (family->sctx->wakeup_fds[1] >= 0) {
+        /* non-blocking: if the pipe is full, a wakeup is already pending */
+        while (write(family->sctx->wakeup_fds[1], "", 1) < 0 && errno == EINTR)
+            ; /* nothing but loop */
+    }
     SENSOR_LOCK_UNLOCK(family->sctx);
     return ret == 0 ? SENSOR_SUCCESS : SENSOR_ERROR;
 }
@@ -897,6 +2171,16 @@ static sensor_status_t sensor_lock_upgrade(sensor_ctx_t * sctx) {
     return res;
 }
 
+/* ************************************************************************ */
+static inline void sensor_lock_stats_wait(sensor_ctx_t * sctx, uint64_t start_ns) {
+    uint64_t            ns = sensor_stats_now_ns();
+    sensor_ctx_stats_t *stats = &(sctx->stats[sensor_stats_shard()]);
+
+    SENSOR_STATS_ADD(stats->lock_waits, 1);
+    if (start_ns != 0 && ns > start_ns)
+        SENSOR_STATS_ADD(stats->lock_wait_ns, ns - start_ns);
+}
+
 /* ************************************************************************ */
 sensor_status_t sensor_lock(sensor_ctx_t * sctx, sensor_lock_type_t lock_type) {
     sensor_status_t res;
@@ -917,7 +2201,11 @@ sensor_status_t sensor_lock(sensor_ctx_t * sctx, sensor_lock_type_t lock_type) {
     while (1) {
         SENSOR_LOCK_UNLOCK(sctx);
         if (lock_type == SENSOR_LOCK_WRITE) {
-            res = SENSOR_WRITE_LOCK(sctx);
+            if ((res = SENSOR_TRYWRITE_LOCK(sctx)) != SENSOR_SUCCESS) {
+                uint64_t start_ns = sensor_stats_now_ns();
+                res = SENSOR_WRITE_LOCK(sctx);
+                sensor_lock_stats_wait(sctx, start_ns);
+            }
             SENSOR_LOCK_LOCK(sctx);
             if (res == SENSOR_SUCCESS && sctx->write_lock_counter == 0) {
                 sctx->write_lock_owner = self;
@@ -926,7 +2214,11 @@ sensor_status_t sensor_lock(sensor_ctx_t * sctx, sensor_lock_type_t lock_type) {
                 return SENSOR_SUCCESS;
             }
         } else {
-            res = SENSOR_READ_LOCK(sctx);
+            if ((res = SENSOR_TRYREAD_LOCK(sctx)) != SENSOR_SUCCESS) {
+                uint64_t start_ns = sensor_stats_now_ns();
+                res = SENSOR_READ_LOCK(sctx);
+                sensor_lock_stats_wait(sctx, start_ns);
+            }
             SENSOR_LOCK_LOCK(sctx);
             if (res == SENSOR_SUCCESS && sctx->write_lock_counter == 0) {
                 SENSOR_LOCK_UNLOCK(sctx);
@@ -964,12 +2256,13 @@ sensor_status_t sensor_unlock(sensor_ctx_t * sctx) {
 static sensor_status_t sensor_list_build(sensor_ctx_t *sctx) {
     slist_t * list = NULL;
 
-    if (sctx->sensorlist != NULL) {
+    if (sctx->sensorlist != NULL || (sctx->flags & SPF_LIST_BUILT) != 0) {
         return SENSOR_UNCHANGED;
     }
     SLIST_FOREACH_DATA(sctx->families, fam, sensor_family_t *) {
         sensor_family_list_sensors(fam, &list);
     }
+    sctx->flags |= SPF_LIST_BUILT;
     return SENSOR_SUCCESS;
 }
 
@@ -980,6 +2273,11 @@ const slist_t * sensor_list_get(sensor_ctx_t *sctx) {
     if (sctx == NULL) {
         return NULL;
     }
+    if (__atomic_load_n(&(sctx->lazy_families), __ATOMIC_ACQUIRE) != 0) {
+        sensor_lock(sctx, SENSOR_LOCK_WRITE);
+        sensor_families_load_unlocked(sctx, UINT32_MAX, 1);
+        sensor_unlock(sctx);
+    }
     result = sctx->sensorlist;
 
     return result;
@@ -993,10 +2291,12 @@ void sensor_list_free(sensor_ctx_t *sctx) {
     sensor_lock(sctx, SENSOR_LOCK_WRITE);
     sensor_watch_free(sctx);
     avltree_clear(sctx->sensors);
+    sensor_index_clear(sctx, 1);
     if (sctx->sensorlist != NULL) {
         slist_free(sctx->sensorlist, sensor_desc_free_one);
         sctx->sensorlist = NULL;
     }
+    sctx->flags &= ~SPF_LIST_BUILT;
     sensor_unlock(sctx);
 }
 
@@ -1014,12 +2314,36 @@ typedef struct {
     char *              slash;
     int                 (*cmp)(const char *, const char *);
     int                 (*ncmp)(const char *, const char *, size_t);
+    /* fast matcher when family is literal: fnmatch() on the label part only */
+    const char *        label_pattern;
+    size_t              fam_len;
+    size_t              label_prefix_len;
+    int                 label_any;
+    /* sensor_name_hash() of exact pattern, casefolded with SSF_CASEFOLD */
+    unsigned int        name_hash;
 } sensor_desc_match_t;
 
-/** for sensor_find(), init with sensor_desc_range_get() */
-typedef struct {
+/** compiled pattern, init with sensor_desc_range_get() */
+struct sensor_pattern_s {
+    /* pattern copy, owned by sensor_pattern_compile() handles */
+    char *              pattern_copy;
     /* for range computing and sensor_desc_match_unlocked() */
     sensor_desc_match_t matchdata;
+    /* min/max sensor_desc_t */
+    char fam_name_min[SENSOR_LABEL_SIZE], fam_name_max[SENSOR_LABEL_SIZE];
+    char lab_name_min[SENSOR_LABEL_SIZE], lab_name_max[SENSOR_LABEL_SIZE];
+    sensor_family_info_t faminfo_min;
+    sensor_family_info_t faminfo_max;
+    sensor_family_t fam_min;
+    sensor_family_t fam_max;
+    sensor_desc_t   desc_min;
+    sensor_desc_t   desc_max;
+};
+
+/** for sensor_find() */
+typedef struct {
+    /* compiled pattern */
+    const sensor_pattern_t * cpattern;
     /* list of results */
     slist_t **          plist;
     /* first matching element */
@@ -1034,15 +2358,6 @@ typedef struct {
     } visit;
     /* user_data for visit() function */
     void *              user_data;
-    /* min/max sensor_desc_t */
-    char fam_name_min[SENSOR_LABEL_SIZE], fam_name_max[SENSOR_LABEL_SIZE];
-    char lab_name_min[SENSOR_LABEL_SIZE], lab_name_max[SENSOR_LABEL_SIZE];
-    sensor_family_info_t faminfo_min;
-    sensor_family_info_t faminfo_max;
-    sensor_family_t fam_min;
-    sensor_family_t fam_max;
-    sensor_desc_t   desc_min;
-    sensor_desc_t   desc_max;
 } sensor_find_range_t;
 
 /* *********************************************************************** */
@@ -1070,6 +2385,26 @@ static sensor_status_t sensor_desc_match_get(
         matchdata->ncmp = strncmp;
         matchdata->fnm_flags = 0;
     }
+    /* family names have no '/': with a literal family, only the label is a pattern */
+    if (matchdata->pattern_idx >= 0 && matchdata->slash != NULL
+    &&  matchdata->slash < pattern + matchdata->pattern_idx) {
+        matchdata->fam_len = matchdata->slash - pattern;
+        matchdata->label_pattern = matchdata->slash + 1;
+        matchdata->label_prefix_len = matchdata->pattern_idx - (matchdata->fam_len + 1);
+        matchdata->label_any = (strcmp(matchdata->label_pattern, "*") == 0);
+    } else {
+        matchdata->fam_len = matchdata->slash != NULL ? (size_t) (matchdata->slash - pattern) : 0;
+        matchdata->label_pattern = NULL;
+        matchdata->label_prefix_len = 0;
+        matchdata->label_any = 0;
+    }
+    if (matchdata->pattern_idx < 0) {
+        matchdata->name_hash = sensor_name_hash(pattern, matchdata->fam_len,
+                                                 matchdata->slash + 1,
+                                                 (flags & SSF_CASEFOLD) != 0);
+    } else {
+        matchdata->name_hash = 0;
+    }
     return SENSOR_SUCCESS;
 }
 
@@ -1077,7 +2412,7 @@ static sensor_status_t sensor_desc_match_get(
  * try to minimize the search range by keeping the beginning of pattern */
 static sensor_status_t sensor_desc_range_get(
                             sensor_ctx_t *          sctx,
-                            sensor_find_range_t *   data,
+                            sensor_pattern_t *      data,
                             const char *            pattern,
                             unsigned int            flags) {
     #ifndef _DEBUG
@@ -1163,11 +2498,22 @@ static sensor_status_t sensor_desc_range_get(
 }
 
 /* ************************************************************************ */
-static int sensor_desc_match_unlocked(const sensor_desc_t *  sensor,
-                                      sensor_desc_match_t *  data) {
+static int sensor_desc_match_unlocked(const sensor_desc_t *         sensor,
+                                      const sensor_desc_match_t *   data) {
     int matched = 0;
 
-    if (data->pattern_idx >= 0) {
+    if (data->label_pattern != NULL) {
+        const char * const  fam_name    = SENSOR_DESC_FAMNAME(sensor);
+        const char * const  label       = SENSOR_DESC_LABEL(sensor);
+        matched =
+            (data->ncmp(fam_name, data->pattern, data->fam_len) == 0
+             && fam_name[data->fam_len] == 0
+             && (data->label_any
+                 || (data->ncmp(label, data->label_pattern, data->label_prefix_len) == 0
+                     && fnmatch(data->label_pattern, label, data->fnm_flags) == 0)));
+    } else if (data->pattern_idx >= 0 && sensor->fullname != NULL) {
+        matched = (fnmatch(data->pattern, sensor->fullname->name, data->fnm_flags) == 0);
+    } else if (data->pattern_idx >= 0) {
         char    label[SENSOR_LABEL_SIZE];
 
         snprintf(label, PTR_COUNT(label), "%s/%s",
@@ -1192,6 +2538,76 @@ static int sensor_desc_match_unlocked(const sensor_desc_t *  sensor,
     return matched;
 }
 
+/* ************************************************************************ */
+/** next index entry matching the exact pattern of match (pattern_idx < 0),
+ * starting at the head of its chain when entry is NULL */
+static sensor_index_entry_t * sensor_index_next(
+                                const sensor_index_t *      index,
+                                const sensor_desc_match_t * match,
+                                sensor_index_entry_t *      entry) {
+    const int casefold = (match->flags & SSF_CASEFOLD) != 0;
+
+    if (entry != NULL) {
+        entry = casefold ? entry->next_ci : entry->next;
+    } else if (index->size != 0) {
+        entry = index->buckets[(casefold ? index->size : 0)
+                               + (match->name_hash & (index->size - 1))];
+    }
+    for ( ; entry != NULL; entry = casefold ? entry->next_ci : entry->next) {
+        if ((casefold ? entry->hash_ci : entry->hash) == match->name_hash
+        &&  sensor_desc_match_unlocked(entry->desc, match)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* ************************************************************************ */
+/** record a matching sample for sensor_watch_find(), returns AVS_* */
+static int sensor_watch_find_found(sensor_sample_t * sample, sensor_find_range_t * data) {
+    if (data->first.sample == NULL) {
+        data->first.sample = sample;
+        if (data->visit.sample == NULL && data->plist == NULL)
+            return AVS_FINISHED;
+    }
+    if (data->plist != NULL) {
+        *(data->plist) = slist_prepend(*(data->plist), sample);
+    }
+    if (data->visit.sample != NULL) {
+        int ret = data->visit.sample(sample, data->user_data);
+        if (ret == SENSOR_ERROR) {
+            return AVS_ERROR;
+        }
+        if (ret == SENSOR_RELOAD_FAMILY) {
+            return AVS_FINISHED;
+        }
+    }
+    return AVS_CONTINUE;
+}
+
+/* ************************************************************************ */
+/** record a matching desc for sensor_find(), returns AVS_* */
+static int sensor_desc_find_found(sensor_desc_t * desc, sensor_find_range_t * data) {
+    if (data->first.desc == NULL) {
+        data->first.desc = desc;
+        if (data->visit.desc == NULL && data->plist == NULL)
+            return AVS_FINISHED;
+    }
+    if (data->plist != NULL) {
+        *(data->plist) = slist_prepend(*(data->plist), desc);
+    }
+    if (data->visit.desc != NULL) {
+        int ret = data->visit.desc(desc, data->user_data);
+        if (ret == SENSOR_ERROR) {
+            return AVS_ERROR;
+        }
+        if (ret == SENSOR_RELOAD_FAMILY) {
+            return AVS_FINISHED;
+        }
+    }
+    return AVS_CONTINUE;
+}
+
 /* ************************************************************************ */
 AVLTREE_DECLARE_VISITFUN(sensor_watch_visit_find, node_data, context, vdata) {
     sensor_sample_t *       sample  = (sensor_sample_t *) node_data;
@@ -1201,24 +2617,8 @@ AVLTREE_DECLARE_VISITFUN(sensor_watch_visit_find, node_data, context, vdata) {
     LOG_DEBUG(sample->desc->family->sctx->log, "sensor_watch_find(): check '%s/%s'",
               SENSOR_DESC_FAMNAME(sample->desc), SENSOR_DESC_LABEL(sample->desc));
 
-    if (sensor_desc_match_unlocked(sample->desc, &(data->matchdata))) {
-        if (data->first.sample == NULL) {
-            data->first.sample = sample;
-            if (data->visit.sample == NULL && data->plist == NULL)
-                return AVS_FINISHED;
-        }
-        if (data->plist != NULL) {
-            *(data->plist) = slist_prepend(*(data->plist), sample);
-        }
-        if (data->visit.sample != NULL) {
-            int ret = data->visit.sample(sample, data->user_data);
-            if (ret == SENSOR_ERROR) {
-                return AVS_ERROR;
-            }
-            if (ret == SENSOR_RELOAD_FAMILY) {
-                return AVS_FINISHED;
-            }
-        }
+    if (sensor_desc_match_unlocked(sample->desc, &(data->cpattern->matchdata))) {
+        return sensor_watch_find_found(sample, data);
     }
 
     return AVS_CONTINUE;
@@ -1233,27 +2633,60 @@ AVLTREE_DECLARE_VISITFUN(sensor_desc_visit_find, node_data, context, vdata) {
     LOG_DEBUG(desc->family->sctx->log, "sensor_desc_find(): check '%s/%s'",
               SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc));
 
-    if (sensor_desc_match_unlocked(desc, &(data->matchdata))) {
-        if (data->first.desc == NULL) {
-            data->first.desc = desc;
-            if (data->visit.desc == NULL && data->plist == NULL)
-                return AVS_FINISHED;
-        }
-        if (data->plist != NULL) {
-            *(data->plist) = slist_prepend(*(data->plist), desc);
-        }
-        if (data->visit.desc != NULL) {
-            int ret = data->visit.desc(desc, data->user_data);
-            if (ret == SENSOR_ERROR) {
-                return AVS_ERROR;
+    if (sensor_desc_match_unlocked(desc, &(data->cpattern->matchdata))) {
+        return sensor_desc_find_found(desc, data);
+    }
+
+    return AVS_CONTINUE;
+}
+
+/* ************************************************************************ */
+static sensor_sample_t * sensor_watch_find_compiled_unlocked(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        slist_t **              matchs,
+                        sensor_watch_visitfun_t visit,
+                        void *                  user_data) {
+    sensor_find_range_t data = {
+        .cpattern = cpattern, .plist = matchs, .first.sample = NULL,
+        .visit.sample = visit, .user_data = user_data,
+    };
+    sensor_sample_t min = { .desc = &(cpattern->desc_min), .watch = NULL/*IMPORTANT*/ };
+    sensor_sample_t max = { .desc = &(cpattern->desc_max), .watch = NULL/*IMPORTANT*/ };
+
+    /* exact name: use the index, loading watchs are not indexed -> range on miss */
+    if (cpattern->matchdata.pattern_idx < 0) {
+        int ret = AVS_CONTINUE;
+        for (sensor_index_entry_t * entry = NULL;
+                ret == AVS_CONTINUE
+                && (entry = sensor_index_next(&(sctx->index), &(cpattern->matchdata), entry))
+                   != NULL; ) {
+            if (entry->sample != NULL) {
+                ret = sensor_watch_find_found(entry->sample, &data);
             }
-            if (ret == SENSOR_RELOAD_FAMILY) {
-                return AVS_FINISHED;
+        }
+        if (ret == AVS_ERROR) {
+            if (matchs != NULL) {
+                slist_free(*matchs, NULL);
+                *matchs = NULL;
             }
+            return NULL;
+        }
+        if (data.first.sample != NULL) {
+            return data.first.sample;
         }
     }
 
-    return AVS_CONTINUE;
+    if (avltree_visit_range(sctx->watchs, &min, &max,
+                            sensor_watch_visit_find, &data, AVH_INFIX) != AVS_FINISHED) {
+        if (matchs != NULL) {
+            slist_free(*matchs, NULL);
+            *matchs = NULL;
+        }
+        return NULL;
+    }
+
+    return data.first.sample;
 }
 
 /* ************************************************************************ */
@@ -1264,26 +2697,58 @@ static sensor_sample_t * sensor_watch_find_unlocked(
                         slist_t **              matchs,
                         sensor_watch_visitfun_t visit,
                         void *                  user_data) {
-    sensor_find_range_t data = {
-        .plist = matchs, .first.sample = NULL,
-        .visit.sample = visit, .user_data = user_data,
-    };
-    sensor_sample_t min = { .desc = &(data.desc_min), .watch = NULL/*IMPORTANT*/ };
-    sensor_sample_t max = { .desc = &(data.desc_max), .watch = NULL/*IMPORTANT*/ };
+    sensor_pattern_t    cpattern;
 
     LOG_DEBUG(sctx->log, "FINDING WATCHS, pattern:'%s' (flags:%u)",
               pattern, flags);
 
     /* compute min and max range values from pattern */
-    if (sensor_desc_range_get(sctx, &data, pattern, flags) != SENSOR_SUCCESS) {
+    if (sensor_desc_range_get(sctx, &cpattern, pattern, flags) != SENSOR_SUCCESS) {
         if (matchs != NULL) {
             *matchs = NULL;
         }
         return NULL;
     }
 
-    if (avltree_visit_range(sctx->watchs, &min, &max,
-                            sensor_watch_visit_find, &data, AVH_INFIX) != AVS_FINISHED) {
+    return sensor_watch_find_compiled_unlocked(sctx, &cpattern, matchs, visit, user_data);
+}
+
+/* ************************************************************************ */
+static sensor_desc_t * sensor_find_compiled_unlocked(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        slist_t **              matchs,
+                        sensor_visitfun_t       visit,
+                        void *                  user_data) {
+    sensor_find_range_t data = {
+        .cpattern = cpattern, .plist = matchs, .first.desc = NULL,
+        .visit.desc = visit, .user_data = user_data,
+    };
+
+    /* exact name: use the index, loading descs are not indexed -> range on miss */
+    if (cpattern->matchdata.pattern_idx < 0) {
+        int ret = AVS_CONTINUE;
+        for (sensor_index_entry_t * entry = NULL;
+                ret == AVS_CONTINUE
+                && (entry = sensor_index_next(&(sctx->index), &(cpattern->matchdata), entry))
+                   != NULL; ) {
+            ret = sensor_desc_find_found((sensor_desc_t *) entry->desc, &data);
+        }
+        if (ret == AVS_ERROR) {
+            if (matchs != NULL) {
+                slist_free(*matchs, NULL);
+                *matchs = NULL;
+            }
+            return NULL;
+        }
+        if (data.first.desc != NULL) {
+            return data.first.desc;
+        }
+    }
+
+    if (avltree_visit_range(sctx->sensors, (void *) &(cpattern->desc_min),
+                            (void *) &(cpattern->desc_max),
+                            sensor_desc_visit_find, &data, AVH_INFIX) != AVS_FINISHED) {
         if (matchs != NULL) {
             slist_free(*matchs, NULL);
             *matchs = NULL;
@@ -1291,7 +2756,7 @@ static sensor_sample_t * sensor_watch_find_unlocked(
         return NULL;
     }
 
-    return data.first.sample;
+    return data.first.desc;
 }
 
 /* ************************************************************************ */
@@ -1302,32 +2767,20 @@ static sensor_desc_t * sensor_find_unlocked(
                         slist_t **              matchs,
                         sensor_visitfun_t       visit,
                         void *                  user_data) {
-    sensor_find_range_t data = {
-        .plist = matchs, .first.desc = NULL,
-        .visit.desc = visit, .user_data = user_data,
-    };
+    sensor_pattern_t    cpattern;
 
     LOG_DEBUG(sctx->log, "FINDING DESCS, pattern:'%s' (flags:%u)",
                 pattern, flags);
 
     /* compute min and max range values from pattern */
-    if (sensor_desc_range_get(sctx, &data, pattern, flags) != SENSOR_SUCCESS) {
-        if (matchs != NULL) {
-            *matchs = NULL;
-        }
-        return NULL;
-    }
-
-    if (avltree_visit_range(sctx->sensors, &(data.desc_min), &(data.desc_max),
-                            sensor_desc_visit_find, &data, AVH_INFIX) != AVS_FINISHED) {
+    if (sensor_desc_range_get(sctx, &cpattern, pattern, flags) != SENSOR_SUCCESS) {
         if (matchs != NULL) {
-            slist_free(*matchs, NULL);
             *matchs = NULL;
         }
         return NULL;
     }
 
-    return data.first.desc;
+    return sensor_find_compiled_unlocked(sctx, &cpattern, matchs, visit, user_data);
 }
 
 /* ************************************************************************ */
@@ -1366,6 +2819,7 @@ sensor_desc_t * sensor_find(
     if (sctx == NULL || pattern == NULL) {
         return NULL;
     }
+    sensor_families_load_pattern(sctx, pattern, flags);
     sensor_lock(sctx, (flags & SSF_LOCK_WRITE) != 0
                       ? SENSOR_LOCK_WRITE : SENSOR_LOCK_READ);
 
@@ -1389,6 +2843,7 @@ sensor_status_t sensor_visit(
         return SENSOR_ERROR;
     }
 
+    sensor_families_load_pattern(sctx, pattern, flags);
     sensor_lock(sctx, (flags & SSF_LOCK_WRITE) != 0
                       ? SENSOR_LOCK_WRITE : SENSOR_LOCK_READ);
 
@@ -1443,70 +2898,194 @@ sensor_status_t sensor_watch_visit(
     return result != NULL ? SENSOR_SUCCESS : SENSOR_ERROR;
 }
 
+/* ************************************************************************ */
+sensor_pattern_t *  sensor_pattern_compile(
+                        sensor_ctx_t *          sctx,
+                        const char *            pattern,
+                        unsigned int            flags) {
+    sensor_pattern_t *  cpattern;
 
-/* ************************************************************************
- * SENSOR WATCH ADD / DELETE / LIST FUNCTIONS
- * ************************************************************************ */
+    if (sctx == NULL || pattern == NULL) {
+        return NULL;
+    }
+    sensor_families_load_pattern(sctx, pattern, flags);
+    if ((cpattern = malloc(sizeof(*cpattern))) == NULL) {
+        LOG_WARN(sctx->log, "%s(): cannot malloc compiled pattern: %s",
+                 __func__, strerror(errno));
+        return NULL;
+    }
+    if ((cpattern->pattern_copy = strdup(pattern)) == NULL
+    ||  sensor_desc_range_get(sctx, cpattern, cpattern->pattern_copy, flags) != SENSOR_SUCCESS) {
+        LOG_VERBOSE(sctx->log, "%s(): cannot compile pattern '%s'", __func__, pattern);
+        sensor_pattern_free(cpattern);
+        return NULL;
+    }
+    return cpattern;
+}
 
 /* ************************************************************************ */
-static sensor_status_t sensor_watch_del_unlocked(
-                    sensor_ctx_t *          sctx,
-                    const char *            pattern,
-                    unsigned int            flags) {
-    sensor_status_t     result = SENSOR_ERROR;
-    sensor_desc_match_t data;
+void                sensor_pattern_free(sensor_pattern_t * cpattern) {
+    if (cpattern != NULL) {
+        if (cpattern->pattern_copy != NULL) {
+            free(cpattern->pattern_copy);
+        }
+        free(cpattern);
+    }
+}
 
-    LOG_VERBOSE(sctx->log, "REMOVING WATCHS, pattern:'%s' (flags:%u)", pattern, flags);
+/* ************************************************************************ */
+sensor_desc_t *     sensor_find_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        slist_t **              matchs) {
+    sensor_desc_t * result;
 
-    if (sensor_desc_match_get(&data, pattern, flags) != SENSOR_SUCCESS) {
-        return SENSOR_ERROR;
+    if (sctx == NULL || cpattern == NULL) {
+        return NULL;
     }
+    sensor_lock(sctx, (cpattern->matchdata.flags & SSF_LOCK_WRITE) != 0
+                      ? SENSOR_LOCK_WRITE : SENSOR_LOCK_READ);
 
-    for (slist_t * list = sctx->watchlist, *prev = NULL; list != NULL; /* no_incr */) {
-        sensor_sample_t *           watch = (sensor_sample_t *) list->data;
-        sensor_watchparam_entry_t * watchparam;
+    result = sensor_find_compiled_unlocked(sctx, cpattern, matchs, NULL, NULL);
 
-        if (sensor_desc_match_unlocked(watch->desc, &data)) {
-            slist_t *                   to_free = list;
-            sensor_watchparam_entry_t   testwatchparam = { .watch = *(watch->watch) };
-            const sensor_desc_t *       desc = watch->desc;
+    sensor_unlock(sctx);
 
-            /* watch to delete found, check if its watch param is still used */
-            watchparam = avltree_find(sctx->watch_params, &testwatchparam);
+    return result;
+}
 
-            LOG_DEBUG(sctx->log, "-> REMOVING Watch '%s/%s', param_usecount:%d",
-                      SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc),
-                      watchparam == NULL ? -1 : watchparam->use_count);
+/* ************************************************************************ */
+sensor_status_t     sensor_visit_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        sensor_visitfun_t       visit,
+                        void *                  user_data) {
+    sensor_desc_t * result;
 
-            /* notify family that watch will be deleted, while its data are still valid */
-            if (desc->family->info->notify != NULL) {
-                desc->family->info->notify(SWE_WATCH_DELETING,
-                                           desc->family, watch, NULL);
-            }
+    if (sctx == NULL || cpattern == NULL || visit == NULL) {
+        return SENSOR_ERROR;
+    }
+    sensor_lock(sctx, (cpattern->matchdata.flags & SSF_LOCK_WRITE) != 0
+                      ? SENSOR_LOCK_WRITE : SENSOR_LOCK_READ);
 
-            if (watchparam != NULL && --(watchparam->use_count) == 0) {
-                /* watch param no longer used, delete it */
-                LOG_DEBUG(sctx->log, "-> %s/%s: REMOVING unused WATCH ENTRY (t=%lu.%03lu)",
-                    SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc),
-                    (unsigned long)(watchparam->watch.update_interval.tv_sec),
-                    (unsigned long)(watchparam->watch.update_interval.tv_usec / 1000));
+    result = sensor_find_compiled_unlocked(sctx, cpattern, NULL, visit, user_data);
 
-                avltree_remove(sctx->watch_params, watchparam);
-            }
+    sensor_unlock(sctx);
 
-            /* remove watch from tree */
-            if (avltree_remove(sctx->watchs, watch) != watch) {
-                LOG_WARN(sctx->log, "-> cannot remove '%s/%s' from tree",
-                         SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc));
-            }
-            /* remove watch from list and go to next */
-            if (to_free == sctx->watchlist)
-                sctx->watchlist = to_free->next;
-            list = list->next;
-            slist_free_1(to_free, sensor_watch_free_one);
-            if (prev != NULL) {
-                prev->next = list;
-            }
+    return result != NULL ? SENSOR_SUCCESS : SENSOR_ERROR;
+}
+
+/* ************************************************************************ */
+sensor_sample_t *   sensor_watch_find_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        slist_t **              matchs) {
+    sensor_sample_t * result;
+
+    if (sctx == NULL || cpattern == NULL) {
+        return NULL;
+    }
+    sensor_lock(sctx, (cpattern->matchdata.flags & SSF_LOCK_WRITE) != 0
+                      ? SENSOR_LOCK_WRITE : SENSOR_LOCK_READ);
+
+    result = sensor_watch_find_compiled_unlocked(sctx, cpattern, matchs, NULL, NULL);
+
+    sensor_unlock(sctx);
+
+    return result;
+}
+
+/* ************************************************************************ */
+sensor_status_t     sensor_watch_visit_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        sensor_watch_visitfun_t visit,
+                        void *                  user_data) {
+    sensor_sample_t * result;
+
+    if (sctx == NULL || cpattern == NULL || visit == NULL) {
+        return SENSOR_ERROR;
+    }
+    sensor_lock(sctx, (cpattern->matchdata.flags & SSF_LOCK_WRITE) != 0
+                      ? SENSOR_LOCK_WRITE : SENSOR_LOCK_READ);
+
+    result = sensor_watch_find_compiled_unlocked(sctx, cpattern, NULL, visit, user_data);
+
+    sensor_unlock(sctx);
+
+    return result != NULL ? SENSOR_SUCCESS : SENSOR_ERROR;
+}
+
+
+/* ************************************************************************
+ * SENSOR WATCH ADD / DELETE / LIST FUNCTIONS
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+/** remove the watch of a watchlist node, prev being the node before it or NULL,
+ * and return the next node. */
+static slist_t * sensor_watch_del_node_unlocked(
+                    sensor_ctx_t *          sctx,
+                    slist_t *               list,
+                    slist_t *               prev) {
+    sensor_sample_t *           watch = (sensor_sample_t *) list->data;
+    sensor_watchparam_entry_t * watchparam;
+    slist_t *                   to_free = list;
+    sensor_watchparam_entry_t   testwatchparam = { .watch = *(watch->watch) };
+    const sensor_desc_t *       desc = watch->desc;
+
+    /* watch to delete found, check if its watch param is still used */
+    watchparam = avltree_find(sctx->watch_params, &testwatchparam);
+
+    LOG_DEBUG(sctx->log, "-> REMOVING Watch '%s/%s', param_usecount:%d",
+              SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc),
+              watchparam == NULL ? -1 : watchparam->use_count);
+
+    /* notify family that watch will be deleted, while its data are still valid */
+    if (desc->family->info->notify != NULL) {
+        desc->family->info->notify(SWE_WATCH_DELETING,
+                                   desc->family, watch, NULL);
+    }
+
+    if (watchparam != NULL && --(watchparam->use_count) == 0) {
+        /* watch param no longer used, delete it */
+        LOG_DEBUG(sctx->log, "-> %s/%s: REMOVING unused WATCH ENTRY (t=%lu.%03lu)",
+            SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc),
+            (unsigned long)(watchparam->watch.update_interval.tv_sec),
+            (unsigned long)(watchparam->watch.update_interval.tv_usec / 1000));
+
+        avltree_remove(sctx->watch_params, watchparam);
+    }
+
+    /* remove watch from tree */
+    if (avltree_remove(sctx->watchs, watch) != watch) {
+        LOG_WARN(sctx->log, "-> cannot remove '%s/%s' from tree",
+                 SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc));
+    }
+    /* remove watch from scheduler and index */
+    sensor_sched_remove(sctx, watch);
+    sensor_index_set_sample(sctx, desc, NULL);
+    /* remove watch from list and go to next */
+    if (to_free == sctx->watchlist)
+        sctx->watchlist = to_free->next;
+    list = list->next;
+    slist_free_1(to_free, sensor_watch_free_one);
+    if (prev != NULL) {
+        prev->next = list;
+    }
+    return list;
+}
+
+/* ************************************************************************ */
+static sensor_status_t sensor_watch_del_match_unlocked(
+                    sensor_ctx_t *              sctx,
+                    const sensor_desc_match_t * data) {
+    sensor_status_t     result = SENSOR_ERROR;
+
+    for (slist_t * list = sctx->watchlist, *prev = NULL; list != NULL; /* no_incr */) {
+        sensor_sample_t *           watch = (sensor_sample_t *) list->data;
+
+        if (sensor_desc_match_unlocked(watch->desc, data)) {
+            list = sensor_watch_del_node_unlocked(sctx, list, prev);
             result = SENSOR_SUCCESS;
         } else {
             prev = list;
@@ -1516,6 +3095,21 @@ static sensor_status_t sensor_watch_del_unlocked(
     return result;
 }
 
+/* ************************************************************************ */
+static sensor_status_t sensor_watch_del_unlocked(
+                    sensor_ctx_t *          sctx,
+                    const char *            pattern,
+                    unsigned int            flags) {
+    sensor_desc_match_t data;
+
+    LOG_VERBOSE(sctx->log, "REMOVING WATCHS, pattern:'%s' (flags:%u)", pattern, flags);
+
+    if (sensor_desc_match_get(&data, pattern, flags) != SENSOR_SUCCESS) {
+        return SENSOR_ERROR;
+    }
+    return sensor_watch_del_match_unlocked(sctx, &data);
+}
+
 /* ************************************************************************ */
 static sensor_sample_t * sensor_watch_add_desc_unlocked(
                         sensor_ctx_t *          sctx,
@@ -1584,11 +3178,13 @@ static sensor_sample_t * sensor_watch_add_desc_unlocked(
         }
         /* reset next_update_time in order to take into account possible new timer */
         memset(&(sample->next_update_time), 0, sizeof(sample->next_update_time));
+        memset(&(sample->interval), 0, sizeof(sample->interval));
+        sample->deadband_ref = NAN;
         /* set event value */
         event |= SWE_WATCH_REPLACED;
     } else {
         /* alloc a new sample if not already watched */
-        if ((sample = calloc(1, sizeof(sensor_sample_t))) == NULL) {
+        if ((sample = sensor_sample_alloc(sensor->family)) == NULL) {
             LOG_WARN(sctx->log, "error: cannot allocate sensor sample in %s", __func__);
             return NULL;
         }
@@ -1601,6 +3197,7 @@ static sensor_sample_t * sensor_watch_add_desc_unlocked(
     if ((event & SWE_WATCH_ADDED) != 0) {
         /* sensor added, not replaced */
         memset(&(sample->value), 0xff, sizeof(sample->value));
+        sample->deadband_ref = NAN;
         sample->value.type = sample->desc->type;
         if (SENSOR_VALUE_IS_BUFFER(sample->value.type)) {
             SENSOR_VALUE_INIT_BUF(sample->value, sample->value.type, NULL, 0);
@@ -1612,6 +3209,7 @@ static sensor_sample_t * sensor_watch_add_desc_unlocked(
             LOG_WARN(sctx->log, "cannot insert '%s/%s' in tree",
                      SENSOR_DESC_FAMNAME(sensor), SENSOR_DESC_LABEL(sensor));
         }
+        sensor_index_set_sample(sctx, sensor, sample);
     } else if (sample->desc->properties != s_sensor_loading_properties) {
         if (SENSOR_VALUE_IS_BUFFER(sample->value.type)) {
             sample->value.data.b.size = 0;
@@ -1624,6 +3222,9 @@ static sensor_sample_t * sensor_watch_add_desc_unlocked(
         }
     }
 
+    /* schedule the sample, or take into account its reset next_update_time */
+    sensor_sched_push(sctx, sample);
+
     LOG_DEBUG(sctx->log, "WATCH %s: '%s/%s' (T:%lu.%03lu, param_usecount:%d)",
               (event & SWE_WATCH_ADDED) != 0 ? "ADDED" : "REPLACED",
               SENSOR_DESC_FAMNAME(sensor), SENSOR_DESC_LABEL(sensor),
@@ -1640,29 +3241,25 @@ static sensor_sample_t * sensor_watch_add_desc_unlocked(
 }
 
 /* ************************************************************************ */
-static sensor_status_t sensor_watch_add_unlocked(
-                        sensor_ctx_t *      sctx,
-                        const char *        pattern,
-                        unsigned int        flags,
-                        sensor_watch_t *    watch) {
+static sensor_status_t sensor_watch_add_match_unlocked(
+                        sensor_ctx_t *              sctx,
+                        const sensor_desc_match_t * matchdata,
+                        sensor_watch_t *            watch) {
     sensor_status_t         result      = SENSOR_ERROR;
-    sensor_desc_match_t     matchdata;
+    const char *            pattern     = matchdata->pattern;
+    unsigned int            flags       = matchdata->flags;
     int                     has_loading = 0;
 
     LOG_VERBOSE(sctx->log, "ADDING new watches, pattern:'%s' (T:%lu.%03lu, flags:%u)",
                 pattern, (unsigned long) watch->update_interval.tv_sec,
                          (unsigned long) (watch->update_interval.tv_usec / 1000UL), flags);
 
-    if (sensor_desc_match_get(&matchdata, pattern, flags) != SENSOR_SUCCESS) {
-        return SENSOR_ERROR;
-    }
-
     SLIST_FOREACH_DATA(sctx->sensorlist, sensor, sensor_desc_t *) {
         if (sensor->label == s_sensor_loading_label) {
             has_loading = 1;
             continue ;
         }
-        if (sensor_desc_match_unlocked(sensor, &matchdata)
+        if (sensor_desc_match_unlocked(sensor, matchdata)
         &&  sensor_watch_add_desc_unlocked(sctx, sensor, flags, watch) != NULL) {
             result = SENSOR_SUCCESS;
         }
@@ -1670,7 +3267,7 @@ static sensor_status_t sensor_watch_add_unlocked(
     if ( ! has_loading ) {
         return result;
     } else {
-        sensor_find_range_t     range;
+        sensor_pattern_t        range;
 
         LOG_DEBUG(sctx->log, "LOOKING for a match for '%s' in loading sensors", pattern);
 
@@ -1725,6 +3322,7 @@ static sensor_status_t sensor_watch_add_unlocked(
                 newdesc->properties = s_sensor_loading_properties;
                 newdesc->label = strdup(range.matchdata.slash != NULL
                                         ? range.matchdata.slash + 1 : pattern);
+                sensor_name_intern(newdesc);
                 if ((newdesc->key = malloc(sizeof(sensor_loadinginfo_t))) != NULL) {
                     sensor_loadinginfo_t * info = (sensor_loadinginfo_t *) newdesc->key;
                     info->pattern = strdup(pattern);
@@ -1756,6 +3354,24 @@ static sensor_status_t sensor_watch_add_unlocked(
     return result;
 }
 
+/* ************************************************************************ */
+static sensor_status_t sensor_watch_add_unlocked(
+                        sensor_ctx_t *      sctx,
+                        const char *        pattern,
+                        unsigned int        flags,
+                        sensor_watch_t *    watch) {
+    sensor_desc_match_t     matchdata;
+
+    /* under write lock: the lazy families are loaded without unlocking */
+    sensor_families_load_pattern(sctx, pattern, flags);
+    if (sensor_desc_match_get(&matchdata, pattern, flags) != SENSOR_SUCCESS) {
+        LOG_VERBOSE(sctx->log, "ADDING new watches, bad pattern:'%s' (flags:%u)",
+                    pattern, flags);
+        return SENSOR_ERROR;
+    }
+    return sensor_watch_add_match_unlocked(sctx, &matchdata, watch);
+}
+
 /* ************************************************************************ */
 sensor_status_t sensor_watch_add(
                         sensor_ctx_t *      sctx,
@@ -1779,6 +3395,28 @@ sensor_status_t sensor_watch_add(
     return result;
 }
 
+/* ************************************************************************ */
+sensor_status_t sensor_watch_add_compiled(
+                        sensor_ctx_t *          sctx,
+                        const sensor_pattern_t *cpattern,
+                        sensor_watch_t *        watch) {
+    sensor_status_t result;
+
+    if (sctx == NULL)
+       return SENSOR_ERROR;
+
+    if (cpattern == NULL || watch == NULL) {
+        LOG_VERBOSE(sctx->log, "error: watch or pattern is NULL in %s", __func__);
+        return SENSOR_ERROR;
+    }
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    result = sensor_watch_add_match_unlocked(sctx, &(cpattern->matchdata), watch);
+    sensor_unlock(sctx);
+
+    return result;
+}
+
 /* ************************************************************************ */
 sensor_status_t sensor_watch_add_desc(
                     sensor_ctx_t *          sctx,
@@ -1828,120 +3466,1946 @@ sensor_status_t sensor_watch_del(
 }
 
 /* ************************************************************************ */
-const slist_t * sensor_watch_list_get(sensor_ctx_t *sctx) {
-    const slist_t * result;
+sensor_status_t sensor_watch_del_compiled(
+                    sensor_ctx_t *          sctx,
+                    const sensor_pattern_t *cpattern) {
+    sensor_status_t result;
+
+    if (sctx == NULL || cpattern == NULL) {
+        return SENSOR_ERROR;
+    }
+    LOG_VERBOSE(sctx->log, "REMOVING WATCHS, compiled pattern:'%s'", cpattern->pattern_copy);
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    result = sensor_watch_del_match_unlocked(sctx, &(cpattern->matchdata));
+    sensor_unlock(sctx);
+
+    return result;
+}
+
+/* ************************************************************************ */
+const slist_t * sensor_watch_list_get(sensor_ctx_t *sctx) {
+    const slist_t * result;
+
+    if (sctx == NULL) {
+        return NULL;
+    }
+    result = sctx->watchlist;
+
+    return result;
+}
+
+/* ************************************************************************ */
+unsigned long sensor_watch_timerms(sensor_sample_t * sample) {
+    if (sample == NULL) {
+        errno = EFAULT;
+        return 0UL;
+    }
+    return sample->watch->update_interval.tv_sec * 1000UL
+           + sample->watch->update_interval.tv_usec / 1000UL;
+}
+
+
+/* ************************************************************************ */
+void sensor_watch_free(sensor_ctx_t *sctx) {
+    if (sctx == NULL) {
+        return ;
+    }
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    avltree_clear(sctx->watchs);
+    sensor_index_clear(sctx, 0);
+    sctx->sched.count = 0;
+    slist_free(sctx->watchlist, sensor_watch_free_one);
+    sctx->watchlist = NULL;
+    avltree_clear(sctx->watch_params);
+    slist_free(sctx->watchfiles, free);
+    sctx->watchfiles = NULL;
+    sensor_unlock(sctx);
+}
+
+/* ************************************************************************ */
+typedef struct {
+    sensor_ctx_t *  sctx;
+    unsigned long   pgcd;
+    double *        p_precision;
+    double          min_precision;
+} sensor_watchpgcd_visit_t;
+static AVLTREE_DECLARE_VISITFUN(sensor_watchpgcd_visit, node_data, context, user_data) {
+    sensor_watchparam_entry_t * watchparam = (sensor_watchparam_entry_t *) node_data;
+    sensor_watchpgcd_visit_t *  data = (sensor_watchpgcd_visit_t *) user_data;
+    (void) context;
+
+    unsigned long interval_ms = watchparam->watch.update_interval.tv_sec * 1000
+                              + watchparam->watch.update_interval.tv_usec / 1000;
+
+    data->pgcd = pgcd_rounded(data->pgcd, interval_ms, data->p_precision, data->min_precision);
+
+    LOG_DEBUG(data->sctx->log, "loop. new pgcd=%lu, current=%lu, precision=%f",
+              data->pgcd, interval_ms, *(data->p_precision));
+
+    return AVS_CONTINUE;
+}
+
+/* ************************************************************************ */
+unsigned long sensor_watch_pgcd(sensor_ctx_t *sctx,
+                                double * p_precision, double min_precision) {
+    double                      precision;
+    sensor_watchpgcd_visit_t    data;
+    int                         ret;
+
+    if (sctx == NULL) {
+        return 0;
+    }
+    if (p_precision == NULL) {
+        precision = 1.0L;
+        p_precision = &precision;
+        min_precision = 1.0L;
+    }
+    if (min_precision <= 0.0L) {
+        min_precision = 1.0L;
+    }
+    if (*p_precision <= 0.0L) {
+        *p_precision = 1.0L;
+    }
+    data.p_precision = p_precision;
+    data.min_precision = min_precision;
+    data.pgcd = 0;
+    data.sctx = sctx;
+
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+
+    ret = avltree_visit(sctx->watch_params, sensor_watchpgcd_visit, &data, AVH_INFIX | AVH_RIGHT);
+
+    LOG_DEBUG(sctx->log, "END. pgcd=%lu, precision=%f, ret=%d",
+              data.pgcd, *(data.p_precision), ret);
+
+    if (ret != AVS_FINISHED) {
+        LOG_WARN(sctx->log, "watch_params tree pgcd error");
+    }
+
+    sensor_unlock(sctx);
+
+    return data.pgcd;
+}
+
+
+/* ************************************************************************
+ * SENSOR WATCH SAVE / LOAD : versioned binary file, native byte order,
+ * fixed size records read in place from a mmap().
+ *   header | params[n_params] | props[n_props] | watchs[n_watchs] | blob[blob_size]
+ * Offsets are relative to blob, which holds 0-terminated names and buffer values.
+ * ************************************************************************ */
+
+#define SENSOR_WATCHFILE_MAGIC      "VSWF"
+#define SENSOR_WATCHFILE_VERSION    7
+#define SENSOR_WATCHFILE_BYTEORDER  0x01020304U
+
+typedef enum {
+    SWFF_NONE       = 0,
+    SWFF_PATTERN    = 1 << 0,   /* name is a pattern of a loading family, not a label */
+} sensor_watchfile_flag_t;
+
+typedef struct {
+    uint32_t        type;
+    uint32_t        size;       /* buffers: number of bytes in blob */
+    uint32_t        offset;     /* buffers: offset in blob */
+    uint32_t        reserved;
+    unsigned char   data[sizeof(((sensor_value_t *) 0)->data)]; /* other types: raw data */
+} sensor_watchfile_value_t;
+
+typedef struct {
+    char            magic[4];
+    uint32_t        version;
+    uint32_t        byteorder;
+    uint32_t        value_size; /* sizeof(sensor_watchfile_value_t) */
+    uint32_t        n_params;
+    uint32_t        n_props;
+    uint32_t        n_watchs;
+    uint32_t        blob_size;
+} sensor_watchfile_header_t;
+
+typedef struct {
+    uint32_t                    tv_sec;
+    uint32_t                    tv_usec;
+    uint32_t                    prop_first;
+    uint32_t                    prop_count;
+    uint32_t                    history_size;
+    uint32_t                    archive_size;
+    uint32_t                    flags;      /* sensor_watch_flag_t */
+    uint32_t                    max_tv_sec;
+    uint32_t                    max_tv_usec;
+    uint32_t                    slack_tv_sec;
+    uint32_t                    slack_tv_usec;
+    sensor_watchfile_value_t    update_levels[SENSOR_LEVEL_NB];
+    sensor_watchfile_value_t    level_hysteresis;
+    sensor_watchfile_value_t    deadband_abs;
+    sensor_watchfile_value_t    deadband_pct;
+} sensor_watchfile_param_t;
+
+typedef struct {
+    uint32_t                    name_offset;
+    uint32_t                    reserved;
+    sensor_watchfile_value_t    value;
+} sensor_watchfile_prop_t;
+
+typedef struct {
+    uint32_t        name_offset;
+    uint32_t        name_len;
+    uint32_t        param_idx;
+    uint32_t        flags;      /* sensor_watchfile_flag_t */
+} sensor_watchfile_watch_t;
+
+/** growing buffer for sensor_watch_save() sections, error is kept until the end */
+typedef struct {
+    char *          buf;
+    size_t          size;
+    size_t          maxsize;
+    int             error;
+} sensor_watchfile_buf_t;
+
+/* ************************************************************************ */
+static uint32_t sensor_watchfile_append(
+                            sensor_watchfile_buf_t *    wbuf,
+                            const void *                data,
+                            size_t                      size) {
+    uint32_t offset = wbuf->size;
+
+    if (wbuf->error) {
+        return 0;
+    }
+    if (wbuf->size + size > UINT32_MAX) {
+        wbuf->error = 1;
+        return 0;
+    }
+    if (wbuf->size + size > wbuf->maxsize) {
+        size_t  maxsize = wbuf->maxsize == 0 ? 4096 : wbuf->maxsize;
+        char *  buf;
+
+        while (maxsize < wbuf->size + size)
+            maxsize *= 2;
+        if ((buf = realloc(wbuf->buf, maxsize)) == NULL) {
+            wbuf->error = 1;
+            return 0;
+        }
+        wbuf->buf = buf;
+        wbuf->maxsize = maxsize;
+    }
+    if (size > 0) {
+        memcpy(wbuf->buf + wbuf->size, data, size);
+    }
+    wbuf->size += size;
+    return offset;
+}
+
+/* ************************************************************************ */
+static void sensor_watchfile_value_put(
+                            sensor_watchfile_value_t *  record,
+                            const sensor_value_t *      value,
+                            sensor_watchfile_buf_t *    blob) {
+    memset(record, 0, sizeof(*record));
+    record->type = value->type;
+    if (SENSOR_VALUE_IS_BUFFER(value->type)) {
+        if (value->data.b.buf != NULL) {
+            record->size = value->type == SENSOR_VALUE_STRING
+                           ? strlen(value->data.b.buf) + 1 : value->data.b.size;
+            record->offset = sensor_watchfile_append(blob, value->data.b.buf, record->size);
+        }
+    } else {
+        memcpy(record->data, &(value->data), sizeof(record->data));
+    }
+}
+
+/* ************************************************************************ */
+static sensor_status_t sensor_watchfile_value_get(
+                            const sensor_watchfile_value_t *    record,
+                            sensor_value_t *                    value,
+                            char *                              blob,
+                            uint32_t                            blob_size) {
+    if (record->type >= SENSOR_VALUE_NB) {
+        return SENSOR_ERROR;
+    }
+    memset(value, 0, sizeof(*value));
+    value->type = record->type;
+    if (SENSOR_VALUE_IS_BUFFER(record->type)) {
+        if (record->size > blob_size || record->offset > blob_size - record->size) {
+            return SENSOR_ERROR;
+        }
+        if (record->size > 0) {
+            SENSOR_VALUE_INIT_BUF(*value, record->type, blob + record->offset, record->size);
+        }
+        return SENSOR_SUCCESS;
+    }
+    memcpy(&(value->data), record->data, sizeof(record->data));
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static void sensor_watchfile_double_put(
+                            sensor_watchfile_value_t *  record,
+                            double                      d,
+                            sensor_watchfile_buf_t *    blob) {
+    sensor_value_t value;
+
+    SENSOR_VALUE_INIT(value, SENSOR_VALUE_DOUBLE, d);
+    sensor_watchfile_value_put(record, &value, blob);
+}
+
+/* ************************************************************************ */
+static double sensor_watchfile_double_get(
+                            const sensor_watchfile_value_t *    record,
+                            char *                              blob,
+                            uint32_t                            blob_size) {
+    sensor_value_t value;
+
+    if (record->type != SENSOR_VALUE_DOUBLE
+    ||  sensor_watchfile_value_get(record, &value, blob, blob_size) != SENSOR_SUCCESS) {
+        return 0.0;
+    }
+    return value.data.d;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_watch_save(slist_t * watch_list, const char * path) {
+    sensor_ctx_t *              sctx;
+    sensor_watchfile_header_t   header;
+    sensor_watchfile_buf_t      params = { NULL, 0, 0, 0 }, props = { NULL, 0, 0, 0 };
+    sensor_watchfile_buf_t      watchs = { NULL, 0, 0, 0 }, blob = { NULL, 0, 0, 0 };
+    sensor_watchfile_buf_t      saved_params = { NULL, 0, 0, 0 }; /* const sensor_watch_t * */
+    sensor_status_t             ret = SENSOR_SUCCESS;
+    char                        tmppath[PATH_MAX];
+    FILE *                      out;
+    int                         fd;
+
+    if (path == NULL || watch_list == NULL || watch_list->data == NULL) {
+        return SENSOR_ERROR;
+    }
+    sctx = ((sensor_sample_t *) watch_list->data)->desc->family->sctx;
+
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    SLIST_FOREACH_DATA(watch_list, sample, sensor_sample_t *) {
+        const sensor_watch_t **     watch_params = (const sensor_watch_t **) saved_params.buf;
+        uint32_t                    n_params = saved_params.size / sizeof(*watch_params);
+        sensor_watchfile_watch_t    watch = { .flags = SWFF_NONE };
+        const char *                name;
+        char                        label[SENSOR_LABEL_SIZE];
+
+        /* resolved label, or pattern waiting for its family to be loaded */
+        if (sample->desc->properties == s_sensor_loading_properties
+        &&  sample->desc->key != NULL
+        &&  ((sensor_loadinginfo_t *) sample->desc->key)->pattern != NULL) {
+            name = ((sensor_loadinginfo_t *) sample->desc->key)->pattern;
+            watch.flags |= SWFF_PATTERN;
+        } else if (sample->desc->label == s_sensor_loading_label) {
+            continue ; /* generic loading desc, nothing to restore */
+        } else if ((name = sensor_desc_fullname(sample->desc, NULL, NULL)) == NULL) {
+            snprintf(label, PTR_COUNT(label), "%s/%s",
+                     SENSOR_DESC_FAMNAME(sample->desc), SENSOR_DESC_LABEL(sample->desc));
+            name = label;
+        }
+
+        /* watch parameters are shared by samples, store them once */
+        for (watch.param_idx = 0; watch.param_idx < n_params
+                && watch_params[watch.param_idx] != sample->watch; ++watch.param_idx)
+            ; /* nothing but loop */
+        if (watch.param_idx == n_params) {
+            sensor_watchfile_param_t param;
+
+            sensor_watchfile_append(&saved_params, &(sample->watch), sizeof(sample->watch));
+            param.tv_sec = sample->watch->update_interval.tv_sec;
+            param.tv_usec = sample->watch->update_interval.tv_usec;
+            param.prop_first = props.size / sizeof(sensor_watchfile_prop_t);
+            param.prop_count = 0;
+            param.history_size = sample->watch->history_size;
+            param.archive_size = sample->watch->archive_size;
+            param.flags = sample->watch->flags;
+            param.max_tv_sec = sample->watch->update_interval_max.tv_sec;
+            param.max_tv_usec = sample->watch->update_interval_max.tv_usec;
+            param.slack_tv_sec = sample->watch->update_slack.tv_sec;
+            param.slack_tv_usec = sample->watch->update_slack.tv_usec;
+            for (unsigned int i = 0; i < SENSOR_LEVEL_NB; ++i) {
+                sensor_watchfile_value_put(&(param.update_levels[i]),
+                                           &(sample->watch->update_levels[i]), &blob);
+            }
+            sensor_watchfile_double_put(&(param.level_hysteresis),
+                                        sample->watch->level_hysteresis, &blob);
+            sensor_watchfile_double_put(&(param.deadband_abs), sample->watch->deadband_abs, &blob);
+            sensor_watchfile_double_put(&(param.deadband_pct), sample->watch->deadband_pct, &blob);
+            for (const sensor_property_t * property = sample->watch->properties;
+                    SENSOR_PROPERTY_VALID(property); ++property, ++(param.prop_count)) {
+                sensor_watchfile_prop_t prop = { .reserved = 0 };
+
+                prop.name_offset = sensor_watchfile_append(&blob, SENSOR_PROP_NAME(property),
+                                                           strlen(SENSOR_PROP_NAME(property)) + 1);
+                sensor_watchfile_value_put(&(prop.value), &(property->value), &blob);
+                sensor_watchfile_append(&props, &prop, sizeof(prop));
+            }
+            sensor_watchfile_append(&params, &param, sizeof(param));
+        }
+
+        watch.name_len = strlen(name);
+        watch.name_offset = sensor_watchfile_append(&blob, name, watch.name_len + 1);
+        sensor_watchfile_append(&watchs, &watch, sizeof(watch));
+    }
+    sensor_unlock(sctx);
+
+    if (params.error || props.error || watchs.error || blob.error || saved_params.error) {
+        LOG_WARN(sctx->log, "%s(): cannot allocate watch file data", __func__);
+        ret = SENSOR_ERROR;
+    } else {
+        memcpy(header.magic, SENSOR_WATCHFILE_MAGIC, sizeof(header.magic));
+        header.version = SENSOR_WATCHFILE_VERSION;
+        header.byteorder = SENSOR_WATCHFILE_BYTEORDER;
+        header.value_size = sizeof(sensor_watchfile_value_t);
+        header.n_params = params.size / sizeof(sensor_watchfile_param_t);
+        header.n_props = props.size / sizeof(sensor_watchfile_prop_t);
+        header.n_watchs = watchs.size / sizeof(sensor_watchfile_watch_t);
+        header.blob_size = blob.size;
+
+        /* write a temporary file, renamed so that readers never see a partial file.
+         * mkstemp() creates a new file (O_EXCL), not following links, mode 0600 */
+        if ((size_t) snprintf(tmppath, PTR_COUNT(tmppath), "%s.XXXXXX", path)
+                >= PTR_COUNT(tmppath)
+        ||  (fd = mkstemp(tmppath)) < 0) {
+            ret = SENSOR_ERROR;
+        } else if ((out = fdopen(fd, "wb")) == NULL) {
+            ret = SENSOR_ERROR;
+            close(fd);
+            unlink(tmppath);
+        } else {
+            if (fwrite(&header, sizeof(header), 1, out) != 1
+            ||  (params.size > 0 && fwrite(params.buf, 1, params.size, out) != params.size)
+            ||  (props.size > 0 && fwrite(props.buf, 1, props.size, out) != props.size)
+            ||  (watchs.size > 0 && fwrite(watchs.buf, 1, watchs.size, out) != watchs.size)
+            ||  (blob.size > 0 && fwrite(blob.buf, 1, blob.size, out) != blob.size)) {
+                ret = SENSOR_ERROR;
+            }
+            if (fclose(out) != 0 || ret != SENSOR_SUCCESS || rename(tmppath, path) != 0) {
+                ret = SENSOR_ERROR;
+                unlink(tmppath);
+            }
+        }
+        if (ret != SENSOR_SUCCESS) {
+            LOG_WARN(sctx->log, "%s(): cannot save watchs to '%s': %s",
+                     __func__, path, strerror(errno));
+        } else {
+            LOG_VERBOSE(sctx->log, "%s(): %u watchs saved to '%s'",
+                        __func__, header.n_watchs, path);
+        }
+    }
+
+    if (saved_params.buf != NULL)
+        free(saved_params.buf);
+    if (params.buf != NULL)
+        free(params.buf);
+    if (props.buf != NULL)
+        free(props.buf);
+    if (watchs.buf != NULL)
+        free(watchs.buf);
+    if (blob.buf != NULL)
+        free(blob.buf);
+
+    return ret;
+}
+
+/* ************************************************************************ */
+/** restore the watchs of a mapped watch file, under write lock.
+ * the memory of loaded properties and buffers is kept until sensor_watch_free() */
+static sensor_status_t sensor_watchfile_load_unlocked(
+                            sensor_ctx_t *              sctx,
+                            const char *                map,
+                            size_t                      map_size,
+                            sensor_watch_callback_t     callback,
+                            void *                      callback_data) {
+    const sensor_watchfile_header_t *   header = (const sensor_watchfile_header_t *) map;
+    const sensor_watchfile_param_t *    params;
+    const sensor_watchfile_prop_t *     props;
+    const sensor_watchfile_watch_t *    watchs;
+    sensor_property_t *                 properties;
+    sensor_watch_t *                    watch_params;
+    char *                              block;
+    char *                              blob;
+    slist_t *                           blocks;
+    size_t                              size;
+    uint32_t                            n_copied = 0;   /* properties copied to block */
+    unsigned int                        n_failed = 0;
+
+    /* check header and sections: map_size must be exactly the size of sections */
+    if (map_size < sizeof(*header)
+    ||  memcmp(header->magic, SENSOR_WATCHFILE_MAGIC, sizeof(header->magic)) != 0
+    ||  header->version != SENSOR_WATCHFILE_VERSION
+    ||  header->byteorder != SENSOR_WATCHFILE_BYTEORDER
+    ||  header->value_size != sizeof(sensor_watchfile_value_t)
+    ||  header->n_params > map_size / sizeof(*params)
+    ||  header->n_props > map_size / sizeof(*props)
+    ||  header->n_watchs > map_size / sizeof(*watchs)
+    ||  map_size != sizeof(*header) + header->n_params * sizeof(*params)
+                    + header->n_props * sizeof(*props) + header->n_watchs * sizeof(*watchs)
+                    + header->blob_size
+    ||  (header->blob_size > 0 && map[map_size - 1] != 0)) {
+        LOG_WARN(sctx->log, "%s(): bad watch file format or version", __func__);
+        return SENSOR_ERROR;
+    }
+    params = (const sensor_watchfile_param_t *) (header + 1);
+    props = (const sensor_watchfile_prop_t *) (params + header->n_params);
+    watchs = (const sensor_watchfile_watch_t *) (props + header->n_props);
+
+    /* one block for properties arrays (NULL terminated) and blob copy */
+    size = (header->n_props + header->n_params) * sizeof(*properties) + header->blob_size;
+    if ((block = malloc(size > 0 ? size : 1)) == NULL) {
+        LOG_WARN(sctx->log, "%s(): cannot allocate watch file data: %s",
+                 __func__, strerror(errno));
+        return SENSOR_ERROR;
+    }
+    if ((watch_params = calloc(header->n_params + 1, sizeof(*watch_params))) == NULL) {
+        LOG_WARN(sctx->log, "%s(): cannot allocate watch file data: %s",
+                 __func__, strerror(errno));
+        free(block);
+        return SENSOR_ERROR;
+    }
+    properties = (sensor_property_t *) block;
+    blob = block + (header->n_props + header->n_params) * sizeof(*properties);
+    memcpy(blob, (const char *) (watchs + header->n_watchs), header->blob_size);
+
+    /* decode watch parameters */
+    for (uint32_t i_param = 0; i_param < header->n_params; ++i_param) {
+        const sensor_watchfile_param_t *    param = &(params[i_param]);
+        sensor_watch_t *                    watch = &(watch_params[i_param]);
+
+        *watch = SENSOR_WATCH_INITIALIZER(0, callback);
+        watch->callback_data = callback_data;
+        watch->update_interval.tv_sec = param->tv_sec;
+        watch->update_interval.tv_usec = param->tv_usec;
+        watch->history_size = param->history_size;
+        watch->archive_size = param->archive_size;
+        watch->flags = param->flags;
+        watch->update_interval_max.tv_sec = param->max_tv_sec;
+        watch->update_interval_max.tv_usec = param->max_tv_usec;
+        watch->update_slack.tv_sec = param->slack_tv_sec;
+        watch->update_slack.tv_usec = param->slack_tv_usec;
+        watch->level_hysteresis = sensor_watchfile_double_get(&(param->level_hysteresis),
+                                                              blob, header->blob_size);
+        watch->deadband_abs = sensor_watchfile_double_get(&(param->deadband_abs),
+                                                          blob, header->blob_size);
+        watch->deadband_pct = sensor_watchfile_double_get(&(param->deadband_pct),
+                                                          blob, header->blob_size);
+        for (unsigned int i = 0; i < SENSOR_LEVEL_NB; ++i) {
+            if (sensor_watchfile_value_get(&(param->update_levels[i]), &(watch->update_levels[i]),
+                                           blob, header->blob_size) != SENSOR_SUCCESS) {
+                free(watch_params);
+                free(block);
+                return SENSOR_ERROR;
+            }
+        }
+        /* ranges are checked one by one, and the properties copied by all of them
+         * must fit in block: overlapping ranges could exceed it */
+        if (param->prop_count > header->n_props - n_copied
+        ||  param->prop_first > header->n_props - param->prop_count) {
+            free(watch_params);
+            free(block);
+            return SENSOR_ERROR;
+        }
+        if (param->prop_count > 0) {
+            watch->properties = properties;
+            n_copied += param->prop_count;
+            for (uint32_t i = 0; i < param->prop_count; ++i, ++properties) {
+                const sensor_watchfile_prop_t * prop = &(props[param->prop_first + i]);
+                if (prop->name_offset >= header->blob_size
+                ||  sensor_watchfile_value_get(&(prop->value), &(properties->value),
+                                               blob, header->blob_size) != SENSOR_SUCCESS) {
+                    free(watch_params);
+                    free(block);
+                    return SENSOR_ERROR;
+                }
+                properties->name = blob + prop->name_offset;
+            }
+            *(properties++) = (sensor_property_t) { NULL, { .type = SENSOR_VALUE_NULL, } };
+        }
+    }
+
+    /* block is referenced by watch parameters from now, until sensor_watch_free() */
+    if ((blocks = slist_prepend(sctx->watchfiles, block)) == NULL) {
+        free(watch_params);
+        free(block);
+        return SENSOR_ERROR;
+    }
+    sctx->watchfiles = blocks;
+
+    /* add watchs, resolving labels with the name index */
+    for (uint32_t i_watch = 0; i_watch < header->n_watchs; ++i_watch) {
+        const sensor_watchfile_watch_t *    watch = &(watchs[i_watch]);
+        sensor_index_entry_t *              entry = NULL;
+        sensor_desc_match_t                 matchdata;
+        const char *                        name;
+
+        if (watch->name_offset >= header->blob_size
+        ||  watch->name_len >= header->blob_size - watch->name_offset
+        ||  watch->param_idx >= header->n_params) {
+            ++n_failed;
+            continue ;
+        }
+        name = blob + watch->name_offset;
+        if ((watch->flags & SWFF_PATTERN) == 0
+        &&  sensor_desc_match_get(&matchdata, name, SSF_NOPATTERN) == SENSOR_SUCCESS) {
+            unsigned int n_found = 0;
+            while ((entry = sensor_index_next(&(sctx->index), &matchdata, entry)) != NULL) {
+                if (sensor_watch_add_desc_unlocked(sctx, entry->desc, SSF_NOPATTERN,
+                                                   &(watch_params[watch->param_idx])) != NULL) {
+                    ++n_found;
+                }
+            }
+            if (n_found > 0) {
+                continue ;
+            }
+        }
+        /* pattern, or family not loaded yet */
+        if (sensor_watch_add_unlocked(sctx, name, (watch->flags & SWFF_PATTERN) != 0
+                                                  ? SSF_DEFAULT : SSF_NOPATTERN,
+                                      &(watch_params[watch->param_idx])) != SENSOR_SUCCESS) {
+            LOG_VERBOSE(sctx->log, "%s(): cannot restore watch '%s'", __func__, name);
+            ++n_failed;
+        }
+    }
+    free(watch_params);
+
+    LOG_VERBOSE(sctx->log, "%s(): %u/%u watchs restored", __func__,
+                header->n_watchs - n_failed, header->n_watchs);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+const slist_t * sensor_watch_load(const char * path) {
+    /* the watchs can't be added without context, see sensor_watch_load_ctx() */
+    (void)path;
+    return NULL;
+}
+
+/* ************************************************************************ */
+const slist_t * sensor_watch_load_ctx(
+                    sensor_ctx_t *          sctx,
+                    const char *            path,
+                    sensor_watch_callback_t callback,
+                    void *                  callback_data) {
+    const slist_t * result = NULL;
+    struct stat     st;
+    void *          map;
+    int             fd;
+
+    if (sctx == NULL || path == NULL) {
+        return NULL;
+    }
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        LOG_VERBOSE(sctx->log, "%s(): cannot open '%s': %s", __func__, path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0
+    ||  (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        LOG_WARN(sctx->log, "%s(): cannot map '%s': %s", __func__, path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    if (sensor_watchfile_load_unlocked(sctx, map, st.st_size,
+                                       callback, callback_data) == SENSOR_SUCCESS) {
+        result = sctx->watchlist;
+    }
+    sensor_unlock(sctx);
+
+    munmap(map, st.st_size);
+    close(fd);
+
+    return result;
+}
+
+
+/* ************************************************************************
+ * SENSOR EXPORT : serialization of the samples updated by one update pass
+ * into a reusable buffer, written with one writev() per pass.
+ * Exporters list is modified under write lock and run under read lock;
+ * each exporter has its own mutex as several threads can update concurrently.
+ * ************************************************************************ */
+
+#define SENSOR_EXPORT_BIN_MAGIC     "VSXB"
+#define SENSOR_EXPORT_BIN_VERSION   1
+#define SENSOR_EXPORT_BYTEORDER     0x01020304U
+#define SENSOR_EXPORT_REC_NAME      0xff    /* record type defining the name of an id */
+#define SENSOR_EXPORT_MEASUREMENT   "sensors"
+
+/** binary frame header, one per update pass, followed by 'size' bytes of records */
+typedef struct {
+    char            magic[4];
+    uint8_t         version;
+    uint8_t         flags;      /* SEBF_* */
+    uint16_t        header_size;
+    uint32_t        byteorder;
+    uint32_t        n_records;
+    uint32_t        size;
+    uint32_t        reserved;
+    uint64_t        time_ns;    /* CLOCK_REALTIME nano-seconds */
+} sensor_export_binheader_t;
+
+/** binary record header, followed by 'size' bytes of data */
+typedef struct {
+    uint32_t        id;
+    uint8_t         type;       /* sensor_value_type_t or SENSOR_EXPORT_REC_NAME */
+    uint8_t         reserved;
+    uint16_t        size;
+} sensor_export_binrecord_t;
+
+enum {
+    SEBF_NONE       = 0,
+    SEBF_RESET      = 1 << 0,   /* ids previously defined are no longer valid */
+};
+
+typedef struct {
+    const sensor_desc_t *   desc;
+    uint32_t                id;
+} sensor_export_id_t;
+
+struct sensor_export_s {
+    sensor_ctx_t *          sctx;
+    int                     fd;
+    sensor_export_format_t  format;
+    char *                  measurement;
+    pthread_mutex_t         mutex;
+    /* output buffer, kept between passes */
+    char *                  buf;
+    size_t                  size;
+    size_t                  maxsize;
+    int                     error;
+    uint32_t                n_records;
+    /* binary format: ids given to sensors, hash table of desc pointers */
+    sensor_export_id_t *    ids;
+    unsigned int            ids_size;   /* power of 2, or 0 */
+    unsigned int            ids_count;
+    uint8_t                 bin_flags;
+};
+
+/* ************************************************************************ */
+static inline char * sensor_export_reserve(sensor_export_t * exporter, size_t size) {
+    if (exporter->size + size > exporter->maxsize) {
+        size_t  maxsize = exporter->maxsize == 0 ? 4096 : exporter->maxsize;
+        char *  buf;
+
+        while (maxsize < exporter->size + size)
+            maxsize *= 2;
+        if ((buf = realloc(exporter->buf, maxsize)) == NULL) {
+            exporter->error = 1;
+            return NULL;
+        }
+        exporter->buf = buf;
+        exporter->maxsize = maxsize;
+    }
+    return exporter->buf + exporter->size;
+}
+
+/* ************************************************************************ */
+static inline void sensor_export_append(sensor_export_t * exporter, const void * data, size_t size) {
+    char * dst;
+
+    if ((dst = sensor_export_reserve(exporter, size)) != NULL) {
+        memcpy(dst, data, size);
+        exporter->size += size;
+    }
+}
+
+/* ************************************************************************ */
+/** append str, escaping with a backslash the characters of 'specials' */
+static void sensor_export_append_escaped(sensor_export_t * exporter, const char * str,
+                                         size_t len, const char * specials) {
+    char *  dst;
+
+    if ((dst = sensor_export_reserve(exporter, 2 * len)) == NULL)
+        return ;
+    for (size_t i = 0; i < len; ++i) {
+        if (strchr(specials, str[i]) != NULL && str[i] != 0)
+            *(dst++) = '\\';
+        *(dst++) = str[i];
+    }
+    exporter->size = dst - exporter->buf;
+}
+
+/* ************************************************************************ */
+/** append printf-formatted data to exporter buffer */
+static void sensor_export_printf(sensor_export_t * exporter, const char * fmt, ...)
+                                 __attribute__((format(printf, 2, 3)));
+static void sensor_export_printf(sensor_export_t * exporter, const char * fmt, ...) {
+    va_list     valist;
+    int         len;
+    char *      dst;
+
+    if ((dst = sensor_export_reserve(exporter, 64)) == NULL)
+        return ;
+    va_start(valist, fmt);
+    len = vsnprintf(dst, exporter->maxsize - exporter->size, fmt, valist);
+    va_end(valist);
+    if (len >= 0 && (size_t) len >= exporter->maxsize - exporter->size) {
+        if ((dst = sensor_export_reserve(exporter, len + 1)) == NULL)
+            return ;
+        va_start(valist, fmt);
+        len = vsnprintf(dst, exporter->maxsize - exporter->size, fmt, valist);
+        va_end(valist);
+    }
+    if (len < 0) {
+        exporter->error = 1;
+        return ;
+    }
+    exporter->size += len;
+}
+
+/* ************************************************************************ */
+/** '<measurement>,family=<fam>,label=<label> value=<value> <time_ns>\n' */
+static void sensor_export_lineproto(sensor_export_t * exporter, const sensor_sample_t * sample,
+                                    const char * timestamp) {
+    const sensor_value_t *  value = &(sample->value);
+    const char *            label = SENSOR_DESC_LABEL(sample->desc);
+    const char *            famname = SENSOR_DESC_FAMNAME(sample->desc);
+
+    sensor_export_append_escaped(exporter, exporter->measurement,
+                                 strlen(exporter->measurement), ", ");
+    sensor_export_append(exporter, ",family=", 8);
+    sensor_export_append_escaped(exporter, famname, strlen(famname), ",= ");
+    sensor_export_append(exporter, ",label=", 7);
+    sensor_export_append_escaped(exporter, label, strlen(label), ",= ");
+    sensor_export_append(exporter, " value=", 7);
+
+    switch (value->type) {
+        case SENSOR_VALUE_FLOAT:
+            sensor_export_printf(exporter, "%.*g", FLT_DIG, (double) value->data.f);
+            break ;
+        case SENSOR_VALUE_DOUBLE:
+            sensor_export_printf(exporter, "%.*g", DBL_DIG, value->data.d);
+            break ;
+        case SENSOR_VALUE_LDOUBLE:
+            sensor_export_printf(exporter, "%.*Lg", LDBL_DIG, value->data.ld);
+            break ;
+        case SENSOR_VALUE_UINT64:
+        case SENSOR_VALUE_ULONG: {
+            uint64_t u64 = value->type == SENSOR_VALUE_ULONG ? value->data.ul : value->data.u64;
+            sensor_export_printf(exporter, u64 > INT64_MAX ? "%" PRIu64 "u" : "%" PRIu64 "i", u64);
+            break ;
+        }
+        case SENSOR_VALUE_STRING:
+            sensor_export_append(exporter, "\"", 1);
+            if (value->data.b.buf != NULL) {
+                sensor_export_append_escaped(exporter, value->data.b.buf,
+                        strnlen(value->data.b.buf, value->data.b.size), "\"\\");
+            }
+            sensor_export_append(exporter, "\"", 1);
+            break ;
+        case SENSOR_VALUE_BYTES: {
+            char *  dst;
+            int     len;
+            size_t  maxlen = value->data.b.size * 3 + 1;
+
+            sensor_export_append(exporter, "\"", 1);
+            if ((dst = sensor_export_reserve(exporter, maxlen)) != NULL
+            &&  (len = sensor_value_tostring(value, dst, maxlen)) > 0) {
+                exporter->size += ((size_t) len < maxlen ? (size_t) len : maxlen - 1);
+            }
+            sensor_export_append(exporter, "\"", 1);
+            break ;
+        }
+        default:
+            sensor_export_printf(exporter, "%" PRIdMAX "i", sensor_value_toint(value));
+            break ;
+    }
+    sensor_export_append(exporter, " ", 1);
+    sensor_export_append(exporter, timestamp, strlen(timestamp));
+    sensor_export_append(exporter, "\n", 1);
+    ++(exporter->n_records);
+}
+
+/* ************************************************************************ */
+static size_t sensor_export_value_size(const sensor_value_t * value) {
+    switch (value->type) {
+        case SENSOR_VALUE_UCHAR:    return sizeof(value->data.uc);
+        case SENSOR_VALUE_CHAR:     return sizeof(value->data.c);
+        case SENSOR_VALUE_UINT16:   return sizeof(value->data.u16);
+        case SENSOR_VALUE_INT16:    return sizeof(value->data.i16);
+        case SENSOR_VALUE_UINT32:   return sizeof(value->data.u32);
+        case SENSOR_VALUE_INT32:    return sizeof(value->data.i32);
+        case SENSOR_VALUE_UINT:     return sizeof(value->data.ui);
+        case SENSOR_VALUE_INT:      return sizeof(value->data.i);
+        case SENSOR_VALUE_ULONG:    return sizeof(value->data.ul);
+        case SENSOR_VALUE_LONG:     return sizeof(value->data.l);
+        case SENSOR_VALUE_FLOAT:    return sizeof(value->data.f);
+        case SENSOR_VALUE_DOUBLE:   return sizeof(value->data.d);
+        case SENSOR_VALUE_LDOUBLE:  return sizeof(value->data.ld);
+        case SENSOR_VALUE_UINT64:   return sizeof(value->data.u64);
+        case SENSOR_VALUE_INT64:    return sizeof(value->data.i64);
+        case SENSOR_VALUE_STRING:
+            return value->data.b.buf == NULL ? 0 : strnlen(value->data.b.buf, value->data.b.size);
+        case SENSOR_VALUE_BYTES:
+            return value->data.b.buf == NULL ? 0 : value->data.b.size;
+        default:
+            return 0;
+    }
+}
+
+/* ************************************************************************ */
+/** get the id of desc, or give it a new one, *p_new being set in that case */
+static uint32_t sensor_export_id(sensor_export_t * exporter, const sensor_desc_t * desc, int * p_new) {
+    unsigned int    mask, i;
+
+    *p_new = 0;
+    if (exporter->ids_count >= exporter->ids_size / 2) {
+        unsigned int            size = exporter->ids_size == 0 ? 256 : exporter->ids_size * 2;
+        sensor_export_id_t *    ids;
+
+        if ((ids = calloc(size, sizeof(*ids))) == NULL) {
+            exporter->error = 1;
+            return 0;
+        }
+        for (unsigned int j = 0; j < exporter->ids_size; ++j) {
+            if (exporter->ids[j].desc == NULL)
+                continue ;
+            for (i = ((size_t) exporter->ids[j].desc >> 4) & (size - 1); ids[i].desc != NULL;
+                    i = (i + 1) & (size - 1))
+                ; /* nothing but loop */
+            ids[i] = exporter->ids[j];
+        }
+        if (exporter->ids != NULL)
+            free(exporter->ids);
+        exporter->ids = ids;
+        exporter->ids_size = size;
+    }
+    mask = exporter->ids_size - 1;
+    for (i = ((size_t) desc >> 4) & mask; exporter->ids[i].desc != NULL; i = (i + 1) & mask) {
+        if (exporter->ids[i].desc == desc)
+            return exporter->ids[i].id;
+    }
+    exporter->ids[i].desc = desc;
+    exporter->ids[i].id = exporter->ids_count++;
+    *p_new = 1;
+    return exporter->ids[i].id;
+}
+
+/* ************************************************************************ */
+static void sensor_export_binary(sensor_export_t * exporter, const sensor_sample_t * sample) {
+    sensor_export_binrecord_t   record = { .reserved = 0 };
+    const char *                data;
+    size_t                      size;
+    int                         b_new;
+
+    record.id = sensor_export_id(exporter, sample->desc, &b_new);
+    if (b_new) {
+        /* first export of this sensor: define its name */
+        if ((data = sensor_desc_fullname(sample->desc, &size, NULL)) == NULL) {
+            data = SENSOR_DESC_LABEL(sample->desc);
+            size = strlen(data);
+        }
+        record.type = SENSOR_EXPORT_REC_NAME;
+        record.size = size > UINT16_MAX ? UINT16_MAX : size;
+        sensor_export_append(exporter, &record, sizeof(record));
+        sensor_export_append(exporter, data, record.size);
+        ++(exporter->n_records);
+    }
+    size = sensor_export_value_size(&(sample->value));
+    record.type = sample->value.type;
+    record.size = size > UINT16_MAX ? UINT16_MAX : size;
+    sensor_export_append(exporter, &record, sizeof(record));
+    sensor_export_append(exporter, SENSOR_VALUE_IS_BUFFER(sample->value.type)
+                                   ? (const void *) sample->value.data.b.buf
+                                   : (const void *) &(sample->value.data), record.size);
+    ++(exporter->n_records);
+}
+
+/* ************************************************************************ */
+/** write the iovecs, resuming after partial writes */
+static sensor_status_t sensor_export_writev(int fd, struct iovec * iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue ;
+            return SENSOR_ERROR;
+        }
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** export the samples of one update pass, given as a list or as an array */
+static sensor_status_t sensor_export_one(
+                            sensor_export_t *           exporter,
+                            const slist_t *             list,
+                            sensor_sample_t * const *   samples,
+                            unsigned int                n_samples) {
+    sensor_export_binheader_t   header;
+    struct iovec                iov[2];
+    struct timespec             ts;
+    char                        timestamp[32];
+    sensor_status_t             ret = SENSOR_SUCCESS;
+    int                         iovcnt = 0;
+
+    if (vclock_gettime(CLOCK_REALTIME, &ts) != 0) {
+        return SENSOR_ERROR;
+    }
+    pthread_mutex_lock(&(exporter->mutex));
+    exporter->size = 0;
+    exporter->error = 0;
+    exporter->n_records = 0;
+
+    if (exporter->format == SEF_LINE_PROTOCOL) {
+        snprintf(timestamp, sizeof(timestamp), "%" PRIu64,
+                 (uint64_t) ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec);
+        for (const slist_t * elt = list; elt != NULL; elt = elt->next) {
+            sensor_export_lineproto(exporter, elt->data, timestamp);
+        }
+        for (unsigned int i = 0; i < n_samples; ++i) {
+            sensor_export_lineproto(exporter, samples[i], timestamp);
+        }
+    } else {
+        for (const slist_t * elt = list; elt != NULL; elt = elt->next) {
+            sensor_export_binary(exporter, elt->data);
+        }
+        for (unsigned int i = 0; i < n_samples; ++i) {
+            sensor_export_binary(exporter, samples[i]);
+        }
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SENSOR_EXPORT_BIN_MAGIC, sizeof(header.magic));
+        header.version = SENSOR_EXPORT_BIN_VERSION;
+        header.flags = exporter->bin_flags;
+        header.header_size = sizeof(header);
+        header.byteorder = SENSOR_EXPORT_BYTEORDER;
+        header.n_records = exporter->n_records;
+        header.size = exporter->size;
+        header.time_ns = (uint64_t) ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+        iov[iovcnt].iov_base = &header;
+        iov[iovcnt++].iov_len = sizeof(header);
+    }
+    iov[iovcnt].iov_base = exporter->buf;
+    iov[iovcnt++].iov_len = exporter->size;
+
+    if (exporter->error) {
+        LOG_ERROR(exporter->sctx->log, "export: cannot serialize %u records", exporter->n_records);
+        ret = SENSOR_ERROR;
+    } else if (exporter->n_records > 0) {
+        if ((ret = sensor_export_writev(exporter->fd, iov, iovcnt)) != SENSOR_SUCCESS) {
+            LOG_ERROR(exporter->sctx->log, "export: cannot write %u records to fd %d: %s",
+                      exporter->n_records, exporter->fd, strerror(errno));
+        } else {
+            exporter->bin_flags &= ~SEBF_RESET;
+        }
+    }
+    pthread_mutex_unlock(&(exporter->mutex));
+    return ret;
+}
+
+/* ************************************************************************ */
+/** run the exporters of sctx, under read or write lock */
+static void sensor_export_run(
+                            sensor_ctx_t *              sctx,
+                            const slist_t *             list,
+                            sensor_sample_t * const *   samples,
+                            unsigned int                n_samples) {
+    SLIST_FOREACH_DATA(sctx->exporters, exporter, sensor_export_t *) {
+        sensor_export_one(exporter, list, samples, n_samples);
+    }
+}
+
+/* ************************************************************************ */
+/** forget the binary ids of exporters as descs are going to be freed, under write lock */
+static void sensor_export_reset(sensor_ctx_t * sctx) {
+    SLIST_FOREACH_DATA(sctx->exporters, exporter, sensor_export_t *) {
+        if (exporter->ids_count > 0) {
+            memset(exporter->ids, 0, exporter->ids_size * sizeof(*exporter->ids));
+            exporter->ids_count = 0;
+            exporter->bin_flags |= SEBF_RESET;
+        }
+    }
+}
+
+/* ************************************************************************ */
+static void sensor_export_free_one(void * vdata) {
+    sensor_export_t * exporter = (sensor_export_t *) vdata;
+
+    pthread_mutex_destroy(&(exporter->mutex));
+    if (exporter->buf != NULL)
+        free(exporter->buf);
+    if (exporter->ids != NULL)
+        free(exporter->ids);
+    free(exporter->measurement);
+    free(exporter);
+}
+
+/* ************************************************************************ */
+sensor_export_t * sensor_export_create(
+                        sensor_ctx_t *          sctx,
+                        int                     fd,
+                        sensor_export_format_t  format,
+                        const char *            measurement) {
+    sensor_export_t * exporter;
+    slist_t *         new;
+
+    if (sctx == NULL || fd < 0 || (format != SEF_LINE_PROTOCOL && format != SEF_BINARY)) {
+        return NULL;
+    }
+    if ((exporter = calloc(1, sizeof(*exporter))) == NULL) {
+        return NULL;
+    }
+    exporter->sctx = sctx;
+    exporter->fd = fd;
+    exporter->format = format;
+    exporter->bin_flags = SEBF_RESET;
+    if ((exporter->measurement = strdup(measurement != NULL
+                                        ? measurement : SENSOR_EXPORT_MEASUREMENT)) == NULL) {
+        free(exporter);
+        return NULL;
+    }
+    pthread_mutex_init(&(exporter->mutex), NULL);
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    if ((new = slist_prepend(sctx->exporters, exporter)) == NULL) {
+        sensor_unlock(sctx);
+        sensor_export_free_one(exporter);
+        return NULL;
+    }
+    sctx->exporters = new;
+    sensor_unlock(sctx);
+
+    LOG_VERBOSE(sctx->log, "exporter added (fd %d, %s)", fd,
+                format == SEF_LINE_PROTOCOL ? "line-protocol" : "binary");
+    return exporter;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_export_free(sensor_export_t * exporter) {
+    sensor_ctx_t * sctx;
+
+    if (exporter == NULL) {
+        return SENSOR_ERROR;
+    }
+    sctx = exporter->sctx;
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    sctx->exporters = slist_remove_ptr(sctx->exporters, exporter);
+    sensor_unlock(sctx);
+    sensor_export_free_one(exporter);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_stream_attach(sensor_ctx_t * sctx, sensor_stream_t * stream,
+                                     int b_attach) {
+    sensor_status_t ret = SENSOR_SUCCESS;
+    slist_t *       new;
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    if (!b_attach) {
+        sctx->streams = slist_remove_ptr(sctx->streams, stream);
+    } else if ((new = slist_prepend(sctx->streams, stream)) != NULL) {
+        sctx->streams = new;
+    } else {
+        ret = SENSOR_ERROR;
+    }
+    sensor_unlock(sctx);
+    return ret;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_dispatch_attach(sensor_ctx_t * sctx, sensor_dispatch_t * d) {
+    sensor_status_t ret = SENSOR_SUCCESS;
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    if (sctx->dispatcher != NULL) {
+        ret = SENSOR_ERROR;
+    } else {
+        sctx->dispatcher = d;
+    }
+    sensor_unlock(sctx);
+    return ret;
+}
+
+/* ************************************************************************ */
+sensor_dispatch_t * sensor_dispatch_detach(sensor_ctx_t * sctx) {
+    sensor_dispatch_t * d;
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    d = sctx->dispatcher;
+    sctx->dispatcher = NULL;
+    sensor_unlock(sctx);
+    return d;
+}
+
+/* ************************************************************************ */
+void sensor_stream_mirror_attach(sensor_ctx_t * sctx, sensor_stream_mirror_t * mirror) {
+    sctx->mirror = mirror;
+}
+
+/* ************************************************************************
+ * SENSOR RENDER : OpenMetrics text exposition of the watched samples.
+ * The '<metric>{labels} ' prefix of each desc is rendered once and cached
+ * in its interned name, published atomically as renders run under read lock.
+ * ************************************************************************ */
+
+#define SENSOR_RENDER_METRIC    "sensors"
+
+typedef struct {
+    char *          buf;
+    size_t          cap;    /* usable bytes, without terminating 0 */
+    size_t          len;    /* total length, can be greater than cap */
+} sensor_render_t;
+
+/* ************************************************************************ */
+static inline void sensor_render_append(sensor_render_t * render, const char * str, size_t len) {
+    if (render->len < render->cap) {
+        size_t room = render->cap - render->len;
+        memcpy(render->buf + render->len, str, len < room ? len : room);
+    }
+    render->len += len;
+}
+
+/* ************************************************************************ */
+/** append an OpenMetrics label value: '\', '"' and newline are escaped */
+static void sensor_render_escaped(sensor_render_t * render, const char * str, size_t len) {
+    const char * start = str, * end = str + len;
+
+    for ( ; str < end && *str != 0; ++str) {
+        if (*str == '\\' || *str == '"' || *str == '\n') {
+            sensor_render_append(render, start, str - start);
+            sensor_render_append(render, *str == '\n' ? "\\n" : *str == '"' ? "\\\"" : "\\\\", 2);
+            start = str + 1;
+        }
+    }
+    sensor_render_append(render, start, str - start);
+}
+
+/* ************************************************************************ */
+/** append a label name, invalid characters replaced by '_' */
+static void sensor_render_labelname(sensor_render_t * render, const char * name) {
+    for (const char * it = name; *it != 0; ++it) {
+        char c = *it;
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'
+              || (c >= '0' && c <= '9' && it != name)))
+            c = '_';
+        sensor_render_append(render, &c, 1);
+    }
+}
+
+/* ************************************************************************ */
+/** 'sensors{family="<fam>",label="<label>"[,<prop>="<value>"...]} ' */
+static void sensor_render_prefix(sensor_render_t * render, const sensor_desc_t * desc) {
+    const char *    str;
+    char            value[256];
+    int             len;
+
+    sensor_render_append(render, SENSOR_RENDER_METRIC "{family=\"",
+                         sizeof(SENSOR_RENDER_METRIC "{family=\"") - 1);
+    str = SENSOR_DESC_FAMNAME(desc);
+    sensor_render_escaped(render, str, strlen(str));
+    sensor_render_append(render, "\",label=\"", 9);
+    str = SENSOR_DESC_LABEL(desc);
+    sensor_render_escaped(render, str, strlen(str));
+    sensor_render_append(render, "\"", 1);
+
+    for (const sensor_property_t * property = desc->properties;
+            SENSOR_PROPERTY_VALID(property); ++property) {
+        if (property->name == NULL
+        ||  (len = sensor_value_tostring(&(property->value), value, sizeof(value))) < 0)
+            continue ;
+        sensor_render_append(render, ",", 1);
+        sensor_render_labelname(render, property->name);
+        sensor_render_append(render, "=\"", 2);
+        sensor_render_escaped(render, value, (size_t) len < sizeof(value) ? (size_t) len
+                                                                          : sizeof(value) - 1);
+        sensor_render_append(render, "\"", 1);
+    }
+    sensor_render_append(render, "} ", 2);
+}
+
+/* ************************************************************************ */
+/** get the cached prefix of desc, rendering it on first use */
+static const char * sensor_render_getprefix(const sensor_desc_t * desc, size_t * p_len) {
+    struct sensor_name_s *  name = (struct sensor_name_s *) desc->fullname;
+    char *                  prefix, * expected = NULL;
+    sensor_render_t         render = { .buf = NULL, .cap = 0, .len = 0 };
+
+    if (name == NULL) {
+        return NULL;
+    }
+    if ((prefix = __atomic_load_n(&(name->render_prefix), __ATOMIC_ACQUIRE)) != NULL) {
+        *p_len = name->render_len;
+        return prefix;
+    }
+    /* measure, then render */
+    sensor_render_prefix(&render, desc);
+    if ((render.buf = malloc(render.len + 1)) == NULL) {
+        return NULL;
+    }
+    render.cap = render.len;
+    render.len = 0;
+    sensor_render_prefix(&render, desc);
+    render.buf[render.len] = 0;
+
+    name->render_len = render.len;
+    if (!__atomic_compare_exchange_n(&(name->render_prefix), &expected, render.buf, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        /* another thread was faster */
+        free(render.buf);
+        prefix = expected;
+    } else {
+        prefix = render.buf;
+    }
+    *p_len = name->render_len;
+    return prefix;
+}
+
+/* ************************************************************************ */
+static AVLTREE_DECLARE_VISITFUN(sensor_render_visit, node_data, context, user_data) {
+    const sensor_sample_t * sample  = (const sensor_sample_t *) node_data;
+    const sensor_value_t *  value   = &(sample->value);
+    sensor_render_t *       render  = (sensor_render_t *) user_data;
+    const char *            prefix;
+    char                    str[64];
+    size_t                  len;
+    int                     n;
+    (void) context;
+
+    if (SENSOR_VALUE_IS_BUFFER(value->type) || value->type == SENSOR_VALUE_NULL
+    ||  sample->desc->properties == s_sensor_loading_properties
+    ||  sample->desc->label == s_sensor_loading_label
+    ||  (prefix = sensor_render_getprefix(sample->desc, &len)) == NULL) {
+        return AVS_CONTINUE;
+    }
+    if (SENSOR_VALUE_IS_FLOATING(value->type)) {
+        long double d = sensor_value_todouble(value);
+        if (isnan(d))
+            n = snprintf(str, sizeof(str), "NaN");
+        else if (isinf(d))
+            n = snprintf(str, sizeof(str), d < 0 ? "-Inf" : "+Inf");
+        else
+            n = snprintf(str, sizeof(str), "%.*Lg",
+                         value->type == SENSOR_VALUE_FLOAT ? FLT_DIG : DBL_DIG, d);
+    } else if (value->type == SENSOR_VALUE_UINT64 || value->type == SENSOR_VALUE_ULONG) {
+        n = snprintf(str, sizeof(str), "%" PRIu64,
+                     value->type == SENSOR_VALUE_ULONG ? (uint64_t) value->data.ul : value->data.u64);
+    } else {
+        n = snprintf(str, sizeof(str), "%" PRIdMAX, sensor_value_toint(value));
+    }
+    if (n <= 0 || (size_t) n >= sizeof(str)) {
+        return AVS_CONTINUE;
+    }
+    str[n++] = '\n';
+    sensor_render_append(render, prefix, len);
+    sensor_render_append(render, str, n);
+
+    return AVS_CONTINUE;
+}
+
+/* ************************************************************************ */
+int sensor_render_openmetrics(sensor_ctx_t * sctx, char * buf, size_t cap) {
+    static const char   header[] = "# TYPE " SENSOR_RENDER_METRIC " gauge\n";
+    static const char   footer[] = "# EOF\n";
+    sensor_render_t     render = { .buf = buf, .cap = cap > 0 ? cap - 1 : 0, .len = 0 };
+
+    if (sctx == NULL || (buf == NULL && cap > 0)) {
+        return -1;
+    }
+    sensor_render_append(&render, header, sizeof(header) - 1);
+
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    if (avltree_visit(sctx->watchs, sensor_render_visit, &render, AVH_INFIX) == AVS_ERROR) {
+        sensor_unlock(sctx);
+        return -1;
+    }
+    sensor_unlock(sctx);
+
+    sensor_render_append(&render, footer, sizeof(footer) - 1);
+    if (cap > 0) {
+        buf[render.len < render.cap ? render.len : render.cap] = 0;
+    }
+    return render.len > INT_MAX ? -1 : (int) render.len;
+}
+
+/* ************************************************************************
+ * SENSOR SNAPSHOT : copy of the watched values into a caller-owned flat
+ * buffer, under write lock. Strings and bytes are packed in a bytes area,
+ * names are given ids by the snapshot, by name so that they survive reloads.
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+/** grow *pbuf to hold at least size elements of elt_size, -1 on error */
+static int sensor_snapshot_grow(void ** pbuf, size_t * pmax, size_t size, size_t elt_size) {
+    size_t  max = *pmax == 0 ? 64 : *pmax;
+    void *  buf;
+
+    if (size <= *pmax) {
+        return 0;
+    }
+    while (max < size)
+        max *= 2;
+    if ((buf = realloc(*pbuf, max * elt_size)) == NULL) {
+        return -1;
+    }
+    *pbuf = buf;
+    *pmax = max;
+    return 0;
+}
+
+/* ************************************************************************ */
+/** get the id of desc name, or give it a new one, -1 on error */
+static long sensor_snapshot_id(sensor_snapshot_t * snap, const sensor_desc_t * desc) {
+    const char *    name;
+    size_t          len;
+    unsigned int    hash, mask, i;
+    uint32_t        id;
+
+    if ((name = sensor_desc_fullname(desc, &len, &hash)) == NULL) {
+        return -1;
+    }
+    if (snap->n_ids >= snap->ids_size / 2) {
+        /* ids: pairs of id + 1 and name hash */
+        unsigned int    size = snap->ids_size == 0 ? 256 : snap->ids_size * 2;
+        uint32_t *      ids;
+
+        if ((ids = calloc(size, 2 * sizeof(*ids))) == NULL) {
+            return -1;
+        }
+        for (unsigned int j = 0; j < snap->ids_size; ++j) {
+            if (snap->ids[2 * j] == 0)
+                continue ;
+            for (i = snap->ids[2 * j + 1] & (size - 1); ids[2 * i] != 0; i = (i + 1) & (size - 1))
+                ; /* nothing but loop */
+            ids[2 * i] = snap->ids[2 * j];
+            ids[2 * i + 1] = snap->ids[2 * j + 1];
+        }
+        if (snap->ids != NULL)
+            free(snap->ids);
+        snap->ids = ids;
+        snap->ids_size = size;
+    }
+    mask = snap->ids_size - 1;
+    for (i = hash & mask; snap->ids[2 * i] != 0; i = (i + 1) & mask) {
+        const char * idname = snap->names + snap->name_offsets[snap->ids[2 * i] - 1];
+
+        if (snap->ids[2 * i + 1] == hash && strncmp(idname, name, len) == 0 && idname[len] == 0)
+            return snap->ids[2 * i] - 1;
+    }
+    if (sensor_snapshot_grow((void **) &(snap->name_offsets), &(snap->name_offsets_max),
+                             snap->n_ids + 1, sizeof(*snap->name_offsets)) != 0
+    ||  sensor_snapshot_grow((void **) &(snap->names), &(snap->names_max),
+                             snap->names_size + len + 1, 1) != 0) {
+        return -1;
+    }
+    memcpy(snap->names + snap->names_size, name, len);
+    snap->names[snap->names_size + len] = 0;
+    id = snap->n_ids++;
+    snap->name_offsets[id] = snap->names_size;
+    snap->names_size += len + 1;
+    snap->ids[2 * i] = id + 1;
+    snap->ids[2 * i + 1] = hash;
+
+    return id;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_snapshot_take(sensor_ctx_t * sctx, sensor_snapshot_t * snap) {
+    size_t          max_entries;
+    sensor_status_t ret = SENSOR_SUCCESS;
+
+    if (sctx == NULL || snap == NULL) {
+        return SENSOR_ERROR;
+    }
+    snap->count = 0;
+    snap->bytes_size = 0;
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    sensor_now_ns(sctx, &(snap->time_ns));
+    max_entries = snap->max_entries;
+    if (sensor_snapshot_grow((void **) &(snap->entries), &max_entries,
+                             slist_length(sctx->watchlist), sizeof(*snap->entries)) != 0) {
+        sensor_unlock(sctx);
+        return SENSOR_ERROR;
+    }
+    snap->max_entries = max_entries;
+    SLIST_FOREACH_DATA(sctx->watchlist, sample, sensor_sample_t *) {
+        sensor_snapshot_entry_t *   entry;
+        long                        id;
+
+        if (sample->desc->properties == s_sensor_loading_properties
+        ||  sample->desc->label == s_sensor_loading_label) {
+            continue ;
+        }
+        if ((id = sensor_snapshot_id(snap, sample->desc)) < 0) {
+            ret = SENSOR_ERROR;
+            break ;
+        }
+        entry = &(snap->entries[snap->count]);
+        entry->id = id;
+        entry->reserved = 0;
+        entry->time_ns = sample->acquired_ns;
+        entry->value = sample->value;
+        if (SENSOR_VALUE_IS_BUFFER(sample->value.type)) {
+            const sensor_value_t *  value = &(sample->value);
+            size_t                  size = value->data.b.buf == NULL ? 0
+                                           : value->type == SENSOR_VALUE_STRING
+                                             ? strnlen(value->data.b.buf, value->data.b.size)
+                                             : value->data.b.size;
+
+            if (sensor_snapshot_grow((void **) &(snap->bytes), &(snap->bytes_max),
+                                     snap->bytes_size + size + 1, 1) != 0) {
+                ret = SENSOR_ERROR;
+                break ;
+            }
+            if (size > 0)
+                memcpy(snap->bytes + snap->bytes_size, value->data.b.buf, size);
+            snap->bytes[snap->bytes_size + size] = 0;
+            /* offset until the bytes area is complete */
+            entry->value.data.b.buf = (char *) (uintptr_t) snap->bytes_size;
+            entry->value.data.b.size = entry->value.data.b.maxsize = size;
+            snap->bytes_size += size + 1;
+        }
+        ++(snap->count);
+    }
+    sensor_unlock(sctx);
+
+    for (unsigned int i = 0; i < snap->count; ++i) {
+        sensor_snapshot_entry_t * entry = &(snap->entries[i]);
+
+        if (SENSOR_VALUE_IS_BUFFER(entry->value.type)) {
+            entry->value.data.b.buf = snap->bytes + (uintptr_t) entry->value.data.b.buf;
+        }
+    }
+    return ret;
+}
+
+/* ************************************************************************ */
+const char * sensor_snapshot_name(const sensor_snapshot_t * snap, uint32_t id) {
+    if (snap == NULL || id >= snap->n_ids) {
+        return NULL;
+    }
+    return snap->names + snap->name_offsets[id];
+}
+
+/* ************************************************************************ */
+void sensor_snapshot_free(sensor_snapshot_t * snap) {
+    if (snap == NULL) {
+        return ;
+    }
+    if (snap->entries != NULL)
+        free(snap->entries);
+    if (snap->bytes != NULL)
+        free(snap->bytes);
+    if (snap->names != NULL)
+        free(snap->names);
+    if (snap->name_offsets != NULL)
+        free(snap->name_offsets);
+    if (snap->ids != NULL)
+        free(snap->ids);
+    *snap = SENSOR_SNAPSHOT_INITIALIZER;
+}
+
+/* ************************************************************************
+ * SENSOR SHARED MEMORY : publication of watched values in a mmap'd file
+ * read by other processes without syscalls. Each slot has a seqlock, odd
+ * while the publisher writes it. Slots are given to '<family>/<label>' names
+ * on their first update and never reused, so readers can cache slot indexes.
+ * Slots are written by the update passes (a sample is updated by one thread
+ * at a time), slot allocation is serialized by the publisher mutex.
+ * ************************************************************************ */
+
+#define SENSOR_SHM_MAGIC        "VSSH"
+#define SENSOR_SHM_VERSION      1
+#define SENSOR_SHM_BYTEORDER    0x01020304U
+#define SENSOR_SHM_DATA_SIZE    40
+#define SENSOR_SHM_NAME_AVG     48      /* average name size used to size names area */
+#define SENSOR_SHM_READ_RETRIES 100000
+
+typedef struct {
+    char            magic[4];
+    uint32_t        version;
+    uint32_t        byteorder;
+    uint32_t        header_size;
+    uint32_t        slot_size;
+    uint32_t        max_slots;
+    uint32_t        n_slots;        /* published slots, written with release semantics */
+    uint32_t        names_offset;   /* from beginning of segment */
+    uint32_t        names_size;
+    uint32_t        names_used;
+    uint32_t        pid;            /* publisher pid, 0 when stopped */
+    uint32_t        reserved[5];
+} sensor_shm_header_t;
+
+typedef struct {
+    uint32_t        seq;            /* seqlock: odd while being written */
+    uint32_t        name_offset;    /* from names area */
+    uint32_t        name_len;
+    uint16_t        type;           /* sensor_value_type_t */
+    uint16_t        size;           /* bytes used in data */
+    uint64_t        time_ns;        /* acquisition time (sctx clock, see sensor_now_ns()) */
+    unsigned char   data[SENSOR_SHM_DATA_SIZE];
+} sensor_shm_slot_t;
+
+struct sensor_shm_s {
+    sensor_shm_header_t *   header;
+    sensor_shm_slot_t *     slots;
+    char *                  names;
+    size_t                  map_size;
+    uint32_t                max_slots;  /* validated when mapped, bounds header->n_slots */
+    /* publisher only */
+    int                     fd;
+    char *                  path;
+    pthread_mutex_t         mutex;
+    uint32_t *              table;      /* hash table of slot index + 1, by name */
+    unsigned int            table_size; /* power of 2 */
+};
+
+/* ************************************************************************ */
+/** check a mapped segment, for the reader */
+static sensor_status_t sensor_shm_check(const sensor_shm_header_t * header, size_t size) {
+    size_t slots_end;
+
+    if (size < sizeof(*header)
+    ||  memcmp(header->magic, SENSOR_SHM_MAGIC, sizeof(header->magic)) != 0
+    ||  header->version != SENSOR_SHM_VERSION
+    ||  header->byteorder != SENSOR_SHM_BYTEORDER
+    ||  header->header_size != sizeof(*header)
+    ||  header->slot_size != sizeof(sensor_shm_slot_t)) {
+        return SENSOR_ERROR;
+    }
+    slots_end = sizeof(*header) + (size_t) header->max_slots * sizeof(sensor_shm_slot_t);
+    if (header->names_offset < slots_end || header->names_offset > size
+    ||  header->names_size > size - header->names_offset) {
+        return SENSOR_ERROR;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** get or allocate the slot of desc, -1 if full */
+static long sensor_shm_slot(sensor_shm_t * shm, const sensor_desc_t * desc) {
+    unsigned int            hash, mask = shm->table_size - 1, i;
+    size_t                  len;
+    const char *            name;
+    sensor_shm_header_t *   header = shm->header;
+    sensor_shm_slot_t *     slot;
+    uint32_t                n_slots;
+
+    if ((name = sensor_desc_fullname(desc, &len, &hash)) == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&(shm->mutex));
+    for (i = hash & mask; shm->table[i] != 0; i = (i + 1) & mask) {
+        slot = &(shm->slots[shm->table[i] - 1]);
+        if (slot->name_len == len && memcmp(shm->names + slot->name_offset, name, len) == 0) {
+            pthread_mutex_unlock(&(shm->mutex));
+            return shm->table[i] - 1;
+        }
+    }
+    n_slots = header->n_slots;
+    if (n_slots >= header->max_slots || len + 1 > header->names_size - header->names_used) {
+        pthread_mutex_unlock(&(shm->mutex));
+        return -1;
+    }
+    slot = &(shm->slots[n_slots]);
+    memcpy(shm->names + header->names_used, name, len);
+    shm->names[header->names_used + len] = 0;
+    slot->name_offset = header->names_used;
+    slot->name_len = len;
+    slot->type = SENSOR_VALUE_NULL;
+    header->names_used += len + 1;
+    shm->table[i] = n_slots + 1;
+    /* slot and its name are complete before readers can see it */
+    __atomic_store_n(&(header->n_slots), n_slots + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&(shm->mutex));
+
+    return n_slots;
+}
+
+/* ************************************************************************ */
+static void sensor_shm_put(sensor_shm_t * shm, const sensor_sample_t * sample,
+                           const struct timeval * now) {
+    const sensor_value_t *  value = &(sample->value);
+    sensor_shm_slot_t *     slot;
+    uint32_t                seq;
+    size_t                  size;
+    long                    idx;
+
+    if (sample->desc->properties == s_sensor_loading_properties
+    ||  sample->desc->label == s_sensor_loading_label
+    ||  (idx = sensor_shm_slot(shm, sample->desc)) < 0) {
+        return ;
+    }
+    slot = &(shm->slots[idx]);
+    seq = __atomic_load_n(&(slot->seq), __ATOMIC_RELAXED);
+    __atomic_store_n(&(slot->seq), seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->type = value->type;
+    slot->time_ns = sample->acquired_ns != 0 ? sample->acquired_ns
+                    : (uint64_t) now->tv_sec * UINT64_C(1000000000) + now->tv_usec * 1000;
+    if (SENSOR_VALUE_IS_BUFFER(value->type)) {
+        size = value->data.b.buf == NULL ? 0 : value->type == SENSOR_VALUE_STRING
+               ? strnlen(value->data.b.buf, value->data.b.size) : value->data.b.size;
+        if (size > sizeof(slot->data) - 1)
+            size = sizeof(slot->data) - 1;
+        if (size > 0)
+            memcpy(slot->data, value->data.b.buf, size);
+        slot->data[size] = 0;
+    } else {
+        size = sizeof(value->data);
+        memcpy(slot->data, &(value->data), size);
+    }
+    slot->size = size;
+
+    __atomic_store_n(&(slot->seq), seq + 2, __ATOMIC_RELEASE);
+}
+
+/* ************************************************************************ */
+static void sensor_shm_free_one(sensor_shm_t * shm) {
+    if (shm->header != NULL) {
+        if (shm->fd >= 0)
+            __atomic_store_n(&(shm->header->pid), 0, __ATOMIC_RELEASE);
+        munmap(shm->header, shm->map_size);
+    }
+    if (shm->fd >= 0) {
+        close(shm->fd);
+        pthread_mutex_destroy(&(shm->mutex));
+    }
+    if (shm->table != NULL)
+        free(shm->table);
+    if (shm->path != NULL)
+        free(shm->path);
+    free(shm);
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_shm_publish(sensor_ctx_t * sctx, const char * path, unsigned int max_slots) {
+    sensor_shm_t *  shm;
+    size_t          names_size, names_offset;
+    char *          tmp_path = NULL;
+
+    if (sctx == NULL) {
+        return SENSOR_ERROR;
+    }
+    /* stop previous publication */
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    shm = sctx->publisher;
+    sctx->publisher = NULL;
+    sensor_unlock(sctx);
+    if (shm != NULL) {
+        LOG_VERBOSE(sctx->log, "stopping publication to '%s'", shm->path);
+        sensor_shm_free_one(shm);
+    }
+    if (path == NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if (max_slots == 0 || max_slots > (UINT32_MAX / 2) / (sizeof(sensor_shm_slot_t)
+                                                         + SENSOR_SHM_NAME_AVG)) {
+        return SENSOR_ERROR;
+    }
+
+    if ((shm = calloc(1, sizeof(*shm))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    shm->fd = -1;
+    names_offset = sizeof(sensor_shm_header_t) + max_slots * sizeof(sensor_shm_slot_t);
+    names_size = max_slots * SENSOR_SHM_NAME_AVG;
+    shm->map_size = names_offset + names_size;
+    for (shm->table_size = 64; shm->table_size < 2 * max_slots; shm->table_size *= 2)
+        ; /* nothing but loop */
+
+    /* the segment is built in a new file renamed over path: readers of a previous
+     * segment keep their mapping, which truncating it would turn into SIGBUS */
+    if ((shm->path = strdup(path)) == NULL
+    ||  (shm->table = calloc(shm->table_size, sizeof(*shm->table))) == NULL
+    ||  (tmp_path = malloc(strlen(path) + sizeof(".XXXXXX"))) == NULL
+    ||  sprintf(tmp_path, "%s.XXXXXX", path) < 0
+    ||  (shm->fd = mkstemp(tmp_path)) < 0
+    ||  fchmod(shm->fd, 0644) != 0
+    ||  ftruncate(shm->fd, shm->map_size) != 0
+    ||  (shm->header = mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            shm->fd, 0)) == MAP_FAILED) {
+        LOG_ERROR(sctx->log, "cannot publish to '%s': %s", path, strerror(errno));
+        if (shm->header == MAP_FAILED)
+            shm->header = NULL;
+        if (shm->fd >= 0) {
+            close(shm->fd);
+            shm->fd = -1;
+            unlink(tmp_path);
+        }
+        if (tmp_path != NULL)
+            free(tmp_path);
+        sensor_shm_free_one(shm);
+        return SENSOR_ERROR;
+    }
+    pthread_mutex_init(&(shm->mutex), NULL);
+    shm->slots = (sensor_shm_slot_t *) (shm->header + 1);
+    shm->names = (char *) shm->header + names_offset;
+
+    memcpy(shm->header->magic, SENSOR_SHM_MAGIC, sizeof(shm->header->magic));
+    shm->header->version = SENSOR_SHM_VERSION;
+    shm->header->byteorder = SENSOR_SHM_BYTEORDER;
+    shm->header->header_size = sizeof(sensor_shm_header_t);
+    shm->header->slot_size = sizeof(sensor_shm_slot_t);
+    shm->header->max_slots = max_slots;
+    shm->header->names_offset = names_offset;
+    shm->header->names_size = names_size;
+    shm->header->pid = getpid();
+    shm->max_slots = max_slots;
+
+    if (rename(tmp_path, path) != 0) {
+        LOG_ERROR(sctx->log, "cannot publish to '%s': %s", path, strerror(errno));
+        unlink(tmp_path);
+        free(tmp_path);
+        sensor_shm_free_one(shm);
+        return SENSOR_ERROR;
+    }
+    free(tmp_path);
+
+    sensor_lock(sctx, SENSOR_LOCK_WRITE);
+    sctx->publisher = shm;
+    sensor_unlock(sctx);
+    LOG_VERBOSE(sctx->log, "publishing up to %u values to '%s'", max_slots, path);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_shm_t * sensor_shm_open(const char * path) {
+    sensor_shm_t *  shm;
+    struct stat     st;
+    int             fd;
+    void *          map;
 
-    if (sctx == NULL) {
+    if (path == NULL || (fd = open(path, O_RDONLY)) < 0) {
         return NULL;
     }
-    result = sctx->watchlist;
-
-    return result;
-}
-
-/* ************************************************************************ */
-unsigned long sensor_watch_timerms(sensor_sample_t * sample) {
-    if (sample == NULL) {
-        errno = EFAULT;
-        return 0UL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(sensor_shm_header_t)
+    ||  (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return NULL;
     }
-    return sample->watch->update_interval.tv_sec * 1000UL
-           + sample->watch->update_interval.tv_usec / 1000UL;
+    close(fd);
+    if (sensor_shm_check(map, st.st_size) != SENSOR_SUCCESS
+    ||  (shm = calloc(1, sizeof(*shm))) == NULL) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    shm->fd = -1;
+    shm->header = map;
+    shm->map_size = st.st_size;
+    shm->max_slots = shm->header->max_slots;
+    shm->slots = (sensor_shm_slot_t *) (shm->header + 1);
+    shm->names = (char *) map + shm->header->names_offset;
+
+    return shm;
 }
 
-
 /* ************************************************************************ */
-void sensor_watch_free(sensor_ctx_t *sctx) {
-    if (sctx == NULL) {
-        return ;
+void sensor_shm_close(sensor_shm_t * shm) {
+    if (shm != NULL && shm->fd < 0) {
+        sensor_shm_free_one(shm);
     }
-    sensor_lock(sctx, SENSOR_LOCK_WRITE);
-    avltree_clear(sctx->watchs);
-    slist_free(sctx->watchlist, sensor_watch_free_one);
-    sctx->watchlist = NULL;
-    avltree_clear(sctx->watch_params);
-    sensor_unlock(sctx);
 }
 
 /* ************************************************************************ */
-typedef struct {
-    sensor_ctx_t *  sctx;
-    unsigned long   pgcd;
-    double *        p_precision;
-    double          min_precision;
-} sensor_watchpgcd_visit_t;
-static AVLTREE_DECLARE_VISITFUN(sensor_watchpgcd_visit, node_data, context, user_data) {
-    sensor_watchparam_entry_t * watchparam = (sensor_watchparam_entry_t *) node_data;
-    sensor_watchpgcd_visit_t *  data = (sensor_watchpgcd_visit_t *) user_data;
-    (void) context;
-
-    unsigned long interval_ms = watchparam->watch.update_interval.tv_sec * 1000
-                              + watchparam->watch.update_interval.tv_usec / 1000;
-
-    data->pgcd = pgcd_rounded(data->pgcd, interval_ms, data->p_precision, data->min_precision);
-
-    LOG_DEBUG(data->sctx->log, "loop. new pgcd=%lu, current=%lu, precision=%f",
-              data->pgcd, interval_ms, *(data->p_precision));
+unsigned int sensor_shm_count(const sensor_shm_t * shm) {
+    uint32_t n_slots;
 
-    return AVS_CONTINUE;
+    if (shm == NULL) {
+        return 0;
+    }
+    /* n_slots is not trusted: slots were checked to be mapped up to max_slots */
+    n_slots = __atomic_load_n(&(shm->header->n_slots), __ATOMIC_ACQUIRE);
+    return n_slots < shm->max_slots ? n_slots : shm->max_slots;
 }
 
 /* ************************************************************************ */
-unsigned long sensor_watch_pgcd(sensor_ctx_t *sctx,
-                                double * p_precision, double min_precision) {
-    double                      precision;
-    sensor_watchpgcd_visit_t    data;
-    int                         ret;
+const char * sensor_shm_name(const sensor_shm_t * shm, unsigned int idx) {
+    const sensor_shm_slot_t * slot;
 
-    if (sctx == NULL) {
-        return 0;
-    }
-    if (p_precision == NULL) {
-        precision = 1.0L;
-        p_precision = &precision;
-        min_precision = 1.0L;
-    }
-    if (min_precision <= 0.0L) {
-        min_precision = 1.0L;
+    if (idx >= sensor_shm_count(shm)) {
+        return NULL;
     }
-    if (*p_precision <= 0.0L) {
-        *p_precision = 1.0L;
+    slot = &(shm->slots[idx]);
+    if (slot->name_offset >= shm->header->names_size
+    ||  slot->name_len >= shm->header->names_size - slot->name_offset) {
+        return NULL;
     }
-    data.p_precision = p_precision;
-    data.min_precision = min_precision;
-    data.pgcd = 0;
-    data.sctx = sctx;
-
-    sensor_lock(sctx, SENSOR_LOCK_READ);
-
-    ret = avltree_visit(sctx->watch_params, sensor_watchpgcd_visit, &data, AVH_INFIX | AVH_RIGHT);
+    return shm->names + slot->name_offset;
+}
 
-    LOG_DEBUG(sctx->log, "END. pgcd=%lu, precision=%f, ret=%d",
-              data.pgcd, *(data.p_precision), ret);
+/* ************************************************************************ */
+int sensor_shm_find(const sensor_shm_t * shm, const char * name) {
+    unsigned int    count = sensor_shm_count(shm);
+    size_t          len;
 
-    if (ret != AVS_FINISHED) {
-        LOG_WARN(sctx->log, "watch_params tree pgcd error");
+    if (name == NULL) {
+        return -1;
     }
-
-    sensor_unlock(sctx);
-
-    return data.pgcd;
+    len = strlen(name);
+    for (unsigned int idx = 0; idx < count; ++idx) {
+        const char * slot_name = sensor_shm_name(shm, idx);
+        if (slot_name != NULL && shm->slots[idx].name_len == len
+        &&  memcmp(slot_name, name, len) == 0)
+            return idx;
+    }
+    return -1;
 }
 
 /* ************************************************************************ */
-sensor_status_t sensor_watch_save(slist_t * watch_list, const char * path) {
-    (void)watch_list;
-    (void)path;
-    return SENSOR_NOT_SUPPORTED;
-}
+sensor_status_t sensor_shm_read(const sensor_shm_t *    shm,
+                                unsigned int            idx,
+                                sensor_value_t *        value,
+                                struct timeval *        time) {
+    const sensor_shm_slot_t *   slot;
+    sensor_shm_slot_t           copy;
+    uint32_t                    seq;
+
+    if (value == NULL || idx >= sensor_shm_count(shm)) {
+        return SENSOR_ERROR;
+    }
+    slot = &(shm->slots[idx]);
+    for (unsigned int retries = 0; ; ++retries) {
+        if (retries >= SENSOR_SHM_READ_RETRIES) {
+            /* publisher stopped while writing, or too many concurrent updates */
+            errno = EAGAIN;
+            return SENSOR_ERROR;
+        }
+        if (((seq = __atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE)) & 1) != 0)
+            continue ; /* being written */
+        memcpy(&copy, slot, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&(slot->seq), __ATOMIC_RELAXED) == seq)
+            break ;
+    }
 
-/* ************************************************************************ */
-const slist_t * sensor_watch_load(const char * path) {
-    (void)path;
-    return NULL;
+    if (copy.type == SENSOR_VALUE_NULL || copy.type >= SENSOR_VALUE_NB) {
+        return SENSOR_LOADING;
+    }
+    if (SENSOR_VALUE_IS_BUFFER(copy.type)) {
+        if (value->type != copy.type || value->data.b.buf == NULL
+        ||  value->data.b.maxsize < copy.size + (unsigned int) (copy.type == SENSOR_VALUE_STRING)
+        ||  copy.size >= sizeof(copy.data)) {
+            return SENSOR_ERROR;
+        }
+        memcpy(value->data.b.buf, copy.data, copy.size + (copy.type == SENSOR_VALUE_STRING));
+        value->data.b.size = copy.size;
+    } else {
+        value->type = copy.type;
+        memcpy(&(value->data), copy.data, sizeof(value->data));
+    }
+    if (time != NULL) {
+        time->tv_sec = copy.time_ns / UINT64_C(1000000000);
+        time->tv_usec = (copy.time_ns % UINT64_C(1000000000)) / 1000;
+    }
+    return SENSOR_SUCCESS;
 }
 
-
 /* ************************************************************************
  * SENSOR_UPDATE FUNCTIONS
  * ************************************************************************ */
@@ -1963,6 +5427,8 @@ slist_t * sensor_family_loading_list(sensor_family_t * family) {
     desc->family = family;
     desc->properties = NULL;
     desc->key = NULL; /* NULL pattern will never match */;
+    desc->fullname = NULL;
+    desc->ops = sensor_value_ops(desc->type);
 
     return slist_prepend(NULL, desc);
 }
@@ -2004,6 +5470,9 @@ static sensor_status_t sensor_family_reload_visit(sensor_sample_t * sample, void
                 strdup(STR_CHECKNULL(((sensor_loadinginfo_t *)sample->desc->key)->pattern));
             new->id = ((sensor_loadinginfo_t *)sample->desc->key)->id;
         }
+    } else if (sample->desc->fullname != NULL) {
+        new->pattern = strdup(sample->desc->fullname->name);
+        new->id = 0;
     } else {
         char * pattern = NULL;
         if (asprintf(&pattern, "%s/%s", SENSOR_DESC_FAMNAME(sample->desc),
@@ -2028,31 +5497,19 @@ static sensor_status_t sensor_family_reload_visit(sensor_sample_t * sample, void
 }
 
 /* ************************************************************************ */
-static sensor_status_t sensor_family_reload(
-                            sensor_family_t *       family) {
-    char                        pattern[SENSOR_LABEL_SIZE];
-    sensor_family_reload_t *    data = NULL;
-
-    snprintf(pattern, sizeof(pattern) / sizeof(*pattern), "%s/*", family->info->name);
-
-    /* keep the watched sensors and their watch parameters, then un-watch them
-     * (they are patterns, they must be expanded with sensor_watch_add_unlocked) */
-    sensor_watch_find_unlocked(family->sctx, pattern, SSF_DEFAULT, NULL,
-                               sensor_family_reload_visit, &data);
-    sensor_watch_del(family->sctx, pattern, SSF_DEFAULT);
-
-    /* ask family for a new list of <sensor_desc_t *> */
-    sensor_family_list_sensors(family, NULL);
-
-    /* re-add the previous watches, hopefully some sensors will match this time
-     * and free the 'fake' descs */
+/** re-add the watches backed up by sensor_family_reload_visit() on the matching
+ * descs of the given list, and free the backup */
+static void sensor_family_reload_restore(
+                            sensor_family_t *           family,
+                            sensor_family_reload_t *    data,
+                            slist_t *                   descs) {
     while (data != NULL) {
         sensor_desc_match_t         matchdata;
         sensor_family_reload_t *    to_free = data;
         data = data->next;
         if (to_free->pattern != NULL
         && sensor_desc_match_get(&matchdata, to_free->pattern, SSF_DEFAULT) == SENSOR_SUCCESS) {
-            SLIST_FOREACH_DATA(family->sctx->sensorlist, desc, sensor_desc_t *) {
+            SLIST_FOREACH_DATA(descs, desc, sensor_desc_t *) {
                 if (to_free->family == desc->family
                 &&  sensor_desc_match_unlocked(desc, &matchdata)) {
                     LOG_DEBUG(family->sctx->log, "%s(): RESTORE family %s, pattern:%s",
@@ -2065,6 +5522,180 @@ static sensor_status_t sensor_family_reload(
         }
         free(to_free);
     }
+}
+
+/* ************************************************************************ */
+static inline int sensor_desc_list_has(const slist_t * descs, const sensor_desc_t * desc) {
+    SLISTC_FOREACH_DATA(descs, it, const sensor_desc_t *) {
+        if (it == desc)
+            return 1;
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+/** 'fake' loading descs of family are replaced by the whole list() */
+static int sensor_family_has_loading(sensor_ctx_t * sctx, const sensor_family_t * family) {
+    SLISTC_FOREACH_DATA(sctx->sensorlist, desc, const sensor_desc_t *) {
+        if (desc->family == family
+        &&  (desc->label == s_sensor_loading_label
+             || desc->properties == s_sensor_loading_properties)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+/** incremental reload with the added and removed descs given by the family
+ * list_delta(): only the removed descs are un-watched and unlisted, and only the
+ * added ones are listed and matched against the watches of removed descs. Other
+ * samples are kept with their values, history, archive and scheduling. */
+static void sensor_family_reload_delta(
+                            sensor_family_t *       family,
+                            slist_t *               added,
+                            slist_t *               removed) {
+    sensor_ctx_t *              sctx = family->sctx;
+    sensor_family_reload_t *    data = NULL;
+    slist_t *                   last = NULL, * first_added;
+
+    LOG_VERBOSE(sctx->log, "%s(): family %s: %u added, %u removed", __func__,
+                SENSOR_FAM_NAME(family), (unsigned int) slist_length(added),
+                (unsigned int) slist_length(removed));
+
+    if (removed != NULL) {
+        /* removed descs are going to be freed, exporters and streams must forget them */
+        sensor_export_reset(sctx);
+        SLIST_FOREACH_DATA(sctx->streams, stream, sensor_stream_t *) {
+            sensor_stream_reset(stream);
+        }
+        /* keep the watch parameters of removed descs, a desc with the same name
+         * can be added again, then un-watch them */
+        for (slist_t * list = sctx->watchlist, * prev = NULL; list != NULL; /* no_incr */) {
+            sensor_sample_t * sample = (sensor_sample_t *) list->data;
+
+            if (sample->desc->family == family && sensor_desc_list_has(removed, sample->desc)) {
+                sensor_family_reload_visit(sample, &data);
+                list = sensor_watch_del_node_unlocked(sctx, list, prev);
+            } else {
+                prev = list;
+                list = list->next;
+            }
+        }
+    }
+    /* unlist removed descs and free them, find the end of list */
+    for (slist_t * list = sctx->sensorlist; list != NULL; /* no_incr */) {
+        sensor_desc_t * desc = (sensor_desc_t *) list->data;
+
+        if (desc->family == family && sensor_desc_list_has(removed, desc)) {
+            slist_t * to_free = list;
+
+            sensor_family_unlist_desc(sctx, desc);
+            list = list->next;
+            if (last == NULL) {
+                sctx->sensorlist = list;
+            } else {
+                last->next = list;
+            }
+            slist_free_1(to_free, sensor_desc_free_one);
+        } else {
+            last = list;
+            list = list->next;
+        }
+    }
+    slist_free(removed, NULL);
+
+    /* list the added descs at the end */
+    first_added = NULL;
+    while (added != NULL) {
+        slist_t *       node = added;
+        sensor_desc_t * desc = (sensor_desc_t *) node->data;
+
+        added = added->next;
+        if (desc == NULL) {
+            LOG_WARN(sctx->log, "ignoring sensor '%s/%s': wrong data",
+                     SENSOR_FAM_NAME(family), STR_NULL);
+            slist_free_1(node, NULL);
+            continue ;
+        }
+        sensor_family_list_desc(family, desc);
+        node->next = NULL;
+        if (last == NULL) {
+            sctx->sensorlist = node;
+        } else {
+            last->next = node;
+        }
+        last = node;
+        if (first_added == NULL)
+            first_added = node;
+    }
+    sensor_family_reload_restore(family, data, first_added);
+}
+
+/* ************************************************************************ */
+/** reload the descs of family, called under read or write lock, returns with the
+ * write lock. The new descs are asked to the family under the read lock and the
+ * family mutex, while the listed ones are still used by readers (families keep them
+ * until their next list), and updates of the family are skipped. Only the swap of
+ * the descs takes the write lock and blocks the readers of other families.
+ * Returns SENSOR_UNCHANGED if another thread is already reloading the family. */
+static sensor_status_t sensor_family_reload(
+                            sensor_family_t *       family) {
+    sensor_family_priv_t *      fpriv = (sensor_family_priv_t *) family;
+    char                        pattern[SENSOR_LABEL_SIZE];
+    sensor_family_reload_t *    data = NULL;
+    slist_t *                   famlist = NULL, * added = NULL, * removed = NULL, * last;
+    sensor_status_t             delta = SENSOR_NOT_SUPPORTED;
+    uint64_t                    start_ns = sensor_stats_now_ns(), end_ns;
+    SENSOR_TRACE_DECL(trace_ns);
+
+    SENSOR_FAMILY_LOCK(family);
+    if (fpriv->reloading) {
+        SENSOR_FAMILY_UNLOCK(family);
+        return SENSOR_UNCHANGED;
+    }
+    fpriv->reloading = 1;
+    SENSOR_TRACE_BEGIN(trace_ns, STP_FAMILY_RELOAD, family->info->name, 0);
+    if (family->info->list_delta != NULL && !sensor_family_has_loading(family->sctx, family)) {
+        delta = family->info->list_delta(family, &added, &removed);
+    }
+    if (delta != SENSOR_SUCCESS && family->info->list != NULL) {
+        /* ask family for a new list of <sensor_desc_t *> */
+        famlist = family->info->list(family);
+    }
+    SENSOR_FAMILY_UNLOCK(family);
+
+    sensor_lock_upgrade(family->sctx);
+    if (delta == SENSOR_SUCCESS) {
+        sensor_family_reload_delta(family, added, removed);
+        goto reloaded;
+    }
+    snprintf(pattern, sizeof(pattern) / sizeof(*pattern), "%s/*", family->info->name);
+
+    /* descs are going to be freed, exporters and streams must forget them */
+    sensor_export_reset(family->sctx);
+    SLIST_FOREACH_DATA(family->sctx->streams, stream, sensor_stream_t *) {
+        sensor_stream_reset(stream);
+    }
+
+    /* keep the watched sensors and their watch parameters, then un-watch them
+     * (they are patterns, they must be expanded with sensor_watch_add_unlocked) */
+    sensor_watch_find_unlocked(family->sctx, pattern, SSF_DEFAULT, NULL,
+                               sensor_family_reload_visit, &data);
+    sensor_watch_del(family->sctx, pattern, SSF_DEFAULT);
+
+    /* replace the listed descs by the new ones */
+    last = sensor_family_unlist_sensors(family);
+    sensor_family_add_sensors(family, famlist, &last);
+
+    /* re-add the previous watches, hopefully some sensors will match this time
+     * and free the 'fake' descs */
+    sensor_family_reload_restore(family, data, family->sctx->sensorlist);
+
+reloaded:
+    /* no update runs under the write lock */
+    fpriv->reloading = 0;
+
     /* notify families about reload */
     SLIST_FOREACH_DATA(family->sctx->families, it_fam, sensor_family_t *) {
         if (it_fam->info->notify != NULL) {
@@ -2072,7 +5703,215 @@ static sensor_status_t sensor_family_reload(
             it_fam->info->notify(SWE_FAMILY_RELOADED, it_fam, NULL, family->sctx->evdata);
         }
     }
-    return SENSOR_SUCCESS;
+    end_ns = sensor_stats_now_ns();
+    SENSOR_STATS_ADD(sensor_family_stats(family)->reloads, 1);
+    if (start_ns != 0 && end_ns > start_ns)
+        SENSOR_STATS_ADD(sensor_family_stats(family)->reload_ns, end_ns - start_ns);
+    SENSOR_TRACE_END(trace_ns, STP_FAMILY_RELOAD, family->info->name, 0);
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** notify a watch event to the sample callback, or to the dispatcher thread
+ * which also takes the events of samples without callback for its batches */
+static inline void sensor_watch_notify(sensor_sample_t * sensor, unsigned int event,
+                                       sensor_watch_ev_data_t * ev_data) {
+    sensor_ctx_t * sctx = sensor->desc->family->sctx;
+
+    if (sctx->dispatcher != NULL) {
+        sensor_dispatch_post(sctx->dispatcher, sensor, event, ev_data);
+    } else if (sensor->watch->callback != NULL) {
+        sensor->watch->callback(event, sctx, sensor, ev_data, sensor->watch->callback_data);
+    }
+}
+
+/* ************************************************************************ */
+/** compute sample->level after a value change, with watch->level_hysteresis,
+ * and notify the callback with SWE_WATCH_LEVEL when it changes. */
+static void sensor_update_level(sensor_sample_t * sensor) {
+    const sensor_watch_t *  watch = sensor->watch;
+    sensor_watch_ev_data_t  ev_data;
+    unsigned int            level, raw = 0;
+    long double             value;
+
+    if (SENSOR_VALUE_IS_BUFFER(sensor->value.type)
+    ||  sensor->value.type == SENSOR_VALUE_NULL) {
+        return ;
+    }
+    value = SENSOR_SAMPLE_OPS(sensor)->todouble(&(sensor->value));
+
+    /* raw level: highest level reached */
+    for (level = SENSOR_LEVEL_NB; level > 0; --level) {
+        if (watch->update_levels[level - 1].type != SENSOR_VALUE_NULL
+        &&  value >= sensor_value_todouble(&(watch->update_levels[level - 1]))) {
+            raw = level;
+            break ;
+        }
+    }
+    /* going down: a level is left only below its value minus hysteresis */
+    for (level = sensor->level < raw ? raw : sensor->level; level > raw; --level) {
+        if (level <= SENSOR_LEVEL_NB
+        &&  watch->update_levels[level - 1].type != SENSOR_VALUE_NULL
+        &&  value >= sensor_value_todouble(&(watch->update_levels[level - 1]))
+                     - watch->level_hysteresis) {
+            break ;
+        }
+    }
+    if (level == sensor->level) {
+        return ;
+    }
+    ev_data.level = sensor->level;
+    sensor->level = level;
+    sensor_watch_notify(sensor, SWE_WATCH_LEVEL, &ev_data);
+}
+
+/* ************************************************************************ */
+/** interval until next update of sample: the watch one, or the adaptive one
+ * doubled while the value is unchanged, see sensor_watch_t.update_interval_max */
+static inline const struct timeval * sensor_update_interval(
+                                        sensor_sample_t *   sensor,
+                                        sensor_status_t     ret) {
+    const sensor_watch_t *  watch = sensor->watch;
+    struct timeval          next;
+
+    if (SENSOR_LIKELY(!timercmp(&(watch->update_interval_max), &(watch->update_interval), >))) {
+        return &(watch->update_interval);
+    }
+    if (ret != SENSOR_UNCHANGED
+    ||  timercmp(&(sensor->interval), &(watch->update_interval), <)) {
+        sensor->interval = watch->update_interval;
+    } else {
+        timeradd(&(sensor->interval), &(sensor->interval), &next);
+        if (next.tv_sec == 0 && next.tv_usec == 0) {
+            next.tv_usec = 1000; /* backoff from a null interval */
+        }
+        sensor->interval = timercmp(&next, &(watch->update_interval_max), <)
+                           ? next : watch->update_interval_max;
+    }
+    return &(sensor->interval);
+}
+
+/* ************************************************************************ */
+/** delay a deadline to the next multiple of slack, so that samples with the
+ * same slack, or with multiples of it, are updated in the same wakeup. */
+static inline void sensor_update_align(struct timeval * deadline, const struct timeval * slack) {
+    uint64_t slack_us = (uint64_t) slack->tv_sec * 1000000 + slack->tv_usec;
+    uint64_t time_us = (uint64_t) deadline->tv_sec * 1000000 + deadline->tv_usec;
+
+    time_us = ((time_us + slack_us - 1) / slack_us) * slack_us;
+    deadline->tv_sec = time_us / 1000000;
+    deadline->tv_usec = time_us % 1000000;
+}
+
+/* ************************************************************************ */
+#define SENSOR_WATCH_HAS_DEADBAND(_watch) \
+            ((_watch)->deadband_abs > 0.0 || (_watch)->deadband_pct > 0.0)
+
+/** deadband filter of a changed value: returns non-0 if the change from the last
+ * reported value is not meaningful, otherwise the value becomes the reference. */
+static inline int sensor_update_deadband(sensor_sample_t * sensor) {
+    const sensor_watch_t *  watch = sensor->watch;
+    long double             value, delta;
+
+    if (SENSOR_VALUE_IS_BUFFER(sensor->value.type)
+    ||  sensor->value.type == SENSOR_VALUE_NULL) {
+        return 0;
+    }
+    value = SENSOR_SAMPLE_OPS(sensor)->todouble(&(sensor->value));
+    if (!isnan(sensor->deadband_ref)) {
+        delta = fabsl(value - sensor->deadband_ref);
+        if (delta <= watch->deadband_abs
+        ||  delta * 100.0L <= watch->deadband_pct * fabsl(sensor->deadband_ref)) {
+            return 1;
+        }
+    }
+    sensor->deadband_ref = value;
+    return 0;
+}
+
+/* ************************************************************************ */
+/** process the status returned by family update() or update_batch().
+ * changed is 1 if the value differs from the one before update, 0 if not,
+ * or -1 if unknown (SFF_PRECISE_UPDATE, update_batch()) */
+static inline sensor_status_t sensor_update_status_internal(
+                                sensor_sample_t *           sensor,
+                                const struct timeval *      now,
+                                sensor_status_t             ret,
+                                int                         changed) {
+    if (ret == SENSOR_UNCHANGED) {
+        /* nothing */
+    } else if (ret == SENSOR_UPDATED) {
+        /* nothing except deadband filter and callback */
+        if (SENSOR_WATCH_HAS_DEADBAND(sensor->watch) && sensor_update_deadband(sensor)) {
+            ret = SENSOR_UNCHANGED;
+        } else if ((sensor->watch->flags & SWF_LEVEL_ONLY) == 0) {
+            sensor_watch_notify(sensor, SWE_WATCH_UPDATED, NULL);
+        }
+    }
+    else if (ret == SENSOR_SUCCESS || ret == SENSOR_LOADING) {
+        LOG_SCREAM(sensor->desc->family->log, "%s/%s: forced comparison",
+                   SENSOR_DESC_FAMNAME(sensor->desc), SENSOR_DESC_LABEL(sensor->desc));
+        if (ret == SENSOR_LOADING) {
+            now = NULL; /* we return without updating the timer in order to reload asap */
+        }
+        if ((sensor->next_update_time.tv_sec == 0
+             && sensor->next_update_time.tv_usec == 0)
+        ||  (changed < 0 && ret == SENSOR_SUCCESS)
+        ||  changed > 0) {
+            ret = SENSOR_WATCH_HAS_DEADBAND(sensor->watch) && sensor_update_deadband(sensor)
+                  ? SENSOR_UNCHANGED : SENSOR_UPDATED;
+        } else {
+            ret = SENSOR_UNCHANGED;
+        }
+    } else {
+        if (ret == SENSOR_RELOAD_FAMILY) {
+            sensor_family_t *       family          = sensor->desc->family;
+            sensor_watch_callback_t callback        = sensor->watch->callback;
+            void *                  callback_data   = sensor->watch->callback_data;
+            if (sensor_family_reload(family) != SENSOR_SUCCESS) {
+                /* another thread is reloading the family, the sample is kept until then */
+                return SENSOR_WAIT_TIMER;
+            }
+            if (callback != NULL) {
+                family->sctx->evdata->family = family;
+                callback(SWE_FAMILY_RELOADED, family->sctx, NULL, family->sctx->evdata, callback_data);
+            }
+            return ret;
+        }
+        return SENSOR_ERROR;
+    }
+    if (ret == SENSOR_UPDATED
+    &&  (sensor->watch->update_levels[SENSOR_LEVEL_THRESHOLD].type != SENSOR_VALUE_NULL
+         || sensor->watch->update_levels[SENSOR_LEVEL_WARN].type != SENSOR_VALUE_NULL
+         || sensor->watch->update_levels[SENSOR_LEVEL_CRITICAL].type != SENSOR_VALUE_NULL)) {
+        sensor_update_level(sensor);
+    }
+    if (now != NULL) {
+        const struct timeval * interval = sensor_update_interval(sensor, ret);
+        timeradd(interval, now, &(sensor->next_update_time));
+        if (sensor->watch->update_slack.tv_sec != 0 || sensor->watch->update_slack.tv_usec != 0) {
+            sensor_update_align(&(sensor->next_update_time), &(sensor->watch->update_slack));
+        }
+        if (sensor->watch->history_size > 0 && ret != SENSOR_LOADING) {
+            sensor_history_push(sensor, now);
+        }
+        if (sensor->watch->archive_size > 0 && ret != SENSOR_LOADING
+        &&  sensor->desc->properties != s_sensor_loading_properties
+        &&  sensor->desc->label != s_sensor_loading_label) {
+            sensor_archive_push(sensor, now);
+        }
+    }
+    return ret;
+}
+
+/* ************************************************************************ */
+/** record acquisition time of sample if family update() could read its value */
+static inline void sensor_update_stamp(sensor_sample_t * sensor, sensor_status_t ret,
+                                       uint64_t acquired_ns) {
+    if (acquired_ns != 0 && (ret == SENSOR_UPDATED || ret == SENSOR_UNCHANGED
+                             || ret == SENSOR_SUCCESS)) {
+        sensor->acquired_ns = acquired_ns;
+    }
 }
 
 /* ************************************************************************ */
@@ -2082,61 +5921,230 @@ static inline sensor_status_t sensor_update_check_internal(
     if (sensor->desc->family->info->update != NULL) {
         if (now == NULL || timercmp(now, &(sensor->next_update_time), >=)) {
             sensor_status_t ret;
-            sensor_value_t  *p_prev_value;
-
-            if (SENSOR_VALUE_IS_BUFFER(sensor->value.type)) {
-                p_prev_value = &(sensor->desc->family->sctx->work_buffer);
-            } else {
-                p_prev_value = &(sensor->desc->family->sctx->work_value);
-            }
-            sensor_value_copy(p_prev_value, &(sensor->value)); // FIXME perfs
-            if ((ret = sensor->desc->family->info->update(sensor, now)) == SENSOR_UNCHANGED) {
-                /* nothing */
-            } else if (ret == SENSOR_UPDATED) {
-                /* nothing except callback */
-                if (sensor->watch->callback != NULL) {
-                    sensor->watch->callback(SWE_WATCH_UPDATED, sensor->desc->family->sctx,
-                                            sensor, NULL, sensor->watch->callback_data);
+            int             changed = -1;
+            sensor_value_t  prev_value;
+            char            prev_buffer[SENSOR_VALUE_BYTES_WORKSZ];
+            uint64_t        start_ns;
+            int             b_precise = (sensor->desc->family->info->flags
+                                         & SFF_PRECISE_UPDATE) != 0;
+            SENSOR_TRACE_DECL(trace_ns);
+
+            /* snapshot on the stack (not in sctx) as several threads can update
+             * samples concurrently under the read lock. */
+            if (!b_precise) {
+                if (SENSOR_VALUE_IS_BUFFER(sensor->value.type)) {
+                    prev_value.data.b.buf = prev_buffer;
+                    prev_value.data.b.size = 0;
+                    prev_value.data.b.maxsize = sizeof(prev_buffer);
                 }
+                sensor_value_copy(&prev_value, &(sensor->value));
             }
-            else if (ret == SENSOR_SUCCESS || ret == SENSOR_LOADING) {
-                LOG_SCREAM(sensor->desc->family->log, "%s/%s: forced comparison",
-                           SENSOR_DESC_FAMNAME(sensor->desc), SENSOR_DESC_LABEL(sensor->desc));
-                if (ret == SENSOR_LOADING) {
-                    now = NULL; /* we return without updating the timer in order to reload asap */
-                }
-                if ((sensor->next_update_time.tv_sec == 0
-                     && sensor->next_update_time.tv_usec == 0)
-                ||  sensor_value_equal(p_prev_value, &sensor->value) == 0) {
-                    ret = SENSOR_UPDATED;
-                } else {
-                    ret = SENSOR_UNCHANGED;
-                }
-            } else {
-                if (ret == SENSOR_RELOAD_FAMILY) {
-                    sensor_family_t *       family          = sensor->desc->family;
-                    sensor_watch_callback_t callback        = sensor->watch->callback;
-                    void *                  callback_data   = sensor->watch->callback_data;
-                    sensor_lock_upgrade(family->sctx);
-                    sensor_family_reload(family);
-                    if (callback != NULL) {
-                        family->sctx->evdata->family = family;
-                        callback(SWE_FAMILY_RELOADED, family->sctx, NULL, family->sctx->evdata, callback_data);
-                    }
-                    return ret;
-                }
-                return SENSOR_ERROR;
+            SENSOR_FAMILY_LOCK(sensor->desc->family);
+            if (((sensor_family_priv_t *) sensor->desc->family)->reloading) {
+                /* the sample is going to be released by the reload */
+                SENSOR_FAMILY_UNLOCK(sensor->desc->family);
+                return SENSOR_WAIT_TIMER;
             }
-            if (now != NULL) {
-                timeradd(&(sensor->watch->update_interval), now, &(sensor->next_update_time));
+            SENSOR_TRACE_BEGIN(trace_ns, STP_FAMILY_UPDATE, sensor->desc->family->info->name, 1);
+            start_ns = sensor_stats_now_ns();
+            ret = sensor->desc->family->info->update(sensor, now);
+            sensor_family_stats_update(sensor->desc->family, start_ns);
+            SENSOR_TRACE_END(trace_ns, STP_FAMILY_UPDATE, sensor->desc->family->info->name, 1);
+            SENSOR_FAMILY_UNLOCK(sensor->desc->family);
+            sensor_update_stamp(sensor, ret, sensor_clock_ns(sensor->desc->family->sctx));
+
+            if (!b_precise && (ret == SENSOR_SUCCESS || ret == SENSOR_LOADING)) {
+                changed = SENSOR_SAMPLE_OPS(sensor)->equal(&prev_value, &(sensor->value)) == 0;
             }
-            return ret;
+            return sensor_update_status_internal(sensor, now, ret, changed);
         }
         return SENSOR_WAIT_TIMER;
     }
     return SENSOR_NOT_SUPPORTED;
 }
 
+/* ************************************************************************ */
+/** due samples of one family, updated together */
+typedef struct {
+    sensor_family_t *       family;
+    sensor_sample_t **      samples;
+    sensor_status_t *       results;
+    unsigned int            n;
+    const struct timeval *  now;
+    vjob_t *                job;
+    sensor_value_t *        values; /* 2 * n values, for sensor_update_group_check() */
+    unsigned char *         equal;  /* n results of sensor_values_equal_n() */
+    int                     b_raw;  /* results are raw update statuses, to be processed */
+    int                     b_check;/* changes are detected on the whole group */
+} sensor_update_group_t;
+
+/* ************************************************************************ */
+/** can the group be updated without previous value snapshot, possibly in a vjob */
+static inline int sensor_update_group_can_raw(const sensor_update_group_t * group) {
+    return group->family->info->update_batch != NULL
+           || (group->family->info->flags & SFF_PRECISE_UPDATE) != 0;
+}
+
+/* ************************************************************************ */
+/** only call the family update functions, without status processing (callbacks,
+ * reload, timers), as this can run in a vjob for SIF_PARALLEL_UPDATE. */
+static void * sensor_update_group_job(void * vgroup) {
+    sensor_update_group_t * group = (sensor_update_group_t *) vgroup;
+    unsigned int            i;
+    uint64_t                start_ns;
+    SENSOR_TRACE_DECL(trace_ns);
+
+    SENSOR_FAMILY_LOCK(group->family);
+    group->b_raw = 1;
+    if (((sensor_family_priv_t *) group->family)->reloading) {
+        /* the samples are going to be released by the reload */
+        for (i = 0; i < group->n; ++i) {
+            group->results[i] = SENSOR_WAIT_TIMER;
+        }
+        SENSOR_FAMILY_UNLOCK(group->family);
+        return NULL;
+    }
+    SENSOR_TRACE_BEGIN(trace_ns, STP_FAMILY_UPDATE, group->family->info->name, group->n);
+    if (group->family->info->update_batch != NULL) {
+        sensor_status_t ret;
+
+        start_ns = sensor_stats_now_ns();
+        ret = group->family->info->update_batch(group->family, group->samples, group->n,
+                                                group->now, group->results);
+        sensor_family_stats_update(group->family, start_ns);
+        if (ret != SENSOR_SUCCESS) {
+            for (i = 0; i < group->n; ++i) {
+                group->results[i] = SENSOR_ERROR;
+            }
+        } else {
+            /* samples of a batch are read together */
+            uint64_t acquired_ns = sensor_clock_ns(group->family->sctx);
+            for (i = 0; i < group->n; ++i) {
+                sensor_update_stamp(group->samples[i], group->results[i], acquired_ns);
+            }
+        }
+    } else {
+        for (i = 0; i < group->n; ++i) {
+            start_ns = sensor_stats_now_ns();
+            group->results[i] = group->family->info->update(group->samples[i], group->now);
+            sensor_family_stats_update(group->family, start_ns);
+            sensor_update_stamp(group->samples[i], group->results[i],
+                                sensor_clock_ns(group->family->sctx));
+        }
+    }
+    SENSOR_TRACE_END(trace_ns, STP_FAMILY_UPDATE, group->family->info->name, group->n);
+    SENSOR_FAMILY_UNLOCK(group->family);
+    return NULL;
+}
+
+/* ************************************************************************ */
+/** can the sample join a group of its family updated by sensor_update_group_check():
+ * family update() compared to previous value, on scalar values */
+static inline int sensor_update_group_can_check(const sensor_sample_t * sensor) {
+    return sensor->desc->family->info->update != NULL
+           && sensor->desc->family->info->update_batch == NULL
+           && (sensor->desc->family->info->flags & SFF_PRECISE_UPDATE) == 0
+           && !SENSOR_VALUE_IS_BUFFER(sensor->value.type);
+}
+
+/* ************************************************************************ */
+/** family update() on the scalar samples of a group: the values before and after
+ * the updates are compared with one sensor_values_equal_n() instead of one
+ * comparison per sample. Results are raw, as in sensor_update_group_job(). */
+static void sensor_update_group_check(sensor_update_group_t * group) {
+    sensor_value_t *    prev    = group->values;
+    sensor_value_t *    cur     = group->values + group->n;
+    unsigned int        i;
+    uint64_t            start_ns;
+    SENSOR_TRACE_DECL(trace_ns);
+
+    /* scalars only: no buffer to snapshot */
+    for (i = 0; i < group->n; ++i) {
+        prev[i] = group->samples[i]->value;
+    }
+    SENSOR_FAMILY_LOCK(group->family);
+    group->b_raw = 1;
+    if (((sensor_family_priv_t *) group->family)->reloading) {
+        /* the samples are going to be released by the reload */
+        for (i = 0; i < group->n; ++i) {
+            group->results[i] = SENSOR_WAIT_TIMER;
+        }
+        SENSOR_FAMILY_UNLOCK(group->family);
+        return ;
+    }
+    SENSOR_TRACE_BEGIN(trace_ns, STP_FAMILY_UPDATE, group->family->info->name, group->n);
+    for (i = 0; i < group->n; ++i) {
+        start_ns = sensor_stats_now_ns();
+        group->results[i] = group->family->info->update(group->samples[i], group->now);
+        sensor_family_stats_update(group->family, start_ns);
+        sensor_update_stamp(group->samples[i], group->results[i],
+                            sensor_clock_ns(group->family->sctx));
+        cur[i] = group->samples[i]->value;
+    }
+    SENSOR_TRACE_END(trace_ns, STP_FAMILY_UPDATE, group->family->info->name, group->n);
+    SENSOR_FAMILY_UNLOCK(group->family);
+
+    sensor_values_equal_n(prev, cur, group->n, group->equal);
+}
+
+/* ************************************************************************ */
+/** update the due samples of a family, with one update_batch() call if supported.
+ * results[i] receives the status of samples[i], processing stops on RELOAD_FAMILY */
+static sensor_status_t sensor_update_group_internal(sensor_update_group_t * group) {
+    unsigned int i;
+
+    if (!group->b_raw && group->family->info->update_batch != NULL) {
+        sensor_update_group_job(group);
+    } else if (!group->b_raw && group->b_check) {
+        sensor_update_group_check(group);
+    }
+    for (i = 0; i < group->n; ++i) {
+        if (group->b_raw && group->results[i] == SENSOR_WAIT_TIMER) {
+            continue ; /* skipped during a reload */
+        } else if (group->b_raw) {
+            group->results[i] = sensor_update_status_internal(
+                                    group->samples[i], group->now, group->results[i],
+                                    group->b_check ? group->equal[i] == 0 : -1);
+        } else {
+            group->results[i] = sensor_update_check_internal(group->samples[i], group->now);
+        }
+        if (group->results[i] == SENSOR_RELOAD_FAMILY) {
+            return SENSOR_RELOAD_FAMILY;
+        }
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** SIF_PARALLEL_UPDATE: run family updates of groups in vjobs, the first one
+ * on the caller thread, and wait for all of them. */
+static void sensor_update_groups_parallel(
+                                sensor_ctx_t *              sctx,
+                                sensor_update_group_t *     groups,
+                                unsigned int                n_groups) {
+    sensor_update_group_t * inline_group = NULL;
+    unsigned int            i;
+
+    for (i = 0; i < n_groups; ++i) {
+        if (!sensor_update_group_can_raw(&groups[i]))
+            continue ;
+        if (inline_group == NULL) {
+            inline_group = &groups[i];
+        } else if ((groups[i].job = vjob_run(sensor_update_group_job, &groups[i])) == NULL) {
+            LOG_VERBOSE(sctx->log, "%s(): cannot run job for family %s, running it serially",
+                        __func__, SENSOR_FAM_NAME(groups[i].family));
+        }
+    }
+    if (inline_group != NULL) {
+        sensor_update_group_job(inline_group);
+    }
+    for (i = 0; i < n_groups; ++i) {
+        if (groups[i].job != NULL) {
+            vjob_waitandfree(groups[i].job);
+            groups[i].job = NULL;
+        }
+    }
+}
 
 /* ************************************************************************ */
 static sensor_status_t sensor_init_wait_desc_unlocked(sensor_desc_t * desc, int b_onlywatched) {
@@ -2159,8 +6167,12 @@ static sensor_status_t sensor_init_wait_desc_unlocked(sensor_desc_t * desc, int
             return SENSOR_ERROR;
         }
         bdelete = 1;
-        snprintf(label, PTR_COUNT(label), "%s/%s",
-                 SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc));
+        if (desc->fullname != NULL) {
+            strn0cpy(label, desc->fullname->name, desc->fullname->len, PTR_COUNT(label) - 1);
+        } else {
+            snprintf(label, PTR_COUNT(label), "%s/%s",
+                     SENSOR_DESC_FAMNAME(desc), SENSOR_DESC_LABEL(desc));
+        }
     }
 
     LOG_INFO(desc->family->sctx->log, "waiting until %s is loaded...", SENSOR_DESC_FAMNAME(desc));
@@ -2236,59 +6248,372 @@ sensor_status_t sensor_now(struct timeval * now) {
 }
 
 /* ************************************************************************ */
-sensor_status_t sensor_update_check(sensor_sample_t * sensor, const struct timeval * now) {
-    return sensor_update_check_internal(sensor, now);
+sensor_status_t sensor_now_ns(sensor_ctx_t * sctx, uint64_t * now_ns) {
+    struct timespec ts;
+
+    if (now_ns == NULL) {
+        return SENSOR_ERROR;
+    }
+    if (vclock_gettime(sctx == NULL ? CLOCK_MONOTONIC_RAW : sctx->clock_id, &ts) != 0) {
+        return SENSOR_ERROR;
+    }
+    *now_ns = (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+    return SENSOR_SUCCESS;
 }
 
 /* ************************************************************************ */
-slist_t * sensor_update_get(sensor_ctx_t *sctx, const struct timeval * now) {
-    slist_t *updates = NULL;
-    struct timeval snow;
+sensor_status_t sensor_update_check(sensor_sample_t * sensor, const struct timeval * now) {
+    sensor_status_t ret = sensor_update_check_internal(sensor, now);
 
-    if (sctx == NULL) {
-        return NULL;
+    if (sensor->sched_idx != 0 && ret != SENSOR_RELOAD_FAMILY && ret != SENSOR_WAIT_TIMER) {
+        sensor_ctx_t * sctx = sensor->desc->family->sctx;
+        SENSOR_LOCK_LOCK(sctx);
+        if (sensor->sched_idx != 0)
+            sensor_sched_fix(&(sctx->sched), sensor);
+        SENSOR_LOCK_UNLOCK(sctx);
     }
+    return ret;
+}
+
+/* ************************************************************************ */
+/** drain the wakeup pipe, if any */
+static void sensor_update_fd_drain(sensor_ctx_t * sctx) {
+    char    buf[64];
+    ssize_t n;
+
+    if (sctx->wakeup_fds[0] < 0)
+        return ;
+    while ((n = read(sctx->wakeup_fds[0], buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+        ; /* nothing but loop */
+}
+
+/* ************************************************************************ */
+/** update due samples, storing updated ones in list if not NULL, else in array */
+static sensor_status_t sensor_update_get_internal(
+                            sensor_ctx_t *          sctx,
+                            const struct timeval *  now,
+                            slist_t **              p_list,
+                            sensor_update_array_t * array) {
+    sensor_status_t     result = SENSOR_UNCHANGED;
+    struct timeval      snow;
+    sensor_sample_t *   due_batch[SENSOR_SCHED_BATCH], ** due = due_batch;
+    sensor_status_t     rets_batch[SENSOR_SCHED_BATCH], * rets = rets_batch;
+    sensor_update_group_t groups_batch[SENSOR_SCHED_BATCH], * groups = groups_batch;
+    sensor_value_t      values_batch[2 * SENSOR_SCHED_BATCH], * values = values_batch;
+    unsigned char       equal_batch[SENSOR_SCHED_BATCH], * equal = equal_batch;
+    void *              due_alloc = NULL;
+    unsigned int        n_due, max_due, i_due, n_groups, i_grp, i;
+    sensor_family_stats_t * stats;
+    SENSOR_TRACE_DECL(trace_ns);
+
     if (now == NULL) {
         struct timespec ts;
-        if (vclock_gettime(CLOCK_MONOTONIC_RAW, &ts) != 0) {
+        if (vclock_gettime(sctx->clock_id, &ts) != 0) {
             LOG_ERROR(sctx->log, "error vclock_gettime: %s, in %s", strerror(errno), __func__);
-            return NULL;
+            return SENSOR_ERROR;
         }
         snow.tv_sec = ts.tv_sec;
         snow.tv_usec = ts.tv_nsec / 1000;
         now = &snow;
     }
 
+    /* a wakeup is consumed by this update */
+    sensor_update_fd_drain(sctx);
+
     sensor_lock(sctx, SENSOR_LOCK_READ);
     if (sctx->watchlist == NULL) {
         LOG_VERBOSE(sctx->log, "warning in %s(): watch list is empty", __func__);
         sensor_unlock(sctx);
-        return NULL;
+        return SENSOR_UNCHANGED;
     }
-    SLIST_FOREACH_DATA(sctx->watchlist, sensor, sensor_sample_t *) {
-        sensor_status_t ret = sensor_update_check_internal(sensor, now);
-        if (ret == SENSOR_UPDATED) {
-            updates = slist_prepend(updates, sensor);
-        } else if (ret == SENSOR_UNCHANGED) {
-            continue ;
-        } else if (ret == SENSOR_RELOAD_FAMILY) {
-            sensor_update_free(updates);
-            updates = NULL;
-            break ;
-        } else if (ret == SENSOR_ERROR) {
-            LOG_ERROR(sctx->log, "sensor '%s' update error",
-                      SENSOR_DESC_LABEL(sensor->desc));
+    SENSOR_TRACE_BEGIN(trace_ns, STP_UPDATE_GET, NULL, 0);
+    /* take all due samples out of the scheduler: concurrent callers won't get them,
+     * and each family is updated once. They can't be more than scheduled ones. */
+    SENSOR_LOCK_LOCK(sctx);
+    max_due = sctx->sched.count;
+    if (max_due > PTR_COUNT(due_batch)) {
+        if ((due_alloc = malloc(max_due * (2 * sizeof(*values) + sizeof(*groups) + sizeof(*due)
+                                           + sizeof(*rets) + sizeof(*equal)))) == NULL) {
+            LOG_WARN(sctx->log, "%s(): cannot allocate %u due samples: %s", __func__,
+                     max_due, strerror(errno));
+            max_due = PTR_COUNT(due_batch);
+        } else {
+            /* values first, as they have the widest alignment */
+            values = (sensor_value_t *) due_alloc;
+            groups = (sensor_update_group_t *) (values + 2 * max_due);
+            due = (sensor_sample_t **) (groups + max_due);
+            rets = (sensor_status_t *) (due + max_due);
+            equal = (unsigned char *) (rets + max_due);
+        }
+    }
+    for (n_due = 0; n_due < max_due && (due[n_due] = sensor_sched_pop_due(sctx, now)) != NULL;
+         ++n_due)
+        ; /* nothing but loop */
+    SENSOR_LOCK_UNLOCK(sctx);
+
+    /* group due samples by family: batch family data is read only once */
+    for (i_due = 0, n_groups = 0; i_due < n_due; i_due += groups[n_groups++].n) {
+        sensor_update_group_t * group = &groups[n_groups];
+
+        group->family = due[i_due]->desc->family;
+        group->samples = due + i_due;
+        group->results = rets + i_due;
+        group->n = 1;
+        group->now = now;
+        group->job = NULL;
+        group->values = values + 2 * i_due;
+        group->equal = equal + i_due;
+        group->b_raw = 0;
+        group->b_check = sensor_update_group_can_check(due[i_due]);
+        if (sensor_update_group_can_raw(group) || group->b_check) {
+            for (i = i_due + 1; i < n_due; ++i) {
+                if (due[i]->desc->family == group->family
+                &&  (!group->b_check || sensor_update_group_can_check(due[i]))) {
+                    sensor_sample_t * tmp = due[i_due + group->n];
+                    due[i_due + group->n++] = due[i];
+                    due[i] = tmp;
+                }
+            }
+        }
+    }
+    if ((sctx->flags & SIF_PARALLEL_UPDATE) != 0 && n_groups > 1) {
+        sensor_update_groups_parallel(sctx, groups, n_groups);
+    }
+
+    for (i_grp = 0; i_grp < n_groups && result != SENSOR_RELOAD_FAMILY; ++i_grp) {
+        unsigned int n_updated = 0, n_unchanged = 0;
+
+        sensor_update_group_internal(&groups[i_grp]);
+
+        for (i = 0; i < groups[i_grp].n; ++i) {
+            sensor_sample_t *   sensor  = groups[i_grp].samples[i];
+            sensor_status_t     ret     = groups[i_grp].results[i];
+
+            if (ret == SENSOR_UNCHANGED) {
+                ++n_unchanged;
+            } else if (ret == SENSOR_UPDATED) {
+                ++n_updated;
+                result = SENSOR_UPDATED;
+                if (sctx->publisher != NULL) {
+                    sensor_shm_put(sctx->publisher, sensor, now);
+                }
+                if (p_list != NULL) {
+                    *p_list = slist_prepend(*p_list, sensor);
+                } else if (array->count < array->capacity) {
+                    array->samples[array->count++] = sensor;
+                } else {
+                    ++(array->overflow);
+                }
+            } else if (ret == SENSOR_RELOAD_FAMILY) {
+                /* watchs changed, we are now owner of the write lock */
+                if (p_list != NULL) {
+                    sensor_update_free(*p_list);
+                    *p_list = NULL;
+                } else {
+                    array->count = array->overflow = 0;
+                }
+                sensor_sched_rebuild(sctx);
+                result = SENSOR_RELOAD_FAMILY;
+                break ;
+            } else if (ret == SENSOR_ERROR) {
+                LOG_ERROR(sctx->log, "sensor '%s' update error",
+                          SENSOR_DESC_LABEL(sensor->desc));
+            }
+            /* on error or loading, the timer is not reset: retry at next interval
+             * rather than at each call. The deadline must be in the future. */
+            if (!timercmp(&(sensor->next_update_time), now, >)) {
+                timeradd(&(sensor->watch->update_interval), now, &(sensor->next_update_time));
+                if (!timercmp(&(sensor->next_update_time), now, >)) {
+                    sensor->next_update_time = *now;
+                    ++(sensor->next_update_time.tv_usec);
+                }
+            }
         }
+        stats = sensor_family_stats(groups[i_grp].family);
+        SENSOR_STATS_ADD(stats->ticks, 1);
+        SENSOR_STATS_ADD(stats->updated, n_updated);
+        SENSOR_STATS_ADD(stats->unchanged, n_unchanged);
     }
+    /* put back processed samples in the scheduler, unless it was rebuilt */
+    if (result != SENSOR_RELOAD_FAMILY) {
+        SENSOR_LOCK_LOCK(sctx);
+        for (i_due = 0; i_due < n_due; ++i_due) {
+            sensor_sched_push(sctx, due[i_due]);
+        }
+        SENSOR_LOCK_UNLOCK(sctx);
+    }
+    if (due_alloc != NULL) {
+        free(due_alloc);
+    }
+
+    /* export updated samples while they are protected by the lock */
+    if (result == SENSOR_UPDATED && sctx->exporters != NULL) {
+        if (p_list != NULL) {
+            sensor_export_run(sctx, *p_list, NULL, 0);
+        } else {
+            sensor_export_run(sctx, NULL, array->samples, array->count);
+        }
+    }
+    /* stream servers accept their clients even if nothing changed */
+    if (sctx->streams != NULL) {
+        int b_updated = (result == SENSOR_UPDATED);
+
+        SLIST_FOREACH_DATA(sctx->streams, stream, sensor_stream_t *) {
+            if (p_list != NULL) {
+                sensor_stream_run(stream, sctx->watchlist, b_updated ? *p_list : NULL, NULL, 0);
+            } else {
+                sensor_stream_run(stream, sctx->watchlist, NULL, array->samples,
+                                  b_updated ? array->count : 0);
+            }
+        }
+    }
+    /* events of the pass can be delivered */
+    if (sctx->dispatcher != NULL) {
+        sensor_dispatch_flush(sctx->dispatcher);
+    }
+    SENSOR_TRACE_END(trace_ns, STP_UPDATE_GET, NULL, n_due);
     sensor_unlock(sctx);
+    return result;
+}
+
+/* ************************************************************************ */
+slist_t * sensor_update_get(sensor_ctx_t *sctx, const struct timeval * now) {
+    slist_t * updates = NULL;
+
+    if (sctx == NULL) {
+        return NULL;
+    }
+    sensor_update_get_internal(sctx, now, &updates, NULL);
+
     return updates;
 }
 
+/* ************************************************************************ */
+sensor_status_t sensor_update_fill(
+                    sensor_ctx_t *          sctx,
+                    const struct timeval *  now,
+                    sensor_update_array_t * updates) {
+    if (sctx == NULL || updates == NULL
+    ||  (updates->samples == NULL && updates->capacity > 0)) {
+        return SENSOR_ERROR;
+    }
+    updates->count = 0;
+    updates->overflow = 0;
+
+    return sensor_update_get_internal(sctx, now, NULL, updates);
+}
+
 /* ************************************************************************ */
 void sensor_update_free(slist_t * updates) {
     slist_free(updates, NULL);
 }
 
+/* ************************************************************************ */
+sensor_status_t sensor_update_next_deadline(sensor_ctx_t * sctx, struct timeval * deadline) {
+    sensor_status_t ret = SENSOR_NOT_SUPPORTED;
+
+    if (sctx == NULL || deadline == NULL) {
+        return SENSOR_ERROR;
+    }
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    SENSOR_LOCK_LOCK(sctx);
+    if (sctx->sched.count > 0) {
+        *deadline = sctx->sched.heap[0]->next_update_time;
+        ret = SENSOR_SUCCESS;
+    }
+    SENSOR_LOCK_UNLOCK(sctx);
+    sensor_unlock(sctx);
+
+    return ret;
+}
+
+/* ************************************************************************ */
+long sensor_update_next_timeout(sensor_ctx_t * sctx, const struct timeval * now) {
+    struct timeval  deadline, snow, delay;
+
+    if (sensor_update_next_deadline(sctx, &deadline) != SENSOR_SUCCESS) {
+        return -1L;
+    }
+    if (now == NULL) {
+        uint64_t now_ns;
+        if (sensor_now_ns(sctx, &now_ns) != SENSOR_SUCCESS) {
+            return -1L;
+        }
+        snow.tv_sec = now_ns / UINT64_C(1000000000);
+        snow.tv_usec = (now_ns % UINT64_C(1000000000)) / 1000;
+        now = &snow;
+    }
+    if (!timercmp(&deadline, now, >)) {
+        return 0L;
+    }
+    timersub(&deadline, now, &delay);
+    return delay.tv_sec * 1000L + (delay.tv_usec + 999L) / 1000L;
+}
+
+/* ************************************************************************ */
+int sensor_update_fd(sensor_ctx_t * sctx) {
+    int fd;
+
+    if (sctx == NULL) {
+        return -1;
+    }
+    SENSOR_LOCK_LOCK(sctx);
+    if (sctx->wakeup_fds[0] < 0) {
+        int fds[2];
+
+        if (pipe(fds) != 0) {
+            LOG_WARN(sctx->log, "%s(): cannot create wakeup pipe: %s", __func__, strerror(errno));
+        } else {
+            for (unsigned int i = 0; i < PTR_COUNT(fds); ++i) {
+                fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+                fcntl(fds[i], F_SETFD, fcntl(fds[i], F_GETFD) | FD_CLOEXEC);
+            }
+            sctx->wakeup_fds[0] = fds[0];
+            sctx->wakeup_fds[1] = fds[1];
+        }
+    }
+    fd = sctx->wakeup_fds[0];
+    SENSOR_LOCK_UNLOCK(sctx);
+
+    return fd;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_update_wait(sensor_ctx_t * sctx, long timeout_ms) {
+    struct pollfd   pfd;
+    long            next;
+    int             ret;
+
+    if (sctx == NULL || (pfd.fd = sensor_update_fd(sctx)) < 0) {
+        return SENSOR_ERROR;
+    }
+    pfd.events = POLLIN;
+
+    if ((next = sensor_update_next_timeout(sctx, NULL)) == 0) {
+        return SENSOR_SUCCESS;
+    }
+    if (next > 0 && (timeout_ms < 0 || next <= timeout_ms)) {
+        timeout_ms = next;
+    } else {
+        next = -1;
+    }
+    if (timeout_ms > INT_MAX) {
+        timeout_ms = INT_MAX;
+    }
+    while ((ret = poll(&pfd, 1, (int) timeout_ms)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+
+    if (ret < 0) {
+        LOG_WARN(sctx->log, "%s(): poll error: %s", __func__, strerror(errno));
+        return SENSOR_ERROR;
+    }
+    if (ret > 0) {
+        sensor_update_fd_drain(sctx);
+        return SENSOR_SUCCESS;
+    }
+    return next >= 0 ? SENSOR_SUCCESS : SENSOR_WAIT_TIMER;
+}
+
 
 /***************************************************************************
  * SENSOR_PROPERTIES
@@ -2346,6 +6671,109 @@ sensor_status_t sensor_property_init(sensor_property_t * property, const char *
     return SENSOR_SUCCESS;
 }
 
+/***************************************************************************
+ * SENSOR_ARENA
+ ***************************************************************************/
+#ifndef SENSOR_ARENA_CHUNK_SIZE
+# define SENSOR_ARENA_CHUNK_SIZE   (64 * 1024)
+#endif
+#define SENSOR_ARENA_ALIGN(_size) \
+            (((_size) + sizeof(long double) - 1) & ~(sizeof(long double) - 1))
+
+/** chunk of arena, its data follows the header */
+typedef struct sensor_arena_chunk_s {
+    struct sensor_arena_chunk_s *   next;
+    size_t                          size;
+    size_t                          used;
+    long double                     data[];
+} sensor_arena_chunk_t;
+
+struct sensor_arena_s {
+    sensor_arena_chunk_t *  chunks;
+    size_t                  chunk_size;
+    size_t                  total;
+};
+
+sensor_arena_t * sensor_arena_create(size_t chunk_size) {
+    sensor_arena_t * arena;
+
+    if ((arena = malloc(sizeof(*arena))) == NULL) {
+        return NULL;
+    }
+    arena->chunks = NULL;
+    arena->chunk_size = chunk_size == 0 ? SENSOR_ARENA_CHUNK_SIZE : chunk_size;
+    arena->total = 0;
+    return arena;
+}
+
+void * sensor_arena_alloc(sensor_arena_t * arena, size_t size) {
+    sensor_arena_chunk_t *  chunk;
+    void *                  ptr;
+
+    if (arena == NULL) {
+        return NULL;
+    }
+    size = SENSOR_ARENA_ALIGN(size == 0 ? 1 : size);
+    if ((chunk = arena->chunks) == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+
+        /* oversized allocations get their own chunk, behind the current one */
+        if ((chunk = calloc(1, sizeof(*chunk) + chunk_size)) == NULL) {
+            return NULL;
+        }
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        if (size > arena->chunk_size && arena->chunks != NULL) {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+        arena->total += sizeof(*chunk) + chunk_size;
+    }
+    ptr = ((char *) chunk->data) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+char * sensor_arena_strdup(sensor_arena_t * arena, const char * str) {
+    size_t  len = strlen(STR_CHECKNULL(str)) + 1;
+    char *  copy;
+
+    if ((copy = sensor_arena_alloc(arena, len)) != NULL) {
+        memcpy(copy, STR_CHECKNULL(str), len);
+    }
+    return copy;
+}
+
+sensor_property_t * sensor_arena_properties(sensor_arena_t * arena, unsigned int count) {
+    sensor_property_t * properties;
+
+    if ((properties = sensor_arena_alloc(arena, (count + 1) * sizeof(*properties))) == NULL) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i <= count; ++i) {
+        properties[i].name = NULL;
+        properties[i].value.type = SENSOR_VALUE_NULL;
+    }
+    return properties;
+}
+
+size_t sensor_arena_size(const sensor_arena_t * arena) {
+    return arena == NULL ? 0 : arena->total;
+}
+
+void sensor_arena_free(sensor_arena_t * arena) {
+    if (arena != NULL) {
+        for (sensor_arena_chunk_t * chunk = arena->chunks, * next; chunk != NULL; chunk = next) {
+            next = chunk->next;
+            free(chunk);
+        }
+        free(arena);
+    }
+}
+
 /***************************************************************************
  * SENSOR_VALUE : src/sensor_value.c
  ***************************************************************************/
@@ -0,0 +1,628 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Compressed long-horizon history of watched samples: chunks of bit-packed
+ * points, timestamps as delta-of-delta, floating values as XOR with the
+ * previous one, integers as zigzag delta - Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "vlib/log.h"
+
+#include "libvsensors/sensor.h"
+
+#include "sensor_private.h"
+
+/** number of points of a chunk before it is sealed */
+#ifndef SENSOR_ARCHIVE_CHUNK_POINTS
+# define SENSOR_ARCHIVE_CHUNK_POINTS    512
+#endif
+/** resolution of archived times in micro-seconds */
+#ifndef SENSOR_ARCHIVE_TIME_RES_US
+# define SENSOR_ARCHIVE_TIME_RES_US     1000
+#endif
+
+/**
+ * chunk of points of a same value type. The open chunk of an archive is grown
+ * by its update thread, sealed chunks are immutable and shared with iterators.
+ * Bits are written MSB first. First point: time and value bits (64 bits each).
+ * Next points:
+ *  - time: delta-of-delta d, zigzag encoded as z:
+ *          '0' (d=0), '10'+7 bits, '110'+9, '1110'+12, '11110'+32, '11111'+64.
+ *  - integers: zigzag encoded difference z with the previous value:
+ *          '0' (z=0), '10'+8 bits, '110'+16, '1110'+32, '1111'+64.
+ *  - floating: xor x with previous value bits: '0' (x=0), '10'+meaningful
+ *          bits if they fit in the previous window, else '11' + 6 bits leading
+ *          zeros + 6 bits (meaningful bits - 1) + meaningful bits.
+ */
+typedef struct sensor_archive_chunk_s {
+    struct sensor_archive_chunk_s * next;       /* newer chunk */
+    unsigned int                    refs;       /* archive + iterators */
+    unsigned int                    count;      /* number of points */
+    unsigned int                    type;       /* sensor_value_type_t */
+    size_t                          nbits;
+    size_t                          maxbytes;
+    int64_t                         first;      /* time of first point */
+    int64_t                         last;       /* time of last point */
+    unsigned char                   data[];
+} sensor_archive_chunk_t;
+
+/** encoding state, against the previous point */
+typedef struct {
+    int64_t         time;
+    int64_t         delta;
+    uint64_t        bits;
+    unsigned int    leading;
+    unsigned int    meaningful;     /* 0 if no xor window yet */
+} sensor_archive_state_t;
+
+struct sensor_archive_s {
+    pthread_mutex_t             mutex;      /* pushs vs queries */
+    sensor_archive_chunk_t *    oldest;     /* sealed chunks, oldest first */
+    sensor_archive_chunk_t *    newest;
+    sensor_archive_chunk_t *    open;       /* chunk being appended, or NULL */
+    sensor_archive_state_t      state;      /* encoding state of open chunk */
+    unsigned int                sealed_count;   /* points in sealed chunks */
+    unsigned int                sealed_chunks;
+    size_t                      sealed_bytes;
+};
+
+struct sensor_archive_iter_s {
+    sensor_archive_chunk_t **   chunks;     /* referenced chunks, oldest first */
+    unsigned int                n_chunks;
+    unsigned int                i_chunk;
+    unsigned int                i_point;    /* points decoded in current chunk */
+    size_t                      bitpos;
+    sensor_archive_state_t      state;
+    int64_t                     from;
+    int64_t                     to;
+};
+
+/* ************************************************************************
+ * BIT CODEC
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+static inline uint64_t archive_zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+/* ************************************************************************ */
+static inline int64_t archive_unzigzag(uint64_t value) {
+    return (int64_t) ((value >> 1) ^ (~(value & 1) + 1));
+}
+
+/* ************************************************************************ */
+static inline int64_t archive_time(const struct timeval * tv) {
+    return (int64_t) tv->tv_sec * (1000000 / SENSOR_ARCHIVE_TIME_RES_US)
+           + tv->tv_usec / SENSOR_ARCHIVE_TIME_RES_US;
+}
+
+/* ************************************************************************ */
+static inline void archive_timeval(int64_t time, struct timeval * tv) {
+    tv->tv_sec = time / (1000000 / SENSOR_ARCHIVE_TIME_RES_US);
+    tv->tv_usec = (time % (1000000 / SENSOR_ARCHIVE_TIME_RES_US)) * SENSOR_ARCHIVE_TIME_RES_US;
+}
+
+/* ************************************************************************ */
+/** append the n low bits of bits to the chunk, growing it, -1 on error */
+static int archive_put_bits(sensor_archive_chunk_t ** pchunk, uint64_t bits, unsigned int n) {
+    sensor_archive_chunk_t * chunk = *pchunk;
+
+    if (((chunk->nbits + n + 7) >> 3) > chunk->maxbytes) {
+        size_t maxbytes = chunk->maxbytes * 2;
+
+        if ((chunk = realloc(chunk, sizeof(*chunk) + maxbytes)) == NULL)
+            return -1;
+        memset(chunk->data + chunk->maxbytes, 0, maxbytes - chunk->maxbytes);
+        chunk->maxbytes = maxbytes;
+        *pchunk = chunk;
+    }
+    while (n > 0) {
+        unsigned int    room = 8 - (chunk->nbits & 7);
+        unsigned int    take = n < room ? n : room;
+        unsigned int    byte = (unsigned int) (bits >> (n - take)) & ((1U << take) - 1);
+
+        chunk->data[chunk->nbits >> 3] |= (unsigned char) (byte << (room - take));
+        chunk->nbits += take;
+        n -= take;
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+/** read n bits (<= 64) at *pos, 0 past the end of chunk */
+static uint64_t archive_get_bits(const sensor_archive_chunk_t * chunk, size_t * pos,
+                                 unsigned int n) {
+    uint64_t bits = 0;
+
+    while (n > 0 && *pos < chunk->nbits) {
+        unsigned int    avail = 8 - (*pos & 7);
+        unsigned int    take = n < avail ? n : avail;
+        unsigned int    byte = chunk->data[*pos >> 3];
+
+        bits = (bits << take) | ((byte >> (avail - take)) & ((1U << take) - 1));
+        *pos += take;
+        n -= take;
+    }
+    return n >= 64 ? 0 : bits << n;
+}
+
+/* ************************************************************************ */
+/** number of leading '1' of a prefix, at most max */
+static inline unsigned int archive_get_prefix(const sensor_archive_chunk_t * chunk,
+                                              size_t * pos, unsigned int max) {
+    unsigned int n = 0;
+
+    while (n < max && archive_get_bits(chunk, pos, 1) != 0)
+        ++n;
+    return n;
+}
+
+/* ************************************************************************ */
+/** integers zero or sign extended, floating bits (long double as double) */
+static uint64_t archive_value_bits(const sensor_value_t * value) {
+    switch (value->type) {
+        case SENSOR_VALUE_UCHAR:    return value->data.uc;
+        case SENSOR_VALUE_CHAR:     return (uint64_t) (int64_t) value->data.c;
+        case SENSOR_VALUE_UINT16:   return value->data.u16;
+        case SENSOR_VALUE_INT16:    return (uint64_t) (int64_t) value->data.i16;
+        case SENSOR_VALUE_UINT32:   return value->data.u32;
+        case SENSOR_VALUE_INT32:    return (uint64_t) (int64_t) value->data.i32;
+        case SENSOR_VALUE_UINT:     return value->data.ui;
+        case SENSOR_VALUE_INT:      return (uint64_t) (int64_t) value->data.i;
+        case SENSOR_VALUE_ULONG:    return value->data.ul;
+        case SENSOR_VALUE_LONG:     return (uint64_t) (int64_t) value->data.l;
+        case SENSOR_VALUE_UINT64:   return value->data.u64;
+        case SENSOR_VALUE_INT64:    return (uint64_t) value->data.i64;
+        case SENSOR_VALUE_FLOAT: {
+            uint32_t bits;
+            memcpy(&bits, &(value->data.f), sizeof(bits));
+            return bits;
+        }
+        case SENSOR_VALUE_DOUBLE:
+        case SENSOR_VALUE_LDOUBLE: {
+            double   d = value->type == SENSOR_VALUE_DOUBLE
+                         ? value->data.d : (double) value->data.ld;
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            return bits;
+        }
+        default:
+            return 0;
+    }
+}
+
+/* ************************************************************************ */
+/** reverse of archive_value_bits() */
+static void archive_value_setbits(sensor_value_t * value, unsigned int type, uint64_t bits) {
+    memset(value, 0, sizeof(*value));
+    value->type = type;
+    switch (type) {
+        case SENSOR_VALUE_UCHAR:    value->data.uc = (unsigned char) bits; break ;
+        case SENSOR_VALUE_CHAR:     value->data.c = (char) bits; break ;
+        case SENSOR_VALUE_UINT16:   value->data.u16 = (uint16_t) bits; break ;
+        case SENSOR_VALUE_INT16:    value->data.i16 = (int16_t) bits; break ;
+        case SENSOR_VALUE_UINT32:   value->data.u32 = (uint32_t) bits; break ;
+        case SENSOR_VALUE_INT32:    value->data.i32 = (int32_t) bits; break ;
+        case SENSOR_VALUE_UINT:     value->data.ui = (unsigned int) bits; break ;
+        case SENSOR_VALUE_INT:      value->data.i = (int) bits; break ;
+        case SENSOR_VALUE_ULONG:    value->data.ul = (unsigned long) bits; break ;
+        case SENSOR_VALUE_LONG:     value->data.l = (long) bits; break ;
+        case SENSOR_VALUE_UINT64:   value->data.u64 = bits; break ;
+        case SENSOR_VALUE_INT64:    value->data.i64 = (int64_t) bits; break ;
+        case SENSOR_VALUE_FLOAT: {
+            uint32_t u32 = (uint32_t) bits;
+            memcpy(&(value->data.f), &u32, sizeof(u32));
+            break ;
+        }
+        case SENSOR_VALUE_DOUBLE:
+            memcpy(&(value->data.d), &bits, sizeof(bits));
+            break ;
+        case SENSOR_VALUE_LDOUBLE: {
+            double d;
+            memcpy(&d, &bits, sizeof(bits));
+            value->data.ld = d;
+            break ;
+        }
+        default:
+            break ;
+    }
+}
+
+/* ************************************************************************ */
+/** append a point to the chunk, updating state, -1 on error */
+static int archive_encode(sensor_archive_chunk_t ** pchunk, sensor_archive_state_t * state,
+                          int64_t time, uint64_t bits) {
+    sensor_archive_chunk_t *    chunk = *pchunk;
+    int                         ret = 0;
+
+    if (chunk->count == 0) {
+        ret |= archive_put_bits(pchunk, (uint64_t) time, 64);
+        ret |= archive_put_bits(pchunk, bits, 64);
+        memset(state, 0, sizeof(*state));
+        state->time = time;
+        state->bits = bits;
+        return ret;
+    } else {
+        int64_t     delta = time - state->time;
+        uint64_t    z = archive_zigzag(delta - state->delta);
+
+        if (z == 0)                     ret |= archive_put_bits(pchunk, 0x0, 1);
+        else if (z < (1ULL << 7))       ret |= archive_put_bits(pchunk, (0x2ULL << 7) | z, 2 + 7);
+        else if (z < (1ULL << 9))       ret |= archive_put_bits(pchunk, (0x6ULL << 9) | z, 3 + 9);
+        else if (z < (1ULL << 12))      ret |= archive_put_bits(pchunk, (0xeULL << 12) | z, 4 + 12);
+        else if (z < (1ULL << 32))      ret |= archive_put_bits(pchunk, (0x1eULL << 32) | z, 5 + 32);
+        else {
+            ret |= archive_put_bits(pchunk, 0x1f, 5);
+            ret |= archive_put_bits(pchunk, z, 64);
+        }
+        state->delta = delta;
+        state->time = time;
+    }
+
+    if (SENSOR_VALUE_IS_FLOATING((*pchunk)->type)) {
+        uint64_t x = bits ^ state->bits;
+
+        if (x == 0) {
+            ret |= archive_put_bits(pchunk, 0x0, 1);
+        } else {
+            unsigned int leading = __builtin_clzll(x);
+            unsigned int trailing = __builtin_ctzll(x);
+
+            if (state->meaningful > 0 && leading >= state->leading
+            &&  trailing >= 64 - state->leading - state->meaningful) {
+                ret |= archive_put_bits(pchunk, 0x2, 2);
+                ret |= archive_put_bits(pchunk, x >> (64 - state->leading - state->meaningful),
+                                        state->meaningful);
+            } else {
+                state->leading = leading;
+                state->meaningful = 64 - leading - trailing;
+                ret |= archive_put_bits(pchunk, (0x3ULL << 12) | (leading << 6)
+                                                | (state->meaningful - 1), 2 + 6 + 6);
+                ret |= archive_put_bits(pchunk, x >> trailing, state->meaningful);
+            }
+        }
+    } else {
+        uint64_t z = archive_zigzag((int64_t) (bits - state->bits));
+
+        if (z == 0)                     ret |= archive_put_bits(pchunk, 0x0, 1);
+        else if (z < (1ULL << 8))       ret |= archive_put_bits(pchunk, (0x2ULL << 8) | z, 2 + 8);
+        else if (z < (1ULL << 16))      ret |= archive_put_bits(pchunk, (0x6ULL << 16) | z, 3 + 16);
+        else if (z < (1ULL << 32))      ret |= archive_put_bits(pchunk, (0xeULL << 32) | z, 4 + 32);
+        else {
+            ret |= archive_put_bits(pchunk, 0xf, 4);
+            ret |= archive_put_bits(pchunk, z, 64);
+        }
+    }
+    state->bits = bits;
+    return ret;
+}
+
+/* ************************************************************************ */
+/** decode the point following state at *pos, updating state */
+static void archive_decode(const sensor_archive_chunk_t * chunk, size_t * pos,
+                           sensor_archive_state_t * state, unsigned int index) {
+    static const unsigned int   time_bits[] = { 0, 7, 9, 12, 32, 64 };
+    static const unsigned int   int_bits[] = { 0, 8, 16, 32, 64 };
+
+    if (index == 0) {
+        memset(state, 0, sizeof(*state));
+        state->time = (int64_t) archive_get_bits(chunk, pos, 64);
+        state->bits = archive_get_bits(chunk, pos, 64);
+        return ;
+    }
+    state->delta += archive_unzigzag(archive_get_bits(chunk, pos,
+                        time_bits[archive_get_prefix(chunk, pos, 5)]));
+    state->time += state->delta;
+
+    if (SENSOR_VALUE_IS_FLOATING(chunk->type)) {
+        switch (archive_get_prefix(chunk, pos, 2)) {
+            case 0:
+                break ;
+            case 2:
+                state->leading = (unsigned int) archive_get_bits(chunk, pos, 6);
+                state->meaningful = (unsigned int) archive_get_bits(chunk, pos, 6) + 1;
+                /* fall through */
+            default:
+                state->bits ^= archive_get_bits(chunk, pos, state->meaningful)
+                               << (64 - state->leading - state->meaningful);
+                break ;
+        }
+    } else {
+        state->bits += (uint64_t) archive_unzigzag(archive_get_bits(chunk, pos,
+                            int_bits[archive_get_prefix(chunk, pos, 4)]));
+    }
+}
+
+/* ************************************************************************
+ * CHUNKS
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+static sensor_archive_chunk_t * archive_chunk_create(unsigned int type) {
+    sensor_archive_chunk_t *    chunk;
+    size_t                      maxbytes = 64;
+
+    if ((chunk = calloc(1, sizeof(*chunk) + maxbytes)) == NULL)
+        return NULL;
+    chunk->maxbytes = maxbytes;
+    chunk->type = type;
+    chunk->refs = 1;
+    return chunk;
+}
+
+/* ************************************************************************ */
+static void archive_chunk_release(sensor_archive_chunk_t * chunk) {
+    if (chunk != NULL && __atomic_sub_fetch(&(chunk->refs), 1, __ATOMIC_ACQ_REL) == 0)
+        free(chunk);
+}
+
+/* ************************************************************************ */
+static inline size_t archive_chunk_size(const sensor_archive_chunk_t * chunk) {
+    return sizeof(*chunk) + chunk->maxbytes;
+}
+
+/* ************************************************************************ */
+/** shrink the open chunk to its data and append it to sealed ones */
+static void archive_seal(sensor_archive_t * archive) {
+    sensor_archive_chunk_t * chunk = archive->open;
+    size_t                   size = (chunk->nbits + 7) >> 3;
+
+    archive->open = NULL;
+    if (size < chunk->maxbytes) {
+        sensor_archive_chunk_t * shrinked = realloc(chunk, sizeof(*chunk) + size);
+
+        if (shrinked != NULL) {
+            chunk = shrinked;
+            chunk->maxbytes = size;
+        }
+    }
+    chunk->next = NULL;
+    if (archive->newest != NULL)
+        archive->newest->next = chunk;
+    else
+        archive->oldest = chunk;
+    archive->newest = chunk;
+    archive->sealed_count += chunk->count;
+    ++archive->sealed_chunks;
+    archive->sealed_bytes += archive_chunk_size(chunk);
+}
+
+/* ************************************************************************ */
+/** drop the oldest sealed chunks not needed to keep max_points points */
+static void archive_trim(sensor_archive_t * archive, unsigned int max_points) {
+    unsigned int open_count = archive->open != NULL ? archive->open->count : 0;
+
+    while (archive->oldest != NULL
+           && archive->sealed_count - archive->oldest->count + open_count >= max_points) {
+        sensor_archive_chunk_t * chunk = archive->oldest;
+
+        if ((archive->oldest = chunk->next) == NULL)
+            archive->newest = NULL;
+        archive->sealed_count -= chunk->count;
+        --archive->sealed_chunks;
+        archive->sealed_bytes -= archive_chunk_size(chunk);
+        archive_chunk_release(chunk);
+    }
+}
+
+/* ************************************************************************
+ * ARCHIVE
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+void sensor_archive_push(sensor_sample_t * sample, const struct timeval * now) {
+    sensor_archive_t *  archive = __atomic_load_n(&(sample->archive), __ATOMIC_ACQUIRE);
+    int64_t             time = archive_time(now);
+    int                 ret;
+
+    if (SENSOR_VALUE_IS_BUFFER(sample->value.type) || sample->value.type == SENSOR_VALUE_NULL) {
+        return ;
+    }
+    if (archive == NULL) {
+        /* only the thread updating the sample creates its archive */
+        if ((archive = calloc(1, sizeof(*archive))) == NULL) {
+            return ;
+        }
+        pthread_mutex_init(&(archive->mutex), NULL);
+        __atomic_store_n(&(sample->archive), archive, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_lock(&(archive->mutex));
+    if (archive->open != NULL
+    &&  (archive->open->type != sample->value.type || time < archive->open->last
+         || archive->open->count >= SENSOR_ARCHIVE_CHUNK_POINTS)) {
+        /* chunk full, new value type, or clock going backward */
+        archive_seal(archive);
+    }
+    if (archive->open == NULL && (archive->open = archive_chunk_create(sample->value.type)) == NULL) {
+        pthread_mutex_unlock(&(archive->mutex));
+        return ;
+    }
+    if ((ret = archive_encode(&(archive->open), &(archive->state), time,
+                              archive_value_bits(&(sample->value)))) == 0) {
+        if (archive->open->count++ == 0)
+            archive->open->first = time;
+        archive->open->last = time;
+    } else {
+        /* a partially written point cannot be decoded: drop the open chunk */
+        archive_chunk_release(archive->open);
+        archive->open = NULL;
+    }
+    archive_trim(archive, sample->watch->archive_size);
+    pthread_mutex_unlock(&(archive->mutex));
+
+    if (ret != 0) {
+        LOG_WARN(sensor_ctx_log(sample->desc->family->sctx), "cannot grow archive of '%s/%s'",
+                 sample->desc->family->info->name, STR_CHECKNULL(sample->desc->label));
+    }
+}
+
+/* ************************************************************************ */
+void sensor_archive_free(sensor_archive_t * archive) {
+    if (archive == NULL)
+        return ;
+    for (sensor_archive_chunk_t * chunk = archive->oldest, * next; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        archive_chunk_release(chunk);
+    }
+    archive_chunk_release(archive->open);
+    pthread_mutex_destroy(&(archive->mutex));
+    free(archive);
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_archive_stats(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    sensor_archive_stats_t *    stats) {
+    sensor_archive_t * archive;
+
+    if (sctx == NULL || sample == NULL || stats == NULL) {
+        return SENSOR_ERROR;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    if ((archive = __atomic_load_n(&(sample->archive), __ATOMIC_ACQUIRE)) == NULL) {
+        sensor_unlock(sctx);
+        return SENSOR_ERROR;
+    }
+    pthread_mutex_lock(&(archive->mutex));
+    stats->count = archive->sealed_count;
+    stats->chunks = archive->sealed_chunks;
+    stats->bytes = sizeof(*archive) + archive->sealed_bytes;
+    if (archive->open != NULL) {
+        stats->count += archive->open->count;
+        ++stats->chunks;
+        stats->bytes += archive_chunk_size(archive->open);
+    }
+    if (stats->count > 0) {
+        archive_timeval(archive->oldest != NULL ? archive->oldest->first : archive->open->first,
+                        &(stats->first));
+        archive_timeval(archive->open != NULL ? archive->open->last : archive->newest->last,
+                        &(stats->last));
+    }
+    pthread_mutex_unlock(&(archive->mutex));
+    sensor_unlock(sctx);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_archive_iter_t * sensor_archive_query(
+                    sensor_ctx_t *              sctx,
+                    const sensor_sample_t *     sample,
+                    const struct timeval *      from,
+                    const struct timeval *      to) {
+    sensor_archive_t *      archive;
+    sensor_archive_iter_t * iter;
+    int64_t                 tfrom = from != NULL ? archive_time(from) : INT64_MIN;
+    int64_t                 tto = to != NULL ? archive_time(to) : INT64_MAX;
+
+    if (sctx == NULL || sample == NULL || (iter = calloc(1, sizeof(*iter))) == NULL) {
+        return NULL;
+    }
+    iter->from = tfrom;
+    iter->to = tto;
+
+    sensor_lock(sctx, SENSOR_LOCK_READ);
+    if ((archive = __atomic_load_n(&(sample->archive), __ATOMIC_ACQUIRE)) == NULL) {
+        sensor_unlock(sctx);
+        free(iter);
+        return NULL;
+    }
+    pthread_mutex_lock(&(archive->mutex));
+    if ((iter->chunks = malloc((archive->sealed_chunks + 1) * sizeof(*iter->chunks))) == NULL) {
+        pthread_mutex_unlock(&(archive->mutex));
+        sensor_unlock(sctx);
+        free(iter);
+        return NULL;
+    }
+    /* reference the sealed chunks in range, they are immutable */
+    for (sensor_archive_chunk_t * chunk = archive->oldest; chunk != NULL; chunk = chunk->next) {
+        if (chunk->last < tfrom || chunk->first > tto)
+            continue ;
+        __atomic_add_fetch(&(chunk->refs), 1, __ATOMIC_RELAXED);
+        iter->chunks[iter->n_chunks++] = chunk;
+    }
+    /* copy the open chunk, which is appended by updates */
+    if (archive->open != NULL && archive->open->count > 0
+    &&  archive->open->last >= tfrom && archive->open->first <= tto) {
+        size_t                   size = (archive->open->nbits + 7) >> 3;
+        sensor_archive_chunk_t * copy = malloc(sizeof(*copy) + size);
+
+        if (copy != NULL) {
+            memcpy(copy, archive->open, sizeof(*copy) + size);
+            copy->maxbytes = size;
+            copy->refs = 1;
+            copy->next = NULL;
+            iter->chunks[iter->n_chunks++] = copy;
+        }
+    }
+    pthread_mutex_unlock(&(archive->mutex));
+    sensor_unlock(sctx);
+
+    return iter;
+}
+
+/* ************************************************************************ */
+int sensor_archive_next(sensor_archive_iter_t * iter, sensor_history_point_t * point) {
+    if (iter == NULL || point == NULL) {
+        return -1;
+    }
+    while (iter->i_chunk < iter->n_chunks) {
+        const sensor_archive_chunk_t * chunk = iter->chunks[iter->i_chunk];
+
+        while (iter->i_point < chunk->count) {
+            archive_decode(chunk, &(iter->bitpos), &(iter->state), iter->i_point++);
+            if (iter->state.time > iter->to) {
+                /* past the range, next chunk can be older if the clock went backward */
+                iter->i_point = chunk->count;
+            } else if (iter->state.time >= iter->from) {
+                archive_timeval(iter->state.time, &(point->time));
+                archive_value_setbits(&(point->value), chunk->type, iter->state.bits);
+                return 1;
+            }
+        }
+        /* chunk decoded: release it now, iterations can be long */
+        archive_chunk_release(iter->chunks[iter->i_chunk]);
+        iter->chunks[iter->i_chunk++] = NULL;
+        iter->i_point = 0;
+        iter->bitpos = 0;
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+void sensor_archive_iter_free(sensor_archive_iter_t * iter) {
+    if (iter == NULL)
+        return ;
+    for (unsigned int i = iter->i_chunk; i < iter->n_chunks; ++i) {
+        archive_chunk_release(iter->chunks[i]);
+    }
+    if (iter->chunks != NULL)
+        free(iter->chunks);
+    free(iter);
+}
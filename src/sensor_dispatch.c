@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Deferred delivery of watch events by a dedicated thread, out of the
+ * sampling path - Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "vlib/log.h"
+
+#include "libvsensors/sensor.h"
+
+#include "sensor_private.h"
+
+/** milli-seconds the dispatcher waits for the end of an update pass */
+#define SENSOR_DISPATCH_IDLE_MS     100
+/** milli-seconds a SDO_BLOCK producer waits between two attempts */
+#define SENSOR_DISPATCH_BLOCK_MS    10
+/** milli-seconds a SDO_BLOCK update pass waits at most, before dropping its events:
+ * it holds the read lock needed by the dispatcher, which a queued writer can
+ * prevent it from taking */
+#define SENSOR_DISPATCH_BLOCK_MAX_MS 100
+
+/** ring cell: seq is the position for which the cell is writable (seq == pos),
+ * or readable (seq == pos + 1), see sensor_common_queue_add() */
+typedef struct {
+    unsigned long               seq;
+    sensor_dispatch_event_t     event;
+    unsigned int                generation; /* of sample when event was posted */
+} sensor_dispatch_cell_t;
+
+struct sensor_dispatch_s {
+    sensor_ctx_t *              sctx;
+    log_t *                     log;
+    sensor_dispatch_batch_t     batch;      /* NULL for watch callbacks */
+    void *                      user_data;
+    sensor_dispatch_overflow_t  overflow;
+    unsigned long               dropped;    /* events dropped since last delivery */
+    /* bounded MPMC ring: producers are the update threads, consumer is the
+     * dispatcher thread, and producers dropping the oldest event (D.Vyukov) */
+    sensor_dispatch_cell_t *    ring;
+    unsigned int                size;       /* power of 2 */
+    unsigned long               head;
+    unsigned long               tail;
+    sensor_dispatch_event_t *   events;     /* batch delivered */
+    /* dispatcher thread */
+    pthread_t                   thread;
+    pthread_mutex_t             mutex;
+    pthread_cond_t              cond;       /* pass ended, or stop */
+    pthread_cond_t              space;      /* events consumed, for SDO_BLOCK */
+    int                         b_flush;
+    int                         b_running;
+    int                         b_timedout; /* SDO_BLOCK wait timed out in this pass */
+};
+
+/* ************************************************************************ */
+/** time in ms from now for pthread_cond_timedwait() */
+static void sensor_dispatch_deadline(struct timespec * ts, long ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ++(ts->tv_sec);
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* ************************************************************************ */
+/** lock-free enqueue, -1 if ring is full */
+static int sensor_dispatch_push(sensor_dispatch_t * d, const sensor_dispatch_event_t * event) {
+    unsigned long pos = __atomic_load_n(&(d->head), __ATOMIC_RELAXED);
+
+    while (1) {
+        sensor_dispatch_cell_t *    cell = &(d->ring[pos & (d->size - 1)]);
+        long                        dif  = (long) (__atomic_load_n(&(cell->seq), __ATOMIC_ACQUIRE) - pos);
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&(d->head), &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->event = *event;
+                cell->generation = event->sample->generation;
+                __atomic_store_n(&(cell->seq), pos + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+        } else if (dif < 0) {
+            return -1; /* ring full */
+        } else {
+            pos = __atomic_load_n(&(d->head), __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* ************************************************************************ */
+/** lock-free dequeue of the oldest event, -1 if ring is empty */
+static int sensor_dispatch_pop(sensor_dispatch_t * d, sensor_dispatch_event_t * event,
+                               unsigned int * p_generation) {
+    unsigned long pos = __atomic_load_n(&(d->tail), __ATOMIC_RELAXED);
+
+    while (1) {
+        sensor_dispatch_cell_t *    cell = &(d->ring[pos & (d->size - 1)]);
+        long                        dif  = (long) (__atomic_load_n(&(cell->seq), __ATOMIC_ACQUIRE)
+                                                   - (pos + 1));
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&(d->tail), &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                if (event != NULL)
+                    *event = cell->event;
+                if (p_generation != NULL)
+                    *p_generation = cell->generation;
+                __atomic_store_n(&(cell->seq), pos + d->size, __ATOMIC_RELEASE);
+                return 0;
+            }
+        } else if (dif < 0) {
+            return -1; /* ring empty */
+        } else {
+            pos = __atomic_load_n(&(d->tail), __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* ************************************************************************ */
+void sensor_dispatch_post(sensor_dispatch_t * d, sensor_sample_t * sample,
+                          unsigned int event, const sensor_watch_ev_data_t * ev_data) {
+    sensor_dispatch_event_t ev;
+    unsigned int            waits = 0;
+
+    ev.sample = sample;
+    ev.event = event;
+    ev.level = (event & SWE_WATCH_LEVEL) != 0 && ev_data != NULL ? ev_data->level : sample->level;
+    ev.time_ns = sample->acquired_ns;
+    if (SENSOR_VALUE_IS_BUFFER(sample->value.type)) {
+        memset(&(ev.value), 0, sizeof(ev.value));
+        ev.value.type = sample->value.type;
+    } else {
+        ev.value = sample->value;
+    }
+
+    while (sensor_dispatch_push(d, &ev) != 0) {
+        if (d->overflow == SDO_DROP_OLD && sensor_dispatch_pop(d, NULL, NULL) == 0) {
+            __atomic_add_fetch(&(d->dropped), 1, __ATOMIC_RELAXED);
+            continue ;
+        }
+        /* once a wait timed out, the pass drops its events without waiting */
+        if (d->overflow == SDO_BLOCK && !pthread_equal(pthread_self(), d->thread)
+        &&  !__atomic_load_n(&(d->b_timedout), __ATOMIC_RELAXED)) {
+            struct timespec ts;
+
+            if (waits++ >= SENSOR_DISPATCH_BLOCK_MAX_MS / SENSOR_DISPATCH_BLOCK_MS) {
+                /* until next sensor_dispatch_flush() */
+                __atomic_store_n(&(d->b_timedout), 1, __ATOMIC_RELAXED);
+            } else {
+                sensor_dispatch_deadline(&ts, SENSOR_DISPATCH_BLOCK_MS);
+                pthread_mutex_lock(&(d->mutex));
+                if (d->b_running) {
+                    d->b_flush = 1;
+                    pthread_cond_signal(&(d->cond));
+                    pthread_cond_timedwait(&(d->space), &(d->mutex), &ts);
+                    pthread_mutex_unlock(&(d->mutex));
+                    continue ;
+                }
+                pthread_mutex_unlock(&(d->mutex));
+            }
+        }
+        /* SDO_DROP_NEW, SDO_BLOCK timeout, or blocking the dispatcher itself */
+        __atomic_add_fetch(&(d->dropped), 1, __ATOMIC_RELAXED);
+        break ;
+    }
+}
+
+/* ************************************************************************ */
+void sensor_dispatch_flush(sensor_dispatch_t * d) {
+    /* next pass can wait again */
+    __atomic_store_n(&(d->b_timedout), 0, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&(d->mutex));
+    d->b_flush = 1;
+    pthread_cond_signal(&(d->cond));
+    pthread_mutex_unlock(&(d->mutex));
+}
+
+/* ************************************************************************ */
+/** deliver the events of the ring, one batch per ring capacity, 0 if none */
+static unsigned int sensor_dispatch_deliver(sensor_dispatch_t * d) {
+    unsigned int    n = 0, total = 0, generation;
+    unsigned long   dropped, stale;
+
+    do {
+        sensor_lock(d->sctx, SENSOR_LOCK_READ);
+        /* events posted before their sample was freed are forgotten: the write lock
+         * was held to free it, and the generation of its slab slot, which stays
+         * allocated with its family, is stable under read lock. */
+        for (n = 0, stale = 0; n < d->size
+                               && sensor_dispatch_pop(d, &(d->events[n]), &generation) == 0; ) {
+            if (generation == d->events[n].sample->generation)
+                ++n;
+            else
+                ++stale;
+        }
+        dropped = __atomic_exchange_n(&(d->dropped), 0, __ATOMIC_RELAXED) + stale;
+        if (d->batch != NULL) {
+            if (n > 0 || dropped > 0)
+                d->batch(d->sctx, d->events, n, dropped, d->user_data);
+        } else {
+            for (unsigned int i = 0; i < n; ++i) {
+                sensor_sample_t *       sample = d->events[i].sample;
+                sensor_watch_ev_data_t  ev_data = { .level = d->events[i].level };
+
+                if (sample->watch->callback != NULL) {
+                    sample->watch->callback(d->events[i].event, d->sctx, sample,
+                                            (d->events[i].event & SWE_WATCH_LEVEL) != 0
+                                            ? &ev_data : NULL, sample->watch->callback_data);
+                }
+            }
+            if (dropped > 0) {
+                LOG_VERBOSE(d->log, "dispatch: %lu watch events dropped", dropped);
+            }
+        }
+        sensor_unlock(d->sctx);
+
+        if (n > 0 && d->overflow == SDO_BLOCK) {
+            pthread_mutex_lock(&(d->mutex));
+            pthread_cond_broadcast(&(d->space));
+            pthread_mutex_unlock(&(d->mutex));
+        }
+        total += n;
+    } while (n == d->size);
+
+    return total;
+}
+
+/* ************************************************************************ */
+static void * sensor_dispatch_thread(void * vdispatch) {
+    sensor_dispatch_t * d = (sensor_dispatch_t *) vdispatch;
+    int                 b_running = 1;
+
+    while (b_running) {
+        struct timespec ts;
+
+        sensor_dispatch_deadline(&ts, SENSOR_DISPATCH_IDLE_MS);
+        pthread_mutex_lock(&(d->mutex));
+        while (d->b_running && !d->b_flush) {
+            if (pthread_cond_timedwait(&(d->cond), &(d->mutex), &ts) == ETIMEDOUT)
+                break ;
+        }
+        d->b_flush = 0;
+        b_running = d->b_running;
+        pthread_mutex_unlock(&(d->mutex));
+
+        /* events of the last passes are delivered before stopping */
+        sensor_dispatch_deliver(d);
+    }
+    return NULL;
+}
+
+/* ************************************************************************ */
+static void sensor_dispatch_free(sensor_dispatch_t * d) {
+    if (d->ring != NULL)
+        free(d->ring);
+    if (d->events != NULL)
+        free(d->events);
+    pthread_cond_destroy(&(d->space));
+    pthread_cond_destroy(&(d->cond));
+    pthread_mutex_destroy(&(d->mutex));
+    free(d);
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_dispatch_start(
+                    sensor_ctx_t *              sctx,
+                    unsigned int                capacity,
+                    sensor_dispatch_overflow_t  overflow,
+                    sensor_dispatch_batch_t     batch,
+                    void *                      user_data) {
+    sensor_dispatch_t * d;
+    unsigned int        size;
+
+    if (sctx == NULL || capacity == 0 || capacity > (UINT_MAX / 2) / sizeof(*d->ring)
+    ||  (overflow != SDO_DROP_NEW && overflow != SDO_DROP_OLD && overflow != SDO_BLOCK)) {
+        return SENSOR_ERROR;
+    }
+    for (size = 2; size < capacity; size *= 2)
+        ; /* nothing but loop */
+    if ((d = calloc(1, sizeof(*d))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    d->sctx = sctx;
+    d->log = sensor_ctx_log(sctx);
+    d->batch = batch;
+    d->user_data = user_data;
+    d->overflow = overflow;
+    d->size = size;
+    d->b_running = 1;
+    pthread_mutex_init(&(d->mutex), NULL);
+    pthread_cond_init(&(d->cond), NULL);
+    pthread_cond_init(&(d->space), NULL);
+    if ((d->ring = malloc(size * sizeof(*d->ring))) == NULL
+    ||  (d->events = malloc(size * sizeof(*d->events))) == NULL) {
+        sensor_dispatch_free(d);
+        return SENSOR_ERROR;
+    }
+    for (unsigned int i = 0; i < size; ++i) {
+        d->ring[i].seq = i;
+    }
+    if (pthread_create(&(d->thread), NULL, sensor_dispatch_thread, d) != 0) {
+        LOG_ERROR(d->log, "dispatch: cannot create thread: %s", strerror(errno));
+        sensor_dispatch_free(d);
+        return SENSOR_ERROR;
+    }
+    if (sensor_dispatch_attach(sctx, d) != SENSOR_SUCCESS) {
+        sensor_dispatch_destroy(d);
+        return SENSOR_ERROR;
+    }
+    LOG_VERBOSE(d->log, "dispatch: started, %u events", size);
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+void sensor_dispatch_destroy(sensor_dispatch_t * d) {
+    if (d == NULL)
+        return ;
+    pthread_mutex_lock(&(d->mutex));
+    d->b_running = 0;
+    pthread_cond_signal(&(d->cond));
+    pthread_cond_broadcast(&(d->space));
+    pthread_mutex_unlock(&(d->mutex));
+    pthread_join(d->thread, NULL);
+    sensor_dispatch_free(d);
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_dispatch_stop(sensor_ctx_t * sctx) {
+    sensor_dispatch_t * d;
+
+    if (sctx == NULL || (d = sensor_dispatch_detach(sctx)) == NULL) {
+        return SENSOR_ERROR;
+    }
+    sensor_dispatch_destroy(d);
+    return SENSOR_SUCCESS;
+}
@@ -22,6 +22,7 @@
 #ifndef LIBVSENSORS_SENSOR_PRIVATE_H
 # define LIBVSENSORS_SENSOR_PRIVATE_H
 
+# include <sys/types.h>
 # include <stdlib.h>
 
 # include "vlib/util.h"
@@ -40,13 +41,161 @@
 /* common family for utilities, not registering any sensor */
 extern const sensor_family_info_t g_sensor_family_common;
 
+/** prefix of the system files read by sysdeps, "" on the live system, see
+ * sensor_init_sysroot(): paths are built as "%s" CPU_PROC_FILE, sensor_sysroot(). */
+const char *    sensor_sysroot(const sensor_family_t * family);
+
+/** typed value operations of a sample: the ones of its desc when they are bound
+ * for the type of its value, see sensor_desc_t.ops */
+# define SENSOR_SAMPLE_OPS(_sample) \
+            (SENSOR_LIKELY((_sample)->desc->ops != NULL \
+                           && (_sample)->desc->ops->type == (_sample)->value.type) \
+             ? (_sample)->desc->ops : sensor_value_ops((_sample)->value.type))
+
 /* ************************************************************************ */
+# include <stdint.h>
+
+/** log2 buckets of update durations in ns, see sensor_family_stats_t */
+# define SENSOR_STATS_HIST_NB   32
+
+/** self-instrumentation counters of a family, cumulated since sensor_init().
+ * They are kept per thread shard and aggregated by sensor_family_stats_get(). */
+typedef struct {
+    uint64_t    updates;        /* update() or update_batch() calls */
+    uint64_t    update_ns;      /* duration of these calls */
+    uint64_t    update_hist[SENSOR_STATS_HIST_NB]; /* calls by log2 of their duration in ns */
+    uint64_t    ticks;          /* sensor_update_{get,fill}() with due samples of family */
+    uint64_t    updated;        /* samples SENSOR_UPDATED by these ticks */
+    uint64_t    unchanged;      /* samples SENSOR_UNCHANGED by these ticks */
+    uint64_t    reads;          /* reads counted by sensor_family_stats_reads() */
+    uint64_t    reloads;        /* SENSOR_RELOAD_FAMILY handled */
+    uint64_t    reload_ns;      /* duration of these reloads */
+} sensor_family_stats_t;
+
+/** libvsensors-wide counters, aggregated as sensor_family_stats_t */
+typedef struct {
+    uint64_t    lock_waits;     /* sensor_lock() calls which had to wait */
+    uint64_t    lock_wait_ns;   /* time spent waiting in sensor_lock() */
+} sensor_ctx_stats_t;
+
+/* tracepoints, see SENSOR_TRACE in sensor.h. SENSOR_TRACE_DECL() declares
+ * the start time of a traced operation, set by SENSOR_TRACE_BEGIN() if active. */
+# ifdef SENSOR_ENABLE_TRACE
+#  define SENSOR_TRACE_DECL(_t0)                    uint64_t _t0 = 0
+#  define SENSOR_TRACE_BEGIN(_t0, _tp, _fam, _n)    \
+            do { if (SENSOR_TRACE_ACTIVE()) _t0 = sensor_trace_begin(_tp, _fam, _n); } while (0)
+#  define SENSOR_TRACE_END(_t0, _tp, _fam, _n)      \
+            do { if (_t0 != 0) sensor_trace_end(_tp, _fam, _n, _t0); } while (0)
+#  ifdef SENSOR_ENABLE_USDT
+#   define SENSOR_TRACE_ACTIVE()    1
+#  else
+#   define SENSOR_TRACE_ACTIVE() \
+            (__atomic_load_n(&g_sensor_trace_hook, __ATOMIC_RELAXED) != NULL)
+#  endif
+extern sensor_trace_hook_t g_sensor_trace_hook;
+uint64_t    sensor_trace_begin(sensor_tracepoint_t tracepoint, const char * family,
+                               unsigned int samples);
+void        sensor_trace_end(sensor_tracepoint_t tracepoint, const char * family,
+                             unsigned int samples, uint64_t start_ns);
+# else
+#  define SENSOR_TRACE_DECL(_t0)
+#  define SENSOR_TRACE_BEGIN(_t0, _tp, _fam, _n)    do { (void) (_n); } while (0)
+#  define SENSOR_TRACE_END(_t0, _tp, _fam, _n)      do { (void) (_n); } while (0)
+# endif
+
+/* self family, instrumentation of libvsensors */
+extern const sensor_family_info_t g_sensor_family_self;
+
 # ifdef __cplusplus
 extern "C" {
 # endif
 
 void                sensor_value_info_init();
 
+/** sysdeps count the reads (system calls) done to retrieve the family data */
+void                sensor_family_stats_reads(sensor_family_t * family, unsigned int n);
+
+/** aggregate the counters of all threads */
+void                sensor_family_stats_get(const sensor_family_t * family,
+                                            sensor_family_stats_t * stats);
+void                sensor_ctx_stats_get(sensor_ctx_t * sctx, sensor_ctx_stats_t * stats);
+
+/** update duration in ns below which percent % of update_hist calls are, 0 if none */
+uint64_t            sensor_family_stats_percentile(const sensor_family_stats_t * stats,
+                                                   unsigned int percent);
+
+/** families registered in sensor context, under sensor lock */
+const slist_t *     sensor_family_list_get(sensor_ctx_t * sctx);
+
+/** process-wide reader of a system file shared by the sysdeps of all sensor
+ * contexts: data read by a context is reused by the other ones during
+ * SENSOR_PROVIDER_MAX_AGE_MS, see sensor_provider_pread() */
+typedef struct sensor_provider_s sensor_provider_t;
+
+/** reference the provider of path (including sensor_sysroot()), NULL on error */
+sensor_provider_t * sensor_provider_get(const char * path);
+
+/** release a reference of sensor_provider_get(), provider can be NULL */
+void                sensor_provider_release(sensor_provider_t * provider);
+
+/** pread(fd, buf, size, 0) of the provider file opened by caller, retrying on
+ * EINTR, from the snapshot of another context if it is recent enough.
+ * The system reads are counted for family. provider can be NULL. */
+ssize_t             sensor_provider_pread(sensor_provider_t *  provider,
+                                          sensor_family_t *    family,
+                                          int                  fd,
+                                          char *               buf,
+                                          size_t               size);
+
+/** compressed archive of a sample, see sensor_archive.c */
+typedef struct sensor_archive_s sensor_archive_t;
+
+/** append the sample value at time now to its archive, created if needed.
+ * Called by the thread updating sample, under read lock. */
+void                sensor_archive_push(sensor_sample_t * sample, const struct timeval * now);
+
+/** free an archive, under write lock. archive can be NULL */
+void                sensor_archive_free(sensor_archive_t * archive);
+
+/** deferred watch events, see sensor_dispatch.c */
+typedef struct sensor_dispatch_s sensor_dispatch_t;
+
+/** set the dispatcher of the context under write lock, error if it has one */
+sensor_status_t     sensor_dispatch_attach(sensor_ctx_t * sctx, sensor_dispatch_t * d);
+/** remove the dispatcher of the context under write lock, NULL if none */
+sensor_dispatch_t * sensor_dispatch_detach(sensor_ctx_t * sctx);
+/** enqueue a watch event, under read lock */
+void                sensor_dispatch_post(sensor_dispatch_t * d, sensor_sample_t * sample,
+                                         unsigned int event,
+                                         const sensor_watch_ev_data_t * ev_data);
+/** end of an update pass: wake up the dispatcher thread */
+void                sensor_dispatch_flush(sensor_dispatch_t * d);
+/** stop the thread of a detached dispatcher, delivering pending events, and free it */
+void                sensor_dispatch_destroy(sensor_dispatch_t * d);
+
+/** log of sensor context */
+log_t *             sensor_ctx_log(sensor_ctx_t * sctx);
+
+/** servers of sensor_stream_serve(), attached to the context under write lock,
+ * run by the update passes under read lock, see sensor_stream.c */
+sensor_status_t     sensor_stream_attach(sensor_ctx_t * sctx, sensor_stream_t * stream,
+                                         int b_attach);
+void                sensor_stream_run(sensor_stream_t *           stream,
+                                      const slist_t *             watchlist,
+                                      const slist_t *             list,
+                                      sensor_sample_t * const *   samples,
+                                      unsigned int                n_samples);
+/** forget the sensors sent as descs are going to be freed, under write lock */
+void                sensor_stream_reset(sensor_stream_t * stream);
+void                sensor_stream_destroy(void * vstream);
+
+/** remote families of a context created by sensor_stream_connect(), freed
+ * by sensor_free() after the families */
+typedef struct sensor_stream_mirror_s sensor_stream_mirror_t;
+void                sensor_stream_mirror_attach(sensor_ctx_t * sctx,
+                                                sensor_stream_mirror_t * mirror);
+void                sensor_stream_mirror_free(sensor_stream_mirror_t * mirror);
+
 # ifdef __cplusplus
 }
 # endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Process-wide providers of system files shared by the sysdeps of several
+ * sensor contexts - Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "vlib/time.h"
+
+#include "sensor_private.h"
+
+/** age below which a snapshot read by a context is given to other ones */
+#ifndef SENSOR_PROVIDER_MAX_AGE_MS
+# define SENSOR_PROVIDER_MAX_AGE_MS 10
+#endif
+
+struct sensor_provider_s {
+    struct sensor_provider_s *  next;
+    char *                      path;
+    unsigned int                refs;       /* under s_providers_mutex */
+    pthread_mutex_t             mutex;      /* protects the snapshot */
+    char *                      buf;        /* snapshot, allocated with bufsz bytes */
+    size_t                      bufsz;
+    size_t                      size;       /* size given to the pread() of snapshot */
+    size_t                      len;        /* bytes read: whole file if len < size */
+    uint64_t                    time_ns;    /* monotonic time of snapshot, 0 if none */
+};
+
+static pthread_mutex_t      s_providers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static sensor_provider_t *  s_providers = NULL;
+
+/* ************************************************************************ */
+static inline uint64_t sensor_provider_now_ns() {
+    struct timespec ts;
+
+    if (vclock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t) ts.tv_sec * UINT64_C(1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+/* ************************************************************************ */
+sensor_provider_t * sensor_provider_get(const char * path) {
+    sensor_provider_t * provider;
+
+    if (path == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&s_providers_mutex);
+    for (provider = s_providers; provider != NULL; provider = provider->next) {
+        if (strcmp(provider->path, path) == 0) {
+            ++(provider->refs);
+            pthread_mutex_unlock(&s_providers_mutex);
+            return provider;
+        }
+    }
+    if ((provider = calloc(1, sizeof(*provider))) != NULL) {
+        if ((provider->path = strdup(path)) == NULL
+        ||  pthread_mutex_init(&(provider->mutex), NULL) != 0) {
+            free(provider->path);
+            free(provider);
+            provider = NULL;
+        } else {
+            provider->refs = 1;
+            provider->next = s_providers;
+            s_providers = provider;
+        }
+    }
+    pthread_mutex_unlock(&s_providers_mutex);
+    return provider;
+}
+
+/* ************************************************************************ */
+void sensor_provider_release(sensor_provider_t * provider) {
+    sensor_provider_t ** prev;
+
+    if (provider == NULL) {
+        return ;
+    }
+    pthread_mutex_lock(&s_providers_mutex);
+    if (--(provider->refs) > 0) {
+        pthread_mutex_unlock(&s_providers_mutex);
+        return ;
+    }
+    for (prev = &s_providers; *prev != NULL; prev = &((*prev)->next)) {
+        if (*prev == provider) {
+            *prev = provider->next;
+            break ;
+        }
+    }
+    pthread_mutex_unlock(&s_providers_mutex);
+
+    pthread_mutex_destroy(&(provider->mutex));
+    free(provider->buf);
+    free(provider->path);
+    free(provider);
+}
+
+/* ************************************************************************ */
+static inline ssize_t sensor_provider_sysread(sensor_family_t * family, int fd,
+                                              char * buf, size_t size) {
+    ssize_t n;
+
+    sensor_family_stats_reads(family, 1);
+    while ((n = pread(fd, buf, size, 0)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+    return n;
+}
+
+/* ************************************************************************ */
+ssize_t sensor_provider_pread(sensor_provider_t *  provider,
+                              sensor_family_t *    family,
+                              int                  fd,
+                              char *               buf,
+                              size_t               size) {
+    uint64_t    now_ns;
+    ssize_t     n;
+
+    /* a single user reads directly, it never gets a previous snapshot */
+    if (provider == NULL || __atomic_load_n(&(provider->refs), __ATOMIC_RELAXED) <= 1) {
+        return sensor_provider_sysread(family, fd, buf, size);
+    }
+
+    /* other contexts wait for the read in progress rather than doing it again */
+    pthread_mutex_lock(&(provider->mutex));
+    now_ns = sensor_provider_now_ns();
+    if (provider->time_ns != 0 && now_ns >= provider->time_ns
+    &&  now_ns - provider->time_ns < SENSOR_PROVIDER_MAX_AGE_MS * UINT64_C(1000000)
+    &&  (provider->len < provider->size || size <= provider->len)) {
+        if ((n = provider->len < size ? provider->len : size) > 0)
+            memcpy(buf, provider->buf, n);
+        pthread_mutex_unlock(&(provider->mutex));
+        return n;
+    }
+    if ((n = sensor_provider_sysread(family, fd, buf, size)) >= 0) {
+        if ((size_t) n > provider->bufsz) {
+            char * snap = realloc(provider->buf, n);
+            if (snap == NULL) {
+                provider->time_ns = 0;
+                pthread_mutex_unlock(&(provider->mutex));
+                return n;
+            }
+            provider->buf = snap;
+            provider->bufsz = n;
+        }
+        if (n > 0)
+            memcpy(provider->buf, buf, n);
+        provider->len = n;
+        provider->size = size;
+        provider->time_ns = now_ns;
+    }
+    pthread_mutex_unlock(&(provider->mutex));
+    return n;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Rates of raw counters for families and sysdeps - Generic Sensor Management Library.
+ */
+#include <math.h>
+
+#include "sensor_rate.h"
+
+/* ************************************************************************ */
+const sensor_rate_conf_t g_sensor_rate_conf64 = { .bits = 64, .nb_windows = 0, };
+
+/* ************************************************************************ */
+void sensor_rate_reset(sensor_rate_t * rate) {
+    rate->last_ns = 0;
+}
+
+/* ************************************************************************ */
+sensor_status_t     sensor_rate_update(
+                        sensor_rate_t *             rate,
+                        const sensor_rate_conf_t *  conf,
+                        uint64_t                    counter,
+                        uint64_t                    now_ns) {
+    uint64_t        delta, elapsed_ns;
+    double          value;
+
+    if (rate->last_ns != 0 && now_ns <= rate->last_ns) {
+        /* same pass or clock going back: keep the reference */
+        return SENSOR_UNCHANGED;
+    }
+    elapsed_ns = now_ns - rate->last_ns;
+    if (rate->last_ns == 0
+    ||  !sensor_rate_delta(conf->bits, rate->last, counter, &delta)) {
+        /* new reference: no rate for this interval, smoothed ones are kept */
+        rate->last = counter;
+        rate->last_ns = now_ns;
+        rate->rate = 0.0;
+        return SENSOR_UNCHANGED;
+    }
+
+    value = ((double) delta * 1000000000.0) / (double) elapsed_ns;
+
+    for (unsigned int i = 0; i < conf->nb_windows; ++i) {
+        if (rate->nb_rates == 0) {
+            rate->ewma[i] = value;
+        } else {
+            /* time aware smoothing, irregular intervals keep the window meaning */
+            double alpha = 1.0 - exp(-(double) elapsed_ns / (double) conf->windows_ns[i]);
+
+            rate->ewma[i] += alpha * (value - rate->ewma[i]);
+        }
+    }
+
+    rate->rate = value;
+    rate->last = counter;
+    rate->last_ns = now_ns;
+    ++(rate->nb_rates);
+
+    return SENSOR_SUCCESS;
+}
+
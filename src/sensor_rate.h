@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Rates of raw counters for families and sysdeps - Generic Sensor Management Library.
+ */
+#ifndef SENSOR_RATE_H
+#define SENSOR_RATE_H
+
+#include <stdint.h>
+
+#include "libvsensors/sensor.h"
+
+/** maximum number of EWMA windows of one sensor_rate_t */
+#define SENSOR_RATE_WINDOWS_MAX     3
+
+/** configuration shared by the rates of a same kind of counter */
+typedef struct {
+    unsigned int    bits;                                   /* width of raw counter: 32,64 */
+    unsigned int    nb_windows;                             /* number of EWMA windows */
+    uint64_t        windows_ns[SENSOR_RATE_WINDOWS_MAX];    /* EWMA windows */
+} sensor_rate_conf_t;
+
+/** state of the rate of one raw counter, to be zeroed or initialized
+ * with SENSOR_RATE_INITIALIZER */
+typedef struct {
+    uint64_t        last;                                   /* last raw counter */
+    uint64_t        last_ns;                                /* its time, 0 if none */
+    unsigned int    nb_rates;                               /* number of rates computed */
+    double          rate;                                   /* last rate per second */
+    double          ewma[SENSOR_RATE_WINDOWS_MAX];          /* smoothed rates per second */
+} sensor_rate_t;
+
+#define SENSOR_RATE_INITIALIZER     { 0, 0, 0, 0.0, { 0.0, } }
+
+/** 64 bits counters without EWMA */
+extern const sensor_rate_conf_t g_sensor_rate_conf64;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** delta of a raw counter of given width, handling wrap.
+ * @return 1 with delta set, or 0 if the counter was reset (rebooted device, recreated
+ *         interface, offline cpu removed from a sum, ...) */
+static inline int sensor_rate_delta(unsigned int bits, uint64_t last, uint64_t counter,
+                                    uint64_t * delta) {
+    if (counter >= last) {
+        *delta = counter - last;
+        return 1;
+    }
+    if (bits < 64) {
+        uint64_t mask = (UINT64_C(1) << bits) - 1;
+
+        /* a wrap is only plausible if the delta is small compared to the width */
+        if (last <= mask && counter <= mask && ((counter - last) & mask) <= (mask >> 1)) {
+            *delta = (counter - last) & mask;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** give a new raw counter taken at now_ns (see sensor_now_ns()).
+ * The first counter, a reset counter or a same timestamp give no rate.
+ * @return SENSOR_SUCCESS if the rate was computed, SENSOR_UNCHANGED otherwise */
+sensor_status_t     sensor_rate_update(
+                        sensor_rate_t *             rate,
+                        const sensor_rate_conf_t *  conf,
+                        uint64_t                    counter,
+                        uint64_t                    now_ns);
+
+/** forget the reference counter: next update won't give a rate */
+void                sensor_rate_reset(sensor_rate_t * rate);
+
+/** last rate per second, rounded */
+static inline TYPE_SENSOR_VALUE_ULONG sensor_rate_value(const sensor_rate_t * rate) {
+    return (TYPE_SENSOR_VALUE_ULONG) (rate->rate + 0.5);
+}
+
+/** smoothed rate per second of EWMA window i_window, rounded */
+static inline TYPE_SENSOR_VALUE_ULONG sensor_rate_ewma(const sensor_rate_t * rate,
+                                                       unsigned int i_window) {
+    return (TYPE_SENSOR_VALUE_ULONG) (rate->ewma[i_window] + 0.5);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifdef SENSOR_RATE_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Snapshots of system files (/proc, /sys) read by sysdeps under the root
+ * given to sensor_init_sysroot() - Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "libvsensors/sensor.h"
+
+#include "sensor_private.h"
+
+/** private roots are created in the first writable directory */
+#define SENSOR_REPLAY_MEMDIR    "/dev/shm"
+#define SENSOR_REPLAY_TEMPLATE  "vsensors-replay-XXXXXX"
+
+struct sensor_replay_s {
+    char *  root;
+    int     b_private;  /* created by sensor_replay_create(NULL), removed at free */
+};
+
+/* ************************************************************************ */
+/** create each missing directory of path, which is modified and restored */
+static int sensor_replay_mkdirs(char * path) {
+    for (char * sep = path + 1; ; ++sep) {
+        if (*sep == '/' || *sep == 0) {
+            char c = *sep;
+
+            *sep = 0;
+            if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+                *sep = c;
+                return -1;
+            }
+            *sep = c;
+            if (c == 0)
+                break ;
+        }
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+sensor_replay_t * sensor_replay_create(const char * root) {
+    sensor_replay_t *   replay;
+    char                path[PATH_MAX];
+
+    if ((replay = calloc(1, sizeof(*replay))) == NULL) {
+        return NULL;
+    }
+    if (root == NULL) {
+        const char * dir = SENSOR_REPLAY_MEMDIR;
+
+        if (access(dir, W_OK) != 0 && ((dir = getenv("TMPDIR")) == NULL || *dir == 0))
+            dir = "/tmp";
+        snprintf(path, sizeof(path), "%s/%s", dir, SENSOR_REPLAY_TEMPLATE);
+        if (mkdtemp(path) == NULL) {
+            free(replay);
+            return NULL;
+        }
+        replay->b_private = 1;
+    } else if (*root == 0 || strlen(root) >= sizeof(path)) {
+        free(replay);
+        return NULL;
+    } else {
+        strcpy(path, root);
+        if (sensor_replay_mkdirs(path) != 0) {
+            free(replay);
+            return NULL;
+        }
+    }
+    if ((replay->root = strdup(path)) == NULL) {
+        if (replay->b_private)
+            rmdir(path);
+        free(replay);
+        return NULL;
+    }
+    return replay;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_replay_put(
+                    sensor_replay_t *   replay,
+                    const char *        path,
+                    const void *        data,
+                    size_t              size) {
+    char            file[PATH_MAX];
+    char *          sep;
+    const char *    buf = (const char *) data;
+    int             fd, n;
+
+    if (replay == NULL || path == NULL) {
+        return SENSOR_ERROR;
+    }
+    n = snprintf(file, sizeof(file), "%s%s%s", replay->root, *path == '/' ? "" : "/", path);
+    if (n < 0 || (size_t) n >= sizeof(file)) {
+        return SENSOR_ERROR;
+    }
+    if (data == NULL) {
+        return sensor_replay_mkdirs(file) == 0 ? SENSOR_SUCCESS : SENSOR_ERROR;
+    }
+    if ((sep = strrchr(file, '/')) != NULL && sep != file) {
+        *sep = 0;
+        n = sensor_replay_mkdirs(file);
+        *sep = '/';
+        if (n != 0)
+            return SENSOR_ERROR;
+    }
+    /* rewritten in place rather than replaced: opened fds see the new content */
+    if ((fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, 0644)) < 0) {
+        return SENSOR_ERROR;
+    }
+    for (size_t off = 0; off < size; ) {
+        ssize_t ret = pwrite(fd, buf + off, size - off, off);
+        if (ret < 0 && errno == EINTR)
+            continue ;
+        if (ret <= 0) {
+            close(fd);
+            return SENSOR_ERROR;
+        }
+        off += ret;
+    }
+    n = ftruncate(fd, size);
+    close(fd);
+
+    return n == 0 ? SENSOR_SUCCESS : SENSOR_ERROR;
+}
+
+/* ************************************************************************ */
+const char * sensor_replay_root(const sensor_replay_t * replay) {
+    return replay != NULL ? replay->root : NULL;
+}
+
+/* ************************************************************************ */
+static int sensor_replay_remove(const char * path, const struct stat * st,
+                                int type, struct FTW * ftw) {
+    (void) st;
+    (void) type;
+    (void) ftw;
+    return remove(path) == 0 ? 0 : -1;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_replay_free(sensor_replay_t * replay) {
+    sensor_status_t ret = SENSOR_SUCCESS;
+
+    if (replay == NULL) {
+        return SENSOR_ERROR;
+    }
+    if (replay->root != NULL) {
+        if (replay->b_private
+        &&  nftw(replay->root, sensor_replay_remove, 16, FTW_DEPTH | FTW_PHYS) != 0) {
+            ret = SENSOR_ERROR;
+        }
+        free(replay->root);
+    }
+    free(replay);
+    return ret;
+}
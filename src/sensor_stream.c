@@ -0,0 +1,1556 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * Streaming of watched samples to remote mirror contexts: catalog of sensors,
+ * then delta-encoded frames of changed samples - Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "vlib/slist.h"
+#include "vlib/log.h"
+#include "vlib/time.h"
+
+#include "libvsensors/sensor.h"
+
+#include "sensor_private.h"
+
+/** pending output above which a client not reading its socket is dropped */
+#ifndef SENSOR_STREAM_MAX_PENDING
+# define SENSOR_STREAM_MAX_PENDING  (4 * 1024 * 1024)
+#endif
+/** maximum size of a received frame */
+#define SENSOR_STREAM_MAX_FRAME     (64 * 1024 * 1024)
+/** maximum distance of a received id above the number of known keys: the server
+ * numbers its entries from 0, so that ids stay below the number of defined sensors */
+#ifndef SENSOR_STREAM_MAX_IDS
+# define SENSOR_STREAM_MAX_IDS      (64 * 1024)
+#endif
+#define SENSOR_STREAM_MAGIC         "VSXS"
+#define SENSOR_STREAM_VERSION       1
+#define SENSOR_STREAM_FRAME_HEADER  5       /* u8 kind, u32 little-endian size */
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+/** frame kinds */
+enum {
+    SSK_HELLO   = 'H',  /* magic, u8 version */
+    SSK_RESET   = 'R',  /* ids previously defined are no longer valid */
+    SSK_DEFINE  = 'D',  /* definitions of ids */
+    SSK_DATA    = 'V',  /* values of ids */
+};
+
+/** growable byte buffer */
+typedef struct {
+    unsigned char *     data;
+    size_t              size;
+    size_t              maxsize;
+    int                 error;
+} stream_buf_t;
+
+/** reader of a received frame */
+typedef struct {
+    const unsigned char *   p;
+    const unsigned char *   end;
+    int                     error;
+} stream_reader_t;
+
+/** server: sensor given an id, with the last value sent */
+typedef struct {
+    const sensor_desc_t *   desc;
+    sensor_value_t          value;      /* buffers owned by the entry */
+    uint64_t                time_ns;    /* CLOCK_REALTIME acquisition time of value */
+} stream_entry_t;
+
+/** server: connected client */
+typedef struct {
+    int                     fd;
+    stream_buf_t            out;        /* pending output, from offset 'sent' */
+    size_t                  sent;
+    int                     b_synced;   /* catalog sent, receives the frames of passes */
+} stream_client_t;
+
+struct sensor_stream_s {
+    sensor_ctx_t *          sctx;
+    log_t *                 log;
+    int                     fd;         /* listening socket */
+    char *                  path;       /* unix socket path, unlinked when freed */
+    pthread_mutex_t         mutex;
+    slist_t *               clients;
+    /* ids of sensors: entries[id], hash table of desc pointers giving id + 1 */
+    stream_entry_t *        entries;
+    unsigned int            n_entries;
+    unsigned int            max_entries;
+    uint32_t *              slots;
+    unsigned int            slots_size; /* power of 2, or 0 */
+    uint64_t                time_ns;    /* CLOCK_REALTIME of the last DATA frame */
+    int                     b_reset;    /* RESET frame to send */
+    /* work buffers of a pass */
+    stream_buf_t            defs;
+    stream_buf_t            data;
+    unsigned int            n_data;
+    stream_buf_t            frame;
+};
+
+/** mirror: family named as a remote one */
+typedef struct {
+    sensor_family_info_t            info;       /* info.name is name */
+    char *                          name;
+    struct sensor_stream_mirror_s * mirror;
+    sensor_family_t *               family;
+    unsigned int                    generation; /* incremented when sensors are defined */
+    unsigned int                    listed;     /* generation of the last list() */
+} stream_family_t;
+
+/** mirror: remote sensor, type of sensor_desc_t.key */
+typedef struct {
+    sensor_desc_t           desc;
+    sensor_value_t          value;      /* last received value, buffers owned by the key */
+    uint64_t                time_ns;    /* remote CLOCK_REALTIME acquisition time */
+    char *                  name;       /* '<family>/<label>', desc.label points into it */
+    unsigned int            hash;
+    stream_family_t *       family;     /* NULL if its family is not mirrored */
+} stream_key_t;
+
+struct sensor_stream_mirror_s {
+    sensor_ctx_t *          sctx;
+    log_t *                 log;
+    int                     fd;
+    pthread_mutex_t         mutex;
+    stream_buf_t            in;
+    uint64_t                time_ns;    /* CLOCK_REALTIME of the last DATA frame */
+    struct timeval          drained;    /* 'now' of the last socket drain */
+    int                     b_eof;
+    int                     b_hello;
+    int                     b_catalog;  /* first DATA frame received */
+    int                     b_families; /* families registered, no new ones */
+    stream_key_t **         keys;       /* all keys, for free */
+    unsigned int            n_keys;
+    unsigned int            max_keys;
+    stream_key_t **         ids;        /* keys by id */
+    unsigned int            ids_size;
+    stream_key_t **         names;      /* hash table of keys by name */
+    unsigned int            names_size; /* power of 2, or 0 */
+    stream_family_t **      families;
+    unsigned int            n_families;
+};
+
+/* ************************************************************************
+ * ENCODING : LEB128 varints, zigzag for signed deltas
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+static unsigned char * stream_buf_reserve(stream_buf_t * buf, size_t size) {
+    if (buf->size + size > buf->maxsize) {
+        size_t          maxsize = buf->maxsize == 0 ? 4096 : buf->maxsize;
+        unsigned char * data;
+
+        while (maxsize < buf->size + size)
+            maxsize *= 2;
+        if ((data = realloc(buf->data, maxsize)) == NULL) {
+            buf->error = 1;
+            return NULL;
+        }
+        buf->data = data;
+        buf->maxsize = maxsize;
+    }
+    return buf->data + buf->size;
+}
+
+/* ************************************************************************ */
+static inline void stream_put(stream_buf_t * buf, const void * data, size_t size) {
+    unsigned char * dst;
+
+    if (size > 0 && (dst = stream_buf_reserve(buf, size)) != NULL) {
+        memcpy(dst, data, size);
+        buf->size += size;
+    }
+}
+
+/* ************************************************************************ */
+static inline void stream_put_u8(stream_buf_t * buf, unsigned int c) {
+    unsigned char byte = (unsigned char) c;
+    stream_put(buf, &byte, 1);
+}
+
+/* ************************************************************************ */
+static inline void stream_put_uvarint(stream_buf_t * buf, uint64_t value) {
+    unsigned char * dst;
+
+    if ((dst = stream_buf_reserve(buf, 10)) == NULL)
+        return ;
+    while (value >= 0x80) {
+        *(dst++) = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    *(dst++) = (unsigned char) value;
+    buf->size = dst - buf->data;
+}
+
+/* ************************************************************************ */
+static inline void stream_put_svarint(stream_buf_t * buf, int64_t value) {
+    stream_put_uvarint(buf, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+/* ************************************************************************ */
+static inline void stream_put_str(stream_buf_t * buf, const char * str, size_t len) {
+    stream_put_uvarint(buf, len);
+    stream_put(buf, str, len);
+}
+
+/* ************************************************************************ */
+/** append to dst the header of a frame of given kind and payload size */
+static void stream_put_header(stream_buf_t * dst, unsigned int kind, size_t size) {
+    unsigned char header[SENSOR_STREAM_FRAME_HEADER];
+
+    header[0] = (unsigned char) kind;
+    for (unsigned int i = 0; i < 4; ++i)
+        header[1 + i] = (unsigned char) (size >> (8 * i));
+    stream_put(dst, header, sizeof(header));
+}
+
+/* ************************************************************************ */
+/** append to dst a frame of given kind with payload */
+static void stream_put_frame(stream_buf_t * dst, unsigned int kind,
+                             const void * payload, size_t size) {
+    stream_put_header(dst, kind, size);
+    stream_put(dst, payload, size);
+}
+
+/* ************************************************************************ */
+static inline unsigned int stream_get_u8(stream_reader_t * reader) {
+    if (reader->p >= reader->end) {
+        reader->error = 1;
+        return 0;
+    }
+    return *(reader->p++);
+}
+
+/* ************************************************************************ */
+static uint64_t stream_get_uvarint(stream_reader_t * reader) {
+    uint64_t value = 0;
+
+    for (unsigned int shift = 0; shift < 64 && reader->p < reader->end; shift += 7) {
+        unsigned char c = *(reader->p++);
+
+        value |= (uint64_t) (c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+            return value;
+    }
+    reader->error = 1;
+    return 0;
+}
+
+/* ************************************************************************ */
+static inline int64_t stream_get_svarint(stream_reader_t * reader) {
+    uint64_t value = stream_get_uvarint(reader);
+    return (int64_t) ((value >> 1) ^ (~(value & 1) + 1));
+}
+
+/* ************************************************************************ */
+static const unsigned char * stream_get(stream_reader_t * reader, size_t size) {
+    const unsigned char * p = reader->p;
+
+    if ((size_t) (reader->end - reader->p) < size) {
+        reader->error = 1;
+        return NULL;
+    }
+    reader->p += size;
+    return p;
+}
+
+/* ************************************************************************ */
+/** integers zero or sign extended, float and double bits, 0 for other types */
+static uint64_t stream_value_bits(const sensor_value_t * value) {
+    switch (value->type) {
+        case SENSOR_VALUE_UCHAR:    return value->data.uc;
+        case SENSOR_VALUE_CHAR:     return (uint64_t) (int64_t) value->data.c;
+        case SENSOR_VALUE_UINT16:   return value->data.u16;
+        case SENSOR_VALUE_INT16:    return (uint64_t) (int64_t) value->data.i16;
+        case SENSOR_VALUE_UINT32:   return value->data.u32;
+        case SENSOR_VALUE_INT32:    return (uint64_t) (int64_t) value->data.i32;
+        case SENSOR_VALUE_UINT:     return value->data.ui;
+        case SENSOR_VALUE_INT:      return (uint64_t) (int64_t) value->data.i;
+        case SENSOR_VALUE_ULONG:    return value->data.ul;
+        case SENSOR_VALUE_LONG:     return (uint64_t) (int64_t) value->data.l;
+        case SENSOR_VALUE_UINT64:   return value->data.u64;
+        case SENSOR_VALUE_INT64:    return (uint64_t) value->data.i64;
+        case SENSOR_VALUE_FLOAT: {
+            uint32_t bits;
+            memcpy(&bits, &(value->data.f), sizeof(bits));
+            return bits;
+        }
+        case SENSOR_VALUE_DOUBLE: {
+            uint64_t bits;
+            memcpy(&bits, &(value->data.d), sizeof(bits));
+            return bits;
+        }
+        default:
+            return 0;
+    }
+}
+
+/* ************************************************************************ */
+/** reverse of stream_value_bits() */
+static void stream_value_setbits(sensor_value_t * value, uint64_t bits) {
+    switch (value->type) {
+        case SENSOR_VALUE_UCHAR:    value->data.uc = (unsigned char) bits; break ;
+        case SENSOR_VALUE_CHAR:     value->data.c = (char) bits; break ;
+        case SENSOR_VALUE_UINT16:   value->data.u16 = (uint16_t) bits; break ;
+        case SENSOR_VALUE_INT16:    value->data.i16 = (int16_t) bits; break ;
+        case SENSOR_VALUE_UINT32:   value->data.u32 = (uint32_t) bits; break ;
+        case SENSOR_VALUE_INT32:    value->data.i32 = (int32_t) bits; break ;
+        case SENSOR_VALUE_UINT:     value->data.ui = (unsigned int) bits; break ;
+        case SENSOR_VALUE_INT:      value->data.i = (int) bits; break ;
+        case SENSOR_VALUE_ULONG:    value->data.ul = (unsigned long) bits; break ;
+        case SENSOR_VALUE_LONG:     value->data.l = (long) bits; break ;
+        case SENSOR_VALUE_UINT64:   value->data.u64 = bits; break ;
+        case SENSOR_VALUE_INT64:    value->data.i64 = (int64_t) bits; break ;
+        case SENSOR_VALUE_FLOAT: {
+            uint32_t u32 = (uint32_t) bits;
+            memcpy(&(value->data.f), &u32, sizeof(u32));
+            break ;
+        }
+        case SENSOR_VALUE_DOUBLE:
+            memcpy(&(value->data.d), &bits, sizeof(bits));
+            break ;
+        default:
+            break ;
+    }
+}
+
+/* ************************************************************************ */
+/** size of the data of strings and bytes */
+static inline size_t stream_value_size(const sensor_value_t * value) {
+    if (value->data.b.buf == NULL)
+        return 0;
+    return value->type == SENSOR_VALUE_STRING
+           ? strnlen(value->data.b.buf, value->data.b.size) : value->data.b.size;
+}
+
+/* ************************************************************************ */
+/**
+ * append value, encoded against the previous value bits of the same type:
+ * integers as the zigzag varint of their difference, float and double as their
+ * xor shifted by its trailing zero bits (u8 0 if unchanged, or u8 shift + 1 and
+ * varint), long double as raw bytes, strings and bytes as varint size and data.
+ */
+static void stream_put_value(stream_buf_t * buf, const sensor_value_t * value, uint64_t prev) {
+    switch (value->type) {
+        case SENSOR_VALUE_STRING:
+        case SENSOR_VALUE_BYTES:
+            stream_put_str(buf, value->data.b.buf, stream_value_size(value));
+            break ;
+        case SENSOR_VALUE_LDOUBLE:
+            stream_put(buf, &(value->data.ld), sensor_value_type_size(value->type));
+            break ;
+        case SENSOR_VALUE_FLOAT:
+        case SENSOR_VALUE_DOUBLE: {
+            uint64_t xor = stream_value_bits(value) ^ prev;
+
+            if (xor == 0) {
+                stream_put_u8(buf, 0);
+            } else {
+                unsigned int shift = __builtin_ctzll(xor);
+                stream_put_u8(buf, shift + 1);
+                stream_put_uvarint(buf, xor >> shift);
+            }
+            break ;
+        }
+        case SENSOR_VALUE_NULL:
+            break ;
+        default:
+            stream_put_svarint(buf, (int64_t) (stream_value_bits(value) - prev));
+            break ;
+    }
+}
+
+/* ************************************************************************ */
+/** store src in dst, whose buffer is owned and grown as needed */
+static sensor_status_t stream_value_store(sensor_value_t * dst, const sensor_value_t * src,
+                                          const void * data, size_t size) {
+    if (!SENSOR_VALUE_IS_BUFFER(src->type)) {
+        if (SENSOR_VALUE_IS_BUFFER(dst->type) && dst->data.b.buf != NULL)
+            free(dst->data.b.buf);
+        *dst = *src;
+        return SENSOR_SUCCESS;
+    }
+    if (!SENSOR_VALUE_IS_BUFFER(dst->type)) {
+        memset(&(dst->data), 0, sizeof(dst->data));
+    }
+    if (size + 1 > dst->data.b.maxsize) {
+        char * buf;
+
+        if ((buf = realloc(dst->data.b.buf, size + 1)) == NULL)
+            return SENSOR_ERROR;
+        dst->data.b.buf = buf;
+        dst->data.b.maxsize = size + 1;
+    }
+    if (size > 0)
+        memcpy(dst->data.b.buf, data, size);
+    dst->data.b.buf[size] = 0;
+    dst->data.b.size = size;
+    dst->type = src->type;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** read a value encoded by stream_put_value() against value, which is updated */
+static sensor_status_t stream_get_value(stream_reader_t * reader, sensor_value_t * value) {
+    switch (value->type) {
+        case SENSOR_VALUE_STRING:
+        case SENSOR_VALUE_BYTES: {
+            size_t                  size = stream_get_uvarint(reader);
+            const unsigned char *   data;
+
+            if (reader->error || (data = stream_get(reader, size)) == NULL)
+                return SENSOR_ERROR;
+            return stream_value_store(value, value, data, size);
+        }
+        case SENSOR_VALUE_LDOUBLE: {
+            const unsigned char * data = stream_get(reader, sensor_value_type_size(value->type));
+
+            if (data == NULL)
+                return SENSOR_ERROR;
+            memcpy(&(value->data.ld), data, sensor_value_type_size(value->type));
+            break ;
+        }
+        case SENSOR_VALUE_FLOAT:
+        case SENSOR_VALUE_DOUBLE: {
+            unsigned int shift = stream_get_u8(reader);
+
+            if (shift > 64)
+                return SENSOR_ERROR;
+            if (shift > 0) {
+                stream_value_setbits(value,
+                        stream_value_bits(value) ^ (stream_get_uvarint(reader) << (shift - 1)));
+            }
+            break ;
+        }
+        case SENSOR_VALUE_NULL:
+            break ;
+        default:
+            stream_value_setbits(value, stream_value_bits(value)
+                                        + (uint64_t) stream_get_svarint(reader));
+            break ;
+    }
+    return reader->error ? SENSOR_ERROR : SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** zero value of type, as the reference of the first value of a sensor */
+static inline void stream_value_zero(sensor_value_t * value, sensor_value_type_t type) {
+    if (SENSOR_VALUE_IS_BUFFER(value->type) && value->data.b.buf != NULL) {
+        value->data.b.size = 0;
+        value->data.b.buf[0] = 0;
+        if (SENSOR_VALUE_IS_BUFFER(type)) {
+            value->type = type;
+            return ;
+        }
+        free(value->data.b.buf);
+    }
+    memset(value, 0, sizeof(*value));
+    value->type = type;
+}
+
+/* ************************************************************************
+ * SOCKETS
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+/** unix socket path of address, or NULL for TCP */
+static const char * stream_unix_path(const char * address) {
+    if (strncmp(address, "unix:", 5) == 0)
+        return address + 5;
+    if (strchr(address, '/') != NULL)
+        return address;
+    return NULL;
+}
+
+/* ************************************************************************ */
+static void stream_socket_setup(int fd) {
+    int one = 1;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    /* frames are written once per pass: do not delay them (fails on unix sockets) */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/* ************************************************************************ */
+/** wait the end of a non-blocking connect() */
+static int stream_connect_wait(int fd, long timeout_ms) {
+    struct pollfd   pfd = { .fd = fd, .events = POLLOUT, .revents = 0 };
+    socklen_t       len = sizeof(int);
+    int             err = 0, ret;
+
+    while ((ret = poll(&pfd, 1, timeout_ms)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+    if (ret == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    if (ret < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        return -1;
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* ************************************************************************ */
+/** connect to address, or listen on it with b_listen, return a non-blocking socket or -1 */
+static int stream_socket(const char * address, int b_listen, long timeout_ms, log_t * log) {
+    const char *        path = stream_unix_path(address);
+    struct addrinfo     hints, * res = NULL;
+    char                host[256];
+    const char *        port;
+    int                 fd = -1, ret;
+
+    if (path != NULL) {
+        struct sockaddr_un  sun;
+        struct stat         st;
+
+        if (strlen(path) >= sizeof(sun.sun_path)) {
+            LOG_ERROR(log, "stream: unix socket path too long '%s'", path);
+            return -1;
+        }
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, path);
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+            LOG_ERROR(log, "stream: socket(): %s", strerror(errno));
+            return -1;
+        }
+        stream_socket_setup(fd);
+        if (b_listen) {
+            /* a socket left by a previous server is replaced */
+            if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+                unlink(path);
+            ret = bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0 || listen(fd, SOMAXCONN) < 0;
+        } else {
+            ret = connect(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0
+                  && (errno != EINPROGRESS || stream_connect_wait(fd, timeout_ms) < 0);
+        }
+        if (ret != 0) {
+            LOG_ERROR(log, "stream: cannot %s '%s': %s", b_listen ? "listen on" : "connect to",
+                      path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /* TCP: '[<host>]:<port>', '<host>:<port>' or ':<port>' */
+    if ((port = strrchr(address, ':')) == NULL || (size_t) (port - address) >= sizeof(host)) {
+        LOG_ERROR(log, "stream: bad address '%s'", address);
+        return -1;
+    }
+    if (*address == '[' && port > address && port[-1] == ']') {
+        snprintf(host, sizeof(host), "%.*s", (int) (port - address - 2), address + 1);
+    } else {
+        snprintf(host, sizeof(host), "%.*s", (int) (port - address), address);
+    }
+    ++port;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = b_listen ? AI_PASSIVE : 0;
+    if ((ret = getaddrinfo(*host ? host : NULL, port, &hints, &res)) != 0) {
+        LOG_ERROR(log, "stream: cannot resolve '%s': %s", address, gai_strerror(ret));
+        return -1;
+    }
+    for (struct addrinfo * ai = res; ai != NULL; ai = ai->ai_next) {
+        int one = 1;
+
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue ;
+        stream_socket_setup(fd);
+        if (b_listen) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0)
+                break ;
+        } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0
+               ||  (errno == EINPROGRESS && stream_connect_wait(fd, timeout_ms) == 0)) {
+            break ;
+        }
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        LOG_ERROR(log, "stream: cannot %s '%s': %s", b_listen ? "listen on" : "connect to",
+                  address, strerror(errno));
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+/* ************************************************************************
+ * SERVER
+ * ************************************************************************ */
+
+/* ************************************************************************ */
+static void stream_client_free(void * vdata) {
+    stream_client_t * client = (stream_client_t *) vdata;
+
+    close(client->fd);
+    if (client->out.data != NULL)
+        free(client->out.data);
+    free(client);
+}
+
+/* ************************************************************************ */
+/** send pending output without blocking, -1 if the client must be dropped */
+static int stream_client_flush(stream_client_t * client) {
+    while (client->sent < client->out.size) {
+        ssize_t n = send(client->fd, client->out.data + client->sent,
+                         client->out.size - client->sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue ;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break ;
+            return -1;
+        }
+        client->sent += n;
+    }
+    if (client->sent > 0) {
+        memmove(client->out.data, client->out.data + client->sent,
+                client->out.size - client->sent);
+        client->out.size -= client->sent;
+        client->sent = 0;
+    }
+    return client->out.error || client->out.size > SENSOR_STREAM_MAX_PENDING ? -1 : 0;
+}
+
+/* ************************************************************************ */
+/** accept the pending connections, as clients waiting their catalog */
+static unsigned int stream_accept(sensor_stream_t * stream) {
+    unsigned int    n_new = 0;
+    int             fd;
+
+    while ((fd = accept(stream->fd, NULL, NULL)) >= 0 || errno == EINTR) {
+        stream_client_t *   client;
+        slist_t *           new;
+
+        if (fd < 0)
+            continue ;
+        stream_socket_setup(fd);
+        if ((client = calloc(1, sizeof(*client))) == NULL
+        ||  (new = slist_prepend(stream->clients, client)) == NULL) {
+            LOG_ERROR(stream->log, "stream: cannot allocate client");
+            if (client != NULL)
+                free(client);
+            close(fd);
+            continue ;
+        }
+        client->fd = fd;
+        stream->clients = new;
+        ++n_new;
+        LOG_VERBOSE(stream->log, "stream: client connected (fd %d)", fd);
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_WARN(stream->log, "stream: accept(): %s", strerror(errno));
+    }
+    return n_new;
+}
+
+/* ************************************************************************ */
+/** append the DEFINE record of an entry to buf */
+static void stream_put_define(stream_buf_t * buf, uint32_t id, const stream_entry_t * entry) {
+    const sensor_desc_t *   desc = entry->desc;
+    const char *            name;
+    size_t                  len;
+    unsigned int            n_props = 0;
+
+    if ((name = sensor_desc_fullname(desc, &len, NULL)) == NULL) {
+        name = STR_CHECKNULL(desc->label);
+        len = strlen(name);
+    }
+    stream_put_uvarint(buf, id);
+    stream_put_u8(buf, entry->value.type);
+    stream_put_str(buf, name, len);
+    for (const sensor_property_t * prop = desc->properties;
+            SENSOR_PROPERTY_VALID(prop); ++prop)
+        ++n_props;
+    stream_put_uvarint(buf, n_props);
+    for (const sensor_property_t * prop = desc->properties;
+            SENSOR_PROPERTY_VALID(prop); ++prop) {
+        stream_put_str(buf, prop->name, strlen(prop->name));
+        stream_put_u8(buf, prop->value.type);
+        stream_put_value(buf, &(prop->value), 0);
+    }
+}
+
+/* ************************************************************************ */
+/** append the DATA record of an entry against prev bits to buf */
+static inline void stream_put_data(stream_buf_t * buf, uint32_t id, const stream_entry_t * entry,
+                                   const sensor_value_t * value, uint64_t prev, uint64_t time_ns) {
+    stream_put_uvarint(buf, id);
+    stream_put_svarint(buf, (int64_t) (entry->time_ns - time_ns));
+    stream_put_value(buf, value, prev);
+}
+
+/* ************************************************************************ */
+/** get the entry id of desc, a new one being created with b_create, or -1 */
+static int64_t stream_entry_id(sensor_stream_t * stream, const sensor_desc_t * desc, int b_create) {
+    unsigned int mask, i;
+
+    if (stream->n_entries >= stream->slots_size / 2) {
+        unsigned int    size = stream->slots_size == 0 ? 256 : stream->slots_size * 2;
+        uint32_t *      slots;
+
+        if ((slots = calloc(size, sizeof(*slots))) == NULL)
+            return -1;
+        for (uint32_t id = 0; id < stream->n_entries; ++id) {
+            for (i = ((size_t) stream->entries[id].desc >> 4) & (size - 1); slots[i] != 0;
+                    i = (i + 1) & (size - 1))
+                ; /* nothing but loop */
+            slots[i] = id + 1;
+        }
+        if (stream->slots != NULL)
+            free(stream->slots);
+        stream->slots = slots;
+        stream->slots_size = size;
+    }
+    mask = stream->slots_size - 1;
+    for (i = ((size_t) desc >> 4) & mask; stream->slots[i] != 0; i = (i + 1) & mask) {
+        if (stream->entries[stream->slots[i] - 1].desc == desc)
+            return stream->slots[i] - 1;
+    }
+    if (!b_create)
+        return -1;
+    if (stream->n_entries >= stream->max_entries) {
+        unsigned int        max = stream->max_entries == 0 ? 256 : stream->max_entries * 2;
+        stream_entry_t *    entries;
+
+        if ((entries = realloc(stream->entries, max * sizeof(*entries))) == NULL)
+            return -1;
+        stream->entries = entries;
+        stream->max_entries = max;
+    }
+    memset(&(stream->entries[stream->n_entries]), 0, sizeof(*stream->entries));
+    stream->entries[stream->n_entries].desc = desc;
+    stream->slots[i] = stream->n_entries + 1;
+    return stream->n_entries++;
+}
+
+/* ************************************************************************ */
+static void stream_entries_clear(sensor_stream_t * stream) {
+    for (unsigned int id = 0; id < stream->n_entries; ++id) {
+        stream_value_zero(&(stream->entries[id].value), SENSOR_VALUE_NULL);
+    }
+    if (stream->slots != NULL)
+        memset(stream->slots, 0, stream->slots_size * sizeof(*stream->slots));
+    stream->n_entries = 0;
+}
+
+/* ************************************************************************ */
+/** encode a sample in the DEFINE and DATA work buffers of the pass */
+static void stream_put_sample(sensor_stream_t * stream, const sensor_sample_t * sample,
+                              uint64_t time_ns, uint64_t clock_ns) {
+    const sensor_value_t *  value = &(sample->value);
+    stream_entry_t *        entry;
+    int64_t                 id;
+    uint64_t                prev;
+
+    if (value->type == SENSOR_VALUE_NULL || value->type >= SENSOR_VALUE_NB) {
+        return ;
+    }
+    if ((id = stream_entry_id(stream, sample->desc, 1)) < 0) {
+        stream->data.error = 1;
+        return ;
+    }
+    entry = &(stream->entries[id]);
+    if (entry->value.type != value->type) {
+        /* new id, or new type: (re)define it, its first value being sent against 0 */
+        stream_value_zero(&(entry->value), value->type);
+        stream_put_define(&(stream->defs), id, entry);
+    }
+    prev = stream_value_bits(&(entry->value));
+    entry->time_ns = time_ns;
+    if (sample->acquired_ns != 0 && sample->acquired_ns < clock_ns)
+        entry->time_ns -= clock_ns - sample->acquired_ns;
+    stream_put_data(&(stream->data), id, entry, value, prev, time_ns);
+    ++(stream->n_data);
+    if (stream_value_store(&(entry->value), value, value->data.b.buf,
+                           SENSOR_VALUE_IS_BUFFER(value->type) ? stream_value_size(value) : 0)
+            != SENSOR_SUCCESS) {
+        stream->data.error = 1;
+    }
+}
+
+/* ************************************************************************ */
+/** append the frames of the pass to buf: RESET, DEFINE, DATA */
+static void stream_put_pass(sensor_stream_t * stream, stream_buf_t * buf, uint64_t time_ns) {
+    stream_buf_t    header = { .data = NULL };
+
+    if (stream->b_reset) {
+        stream_put_frame(buf, SSK_RESET, NULL, 0);
+    }
+    if (stream->defs.size > 0) {
+        stream_put_frame(buf, SSK_DEFINE, stream->defs.data, stream->defs.size);
+    }
+    if (stream->n_data > 0) {
+        unsigned char tmp[20];
+
+        /* DATA: svarint time delta, uvarint count, records */
+        header.data = tmp;
+        header.maxsize = sizeof(tmp);
+        stream_put_svarint(&header, (int64_t) (time_ns - stream->time_ns));
+        stream_put_uvarint(&header, stream->n_data);
+        stream_put_header(buf, SSK_DATA, header.size + stream->data.size);
+        stream_put(buf, header.data, header.size);
+        stream_put(buf, stream->data.data, stream->data.size);
+    }
+}
+
+/* ************************************************************************ */
+/** catalog of a new client: HELLO, the definitions and values of all entries */
+static void stream_put_catalog(sensor_stream_t * stream, stream_buf_t * buf) {
+    unsigned char   hello[sizeof(SENSOR_STREAM_MAGIC)];
+
+    memcpy(hello, SENSOR_STREAM_MAGIC, sizeof(hello) - 1);
+    hello[sizeof(hello) - 1] = SENSOR_STREAM_VERSION;
+    stream_put_frame(buf, SSK_HELLO, hello, sizeof(hello));
+
+    stream->defs.size = 0;
+    for (uint32_t id = 0; id < stream->n_entries; ++id) {
+        stream_put_define(&(stream->defs), id, &(stream->entries[id]));
+    }
+    if (stream->defs.size > 0)
+        stream_put_frame(buf, SSK_DEFINE, stream->defs.data, stream->defs.size);
+    /* the DATA frame always ends the catalog, its time is absolute */
+    stream->data.size = 0;
+    stream_put_svarint(&(stream->data), (int64_t) stream->time_ns);
+    stream_put_uvarint(&(stream->data), stream->n_entries);
+    for (uint32_t id = 0; id < stream->n_entries; ++id) {
+        stream_put_data(&(stream->data), id, &(stream->entries[id]),
+                        &(stream->entries[id].value), 0, stream->time_ns);
+    }
+    stream_put_frame(buf, SSK_DATA, stream->data.data, stream->data.size);
+}
+
+/* ************************************************************************ */
+void sensor_stream_run(
+                    sensor_stream_t *           stream,
+                    const slist_t *             watchlist,
+                    const slist_t *             list,
+                    sensor_sample_t * const *   samples,
+                    unsigned int                n_samples) {
+    struct timespec ts;
+    uint64_t        time_ns, clock_ns = 0;
+    unsigned int    n_new;
+
+    if (vclock_gettime(CLOCK_REALTIME, &ts) != 0) {
+        return ;
+    }
+    time_ns = (uint64_t) ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+    sensor_now_ns(stream->sctx, &clock_ns);
+
+    pthread_mutex_lock(&(stream->mutex));
+    n_new = stream_accept(stream);
+    if (stream->clients == NULL) {
+        /* without clients, values are not followed: the next one gets all of them */
+        stream_entries_clear(stream);
+        stream->b_reset = 0;
+        pthread_mutex_unlock(&(stream->mutex));
+        return ;
+    }
+    stream->defs.size = stream->data.size = stream->frame.size = 0;
+    stream->defs.error = stream->data.error = stream->frame.error = 0;
+    stream->n_data = 0;
+
+    /* a new client, or a reset, needs the watched samples not sent yet */
+    if (n_new > 0 || stream->b_reset) {
+        SLISTC_FOREACH_DATA(watchlist, sample, const sensor_sample_t *) {
+            if (sample->acquired_ns != 0 && stream_entry_id(stream, sample->desc, 0) < 0)
+                stream_put_sample(stream, sample, time_ns, clock_ns);
+        }
+    }
+    for (const slist_t * elt = list; elt != NULL; elt = elt->next) {
+        stream_put_sample(stream, elt->data, time_ns, clock_ns);
+    }
+    for (unsigned int i = 0; i < n_samples; ++i) {
+        stream_put_sample(stream, samples[i], time_ns, clock_ns);
+    }
+    stream_put_pass(stream, &(stream->frame), time_ns);
+    if (stream->n_data > 0)
+        stream->time_ns = time_ns;
+    stream->b_reset = 0;
+
+    if (stream->frame.error || stream->data.error || stream->defs.error) {
+        /* deltas cannot be resumed: the clients must reconnect */
+        LOG_ERROR(stream->log, "stream: cannot encode %u records, dropping clients",
+                  stream->n_data);
+        slist_free(stream->clients, stream_client_free);
+        stream->clients = NULL;
+        pthread_mutex_unlock(&(stream->mutex));
+        return ;
+    }
+    SLIST_FOREACH_DATA(stream->clients, client, stream_client_t *) {
+        if (client->b_synced)
+            stream_put(&(client->out), stream->frame.data, stream->frame.size);
+    }
+    if (n_new > 0) {
+        if (stream->time_ns == 0)
+            stream->time_ns = time_ns;
+        stream->frame.size = 0;
+        stream_put_catalog(stream, &(stream->frame));
+        SLIST_FOREACH_DATA(stream->clients, client, stream_client_t *) {
+            if (!client->b_synced) {
+                stream_put(&(client->out), stream->frame.data, stream->frame.size);
+                client->b_synced = 1;
+            }
+        }
+    }
+    for (slist_t * elt = stream->clients; elt != NULL; ) {
+        stream_client_t * client = (stream_client_t *) elt->data;
+
+        elt = elt->next;
+        if (stream_client_flush(client) < 0) {
+            LOG_WARN(stream->log, "stream: dropping client (fd %d): %s", client->fd,
+                     client->out.size > SENSOR_STREAM_MAX_PENDING ? "too slow" : strerror(errno));
+            stream->clients = slist_remove_ptr(stream->clients, client);
+            stream_client_free(client);
+        }
+    }
+    pthread_mutex_unlock(&(stream->mutex));
+}
+
+/* ************************************************************************ */
+/** forget all entries as descs are going to be freed, under write lock */
+void sensor_stream_reset(sensor_stream_t * stream) {
+    pthread_mutex_lock(&(stream->mutex));
+    if (stream->n_entries > 0) {
+        stream_entries_clear(stream);
+        stream->b_reset = 1;
+    }
+    pthread_mutex_unlock(&(stream->mutex));
+}
+
+/* ************************************************************************ */
+void sensor_stream_destroy(void * vstream) {
+    sensor_stream_t * stream = (sensor_stream_t *) vstream;
+
+    slist_free(stream->clients, stream_client_free);
+    if (stream->fd >= 0)
+        close(stream->fd);
+    if (stream->path != NULL) {
+        unlink(stream->path);
+        free(stream->path);
+    }
+    stream_entries_clear(stream);
+    if (stream->entries != NULL)
+        free(stream->entries);
+    if (stream->slots != NULL)
+        free(stream->slots);
+    if (stream->defs.data != NULL)
+        free(stream->defs.data);
+    if (stream->data.data != NULL)
+        free(stream->data.data);
+    if (stream->frame.data != NULL)
+        free(stream->frame.data);
+    pthread_mutex_destroy(&(stream->mutex));
+    free(stream);
+}
+
+/* ************************************************************************ */
+sensor_stream_t * sensor_stream_serve(sensor_ctx_t * sctx, const char * address) {
+    sensor_stream_t *   stream;
+    const char *        path;
+
+    if (sctx == NULL || address == NULL) {
+        return NULL;
+    }
+    if ((stream = calloc(1, sizeof(*stream))) == NULL) {
+        return NULL;
+    }
+    stream->sctx = sctx;
+    stream->log = sensor_ctx_log(sctx);
+    if ((stream->fd = stream_socket(address, 1, 0, stream->log)) < 0
+    ||  ((path = stream_unix_path(address)) != NULL && (stream->path = strdup(path)) == NULL)) {
+        if (stream->fd >= 0)
+            close(stream->fd);
+        free(stream);
+        return NULL;
+    }
+    pthread_mutex_init(&(stream->mutex), NULL);
+
+    if (sensor_stream_attach(sctx, stream, 1) != SENSOR_SUCCESS) {
+        sensor_stream_destroy(stream);
+        return NULL;
+    }
+    LOG_VERBOSE(stream->log, "stream: serving on '%s'", address);
+    return stream;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_stream_free(sensor_stream_t * stream) {
+    if (stream == NULL) {
+        return SENSOR_ERROR;
+    }
+    sensor_stream_attach(stream->sctx, stream, 0);
+    sensor_stream_destroy(stream);
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************
+ * MIRROR
+ * ************************************************************************ */
+
+static sensor_status_t stream_family_update(sensor_sample_t * sensor, const struct timeval * now);
+
+/* ************************************************************************ */
+/** FNV-1a hash of a sensor name */
+static unsigned int stream_name_hash(const char * name, size_t len) {
+    unsigned int hash = 2166136261U;
+
+    for (const char * end = name + len; name < end; ++name)
+        hash = (hash ^ (unsigned char) *name) * 16777619U;
+    return hash;
+}
+
+/* ************************************************************************ */
+/** slot of name in mirror->names, NULL slot if not found */
+static stream_key_t ** stream_mirror_name_slot(sensor_stream_mirror_t * mirror,
+                                               const char * name, size_t len, unsigned int hash) {
+    unsigned int mask = mirror->names_size - 1;
+
+    for (unsigned int i = hash & mask; ; i = (i + 1) & mask) {
+        stream_key_t * key = mirror->names[i];
+
+        if (key == NULL
+        ||  (key->hash == hash && strncmp(key->name, name, len) == 0 && key->name[len] == 0))
+            return &(mirror->names[i]);
+    }
+}
+
+/* ************************************************************************ */
+static sensor_status_t stream_mirror_grow(sensor_stream_mirror_t * mirror) {
+    if (mirror->n_keys >= mirror->max_keys) {
+        unsigned int    max = mirror->max_keys == 0 ? 256 : mirror->max_keys * 2;
+        stream_key_t ** keys;
+
+        if ((keys = realloc(mirror->keys, max * sizeof(*keys))) == NULL)
+            return SENSOR_ERROR;
+        mirror->keys = keys;
+        mirror->max_keys = max;
+    }
+    if (mirror->n_keys >= mirror->names_size / 2) {
+        unsigned int    size = mirror->names_size == 0 ? 512 : mirror->names_size * 2;
+        stream_key_t ** names;
+
+        if ((names = calloc(size, sizeof(*names))) == NULL)
+            return SENSOR_ERROR;
+        free(mirror->names);
+        mirror->names = names;
+        mirror->names_size = size;
+        for (unsigned int i = 0; i < mirror->n_keys; ++i) {
+            stream_key_t * key = mirror->keys[i];
+            *stream_mirror_name_slot(mirror, key->name, strlen(key->name), key->hash) = key;
+        }
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** mirrored family of this name, created before the registration of families */
+static stream_family_t * stream_mirror_family(sensor_stream_mirror_t * mirror,
+                                              const char * name, size_t len) {
+    stream_family_t *   sfam;
+    stream_family_t **  families;
+
+    for (unsigned int i = 0; i < mirror->n_families; ++i) {
+        if (strncmp(mirror->families[i]->name, name, len) == 0
+        &&  mirror->families[i]->name[len] == 0)
+            return mirror->families[i];
+    }
+    if (mirror->b_families || (len == 6 && strncmp(name, "common", len) == 0)) {
+        return NULL;
+    }
+    if ((families = realloc(mirror->families,
+                            (mirror->n_families + 1) * sizeof(*families))) == NULL) {
+        return NULL;
+    }
+    mirror->families = families;
+    if ((sfam = calloc(1, sizeof(*sfam))) == NULL) {
+        return NULL;
+    }
+    if ((sfam->name = strndup(name, len)) == NULL) {
+        free(sfam);
+        return NULL;
+    }
+    sfam->mirror = mirror;
+    mirror->families[mirror->n_families++] = sfam;
+    return sfam;
+}
+
+/* ************************************************************************ */
+/** decode the properties of a DEFINE record */
+static sensor_property_t * stream_get_properties(stream_reader_t * reader) {
+    unsigned int        n = stream_get_uvarint(reader);
+    sensor_property_t * props;
+
+    if (n == 0 || reader->error || n > (size_t) (reader->end - reader->p)
+    ||  (props = sensor_properties_create(n)) == NULL) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < n && !reader->error; ++i) {
+        size_t                  len = stream_get_uvarint(reader);
+        const unsigned char *   name = stream_get(reader, len);
+        unsigned int            type;
+
+        if (name == NULL || (type = stream_get_u8(reader)) >= SENSOR_VALUE_NB
+        ||  (props[i].name = strndup((const char *) name, len)) == NULL) {
+            reader->error = 1;
+            break ;
+        }
+        stream_value_zero(&(props[i].value), type);
+        if (stream_get_value(reader, &(props[i].value)) != SENSOR_SUCCESS) {
+            reader->error = 1;
+        }
+    }
+    if (reader->error) {
+        sensor_properties_free(props);
+        return NULL;
+    }
+    return props;
+}
+
+/* ************************************************************************ */
+/** apply a DEFINE frame: keys are found by name, or created */
+static sensor_status_t stream_mirror_define(sensor_stream_mirror_t * mirror,
+                                            stream_reader_t * reader) {
+    while (reader->p < reader->end) {
+        uint64_t                id = stream_get_uvarint(reader);
+        unsigned int            type = stream_get_u8(reader);
+        size_t                  len = stream_get_uvarint(reader);
+        const char *            name = (const char *) stream_get(reader, len);
+        sensor_property_t *     props = stream_get_properties(reader);
+        stream_key_t **         slot;
+        stream_key_t *          key;
+        const char *            sep;
+        unsigned int            hash;
+
+        if (reader->error || name == NULL || type >= SENSOR_VALUE_NB
+        ||  id > (uint64_t) mirror->n_keys + SENSOR_STREAM_MAX_IDS
+        ||  (sep = memchr(name, '/', len)) == NULL || stream_mirror_grow(mirror) != SENSOR_SUCCESS) {
+            sensor_properties_free(props);
+            return SENSOR_ERROR;
+        }
+        if (id >= mirror->ids_size) {
+            size_t          size = mirror->ids_size == 0 ? 256 : mirror->ids_size;
+            stream_key_t ** ids;
+
+            while (size <= id)
+                size *= 2;
+            if (size > UINT_MAX || size > SIZE_MAX / sizeof(*ids)
+            ||  (ids = realloc(mirror->ids, size * sizeof(*ids))) == NULL) {
+                sensor_properties_free(props);
+                return SENSOR_ERROR;
+            }
+            memset(ids + mirror->ids_size, 0, (size - mirror->ids_size) * sizeof(*ids));
+            mirror->ids = ids;
+            mirror->ids_size = (unsigned int) size;
+        }
+        hash = stream_name_hash(name, len);
+        if ((key = *(slot = stream_mirror_name_slot(mirror, name, len, hash))) != NULL) {
+            /* known sensor, redefined after a remote reset: with another type,
+             * its samples must be released rather than getting the new values */
+            sensor_properties_free(props);
+            if (key->desc.type != type && key->family != NULL)
+                ++(key->family->generation);
+        } else {
+            if ((key = calloc(1, sizeof(*key))) == NULL
+            ||  (key->name = strndup(name, len)) == NULL) {
+                if (key != NULL)
+                    free(key);
+                sensor_properties_free(props);
+                return SENSOR_ERROR;
+            }
+            key->hash = hash;
+            key->desc.key = key;
+            key->desc.label = key->name + (sep - name) + 1;
+            key->desc.properties = props;
+            if ((key->family = stream_mirror_family(mirror, name, sep - name)) != NULL)
+                ++(key->family->generation);
+            mirror->keys[mirror->n_keys++] = key;
+            *slot = key;
+        }
+        key->desc.type = type;
+        stream_value_zero(&(key->value), type);
+        mirror->ids[id] = key;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** apply a DATA frame to the keys */
+static sensor_status_t stream_mirror_data(sensor_stream_mirror_t * mirror,
+                                          stream_reader_t * reader) {
+    uint64_t    n;
+
+    mirror->time_ns += (uint64_t) stream_get_svarint(reader);
+    n = stream_get_uvarint(reader);
+    for (uint64_t i = 0; i < n && !reader->error; ++i) {
+        uint64_t        id = stream_get_uvarint(reader);
+        int64_t         delta = stream_get_svarint(reader);
+        stream_key_t *  key;
+
+        if (reader->error || id >= mirror->ids_size || (key = mirror->ids[id]) == NULL
+        ||  stream_get_value(reader, &(key->value)) != SENSOR_SUCCESS) {
+            return SENSOR_ERROR;
+        }
+        key->time_ns = mirror->time_ns + (uint64_t) delta;
+    }
+    mirror->b_catalog = 1;
+    return reader->error ? SENSOR_ERROR : SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** apply the complete frames received, under mirror lock */
+static sensor_status_t stream_mirror_parse(sensor_stream_mirror_t * mirror) {
+    size_t          off = 0;
+    sensor_status_t ret = SENSOR_SUCCESS;
+
+    while (ret == SENSOR_SUCCESS && mirror->in.size - off >= SENSOR_STREAM_FRAME_HEADER) {
+        const unsigned char *   header = mirror->in.data + off;
+        stream_reader_t         reader;
+        size_t                  size = 0;
+
+        for (unsigned int i = 0; i < 4; ++i)
+            size |= (size_t) header[1 + i] << (8 * i);
+        if (size > SENSOR_STREAM_MAX_FRAME) {
+            return SENSOR_ERROR;
+        }
+        if (mirror->in.size - off - SENSOR_STREAM_FRAME_HEADER < size)
+            break ;
+        reader.p = header + SENSOR_STREAM_FRAME_HEADER;
+        reader.end = reader.p + size;
+        reader.error = 0;
+        off += SENSOR_STREAM_FRAME_HEADER + size;
+
+        if (!mirror->b_hello && header[0] != SSK_HELLO) {
+            return SENSOR_ERROR;
+        }
+        switch (header[0]) {
+            case SSK_HELLO:
+                if (size < sizeof(SENSOR_STREAM_MAGIC)
+                ||  memcmp(reader.p, SENSOR_STREAM_MAGIC, sizeof(SENSOR_STREAM_MAGIC) - 1) != 0
+                ||  reader.p[sizeof(SENSOR_STREAM_MAGIC) - 1] != SENSOR_STREAM_VERSION) {
+                    LOG_ERROR(mirror->log, "stream: bad protocol version");
+                    return SENSOR_ERROR;
+                }
+                mirror->b_hello = 1;
+                break ;
+            case SSK_RESET:
+                if (mirror->ids != NULL)
+                    memset(mirror->ids, 0, mirror->ids_size * sizeof(*mirror->ids));
+                break ;
+            case SSK_DEFINE:
+                ret = stream_mirror_define(mirror, &reader);
+                break ;
+            case SSK_DATA:
+                ret = stream_mirror_data(mirror, &reader);
+                break ;
+            default:
+                /* unknown frames are skipped for compatibility */
+                break ;
+        }
+    }
+    memmove(mirror->in.data, mirror->in.data + off, mirror->in.size - off);
+    mirror->in.size -= off;
+    return ret;
+}
+
+/* ************************************************************************ */
+/** read and apply what the server sent, under mirror lock */
+static void stream_mirror_drain(sensor_stream_mirror_t * mirror) {
+    while (!mirror->b_eof) {
+        unsigned char * dst;
+        ssize_t         n;
+
+        if ((dst = stream_buf_reserve(&(mirror->in), 64 * 1024)) == NULL) {
+            mirror->b_eof = 1;
+            break ;
+        }
+        if ((n = recv(mirror->fd, dst, mirror->in.maxsize - mirror->in.size, MSG_DONTWAIT)) > 0) {
+            mirror->in.size += n;
+            continue ;
+        }
+        if (n < 0 && errno == EINTR)
+            continue ;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break ;
+        LOG_WARN(mirror->log, "stream: connection closed%s%s",
+                 n < 0 ? ": " : "", n < 0 ? strerror(errno) : "");
+        mirror->b_eof = 1;
+    }
+    if (mirror->in.size > 0 && stream_mirror_parse(mirror) != SENSOR_SUCCESS) {
+        LOG_ERROR(mirror->log, "stream: protocol error, connection closed");
+        mirror->b_eof = 1;
+        mirror->in.size = 0;
+    }
+}
+
+/* ************************************************************************ */
+void sensor_stream_mirror_free(sensor_stream_mirror_t * mirror) {
+    if (mirror == NULL) {
+        return ;
+    }
+    if (mirror->fd >= 0)
+        close(mirror->fd);
+    for (unsigned int i = 0; i < mirror->n_keys; ++i) {
+        stream_key_t * key = mirror->keys[i];
+
+        stream_value_zero(&(key->value), SENSOR_VALUE_NULL);
+        sensor_properties_free(key->desc.properties);
+        free(key->name);
+        free(key);
+    }
+    for (unsigned int i = 0; i < mirror->n_families; ++i) {
+        free(mirror->families[i]->name);
+        free(mirror->families[i]);
+    }
+    if (mirror->keys != NULL)
+        free(mirror->keys);
+    if (mirror->ids != NULL)
+        free(mirror->ids);
+    if (mirror->names != NULL)
+        free(mirror->names);
+    if (mirror->families != NULL)
+        free(mirror->families);
+    if (mirror->in.data != NULL)
+        free(mirror->in.data);
+    pthread_mutex_destroy(&(mirror->mutex));
+    free(mirror);
+}
+
+/* ************************************************************************ */
+static sensor_status_t stream_family_init(sensor_family_t * family) {
+    stream_family_t * sfam = (stream_family_t *) family->info;
+
+    sfam->family = family;
+    family->priv = sfam;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** keys and families belong to the mirror, freed after the families */
+static sensor_status_t stream_family_free(sensor_family_t * family) {
+    family->priv = NULL;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static slist_t * stream_family_list(sensor_family_t * family) {
+    stream_family_t *           sfam = (stream_family_t *) family->priv;
+    sensor_stream_mirror_t *    mirror = sfam->mirror;
+    slist_t *                   list = NULL;
+
+    pthread_mutex_lock(&(mirror->mutex));
+    for (unsigned int i = 0; i < mirror->n_keys; ++i) {
+        if (mirror->keys[i]->family == sfam)
+            list = slist_prepend(list, &(mirror->keys[i]->desc));
+    }
+    sfam->listed = sfam->generation;
+    pthread_mutex_unlock(&(mirror->mutex));
+    return list;
+}
+
+/* ************************************************************************ */
+/** copy the last received value of a key to sample, under mirror lock */
+static sensor_status_t stream_family_get(sensor_sample_t * sensor, const stream_key_t * key) {
+    const sensor_value_t *  value = &(key->value);
+
+    if (key->family->generation != key->family->listed) {
+        return SENSOR_RELOAD_FAMILY;
+    }
+    if (sensor->value.type == value->type
+    &&  (!SENSOR_VALUE_IS_BUFFER(value->type) || sensor->value.data.b.buf != NULL)
+    &&  sensor_value_equal(&(sensor->value), value)) {
+        return SENSOR_UNCHANGED;
+    }
+    if (SENSOR_VALUE_IS_BUFFER(value->type)) {
+        /* families allocate buffers, libvsensors frees them */
+        if (!SENSOR_VALUE_IS_BUFFER(sensor->value.type)) {
+            sensor->value.data.b.buf = NULL;
+            sensor->value.data.b.maxsize = 0;
+        }
+        if (sensor->value.data.b.maxsize < value->data.b.size + 1) {
+            char * buf;
+
+            if ((buf = realloc(sensor->value.data.b.buf, value->data.b.size + 1)) == NULL)
+                return SENSOR_ERROR;
+            sensor->value.data.b.buf = buf;
+            sensor->value.data.b.maxsize = value->data.b.size + 1;
+        }
+    }
+    return sensor_value_copy(&(sensor->value), value) == SENSOR_SUCCESS
+           ? SENSOR_UPDATED : SENSOR_ERROR;
+}
+
+/* ************************************************************************ */
+/** drain the socket once per 'now', under mirror lock */
+static void stream_family_drain(sensor_stream_mirror_t * mirror, const struct timeval * now) {
+    if (now == NULL || now->tv_sec != mirror->drained.tv_sec
+    ||  now->tv_usec != mirror->drained.tv_usec) {
+        stream_mirror_drain(mirror);
+        if (now != NULL)
+            mirror->drained = *now;
+    }
+}
+
+/* ************************************************************************ */
+static sensor_status_t stream_family_update(sensor_sample_t * sensor, const struct timeval * now) {
+    const stream_key_t *        key = (const stream_key_t *) sensor->desc->key;
+    sensor_stream_mirror_t *    mirror = key->family->mirror;
+    sensor_status_t             ret;
+
+    pthread_mutex_lock(&(mirror->mutex));
+    stream_family_drain(mirror, now);
+    ret = stream_family_get(sensor, key);
+    pthread_mutex_unlock(&(mirror->mutex));
+    return ret;
+}
+
+/* ************************************************************************ */
+static sensor_status_t stream_family_update_batch(
+                            sensor_family_t *   family,
+                            sensor_sample_t **  samples,
+                            unsigned int        n,
+                            const struct timeval * now,
+                            sensor_status_t *   results) {
+    sensor_stream_mirror_t * mirror = ((stream_family_t *) family->priv)->mirror;
+
+    pthread_mutex_lock(&(mirror->mutex));
+    stream_family_drain(mirror, now);
+    for (unsigned int i = 0; i < n; ++i) {
+        results[i] = stream_family_get(samples[i], (const stream_key_t *) samples[i]->desc->key);
+    }
+    pthread_mutex_unlock(&(mirror->mutex));
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_ctx_t * sensor_stream_connect(
+                    logpool_t *     logs,
+                    unsigned int    flags,
+                    const char *    address,
+                    long            timeout_ms) {
+    sensor_ctx_t *              sctx;
+    sensor_stream_mirror_t *    mirror;
+    struct timeval              start, now;
+
+    if (address == NULL || (sctx = sensor_init_families(logs, flags, "")) == NULL) {
+        return NULL;
+    }
+    if ((mirror = calloc(1, sizeof(*mirror))) == NULL) {
+        sensor_free(sctx);
+        return NULL;
+    }
+    mirror->sctx = sctx;
+    mirror->log = sensor_ctx_log(sctx);
+    pthread_mutex_init(&(mirror->mutex), NULL);
+    sensor_stream_mirror_attach(sctx, mirror);
+
+    if ((mirror->fd = stream_socket(address, 0, timeout_ms, mirror->log)) < 0) {
+        sensor_free(sctx);
+        return NULL;
+    }
+    /* the catalog is sent by the next update pass of the server */
+    gettimeofday(&start, NULL);
+    while (!mirror->b_catalog && !mirror->b_eof) {
+        struct pollfd   pfd = { .fd = mirror->fd, .events = POLLIN, .revents = 0 };
+        long            elapsed_ms;
+
+        gettimeofday(&now, NULL);
+        elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+        if (timeout_ms >= 0 && elapsed_ms >= timeout_ms) {
+            LOG_ERROR(mirror->log, "stream: no catalog received from '%s'", address);
+            sensor_free(sctx);
+            return NULL;
+        }
+        if (poll(&pfd, 1, timeout_ms < 0 ? -1 : timeout_ms - elapsed_ms) > 0) {
+            stream_mirror_drain(mirror);
+        }
+    }
+    if (!mirror->b_catalog) {
+        sensor_free(sctx);
+        return NULL;
+    }
+
+    /* families of the catalog: sensors of other families defined later are not mirrored */
+    mirror->b_families = 1;
+    for (unsigned int i = 0; i < mirror->n_families; ++i) {
+        stream_family_t * sfam = mirror->families[i];
+
+        sfam->info.name = sfam->name;
+        sfam->info.init = stream_family_init;
+        sfam->info.free = stream_family_free;
+        sfam->info.update = stream_family_update;
+        sfam->info.list = stream_family_list;
+        sfam->info.flags = SFF_PRECISE_UPDATE;
+        sfam->info.update_batch = stream_family_update_batch;
+        if (sensor_family_register(sctx, &(sfam->info)) != SENSOR_SUCCESS) {
+            LOG_WARN(mirror->log, "stream: cannot register family %s", sfam->name);
+        }
+    }
+    LOG_VERBOSE(mirror->log, "stream: mirroring %u sensors of %u families from '%s'",
+                mirror->n_keys, mirror->n_families, address);
+    return sctx;
+}
+
+/* ************************************************************************ */
+sensor_status_t sensor_stream_time(const sensor_desc_t * desc, uint64_t * realtime_ns) {
+    const stream_key_t *        key;
+    sensor_stream_mirror_t *    mirror;
+
+    if (desc == NULL || realtime_ns == NULL || desc->family == NULL
+    ||  desc->family->info->update != stream_family_update) {
+        return SENSOR_ERROR;
+    }
+    key = (const stream_key_t *) desc->key;
+    mirror = key->family->mirror;
+    pthread_mutex_lock(&(mirror->mutex));
+    *realtime_ns = key->time_ns;
+    pthread_mutex_unlock(&(mirror->mutex));
+    return SENSOR_SUCCESS;
+}
@@ -80,16 +80,26 @@ typedef struct {
 } sensor_value_info_t;
 static sensor_value_info_t s_sensor_value_info[SENSOR_VALUE_NB + 1] = { { SIZE_MAX, SIZE_MAX}, };
 
+/* builds s_sensor_value_info on first use */
+#define SENSOR_VALUE_INFO_CHECK() \
+    do { \
+        if (SENSOR_UNLIKELY(__atomic_load_n(&(s_sensor_value_info[0].size), \
+                                            __ATOMIC_ACQUIRE) == SIZE_MAX)) \
+            sensor_value_info_init(); \
+    } while (0)
+
 #define SENSOR_VALUE_INFO_INIT(val, field) \
     (sensor_value_info_t) { sizeof(val.field), VLIB_OFFSETOF(sensor_value_t, field) }
 
+static pthread_once_t s_sensor_value_info_once = PTHREAD_ONCE_INIT;
+
 // *************************************************************************************
-void sensor_value_info_init() {
-    sensor_value_info_t * const info = s_sensor_value_info;
-    if (info[0].size != SIZE_MAX)
-        return ;
+/** fills a copy of the table shared by all sensor contexts, published by
+ * its first entry, which readers check before using the other ones */
+static void sensor_value_info_build() {
+    sensor_value_info_t info[SENSOR_VALUE_NB + 1];
     sensor_value_t v;
-    memset(s_sensor_value_info, 0, sizeof(s_sensor_value_info));
+    memset(info, 0, sizeof(info));
     info[0]                     = (sensor_value_info_t) { 0, 0 };
     info[SENSOR_VALUE_NULL]     = (sensor_value_info_t) { 0, 0 };
     info[SENSOR_VALUE_UCHAR]    = SENSOR_VALUE_INFO_INIT(v, data.uc);
@@ -110,6 +120,15 @@ void sensor_value_info_init() {
     info[SENSOR_VALUE_STRING]   = SENSOR_VALUE_INFO_INIT(v, data.b.buf);
     info[SENSOR_VALUE_BYTES]    = SENSOR_VALUE_INFO_INIT(v, data.b.buf);
     info[SENSOR_VALUE_NB]       = SENSOR_VALUE_INFO_INIT(v, data.c);
+
+    memcpy(s_sensor_value_info + 1, info + 1, sizeof(info) - sizeof(*info));
+    __atomic_store_n(&(s_sensor_value_info[0].off), info[0].off, __ATOMIC_RELAXED);
+    __atomic_store_n(&(s_sensor_value_info[0].size), info[0].size, __ATOMIC_RELEASE);
+}
+
+// *************************************************************************************
+void sensor_value_info_init() {
+    pthread_once(&s_sensor_value_info_once, sensor_value_info_build);
 }
 
 // *************************************************************************************
@@ -132,13 +151,16 @@ sensor_status_t sensor_value_fromraw(const void *src, sensor_value_t * value) {
             return SENSOR_UPDATED;
         }
         case SENSOR_VALUE_STRING:
+            if (value->data.b.maxsize > 0
+            &&  strncmp(value->data.b.buf, (const char *) src, value->data.b.maxsize - 1) == 0) {
+                return SENSOR_UNCHANGED;
+            }
             value->data.b.size = str0cpy(value->data.b.buf, (const char *) src,
                                          value->data.b.maxsize);
-            break ;
+            return SENSOR_UPDATED;
         default: {
             const sensor_value_info_t * info;
-            if (SENSOR_UNLIKELY(s_sensor_value_info[0].size == SIZE_MAX))
-                sensor_value_info_init();
+            SENSOR_VALUE_INFO_CHECK();
             info = &(s_sensor_value_info[value->type]);
             if (memcmp((unsigned char *)value + info->off, src, info->size) == 0) {
                 return SENSOR_UNCHANGED;
@@ -198,6 +220,124 @@ sensor_status_t sensor_value_frombuffer(const char * src, unsigned int size,
     return SENSOR_UPDATED;
 }
 
+// *************************************************************************************
+/* Fast formatting of scalars, same output as the snprintf() formats they replace.
+ * Digits are written backwards from the end of a local buffer. */
+#define SENSOR_FMT_BUFSZ    48
+
+static const char s_sensor_digits2[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/** write decimal digits of v ending at end, return the first written char */
+static inline char * sensor_fmt_u64(char * end, uint64_t v) {
+    while (v >= 100) {
+        unsigned int i = (unsigned int) (v % 100) * 2;
+        v /= 100;
+        *(--end) = s_sensor_digits2[i + 1];
+        *(--end) = s_sensor_digits2[i];
+    }
+    if (v >= 10) {
+        unsigned int i = (unsigned int) v * 2;
+        *(--end) = s_sensor_digits2[i + 1];
+        *(--end) = s_sensor_digits2[i];
+    } else {
+        *(--end) = (char) ('0' + v);
+    }
+    return end;
+}
+
+/** copy the formatted [start,end[ in dst, with the truncation of VLIB_SNPRINTF() */
+static inline int sensor_fmt_put(char * dst, size_t maxlen, const char * start, const char * end) {
+    size_t len = end - start;
+
+    if (len >= maxlen)
+        len = maxlen - 1;
+    memcpy(dst, start, len);
+    dst[len] = 0;
+    return (int) len;
+}
+
+static inline int sensor_fmt_int(char * dst, size_t maxlen, int64_t v) {
+    char    buf[SENSOR_FMT_BUFSZ];
+    char *  end = buf + sizeof(buf);
+    char *  start;
+
+    /* negation done in unsigned to support INT64_MIN */
+    start = sensor_fmt_u64(end, v < 0 ? (uint64_t) 0 - (uint64_t) v : (uint64_t) v);
+    if (v < 0)
+        *(--start) = '-';
+    return sensor_fmt_put(dst, maxlen, start, end);
+}
+
+static inline int sensor_fmt_uint(char * dst, size_t maxlen, uint64_t v) {
+    char    buf[SENSOR_FMT_BUFSZ];
+    char *  end = buf + sizeof(buf);
+
+    return sensor_fmt_put(dst, maxlen, sensor_fmt_u64(end, v), end);
+}
+
+/** "%f" of a double, exact: the binary value m.2^e is scaled by 10^6 on 128 bits
+ * and rounded half to even, as glibc does in the default rounding mode.
+ * Outside of |d| < 1e12, and for nan/inf, -1 is returned to use snprintf(). */
+static int sensor_fmt_double(char * dst, size_t maxlen, double d) {
+    char        buf[SENSOR_FMT_BUFSZ];
+    char *      end = buf + sizeof(buf);
+    char *      start;
+    int         neg = signbit(d) != 0, exp;
+    uint64_t    m, hi, lo, mh, ml, q, frac;
+    double      mant;
+    unsigned    shift;
+
+    if (!(fabs(d) < 1e12))
+        return -1;
+    /* d = m * 2^exp, m integer < 2^53 */
+    mant = frexp(fabs(d), &exp);
+    m = (uint64_t) ldexp(mant, 53);
+    exp -= 53;
+    if (m == 0) {
+        q = 0;
+    } else if (exp >= 0) {
+        q = (m << exp) * UINT64_C(1000000); /* < 1e18 as |d| < 1e12 */
+    } else if ((shift = (unsigned) -exp) > 74) {
+        q = 0; /* m * 10^6 < 2^73: less than half of 2^shift */
+    } else {
+        /* (hi,lo) = m * 10^6 */
+        mh = (m >> 32) * UINT64_C(1000000);
+        ml = (m & UINT64_C(0xffffffff)) * UINT64_C(1000000);
+        lo = ml + (mh << 32);
+        hi = (mh >> 32) + (lo < ml);
+        /* q = (hi,lo) >> shift, rounded half to even */
+        if (shift < 64) {
+            uint64_t rem  = lo & ((UINT64_C(1) << shift) - 1);
+            uint64_t half = UINT64_C(1) << (shift - 1);
+            q = (lo >> shift) | (hi << (64 - shift));
+            if (rem > half || (rem == half && (q & 1) != 0))
+                ++q;
+        } else {
+            uint64_t rem_hi = shift == 64 ? 0 : hi & ((UINT64_C(1) << (shift - 64)) - 1);
+            uint64_t half_hi = shift == 64 ? 0 : UINT64_C(1) << (shift - 65);
+            uint64_t half_lo = shift == 64 ? UINT64_C(1) << 63 : 0;
+            int      cmp;
+            q = shift == 64 ? hi : hi >> (shift - 64);
+            cmp = rem_hi != half_hi ? (rem_hi > half_hi ? 1 : -1)
+                : lo != half_lo ? (lo > half_lo ? 1 : -1) : 0;
+            if (cmp > 0 || (cmp == 0 && (q & 1) != 0))
+                ++q;
+        }
+    }
+    frac = q % UINT64_C(1000000);
+    q /= UINT64_C(1000000);
+    for (int i = 0; i < 6; ++i, frac /= 10)
+        *(--end) = (char) ('0' + frac % 10);
+    *(--end) = '.';
+    start = sensor_fmt_u64(end, q);
+    if (neg)
+        *(--start) = '-';
+    return sensor_fmt_put(dst, maxlen, start, buf + sizeof(buf));
+}
+
 // *************************************************************************************
 int sensor_value_tostring(const sensor_value_t * value, char *dst, size_t maxlen) {
     int ret;
@@ -213,47 +353,41 @@ int sensor_value_tostring(const sensor_value_t * value, char *dst, size_t maxlen
     }
     switch (value->type) {
         case SENSOR_VALUE_UCHAR:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%u",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_UCHAR));
+            return sensor_fmt_uint(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_UCHAR));
         case SENSOR_VALUE_CHAR:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%d",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_CHAR));
+            return sensor_fmt_int(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_CHAR));
         case SENSOR_VALUE_UINT:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%u",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT));
+            return sensor_fmt_uint(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT));
         case SENSOR_VALUE_INT:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%d",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT));
+            return sensor_fmt_int(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT));
         case SENSOR_VALUE_UINT16:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%u",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT16));
+            return sensor_fmt_uint(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT16));
         case SENSOR_VALUE_INT16:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%d",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT16));
+            return sensor_fmt_int(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT16));
         case SENSOR_VALUE_UINT32:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%u",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT32));
+            return sensor_fmt_uint(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT32));
         case SENSOR_VALUE_INT32:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%d",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT32));
+            return sensor_fmt_int(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT32));
         case SENSOR_VALUE_ULONG:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%lu",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_ULONG));
+            return sensor_fmt_uint(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_ULONG));
         case SENSOR_VALUE_LONG:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%ld",
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_LONG));
+            return sensor_fmt_int(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_LONG));
         case SENSOR_VALUE_UINT64:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%" PRIu64,
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT64));
+            return sensor_fmt_uint(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_UINT64));
         case SENSOR_VALUE_INT64:
-            return VLIB_SNPRINTF(ret, dst, maxlen, "%" PRId64,
-                                 SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT64));
+            return sensor_fmt_int(dst, maxlen, SENSOR_VALUEP_GET(value, SENSOR_VALUE_INT64));
         case SENSOR_VALUE_FLOAT:
            /* Need a particular case for Float as new C libraries (from c99 i think)
              * do not support float, and always promote them to double before conversion */
+            if ((ret = sensor_fmt_double(dst, maxlen,
+                                         SENSOR_VALUEP_GET(value, SENSOR_VALUE_FLOAT))) >= 0)
+                return ret;
             return VLIB_SNPRINTF(ret, dst, maxlen, "%f",
                                  SENSOR_VALUEP_GET(value, SENSOR_VALUE_FLOAT));
         case SENSOR_VALUE_DOUBLE:
+            if ((ret = sensor_fmt_double(dst, maxlen,
+                                         SENSOR_VALUEP_GET(value, SENSOR_VALUE_DOUBLE))) >= 0)
+                return ret;
             return VLIB_SNPRINTF(ret, dst, maxlen, "%lf",
                                  SENSOR_VALUEP_GET(value, SENSOR_VALUE_DOUBLE));
         case SENSOR_VALUE_LDOUBLE:
@@ -291,6 +425,29 @@ int sensor_value_tostring(const sensor_value_t * value, char *dst, size_t maxlen
     return -1; /* should not be reached */
 }
 
+// *************************************************************************************
+int sensor_values_tostring_n(const sensor_value_t * values, size_t n, const char * sep,
+                             char * dst, size_t maxlen) {
+    size_t  len = 0, sep_len;
+    int     ret;
+
+    if (SENSOR_UNLIKELY(dst == NULL || maxlen == 0 || (values == NULL && n > 0)))
+        return -1;
+    sep_len = sep == NULL ? 0 : strlen(sep);
+    *dst = 0;
+    for (size_t i = 0; i < n && len + 1 < maxlen; ++i) {
+        if (i > 0 && sep_len > 0) {
+            len += str0cpy(dst + len, sep, maxlen - len);
+            if (len + 1 >= maxlen)
+                break ;
+        }
+        if ((ret = sensor_value_tostring(values + i, dst + len, maxlen - len)) < 0)
+            return -1;
+        len += ret;
+    }
+    return (int) len;
+}
+
 // *************************************************************************************
 long double sensor_value_todouble(const sensor_value_t * value) {
     long double result = 0.0L;
@@ -510,8 +667,7 @@ int sensor_value_equal(const sensor_value_t * v1, const sensor_value_t * v2) {
         /* generic memory compare for remaining types */
         default: {
             const sensor_value_info_t * info;
-            if (SENSOR_UNLIKELY(s_sensor_value_info[0].size == SIZE_MAX))
-                sensor_value_info_init();
+            SENSOR_VALUE_INFO_CHECK();
             info = &(s_sensor_value_info[v1->type]);
             return 0 == memcmp((unsigned char *)v1 + info->off,
                                (unsigned char *)v2 + info->off, info->size);
@@ -577,8 +733,7 @@ sensor_status_t sensor_value_copy(sensor_value_t * dst, const sensor_value_t * s
         return SENSOR_SUCCESS;
     } else {
         const sensor_value_info_t * info;
-        if (SENSOR_UNLIKELY(s_sensor_value_info[0].size == SIZE_MAX))
-            sensor_value_info_init();
+        SENSOR_VALUE_INFO_CHECK();
         info = &(s_sensor_value_info[src->type]);
 
         if (memcpy((unsigned char *) dst + info->off, (unsigned char *) src + info->off,
@@ -588,6 +743,246 @@ sensor_status_t sensor_value_copy(sensor_value_t * dst, const sensor_value_t * s
     }
 }
 
+// *************************************************************************************
+size_t sensor_value_type_size(sensor_value_type_t type) {
+    if (SENSOR_UNLIKELY((unsigned int) type >= SENSOR_VALUE_NB
+                        || type == SENSOR_VALUE_NULL || SENSOR_VALUE_IS_BUFFER(type)))
+        return 0;
+    SENSOR_VALUE_INFO_CHECK();
+    return s_sensor_value_info[type].size;
+}
+
+/* branchless loops, vectorized by the compiler: the type is switched once per array */
+#define SENSOR_SCALARS_EQUAL_N(_type, _a, _b, _n, _equal, _count)                 \
+    do {                                                                            \
+        const _type * a_ = (const _type *) (_a);                                    \
+        const _type * b_ = (const _type *) (_b);                                    \
+        if ((_equal) == NULL) {                                                     \
+            for (size_t i_ = 0; i_ < (_n); ++i_)                                    \
+                (_count) += (a_[i_] == b_[i_]);                                     \
+        } else {                                                                    \
+            for (size_t i_ = 0; i_ < (_n); ++i_)                                    \
+                (_count) += ((_equal)[i_] = (a_[i_] == b_[i_]));                    \
+        }                                                                           \
+    } while (0)
+
+// *************************************************************************************
+size_t sensor_scalars_equal_n(sensor_value_type_t type, const void * a, const void * b,
+                              size_t n, unsigned char * equal) {
+    size_t count = 0;
+
+    if (SENSOR_UNLIKELY(a == NULL || b == NULL))
+        return 0;
+    switch (type) {
+        /* floating are compared by value, same as sensor_value_equal() */
+        case SENSOR_VALUE_FLOAT:
+            SENSOR_SCALARS_EQUAL_N(float, a, b, n, equal, count); break ;
+        case SENSOR_VALUE_DOUBLE:
+            SENSOR_SCALARS_EQUAL_N(double, a, b, n, equal, count); break ;
+        case SENSOR_VALUE_LDOUBLE:
+            SENSOR_SCALARS_EQUAL_N(long double, a, b, n, equal, count); break ;
+        /* integers are compared by width */
+        default:
+            switch (sensor_value_type_size(type)) {
+                case 1: SENSOR_SCALARS_EQUAL_N(uint8_t, a, b, n, equal, count); break ;
+                case 2: SENSOR_SCALARS_EQUAL_N(uint16_t, a, b, n, equal, count); break ;
+                case 4: SENSOR_SCALARS_EQUAL_N(uint32_t, a, b, n, equal, count); break ;
+                case 8: SENSOR_SCALARS_EQUAL_N(uint64_t, a, b, n, equal, count); break ;
+                default: return 0;
+            }
+            break ;
+    }
+    return count;
+}
+
+/* loop on a run of same-typed sensor values, on the given data field */
+#define SENSOR_VALUES_EQUAL_RUN(_field, _v1, _v2, _n, _equal, _count)             \
+    do {                                                                            \
+        if ((_equal) == NULL) {                                                     \
+            for (size_t i_ = 0; i_ < (_n); ++i_)                                    \
+                (_count) += ((_v1)[i_].data._field == (_v2)[i_].data._field);       \
+        } else {                                                                    \
+            for (size_t i_ = 0; i_ < (_n); ++i_)                                    \
+                (_count) += ((_equal)[i_]                                           \
+                             = ((_v1)[i_].data._field == (_v2)[i_].data._field));   \
+        }                                                                           \
+    } while (0)
+
+// *************************************************************************************
+size_t sensor_values_equal_n(const sensor_value_t * v1, const sensor_value_t * v2,
+                             size_t n, unsigned char * equal) {
+    size_t count = 0;
+
+    if (SENSOR_UNLIKELY(v1 == NULL || v2 == NULL))
+        return 0;
+
+    for (size_t start = 0, end; start < n; start = end) {
+        sensor_value_type_t type = v1[start].type;
+        size_t              run;
+
+        /* run of values having the same type in both arrays */
+        for (end = start; end < n && v1[end].type == type && v2[end].type == type; ++end)
+            ; /* nothing but loop */
+        if (end == start) {
+            /* different types */
+            if (equal != NULL)
+                equal[start] = 0;
+            end = start + 1;
+            continue ;
+        }
+        run = end - start;
+        switch (type) {
+            case SENSOR_VALUE_CHAR:
+            case SENSOR_VALUE_UCHAR:
+                SENSOR_VALUES_EQUAL_RUN(uc, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_INT16:
+            case SENSOR_VALUE_UINT16:
+                SENSOR_VALUES_EQUAL_RUN(u16, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_INT:
+            case SENSOR_VALUE_UINT:
+                SENSOR_VALUES_EQUAL_RUN(ui, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_INT32:
+            case SENSOR_VALUE_UINT32:
+                SENSOR_VALUES_EQUAL_RUN(u32, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_LONG:
+            case SENSOR_VALUE_ULONG:
+                SENSOR_VALUES_EQUAL_RUN(ul, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_INT64:
+            case SENSOR_VALUE_UINT64:
+                SENSOR_VALUES_EQUAL_RUN(u64, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_FLOAT:
+                SENSOR_VALUES_EQUAL_RUN(f, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_DOUBLE:
+                SENSOR_VALUES_EQUAL_RUN(d, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            case SENSOR_VALUE_LDOUBLE:
+                SENSOR_VALUES_EQUAL_RUN(ld, v1 + start, v2 + start, run,
+                                        equal ? equal + start : NULL, count); break ;
+            default:
+                /* buffers, null and unknown types */
+                for (size_t i = start; i < end; ++i) {
+                    int eq = sensor_value_equal(v1 + i, v2 + i) != 0;
+                    if (equal != NULL)
+                        equal[i] = eq;
+                    count += eq;
+                }
+                break ;
+        }
+    }
+    return count;
+}
+
+// *************************************************************************************
+size_t sensor_values_copy_n(sensor_value_t * dst, const sensor_value_t * src, size_t n) {
+    size_t count = 0;
+
+    if (SENSOR_UNLIKELY(dst == NULL || src == NULL))
+        return 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (SENSOR_VALUE_IS_BUFFER(src[i].type)) {
+            count += (sensor_value_copy(dst + i, src + i) == SENSOR_SUCCESS);
+        } else if (SENSOR_LIKELY((unsigned int) src[i].type < SENSOR_VALUE_NB)) {
+            /* scalars: plain copy of the whole data union, without type switch */
+            dst[i].type = src[i].type;
+            dst[i].data = src[i].data;
+            ++count;
+        }
+    }
+    return count;
+}
+
+/***************************************************************************
+ * SENSOR_VALUE typed operations, generated from SENSOR_VALUE_SCALARS_X
+ ***************************************************************************/
+static inline intmax_t sensor_value_toint_cast(intmax_t result) {
+    if (result == INTMAX_C(0))
+        errno = 0;
+    return result;
+}
+
+static inline intmax_t sensor_value_toint_umax(uintmax_t uresult) {
+    if (uresult > INTMAX_MAX) {
+        errno = EOVERFLOW;
+        return (uresult - INTMAX_MAX);
+    }
+    errno = 0;
+    return uresult;
+}
+
+static inline intmax_t sensor_value_toint_ld(long double ld) {
+    if (ld > INTMAX_MAX) {
+        errno = EOVERFLOW;
+        return ((uintmax_t)ld - INTMAX_MAX);
+    }
+    if (ld < INTMAX_MIN) {
+        errno = ERANGE;
+        return (ld + INTMAX_MIN);
+    }
+    errno = 0;
+    return ld;
+}
+
+#define SENSOR_VALUE_TOINT_INT(_x)      sensor_value_toint_cast((intmax_t) (_x))
+#define SENSOR_VALUE_TOINT_UMAX(_x)     sensor_value_toint_umax(_x)
+#define SENSOR_VALUE_TOINT_LDOUBLE(_x)  sensor_value_toint_ld(_x)
+
+/* all union members start at data: raw bytes are compared as sensor_value_fromraw() */
+#define SENSOR_VALUE_OPS_DEFINE(_type, _name, _toint)                                     \
+    sensor_status_t sensor_value_fromraw_##_name(const void * src, sensor_value_t * value) { \
+        TYPE_SENSOR_VALUE_##_type raw;                                                      \
+        memcpy(&raw, src, sizeof(raw));                                                     \
+        if (memcmp(&(value->data), &raw, sizeof(raw)) == 0)                                 \
+            return SENSOR_UNCHANGED;                                                        \
+        memcpy(&(value->data), &raw, sizeof(raw));                                          \
+        return SENSOR_UPDATED;                                                              \
+    }                                                                                       \
+    int sensor_value_equal_##_name(const sensor_value_t * v1, const sensor_value_t * v2) {  \
+        return v1->type == v2->type                                                         \
+               && SENSOR_VALUEP_GET(v1, SENSOR_VALUE_##_type)                               \
+                  == SENSOR_VALUEP_GET(v2, SENSOR_VALUE_##_type);                           \
+    }                                                                                       \
+    long double sensor_value_todouble_##_name(const sensor_value_t * value) {               \
+        long double result = SENSOR_VALUEP_GET(value, SENSOR_VALUE_##_type);                \
+        if (result == 0.0L)                                                                 \
+            errno = 0;                                                                      \
+        return result;                                                                      \
+    }                                                                                       \
+    intmax_t sensor_value_toint_##_name(const sensor_value_t * value) {                     \
+        return SENSOR_VALUE_TOINT_##_toint(SENSOR_VALUEP_GET(value, SENSOR_VALUE_##_type)); \
+    }
+SENSOR_VALUE_SCALARS_X(SENSOR_VALUE_OPS_DEFINE)
+
+#define SENSOR_VALUE_OPS_ENTRY(_type, _name, _toint)                                      \
+    [SENSOR_VALUE_##_type] = { SENSOR_VALUE_##_type, sensor_value_fromraw_##_name,          \
+                               sensor_value_equal_##_name, sensor_value_todouble_##_name,   \
+                               sensor_value_toint_##_name },
+#define SENSOR_VALUE_OPS_GENERIC(_type)                                                    \
+    [_type] = { _type, sensor_value_fromraw, sensor_value_equal,                            \
+                sensor_value_todouble, sensor_value_toint },
+
+static const sensor_value_ops_t s_sensor_value_ops[SENSOR_VALUE_NB + 1] = {
+    SENSOR_VALUE_OPS_GENERIC(SENSOR_VALUE_NULL)
+    SENSOR_VALUE_SCALARS_X(SENSOR_VALUE_OPS_ENTRY)
+    SENSOR_VALUE_OPS_GENERIC(SENSOR_VALUE_STRING)
+    SENSOR_VALUE_OPS_GENERIC(SENSOR_VALUE_BYTES)
+    SENSOR_VALUE_OPS_GENERIC(SENSOR_VALUE_NB)
+};
+
+// *************************************************************************************
+const sensor_value_ops_t * sensor_value_ops(sensor_value_type_t type) {
+    if (SENSOR_UNLIKELY((unsigned int) type >= SENSOR_VALUE_NB))
+        type = SENSOR_VALUE_NB;
+    return &(s_sensor_value_ops[type]);
+}
+
 // *************************************************************************************
 int sensor_value_compare_fallback(const sensor_value_t * v1, const sensor_value_t * v2) {
     if (SENSOR_VALUE_IS_FLOATING(v1->type) && SENSOR_VALUE_IS_FLOATING(v2->type)) {
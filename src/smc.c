@@ -35,8 +35,12 @@
 #include <limits.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "vlib/log.h"
 #include "vlib/job.h"
@@ -46,6 +50,7 @@
 
 #include "smc.h"
 #include "smc_private.h"
+#include "sensor_private.h"
 
 /* ************************************************************************ */
 sensor_status_t     sysdep_smc_support(sensor_family_t * family, const char * label);
@@ -76,6 +81,35 @@ int                 sysdep_smc_writekey(
                         const sensor_value_t* value,
                         void *          smc_handle,
                         log_t *         log);
+int                 sysdep_smc_keyinfo(
+                        uint32_t        key,
+                        uint32_t        index,
+                        void **         key_info,
+                        void *          smc_handle,
+                        log_t *         log);
+int                 sysdep_smc_fingerprint(
+                        uint32_t *      fingerprint,
+                        void *          smc_handle,
+                        log_t *         log);
+/** read nb_keys keys back-to-back, as sysdep_smc_readkey() without value_type would do:
+ * key_infos[i] is given as key_info, output of keys[i] is in output_buffers + i * bufsize
+ * and value_sizes[i] is set to the sysdep_smc_readkey() result.
+ * Returns the number of keys read or SENSOR_ERROR. */
+int                 sysdep_smc_readkeys(
+                        unsigned int    nb_keys,
+                        const uint32_t * keys,
+                        void ***        key_infos,
+                        void *          output_buffers,
+                        int *           value_sizes,
+                        void *          smc_handle,
+                        log_t *         log);
+
+/* ************************************************************************ */
+/* The catalog cache keeps the enumerated keys, see smc_catalog_load(), in the
+ * per-user cache directory ($XDG_CACHE_HOME, or $HOME/.cache).
+ * VSENSORS_SMC_CACHE environment variable overrides its path, or disables it if empty. */
+#define SMC_CATALOG_NAME    "libvsensors-smc.cache"
+#define SMC_CATALOG_ENV     "VSENSORS_SMC_CACHE"
 
 /* ************************************************************************ */
 typedef struct {
@@ -86,6 +120,21 @@ typedef struct {
     char *              smc_buffer;
     slist_t *           jobs;
     slist_t *           descs;
+    sensor_arena_t *    arena;          /* arena of descs being listed */
+    sensor_arena_t *    listed_arena;   /* arena of descs given to libvsensors */
+    sensor_arena_t *    retired_arena;  /* arena of previous descs, listed during a reload */
+    char *              catalog_path;
+    /* update_batch() data, for batch_max samples */
+    unsigned int        batch_max;
+    uint32_t *          batch_keys;
+    void ***            batch_infos;
+    int *               batch_sizes;
+    unsigned int *      batch_samples;
+    char *              batch_buffer;
+    uint16_t *          batch_raw;
+    uint16_t *          batch_signs;
+    float *             batch_scales;
+    float *             batch_values;
 } smc_priv_t;
 
 typedef sensor_status_t (*smc_format_fun_t)(
@@ -98,6 +147,18 @@ typedef sensor_status_t (*smc_write_fun_t)(
                                 char * bytes, const sensor_value_t * value,
                                 sensor_family_t * family);
 
+/** decode plans of keys, for smc_decode_batch() */
+typedef enum {
+    SMC_PLAN_NONE       = 0,        /* format_fun is used */
+    SMC_PLAN_U16,                   /* float value = ntohs(bytes) * scale */
+    SMC_PLAN_S16,                   /* float value = (int16_t) ntohs(bytes) * scale */
+} smc_decode_plan_t;
+
+typedef enum {
+    SMC_KEY_NONE        = 0,
+    SMC_KEY_UNCHECKED   = 1 << 0,   /* from catalog cache, type/size checked on first read */
+} smc_key_flag_t;
+
 typedef struct {
     uint32_t            value_key;
     uint32_t            value_type;
@@ -106,6 +167,9 @@ typedef struct {
     smc_format_fun_t    format_fun;
     smc_write_fun_t     write_fun;
     void *              key_info;
+    unsigned int        flags;
+    smc_decode_plan_t   plan;
+    float               scale;
 } smc_desc_key_t;
 
 /* ************************************************************************ */
@@ -120,8 +184,108 @@ static sensor_status_t  smc_putsensorvalue(
                             sensor_family_t *   family);
 
 static sensor_status_t  smc_list(sensor_family_t * family);
+static sensor_status_t  smc_catalog_load(sensor_family_t * family);
 static void             smc_free_desc(void * data);
 
+extern const sensor_family_info_t g_sensor_family_smc_loaded;
+
+/* ************************************************************************ */
+static void smc_batch_free(smc_priv_t * priv) {
+    if (priv->batch_keys != NULL)
+        free(priv->batch_keys);
+    if (priv->batch_infos != NULL)
+        free(priv->batch_infos);
+    if (priv->batch_sizes != NULL)
+        free(priv->batch_sizes);
+    if (priv->batch_samples != NULL)
+        free(priv->batch_samples);
+    if (priv->batch_buffer != NULL)
+        free(priv->batch_buffer);
+    if (priv->batch_raw != NULL)
+        free(priv->batch_raw);
+    if (priv->batch_signs != NULL)
+        free(priv->batch_signs);
+    if (priv->batch_scales != NULL)
+        free(priv->batch_scales);
+    if (priv->batch_values != NULL)
+        free(priv->batch_values);
+    priv->batch_keys = NULL;
+    priv->batch_infos = NULL;
+    priv->batch_sizes = NULL;
+    priv->batch_samples = NULL;
+    priv->batch_buffer = NULL;
+    priv->batch_raw = NULL;
+    priv->batch_signs = NULL;
+    priv->batch_scales = NULL;
+    priv->batch_values = NULL;
+    priv->batch_max = 0;
+}
+
+/** grow the update_batch() arrays for n samples */
+static sensor_status_t smc_batch_reserve(smc_priv_t * priv, unsigned int n) {
+    if (n <= priv->batch_max) {
+        return SENSOR_SUCCESS;
+    }
+    smc_batch_free(priv);
+    if ((priv->batch_keys = malloc(n * sizeof(*priv->batch_keys))) == NULL
+    ||  (priv->batch_infos = malloc(n * sizeof(*priv->batch_infos))) == NULL
+    ||  (priv->batch_sizes = malloc(n * sizeof(*priv->batch_sizes))) == NULL
+    ||  (priv->batch_samples = malloc(n * sizeof(*priv->batch_samples))) == NULL
+    ||  (priv->batch_buffer = malloc((size_t) n * priv->output_bufsz)) == NULL
+    ||  (priv->batch_raw = malloc(n * sizeof(*priv->batch_raw))) == NULL
+    ||  (priv->batch_signs = malloc(n * sizeof(*priv->batch_signs))) == NULL
+    ||  (priv->batch_scales = malloc(n * sizeof(*priv->batch_scales))) == NULL
+    ||  (priv->batch_values = malloc(n * sizeof(*priv->batch_values))) == NULL) {
+        smc_batch_free(priv);
+        return SENSOR_ERROR;
+    }
+    priv->batch_max = n;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/* The SMC connection is opened once for all sensor contexts */
+static pthread_mutex_t  s_smc_handle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void *           s_smc_handle = NULL;
+static unsigned int     s_smc_handle_refs = 0;
+static unsigned int     s_smc_output_bufsz = 0;
+static unsigned int     s_smc_value_offset = 0;
+
+/* ************************************************************************ */
+static int smc_handle_acquire(smc_priv_t * priv, log_t * log) {
+    int ret = SENSOR_SUCCESS;
+
+    pthread_mutex_lock(&s_smc_handle_mutex);
+    if (s_smc_handle == NULL
+    &&  (ret = sysdep_smc_open(&s_smc_handle, log,
+                               &s_smc_output_bufsz, &s_smc_value_offset)) != SENSOR_SUCCESS) {
+        s_smc_handle = NULL;
+    } else {
+        ++s_smc_handle_refs;
+        priv->smc_handle = s_smc_handle;
+        priv->output_bufsz = s_smc_output_bufsz;
+        priv->value_offset = s_smc_value_offset;
+    }
+    pthread_mutex_unlock(&s_smc_handle_mutex);
+    return ret;
+}
+
+/* ************************************************************************ */
+static int smc_handle_release(smc_priv_t * priv, log_t * log) {
+    int ret = 0;
+
+    pthread_mutex_lock(&s_smc_handle_mutex);
+    if (priv->smc_handle == NULL || priv->smc_handle != s_smc_handle) {
+        ret = sysdep_smc_close(priv->smc_handle, log);
+    } else if (--s_smc_handle_refs == 0) {
+        ret = sysdep_smc_close(s_smc_handle, log);
+        s_smc_handle = NULL;
+    }
+    priv->smc_handle = NULL;
+    pthread_mutex_unlock(&s_smc_handle_mutex);
+    return ret;
+}
+
 /* ************************************************************************ */
 static sensor_status_t smc_family_free(sensor_family_t *family) {
     if (family == NULL ||  family->priv == NULL) {
@@ -139,8 +303,11 @@ static sensor_status_t smc_family_free(sensor_family_t *family) {
         LOG_VERBOSE(family->log, "freeing in-construction internal sensor desc list...");
         slist_free(priv->descs, smc_free_desc);
     }
+    sensor_arena_free(priv->arena);
+    sensor_arena_free(priv->listed_arena);
+    sensor_arena_free(priv->retired_arena);
 
-    if (sysdep_smc_close(priv->smc_handle, family->log) == 0) {
+    if (smc_handle_release(priv, family->log) == 0) {
         result = SENSOR_SUCCESS;
     } else {
        LOG_ERROR(family->log, "SMCClose() failed!");
@@ -150,6 +317,10 @@ static sensor_status_t smc_family_free(sensor_family_t *family) {
     if (priv->smc_buffer != NULL) {
         free(priv->smc_buffer);
     }
+    if (priv->catalog_path != NULL) {
+        free(priv->catalog_path);
+    }
+    smc_batch_free(priv);
     family->priv = NULL;
     free(priv);
 
@@ -173,8 +344,12 @@ static sensor_status_t smc_family_init(sensor_family_t *family) {
     priv->value_offset = 0;
     priv->jobs = NULL;
     priv->descs = NULL;
-    if (sysdep_smc_open(&priv->smc_handle, family->log,
-                        &(priv->output_bufsz), &(priv->value_offset)) != SENSOR_SUCCESS) {
+    priv->arena = NULL;
+    priv->listed_arena = NULL;
+    priv->retired_arena = NULL;
+    priv->catalog_path = NULL;
+    priv->batch_max = 0;
+    if (smc_handle_acquire(priv, family->log) != SENSOR_SUCCESS) {
        LOG_ERROR(family->log, "SMCOpen() failed!");
        smc_family_free(family);
        return SENSOR_ERROR;
@@ -184,6 +359,10 @@ static sensor_status_t smc_family_init(sensor_family_t *family) {
         smc_family_free(family);
         return SENSOR_ERROR;
     }
+    /* with a valid catalog cache, the family is listed without loading job */
+    if (smc_catalog_load(family) == SENSOR_SUCCESS) {
+        family->info = &g_sensor_family_smc_loaded;
+    }
     return SENSOR_SUCCESS;
 }
 
@@ -192,12 +371,15 @@ static void * smc_list_job(void * vdata) {
     sensor_family_t *  family = (sensor_family_t *) vdata;
     sensor_status_t ret;
     int             old_ena, old_asy;
+    SENSOR_TRACE_DECL(trace_ns);
 
     /* disable vjob_kill without vjob_testkill */
     vjob_killmode(0, 0, &old_ena, &old_asy);
 
     /* do it */
+    SENSOR_TRACE_BEGIN(trace_ns, STP_SMC_LIST, family->info->name, 0);
     ret = smc_list(family);
+    SENSOR_TRACE_END(trace_ns, STP_SMC_LIST, family->info->name, 0);
 
     /* restore killmode */
     vjob_killmode(old_ena, old_asy, NULL, NULL);
@@ -228,8 +410,15 @@ static slist_t * smc_family_list(sensor_family_t *family) {
     smc_priv_t *    priv = (smc_priv_t *) family->priv;
     slist_t *       list = priv->descs;
 
-    LOG_DEBUG(family->log, "%s(): list length = %u", __func__, slist_length(list));
+    LOG_DEBUG(family->log, "%s(): list length = %u, arena %zu bytes", __func__,
+              slist_length(list), sensor_arena_size(priv->arena));
 
+    /* descs of the previous listing have been released by libvsensors, the ones
+     * of the last listing are used until libvsensors replaces them */
+    sensor_arena_free(priv->retired_arena);
+    priv->retired_arena = priv->listed_arena;
+    priv->listed_arena = priv->arena;
+    priv->arena = NULL;
     priv->descs = NULL; // we lose ownership of descs list as soon as we give it to libvsensors.
     return list;
 }
@@ -241,14 +430,117 @@ static sensor_status_t smc_family_update(sensor_sample_t *sensor, const struct t
                                &(sensor->value), sensor->desc->family));
 }
 
+/* ************************************************************************ */
+/** decode the keys read by smc_family_update_batch(): 16 bits fixed point keys are
+ * converted together with their plan, others with their format_fun */
+static void smc_decode_batch(sensor_family_t * family, sensor_sample_t ** samples,
+                             unsigned int nb_keys, int ret, sensor_status_t * results) {
+    smc_priv_t *        priv = (smc_priv_t *) family->priv;
+    uint16_t * restrict raw = priv->batch_raw;
+    uint16_t * restrict signs = priv->batch_signs;
+    float * restrict    scales = priv->batch_scales;
+    float * restrict    values = priv->batch_values;
+    const char *        buffer = priv->batch_buffer + priv->value_offset;
+    unsigned int        nb_planned = 0;
+
+    /* 1. check, and gather the planned raw values */
+    for (unsigned int i_key = 0; i_key < nb_keys; ++i_key) {
+        unsigned int        i = priv->batch_samples[i_key];
+        smc_desc_key_t *    key = (smc_desc_key_t *) samples[i]->desc->key;
+        const char *        value_bytes = buffer + (size_t) i_key * priv->output_bufsz;
+
+        if (ret < 0 || priv->batch_sizes[i_key] < 0
+        ||  (unsigned int) priv->batch_sizes[i_key] != key->value_size) {
+            LOG_VERBOSE(family->log, "cannot read SMC key '%08x' (sz:%d,refsz:%u)",
+                        key->value_key, ret < 0 ? ret : priv->batch_sizes[i_key], key->value_size);
+            results[i] = SENSOR_ERROR;
+        } else if (key->plan == SMC_PLAN_NONE) {
+            results[i] = key->format_fun(key->value_type, key->value_size, (char *) value_bytes,
+                                         &(samples[i]->value), family);
+        } else {
+            memcpy(&(raw[nb_planned]), value_bytes, sizeof(*raw));
+            signs[nb_planned] = key->plan == SMC_PLAN_S16 ? 0x8000 : 0;
+            scales[nb_planned] = key->scale;
+            priv->batch_samples[nb_planned++] = i;
+        }
+    }
+    if (nb_planned == 0) {
+        return ;
+    }
+
+    /* 2. byte-swap, sign extension and conversion on contiguous arrays, without branch,
+     * so that the compiler vectorizes it. Results are exact, as int16 * 2^-n in float. */
+    for (unsigned int i_key = 0; i_key < nb_planned; ++i_key) {
+        int32_t u = ntohs(raw[i_key]);
+
+        values[i_key] = (float) (u - ((u & signs[i_key]) << 1)) * scales[i_key];
+    }
+
+    /* 3. scatter to the samples */
+    for (unsigned int i_key = 0; i_key < nb_planned; ++i_key) {
+        unsigned int        i = priv->batch_samples[i_key];
+        sensor_value_t *    value = &(samples[i]->value);
+
+        if (values[i_key] == SENSOR_VALUEP_GET(value, SENSOR_VALUE_FLOAT)) {
+            results[i] = SENSOR_UNCHANGED;
+        } else {
+            SENSOR_VALUEP_GET(value, SENSOR_VALUE_FLOAT) = values[i_key];
+            results[i] = SENSOR_UPDATED;
+        }
+    }
+}
+
+/* ************************************************************************ */
+/** read all due keys back-to-back with their cached key_info, then decode them */
+static sensor_status_t smc_family_update_batch(sensor_family_t * family,
+                                               sensor_sample_t ** samples, unsigned int n,
+                                               const struct timeval * now,
+                                               sensor_status_t * results) {
+    smc_priv_t *    priv = (smc_priv_t *) family->priv;
+    unsigned int    nb_keys = 0;
+    int             ret;
+
+    if (smc_batch_reserve(priv, n) != SENSOR_SUCCESS) {
+        LOG_VERBOSE(family->log, "cannot allocate smc batch of %u keys, reading one by one", n);
+        for (unsigned int i = 0; i < n; ++i) {
+            results[i] = smc_family_update(samples[i], now);
+        }
+        return SENSOR_SUCCESS;
+    }
+
+    for (unsigned int i = 0; i < n; ++i) {
+        smc_desc_key_t * key = (smc_desc_key_t *) samples[i]->desc->key;
+
+        if ((key->flags & SMC_KEY_UNCHECKED) != 0) {
+            /* the type of keys from the catalog cache must be checked on first read */
+            results[i] = smc_getsensorvalue(key, &(samples[i]->value), family);
+            continue ;
+        }
+        priv->batch_keys[nb_keys] = key->value_key;
+        priv->batch_infos[nb_keys] = &(key->key_info);
+        priv->batch_samples[nb_keys] = i;
+        ++nb_keys;
+    }
+    if (nb_keys == 0) {
+        return SENSOR_SUCCESS;
+    }
+
+    ret = sysdep_smc_readkeys(nb_keys, priv->batch_keys, priv->batch_infos, priv->batch_buffer,
+                              priv->batch_sizes, priv->smc_handle, family->log);
+    /* one SMC call per key, even in a batch */
+    sensor_family_stats_reads(family, nb_keys);
+
+    smc_decode_batch(family, samples, nb_keys, ret, results);
+
+    return SENSOR_SUCCESS;
+}
+
 /* ************************************************************************ */
 static sensor_status_t smc_family_write(const sensor_desc_t * sensordesc, const sensor_value_t * value) {
     return smc_putsensorvalue((smc_desc_key_t *) sensordesc->key, value, sensordesc->family);
 }
 
 /* ************************************************************************ */
-extern const sensor_family_info_t g_sensor_family_smc_loaded;
-
 static sensor_status_t smc_family_loading_update(sensor_sample_t *sensor, const struct timeval * now) {
     smc_priv_t * priv = (smc_priv_t *) sensor->desc->family->priv;
     (void)now;
@@ -304,7 +596,9 @@ const sensor_family_info_t g_sensor_family_smc_loaded = {
     .list = smc_family_list,
     .notify = NULL,
     .write = smc_family_write,
-    .free_desc = smc_free_desc
+    .free_desc = smc_free_desc,
+    .flags = SFF_PRECISE_UPDATE,
+    .update_batch = smc_family_update_batch
 };
 
 /* ************************************************************************************* */
@@ -572,6 +866,56 @@ static const smc_sensor_info_t s_smc_known_sensors[] = {
     { 0, NULL, NULL },
 };
 
+/** keys of s_smc_known_sensors converted once and sorted, for smc_known_sensor() */
+typedef struct {
+    uint32_t                    key;
+    unsigned int                index;
+} smc_known_key_t;
+
+#define SMC_KNOWN_SENSORS_NB    (sizeof(s_smc_known_sensors) / sizeof(*s_smc_known_sensors))
+static smc_known_key_t          s_smc_known_keys[SMC_KNOWN_SENSORS_NB];
+static unsigned int             s_smc_known_nb = 0;
+static pthread_once_t           s_smc_known_once = PTHREAD_ONCE_INIT;
+
+static int smc_known_key_cmp(const void * va, const void * vb) {
+    const smc_known_key_t * a = (const smc_known_key_t *) va;
+    const smc_known_key_t * b = (const smc_known_key_t *) vb;
+
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    /* the first entry of a duplicated key wins, as with a linear search */
+    return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+static void smc_known_keys_init(void) {
+    for (unsigned int i = 0; i < SMC_KNOWN_SENSORS_NB; ++i) {
+        if (s_smc_known_sensors[i].label != NULL && s_smc_known_sensors[i].key != NULL) {
+            s_smc_known_keys[s_smc_known_nb].key = SMC_TYPE(s_smc_known_sensors[i].key);
+            s_smc_known_keys[s_smc_known_nb++].index = i;
+        }
+    }
+    qsort(s_smc_known_keys, s_smc_known_nb, sizeof(*s_smc_known_keys), smc_known_key_cmp);
+}
+
+/** get the s_smc_known_sensors entry of key with a binary search, or NULL */
+static const smc_sensor_info_t * smc_known_sensor(uint32_t key) {
+    unsigned int lo = 0, hi;
+
+    pthread_once(&s_smc_known_once, smc_known_keys_init);
+    /* lower bound of key */
+    for (hi = s_smc_known_nb; lo < hi; ) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if (s_smc_known_keys[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < s_smc_known_nb && s_smc_known_keys[lo].key == key)
+        return &(s_smc_known_sensors[s_smc_known_keys[lo].index]);
+    return NULL;
+}
+
 /* ************************************************************************ */
 unsigned long _str32toul(const char * int32, unsigned int size, int base) {
     unsigned long   total = 0;
@@ -838,6 +1182,39 @@ static sensor_status_t smc_write_bytes(uint32_t type, uint32_t size, char * byte
 //TODO
 SENSOR_VALUE_INIT_BUF(*value, SENSOR_VALUE_STRING, value_bytes, value_size);*/
 
+/** set the decode plan of 16 bits fixed point keys, decoded as format_fun would do:
+ * 'fp' and 'sp' types have their number of fraction bits in the last character */
+static void smc_decode_plan(smc_desc_key_t * key, uint32_t value_type, uint32_t value_size,
+                            sensor_value_type_t type) {
+    unsigned int    frac = value_type & 0xff;
+    unsigned int    prefix = value_type >> 16;
+
+    key->plan = SMC_PLAN_NONE;
+    key->scale = 1.0f;
+    if (value_size != 2 || type != SENSOR_VALUE_FLOAT) {
+        return ;
+    }
+    if (value_type == DATATYPE_PWM) {
+        key->plan = SMC_PLAN_U16;
+        key->scale = 100 / 65536.0f;
+        return ;
+    }
+    if (frac >= '0' && frac <= '9')
+        frac -= '0';
+    else if (frac >= 'a' && frac <= 'f')
+        frac -= 'a' - 10;
+    else
+        return ;
+
+    if (prefix == (('f' << 8) | 'p'))
+        key->plan = SMC_PLAN_U16;
+    else if (prefix == (('s' << 8) | 'p'))
+        key->plan = SMC_PLAN_S16;
+    else
+        return ;
+    key->scale = 1.0f / (1 << frac);
+}
+
 static sensor_status_t smc_getformatfun(smc_desc_key_t * key, uint32_t value_type, uint32_t value_size,
                                         sensor_value_t * value, sensor_family_t * family) {
     (void)family;
@@ -992,6 +1369,7 @@ static sensor_status_t smc_getformatfun(smc_desc_key_t * key, uint32_t value_typ
         key->format_fun = smc_format_bytes;
         key->write_fun = smc_write_bytes;
     }
+    smc_decode_plan(key, value_type, value_size, value->type);
     return SENSOR_SUCCESS;
 }
 
@@ -1035,11 +1413,26 @@ static sensor_status_t smc_getsensorvalue(
 {
     smc_priv_t *    priv = (smc_priv_t *) family->priv;
     unsigned int    value_size;
+    uint32_t        value_type = key->value_type;
     char *          value_bytes = priv->smc_buffer + priv->value_offset;
 
-    value_size = sysdep_smc_readkey(key->value_key, NULL, &(key->key_info),
+    sensor_family_stats_reads(family, 1);
+    value_size = sysdep_smc_readkey(key->value_key,
+                                    (key->flags & SMC_KEY_UNCHECKED) != 0 ? &value_type : NULL,
+                                    &(key->key_info),
                                     priv->smc_buffer, priv->smc_handle, family->log);
 
+    if ((key->flags & SMC_KEY_UNCHECKED) != 0 && value_size == key->value_size) {
+        if (value_type != key->value_type) {
+            /* the cached catalog does not match this SMC anymore */
+            LOG_WARN(family->log, "SMC key '%08x' does not match catalog cache, removing '%s'",
+                     key->value_key, priv->catalog_path);
+            if (priv->catalog_path != NULL)
+                unlink(priv->catalog_path);
+            return SENSOR_ERROR;
+        }
+        key->flags &= ~SMC_KEY_UNCHECKED;
+    }
     if (value_size != key->value_size) {
         LOG_VERBOSE(family->log, "cannot read SMC key '%08x' (bytes:%lx,key_info:%lx,sz:%u,refsz:%u",
                  key->value_key, (unsigned long) value_bytes, (unsigned long)key->key_info,
@@ -1082,23 +1475,20 @@ static sensor_status_t  smc_putsensorvalue(
 }
 
 /* ************************************************************************ */
+/** desc, key, properties and label are in the family arena, only the
+ * sysdep key_info is released here. */
 static void smc_free_desc(void * data) {
     if (data != NULL) {
         sensor_desc_t * desc = data;
 
-        if (desc->label != NULL) {
-            free((void*) (desc->label));
-        }
         if (desc->key != NULL) {
             smc_desc_key_t * key = (smc_desc_key_t *) desc->key;
             desc->key = NULL;
             if (key->key_info != NULL) {
                 free(key->key_info);
+                key->key_info = NULL;
             }
-            free(key);
         }
-        sensor_properties_free(desc->properties);
-        free(desc);
     }
 }
 
@@ -1110,19 +1500,146 @@ enum {
     SMC_PROP_INDEX,
     SMC_PROP_NB /* must be last */
 };
+#define SMC_PROP_BUFSZ  16
 
 /* ************************************************************************ */
-static sensor_status_t smc_list(sensor_family_t * family) {
+/** create a smc sensor desc in the family arena, taking ownership of key_info.
+ * label is the cached label or NULL to use the known or default one. */
+static sensor_desc_t * smc_desc_create(
+                            sensor_family_t *   family,
+                            uint32_t            value_key,
+                            uint32_t            value_type,
+                            uint32_t            value_size,
+                            uint32_t            index,
+                            void *              key_info,
+                            const char *        cached_label) {
+    smc_priv_t *    priv = (smc_priv_t *) family->priv;
+    sensor_desc_t * desc;
+    smc_desc_key_t* key;
+    sensor_value_t  value;
+    char *          label = NULL;
+    const smc_sensor_info_t * known;
+    char *          bufs;
+
+    if (priv->arena == NULL && (priv->arena = sensor_arena_create(0)) == NULL) {
+        LOG_WARN(family->log, "cannot create smc arena: %s", strerror(errno));
+        if (key_info != NULL)
+            free(key_info);
+        return NULL;
+    }
+
+    /* alloc sensor_desc_t and smc_desc_key_t */
+    if ((desc = sensor_arena_alloc(priv->arena, sizeof(*desc))) == NULL
+    ||  (key = desc->key = sensor_arena_alloc(priv->arena, sizeof(smc_desc_key_t))) == NULL) {
+        LOG_WARN(family->log, "cannot allocate smc sensor desc for #%u", index);
+        if (key_info != NULL)
+            free(key_info);
+        return NULL;
+    }
+    desc->type = SENSOR_VALUE_NULL;
+    desc->label = NULL;
+    desc->family = family;
+    key->key_info = key_info;
+    key->format_fun = NULL;
+    key->write_fun = NULL;
+    key->value_key = value_key;
+    key->value_type = value_type;
+    key->value_index = index;
+    key->value_size = value_size;
+    key->flags = SMC_KEY_NONE;
+
+    /* alloc sensor_property_t */
+    if ((desc->properties = sensor_arena_properties(priv->arena, SMC_PROP_NB)) == NULL) {
+        LOG_WARN(family->log, "cannot allocate smc properties for key #%u'", index);
+        smc_free_desc(desc);
+        return NULL;
+    }
+
+    /* init sensor value and its formating function */
+    memset(&value, 0, sizeof(value));
+    value.data.b.buf = NULL;
+    if (smc_getformatfun(key, value_type, value_size, &value, family) != SENSOR_SUCCESS
+    ||  key->format_fun == NULL) {
+        LOG_WARN(family->log, "cannot decode SMC key '%08x', skipping...", value_key);
+        smc_free_desc(desc);
+        return NULL;
+    }
+    desc->type = value.type;
+
+    /* get known human readable sensor label if exisiting */
+    if (cached_label != NULL) {
+        label = sensor_arena_strdup(priv->arena, cached_label);
+    } else if ((known = smc_known_sensor(value_key)) != NULL) {
+        size_t len = strlen(known->label) + 1 /*0*/ + 7 /*' {abcd}'*/;
+        if ((label = sensor_arena_alloc(priv->arena, len * sizeof(char))) != NULL) {
+            snprintf(label, len, "%s {%s}", known->label, known->key);
+        }
+    }
+
+    /* attribute a default label if not known */
+    if (label == NULL) {
+        if ((label = sensor_arena_alloc(priv->arena, (sizeof(value_key) + 3) * sizeof(char))) == NULL) {
+            LOG_WARN(family->log, "cannot allocate smc sensor label for '%08x'", value_key);
+            smc_free_desc(desc);
+            return NULL;
+        }
+        _ultostr32(label + 1, sizeof(value_key) + 1, value_key, sizeof(value_key));
+        *(label) = '{';
+        label[sizeof(value_key) + 1] = '}';
+        label[sizeof(value_key) + 2] = 0;
+    }
+    desc->label = label;
+
+    /* set sensor_properties: names are static, buffers in arena */
+    if ((bufs = sensor_arena_alloc(priv->arena, 2 * SMC_PROP_BUFSZ)) == NULL) {
+        LOG_WARN(family->log, "cannot allocate smc properties for key #%u'", index);
+        smc_free_desc(desc);
+        return NULL;
+    }
+    desc->properties[SMC_PROP_TYPE].name = "smc-type";
+    SENSOR_VALUE_INIT_BUF(desc->properties[SMC_PROP_TYPE].value, SENSOR_VALUE_STRING,
+                          bufs, SMC_PROP_BUFSZ);
+    _ultostr32(bufs, sizeof(value_type) + 1, value_type, sizeof(value_type));
+    desc->properties[SMC_PROP_TYPE].value.data.b.size = sizeof(value_type);
+    desc->properties[SMC_PROP_SIZE].name = "smc-size";
+    SENSOR_VALUE_INIT(desc->properties[SMC_PROP_SIZE].value, SENSOR_VALUE_UINT16, value_size);
+    desc->properties[SMC_PROP_KEY].name = "smc-key";
+    SENSOR_VALUE_INIT_BUF(desc->properties[SMC_PROP_KEY].value, SENSOR_VALUE_STRING,
+                          bufs + SMC_PROP_BUFSZ, SMC_PROP_BUFSZ);
+    _ultostr32(bufs + SMC_PROP_BUFSZ, sizeof(value_key) + 1, value_key, sizeof(value_key));
+    desc->properties[SMC_PROP_KEY].value.data.b.size = sizeof(value_key);
+    desc->properties[SMC_PROP_INDEX].name = "smc-index";
+    SENSOR_VALUE_INIT(desc->properties[SMC_PROP_INDEX].value, SENSOR_VALUE_UINT32, index);
+
+    return desc;
+}
+
+/* ************************************************************************ */
+static int smc_get_total_keys(sensor_family_t * family) {
+    sensor_value_t  value;
     sensor_status_t ret;
+
+    memset(&value, 0, sizeof(value));
+    ret = smc_getvalue(SMC_TYPE("#KEY"), &value, family);
+
+    if (ret != SENSOR_SUCCESS && ret != SENSOR_UPDATED
+    &&  ret != SENSOR_UNCHANGED && ret != SENSOR_WAIT_TIMER) {
+        return -1;
+    }
+    return sensor_value_toint(&value);
+}
+
+/* ************************************************************************ */
+static void smc_catalog_save(sensor_family_t * family, int total_keys);
+
+static sensor_status_t smc_list(sensor_family_t * family) {
     smc_priv_t *    priv = (smc_priv_t *) family->priv;
     slist_t *       last, * new;
     int             value_size;
     uint32_t        value_type;
     uint32_t        value_key;
-    sensor_value_t  value;
     int             total_keys, i;
     sensor_desc_t * desc;
-    smc_desc_key_t* key;
 
     /* don't rebuild list */
     if (priv->descs != NULL) {
@@ -1130,118 +1647,36 @@ static sensor_status_t smc_list(sensor_family_t * family) {
     }
 
     /* Get Number of SMC Keys */
-    memset(&value, 0, sizeof(value));
-    ret = smc_getvalue(SMC_TYPE("#KEY"), &value, family);
-
-    if (ret != SENSOR_SUCCESS && ret != SENSOR_UPDATED
-    &&  ret != SENSOR_UNCHANGED && ret != SENSOR_WAIT_TIMER) {
+    if ((total_keys = smc_get_total_keys(family)) < 0) {
         LOG_WARN(family->log, "warning: cannot get number of smc keys");
         return SENSOR_ERROR;
     }
-    total_keys = sensor_value_toint(&value);
     LOG_VERBOSE(family->log, "%s(): nb_keys = %d", __func__, total_keys);
 
     /* Scan each Key */
     last = NULL;
     for (i = 0; i < total_keys; i++) {
-        char * label = NULL;
+        void * key_info = NULL;
 
         /* cancelation point */
         vjob_testkill();
 
-        /* alloc sensor_desc_t */
-        if ((desc = malloc(sizeof(*desc))) == NULL) {
-            LOG_WARN(family->log, "cannot allocate smc sensor desc for #%u", i);
-            continue ;
-        }
-        desc->type = SENSOR_VALUE_NULL;
-        desc->label = NULL;
-        desc->family = family;
-
-        /* alloc sensor_property_t */
-        if ((desc->properties = sensor_properties_create(SMC_PROP_NB)) == NULL) {
-            LOG_WARN(family->log, "cannot allocate smc properties for key #%u'", i);
-            smc_free_desc(desc);
-            continue ;
-        }
-
-        /* alloc smc_desc_key_t */
-        if ((key = desc->key = malloc(sizeof(smc_desc_key_t))) == NULL) {
-            LOG_WARN(family->log, "cannot allocate smc cache for key #%u'", i);
-            smc_free_desc(desc);
-            continue ;
-        }
-        key->key_info = NULL;
-        key->format_fun = NULL;
-        key->write_fun = NULL;
-
         /* ask key info to smc driver */
         value_size = sysdep_smc_readindex(i, &value_key, &value_type,
-                        &(key->key_info), priv->smc_buffer, priv->smc_handle, family->log);
+                        &key_info, priv->smc_buffer, priv->smc_handle, family->log);
 
         if (value_size < 0) {
             if (value_size != SENSOR_NOT_SUPPORTED)
                 LOG_WARN(family->log, "cannot get smc key info for #%u", i);
-            smc_free_desc(desc);
+            if (key_info != NULL)
+                free(key_info);
             continue ;
         }
-        key->value_key = value_key;
-        key->value_type = value_type;
-        key->value_index = i;
-        key->value_size = value_size;
-
-        /* get known human readable sensor label if exisiting */
-        for (unsigned int i_desc = 0; i_desc < sizeof(s_smc_known_sensors)
-                                               / sizeof(*s_smc_known_sensors); ++i_desc) {
-            if (s_smc_known_sensors[i_desc].label != NULL) {
-                if (value_key == SMC_TYPE(s_smc_known_sensors[i_desc].key)) {
-                    size_t len = strlen(s_smc_known_sensors[i_desc].label) + 1 /*0*/ + 7 /*' {abcd}'*/;
-                    if ((label = malloc(len * sizeof(char))) != NULL) {
-                        snprintf(label, len, "%s {%s}",
-                                 s_smc_known_sensors[i_desc].label, s_smc_known_sensors[i_desc].key);
-                    }
-                    break ;
-                }
-            }
-        }
 
-        /* init sensor value and its formating function */
-        value.data.b.buf = NULL;
-        if (smc_getformatfun(key, value_type, value_size, &value, family) != SENSOR_SUCCESS
-        ||  key->format_fun == NULL) {
-            LOG_WARN(family->log, "cannot decode SMC key '%08x', skipping...", value_key);
-            smc_free_desc(desc);
+        if ((desc = smc_desc_create(family, value_key, value_type, value_size,
+                                    i, key_info, NULL)) == NULL) {
             continue ;
         }
-        desc->type = value.type;
-
-        /* attribute a default label if not known */
-        if (label == NULL) {
-            if ((label = malloc((sizeof(value_key) + 3) * sizeof(char))) == NULL) {
-                LOG_WARN(family->log, "cannot allocate smc sensor label for '%08x'", value_key);
-                smc_free_desc(desc);
-                continue ;
-            }
-            _ultostr32(label + 1, sizeof(value_key) + 1, value_key, sizeof(value_key));
-            *(label) = '{';
-            label[sizeof(value_key) + 1] = '}';
-            label[sizeof(value_key) + 2] = 0;
-        }
-        desc->label = label;
-
-        /* set sensor_properties */
-        sensor_property_init(&(desc->properties[SMC_PROP_TYPE]), "smc-type");
-        SENSOR_VALUE_INIT_BUF(desc->properties[SMC_PROP_TYPE].value, SENSOR_VALUE_STRING, NULL, 16);
-        _ultostr32(desc->properties[SMC_PROP_TYPE].value.data.b.buf,
-                   sizeof(value_type) + 1, value_type, sizeof(value_type));
-        sensor_property_init(&(desc->properties[SMC_PROP_SIZE]), "smc-size");
-        SENSOR_VALUE_INIT(desc->properties[SMC_PROP_SIZE].value, SENSOR_VALUE_UINT16, value_size);
-        sensor_property_init(&(desc->properties[SMC_PROP_KEY]), "smc-key");
-        SENSOR_VALUE_INIT_BUF(desc->properties[SMC_PROP_KEY].value, SENSOR_VALUE_STRING, NULL, 16);
-        _ultostr32(desc->properties[SMC_PROP_KEY].value.data.b.buf,
-                   sizeof(value_key) + 1, value_key, sizeof(value_key));
-        sensor_property_init(&(desc->properties[SMC_PROP_INDEX]), "smc-index");
-        SENSOR_VALUE_INIT(desc->properties[SMC_PROP_INDEX].value, SENSOR_VALUE_UINT32, i);
 
         /* finally add desc to list */
         if ((new = slist_prepend(NULL, desc)) == NULL) {
@@ -1256,7 +1691,242 @@ static sensor_status_t smc_list(sensor_family_t * family) {
         }
         last = new;
     }
+    smc_catalog_save(family, total_keys);
+
     LOG_INFO(family->log, "sensors loaded");
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+/* SMC CATALOG CACHE
+ * Enumerating every SMC key at startup is slow (one or more driver calls per
+ * key), whereas the catalog almost never changes on a given machine.
+ * The result of smc_list() is saved in a native-endian file, reloaded at
+ * smc_family_init() if the #KEY count and the machine fingerprint match.
+ * Each cached key is checked against the SMC on its first read, and the
+ * cache is removed on mismatch. */
+/* ************************************************************************ */
+#define SMC_CATALOG_MAGIC       "VSMC"
+#define SMC_CATALOG_VERSION     1
+#define SMC_CATALOG_BYTEORDER   0x01020304U
+
+typedef struct {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    byteorder;
+    uint32_t    total_keys;
+    uint32_t    fingerprint;
+    uint32_t    n_keys;
+    uint32_t    labels_size;
+    uint32_t    reserved;
+} smc_catalog_header_t;
+
+typedef struct {
+    uint32_t    key;
+    uint32_t    type;
+    uint32_t    size;
+    uint32_t    index;
+    uint32_t    sv_type;        /* decoded value type, to detect format changes */
+    uint32_t    label_offset;
+} smc_catalog_entry_t;
+
+/* ************************************************************************ */
+static const char * smc_catalog_path(sensor_family_t * family) {
+    smc_priv_t *    priv = (smc_priv_t *) family->priv;
+    const char *    path;
+    const char *    dir;
+    const char *    sub = "";
+    size_t          len;
+
+    if (priv->catalog_path != NULL) {
+        return *priv->catalog_path == 0 ? NULL : priv->catalog_path;
+    }
+    if ((path = getenv(SMC_CATALOG_ENV)) != NULL) {
+        priv->catalog_path = strdup(path);
+    } else {
+        /* not in a shared directory: other users could create or replace it */
+        if ((dir = getenv("XDG_CACHE_HOME")) == NULL || *dir != '/') {
+            dir = getenv("HOME");
+            sub = "/.cache";
+        }
+        if (dir == NULL || *dir != '/') {
+            priv->catalog_path = strdup("");
+        } else {
+            len = strlen(dir) + strlen(sub) + sizeof(SMC_CATALOG_NAME) + 1;
+            if ((priv->catalog_path = malloc(len)) != NULL) {
+                snprintf(priv->catalog_path, len, "%s%s", dir, sub);
+                mkdir(priv->catalog_path, 0700);
+                snprintf(priv->catalog_path, len, "%s%s/" SMC_CATALOG_NAME, dir, sub);
+            }
+        }
+    }
+    if (priv->catalog_path == NULL || *priv->catalog_path == 0) {
+        return NULL;
+    }
+    return priv->catalog_path;
+}
+
+/* ************************************************************************ */
+static void smc_catalog_save(sensor_family_t * family, int total_keys) {
+    smc_priv_t *            priv = (smc_priv_t *) family->priv;
+    smc_catalog_header_t    header;
+    smc_catalog_entry_t     entry;
+    const char *            path;
+    char                    tmp_path[PATH_MAX];
+    FILE *                  f;
+    int                     ok, fd;
+
+    if ((path = smc_catalog_path(family)) == NULL) {
+        return ;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SMC_CATALOG_MAGIC, sizeof(header.magic));
+    header.version = SMC_CATALOG_VERSION;
+    header.byteorder = SMC_CATALOG_BYTEORDER;
+    header.total_keys = total_keys;
+    if (sysdep_smc_fingerprint(&header.fingerprint, priv->smc_handle, family->log)
+            != SENSOR_SUCCESS) {
+        LOG_VERBOSE(family->log, "no smc fingerprint, catalog cache not saved");
+        return ;
+    }
+    SLIST_FOREACH_DATA(priv->descs, desc, sensor_desc_t *) {
+        ++header.n_keys;
+        header.labels_size += strlen(desc->label) + 1;
+    }
+
+    /* mkstemp() creates a new file (O_EXCL), not following links, mode 0600 */
+    if ((size_t) snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) >= sizeof(tmp_path)
+    ||  (fd = mkstemp(tmp_path)) < 0) {
+        LOG_VERBOSE(family->log, "cannot create smc catalog '%s': %s", path, strerror(errno));
+        return ;
+    }
+    if ((f = fdopen(fd, "w")) == NULL) {
+        LOG_VERBOSE(family->log, "cannot create smc catalog '%s': %s", tmp_path, strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return ;
+    }
+    ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+    header.labels_size = 0;
+    SLIST_FOREACH_DATA(priv->descs, entry_desc, sensor_desc_t *) {
+        smc_desc_key_t * key = (smc_desc_key_t *) entry_desc->key;
+
+        if (!ok)
+            break ;
+        memset(&entry, 0, sizeof(entry));
+        entry.key = key->value_key;
+        entry.type = key->value_type;
+        entry.size = key->value_size;
+        entry.index = key->value_index;
+        entry.sv_type = entry_desc->type;
+        entry.label_offset = header.labels_size;
+        header.labels_size += strlen(entry_desc->label) + 1;
+        ok = (fwrite(&entry, sizeof(entry), 1, f) == 1);
+    }
+    SLIST_FOREACH_DATA(priv->descs, label_desc, sensor_desc_t *) {
+        if (!ok)
+            break ;
+        ok = (fwrite(label_desc->label, strlen(label_desc->label) + 1, 1, f) == 1);
+    }
+    if (fclose(f) != 0)
+        ok = 0;
+    if (!ok || rename(tmp_path, path) != 0) {
+        LOG_VERBOSE(family->log, "cannot write smc catalog '%s': %s", path, strerror(errno));
+        unlink(tmp_path);
+        return ;
+    }
+    LOG_VERBOSE(family->log, "smc catalog saved to '%s' (%u keys)", path, header.n_keys);
+}
+
+/* ************************************************************************ */
+static sensor_status_t smc_catalog_load(sensor_family_t * family) {
+    smc_priv_t *            priv = (smc_priv_t *) family->priv;
+    smc_catalog_header_t    header;
+    smc_catalog_entry_t *   entries = NULL;
+    char *                  labels = NULL;
+    const char *            path;
+    slist_t *               descs = NULL, * last = NULL, * new;
+    uint32_t                fingerprint, i;
+    int                     total_keys, fd;
+    struct stat             st;
+    FILE *                  f;
+
+    if ((path = smc_catalog_path(family)) == NULL || (fd = open(path, O_RDONLY)) < 0) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+    /* the catalog is trusted only if nobody else could have written it */
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != getuid()
+    ||  (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        LOG_WARN(family->log, "smc catalog '%s' ignored: not a private file of user", path);
+        close(fd);
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if ((f = fdopen(fd, "r")) == NULL) {
+        close(fd);
+        return SENSOR_NOT_SUPPORTED;
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1
+    ||  memcmp(header.magic, SMC_CATALOG_MAGIC, sizeof(header.magic)) != 0
+    ||  header.version != SMC_CATALOG_VERSION
+    ||  header.byteorder != SMC_CATALOG_BYTEORDER
+    ||  header.n_keys > header.total_keys || header.labels_size == 0
+    ||  (total_keys = smc_get_total_keys(family)) < 0
+    ||  header.total_keys != (uint32_t) total_keys
+    ||  sysdep_smc_fingerprint(&fingerprint, priv->smc_handle, family->log) != SENSOR_SUCCESS
+    ||  header.fingerprint != fingerprint
+    ||  (entries = malloc(header.n_keys * sizeof(*entries) + 1)) == NULL
+    ||  (labels = malloc(header.labels_size)) == NULL
+    ||  fread(entries, sizeof(*entries), header.n_keys, f) != header.n_keys
+    ||  fread(labels, header.labels_size, 1, f) != 1
+    ||  labels[header.labels_size - 1] != 0) {
+        LOG_VERBOSE(family->log, "smc catalog '%s' is outdated or invalid", path);
+        fclose(f);
+        if (entries != NULL)
+            free(entries);
+        if (labels != NULL)
+            free(labels);
+        return SENSOR_ERROR;
+    }
+    fclose(f);
+
+    for (i = 0; i < header.n_keys; ++i) {
+        smc_catalog_entry_t *   entry = &entries[i];
+        sensor_desc_t *         desc;
+        void *                  key_info = NULL;
+
+        if (entry->label_offset >= header.labels_size
+        ||  sysdep_smc_keyinfo(entry->key, entry->index, &key_info,
+                               priv->smc_handle, family->log) != SENSOR_SUCCESS
+        ||  (desc = smc_desc_create(family, entry->key, entry->type, entry->size, entry->index,
+                                    key_info, labels + entry->label_offset)) == NULL) {
+            break ;
+        }
+        if (desc->type != entry->sv_type || (new = slist_prepend(NULL, desc)) == NULL) {
+            smc_free_desc(desc);
+            break ;
+        }
+        ((smc_desc_key_t *) desc->key)->flags |= SMC_KEY_UNCHECKED;
+        if (descs == NULL) {
+            descs = new;
+        } else {
+            last->next = new;
+        }
+        last = new;
+    }
+    free(entries);
+    free(labels);
+
+    if (i < header.n_keys) {
+        LOG_VERBOSE(family->log, "smc catalog '%s' does not match, ignored", path);
+        slist_free(descs, smc_free_desc);
+        sensor_arena_free(priv->arena);
+        priv->arena = NULL;
+        return SENSOR_ERROR;
+    }
+    priv->descs = descs;
+    LOG_INFO(family->log, "sensors loaded from catalog '%s' (%u keys)", path, header.n_keys);
+
+    return SENSOR_SUCCESS;
+}
+
+
@@ -41,5 +41,18 @@ unsigned int        _ultostr32(char * str32, unsigned int maxsize,
 }
 #endif
 
+/** FNV-1a hash of data, starting with hash (0 for a new hash), for smc fingerprints */
+static inline uint32_t _smc_hash(uint32_t hash, const void * data, size_t size) {
+    const unsigned char * bytes = (const unsigned char *) data;
+
+    if (hash == 0)
+        hash = 2166136261U;
+    while (size-- > 0) {
+        hash ^= *(bytes++);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
 #endif // !ifdef SENSOR_SMC_PRIVATE_H
 
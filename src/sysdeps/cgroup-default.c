@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * cgroup default implementation for Generic Sensor Management Library.
+ */
+#include <stdlib.h>
+#include <errno.h>
+
+#include "libvsensors/sensor.h"
+
+#include "cgroup_private.h"
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_support(sensor_family_t * family, const char * label) {
+    (void)family;
+    (void)label;
+    return SENSOR_NOT_SUPPORTED;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_init(sensor_family_t * family) {
+    (void)family;
+    return SENSOR_ERROR;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_destroy(sensor_family_t * family) {
+    (void)family;
+    return SENSOR_ERROR;
+}
+
+/* ************************************************************************ */
+void sysdep_cgroup_info_free(cgroupinfo_t * info) {
+    (void)info;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_has_file(sensor_family_t * family, cgroupinfo_t * info,
+                                       cgroup_file_t file) {
+    (void)family;
+    (void)info;
+    (void)file;
+    return SENSOR_NOT_SUPPORTED;
+}
+
+/* ************************************************************************ */
+ssize_t sysdep_cgroup_read(sensor_family_t * family, cgroupinfo_t * info,
+                           cgroup_file_t file, char * buf, size_t size) {
+    (void)family;
+    (void)info;
+    (void)file;
+    (void)buf;
+    (void)size;
+    errno = ENOSYS;
+    return -1;
+}
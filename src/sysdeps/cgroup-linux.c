@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * cgroup v2 linux implementation for Generic Sensor Management Library.
+ * cgroups are discovered with inotify on the common thread: only directories
+ * which can lead to cgroups matched by filters are watched.
+ */
+#include <sys/inotify.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "libvsensors/sensor.h"
+#include "vlib/util.h"
+
+#include "cgroup_private.h"
+#include "common_private.h"
+#include "sensor_private.h"
+
+/* ************************************************************************ */
+#ifndef CGROUP_ROOT_DIR
+#define CGROUP_ROOT_DIR         "/sys/fs/cgroup"
+#endif
+/** file of the cgroup v2 root, not in the v1 hierarchies */
+#define CGROUP_CONTROLLERS_FILE "cgroup.controllers"
+/** events of a watched directory telling that a cgroup was created or removed */
+#define CGROUP_LINUX_IN_MASK    (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+static const char * s_cgroup_files[CGROUP_FILE_NB] = {
+    "cpu.stat", "memory.current", "memory.stat", "io.stat", "cpu.pressure", "memory.pressure"
+};
+
+/** a watched directory */
+typedef struct {
+    int             wd;
+    unsigned int    depth;  /* number of components of path */
+    char            path[]; /* relative to the root, "" for the root */
+} cgroup_watch_t;
+
+typedef struct {
+    char *          root;
+    int             root_fd;
+    int             notify_ifd;
+    int             registered;
+    slist_t *       watches; /* of cgroup_watch_t * */
+} sysdep_t;
+
+typedef struct {
+    int             fds[CGROUP_FILE_NB];
+} sys_cgroupinfo_t;
+
+/* ************************************************************************ */
+static int cgroup_linux_thread_event_read(
+                vthread_t *             vthread,
+                vthread_event_t         event,
+                void *                  event_data,
+                void *                  callback_user_data);
+
+/* ************************************************************************ */
+/** watch a directory, under priv->mutex */
+static void cgroup_linux_watch_add(sensor_family_t * family, const char * path, unsigned int depth) {
+    cgroup_priv_t *     priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    char                dir[PATH_MAX];
+    cgroup_watch_t *    watch;
+    size_t              len = strlen(path);
+    int                 wd;
+
+    snprintf(dir, sizeof(dir), "%s%s%s", sysdep->root, *path ? "/" : "", path);
+    if ((wd = inotify_add_watch(sysdep->notify_ifd, dir, CGROUP_LINUX_IN_MASK)) < 0) {
+        LOG_WARN(family->log, "inotify_add_watch(%s): %s", dir, strerror(errno));
+        return ;
+    }
+    SLIST_FOREACH_DATA(sysdep->watches, known, cgroup_watch_t *) {
+        if (known->wd == wd)
+            return ;
+    }
+    if ((watch = malloc(sizeof(*watch) + len + 1)) == NULL) {
+        inotify_rm_watch(sysdep->notify_ifd, wd);
+        return ;
+    }
+    watch->wd = wd;
+    watch->depth = depth;
+    memcpy(watch->path, path, len + 1);
+    sysdep->watches = slist_prepend(sysdep->watches, watch);
+}
+
+/* ************************************************************************ */
+/** give the sub-cgroups of path to the family, and watch the directories which can
+ * lead to matched cgroups, under priv->mutex */
+static void cgroup_linux_scan(sensor_family_t * family, const char * path, unsigned int depth) {
+    cgroup_priv_t *     priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    struct dirent *     entry;
+    DIR *               dir;
+    int                 fd;
+
+    if ((fd = openat(sysdep->root_fd, *path ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+        return ;
+    }
+    if ((dir = fdopendir(fd)) == NULL) {
+        close(fd);
+        return ;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        char            child[PATH_MAX];
+        struct stat     st;
+
+        if (entry->d_name[0] == '.'
+        ||  (entry->d_type != DT_DIR
+             && (entry->d_type != DT_UNKNOWN
+                 || fstatat(dirfd(dir), entry->d_name, &st, 0) != 0 || !S_ISDIR(st.st_mode)))) {
+            continue ;
+        }
+        if (snprintf(child, sizeof(child), "%s%s%s", path, *path ? "/" : "", entry->d_name)
+                >= (int) sizeof(child)) {
+            continue ;
+        }
+        cgroup_found(family, child, depth + 1);
+        if (depth + 1 < priv->max_depth && cgroup_filter_match(priv, child, depth + 1, 1)) {
+            /* watched before it is scanned: no creation is missed */
+            cgroup_linux_watch_add(family, child, depth + 1);
+            cgroup_linux_scan(family, child, depth + 1);
+        }
+    }
+    closedir(dir);
+}
+
+/* ************************************************************************ */
+/** handle the events of a watched directory, under priv->mutex */
+static void cgroup_linux_event(sensor_family_t * family, const struct inotify_event * event) {
+    cgroup_priv_t *     priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    cgroup_watch_t *    watch = NULL;
+    char                child[PATH_MAX];
+
+    SLIST_FOREACH_DATA(sysdep->watches, it, cgroup_watch_t *) {
+        if (it->wd == event->wd) {
+            watch = it;
+            break ;
+        }
+    }
+    if (watch == NULL) {
+        return ;
+    }
+    if ((event->mask & IN_IGNORED) != 0) {
+        /* the directory is gone, its cgroup is given by the event of its parent */
+        sysdep->watches = slist_remove_ptr(sysdep->watches, watch);
+        free(watch);
+        return ;
+    }
+    if (event->len == 0 || (event->mask & IN_ISDIR) == 0
+    ||  snprintf(child, sizeof(child), "%s%s%s", watch->path, *watch->path ? "/" : "", event->name)
+            >= (int) sizeof(child)) {
+        return ;
+    }
+    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+        cgroup_found(family, child, watch->depth + 1);
+        if (watch->depth + 1 < priv->max_depth
+        &&  cgroup_filter_match(priv, child, watch->depth + 1, 1)) {
+            cgroup_linux_watch_add(family, child, watch->depth + 1);
+            cgroup_linux_scan(family, child, watch->depth + 1);
+        }
+    } else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+        cgroup_lost(family, child);
+    }
+}
+
+/* ************************************************************************ */
+/** read all pending inotify events */
+static sensor_status_t cgroup_linux_notify_handle_events(sensor_family_t * family) {
+    cgroup_priv_t * priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    char            buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event * event;
+    ssize_t         len;
+    int             changed;
+
+    pthread_mutex_lock(&priv->mutex);
+    for (;;) {
+        if ((len = read(sysdep->notify_ifd, buf, sizeof(buf))) < 0) {
+            if (errno == EINTR)
+                continue ;
+            if (errno != EAGAIN)
+                LOG_WARN(family->log, "inotify read error: %s", strerror(errno));
+            break ;
+        }
+        if (len == 0)
+            break ;
+        for (char * ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *) ptr;
+
+            if ((event->mask & IN_Q_OVERFLOW) != 0) {
+                /* events were lost: scan all again */
+                LOG_VERBOSE(family->log, "inotify queue overflow");
+                ++(priv->scan_gen);
+                cgroup_linux_scan(family, "", 0);
+                cgroup_scan_end(family);
+                continue ;
+            }
+            cgroup_linux_event(family, event);
+        }
+    }
+    changed = __atomic_load_n(&(priv->changed), __ATOMIC_ACQUIRE);
+    pthread_mutex_unlock(&priv->mutex);
+
+    if (changed) {
+        sensor_family_signal(family);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static int cgroup_linux_thread_event_read(
+                vthread_t *             vthread,
+                vthread_event_t         event,
+                void *                  event_data,
+                void *                  callback_user_data) {
+    (void)vthread;
+    (void)event;
+    (void)event_data;
+    cgroup_linux_notify_handle_events(callback_user_data);
+    return 0;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_support(sensor_family_t * family, const char * label) {
+    char path[PATH_MAX];
+    (void)label;
+
+    snprintf(path, sizeof(path), "%s%s/%s", sensor_sysroot(family), CGROUP_ROOT_DIR,
+             CGROUP_CONTROLLERS_FILE);
+    return access(path, R_OK) == 0 ? SENSOR_SUCCESS : SENSOR_NOT_SUPPORTED;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_destroy(sensor_family_t * family) {
+    cgroup_priv_t * priv = (cgroup_priv_t *) family->priv;
+
+    if (priv != NULL && priv->sysdep != NULL) {
+        sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+        sensor_family_t *   common = sensor_family_common(family->sctx);
+        common_priv_t *     common_priv = common ? (common_priv_t *) common->priv : NULL;
+
+        if (sysdep->registered && common_priv != NULL) {
+            vthread_unregister_event(common_priv->thread, VTE_FD_READ, VTE_DATA_FD(sysdep->notify_ifd),
+                                     cgroup_linux_thread_event_read, family);
+        }
+        if (sysdep->notify_ifd >= 0)
+            close(sysdep->notify_ifd);
+        if (sysdep->root_fd >= 0)
+            close(sysdep->root_fd);
+        slist_free(sysdep->watches, free);
+        if (sysdep->root != NULL)
+            free(sysdep->root);
+        priv->sysdep = NULL;
+        free(sysdep);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_init(sensor_family_t * family) {
+    cgroup_priv_t *     priv = (family->priv);
+    sensor_family_t *   common = sensor_family_common(family->sctx);
+    common_priv_t *     common_priv = common ? (common_priv_t *) common->priv : NULL;
+    sysdep_t *          sysdep;
+
+    if (priv->sysdep != NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if ((sysdep = calloc(1, sizeof(sysdep_t))) == NULL) {
+        LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
+        return SENSOR_ERROR;
+    }
+    priv->sysdep = sysdep;
+    sysdep->root_fd = sysdep->notify_ifd = -1;
+
+    if (asprintf(&sysdep->root, "%s%s", sensor_sysroot(family), CGROUP_ROOT_DIR) < 0) {
+        sysdep->root = NULL;
+        sysdep_cgroup_destroy(family);
+        return SENSOR_ERROR;
+    }
+    if ((sysdep->root_fd = open(sysdep->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0
+    ||  (sysdep->notify_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        LOG_WARN(family->log, "cannot watch %s: %s", sysdep->root, strerror(errno));
+        sysdep_cgroup_destroy(family);
+        return SENSOR_ERROR;
+    }
+
+    /* the discovery starts before the common thread can give events */
+    pthread_mutex_lock(&priv->mutex);
+    cgroup_linux_watch_add(family, "", 0);
+    cgroup_linux_scan(family, "", 0);
+    pthread_mutex_unlock(&priv->mutex);
+
+    if (common_priv == NULL
+    ||  vthread_register_event(common_priv->thread, VTE_FD_READ, VTE_DATA_FD(sysdep->notify_ifd),
+                               cgroup_linux_thread_event_read, family) != 0) {
+        LOG_WARN(family->log, "cannot register inotify events in common thread(): %s", strerror(errno));
+        sysdep_cgroup_destroy(family);
+        return SENSOR_ERROR;
+    }
+    sysdep->registered = 1;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+void sysdep_cgroup_info_free(cgroupinfo_t * info) {
+    sys_cgroupinfo_t * sysinfo = (sys_cgroupinfo_t *) info->sysdep;
+
+    if (sysinfo != NULL) {
+        for (unsigned int i = 0; i < CGROUP_FILE_NB; ++i) {
+            if (sysinfo->fds[i] >= 0)
+                close(sysinfo->fds[i]);
+        }
+        info->sysdep = NULL;
+        free(sysinfo);
+    }
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_cgroup_has_file(sensor_family_t * family, cgroupinfo_t * info,
+                                       cgroup_file_t file) {
+    cgroup_priv_t * priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    char            path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", info->path, s_cgroup_files[file]);
+    return faccessat(sysdep->root_fd, path, R_OK, 0) == 0 ? SENSOR_SUCCESS : SENSOR_NOT_SUPPORTED;
+}
+
+/* ************************************************************************ */
+ssize_t sysdep_cgroup_read(sensor_family_t * family, cgroupinfo_t * info,
+                           cgroup_file_t file, char * buf, size_t size) {
+    cgroup_priv_t *     priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    sys_cgroupinfo_t *  sysinfo = (sys_cgroupinfo_t *) info->sysdep;
+    ssize_t             n;
+
+    if (sysinfo == NULL) {
+        if ((sysinfo = malloc(sizeof(*sysinfo))) == NULL)
+            return -1;
+        for (unsigned int i = 0; i < CGROUP_FILE_NB; ++i)
+            sysinfo->fds[i] = -1;
+        info->sysdep = sysinfo;
+    }
+    /* the file stays opened: next reads only cost a pread() */
+    if (sysinfo->fds[file] < 0) {
+        char path[PATH_MAX];
+
+        snprintf(path, sizeof(path), "%s/%s", info->path, s_cgroup_files[file]);
+        if ((sysinfo->fds[file] = openat(sysdep->root_fd, path, O_RDONLY | O_CLOEXEC)) < 0) {
+            LOG_DEBUG(family->log, "cannot open cgroup %s: %s", path, strerror(errno));
+            return -1;
+        }
+    }
+    while ((n = pread(sysinfo->fds[file], buf, size - 1, 0)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+    if (n < 0) {
+        /* the cgroup is being removed */
+        close(sysinfo->fds[file]);
+        sysinfo->fds[file] = -1;
+        return -1;
+    }
+    buf[n] = 0;
+    sensor_family_stats_reads(family, 1);
+
+    return n;
+}
@@ -52,6 +52,7 @@ static int (*udev_monitor_get_fd)(struct udev_monitor *) = NULL;
 static struct udev_device * (*udev_monitor_receive_device)(struct udev_monitor *) = NULL;
 static int (*udev_monitor_filter_update)(struct udev_monitor *) = NULL;
 static const char * (*udev_device_get_devnode)(struct udev_device *) = NULL;
+static const char * (*udev_device_get_sysname)(struct udev_device *) = NULL;
 static const char * (*udev_device_get_action)(struct udev_device *) = NULL;
 static const char * (*udev_device_get_devtype)(struct udev_device *) = NULL;
 static const char * (*udev_device_get_subsystem)(struct udev_device *) = NULL;
@@ -60,6 +61,11 @@ static const char * (*udev_device_get_sysattr_value)(struct udev_device *, const
 static struct udev_device * (*udev_device_unref)(struct udev_device *) = NULL;
 static struct udev_monitor * (*udev_monitor_unref)(struct udev_monitor *) = NULL;
 static struct udev * (*udev_unref)(struct udev *) = NULL;
+
+/* the udev library and its symbols are shared by all sensor contexts */
+static pthread_mutex_t  s_udevlib_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void *           s_udevlib = NULL;
+static unsigned int     s_udevlib_refs = 0;
 #endif
 
 #include "vlib/util.h"
@@ -92,6 +98,13 @@ static sensor_status_t common_linux_udevlib_init(sensor_family_t * family) {
     if (sysdep->udevlib != NULL) {
         return SENSOR_SUCCESS;
     }
+    pthread_mutex_lock(&s_udevlib_mutex);
+    if (s_udevlib != NULL) {
+        ++s_udevlib_refs;
+        sysdep->udevlib = s_udevlib;
+        pthread_mutex_unlock(&s_udevlib_mutex);
+        return SENSOR_SUCCESS;
+    }
 
     static const char * libs[] = { "libudev.so", "libudev.so.1", "libudev.so.2", "libudev.so.3", "libudev.so.4", "libudev.so.0", NULL };
 
@@ -100,6 +113,7 @@ static sensor_status_t common_linux_udevlib_init(sensor_family_t * family) {
     }
     if (sysdep->udevlib == NULL) {
         LOG_WARN(family->log, "cannot open udev library -> no dynamic device");
+        pthread_mutex_unlock(&s_udevlib_mutex);
         return SENSOR_ERROR;
     }
 
@@ -112,6 +126,7 @@ static sensor_status_t common_linux_udevlib_init(sensor_family_t * family) {
     ||  (udev_monitor_receive_device = dlsym(sysdep->udevlib, "udev_monitor_receive_device")) == NULL
     ||  (udev_monitor_filter_update = dlsym(sysdep->udevlib, "udev_monitor_filter_update")) == NULL
     ||  (udev_device_get_devnode = dlsym(sysdep->udevlib, "udev_device_get_devnode")) == NULL
+    ||  (udev_device_get_sysname = dlsym(sysdep->udevlib, "udev_device_get_sysname")) == NULL
     ||  (udev_device_get_action = dlsym(sysdep->udevlib, "udev_device_get_action")) == NULL
     ||  (udev_device_get_devtype = dlsym(sysdep->udevlib, "udev_device_get_devtype")) == NULL
     ||  (udev_device_get_subsystem = dlsym(sysdep->udevlib, "udev_device_get_subsystem")) == NULL
@@ -123,8 +138,12 @@ static sensor_status_t common_linux_udevlib_init(sensor_family_t * family) {
         LOG_WARN(family->log, "cannot find symbols in udev library -> no dynamic device");
         dlclose(sysdep->udevlib);
         sysdep->udevlib = NULL;
+        pthread_mutex_unlock(&s_udevlib_mutex);
         return SENSOR_ERROR;
     }
+    s_udevlib = sysdep->udevlib;
+    s_udevlib_refs = 1;
+    pthread_mutex_unlock(&s_udevlib_mutex);
     LOG_VERBOSE(family->log, "udevlib loaded.");
     return SENSOR_SUCCESS;
 }
@@ -135,7 +154,12 @@ static sensor_status_t common_linux_udevlib_destroy(sensor_family_t * family) {
     sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
 
     if (sysdep->udevlib != NULL) {
-        dlclose(sysdep->udevlib);
+        pthread_mutex_lock(&s_udevlib_mutex);
+        if (--s_udevlib_refs == 0) {
+            dlclose(s_udevlib);
+            s_udevlib = NULL;
+        }
+        pthread_mutex_unlock(&s_udevlib_mutex);
         sysdep->udevlib = NULL;
     }
 
@@ -223,7 +247,12 @@ static sensor_status_t common_linux_handle_device(sensor_family_t * family, int
     const char * devsubsys = udev_device_get_subsystem(dev);
     const char * devdrv = udev_device_get_driver(dev);
 
+    /* network interfaces have no device node, use their name */
+    if (!devnode && devsubsys && !strcmp(devsubsys, "net")) {
+        devnode = udev_device_get_sysname(dev);
+    }
     if (!devnode) {
+        udev_device_unref(dev);
         return SENSOR_ERROR;
     }
 
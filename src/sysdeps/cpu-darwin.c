@@ -44,11 +44,19 @@
 #include "cpu_private.h"
 
 /* ************************************************************************ */
+/* host_processor_info() is the only unprivileged per-cpu load interface, and
+ * it always gives a new out-of-line array: the previous one is released on
+ * next call. The host port is taken once, each mach_host_self() adding a
+ * reference to it. */
 typedef struct {
+    host_t                              host;
     processor_cpu_load_info_data_t *    pinfo;
     mach_msg_type_number_t              info_count;
 } cpu_sysdep_t;
 
+/** size in bytes of an array given by host_processor_info() */
+#define CPU_DARWIN_INFO_SIZE(count)     ((vm_size_t) (count) * sizeof(integer_t))
+
 /* ************************************************************************ */
 sensor_status_t sysdep_cpu_support(sensor_family_t * family, const char * label) {
     (void) label;
@@ -77,6 +85,7 @@ unsigned int    sysdep_cpu_nb(sensor_family_t * family) {
         }
         else {
             cpu_sysdep_t * sysdep = (cpu_sysdep_t *) priv->sysdep;
+            sysdep->host = mach_host_self();
             sysdep->pinfo = NULL;
             sysdep->info_count = 0;
         }
@@ -92,9 +101,12 @@ void            sysdep_cpu_destroy(sensor_family_t * family) {
         cpu_sysdep_t *  sysdep  = (cpu_sysdep_t *) priv->sysdep;
 
         if (sysdep->pinfo != NULL) {
-            vm_deallocate(mach_task_self(), (vm_address_t) sysdep->pinfo, sysdep->info_count);
+            vm_deallocate(mach_task_self(), (vm_address_t) sysdep->pinfo,
+                          CPU_DARWIN_INFO_SIZE(sysdep->info_count));
             sysdep->pinfo = NULL;
         }
+        if (sysdep->host != MACH_PORT_NULL)
+            mach_port_deallocate(mach_task_self(), sysdep->host);
         priv->sysdep = NULL;
         free(sysdep);
     }
@@ -107,15 +119,15 @@ sensor_status_t sysdep_cpu_get(sensor_family_t * family, struct timeval *elapsed
     cpu_sysdep_t *                      sysdep      = (cpu_sysdep_t *) priv->sysdep;
     cpu_data_t *                        data        = &(priv->cpu_data);
     unsigned int                        i;
-    unsigned int                        n_cpus      = data->nb_cpus;
-    processor_cpu_load_info_data_t *    pinfo       = sysdep->pinfo;
-    mach_msg_type_number_t              info_count  = sysdep->info_count;
+    natural_t                           n_cpus      = data->nb_cpus;
+    processor_cpu_load_info_data_t *    pinfo       = NULL;
+    mach_msg_type_number_t              info_count  = 0;
 
-    if (sysdep == NULL) {
+    if (sysdep == NULL || sysdep->host == MACH_PORT_NULL) {
         return SENSOR_ERROR;
     }
 
-    if (host_processor_info (mach_host_self(),
+    if (host_processor_info (sysdep->host,
                        PROCESSOR_CPU_LOAD_INFO,
                        &n_cpus,
                        (processor_info_array_t *) &(pinfo),
@@ -124,26 +136,19 @@ sensor_status_t sysdep_cpu_get(sensor_family_t * family, struct timeval *elapsed
         LOG_ERROR(family->log, "%s/%s(): error host_processo_info", __FILE__, __func__);
         return SENSOR_ERROR;
     }
-    if (pinfo != sysdep->pinfo || info_count != sysdep->info_count || n_cpus != data->nb_cpus) {
-        LOG_SCREAM(family->log, "cpu-darwin: pinfo reallocated = %lx", (unsigned long) pinfo);
-        if (sysdep->pinfo != NULL)
-            vm_deallocate(mach_task_self(), (vm_address_t) sysdep->pinfo, sysdep->info_count);
-        sysdep->pinfo = pinfo;
-        sysdep->info_count = info_count;
+    if (sysdep->pinfo != NULL) {
+        vm_deallocate(mach_task_self(), (vm_address_t) sysdep->pinfo,
+                      CPU_DARWIN_INFO_SIZE(sysdep->info_count));
     }
+    sysdep->pinfo = pinfo;
+    sysdep->info_count = info_count;
 
-    if (n_cpus > data->nb_cpus) {
-        // array size = 1 global measure + 1 per cpu.
+    if (n_cpus != data->nb_cpus) {
+        /* ticks and descs are re-allocated by cpu.c when the family is reloaded */
         LOG_VERBOSE(family->log, "number of CPUs changed ! old:%u new:%u", data->nb_cpus, n_cpus);
-        if ((data->ticks = realloc(data->ticks, (n_cpus + 1) * sizeof(cpu_tick_t))) == NULL) {
-            data->nb_cpus = 0;
-            LOG_ERROR(family->log, "%s/%s(): cannot allocate cpu_ticks", __FILE__, __func__);
-            return SENSOR_ERROR;
-        } else {
-            memset(data->ticks + data->nb_cpus + 1, 0,
-                   (n_cpus - data->nb_cpus) * sizeof(cpu_tick_t));
-        }
         data->nb_cpus = n_cpus;
+        data->max_cpus = n_cpus;
+        return SENSOR_RELOAD_FAMILY;
     }
 
     for (i = 1; i <= n_cpus; i++) {
@@ -178,32 +183,3 @@ sensor_status_t sysdep_cpu_get(sensor_family_t * family, struct timeval *elapsed
 
     return SENSOR_SUCCESS;
 }
-
-#if 0 // TODO to be removed
-/* ************************************************************************ */
-static sensor_status_t cpu_get2(sensor_family_t * family,
-                                cpu_data_t *data, struct timeval *elapsed) {
-    int mib[] = {
-	    CTL_VM,
-	    VM_LOADAVG,
-    };
-    struct loadavg loadavg;
-    size_t len = sizeof(loadavg);
-    if (sysctl(mib, sizeof(mib) / sizeof(*mib), &loadavg, &len, NULL, 0) < 0) {
-	    LOG_WARN(family->log, "%s(): sysctl(buf): %s", __func__, strerror(errno));
-	    return SENSOR_ERROR;
-    }
-
-    LOG_DEBUG(family->log, "CPU FSSCALE:%ld L0 %u(%f) L1: %u(%f) L2: %u(%f)",
-           loadavg.fscale,
-           loadavg.ldavg[0], (float)loadavg.ldavg[0]/loadavg.fscale,
-           loadavg.ldavg[1], (float)loadavg.ldavg[1]/loadavg.fscale,
-           loadavg.ldavg[2], (float)loadavg.ldavg[2]/loadavg.fscale);
-
-    //data->usage = 55;
-    (void)elapsed;
-    (void)data;
-    return SENSOR_SUCCESS;
-}
-#endif
-
@@ -48,8 +48,38 @@ typedef struct {
     int             cp_times_mib[6];
     size_t          cp_times_mib_sz;
     long *          cp_times;
+    size_t          cp_times_size;  /* bytes allocated in cp_times */
 } sysdep_cpu_data_t;
 
+/* ************************************************************************ */
+/** make cp_times hold what kern.cp_times gives (all cpus up to kern.smp.maxcpus),
+ * and at least nb_cpus entries for kern.cp_time: it is probed once, sysdep_cpu_get()
+ * then reads in it directly */
+static int cpu_freebsd_alloc(sensor_family_t * family, sysdep_cpu_data_t * sysdep,
+                             unsigned int n_cpus) {
+    size_t  size = 0;
+    long *  cp_times;
+
+    if (sysdep->cp_times_mib_sz > 0
+    &&  sysctl(sysdep->cp_times_mib, sysdep->cp_times_mib_sz, NULL, &size, NULL, 0) < 0) {
+        LOG_WARN(family->log, "%s(): sysctl(cp_times size): %s", __func__, strerror(errno));
+        size = 0;
+    }
+    if (size < sizeof(*sysdep->cp_times) * CPUSTATES * n_cpus)
+        size = sizeof(*sysdep->cp_times) * CPUSTATES * n_cpus;
+    if (size <= sysdep->cp_times_size) {
+        return 0;
+    }
+    if ((cp_times = realloc(sysdep->cp_times, size)) == NULL) {
+        LOG_WARN(family->log, "%s(): cannot allocate cp_times: %s", __func__, strerror(errno));
+        return -1;
+    }
+    memset((char *) cp_times + sysdep->cp_times_size, 0, size - sysdep->cp_times_size);
+    sysdep->cp_times = cp_times;
+    sysdep->cp_times_size = size;
+    return 0;
+}
+
 
 /* ************************************************************************ */
 sensor_status_t sysdep_cpu_support(sensor_family_t * family, const char * label) {
@@ -77,7 +107,8 @@ unsigned int    sysdep_cpu_nb(sensor_family_t * family) {
 
     if (priv->sysdep == NULL) {
         if ((sysdep = priv->sysdep = malloc(sizeof(sysdep_cpu_data_t))) != NULL) {
-            sysdep->cp_times = calloc(n_cpus * CPUSTATES, sizeof(*sysdep->cp_times));
+            sysdep->cp_times = NULL;
+            sysdep->cp_times_size = 0;
             sysdep->cp_time_mib_sz = sizeof(sysdep->cp_time_mib) / sizeof(*sysdep->cp_time_mib);
             sysdep->cp_times_mib_sz = sizeof(sysdep->cp_times_mib) / sizeof(*sysdep->cp_times_mib);
             if (sysctlnametomib("kern.cp_time",  sysdep->cp_time_mib, &sysdep->cp_time_mib_sz) != 0) {
@@ -90,6 +121,9 @@ unsigned int    sysdep_cpu_nb(sensor_family_t * family) {
             }
         }
     }
+    if ((sysdep = priv->sysdep) != NULL) {
+        cpu_freebsd_alloc(family, sysdep, n_cpus);
+    }
 
     return n_cpus;
 }
@@ -123,15 +157,18 @@ sensor_status_t sysdep_cpu_get(sensor_family_t * family, struct timeval *elapsed
     /* "kern.cp_times" -> specific cpu */
 
     if (data->nb_cpus > 1 && sysdep->cp_times_mib_sz > 0) {
-        size = sizeof(sysdep->cp_times) * CPUSTATES * data->nb_cpus;
+        size = sysdep->cp_times_size;
         if (sysctl(sysdep->cp_times_mib, sysdep->cp_times_mib_sz,
                    sysdep->cp_times, &size, NULL, 0) < 0) {
+            /* ENOMEM: kern.smp.maxcpus grew, the size is probed again next time */
+            if (errno == ENOMEM)
+                cpu_freebsd_alloc(family, sysdep, data->nb_cpus);
             LOG_WARN(family->log, "%s(): sysctl(cp_times): %s", __func__, strerror(errno));
             errno = EAGAIN;
             return SENSOR_ERROR;
         }
     } else if (sysdep->cp_time_mib_sz > 0) {
-        size = sizeof(sysdep->cp_times) * CPUSTATES * data->nb_cpus;
+        size = sizeof(*sysdep->cp_times) * CPUSTATES;
         if (sysctl(sysdep->cp_time_mib, sysdep->cp_time_mib_sz,
                    sysdep->cp_times, &size, NULL, 0) < 0) {
             LOG_WARN(family->log, "%s(): sysctl(cp_time): %s", __func__, strerror(errno));
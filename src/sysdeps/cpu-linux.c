@@ -24,15 +24,20 @@
  * Generic Sensor Management Library.
  */
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
 
 #include "vlib/util.h"
 
 #include "cpu_private.h"
+#include "sensor_private.h"
 
 /* ************************************************************************ */
 
@@ -40,12 +45,336 @@
 #define CPU_PROC_FILE   "/proc/stat"
 #endif
 
+#ifndef CPU_LINUX_BUFSZ_MIN
+#define CPU_LINUX_BUFSZ_MIN     4096
+#endif
+
+/** /proc/stat columns after "cpuN", older kernels can have less columns */
+enum {
+    CPU_LINUX_USER = 0,
+    CPU_LINUX_NICE,
+    CPU_LINUX_SYS,
+    CPU_LINUX_IDLE,
+    CPU_LINUX_IOWAIT,
+    CPU_LINUX_IRQ,
+    CPU_LINUX_SOFTIRQ,
+    CPU_LINUX_STEAL,
+    CPU_LINUX_GUEST,
+    CPU_LINUX_GUEST_NICE,
+    CPU_LINUX_NB
+};
+
+#ifndef CPU_SYSFS_DIR
+#define CPU_SYSFS_DIR   "/sys/devices/system/cpu"
+#endif
+
+/** per-cpu sysfs files (CPU_SYSFS_DIR/cpuN/...) giving cpu_extra_t data */
+enum {
+    CPU_LINUX_X_FREQ = 0,
+    CPU_LINUX_X_CORE_THROTTLE,
+    CPU_LINUX_X_PACKAGE_THROTTLE,
+    CPU_LINUX_X_NB
+};
+static const char * const s_cpu_linux_extra_files[CPU_LINUX_X_NB] = {
+    "cpufreq/scaling_cur_freq",
+    "thermal_throttle/core_throttle_count",
+    "thermal_throttle/package_throttle_count"
+};
+#define CPU_LINUX_X_NOTOPENED   -2
+
 typedef struct {
-    FILE *  stat;
-    char *  stat_line;
-    size_t  stat_linesz;
+    int     fd;
+    sensor_provider_t * provider;   /* CPU_PROC_FILE reads shared with other contexts */
+    char *  buf;        /* reused between reads, holds at least the cpu lines */
+    size_t  bufsz;
+    int *   extra_fds;  /* CPU_LINUX_X_NB per cpu index, opened once, -1 if unavailable */
+    size_t  nb_extra_fds;
+    int     online_fd;  /* CPU_SYSFS_DIR/online, -1 if not available: all cpus online */
+    char *  online_list;/* last content of online file */
+    size_t  online_len;
+    unsigned char * online;     /* cpu_data_t.online, node_of, package_of */
+    size_t          nb_topo;    /* allocated elements of online, node_of, package_of */
+    int *           node_of;
+    int *           package_of;
 } cpu_linux_t;
 
+#define CPU_LINUX_ONLINE_BUFSZ  4096
+
+/* ************************************************************************ */
+/** read the cpu lines of /proc/stat with pread() in sysdep buffer.
+ * As cpu lines are the first ones, stop as soon as another line is complete,
+ * growing the buffer only if it cannot hold all cpu lines.
+ * @return the number of bytes in buffer, or -1 on error */
+static ssize_t cpu_linux_read(sensor_family_t * family, cpu_linux_t * sysdep) {
+    char *  buf;
+    ssize_t n;
+
+    if (sysdep->fd < 0) {
+        char path[PATH_MAX];
+
+        snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), CPU_PROC_FILE);
+        if ((sysdep->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+            LOG_ERROR(family->log, "error while openning %s: %s", path, strerror(errno));
+            return -1;
+        }
+        if (sysdep->provider == NULL)
+            sysdep->provider = sensor_provider_get(path);
+    }
+    while (1) {
+        const char * line, * end;
+
+        if ((n = sensor_provider_pread(sysdep->provider, family,
+                                       sysdep->fd, sysdep->buf, sysdep->bufsz)) < 0) {
+            LOG_ERROR(family->log, "error while reading %s: %s", CPU_PROC_FILE, strerror(errno));
+            return -1;
+        }
+        if ((size_t) n < sysdep->bufsz) {
+            return n; /* whole file */
+        }
+        /* buffer is full: look for a complete line not starting with "cpu" */
+        for (line = sysdep->buf, end = sysdep->buf + n; line < end; ++line) {
+            const char * eol = memchr(line, '\n', end - line);
+            if (eol == NULL)
+                break ;
+            if (end - line < 3 || strncmp(line, "cpu", 3) != 0)
+                return n;
+            line = eol;
+        }
+        if ((buf = realloc(sysdep->buf, sysdep->bufsz * 2)) == NULL) {
+            LOG_ERROR(family->log, "error, cannot grow %s buffer", CPU_PROC_FILE);
+            return -1;
+        }
+        sysdep->buf = buf;
+        sysdep->bufsz *= 2;
+    }
+}
+
+/* ************************************************************************ */
+/** scan an unsigned decimal after blanks, NULL if there is none before eol */
+static inline const char * cpu_linux_scan_ulong(const char * s, const char * eol,
+                                               unsigned long * value) {
+    unsigned long v = 0;
+
+    while (s < eol && (*s == ' ' || *s == '\t'))
+        ++s;
+    if (s >= eol || (unsigned char) (*s - '0') > 9)
+        return NULL;
+    do {
+        v = v * 10 + (*s - '0');
+    } while (++s < eol && (unsigned char) (*s - '0') <= 9);
+    *value = v;
+    return s;
+}
+
+/* ************************************************************************ */
+/** read the sysfs extras of cpu index n (cpuN-1) with their persistent fds */
+static void cpu_linux_read_extras(sensor_family_t * family, cpu_linux_t * sysdep,
+                                  unsigned long n) {
+    cpu_tick_t *                ticks   = &(((cpu_priv_t *) family->priv)->cpu_data.ticks[n]);
+    TYPE_SENSOR_VALUE_ULONG *   values[CPU_LINUX_X_NB] = {
+        &ticks->freq, &ticks->core_throttles, &ticks->package_throttles
+    };
+    char                        buf[32];
+    ssize_t                     len;
+
+    if (n == 0 || n >= sysdep->nb_extra_fds) {
+        return ;
+    }
+    for (unsigned int i = 0; i < CPU_LINUX_X_NB; ++i) {
+        int * fd = &(sysdep->extra_fds[n * CPU_LINUX_X_NB + i]);
+
+        if (*fd == CPU_LINUX_X_NOTOPENED) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s%s/cpu%lu/%s", sensor_sysroot(family),
+                     CPU_SYSFS_DIR, n - 1, s_cpu_linux_extra_files[i]);
+            if ((*fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+                LOG_DEBUG(family->log, "cannot open %s: %s", path, strerror(errno));
+        }
+        if (*fd < 0) {
+            continue ;
+        }
+        sensor_family_stats_reads(family, 1);
+        if ((len = pread(*fd, buf, sizeof(buf) - 1, 0)) <= 0
+        ||  cpu_linux_scan_ulong(buf, buf + len, values[i]) == NULL) {
+            LOG_SCREAM(family->log, "cannot read cpu%lu/%s", n - 1, s_cpu_linux_extra_files[i]);
+        }
+    }
+}
+
+/* ************************************************************************ */
+/** (re)allocate the fds of cpu extras for cpu indexes 0..nb-1, closing previous ones */
+static void cpu_linux_alloc_extras(sensor_family_t * family, cpu_linux_t * sysdep, size_t nb) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+    int *           fds;
+
+    if (priv->extras == CPU_EXTRA_NONE)
+        return ;
+    for (size_t i = 0; i < sysdep->nb_extra_fds * CPU_LINUX_X_NB; ++i) {
+        if (sysdep->extra_fds[i] >= 0)
+            close(sysdep->extra_fds[i]);
+    }
+    if ((fds = realloc(sysdep->extra_fds, nb * CPU_LINUX_X_NB * sizeof(*fds))) == NULL) {
+        LOG_WARN(family->log, "cannot allocate cpu sysfs fds");
+        nb = 0;
+    } else {
+        sysdep->extra_fds = fds;
+    }
+    sysdep->nb_extra_fds = nb;
+    for (size_t i = 0; i < sysdep->nb_extra_fds * CPU_LINUX_X_NB; ++i)
+        sysdep->extra_fds[i] = CPU_LINUX_X_NOTOPENED;
+}
+
+/* ************************************************************************ */
+/** parse a sysfs cpu list ("0-3,8,10-11\n"), setting mask[id + 1] if mask is not NULL.
+ * @return the number of cpus, their highest id being stored in *max_id */
+static unsigned int cpu_linux_parse_cpulist(const char * s, const char * end,
+                                            unsigned char * mask, size_t mask_size,
+                                            unsigned long * max_id) {
+    unsigned int    count = 0;
+    unsigned long   first, last;
+
+    *max_id = 0;
+    while (s < end && (s = cpu_linux_scan_ulong(s, end, &first)) != NULL) {
+        last = first;
+        if (s < end && *s == '-' && (s = cpu_linux_scan_ulong(s + 1, end, &last)) == NULL)
+            break ;
+        for (unsigned long id = first; id <= last; ++id) {
+            if (mask != NULL && id + 1 < mask_size)
+                mask[id + 1] = 1;
+            ++count;
+        }
+        if (last > *max_id)
+            *max_id = last;
+        if (s >= end || *s != ',')
+            break ;
+        ++s;
+    }
+    return count;
+}
+
+/* ************************************************************************ */
+/** read an integer in a small sysfs file, -1 on error */
+static int cpu_linux_read_int(const char * path) {
+    char            buf[32];
+    unsigned long   value;
+    ssize_t         len;
+    int             fd;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    len = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (len <= 0 || cpu_linux_scan_ulong(buf, buf + len, &value) == NULL || value > INT_MAX)
+        return -1;
+    return (int) value;
+}
+
+/* ************************************************************************ */
+/** numa node of cpu id, given by the cpuN/nodeM link, -1 if unknown */
+static int cpu_linux_node(sensor_family_t * family, unsigned long id) {
+    char            path[PATH_MAX];
+    struct dirent * entry;
+    DIR *           dir;
+    int             node = -1;
+
+    snprintf(path, sizeof(path), "%s%s/cpu%lu", sensor_sysroot(family), CPU_SYSFS_DIR, id);
+    if ((dir = opendir(path)) == NULL)
+        return -1;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned long value;
+        if (strncmp(entry->d_name, "node", 4) == 0
+        &&  cpu_linux_scan_ulong(entry->d_name + 4, entry->d_name + strlen(entry->d_name),
+                                 &value) != NULL && value <= INT_MAX) {
+            node = (int) value;
+            break ;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/* ************************************************************************ */
+/** read the online cpus mask and, if it changed, update online cpus, their
+ * topology and cpu_data_t (the ticks must then be re-allocated by cpu.c).
+ * @return 1 if changed, 0 if not, -1 on error */
+static int cpu_linux_online(sensor_family_t * family, cpu_linux_t * sysdep) {
+    cpu_priv_t *    priv = (cpu_priv_t *) family->priv;
+    cpu_data_t *    data = &(priv->cpu_data);
+    char            buf[CPU_LINUX_ONLINE_BUFSZ];
+    char            path[PATH_MAX];
+    unsigned long   max_id;
+    unsigned int    n_cpus, i;
+    int             b_nodes = 0, b_packages = 0;
+    size_t          nb;
+    ssize_t         len;
+    void *          ptr;
+
+    sensor_family_stats_reads(family, 1);
+    if ((len = pread(sysdep->online_fd, buf, sizeof(buf), 0)) <= 0) {
+        LOG_ERROR(family->log, "error while reading %s/online", CPU_SYSFS_DIR);
+        return -1;
+    }
+    if (sysdep->online_list != NULL && (size_t) len == sysdep->online_len
+    &&  memcmp(buf, sysdep->online_list, len) == 0) {
+        return 0;
+    }
+    if ((n_cpus = cpu_linux_parse_cpulist(buf, buf + len, NULL, 0, &max_id)) == 0
+    ||  max_id >= UINT16_MAX) {
+        LOG_ERROR(family->log, "bad content of %s/online", CPU_SYSFS_DIR);
+        return -1;
+    }
+    LOG_VERBOSE(family->log, "online cpus: %.*s", (int) len, buf);
+
+    /* cpu indexes go from 1 to max_id + 1 */
+    nb = max_id + 2;
+    /* topology arrays never shrink: cpu_data_t can use them until it is updated */
+    if ((ptr = realloc(sysdep->online_list, len)) != NULL) {
+        sysdep->online_list = ptr;
+        sysdep->online_len = 0;
+        if (nb > sysdep->nb_topo && (ptr = realloc(sysdep->online, nb)) != NULL) {
+            data->online = sysdep->online = ptr;
+            if ((ptr = realloc(sysdep->node_of, nb * sizeof(int))) != NULL) {
+                sysdep->node_of = ptr;
+                data->node_of = data->node_of != NULL ? sysdep->node_of : NULL;
+                if ((ptr = realloc(sysdep->package_of, nb * sizeof(int))) != NULL) {
+                    sysdep->package_of = ptr;
+                    data->package_of = data->package_of != NULL ? sysdep->package_of : NULL;
+                    sysdep->nb_topo = nb;
+                }
+            }
+        }
+    }
+    if (ptr == NULL) {
+        LOG_ERROR(family->log, "error, cannot allocate cpu topology");
+        return -1;
+    }
+    memcpy(sysdep->online_list, buf, len);
+    sysdep->online_len = len;
+
+    memset(sysdep->online, 0, nb);
+    cpu_linux_parse_cpulist(buf, buf + len, sysdep->online, nb, &max_id);
+    for (i = 0; i < nb; ++i) {
+        sysdep->node_of[i] = sysdep->package_of[i] = -1;
+        if (i == 0 || !sysdep->online[i])
+            continue ;
+        snprintf(path, sizeof(path), "%s%s/cpu%u/topology/physical_package_id",
+                 sensor_sysroot(family), CPU_SYSFS_DIR, i - 1);
+        if ((sysdep->package_of[i] = cpu_linux_read_int(path)) >= 0)
+            b_packages = 1;
+        if ((sysdep->node_of[i] = cpu_linux_node(family, i - 1)) >= 0)
+            b_nodes = 1;
+    }
+
+    data->nb_cpus = n_cpus;
+    data->max_cpus = max_id + 1;
+    data->online = sysdep->online;
+    data->node_of = b_nodes ? sysdep->node_of : NULL;
+    data->package_of = b_packages ? sysdep->package_of : NULL;
+
+    cpu_linux_alloc_extras(family, sysdep, nb);
+
+    return 1;
+}
 
 /* ************************************************************************ */
 sensor_status_t sysdep_cpu_support(sensor_family_t * family, const char * label) {
@@ -59,9 +388,9 @@ unsigned int    sysdep_cpu_nb(sensor_family_t * family) {
     cpu_priv_t *    priv = (family->priv);
     cpu_linux_t *   sysdep;
     unsigned int    n_cpus;
-    char            *line = NULL;
-    size_t          lineallocsz = 0;
-    ssize_t         linesz;
+    const char *    line, * end;
+    char            path[PATH_MAX];
+    ssize_t         n;
 
     if (priv->sysdep == NULL) {
         priv->sysdep = calloc(1, sizeof(cpu_linux_t));
@@ -72,27 +401,67 @@ unsigned int    sysdep_cpu_nb(sensor_family_t * family) {
         }
 
         sysdep = priv->sysdep;
-        sysdep->stat_line = NULL;
-        sysdep->stat_linesz = 0;
-        if ((sysdep->stat = fopen(CPU_PROC_FILE, "r")) == NULL) {
-            LOG_ERROR(family->log, "error while openning %s", CPU_PROC_FILE);
-            errno=ENOENT;
+        sysdep->fd = -1;
+        sysdep->online_fd = -1;
+        sysdep->bufsz = CPU_LINUX_BUFSZ_MIN;
+        if ((sysdep->buf = malloc(sysdep->bufsz)) == NULL) {
+            LOG_ERROR(family->log, "error, cannot malloc %s buffer", CPU_PROC_FILE);
+            errno=ENOMEM;
             return 0;
         }
     } else {
         sysdep = priv->sysdep;
     }
 
-    fseek(sysdep->stat, 0, SEEK_SET);
+    /* all cpu_tick_class_t are given by /proc/stat */
+    priv->tick_classes = (1U << CPU_TICK_NB) - 1;
+
+    /* cpu_extra_t available on this system, their fds are opened on first read */
+    priv->extras = CPU_EXTRA_NONE;
+    snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family),
+             CPU_SYSFS_DIR "/cpu0/cpufreq/scaling_cur_freq");
+    if (access(path, R_OK) == 0)
+        priv->extras |= CPU_EXTRA_FREQ;
+    snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family),
+             CPU_SYSFS_DIR "/cpu0/thermal_throttle/core_throttle_count");
+    if (access(path, R_OK) == 0)
+        priv->extras |= CPU_EXTRA_THROTTLE;
+
+    /* the set of cpus is given by the online mask, which is checked on each update */
+    if (sysdep->online_fd < 0) {
+        snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), CPU_SYSFS_DIR "/online");
+        sysdep->online_fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    if (sysdep->online_fd >= 0) {
+        if (cpu_linux_online(family, sysdep) < 0) {
+            errno = ENOENT;
+            return 0;
+        }
+        return priv->cpu_data.nb_cpus;
+    }
+    LOG_VERBOSE(family->log, "no %s/online, cpus are taken from %s", CPU_SYSFS_DIR, CPU_PROC_FILE);
+
+    if ((n = cpu_linux_read(family, sysdep)) < 0) {
+        errno=ENOENT;
+        return 0;
+    }
+
     n_cpus = 0;
-    while ((linesz = getline(&line, &lineallocsz, sysdep->stat)) >= 0) {
-        LOG_DEBUG(family->log, "%s LINE (sz:%zu) %s", CPU_PROC_FILE, linesz, line);
-        if (!strncmp(line, "cpu", 3) && (line[3] != ' ' && line[3] != '\t'))
+    for (line = sysdep->buf, end = sysdep->buf + n; line < end; ++line) {
+        const char * eol = memchr(line, '\n', end - line);
+        if (eol == NULL)
+            break ;
+        LOG_DEBUG(family->log, "%s LINE (sz:%zd) %.*s", CPU_PROC_FILE,
+                  eol - line, (int) (eol - line), line);
+        if (eol - line < 4 || strncmp(line, "cpu", 3) != 0)
+            break ; /* cpu lines are the first ones */
+        if (line[3] != ' ' && line[3] != '\t')
             ++n_cpus;
+        line = eol;
     }
 
-    if (line != NULL)
-        free(line);
+    cpu_linux_alloc_extras(family, sysdep, n_cpus + 1);
+
     return n_cpus;
 }
 
@@ -103,13 +472,35 @@ void            sysdep_cpu_destroy(sensor_family_t * family) {
     if (priv != NULL && priv->sysdep != NULL) {
         cpu_linux_t * sysdep = (cpu_linux_t *) priv->sysdep;
 
-        if (sysdep->stat != NULL) {
-            fclose(sysdep->stat);
-            sysdep->stat = NULL;
+        if (sysdep->fd >= 0) {
+            close(sysdep->fd);
+            sysdep->fd = -1;
         }
-        if (sysdep->stat_line != NULL)
-            free(sysdep->stat_line);
-        sysdep->stat_line = NULL;
+        sensor_provider_release(sysdep->provider);
+        sysdep->provider = NULL;
+        if (sysdep->buf != NULL)
+            free(sysdep->buf);
+        sysdep->buf = NULL;
+        if (sysdep->extra_fds != NULL) {
+            for (size_t i = 0; i < sysdep->nb_extra_fds * CPU_LINUX_X_NB; ++i) {
+                if (sysdep->extra_fds[i] >= 0)
+                    close(sysdep->extra_fds[i]);
+            }
+            free(sysdep->extra_fds);
+        }
+        sysdep->extra_fds = NULL;
+        if (sysdep->online_fd >= 0)
+            close(sysdep->online_fd);
+        if (sysdep->online_list != NULL)
+            free(sysdep->online_list);
+        if (sysdep->online != NULL)
+            free(sysdep->online);
+        if (sysdep->node_of != NULL)
+            free(sysdep->node_of);
+        if (sysdep->package_of != NULL)
+            free(sysdep->package_of);
+        priv->cpu_data.online = NULL;
+        priv->cpu_data.node_of = priv->cpu_data.package_of = NULL;
         priv->sysdep = NULL;
         free(sysdep);
     }
@@ -119,8 +510,9 @@ void            sysdep_cpu_destroy(sensor_family_t * family) {
 sensor_status_t sysdep_cpu_get(sensor_family_t * family, struct timeval *elapsed) {
     cpu_priv_t *    priv = (family->priv);
     cpu_linux_t *   sysdep = priv->sysdep;
-    ssize_t         linesz;
-    unsigned long   n;
+    cpu_data_t *    data = &priv->cpu_data;
+    const char *    line, * end;
+    ssize_t         len;
 
     if (priv->sysdep == NULL) {
         LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
@@ -128,93 +520,106 @@ sensor_status_t sysdep_cpu_get(sensor_family_t * family, struct timeval *elapsed
         return SENSOR_ERROR;
     }
 
-    if (sysdep->stat == NULL || fseek(sysdep->stat, 0, SEEK_SET) != 0) {
-        if (sysdep->stat != NULL)
-            fclose(sysdep->stat);
-        if ((sysdep->stat = fopen(CPU_PROC_FILE, "r")) == NULL) {
+    if (sysdep->online_fd >= 0) {
+        int changed = cpu_linux_online(family, sysdep);
+        if (changed < 0) {
             return SENSOR_ERROR;
         }
+        if (changed > 0) {
+            LOG_INFO(family->log, "online cpus changed, reloading");
+            return SENSOR_RELOAD_FAMILY;
+        }
     }
 
-    while ((linesz = getline(&sysdep->stat_line, &sysdep->stat_linesz, sysdep->stat)) > 0) {
-        char * line = sysdep->stat_line;
+    if ((len = cpu_linux_read(family, sysdep)) < 0) {
+        return SENSOR_ERROR;
+    }
 
-        if (line == NULL)
-            break ;
+    /* /proc/stat format: {
+     *  cpu    user nice system idle iowait irq softirq steal guest guest_nice
+     *  cpu0   user nice system idle iowait irq softirq steal guest guest_nice
+     *  ...}
+     * ticks for cpu are jiffies * smp_num_cpus
+     * ticks for cpu[i] are jiffies (1/CLK_TCK)
+     * guest and guest_nice are already accounted in user and nice.
+     */
+    for (line = sysdep->buf, end = sysdep->buf + len; line < end; ++line) {
+        const char *    eol = memchr(line, '\n', end - line);
+        const char *    s;
+        unsigned long   cols[CPU_LINUX_NB] = { 0, };
+        unsigned long   classes[CPU_TICK_NB];
+        unsigned long   user, sys, activity, total, n;
+        unsigned int    i_col;
+
+        if (eol == NULL)
+            break ; /* incomplete line */
+
+        LOG_SCREAM(family->log, "%s LINE (sz:%zd) %.*s", CPU_PROC_FILE,
+                   eol - line, (int) (eol - line), line);
+
+        if (eol - line < 4 || strncmp(line, "cpu", 3) != 0) {
+            break ; /* cpu lines are the first ones */
+        }
+        s = line + 3;
+        if (*s == ' ' || *s == '\t') {
+            n = 0;
+        } else if ((s = cpu_linux_scan_ulong(s, eol, &n)) == NULL) {
+            line = eol;
+            continue ;
+        } else {
+            ++n;
+        }
+        if (n > data->max_cpus || n >= data->nb_ticks || (n > 0 && !CPU_IS_ONLINE(data, n))) {
+            line = eol;
+            continue ;
+        }
 
-        if (sysdep->stat_line[linesz - 1] == '\n')
-            sysdep->stat_line[--linesz] = 0;
-
-        /* /proc/stat format: {
-         *  cpu    total_user  total_nice  total_sys   total_idle
-         *  cpu0   cpu0_user   cpu0_nice   cpu0_sys    cpu0_idle
-         *  ...}
-         * ticks for cpu are jiffies * smp_num_cpus
-         * ticks for cpu[i] are jiffies (1/CLK_TCK)
-         */
-        LOG_SCREAM(family->log, "%s LINE (sz:%zu) %s", CPU_PROC_FILE,
-                   linesz, line);
-
-        while (*line == ' ' || *line == '\t') {
-            ++line;
-            --linesz;
-        }
-        if (!strncmp(line, "cpu", 3)) {
-            if (line[3] == ' ' || line[3] == '\t') {
-                n = 0;
-            } else {
-                char * endp = NULL;
-                n = strtoul(line + 3, &endp, 10) + 1;
-            }
+        for (i_col = 0; i_col < CPU_LINUX_NB
+                        && (s = cpu_linux_scan_ulong(s, eol, &cols[i_col])) != NULL; ++i_col)
+            ; /* nothing but loop */
+        line = eol;
+        if (i_col <= CPU_LINUX_IDLE) {
+            continue ;
+        }
 
-            if (n <= priv->cpu_data.nb_cpus) {
-                const char * token, * next = line;
-                ssize_t tok_len;
-                size_t maxlen = linesz;
-                unsigned int tok_idx = 0;
-                unsigned long user = 0, sys = 0, activity = 0, total = 0;
-                cpu_data_t * data = &priv->cpu_data;
-
-                while ((tok_len = strtok_ro_r(&token, " \t", &next, &maxlen, 0)) >= 0 && *next) {
-                    if (tok_len == 0) {
-                        continue ;
-                    } else if (tok_idx == 1) { /* user */
-                        user = strtoul(token, NULL, 0);
-                    } else if (tok_idx == 2) { /* nice */
-                        user += strtoul(token, NULL, 0);
-                    } else if (tok_idx == 3) { /* sys */
-                        sys = strtoul(token, NULL, 0);
-                    } else if (tok_idx == 4) { /* idle */
-                        activity =
-                            + user
-                            + sys;
-
-                        total = strtoul(token, NULL, 0)
-                            + activity;
-
-                        if (n == 0) {
-                            user /= data->nb_cpus;
-                            sys /= data->nb_cpus;
-                            activity /= data->nb_cpus;
-                            total /= data->nb_cpus;
-                        }
-
-                        cpu_store_ticks(family, n, sys, user, activity, total, elapsed);
-
-                        LOG_DEBUG(family->log,
-                            "CPU%lu %u%% (usr:%u sys:%u)",
-                            n,
-                            data->ticks[n].activity_percent,
-                            data->ticks[n].user_percent,
-                            data->ticks[n].sys_percent);
-
-                        break ;
-                    }
-                    ++tok_idx;
-                }
-            }
+        user = cols[CPU_LINUX_USER] + cols[CPU_LINUX_NICE];
+        sys = cols[CPU_LINUX_SYS];
+        activity = user + sys + cols[CPU_LINUX_IRQ] + cols[CPU_LINUX_SOFTIRQ]
+                   + cols[CPU_LINUX_STEAL];
+        total = activity + cols[CPU_LINUX_IDLE] + cols[CPU_LINUX_IOWAIT];
+
+        classes[CPU_TICK_NICE]          = cols[CPU_LINUX_NICE];
+        classes[CPU_TICK_IOWAIT]        = cols[CPU_LINUX_IOWAIT];
+        classes[CPU_TICK_IRQ]           = cols[CPU_LINUX_IRQ];
+        classes[CPU_TICK_SOFTIRQ]       = cols[CPU_LINUX_SOFTIRQ];
+        classes[CPU_TICK_STEAL]         = cols[CPU_LINUX_STEAL];
+        classes[CPU_TICK_GUEST]         = cols[CPU_LINUX_GUEST];
+        classes[CPU_TICK_GUEST_NICE]    = cols[CPU_LINUX_GUEST_NICE];
+
+        if (n == 0) {
+            user /= data->nb_cpus;
+            sys /= data->nb_cpus;
+            activity /= data->nb_cpus;
+            total /= data->nb_cpus;
+            for (i_col = 0; i_col < CPU_TICK_NB; ++i_col)
+                classes[i_col] /= data->nb_cpus;
         }
+
+        cpu_store_ticks_classes(family, n, classes, elapsed);
+        cpu_store_ticks(family, n, sys, user, activity, total, elapsed);
+        if (priv->extras != CPU_EXTRA_NONE)
+            cpu_linux_read_extras(family, sysdep, n);
+
+        LOG_DEBUG(family->log,
+            "CPU%lu %u%% (usr:%u sys:%u iowait:%u steal:%u)",
+            n,
+            data->ticks[n].activity_percent,
+            data->ticks[n].user_percent,
+            data->ticks[n].sys_percent,
+            data->ticks[n].iowait_percent,
+            data->ticks[n].steal_percent);
     }
+    cpu_store_groups(family, elapsed);
+
     return SENSOR_SUCCESS;
 }
-
@@ -31,10 +31,12 @@
 #include <time.h>
 #include <ctype.h>
 #include <fnmatch.h>
+#include <limits.h>
 
 #include "vlib/util.h"
 
 #include "disk_private.h"
+#include "sensor_private.h"
 
 /* ************************************************************************ */
 #define DISK_UDEV_SUBSYSTEM     "block"
@@ -48,24 +50,77 @@
 #endif
 #define SYS_BLOCK_STAT_FILE     "stat"
 #define SYS_BLOCK_SECTORSZ_FILE "queue/hw_sector_size"
+#define SYS_BLOCK_DEV_FILE      "dev"
+
+#ifndef DISK_LINUX_BUFSZ_MIN
+#define DISK_LINUX_BUFSZ_MIN    16384
+#endif
+
+/** device number as in /proc/diskstats major:minor, 0 if unknown */
+#define DISK_LINUX_DEVNO(major, minor)  (((unsigned long) (major) << 20) | (minor))
+
+/** columns of /proc/diskstats after major, minor and name */
+enum {
+    DISK_LINUX_READS = 0,
+    DISK_LINUX_READS_MERGED,
+    DISK_LINUX_READ_SECTORS,
+    DISK_LINUX_READ_MS,
+    DISK_LINUX_WRITES,
+    DISK_LINUX_WRITES_MERGED,
+    DISK_LINUX_WRITE_SECTORS,
+    DISK_LINUX_WRITE_MS,
+    DISK_LINUX_INFLIGHT,
+    DISK_LINUX_IO_MS,
+    DISK_LINUX_WEIGHTED_MS,
+    DISK_LINUX_NB
+};
+
+typedef struct diskstat_s diskstat_t;
+
+/** udev event of a disk waiting to be applied, only the last action of a device is kept */
+typedef struct {
+    char            name[DISK_NAME_SZ];
+    int             action;
+} disk_linux_event_t;
 
 typedef struct {
-    char *      stat_line;
-    size_t      stat_linesz;
-    slist_t *   disks; //<diskstat_t *>  
+    char *          stat_line;
+    size_t          stat_linesz;
+    slist_t *       disks; //<diskstat_t *>
+    /* single pass on /proc/diskstats, fd is -1 if per-disk stat files are used */
+    int             stat_fd;
+    sensor_provider_t * provider;   /* reads of stat_fd shared with other contexts */
+    char *          buf;
+    size_t          bufsz;
+    /* disks indexed by devno and by name: open addressing, size is a power of 2 */
+    diskstat_t **   index;
+    diskstat_t **   names;
+    unsigned int    index_size;
+    int             reindex;
+    /* removed disks are kept with their device slot until the next reload */
+    unsigned int    nb_removed;
+    /* udev events coalesced by device during sensor_common_queue_process() */
+    disk_linux_event_t * events;
+    unsigned int    nb_events;
+    unsigned int    events_size;
 } sysdep_t;
 
 typedef enum {
     DSF_NONE        = 0,
     DSF_REMOVABLE   = 1 << 0,
+    DSF_REMOVED     = 1 << 1,
 } diskstat_flag_t;
 
-typedef struct {
+struct diskstat_s {
     char *          name;
     FILE *          stat;
     unsigned int    sector_sz;
     unsigned int    flags;
-} diskstat_t;
+    unsigned long   devno;
+    /* slot in priv->devices, valid only if dev_gen is priv->devices_gen */
+    unsigned int    dev_idx;
+    unsigned int    dev_gen;
+};
 
 // sysdeps/common-linux.c
 sensor_status_t linux_common_udev_monitor_update(
@@ -96,11 +151,31 @@ static void disk_free(void * vd) {
     }
 }
 
-static sensor_status_t disk_linux_check_stat_file(diskstat_t * disk, sensor_family_t * family) {
+/** read the sector size of a /sys/block disk, 1 if unknown */
+static void disk_linux_read_sector_size(diskstat_t * disk, sensor_family_t * family) {
     disk_priv_t *   priv = (family->priv);
     sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    char            path[PATH_MAX];
+    FILE *          fsector_sz;
     ssize_t         linesz;
-    
+
+    snprintf(path, sizeof(path), "%s%s/%s/%s",
+             sensor_sysroot(family), SYS_BLOCK_DIR, disk->name, SYS_BLOCK_SECTORSZ_FILE);
+
+    disk->sector_sz = 1;
+    if ((fsector_sz = fopen(path, "r")) != NULL) {
+        if ((linesz = getline(&sysdep->stat_line, &sysdep->stat_linesz, fsector_sz)) > 0) {
+            if (sysdep->stat_line[linesz] == '\n')
+                sysdep->stat_line[linesz-1] = 0;
+            disk->sector_sz = strtol(sysdep->stat_line, NULL, 10);
+        }
+        fclose(fsector_sz);
+    }
+}
+
+static sensor_status_t disk_linux_check_stat_file(diskstat_t * disk, sensor_family_t * family) {
+    char path[PATH_MAX];
+
     if (disk->stat != NULL && fseek(disk->stat, 0, SEEK_SET) == 0) {
         return SENSOR_SUCCESS;
     }
@@ -108,38 +183,22 @@ static sensor_status_t disk_linux_check_stat_file(diskstat_t * disk, sensor_fami
         fclose(disk->stat);
     if (disk->name == NULL) {
         // open the generic /proc/diskstats
-        disk->stat = fopen(DISK_STAT_FILE, "r");
+        snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), DISK_STAT_FILE);
+        disk->stat = fopen(path, "r");
         disk->sector_sz = 1;
     } else {
-        // use per disk /sys/block/<disk>/{stat,hw_sector_size}
-        char path[PATH_MAX];
-        FILE * fsector_sz;
-            
-        snprintf(path, sizeof(path), "%s/%s/%s", 
-                 SYS_BLOCK_DIR, disk->name, SYS_BLOCK_STAT_FILE);
-                      
+        // use per disk /sys/block/<disk>/stat, sector size was read by disk_linux_add_device()
+        snprintf(path, sizeof(path), "%s%s/%s/%s",
+                 sensor_sysroot(family), SYS_BLOCK_DIR, disk->name, SYS_BLOCK_STAT_FILE);
+
         disk->stat = fopen(path, "r");
-               
-        snprintf(path, sizeof(path), "%s/%s/%s", 
-                 SYS_BLOCK_DIR, disk->name, SYS_BLOCK_SECTORSZ_FILE);
-                         
-        if ((fsector_sz = fopen(path, "r")) != NULL) {
-            if ((linesz = getline(&sysdep->stat_line, &sysdep->stat_linesz, fsector_sz)) > 0) {
-                if (sysdep->stat_line[linesz] == '\n')
-                    sysdep->stat_line[linesz-1] = 0;
-                disk->sector_sz = strtol(sysdep->stat_line, NULL, 10);
-            }
-            fclose(fsector_sz);
-        } else {
-            disk->sector_sz = 1;
-        }                
     }
-    
+
     if (disk->stat == NULL) {
         LOG_VERBOSE(family->log, "cannot open stat file %s", disk->name ? disk->name : DISK_STAT_FILE);
         return SENSOR_ERROR;
     }
-    
+
     LOG_VERBOSE(family->log, "%s/%s openned, sector size: %u",
                 disk->name ? SYS_BLOCK_DIR : DISK_STAT_FILE, disk->name ? disk->name : "",
                 disk->sector_sz);
@@ -147,16 +206,216 @@ static sensor_status_t disk_linux_check_stat_file(diskstat_t * disk, sensor_fami
     return SENSOR_SUCCESS;
 }
 
+/** scan an unsigned decimal after blanks, NULL if there is none before eol */
+static inline const char * disk_linux_scan_ulong(const char * s, const char * eol,
+                                                 unsigned long * value) {
+    unsigned long v = 0;
+
+    while (s < eol && (*s == ' ' || *s == '\t'))
+        ++s;
+    if (s >= eol || (unsigned char) (*s - '0') > 9)
+        return NULL;
+    do {
+        v = v * 10 + (*s - '0');
+    } while (++s < eol && (unsigned char) (*s - '0') <= 9);
+    *value = v;
+    return s;
+}
+
+static inline unsigned int disk_linux_hash(unsigned long devno, unsigned int size) {
+    return ((unsigned int) (devno ^ (devno >> 16)) * 2654435761U) & (size - 1);
+}
+
+static inline unsigned int disk_linux_name_hash(const char * name, unsigned int size) {
+    uint32_t hash = 2166136261U;
+
+    while (*name) {
+        hash ^= (unsigned char) *(name++);
+        hash *= 16777619U;
+    }
+    return hash & (size - 1);
+}
+
+/** (re)build the devno and name indexes of disks, done after disks were added,
+ * or when the major:minor of a disk changed */
+static sensor_status_t disk_linux_index(sensor_family_t * family) {
+    disk_priv_t *   priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    unsigned int    size = 16, n = slist_length(sysdep->disks);
+
+    sysdep->reindex = 0;
+    while (size < n * 2)
+        size *= 2;
+    if (size != sysdep->index_size) {
+        if (sysdep->index != NULL)
+            free(sysdep->index);
+        if (sysdep->names != NULL)
+            free(sysdep->names);
+        sysdep->names = NULL;
+        if ((sysdep->index = malloc(size * sizeof(*sysdep->index))) == NULL
+        ||  (sysdep->names = malloc(size * sizeof(*sysdep->names))) == NULL) {
+            LOG_ERROR(family->log, "cannot allocate disk index: %s", strerror(errno));
+            if (sysdep->index != NULL)
+                free(sysdep->index);
+            sysdep->index = NULL;
+            sysdep->index_size = 0;
+            sysdep->reindex = 1;
+            return SENSOR_ERROR;
+        }
+        sysdep->index_size = size;
+    }
+    memset(sysdep->index, 0, size * sizeof(*sysdep->index));
+    memset(sysdep->names, 0, size * sizeof(*sysdep->names));
+
+    SLISTC_FOREACH_PDATA(sysdep->disks, disk, diskstat_t *) {
+        unsigned int h;
+
+        if (disk->name != NULL) {
+            for (h = disk_linux_name_hash(disk->name, size); sysdep->names[h] != NULL; h = (h + 1) & (size - 1))
+                ; /* nothing but loop */
+            sysdep->names[h] = disk;
+        }
+        if (disk->devno == 0)
+            continue ;
+        for (h = disk_linux_hash(disk->devno, size); sysdep->index[h] != NULL; h = (h + 1) & (size - 1))
+            ; /* nothing but loop */
+        sysdep->index[h] = disk;
+    }
+    return SENSOR_SUCCESS;
+}
+
+/** disk of a devno, removed disks are ignored */
+static inline diskstat_t * disk_linux_lookup(sysdep_t * sysdep, unsigned long devno) {
+    unsigned int h;
+
+    if (sysdep->index == NULL)
+        return NULL;
+    for (h = disk_linux_hash(devno, sysdep->index_size); sysdep->index[h] != NULL;
+         h = (h + 1) & (sysdep->index_size - 1)) {
+        if (sysdep->index[h]->devno == devno && (sysdep->index[h]->flags & DSF_REMOVED) == 0)
+            return sysdep->index[h];
+    }
+    return NULL;
+}
+
+/** disk of a name, including removed ones */
+static diskstat_t * disk_linux_lookup_name(sysdep_t * sysdep, const char * name) {
+    unsigned int h;
+
+    if (sysdep->names == NULL) {
+        SLISTC_FOREACH_PDATA(sysdep->disks, disk, diskstat_t *) {
+            if (disk->name != NULL && strcmp(disk->name, name) == 0)
+                return disk;
+        }
+        return NULL;
+    }
+    for (h = disk_linux_name_hash(name, sysdep->index_size); sysdep->names[h] != NULL;
+         h = (h + 1) & (sysdep->index_size - 1)) {
+        if (strcmp(sysdep->names[h]->name, name) == 0)
+            return sysdep->names[h];
+    }
+    return NULL;
+}
+
+/** device of a disk in the current priv->devices or in the pending set,
+ * NULL if not listed yet */
+static inline disk_device_t * disk_linux_device(disk_priv_t * priv, diskstat_t * disk) {
+    if (disk->dev_gen == priv->devices_gen && disk->dev_idx < priv->nb_devices)
+        return priv->devices[disk->dev_idx];
+    if (disk->dev_gen == priv->devices_gen + 1 && priv->devices_next != NULL
+    &&  disk->dev_idx < priv->nb_devices_next)
+        return priv->devices_next[disk->dev_idx];
+    return NULL;
+}
+
+/** give the family a new set of devices, the one of named disks, keeping the
+ * devices already known with their state and descs. Removed disks are dropped here,
+ * and the indexes are rebuilt. Returns SENSOR_RELOAD_FAMILY on success. */
+static sensor_status_t disk_linux_update_devices(sensor_family_t * family) {
+    disk_priv_t *       priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    disk_device_t **    devices;
+    unsigned int        n = 0;
+
+    while (sysdep->nb_removed > 0) {
+        diskstat_t * removed = NULL;
+
+        SLISTC_FOREACH_PDATA(sysdep->disks, disk, diskstat_t *) {
+            if ((disk->flags & DSF_REMOVED) != 0) {
+                removed = disk;
+                break ;
+            }
+        }
+        if (removed == NULL)
+            break ;
+        LOG_VERBOSE(family->log, "dropped block %s", removed->name);
+        sysdep->disks = slist_remove_sized(sysdep->disks, removed, disk_cmp, disk_free);
+        --(sysdep->nb_removed);
+    }
+    sysdep->nb_removed = 0;
+    disk_linux_index(family);
+
+    if ((devices = calloc(slist_length(sysdep->disks) + 1, sizeof(*devices))) == NULL) {
+        LOG_ERROR(family->log, "cannot allocate %s devices: %s", family->info->name, strerror(errno));
+        return SENSOR_ERROR;
+    }
+    SLISTC_FOREACH_PDATA(sysdep->disks, disk, diskstat_t *) {
+        if (disk->name == NULL)
+            continue ;
+        if ((devices[n] = disk_linux_device(priv, disk)) == NULL
+        &&  (devices[n] = calloc(1, sizeof(**devices))) == NULL) {
+            LOG_ERROR(family->log, "cannot allocate %s device: %s",
+                      family->info->name, strerror(errno));
+            disk->dev_idx = UINT_MAX;
+            continue ;
+        }
+        if (devices[n]->name[0] == 0)
+            str0cpy(devices[n]->name, disk->name, sizeof(devices[n]->name));
+        disk->dev_idx = n++;
+        disk->dev_gen = priv->devices_gen + 1;
+    }
+
+    disk_devices_set_next(priv, devices, n);
+    LOG_VERBOSE(family->log, "%u %s devices", n, family->info->name);
+
+    return SENSOR_RELOAD_FAMILY;
+}
+
+/** read major:minor and sector size of a /sys/block disk */
+static void disk_linux_read_devno(diskstat_t * disk, sensor_family_t * family) {
+    char            path[PATH_MAX];
+    FILE *          file;
+
+    // get major:minor, to find the disk in /proc/diskstats
+    disk->devno = 0;
+    snprintf(path, sizeof(path), "%s%s/%s/%s",
+             sensor_sysroot(family), SYS_BLOCK_DIR, disk->name, SYS_BLOCK_DEV_FILE);
+    if ((file = fopen(path, "r")) != NULL) {
+        char            buf[64];
+        size_t          n;
+        unsigned long   major, minor;
+        const char *    next;
+
+        if ((n = fread(buf, 1, sizeof(buf), file)) > 0
+        &&  (next = disk_linux_scan_ulong(buf, buf + n, &major)) != NULL && *next == ':'
+        &&  disk_linux_scan_ulong(next + 1, buf + n, &minor) != NULL) {
+            disk->devno = DISK_LINUX_DEVNO(major, minor);
+        }
+        fclose(file);
+    }
+    disk_linux_read_sector_size(disk, family);
+}
+
 static sensor_status_t disk_linux_add_device(sensor_family_t * family, const char * name) {
     char            path[PATH_MAX];
     disk_priv_t *   priv = (family->priv);
     sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
     struct stat     st;
     diskstat_t      disk;
-    FILE *          fremovable;
+    FILE *          file;
     
     // older linux 2.6 have ramXX under /sys/block without subdir 'device' -> ignore them.
-    snprintf(path, sizeof(path), "%s/%s/device", SYS_BLOCK_DIR, name);
+    snprintf(path, sizeof(path), "%s%s/%s/device", sensor_sysroot(family), SYS_BLOCK_DIR, name);
     if (stat(path, &st) < 0 || ((st.st_mode & S_IFMT) & (S_IFLNK | S_IFDIR)) == 0) {
         return SENSOR_NOT_SUPPORTED;
     }
@@ -164,34 +423,46 @@ static sensor_status_t disk_linux_add_device(sensor_family_t * family, const cha
     disk.stat = NULL;
     disk.name = strdup(name);
     disk.flags = 0;
+    disk.devno = 0;
+    disk.sector_sz = 1;
+    disk.dev_idx = 0;
+    disk.dev_gen = 0;
     
     // check whether the device is removable
-    snprintf(path, sizeof(path), "%s/%s/removable", SYS_BLOCK_DIR, name);
-    if ((fremovable = fopen(path, "r")) != NULL) {
+    snprintf(path, sizeof(path), "%s%s/%s/removable", sensor_sysroot(family), SYS_BLOCK_DIR, name);
+    if ((file = fopen(path, "r")) != NULL) {
         char buf[64];
-        if (fread(buf, 1, sizeof(buf), fremovable) > 0) {
+        if (fread(buf, 1, sizeof(buf), file) > 0) {
             int bremovable = strtol(buf, NULL, 10);
             if (bremovable) {
                 disk.flags |= DSF_REMOVABLE;
             }
         }
-        fclose(fremovable);
-    }           
-    
+        fclose(file);
+    }
+
+    if (disk.name != NULL) {
+        disk_linux_read_devno(&disk, family);
+    }
+
     if (disk.name != NULL && (sysdep->disks = slist_prepend_sized(sysdep->disks, &disk, sizeof(disk))) == NULL) {
         LOG_ERROR(family->log, "cannot alloc list for '%s': %s", name, strerror(errno));
         if (disk.name != NULL)
            free(disk.name);
         return SENSOR_ERROR;
     }
+    sysdep->reindex = 1;
     
     return SENSOR_SUCCESS;
 }
 
+/** udev event callback: events are only recorded, merged with previous events
+ * of the same device, they are applied by disk_linux_apply_events() */
 static sensor_status_t disk_linux_handle_event(sensor_common_event_t * event, void * user_data) {
     sensor_family_t *   family = (sensor_family_t *) user_data;
     disk_priv_t *       priv = (family->priv);
     sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    unsigned int        i;
     
     // Only block disk devices are processed. Others (including partitions) are ignored.
     // Please ensure that the call to linux_common_udev_monitor_update() in
@@ -209,27 +480,102 @@ static sensor_status_t disk_linux_handle_event(sensor_common_event_t * event, vo
     LOG_DEBUG(family->log, "queue: processing device %s event: %s (%s)",
               event->u.dev.action == CDA_ADD ? "add" : "remove", event->u.dev.name, event->u.dev.type);
 
-    if (event->u.dev.action == CDA_ADD) {
-        char        path[PATH_MAX];
-        struct stat st;
+    if ((event->u.dev.action != CDA_ADD && event->u.dev.action != CDA_REMOVE)
+    ||  strlen(diskname) >= DISK_NAME_SZ) {
+        return SENSOR_SUCCESS;
+    }
+    for (i = 0; i < sysdep->nb_events; ++i) {
+        if (strcmp(sysdep->events[i].name, diskname) == 0)
+            break ;
+    }
+    if (i == sysdep->nb_events) {
+        if (sysdep->nb_events == sysdep->events_size) {
+            unsigned int            size = sysdep->events_size ? sysdep->events_size * 2 : 8;
+            disk_linux_event_t *    events;
+
+            if ((events = realloc(sysdep->events, size * sizeof(*events))) == NULL) {
+                LOG_ERROR(family->log, "cannot allocate %s events: %s", family->info->name, strerror(errno));
+                return SENSOR_ERROR;
+            }
+            sysdep->events = events;
+            sysdep->events_size = size;
+        }
+        str0cpy(sysdep->events[i].name, diskname, sizeof(sysdep->events[i].name));
+        ++(sysdep->nb_events);
+    }
+    sysdep->events[i].action = event->u.dev.action;
+    
+    return SENSOR_SUCCESS;
+}
+
+/** the device slot of a removed disk stops: no more rates and nothing in flight */
+static void disk_linux_device_stop(disk_device_t * dev) {
+    for (unsigned int i = 0; i < DISK_RATE_NB; ++i)
+        sensor_rate_reset(&(dev->rates[i]));
+    dev->inflight = 0;
+    dev->read_iops = dev->write_iops = 0;
+    dev->read_latency = dev->write_latency = 0.0;
+    dev->utilization = 0;
+    dev->queue_depth = 0.0;
+}
+
+/** apply the coalesced udev events. A removed disk keeps its sensors until the
+ * next reload and gets them back if it comes again, only new disks need a
+ * reload: SENSOR_RELOAD_FAMILY is returned in this case */
+static sensor_status_t disk_linux_apply_events(sensor_family_t * family) {
+    disk_priv_t *   priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    int             reload = 0;
+
+    for (unsigned int i = 0; i < sysdep->nb_events; ++i) {
+        const char *    diskname = sysdep->events[i].name;
+        diskstat_t *    disk = disk_linux_lookup_name(sysdep, diskname);
+        disk_device_t * dev;
+
+        if (sysdep->events[i].action == CDA_REMOVE) {
+            if (disk == NULL || (disk->flags & DSF_REMOVED) != 0)
+                continue ;
+            disk->flags |= DSF_REMOVED;
+            ++(sysdep->nb_removed);
+            if (disk->stat != NULL)
+                fclose(disk->stat);
+            disk->stat = NULL;
+            if ((dev = disk_linux_device(priv, disk)) != NULL)
+                disk_linux_device_stop(dev);
+            LOG_VERBOSE(family->log, "removed block %s", diskname);
+        } else if (disk != NULL) {
+            unsigned long devno = disk->devno;
+
+            /* known disk coming again: same sensors, maybe another major:minor.
+             * An active disk can also have been removed and added in the same burst */
+            if ((disk->flags & DSF_REMOVED) != 0) {
+                disk->flags &= ~DSF_REMOVED;
+                --(sysdep->nb_removed);
+            }
+            disk_linux_read_devno(disk, family);
+            if (disk->devno != devno)
+                sysdep->reindex = 1;
+            LOG_VERBOSE(family->log, "added again block %s", diskname);
+        } else {
+            char        path[PATH_MAX];
+            struct stat st;
 
-        snprintf(path, sizeof(path), "%s/%s", SYS_BLOCK_DIR, diskname);
-        if (stat(path, &st) == 0 && ((st.st_mode & S_IFMT) & (S_IFLNK | S_IFDIR)) != 0) {
-            if (disk_linux_add_device(family, diskname) == SENSOR_SUCCESS) {
+            snprintf(path, sizeof(path), "%s%s/%s", sensor_sysroot(family), SYS_BLOCK_DIR, diskname);
+            if (stat(path, &st) == 0 && ((st.st_mode & S_IFMT) & (S_IFLNK | S_IFDIR)) != 0
+            &&  disk_linux_add_device(family, diskname) == SENSOR_SUCCESS) {
                 LOG_VERBOSE(family->log, "added block %s", diskname);
+                reload = 1;
             }
         }
-    } else if (event->u.dev.action == CDA_REMOVE) {
-        diskstat_t disk;
-            
-        disk.stat = NULL;
-        disk.name = (char *) diskname;
-        errno = 0;
-        sysdep->disks = slist_remove_sized(sysdep->disks, &disk, disk_cmp, disk_free);
-        if (errno == 0)
-            LOG_VERBOSE(family->log, "removed block %s", disk.name);
     }
-    
+    sysdep->nb_events = 0;
+
+    if (reload) {
+        return disk_linux_update_devices(family);
+    }
+    if (sysdep->reindex) {
+        disk_linux_index(family);
+    }
     return SENSOR_SUCCESS;
 }
 
@@ -251,6 +597,7 @@ sensor_status_t sysdep_disk_init(sensor_family_t * family) {
     sysdep_t *      sysdep;
     int             fd = -1;
     DIR *           dir;
+    char            path[PATH_MAX];
         
     priv->sysdep = calloc(1, sizeof(sysdep_t));
     if (priv->sysdep == NULL) {
@@ -262,11 +609,15 @@ sensor_status_t sysdep_disk_init(sensor_family_t * family) {
     sysdep = priv->sysdep;
     sysdep->stat_line = NULL;
     sysdep->stat_linesz = 0;
+    sysdep->stat_fd = -1;
 
-    if ((dir = opendir(SYS_BLOCK_DIR)) != NULL) {
+    snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), SYS_BLOCK_DIR);
+    if ((dir = opendir(path)) != NULL) {
         struct dirent * dirent;
 
-        if (linux_common_udev_monitor_update(
+        /* no udev events for the disks of sensor_init_sysroot() */
+        if (*sensor_sysroot(family) == 0
+        &&  linux_common_udev_monitor_update(
                 sensor_family_common(family->sctx), 
                 DISK_UDEV_SUBSYSTEM, 
                 DISK_UDEV_DEVTYPE, 
@@ -284,8 +635,25 @@ sensor_status_t sysdep_disk_init(sensor_family_t * family) {
             }
         }
         closedir(dir);
+        /* builds the first index */
+        disk_linux_update_devices(family);
+
+        // read all disks at once in /proc/diskstats if possible, otherwise use /sys/block/<disk>/stat
+        snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), DISK_STAT_FILE);
+        if ((sysdep->stat_fd = open(path, O_RDONLY | O_CLOEXEC)) < 0
+        ||  (sysdep->buf = malloc(DISK_LINUX_BUFSZ_MIN)) == NULL
+        ||  sysdep->index == NULL) {
+            LOG_VERBOSE(family->log, "cannot use %s, reading %s/<disk>/%s",
+                        DISK_STAT_FILE, SYS_BLOCK_DIR, SYS_BLOCK_STAT_FILE);
+            if (sysdep->stat_fd >= 0)
+                close(sysdep->stat_fd);
+            sysdep->stat_fd = -1;
+        } else {
+            sysdep->bufsz = DISK_LINUX_BUFSZ_MIN;
+            sysdep->provider = sensor_provider_get(path);
+        }
     } else {            
-        diskstat_t disk = { .name = NULL, .stat = NULL, .flags = 0 };
+        diskstat_t disk = { .name = NULL, .stat = NULL, .flags = 0, .dev_gen = 0 };
         
         if ((sysdep->disks = slist_prepend_sized(sysdep->disks, &disk, sizeof(disk))) == NULL) {
             LOG_ERROR(family->log, "error while openning %s", DISK_STAT_FILE);
@@ -309,6 +677,18 @@ sensor_status_t sysdep_disk_destroy(sensor_family_t * family) {
 
         slist_free_sized(sysdep->disks, disk_free);
         sysdep->disks = NULL;
+
+        if (sysdep->stat_fd >= 0)
+            close(sysdep->stat_fd);
+        sensor_provider_release(sysdep->provider);
+        if (sysdep->buf != NULL)
+            free(sysdep->buf);
+        if (sysdep->index != NULL)
+            free(sysdep->index);
+        if (sysdep->names != NULL)
+            free(sysdep->names);
+        if (sysdep->events != NULL)
+            free(sysdep->events);
         
         if (sysdep->stat_line != NULL)
             free(sysdep->stat_line);
@@ -321,32 +701,122 @@ sensor_status_t sysdep_disk_destroy(sensor_family_t * family) {
 }
 
 /* ************************************************************************ */
-sensor_status_t     sysdep_disk_get(
-                        sensor_family_t *   family,
-                        disk_data_t *       data,
-                        struct timeval *    elapsed) {
-    disk_priv_t *   priv = (family->priv);
-    sysdep_t *      sysdep = priv->sysdep;
-    ssize_t  linesz;
-    uint64_t total_ibytes = 0;
-    uint64_t total_obytes = 0;
-    uint64_t phy_ibytes = 0;
-    uint64_t phy_obytes = 0;
+/** read the whole /proc/diskstats in the reusable buffer */
+static ssize_t disk_linux_read(sensor_family_t * family, sysdep_t * sysdep) {
+    ssize_t n;
 
-    if (priv->sysdep == NULL) {
-        LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
-        errno = EFAULT;
+    while (1) {
+        char * buf;
+
+        if ((n = sensor_provider_pread(sysdep->provider, family,
+                                       sysdep->stat_fd, sysdep->buf, sysdep->bufsz)) < 0) {
+            LOG_ERROR(family->log, "error while reading %s: %s", DISK_STAT_FILE, strerror(errno));
+            return -1;
+        }
+        if ((size_t) n < sysdep->bufsz) {
+            return n;
+        }
+        if ((buf = realloc(sysdep->buf, sysdep->bufsz * 2)) == NULL) {
+            LOG_ERROR(family->log, "error, cannot grow %s buffer", DISK_STAT_FILE);
+            return -1;
+        }
+        sysdep->buf = buf;
+        sysdep->bufsz *= 2;
+    }
+}
+
+/* ************************************************************************ */
+/** single pass on /proc/diskstats, lines are given to disks by major:minor */
+static sensor_status_t disk_linux_diskstats_get(
+                        sensor_family_t *   family,
+                        disk_priv_t *       priv,
+                        sysdep_t *          sysdep,
+                        uint64_t *          total_ibytes,
+                        uint64_t *          total_obytes,
+                        uint64_t *          phy_ibytes,
+                        uint64_t *          phy_obytes) {
+    const char *    line, * eol, * end;
+    ssize_t         n;
+
+    if (sysdep->index == NULL || (n = disk_linux_read(family, sysdep)) < 0) {
         return SENSOR_ERROR;
     }
 
-    sensor_common_queue_process(family->sctx, disk_linux_handle_event, family);
-    
+    /* /proc/diskstats format: see disk_linux_stat_files_get() */
+    for (line = sysdep->buf, end = sysdep->buf + n; line < end; line = eol + 1) {
+        unsigned long   major, minor, values[DISK_LINUX_NB];
+        const char *    s;
+        diskstat_t *    disk;
+        disk_device_t * dev;
+        unsigned int    i;
+        uint64_t        ibytes, obytes;
+
+        if ((eol = memchr(line, '\n', end - line)) == NULL)
+            eol = end;
+        if ((s = disk_linux_scan_ulong(line, eol, &major)) == NULL
+        ||  (s = disk_linux_scan_ulong(s, eol, &minor)) == NULL
+        ||  (disk = disk_linux_lookup(sysdep, DISK_LINUX_DEVNO(major, minor))) == NULL) {
+            continue ; /* partitions and devices not in /sys/block */
+        }
+        /* skip device name */
+        while (s < eol && (*s == ' ' || *s == '\t'))
+            ++s;
+        while (s < eol && *s != ' ' && *s != '\t')
+            ++s;
+        for (i = 0; i < DISK_LINUX_NB && (s = disk_linux_scan_ulong(s, eol, &values[i])) != NULL; ++i)
+            ; /* nothing but loop */
+        if (i <= DISK_LINUX_WRITE_SECTORS)
+            continue ;
+
+        LOG_SCREAM(family->log, "%s %s (%lu:%lu) sectors read %lu written %lu",
+                   DISK_STAT_FILE, disk->name, major, minor,
+                   values[DISK_LINUX_READ_SECTORS], values[DISK_LINUX_WRITE_SECTORS]);
+
+        ibytes = (uint64_t) values[DISK_LINUX_READ_SECTORS] * disk->sector_sz;
+        obytes = (uint64_t) values[DISK_LINUX_WRITE_SECTORS] * disk->sector_sz;
+        *total_ibytes += ibytes;
+        *total_obytes += obytes;
+        if ((disk->flags & DSF_REMOVABLE) == 0) {
+            *phy_ibytes += ibytes;
+            *phy_obytes += obytes;
+        }
+
+        if ((dev = disk_linux_device(priv, disk)) != NULL && i > DISK_LINUX_WEIGHTED_MS) {
+            dev->counters[DISK_RATE_READS] = values[DISK_LINUX_READS];
+            dev->counters[DISK_RATE_WRITES] = values[DISK_LINUX_WRITES];
+            dev->counters[DISK_RATE_READ_MS] = values[DISK_LINUX_READ_MS];
+            dev->counters[DISK_RATE_WRITE_MS] = values[DISK_LINUX_WRITE_MS];
+            dev->counters[DISK_RATE_IO_MS] = values[DISK_LINUX_IO_MS];
+            dev->counters[DISK_RATE_WEIGHTED_MS] = values[DISK_LINUX_WEIGHTED_MS];
+            dev->inflight = values[DISK_LINUX_INFLIGHT];
+        }
+    }
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** read /proc/diskstats or each /sys/block/<disk>/stat with getline() */
+static sensor_status_t disk_linux_stat_files_get(
+                        sensor_family_t *   family,
+                        disk_priv_t *       priv,
+                        sysdep_t *          sysdep,
+                        uint64_t *          total_ibytes,
+                        uint64_t *          total_obytes,
+                        uint64_t *          phy_ibytes,
+                        uint64_t *          phy_obytes) {
+    ssize_t  linesz;
+
     SLISTC_FOREACH_PDATA(sysdep->disks, disk, diskstat_t *) {
-        
-        if (disk_linux_check_stat_file(disk, family) != SENSOR_SUCCESS) {
+        disk_device_t * dev = disk_linux_device(priv, disk);
+
+        if ((disk->flags & DSF_REMOVED) != 0
+        ||  disk_linux_check_stat_file(disk, family) != SENSOR_SUCCESS) {
             continue ;
         }
-        
+
+        /* one buffered read of the small stat file */
+        sensor_family_stats_reads(family, 1);
         while ((linesz = getline(&sysdep->stat_line, &sysdep->stat_linesz, disk->stat)) > 0) {
             char * line = sysdep->stat_line;
             const char * value, * next = line;
@@ -412,7 +882,9 @@ sensor_status_t     sysdep_disk_get(
                             loop = 0; // stop processing this line
                         break ;
                     case 3:
-                        /* # reads completed */                    
+                        /* # reads completed */
+                        if (dev != NULL)
+                            dev->counters[DISK_RATE_READS] = strtoul(value, NULL, 10);
                         break ;
                     case 4:
                         /* # reads merged */
@@ -420,15 +892,19 @@ sensor_status_t     sysdep_disk_get(
                     case 5:
                         /* # sectors read */
                         ibytes = strtoul(value, NULL, 10) * disk->sector_sz;                        
-                        total_ibytes += ibytes;
+                        *total_ibytes += ibytes;
                         if (phys)
-                            phy_ibytes += ibytes;
+                            *phy_ibytes += ibytes;
                         break ;
                     case 6:
                         /* # ms spent reading */
+                        if (dev != NULL)
+                            dev->counters[DISK_RATE_READ_MS] = strtoul(value, NULL, 10);
                         break ;
                     case 7:
                         /* # writes completed */
+                        if (dev != NULL)
+                            dev->counters[DISK_RATE_WRITES] = strtoul(value, NULL, 10);
                         break ;
                     case 8:
                         /* writes merged */
@@ -436,23 +912,29 @@ sensor_status_t     sysdep_disk_get(
                     case 9:
                         /* # sectors written */
                         obytes = strtoul(value, NULL, 10) * disk->sector_sz;
-                        total_obytes += obytes;
+                        *total_obytes += obytes;
                         if (phys)
-                            phy_obytes += obytes;
-                        // THIS IS THE LAST TOKEN WE ARE INTERESTED IN.
-                        loop = 0;
+                            *phy_obytes += obytes;
+                        // THIS IS THE LAST TOKEN WE ARE INTERESTED IN, unless device is listed.
+                        if (dev == NULL)
+                            loop = 0;
                         break ;
                     case 10:
                         /* # ms spent writing */
+                        dev->counters[DISK_RATE_WRITE_MS] = strtoul(value, NULL, 10);
                         break ;
                     case 11:
-                        /* # I/O in progress */                    
+                        /* # I/O in progress */
+                        dev->inflight = strtoul(value, NULL, 10);
                         break ;
                     case 12:
                         /* # ms spent doing I/O */
+                        dev->counters[DISK_RATE_IO_MS] = strtoul(value, NULL, 10);
                         break ;
                     case 13:
                         /* # ms weight spent doing I/O */
+                        dev->counters[DISK_RATE_WEIGHTED_MS] = strtoul(value, NULL, 10);
+                        loop = 0;
                         break ;
                     case 14:
                         /* # discarded */
@@ -482,27 +964,49 @@ sensor_status_t     sysdep_disk_get(
         }
     }
 
-    if (elapsed == NULL) {
-        data->ibytespersec = 0;
-        data->obytespersec = 0;
-        data->phy_ibytespersec = 0;
-        data->phy_obytespersec = 0;
-    } else {
-        data->ibytespersec = (((total_ibytes - data->ibytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->obytespersec = (((total_obytes - data->obytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_ibytespersec = (((phy_ibytes - data->phy_ibytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_obytespersec = (((phy_obytes - data->phy_obytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t     sysdep_disk_get(
+                        sensor_family_t *   family,
+                        disk_data_t *       data,
+                        struct timeval *    elapsed) {
+    disk_priv_t *   priv = (family->priv);
+    sysdep_t *      sysdep = priv->sysdep;
+    uint64_t total_ibytes = 0;
+    uint64_t total_obytes = 0;
+    uint64_t phy_ibytes = 0;
+    uint64_t phy_obytes = 0;
+    sensor_status_t ret = SENSOR_SUCCESS;
+
+    if (priv->sysdep == NULL) {
+        LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
+        errno = EFAULT;
+        return SENSOR_ERROR;
     }
 
+    sensor_common_queue_process(family->sctx, disk_linux_handle_event, family);
+    if (sysdep->nb_events > 0 || sysdep->reindex) {
+        /* new disks: their sensors are listed on reload */
+        if (disk_linux_apply_events(family) == SENSOR_RELOAD_FAMILY)
+            ret = SENSOR_RELOAD_FAMILY;
+    }
+
+    if (sysdep->stat_fd < 0
+    ||  disk_linux_diskstats_get(family, priv, sysdep, &total_ibytes, &total_obytes,
+                                 &phy_ibytes, &phy_obytes) != SENSOR_SUCCESS) {
+        disk_linux_stat_files_get(family, priv, sysdep, &total_ibytes, &total_obytes,
+                                  &phy_ibytes, &phy_obytes);
+    }
+
+    /* rates are computed by the family */
+    (void) elapsed;
     data->ibytes = total_ibytes;
     data->obytes = total_obytes;
     data->phy_ibytes = phy_ibytes;
     data->phy_obytes = phy_obytes;
 
-    return SENSOR_SUCCESS;
+    return ret;
 }
 
@@ -102,22 +102,8 @@ sensor_status_t sysdep_disk_get (sensor_family_t * family,
     }
 
     uint64_t phy_rbytes = total_rbytes, phy_wbytes = total_wbytes;
-    if (elapsed == NULL) {
-        data->ibytespersec = 0;
-        data->obytespersec = 0;
-        data->phy_ibytespersec = 0;
-        data->phy_obytespersec = 0;
-    } else {
-        data->ibytespersec = (((total_rbytes - data->ibytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->obytespersec = (((total_wbytes - data->obytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_ibytespersec = (((phy_rbytes - data->phy_ibytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_obytespersec = (((phy_wbytes - data->phy_obytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-    }
-
+    /* rates are computed by the family */
+    (void) elapsed;
     data->ibytes = total_rbytes;
     data->obytes = total_wbytes;
     data->phy_ibytes = phy_rbytes;
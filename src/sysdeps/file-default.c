@@ -65,3 +65,15 @@ sensor_status_t sysdep_file_watch_del(sensor_family_t * family, fileinfo_t * fil
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+ssize_t sysdep_file_read(sensor_family_t * family, fileinfo_t * file,
+                         void * buf, size_t size, uint64_t offset) {
+    (void)family;
+    (void)file;
+    (void)buf;
+    (void)size;
+    (void)offset;
+    errno = ENOSYS;
+    return -1;
+}
+
@@ -36,14 +36,25 @@
 #include "file_private.h"
 #include "common_private.h"
 
+#include <sys/stat.h>
+
 /* ************************************************************************ */
+/** events changing the values of a watched file */
+#define FILE_LINUX_IN_MASK      (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+/** events of the directory of a tail file, telling that its path was created again */
+#define FILE_LINUX_IN_DIR_MASK  (IN_CREATE | IN_MOVED_TO)
 
 typedef struct {    
     int         notify_ifd;    
+    int         registered;
 } sysdep_t;
 
 typedef struct {
-    int     ifd;
+    int             wd;
+    int             fd;
+    int             dir_wd; /* tail files: watch of the directory, for rotations */
+    const char *    base;   /* name of the file in its directory */
+    uint32_t        mask;   /* events coalesced since the last read */
 } sys_fileinfo_t;
 
 /* ************************************************************************ */
@@ -60,7 +71,7 @@ static sensor_status_t file_linux_notify_init(sensor_family_t * family) {
     sensor_family_t *   common = sensor_family_common(family->sctx);
     common_priv_t *     common_priv = common ? (common_priv_t *) common->priv : NULL;
     
-    if ((sysdep->notify_ifd = inotify_init1(IN_NONBLOCK)) < 0) {
+    if ((sysdep->notify_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
         LOG_WARN(family->log, "inotify_init1(): %s", strerror(errno));
         return SENSOR_ERROR;
     }
@@ -71,10 +82,69 @@ static sensor_status_t file_linux_notify_init(sensor_family_t * family) {
         LOG_WARN(family->log, "cannot register inotify events in common thread(): %s", strerror(errno));
         return SENSOR_ERROR;                              
     }
+    sysdep->registered = 1;
     
     return SENSOR_SUCCESS;
 }
 
+/** open a file and watch it, the previous watch is removed, under priv->mutex */
+static sensor_status_t file_linux_open(sensor_family_t * family, fileinfo_t * info) {
+    file_priv_t *       priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    sys_fileinfo_t *    sysinfo = (sys_fileinfo_t *) info->sysdep;
+    struct stat         st;
+    int                 fd;
+
+    /* the file stays opened to get its values with fstat() on events */
+    if ((fd = open(info->name, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0
+    ||  fstat(fd, &st) != 0) {
+        LOG_WARN(family->log, "cannot open %s: %s", info->name, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return SENSOR_ERROR;
+    }
+    if (sysinfo->fd >= 0)
+        close(sysinfo->fd);
+    sysinfo->fd = fd;
+    if (sysinfo->wd >= 0)
+        inotify_rm_watch(sysdep->notify_ifd, sysinfo->wd);
+    if ((sysinfo->wd = inotify_add_watch(sysdep->notify_ifd, info->name, FILE_LINUX_IN_MASK)) < 0) {
+        LOG_WARN(family->log, "inotify_add_watch(%s): %s", info->name, strerror(errno));
+        return SENSOR_ERROR;
+    }
+    info->size = st.st_size;
+    info->mtime = st.st_mtime;
+    info->ino = st.st_ino;
+
+    return SENSOR_SUCCESS;
+}
+
+/** get size and mtime of a file with its opened fd, under priv->mutex */
+static void file_linux_refresh(sensor_family_t * family, fileinfo_t * info) {
+    sys_fileinfo_t *    sysinfo = (sys_fileinfo_t *) info->sysdep;
+    struct stat         st;
+
+    if ((sysinfo->mask & FILE_LINUX_IN_DIR_MASK) != 0) {
+        /* the path was created again (rotation): follow it */
+        LOG_VERBOSE(family->log, "inotify: %s created", info->name);
+        file_linux_open(family, info);
+    } else if ((sysinfo->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0) {
+        /* the watched path is gone: values stay, no more events for it */
+        LOG_VERBOSE(family->log, "inotify: %s deleted or moved", info->name);
+        if (sysinfo->fd >= 0)
+            close(sysinfo->fd);
+        sysinfo->fd = -1;
+        sysinfo->wd = -1;
+    } else if (sysinfo->fd >= 0 && fstat(sysinfo->fd, &st) == 0) {
+        info->size = st.st_size;
+        info->mtime = st.st_mtime;
+    }
+    sysinfo->mask = 0;
+    __atomic_add_fetch(&(info->gen), 1, __ATOMIC_RELEASE);
+}
+
+/** read all pending inotify events, coalesced by file: a burst of writes
+ * on a file costs one fstat() */
 static sensor_status_t file_linux_notify_handle_events(sensor_family_t * family) {
     file_priv_t *   priv = (family->priv);
     sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
@@ -87,6 +157,10 @@ static sensor_status_t file_linux_notify_handle_events(sensor_family_t * family)
     char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
     const struct inotify_event *event;
     ssize_t len;
+    fileinfo_t * last = NULL;
+    unsigned int nb_changed = 0;
+
+    pthread_mutex_lock(&priv->mutex);
 
     /* Loop while events can be read from inotify file descriptor. */
     for (;;) {
@@ -97,7 +171,7 @@ static sensor_status_t file_linux_notify_handle_events(sensor_family_t * family)
                 continue ;
             } else if (errno != EAGAIN) {
                 LOG_WARN(family->log, "inotify read error: %s", strerror(errno));
-                return SENSOR_ERROR;
+                break ;
             }
         }
         /* if nonblocking read() found no events, we exit the loop. */
@@ -107,16 +181,64 @@ static sensor_status_t file_linux_notify_handle_events(sensor_family_t * family)
         /* Loop over all events in the buffer */
         for (char *ptr = buf; ptr < buf + len;
             ptr += sizeof(struct inotify_event) + event->len) {
+            sys_fileinfo_t * sysinfo;
 
             event = (const struct inotify_event *) ptr;
 
-            /* Print event type */
-            if (event->mask & IN_CREATE)
-                LOG_VERBOSE(family->log, "inotify IN_CREATE '%s'", event->name);
-            if (event->mask & IN_DELETE)
-                LOG_VERBOSE(family->log, "inotify IN_DELETE '%s'", event->name);
+            if ((event->mask & IN_Q_OVERFLOW) != 0) {
+                /* events were lost: refresh all files */
+                LOG_VERBOSE(family->log, "inotify queue overflow");
+                SLIST_FOREACH_DATA(priv->files, info, fileinfo_t *) {
+                    if ((sysinfo = (sys_fileinfo_t *) info->sysdep) != NULL && sysinfo->wd >= 0)
+                        sysinfo->mask |= IN_MODIFY;
+                }
+                nb_changed = 1;
+                continue ;
+            }
+            /* directory events of tail files */
+            if (event->len > 0) {
+                SLIST_FOREACH_DATA(priv->files, info, fileinfo_t *) {
+                    if ((sysinfo = (sys_fileinfo_t *) info->sysdep) != NULL
+                    &&  sysinfo->dir_wd == event->wd && (event->mask & FILE_LINUX_IN_DIR_MASK) != 0
+                    &&  strcmp(sysinfo->base, event->name) == 0) {
+                        sysinfo->mask |= event->mask;
+                        ++nb_changed;
+                    }
+                }
+                continue ;
+            }
+            /* consecutive events are usually for the same file */
+            if (last == NULL || ((sys_fileinfo_t *) last->sysdep)->wd != event->wd) {
+                last = NULL;
+                SLIST_FOREACH_DATA(priv->files, info, fileinfo_t *) {
+                    if ((sysinfo = (sys_fileinfo_t *) info->sysdep) != NULL && sysinfo->wd == event->wd) {
+                        last = info;
+                        break ;
+                    }
+                }
+                if (last == NULL)
+                    continue ;
+            }
+            ((sys_fileinfo_t *) last->sysdep)->mask |= event->mask;
+            ++nb_changed;
         }           
     }
+
+    if (nb_changed > 0) {
+        SLIST_FOREACH_DATA(priv->files, info, fileinfo_t *) {
+            sys_fileinfo_t * sysinfo = (sys_fileinfo_t *) info->sysdep;
+
+            if (sysinfo != NULL && sysinfo->mask != 0) {
+                file_linux_refresh(family, info);
+            }
+        }
+    }
+    pthread_mutex_unlock(&priv->mutex);
+
+    if (nb_changed > 0) {
+        LOG_SCREAM(family->log, "inotify: %u events", nb_changed);
+        sensor_family_signal(family);
+    }
     return SENSOR_SUCCESS;
 }
 
@@ -133,16 +255,22 @@ static int file_linux_thread_event_read(
 }
 
 static sensor_status_t file_linux_notify_destroy(sensor_family_t * family) {
-    file_priv_t *   priv = (family->priv);
-    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;    
+    file_priv_t *       priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;    
+    sensor_family_t *   common = sensor_family_common(family->sctx);
+    common_priv_t *     common_priv = common ? (common_priv_t *) common->priv : NULL;
+
+    if (sysdep->registered && common_priv != NULL) {
+        vthread_unregister_event(common_priv->thread, VTE_FD_READ, VTE_DATA_FD(sysdep->notify_ifd),
+                                 file_linux_thread_event_read, family);
+    }
+    sysdep->registered = 0;
     
     if (sysdep->notify_ifd >= 0)
         close(sysdep->notify_ifd);
             
     sysdep->notify_ifd = -1;
     
-    // TODO: unregister event in common thread
-    
     return SENSOR_SUCCESS;
 }
 
@@ -150,8 +278,7 @@ static sensor_status_t file_linux_notify_destroy(sensor_family_t * family) {
 sensor_status_t sysdep_file_support(sensor_family_t * family, const char * label) {
     (void)family;
     (void)label;
-    return SENSOR_NOT_SUPPORTED;
-    //return SENSOR_SUCCESS;
+    return SENSOR_SUCCESS;
 }
 
 /* ************************************************************************ */
@@ -183,6 +310,7 @@ sensor_status_t sysdep_file_init(sensor_family_t * family) {
         errno=ENOMEM;
         return SENSOR_ERROR;
     }    
+    ((sysdep_t *) priv->sysdep)->notify_ifd = -1;
                 
     if (file_linux_notify_init(family) != SENSOR_SUCCESS) {
         LOG_ERROR(family->log, "cannot initialize inotify");
@@ -193,17 +321,6 @@ sensor_status_t sysdep_file_init(sensor_family_t * family) {
     return SENSOR_SUCCESS;
 }
 
-/* ************************************************************************ */
-sensor_status_t     sysdep_file_get(
-                        sensor_family_t *   family,
-                        void *              data,
-                        struct timeval *    elapsed) {
-    (void)family;
-    (void)data;
-    (void)elapsed;
-    return SENSOR_ERROR;
-}
-
 /* ************************************************************************ */
 sensor_status_t sysdep_file_watch_add(sensor_family_t * family, fileinfo_t * info) {
     file_priv_t *   priv = (family->priv);
@@ -213,25 +330,76 @@ sensor_status_t sysdep_file_watch_add(sensor_family_t * family, fileinfo_t * inf
     if (sysinfo == NULL) {
         return SENSOR_ERROR;
     }
-    
-    if ((sysinfo->ifd = inotify_add_watch(sysdep->notify_ifd, 
-                                info->name, IN_CREATE | IN_DELETE /* FIXME info->flags */)) < 0) {
-        LOG_WARN(family->log, "inotify_add_watch(%s): %s", info->name, strerror(errno));
+    sysinfo->wd = sysinfo->fd = sysinfo->dir_wd = -1;
+    info->sysdep = sysinfo;
+
+    if (file_linux_open(family, info) != SENSOR_SUCCESS) {
         sysdep_file_watch_free(info);
         return SENSOR_ERROR;
     }
+    if ((info->flags & FF_TAIL) != 0) {
+        /* watch the directory to follow the path when it is rotated */
+        char *  dir;
+        char *  slash;
+
+        sysinfo->base = (slash = strrchr(info->name, '/')) != NULL ? slash + 1 : info->name;
+        if ((dir = strdup(slash == NULL ? "." : slash == info->name ? "/" : info->name)) != NULL) {
+            if (slash != NULL && slash != info->name)
+                dir[slash - info->name] = 0;
+            if ((sysinfo->dir_wd = inotify_add_watch(sysdep->notify_ifd, dir, FILE_LINUX_IN_DIR_MASK)) < 0)
+                LOG_WARN(family->log, "inotify_add_watch(%s): %s", dir, strerror(errno));
+            free(dir);
+        }
+    }
+    __atomic_store_n(&(info->gen), 1, __ATOMIC_RELEASE);
 
     return SENSOR_SUCCESS;
 }
 
+/* ************************************************************************ */
+ssize_t sysdep_file_read(sensor_family_t * family, fileinfo_t * info,
+                         void * buf, size_t size, uint64_t offset) {
+    file_priv_t *       priv = (family->priv);
+    sys_fileinfo_t *    sysinfo = (sys_fileinfo_t *) info->sysdep;
+    ssize_t             n;
+
+    /* the fd can be replaced by the common thread */
+    pthread_mutex_lock(&priv->mutex);
+    if (sysinfo == NULL || sysinfo->fd < 0) {
+        n = 0;
+    } else {
+        while ((n = pread(sysinfo->fd, buf, size, offset)) < 0 && errno == EINTR)
+            ; /* nothing but loop */
+        if (n < 0)
+            LOG_WARN(family->log, "cannot read %s: %s", info->name, strerror(errno));
+    }
+    pthread_mutex_unlock(&priv->mutex);
+
+    return n;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_file_watch_del(sensor_family_t * family, fileinfo_t * info) {
+    file_priv_t *       priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    sys_fileinfo_t *    sysinfo = (sys_fileinfo_t *) info->sysdep;
+
+    if (sysinfo != NULL && sysinfo->wd >= 0 && sysdep != NULL) {
+        inotify_rm_watch(sysdep->notify_ifd, sysinfo->wd);
+        sysinfo->wd = -1;
+    }
+    return SENSOR_SUCCESS;
+}
+
 /* ************************************************************************ */
 void sysdep_file_watch_free(void * vfile) {
     fileinfo_t * file = (fileinfo_t *) vfile;
     sys_fileinfo_t * sysfile = (sys_fileinfo_t *) file->sysdep;
 
+    /* watches are removed with sysdep_file_watch_del() or when inotify fd is closed */
     if (sysfile) {    
-        if (sysfile->ifd >= 0) {
-            close(sysfile->ifd); // FIXME inotify_rm_watch() ??
+        if (sysfile->fd >= 0) {
+            close(sysfile->fd);
         }
         file->sysdep = NULL;
         free(sysfile);
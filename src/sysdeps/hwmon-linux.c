@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * hwmon linux implementation for Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "vlib/util.h"
+
+#include "hwmon_private.h"
+#include "sensor_private.h"
+
+/* ************************************************************************ */
+#ifndef HWMON_DIR
+#define HWMON_DIR               "/sys/class/hwmon"
+#endif
+#define HWMON_INPUT_SUFFIX      "_input"
+
+/** sysfs prefixes of inputs, indexed by hwmon_kind_t */
+static const char * s_hwmon_prefixes[HWMON_NB] = {
+    "temp", "fan", "in", "power", "curr"
+};
+
+typedef struct {
+    /* persistent fds of *_input files, same indexes as priv->sensors */
+    int *           fds;
+} sysdep_t;
+
+/* ************************************************************************ */
+/** read a sysfs attribute with a persistent fd, without the ending newline */
+static ssize_t hwmon_linux_pread(int fd, char * buf, size_t size) {
+    ssize_t n;
+
+    while ((n = pread(fd, buf, size - 1, 0)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+    if (n < 0)
+        return -1;
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+        --n;
+    buf[n] = 0;
+    return n;
+}
+
+/** read once a sysfs attribute of dir/file */
+static ssize_t hwmon_linux_read_file(const char * dir, const char * file, char * buf, size_t size) {
+    char    path[PATH_MAX];
+    ssize_t n;
+    int     fd;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    n = hwmon_linux_pread(fd, buf, size);
+    close(fd);
+    return n;
+}
+
+/* ************************************************************************ */
+/** scandir filter of hwmon devices */
+static int hwmon_linux_filter_device(const struct dirent * dirent) {
+    return strncmp(dirent->d_name, "hwmon", 5) == 0;
+}
+
+/** scandir filter of inputs: <prefix><N>_input */
+static int hwmon_linux_filter_input(const struct dirent * dirent) {
+    const char * suffix = strchr(dirent->d_name, '_');
+
+    return suffix != NULL && strcmp(suffix, HWMON_INPUT_SUFFIX) == 0
+           && suffix > dirent->d_name && suffix[-1] >= '0' && suffix[-1] <= '9';
+}
+
+/** get the kind of an input, HWMON_NB if unknown */
+static hwmon_kind_t hwmon_linux_kind(const char * file) {
+    for (unsigned int kind = 0; kind < HWMON_NB; ++kind) {
+        size_t len = strlen(s_hwmon_prefixes[kind]);
+
+        if (strncmp(file, s_hwmon_prefixes[kind], len) == 0 && file[len] >= '0' && file[len] <= '9')
+            return kind;
+    }
+    return HWMON_NB;
+}
+
+/* ************************************************************************ */
+/** add the inputs of one hwmon device */
+static void hwmon_linux_init_device(sensor_family_t * family, const char * devname) {
+    hwmon_priv_t *      priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    char                dir[PATH_MAX];
+    char                chip[HWMON_NAME_SZ / 2];
+    struct dirent **    inputs = NULL;
+    int                 nb_inputs;
+
+    /* old drivers have their attributes in the device directory */
+    snprintf(dir, sizeof(dir), "%s%s/%s", sensor_sysroot(family), HWMON_DIR, devname);
+    if (hwmon_linux_read_file(dir, "name", chip, sizeof(chip)) <= 0) {
+        snprintf(dir, sizeof(dir), "%s%s/%s/device", sensor_sysroot(family), HWMON_DIR, devname);
+        if (hwmon_linux_read_file(dir, "name", chip, sizeof(chip)) <= 0)
+            str0cpy(chip, devname, sizeof(chip));
+    }
+    if ((nb_inputs = scandir(dir, &inputs, hwmon_linux_filter_input, versionsort)) < 0) {
+        LOG_VERBOSE(family->log, "cannot scan %s: %s", dir, strerror(errno));
+        return ;
+    }
+    /* several devices can have the same chip name (one coretemp per package) */
+    for (unsigned int i = 0; i < priv->nb_sensors; ++i) {
+        size_t len = strlen(chip);
+
+        if (strncmp(priv->sensors[i].name, chip, len) == 0 && priv->sensors[i].name[len] == ' ') {
+            snprintf(chip + len, sizeof(chip) - len, ".%s", devname + 5);
+            break ;
+        }
+    }
+
+    for (int i_input = 0; i_input < nb_inputs; ++i_input) {
+        const char *    file = inputs[i_input]->d_name;
+        hwmon_sensor_t  sensor;
+        char            path[PATH_MAX], label[HWMON_NAME_SZ / 2];
+        size_t          len = strlen(file) - PTR_COUNT(HWMON_INPUT_SUFFIX) + 1;
+        void *          ptr;
+        int             fd;
+
+        if ((sensor.kind = hwmon_linux_kind(file)) == HWMON_NB) {
+            continue ;
+        }
+        snprintf(path, sizeof(path), "%.*s_label", (int) len, file);
+        if (hwmon_linux_read_file(dir, path, label, sizeof(label)) <= 0) {
+            snprintf(label, sizeof(label), "%.*s", (int) len, file);
+        }
+        snprintf(sensor.name, sizeof(sensor.name), "%s %s", chip, label);
+        sensor.raw = 0;
+        sensor.value = 0.0;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, file);
+        if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+            LOG_VERBOSE(family->log, "cannot open %s: %s", path, strerror(errno));
+            continue ;
+        }
+        if ((ptr = realloc(priv->sensors, (priv->nb_sensors + 1) * sizeof(*priv->sensors))) == NULL
+        ||  (priv->sensors = ptr, 0)
+        ||  (ptr = realloc(sysdep->fds, (priv->nb_sensors + 1) * sizeof(*sysdep->fds))) == NULL) {
+            close(fd);
+            continue ;
+        }
+        sysdep->fds = ptr;
+        sysdep->fds[priv->nb_sensors] = fd;
+        priv->sensors[priv->nb_sensors++] = sensor;
+        LOG_VERBOSE(family->log, "added hwmon input %s (%s)", sensor.name, path);
+    }
+
+    for (int i_input = 0; i_input < nb_inputs; ++i_input)
+        free(inputs[i_input]);
+    free(inputs);
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_hwmon_support(sensor_family_t * family, const char * label) {
+    (void)family;
+    (void)label;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_hwmon_init(sensor_family_t * family) {
+    hwmon_priv_t *      priv = (family->priv);
+    struct dirent **    devices = NULL;
+    int                 nb_devices;
+    char                root[PATH_MAX];
+
+    if (priv->sysdep != NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if ((priv->sysdep = calloc(1, sizeof(sysdep_t))) == NULL) {
+        LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
+        errno = ENOMEM;
+        return SENSOR_ERROR;
+    }
+
+    /* enumerated once, sorted so that labels and indexes are stable across runs */
+    snprintf(root, sizeof(root), "%s%s", sensor_sysroot(family), HWMON_DIR);
+    if ((nb_devices = scandir(root, &devices, hwmon_linux_filter_device, versionsort)) < 0) {
+        LOG_VERBOSE(family->log, "cannot scan %s: %s", root, strerror(errno));
+        return SENSOR_SUCCESS;
+    }
+    for (int i = 0; i < nb_devices; ++i) {
+        hwmon_linux_init_device(family, devices[i]->d_name);
+        free(devices[i]);
+    }
+    free(devices);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_hwmon_destroy(sensor_family_t * family) {
+    hwmon_priv_t * priv = (hwmon_priv_t *) family->priv;
+
+    if (priv != NULL && priv->sysdep != NULL) {
+        sysdep_t * sysdep = (sysdep_t *) priv->sysdep;
+
+        for (unsigned int i = 0; sysdep->fds != NULL && i < priv->nb_sensors; ++i) {
+            close(sysdep->fds[i]);
+        }
+        if (sysdep->fds != NULL)
+            free(sysdep->fds);
+
+        priv->sysdep = NULL;
+        free(sysdep);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_hwmon_get(sensor_family_t * family) {
+    hwmon_priv_t *  priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    char            buf[32];
+    char *          end;
+
+    if (sysdep == NULL) {
+        LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
+        errno = EFAULT;
+        return SENSOR_ERROR;
+    }
+
+    /* one pread per input, no path lookup */
+    for (unsigned int i = 0; i < priv->nb_sensors; ++i) {
+        long long value;
+
+        /* some drivers give ENODATA or EIO when the sensor is idle: keep the last value */
+        sensor_family_stats_reads(family, 1);
+        if (hwmon_linux_pread(sysdep->fds[i], buf, sizeof(buf)) <= 0) {
+            LOG_SCREAM(family->log, "cannot read hwmon input %s: %s",
+                       priv->sensors[i].name, strerror(errno));
+            continue ;
+        }
+        errno = 0;
+        value = strtoll(buf, &end, 10);
+        if (errno == 0 && end != buf)
+            priv->sensors[i].raw = value;
+    }
+
+    return SENSOR_SUCCESS;
+}
+
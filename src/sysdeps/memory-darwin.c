@@ -27,10 +27,19 @@
 #include <mach/mach.h>
 #include <mach/mach_error.h>
 
+#include <stdlib.h>
+#include <stdint.h>
 #include <fnmatch.h>
 
 #include "memory_private.h"
 
+/* host_statistics64() writes in caller memory: the host port and page size
+ * are taken once */
+typedef struct {
+    host_t                  host;
+    vm_size_t               page_size;
+} memory_sysdep_t;
+
 sensor_status_t     sysdep_memory_support(sensor_family_t * family, const char * label) {
     (void) family;
     (void) label;
@@ -43,35 +52,71 @@ sensor_status_t     sysdep_memory_support(sensor_family_t * family, const char *
 }
 
 sensor_status_t     sysdep_memory_init(sensor_family_t * family) {
-    (void) family;
+    memory_priv_t *     priv = (memory_priv_t *) family->priv;
+    memory_sysdep_t *   sysdep;
+
+    if (priv->sysdep != NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if ((sysdep = malloc(sizeof(*sysdep))) == NULL) {
+        return SENSOR_ERROR;
+    }
+    if ((sysdep->host = mach_host_self()) == MACH_PORT_NULL) {
+        LOG_ERROR(family->log, "Could not get mach reference.");
+        free(sysdep);
+        return SENSOR_ERROR;
+    }
+    if (host_page_size(sysdep->host, &sysdep->page_size) != KERN_SUCCESS) {
+        sysdep->page_size = vm_page_size;
+    }
+    priv->sysdep = sysdep;
     return SENSOR_SUCCESS;
 }
 
 void                sysdep_memory_destroy(sensor_family_t * family) {
-    (void) family;
+    memory_priv_t * priv = (memory_priv_t *) family->priv;
+
+    if (priv != NULL && priv->sysdep != NULL) {
+        memory_sysdep_t * sysdep = (memory_sysdep_t *) priv->sysdep;
+
+        mach_port_deallocate(mach_task_self(), sysdep->host);
+        priv->sysdep = NULL;
+        free(sysdep);
+    }
 }
 
 /**
  * Internal memory info update.
  */
 sensor_status_t sysdep_memory_get(sensor_family_t * family, memory_data_t *data) {
-	mach_port_t host = mach_host_self();
-	if (!host) {
-		LOG_ERROR(family->log, "Could not get mach reference.");
-		return SENSOR_ERROR;
-	}
-
-    vm_statistics_data_t vmStats;
-	mach_msg_type_number_t vmCount = HOST_VM_INFO_COUNT;
-	if (host_statistics(host, HOST_VM_INFO, (host_info_t)&vmStats, &vmCount) != KERN_SUCCESS) {
-        LOG_ERROR(family->log, "Could not get mach reference.");
+    memory_priv_t *         priv = (memory_priv_t *) family->priv;
+    memory_sysdep_t *       sysdep = (memory_sysdep_t *) priv->sysdep;
+#ifdef HOST_VM_INFO64
+    vm_statistics64_data_t  vmStats;
+    mach_msg_type_number_t  vmCount = HOST_VM_INFO64_COUNT;
+#else
+    vm_statistics_data_t    vmStats;
+    mach_msg_type_number_t  vmCount = HOST_VM_INFO_COUNT;
+#endif
+    uint64_t                pgsz;
+
+    if (sysdep == NULL) {
         return SENSOR_ERROR;
-	}
+    }
+#ifdef HOST_VM_INFO64
+    if (host_statistics64(sysdep->host, HOST_VM_INFO64, (host_info64_t)&vmStats, &vmCount) != KERN_SUCCESS) {
+#else
+    if (host_statistics(sysdep->host, HOST_VM_INFO, (host_info_t)&vmStats, &vmCount) != KERN_SUCCESS) {
+#endif
+        LOG_ERROR(family->log, "Could not get host vm statistics.");
+        return SENSOR_ERROR;
+    }
+    pgsz = sysdep->page_size;
 
-    data->active = ((natural_t)vmStats.active_count) * (unsigned long)((natural_t)vm_page_size);
-    data->inactive = ((natural_t)vmStats.inactive_count) * (unsigned long)((natural_t)vm_page_size);
-    data->wired = ((natural_t)vmStats.wire_count) * (unsigned long)((natural_t)vm_page_size);
-    data->free = ((natural_t)vmStats.free_count) * (unsigned long)((natural_t)vm_page_size);
+    data->active = vmStats.active_count * pgsz;
+    data->inactive = vmStats.inactive_count * pgsz;
+    data->wired = vmStats.wire_count * pgsz;
+    data->free = vmStats.free_count * pgsz;
     data->used = data->active + data->wired;
     data->total = data->active + data->inactive + data->free + data->wired;
     if (data->total == 0)
@@ -24,7 +24,11 @@
  * memory-linux for Generic Sensor Management Library.
  */
 #include <unistd.h>
+#include <fcntl.h>
+#include <stddef.h>
 
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -34,6 +38,7 @@
 #include "vlib/util.h"
 
 #include "memory_private.h"
+#include "sensor_private.h"
 
 /* ************************************************************************ */
 
@@ -41,12 +46,260 @@
 #define MEM_MEMINFO_FILE   "/proc/meminfo"
 #endif
 
+#ifndef MEM_CGROUP_FILE
+#define MEM_CGROUP_FILE     "/proc/self/cgroup"
+#endif
+
+#ifndef MEM_CGROUP_DIR
+#define MEM_CGROUP_DIR      "/sys/fs/cgroup"
+#endif
+
+#define MEM_LINUX_BUFSZ     4096
+
+/** memory.current, memory.max and memory.stat of our cgroup v2 */
+enum {
+    MEM_CG_CURRENT = 0,
+    MEM_CG_MAX,
+    MEM_CG_STAT,
+    MEM_CG_NB
+};
+static const char * const s_mem_cgroup_files[MEM_CG_NB] = {
+    "memory.current", "memory.max", "memory.stat"
+};
+
 typedef struct {
-    FILE *  stat;
-    char *  stat_line;
-    size_t  stat_linesz;
+    int     fd;
+    int     cgroup_fds[MEM_CG_NB];
+    char *  buf;        /* reused between reads */
+    size_t  bufsz;
+    sensor_provider_t * provider;   /* MEM_MEMINFO_FILE reads shared with other contexts */
 } mem_linux_t;
 
+/* ************************************************************************ */
+/** Fields read in /proc/meminfo and memory.stat, with a perfect hash of their
+ * names (see mem_linux_hash()) precomputed for each table: any other field name either
+ * hashes to an empty slot or fails the length/name check. Parameters of the
+ * hash must be computed again when a field is added (checked at init). */
+#define MEM_LINUX_HASH_SIZE     32      /* power of 2 */
+
+#define MEM_LINUX_F_KB          (1 << 0)    /* value in kB */
+#define MEM_LINUX_F_ADD         (1 << 1)    /* value is added to the field */
+
+typedef struct {
+    const char *    name;       /* NULL for empty slots */
+    unsigned char   len;
+    unsigned char   flags;      /* MEM_LINUX_F_* */
+    unsigned short  offset;     /* of TYPE_SENSOR_VALUE_ULONG in memory_data_t */
+} mem_linux_field_t;
+
+#define MEM_LINUX_FIELD(_name, _field, _flags) \
+    { _name, sizeof(_name) - 1, _flags, offsetof(memory_data_t, _field) }
+
+/** /proc/meminfo, hash multipliers 3 and 28 */
+#define MEM_MEMINFO_HASH_A      3
+#define MEM_MEMINFO_HASH_B      28
+static const mem_linux_field_t s_meminfo_fields[MEM_LINUX_HASH_SIZE] = {
+    [4]  = MEM_LINUX_FIELD("MemTotal",          total,              MEM_LINUX_F_KB),
+    [20] = MEM_LINUX_FIELD("MemFree",           free,               MEM_LINUX_F_KB),
+    [6]  = MEM_LINUX_FIELD("MemAvailable",      available,          MEM_LINUX_F_KB),
+    [17] = MEM_LINUX_FIELD("Buffers",           buffers,            MEM_LINUX_F_KB),
+    [13] = MEM_LINUX_FIELD("Cached",            cached,             MEM_LINUX_F_KB),
+    [18] = MEM_LINUX_FIELD("SwapTotal",         total_swap,         MEM_LINUX_F_KB),
+    [29] = MEM_LINUX_FIELD("SwapFree",          free_swap,          MEM_LINUX_F_KB),
+    [8]  = MEM_LINUX_FIELD("Active",            active,             MEM_LINUX_F_KB),
+    [1]  = MEM_LINUX_FIELD("Inactive",          inactive,           MEM_LINUX_F_KB),
+    [5]  = MEM_LINUX_FIELD("Unevictable",       wired,              MEM_LINUX_F_KB | MEM_LINUX_F_ADD),
+    [21] = MEM_LINUX_FIELD("Mlocked",           wired,              MEM_LINUX_F_KB | MEM_LINUX_F_ADD),
+    [24] = MEM_LINUX_FIELD("Slab",              slab,               MEM_LINUX_F_KB),
+    [10] = MEM_LINUX_FIELD("HugePages_Total",   hugepages_total,    0),
+    [3]  = MEM_LINUX_FIELD("HugePages_Free",    hugepages_free,     0),
+    [7]  = MEM_LINUX_FIELD("HugePages_Rsvd",    hugepages_reserved, 0),
+    [23] = MEM_LINUX_FIELD("HugePages_Surp",    hugepages_surplus,  0),
+    [31] = MEM_LINUX_FIELD("Hugepagesize",      hugepage_size,      MEM_LINUX_F_KB),
+};
+
+/** cgroup v2 memory.stat, hash multipliers 1 and 1 */
+#define MEM_CGSTAT_HASH_A       1
+#define MEM_CGSTAT_HASH_B       1
+static const mem_linux_field_t s_cgstat_fields[MEM_LINUX_HASH_SIZE] = {
+    [2]  = MEM_LINUX_FIELD("anon",              cgroup_anon,        0),
+    [27] = MEM_LINUX_FIELD("file",              cgroup_file,        0),
+    [11] = MEM_LINUX_FIELD("kernel",            cgroup_kernel,      0),
+    [26] = MEM_LINUX_FIELD("slab",              cgroup_slab,        0),
+    [18] = MEM_LINUX_FIELD("shmem",             cgroup_shmem,       0),
+    [5]  = MEM_LINUX_FIELD("sock",              cgroup_sock,        0),
+};
+
+/* ************************************************************************ */
+static inline unsigned int mem_linux_hash(const char * name, size_t len,
+                                          unsigned int a, unsigned int b) {
+    return (len * a + (unsigned char) name[0] + (unsigned char) name[len - 1] * b
+            + (unsigned char) name[len / 2]) & (MEM_LINUX_HASH_SIZE - 1);
+}
+
+/* ************************************************************************ */
+/** check that table entries are at their hash slot */
+static int mem_linux_check_fields(sensor_family_t * family, const mem_linux_field_t * fields,
+                                  unsigned int a, unsigned int b) {
+    int ret = 0;
+
+    for (unsigned int i = 0; i < MEM_LINUX_HASH_SIZE; ++i) {
+        if (fields[i].name != NULL && mem_linux_hash(fields[i].name, fields[i].len, a, b) != i) {
+            LOG_WARN(family->log, "meminfo field '%s' is not at its hash slot", fields[i].name);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/* ************************************************************************ */
+/** scan an unsigned decimal after blanks, NULL if there is none before end */
+static inline const char * mem_linux_scan_ulong(const char * s, const char * end,
+                                               unsigned long * value) {
+    unsigned long v = 0;
+
+    while (s < end && (*s == ' ' || *s == '\t'))
+        ++s;
+    if (s >= end || (unsigned char) (*s - '0') > 9)
+        return NULL;
+    do {
+        v = v * 10 + (*s - '0');
+    } while (++s < end && (unsigned char) (*s - '0') <= 9);
+    *value = v;
+    return s;
+}
+
+/* ************************************************************************ */
+/** read a whole file with pread() in sysdep buffer, growing it if needed.
+ * @return the number of bytes read, or -1 on error */
+static ssize_t mem_linux_read(sensor_family_t * family, mem_linux_t * sysdep,
+                              sensor_provider_t * provider, int fd) {
+    ssize_t n;
+
+    while (1) {
+        char * buf;
+
+        if ((n = sensor_provider_pread(provider, family, fd, sysdep->buf, sysdep->bufsz)) < 0) {
+            return -1;
+        }
+        if ((size_t) n < sysdep->bufsz) {
+            return n;
+        }
+        if ((buf = realloc(sysdep->buf, sysdep->bufsz * 2)) == NULL) {
+            return -1;
+        }
+        sysdep->buf = buf;
+        sysdep->bufsz *= 2;
+    }
+}
+
+/* ************************************************************************ */
+/** parse "<name><sep> <value>[ kB]" lines, storing known fields in data */
+static void mem_linux_parse(const char * buf, size_t len, char sep,
+                            const mem_linux_field_t * fields, unsigned int a, unsigned int b,
+                            memory_data_t * data) {
+    const char * line, * end = buf + len;
+
+    for (line = buf; line < end; ++line) {
+        const char *                eol = memchr(line, '\n', end - line);
+        const char *                name_end;
+        const mem_linux_field_t *   field;
+        unsigned long               value;
+
+        if (eol == NULL)
+            eol = end;
+        if ((name_end = memchr(line, sep, eol - line)) != NULL && name_end > line) {
+            field = &(fields[mem_linux_hash(line, name_end - line, a, b)]);
+            if (field->name != NULL && field->len == name_end - line
+            &&  memcmp(field->name, line, field->len) == 0
+            &&  mem_linux_scan_ulong(name_end + 1, eol, &value) != NULL) {
+                TYPE_SENSOR_VALUE_ULONG * p = (TYPE_SENSOR_VALUE_ULONG *)
+                                              ((char *) data + field->offset);
+                if ((field->flags & MEM_LINUX_F_KB) != 0)
+                    value *= 1024;
+                *p = (field->flags & MEM_LINUX_F_ADD) != 0 ? *p + value : value;
+            }
+        }
+        line = eol;
+    }
+}
+
+/* ************************************************************************ */
+/** open the memory files of our cgroup v2, if we are not in the root cgroup */
+static void mem_linux_cgroup_open(sensor_family_t * family, mem_linux_t * sysdep) {
+    static const char * const roots[] = { MEM_CGROUP_DIR, MEM_CGROUP_DIR "/unified" };
+    char            path[PATH_MAX];
+    ssize_t         len;
+    const char *    line, * end, * cgpath = NULL;
+    int             fd;
+
+    for (unsigned int i = 0; i < MEM_CG_NB; ++i)
+        sysdep->cgroup_fds[i] = -1;
+
+    /* "0::/path" is the cgroup v2 line of /proc/self/cgroup */
+    snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), MEM_CGROUP_FILE);
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return ;
+    len = mem_linux_read(family, sysdep, NULL, fd);
+    close(fd);
+    for (line = sysdep->buf, end = sysdep->buf + (len > 0 ? len : 0); line < end; ++line) {
+        const char * eol = memchr(line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+        if (eol - line >= 3 && strncmp(line, "0::", 3) == 0) {
+            cgpath = line + 3;
+            len = eol - cgpath;
+            break ;
+        }
+        line = eol;
+    }
+    if (cgpath == NULL)
+        return ;
+
+    for (unsigned int i_root = 0; i_root < PTR_COUNT(roots); ++i_root) {
+        snprintf(path, sizeof(path), "%s%s%.*s/%s", sensor_sysroot(family), roots[i_root],
+                 (int) len, cgpath, s_mem_cgroup_files[MEM_CG_CURRENT]);
+        if ((sysdep->cgroup_fds[MEM_CG_CURRENT] = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+            continue ;
+        LOG_VERBOSE(family->log, "using cgroup memory files %s", path);
+        for (unsigned int i = MEM_CG_CURRENT + 1; i < MEM_CG_NB; ++i) {
+            snprintf(path, sizeof(path), "%s%s%.*s/%s", sensor_sysroot(family), roots[i_root],
+                     (int) len, cgpath, s_mem_cgroup_files[i]);
+            sysdep->cgroup_fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+        }
+        break ;
+    }
+}
+
+/* ************************************************************************ */
+/** read memory.current, memory.max and memory.stat of our cgroup */
+static void mem_linux_cgroup_get(sensor_family_t * family, mem_linux_t * sysdep,
+                                 memory_data_t * data) {
+    ssize_t         len;
+    unsigned long   value;
+
+    if ((len = mem_linux_read(family, sysdep, NULL, sysdep->cgroup_fds[MEM_CG_CURRENT])) > 0
+    &&  mem_linux_scan_ulong(sysdep->buf, sysdep->buf + len, &value) != NULL) {
+        data->cgroup_current = value;
+    }
+    /* memory.max is "max" when unlimited */
+    data->cgroup_max = data->total;
+    if (sysdep->cgroup_fds[MEM_CG_MAX] >= 0
+    &&  (len = mem_linux_read(family, sysdep, NULL, sysdep->cgroup_fds[MEM_CG_MAX])) > 0
+    &&  mem_linux_scan_ulong(sysdep->buf, sysdep->buf + len, &value) != NULL
+    &&  value < data->total) {
+        data->cgroup_max = value;
+    }
+    if (sysdep->cgroup_fds[MEM_CG_STAT] >= 0
+    &&  (len = mem_linux_read(family, sysdep, NULL, sysdep->cgroup_fds[MEM_CG_STAT])) > 0) {
+        mem_linux_parse(sysdep->buf, len, ' ', s_cgstat_fields,
+                        MEM_CGSTAT_HASH_A, MEM_CGSTAT_HASH_B, data);
+    }
+    if (data->cgroup_max == 0)
+        data->cgroup_used_percent = 100;
+    else
+        data->cgroup_used_percent = ((data->cgroup_current/1024.0) / (data->cgroup_max/1024.0)) * 100;
+}
 
 /* ************************************************************************ */
 sensor_status_t sysdep_memory_support(sensor_family_t * family, const char * label) {
@@ -62,9 +315,7 @@ sensor_status_t sysdep_memory_support(sensor_family_t * family, const char * lab
 sensor_status_t sysdep_memory_init(sensor_family_t * family) {
     memory_priv_t * priv = (family->priv);
     mem_linux_t *   sysdep;
-    //char *          line = NULL;
-    //size_t          lineallocsz = 0;
-    //ssize_t         linesz;
+    char            path[PATH_MAX];
 
     if (priv->sysdep == NULL) {
         priv->sysdep = calloc(1, sizeof(mem_linux_t));
@@ -75,28 +326,30 @@ sensor_status_t sysdep_memory_init(sensor_family_t * family) {
         }
 
         sysdep = priv->sysdep;
-        sysdep->stat_line = NULL;
-        sysdep->stat_linesz = 0;
-        if ((sysdep->stat = fopen(MEM_MEMINFO_FILE, "r")) == NULL) {
-            LOG_ERROR(family->log, "error while openning %s", MEM_MEMINFO_FILE);
+        sysdep->fd = -1;
+        sysdep->bufsz = MEM_LINUX_BUFSZ;
+        for (unsigned int i = 0; i < MEM_CG_NB; ++i)
+            sysdep->cgroup_fds[i] = -1;
+        if ((sysdep->buf = malloc(sysdep->bufsz)) == NULL) {
+            LOG_ERROR(family->log, "error, cannot malloc %s buffer", MEM_MEMINFO_FILE);
+            errno=ENOMEM;
+            return SENSOR_ERROR;
+        }
+        snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), MEM_MEMINFO_FILE);
+        if ((sysdep->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+            LOG_ERROR(family->log, "error while openning %s", path);
             errno=ENOENT;
             return SENSOR_ERROR;
         }
-    } else {
-        sysdep = priv->sysdep;
+        sysdep->provider = sensor_provider_get(path);
+        mem_linux_check_fields(family, s_meminfo_fields, MEM_MEMINFO_HASH_A, MEM_MEMINFO_HASH_B);
+        mem_linux_check_fields(family, s_cgstat_fields, MEM_CGSTAT_HASH_A, MEM_CGSTAT_HASH_B);
+        mem_linux_cgroup_open(family, sysdep);
     }
 
-    fseek(sysdep->stat, 0, SEEK_SET);
-    /*
-    while ((linesz = getline(&line, &lineallocsz, sysdep->stat)) >= 0) {
-        LOG_DEBUG(family->log, "%s LINE (sz:%zu) %s", MEM_MEMINFO_FILE, linesz, line);
-        if (!strncmp(line, "cpu", 3) && (line[3] != ' ' && line[3] != '\t'))
-            ++n_cpus;
-    }
-
-    if (line != NULL)
-        free(line);
-    */
+    priv->extras = MEM_EXTRA_DETAILS | MEM_EXTRA_HUGEPAGES;
+    if (((mem_linux_t *) priv->sysdep)->cgroup_fds[MEM_CG_CURRENT] >= 0)
+        priv->extras |= MEM_EXTRA_CGROUP;
 
     return SENSOR_SUCCESS;
 }
@@ -108,13 +361,19 @@ void            sysdep_memory_destroy(sensor_family_t * family) {
     if (priv != NULL && priv->sysdep != NULL) {
         mem_linux_t * sysdep = (mem_linux_t *) priv->sysdep;
 
-        if (sysdep->stat != NULL) {
-            fclose(sysdep->stat);
-            sysdep->stat = NULL;
+        if (sysdep->fd >= 0) {
+            close(sysdep->fd);
+            sysdep->fd = -1;
+        }
+        sensor_provider_release(sysdep->provider);
+        sysdep->provider = NULL;
+        for (unsigned int i = 0; i < MEM_CG_NB; ++i) {
+            if (sysdep->cgroup_fds[i] >= 0)
+                close(sysdep->cgroup_fds[i]);
         }
-        if (sysdep->stat_line != NULL)
-            free(sysdep->stat_line);
-        sysdep->stat_line = NULL;
+        if (sysdep->buf != NULL)
+            free(sysdep->buf);
+        sysdep->buf = NULL;
         priv->sysdep = NULL;
         free(sysdep);
     }
@@ -124,7 +383,7 @@ void            sysdep_memory_destroy(sensor_family_t * family) {
 sensor_status_t sysdep_memory_get(sensor_family_t * family, memory_data_t * data) {
     memory_priv_t * priv = (family->priv);
     mem_linux_t *   sysdep = priv->sysdep;
-    ssize_t         linesz;
+    ssize_t         len;
 
     if (priv->sysdep == NULL) {
         LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
@@ -132,79 +391,28 @@ sensor_status_t sysdep_memory_get(sensor_family_t * family, memory_data_t * data
         return SENSOR_ERROR;
     }
 
-    if (sysdep->stat == NULL || fseek(sysdep->stat, 0, SEEK_SET) != 0) {
-        if (sysdep->stat != NULL)
-            fclose(sysdep->stat);
-        if ((sysdep->stat = fopen(MEM_MEMINFO_FILE, "r")) == NULL) {
-            return SENSOR_ERROR;
-        }
-    }
-
-    data->wired = 0; //((natural_t)vmStats.wire_count) * (unsigned long)((natural_t)vm_page_size);
-
-    while ((linesz = getline(&sysdep->stat_line, &sysdep->stat_linesz, sysdep->stat)) > 0) {
-        char * line = sysdep->stat_line;
-        const char * token, * value, * next = line;
-        ssize_t tok_len, val_len;
-        size_t maxlen;
-
-        if (sysdep->stat_line == NULL)
-            break ;
-
-        if (sysdep->stat_line[linesz - 1] == '\n')
-            sysdep->stat_line[--linesz] = 0;
-            
-        /* /proc/meminfo format: {
-         *  <keyword>:      <value> <unit/info> // For historical reason the unit kB is used but data is actually KiB.
-         *  TotalMemory:    <number> kB
-         *  ...
-         */
-        LOG_SCREAM(family->log, "%s LINE (sz:%zu) %s", MEM_MEMINFO_FILE,
-                   linesz, line);
-
-        if (linesz <= 1)
-            continue ;
-            
-        maxlen = linesz;
-        /* get value name */
-        while (*next == ' ' || *next == '\t') {
-            ++next;
-            --maxlen;
-        }
-        tok_len = strtok_ro_r(&token, ":", &next, &maxlen, 0);
-        if (tok_len == 0 || *next == 0)
-            continue ;
-
-        /* get value value */
-        while((val_len = strtok_ro_r(&value, " ", &next, &maxlen, 0)) == 0 && *next)
-            ; /* nothing */
-        if (val_len == 0)
-            continue ;
-
-        if (strncasecmp(token, "MemTotal", tok_len) == 0) {
-            data->total = strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "MemFree", tok_len) == 0) {
-            data->free = strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "SwapTotal", tok_len) == 0) {
-            data->total_swap = strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "SwapFree", tok_len) == 0) {
-            data->free_swap = strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "Active:", tok_len + 1) == 0) {
-            data->active = strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "Inactive:", tok_len + 1) == 0) {
-            data->inactive = strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "Unevictable", tok_len) == 0) {
-            data->wired += strtoul(value, NULL, 10) * 1024;
-        } else if (strncasecmp(token, "Mlocked", tok_len) == 0) {
-            data->wired += strtoul(value, NULL, 10) * 1024;
-        }
+    /* /proc/meminfo format: {
+     *  <keyword>:      <value> <unit/info> // For historical reason the unit kB is used but data is actually KiB.
+     *  TotalMemory:    <number> kB
+     *  ...
+     */
+    len = mem_linux_read(family, sysdep, sysdep->provider, sysdep->fd);
+    if (len <= 0) {
+        LOG_ERROR(family->log, "error while reading %s: %s", MEM_MEMINFO_FILE, strerror(errno));
+        return SENSOR_ERROR;
     }
+    LOG_SCREAM(family->log, "%s (sz:%zd)", MEM_MEMINFO_FILE, len);
 
-    //data->free = 0; //((natural_t)vmStats.free_count) * (unsigned long)((natural_t)vm_page_size);
+    data->wired = 0; /* Unevictable + Mlocked */
+    data->available = 0;
+    mem_linux_parse(sysdep->buf, len, ':', s_meminfo_fields,
+                    MEM_MEMINFO_HASH_A, MEM_MEMINFO_HASH_B, data);
 
-    data->used = data->total - data->free; //data->active + data->wired;
+    /* MemAvailable estimates memory usable without swapping (linux >= 3.14) */
+    if (data->available == 0)
+        data->available = data->free + data->buffers + data->cached;
+    data->used = data->total > data->available ? data->total - data->available : 0;
     data->used_swap = data->total_swap - data->free_swap;
-    //data->total = data->active + data->inactive + data->free + data->wired;
 
     if (data->total == 0)
         data->used_percent = 100;
@@ -216,6 +424,9 @@ sensor_status_t sysdep_memory_get(sensor_family_t * family, memory_data_t * data
     else
         data->used_swap_percent = ((data->used_swap/1024.0) / (data->total_swap/1024.0)) * 100;
 
+    if ((priv->extras & MEM_EXTRA_CGROUP) != 0) {
+        mem_linux_cgroup_get(family, sysdep, data);
+    }
+
     return SENSOR_SUCCESS;
 }
-
@@ -50,6 +50,10 @@
 # define IFF_ALTPHYS 0
 #endif
 
+/** the interface list is read in a buffer kept between updates, with this
+ * margin when it grows, its size is probed only when it is too small */
+#define NETWORK_SYSCTL_MARGIN   1024
+
 typedef struct {
     char *      buf;
     size_t      buf_size;
@@ -122,9 +126,9 @@ sensor_status_t sysdep_network_get(
     return SENSOR_ERROR;
 #else
 # if defined(NET_RT_IFLIST2) && defined(RTM_IFINFO2)
-    int                 mib[] = { CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST2, 0 };
+    static int          mib[] = { CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST2, 0 };
 # else
-    int                 mib[] = { CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST, 0 };
+    static int          mib[] = { CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST, 0 };
 # endif
     network_priv_t *    priv = (network_priv_t *) family->priv;
     network_sysdep_t *  sysdep = (network_sysdep_t *) priv->sysdep;
@@ -134,21 +138,27 @@ sensor_status_t sysdep_network_get(
         return SENSOR_ERROR;
     }
 
-    if (sysctl(mib, sizeof(mib) / sizeof(*mib), NULL, &len, NULL, 0) < 0) {
-	    LOG_ERROR(family->log, "%s(): sysctl(null): %s", __func__, strerror(errno));
-	    return SENSOR_ERROR;
-    }
+    /* one sysctl() in the kept buffer, unless interfaces were added */
+    while ((len = sysdep->buf_size) == 0
+    ||     sysctl(mib, sizeof(mib) / sizeof(*mib), sysdep->buf, &len, NULL, 0) < 0) {
+        char * newbuf;
 
-    if (len > sysdep->buf_size) {
-        if ((sysdep->buf = realloc(sysdep->buf, len)) == NULL) {
+        if (sysdep->buf_size != 0 && errno != ENOMEM) {
+            LOG_ERROR(family->log, "%s(): sysctl(buf): %s", __func__, strerror(errno));
+            return SENSOR_ERROR;
+        }
+        if (sysctl(mib, sizeof(mib) / sizeof(*mib), NULL, &len, NULL, 0) < 0) {
+            LOG_ERROR(family->log, "%s(): sysctl(null): %s", __func__, strerror(errno));
+            return SENSOR_ERROR;
+        }
+        len += NETWORK_SYSCTL_MARGIN;
+        if ((newbuf = realloc(sysdep->buf, len)) == NULL) {
             return SENSOR_ERROR;
         }
+        sysdep->buf = newbuf;
         sysdep->buf_size = len;
     }
-    if (sysctl(mib, sizeof(mib) / sizeof(*mib), sysdep->buf, &len, NULL, 0) < 0) {
-        LOG_ERROR(family->log, "%s(): sysctl(buf): %s", __func__, strerror(errno));
-        return SENSOR_ERROR;
-    }
+    sysdep->sysctl_len = len;
 
     char * buf = sysdep->buf;
     char *lim = buf + len;
@@ -198,26 +208,29 @@ sensor_status_t sysdep_network_get(
             //fprintf(stderr, "%s(): unreconized ifm data type: %d\n", __func__, ifm->ifm_type);
             continue ;
         }
-        char if_name[IF_NAMESIZE+1] = {0, };
-        if_name[IF_NAMESIZE] = 0;
-        if_indextoname(ifm_index, if_name);
         #ifndef _DEBUG
         (void) ifi_type;
         #endif
-        LOG_DEBUG(
-            family->log,
-            "RTM_IFINFO%u #%d %s TYPE:%u UP:%d LO:%d I:%" PRIu64 " O:%" PRIu64 " FLAGS:%d"
-            " OACT:%d BCST:%d DBG:%d PPP:%d NOTR:%d RUNN:%d NOARP:%d PRO:%d"
-            " ALLM:%d SIMP:%d APH:%d MCST:%d",
-            ifm->ifm_type, ifm_index, if_name, ifi_type,
-            (ifm_flags & IFF_UP) != 0, (ifm_flags & IFF_LOOPBACK) != 0,
-            ibytes, obytes, ifm_flags,
-            (ifm_flags & IFF_OACTIVE) != 0, (ifm_flags & IFF_BROADCAST) != 0,
-            (ifm_flags & IFF_DEBUG) != 0, (ifm_flags & IFF_POINTOPOINT) != 0,
-            (ifm_flags & IFF_NOTRAILERS) != 0, (ifm_flags & IFF_RUNNING) != 0,
-            (ifm_flags & IFF_NOARP) != 0, (ifm_flags & IFF_PROMISC) != 0,
-            (ifm_flags & IFF_ALLMULTI) != 0, (ifm_flags & IFF_SIMPLEX) != 0,
-            (ifm_flags & IFF_ALTPHYS) != 0, (ifm_flags & IFF_MULTICAST) != 0);
+        /* interface name only needed for debug logs */
+        if (LOG_CAN_LOG(family->log, LOG_LVL_DEBUG)) {
+            char if_name[IF_NAMESIZE+1] = {0, };
+            if_name[IF_NAMESIZE] = 0;
+            if_indextoname(ifm_index, if_name);
+            LOG_DEBUG(
+                family->log,
+                "RTM_IFINFO%u #%d %s TYPE:%u UP:%d LO:%d I:%" PRIu64 " O:%" PRIu64 " FLAGS:%d"
+                " OACT:%d BCST:%d DBG:%d PPP:%d NOTR:%d RUNN:%d NOARP:%d PRO:%d"
+                " ALLM:%d SIMP:%d APH:%d MCST:%d",
+                ifm->ifm_type, ifm_index, if_name, ifi_type,
+                (ifm_flags & IFF_UP) != 0, (ifm_flags & IFF_LOOPBACK) != 0,
+                ibytes, obytes, ifm_flags,
+                (ifm_flags & IFF_OACTIVE) != 0, (ifm_flags & IFF_BROADCAST) != 0,
+                (ifm_flags & IFF_DEBUG) != 0, (ifm_flags & IFF_POINTOPOINT) != 0,
+                (ifm_flags & IFF_NOTRAILERS) != 0, (ifm_flags & IFF_RUNNING) != 0,
+                (ifm_flags & IFF_NOARP) != 0, (ifm_flags & IFF_PROMISC) != 0,
+                (ifm_flags & IFF_ALLMULTI) != 0, (ifm_flags & IFF_SIMPLEX) != 0,
+                (ifm_flags & IFF_ALTPHYS) != 0, (ifm_flags & IFF_MULTICAST) != 0);
+        }
 
         total_ibytes += ibytes;
 		total_obytes += obytes;
@@ -237,21 +250,8 @@ sensor_status_t sysdep_network_get(
 	    }
     }
 
-    if (elapsed == NULL) {
-        data->ibytespersec = 0;
-        data->obytespersec = 0;
-        data->phy_ibytespersec = 0;
-        data->phy_obytespersec = 0;
-    } else {
-        data->ibytespersec = (((total_ibytes - data->ibytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->obytespersec = (((total_obytes - data->obytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_ibytespersec = (((phy_ibytes - data->phy_ibytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_obytespersec = (((phy_obytes - data->phy_obytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-    }
+    /* rates are computed by the family */
+    (void) elapsed;
     data->ibytes = total_ibytes;
     data->obytes = total_obytes;
     data->phy_ibytes = phy_ibytes;
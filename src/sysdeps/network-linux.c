@@ -23,128 +23,302 @@
 /* ------------------------------------------------------------------------
  * network-linux for Generic Sensor Management Library.
  */
+#include <sys/types.h>
+#include <sys/socket.h>
 #include <unistd.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
+#include <fnmatch.h>
 
 #include "vlib/util.h"
 
 #include "network_private.h"
+#include "sensor_private.h"
 
 /* ************************************************************************ */
 
+#define NET_UDEV_SUBSYSTEM      "net"
+
 #ifndef NET_DEV_FILE
-#define NET_DEV_FILE   "/proc/net/dev"
+#define NET_DEV_FILE            "/proc/net/dev"
+#endif
+
+#ifndef NET_NETLINK_BUFSZ_MIN
+#define NET_NETLINK_BUFSZ_MIN   32768
 #endif
 
 typedef struct {
-    FILE *  stat;
-    char *  stat_line;
-    size_t  stat_linesz;
+    /* RTM_GETLINK dump, nl_fd is -1 if netlink cannot be used */
+    int                 nl_fd;
+    unsigned int        nl_seq;
+    char *              nl_buf;
+    size_t              nl_bufsz;
+    /* /proc/net/dev fallback */
+    FILE *              stat;
+    char *              stat_line;
+    size_t              stat_linesz;
+    /* interfaces add/remove events come from the common udev thread */
+    int                 monitored;
+    int                 changed;
+    /* state of the current pass */
+    unsigned int        hint;
+    unsigned int        matched;
+    unsigned int        unknown;
+    uint64_t            total_ibytes;
+    uint64_t            total_obytes;
+    uint64_t            phy_ibytes;
+    uint64_t            phy_obytes;
+    /* new set of interfaces collected during the pass when changed */
+    network_iface_t *   next;
+    unsigned int        nb_next;
+    unsigned int        next_size;
 } net_linux_t;
 
+// sysdeps/common-linux.c
+sensor_status_t linux_common_udev_monitor_update(
+                    sensor_family_t * family,
+                    const char * subsystem,
+                    const char * devtype,
+                    const char * tag);
 
 /* ************************************************************************ */
-sensor_status_t sysdep_network_support(sensor_family_t * family, const char * label) {
-    (void) label;
-    (void) family;
-    return SENSOR_SUCCESS;
-}
+/** account the counters of one interface read from netlink or /proc/net/dev.
+ * Interfaces come in the same order at each pass, the hint avoids searching them. */
+static void net_linux_store(
+                    sensor_family_t *       family,
+                    net_linux_t *           sysdep,
+                    const network_iface_t * stats,
+                    int                     phys,
+                    int                     collect) {
+    network_priv_t *    priv = (network_priv_t *) family->priv;
+    network_iface_t *   iface = NULL;
+    unsigned int        i;
+
+    sysdep->total_ibytes += stats->ibytes;
+    sysdep->total_obytes += stats->obytes;
+    if (phys) {
+        sysdep->phy_ibytes += stats->ibytes;
+        sysdep->phy_obytes += stats->obytes;
+    }
 
-/* ************************************************************************ */
-sensor_status_t sysdep_network_init(sensor_family_t * family) {
-    network_priv_t *priv = (family->priv);
-    net_linux_t *   sysdep;
+    for (i = 0; i <= priv->nb_ifaces; ++i) {
+        /* first try the hint, then all interfaces */
+        unsigned int idx = (i == 0 ? sysdep->hint : i - 1);
 
-    if (priv->sysdep == NULL) {
-        priv->sysdep = calloc(1, sizeof(net_linux_t));
-        if (priv->sysdep == NULL) {
-            LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
-            errno=ENOMEM;
-            return SENSOR_ERROR;
+        if (idx < priv->nb_ifaces
+        &&  (stats->ifindex <= 0 || priv->iface_data[idx].ifindex <= 0
+             || stats->ifindex == priv->iface_data[idx].ifindex)
+        &&  strcmp(stats->name, priv->iface_data[idx].name) == 0) {
+            iface = &(priv->iface_data[idx]);
+            sysdep->hint = idx + 1;
+            break ;
         }
+    }
+    if (iface != NULL) {
+        int ifindex = iface->ifindex;
 
-        sysdep = priv->sysdep;
-        sysdep->stat_line = NULL;
-        sysdep->stat_linesz = 0;
-        if ((sysdep->stat = fopen(NET_DEV_FILE, "r")) == NULL) {
-            LOG_ERROR(family->log, "error while openning %s", NET_DEV_FILE);
-            errno=ENOENT;
-            return SENSOR_ERROR;
-        }
+        *iface = *stats;
+        if (ifindex > 0)
+            iface->ifindex = ifindex;
+        ++(sysdep->matched);
     } else {
-        sysdep = priv->sysdep;
+        ++(sysdep->unknown);
     }
 
-    fseek(sysdep->stat, 0, SEEK_SET);
+    if (collect) {
+        if (sysdep->nb_next >= sysdep->next_size) {
+            unsigned int        size = sysdep->next_size ? sysdep->next_size * 2 : 32;
+            network_iface_t *   next;
 
-    return SENSOR_SUCCESS;
+            if ((next = realloc(sysdep->next, size * sizeof(*next))) == NULL) {
+                LOG_WARN(family->log, "%s(): cannot allocate interfaces", __func__);
+                return ;
+            }
+            sysdep->next = next;
+            sysdep->next_size = size;
+        }
+        sysdep->next[sysdep->nb_next++] = *stats;
+    }
 }
 
 /* ************************************************************************ */
-sensor_status_t sysdep_network_destroy(sensor_family_t * family) {
-    network_priv_t * priv = (network_priv_t *) family->priv;
+/** get the counters of all interfaces with a single RTM_GETLINK dump */
+static sensor_status_t net_linux_netlink_get(sensor_family_t * family, net_linux_t * sysdep,
+                                             int collect) {
+    struct {
+        struct nlmsghdr     nlh;
+        struct ifinfomsg    ifm;
+    }                       req;
+    struct sockaddr_nl      addr;
+    unsigned int            seq = ++(sysdep->nl_seq);
+    int                     done = 0;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nlh.nlmsg_type = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = seq;
+    req.ifm.ifi_family = AF_UNSPEC;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    if (sendto(sysdep->nl_fd, &req, req.nlh.nlmsg_len, 0,
+               (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        LOG_VERBOSE(family->log, "netlink RTM_GETLINK request: %s", strerror(errno));
+        return SENSOR_ERROR;
+    }
 
-    if (priv != NULL && priv->sysdep != NULL) {
-        net_linux_t * sysdep = (net_linux_t *) priv->sysdep;
+    while (!done) {
+        struct nlmsghdr *   nlh;
+        ssize_t             n;
+        int                 len;
 
-        if (sysdep->stat != NULL) {
-            fclose(sysdep->stat);
-            sysdep->stat = NULL;
+        if ((n = recv(sysdep->nl_fd, sysdep->nl_buf, sysdep->nl_bufsz, MSG_TRUNC)) < 0) {
+            if (errno == EINTR)
+                continue ;
+            LOG_VERBOSE(family->log, "netlink RTM_GETLINK dump: %s", strerror(errno));
+            return SENSOR_ERROR;
+        }
+        if ((size_t) n > sysdep->nl_bufsz) {
+            /* message lost: grow the buffer for the next pass, the rest of
+             * this dump will be ignored thanks to its sequence number */
+            char * buf;
+
+            if ((buf = realloc(sysdep->nl_buf, n)) != NULL) {
+                sysdep->nl_buf = buf;
+                sysdep->nl_bufsz = n;
+            }
+            LOG_VERBOSE(family->log, "netlink RTM_GETLINK dump truncated (%zd bytes)", n);
+            return SENSOR_ERROR;
+        }
+
+        for (len = n, nlh = (struct nlmsghdr *) sysdep->nl_buf;
+             NLMSG_OK(nlh, (unsigned int) len); nlh = NLMSG_NEXT(nlh, len)) {
+            struct ifinfomsg *  ifm;
+            struct rtattr *     rta;
+            int                 rta_len;
+            network_iface_t     stats;
+            int                 has_stats64 = 0;
+
+            if (nlh->nlmsg_seq != seq) {
+                continue ; /* late message of a previous failed dump */
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                done = 1;
+                break ;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                LOG_VERBOSE(family->log, "netlink RTM_GETLINK dump error");
+                return SENSOR_ERROR;
+            }
+            if (nlh->nlmsg_type != RTM_NEWLINK
+            ||  nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifm))) {
+                continue ;
+            }
+
+            ifm = (struct ifinfomsg *) NLMSG_DATA(nlh);
+            memset(&stats, 0, sizeof(stats));
+            stats.ifindex = ifm->ifi_index;
+
+            for (rta = IFLA_RTA(ifm), rta_len = IFLA_PAYLOAD(nlh);
+                 RTA_OK(rta, rta_len); rta = RTA_NEXT(rta, rta_len)) {
+                if (rta->rta_type == IFLA_IFNAME) {
+                    size_t sz = RTA_PAYLOAD(rta);
+
+                    if (sz >= sizeof(stats.name))
+                        sz = sizeof(stats.name) - 1;
+                    memcpy(stats.name, RTA_DATA(rta), sz);
+                    stats.name[sz] = 0;
+                } else if (rta->rta_type == IFLA_STATS64
+                       &&  RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+                    struct rtnl_link_stats64 st;
+
+                    /* attribute payload is only 4-bytes aligned */
+                    memcpy(&st, RTA_DATA(rta), sizeof(st));
+                    stats.ibytes = st.rx_bytes;
+                    stats.obytes = st.tx_bytes;
+                    stats.ipackets = st.rx_packets;
+                    stats.opackets = st.tx_packets;
+                    stats.ierrors = st.rx_errors;
+                    stats.oerrors = st.tx_errors;
+                    stats.idrops = st.rx_dropped;
+                    stats.odrops = st.tx_dropped;
+                    has_stats64 = 1;
+                } else if (rta->rta_type == IFLA_STATS && !has_stats64
+                       &&  RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats)) {
+                    struct rtnl_link_stats st;
+
+                    memcpy(&st, RTA_DATA(rta), sizeof(st));
+                    stats.ibytes = st.rx_bytes;
+                    stats.obytes = st.tx_bytes;
+                    stats.ipackets = st.rx_packets;
+                    stats.opackets = st.tx_packets;
+                    stats.ierrors = st.rx_errors;
+                    stats.oerrors = st.tx_errors;
+                    stats.idrops = st.rx_dropped;
+                    stats.odrops = st.tx_dropped;
+                }
+            }
+            if (*stats.name == 0)
+                continue ;
+
+            LOG_SCREAM(family->log, "netlink %s (%d): in %lu out %lu", stats.name, stats.ifindex,
+                       (unsigned long) stats.ibytes, (unsigned long) stats.obytes);
+
+            net_linux_store(family, sysdep, &stats, (ifm->ifi_flags & IFF_LOOPBACK) == 0, collect);
         }
-        if (sysdep->stat_line != NULL)
-            free(sysdep->stat_line);
-        sysdep->stat_line = NULL;
-        priv->sysdep = NULL;
-        free(sysdep);
     }
+
     return SENSOR_SUCCESS;
 }
 
 /* ************************************************************************ */
-sensor_status_t     sysdep_network_get(
-                        sensor_family_t *   family,
-                        network_data_t *    data,
-                        struct timeval *    elapsed) {
-    network_priv_t *priv = (family->priv);
-    net_linux_t *   sysdep = priv->sysdep;
-    ssize_t         linesz;
-    uint64_t total_ibytes = 0;
-    uint64_t total_obytes = 0;
-    uint64_t phy_ibytes = 0;
-    uint64_t phy_obytes = 0;
+static FILE * net_linux_procfs_open(sensor_family_t * family) {
+    char path[PATH_MAX];
 
-    if (priv->sysdep == NULL) {
-        LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
-        errno = EFAULT;
-        return SENSOR_ERROR;
-    }
+    snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), NET_DEV_FILE);
+    return fopen(path, "r");
+}
+
+/* ************************************************************************ */
+/** get the counters of all interfaces by parsing /proc/net/dev */
+static sensor_status_t net_linux_procfs_get(sensor_family_t * family, net_linux_t * sysdep,
+                                            int collect) {
+    ssize_t         linesz;
 
     if (sysdep->stat == NULL || fseek(sysdep->stat, 0, SEEK_SET) != 0) {
         if (sysdep->stat != NULL)
             fclose(sysdep->stat);
-        if ((sysdep->stat = fopen(NET_DEV_FILE, "r")) == NULL) {
+        if ((sysdep->stat = net_linux_procfs_open(family)) == NULL) {
             return SENSOR_ERROR;
         }
     }
 
+    /* one buffered read of the file, except with hundreds of interfaces */
+    sensor_family_stats_reads(family, 1);
     while ((linesz = getline(&sysdep->stat_line, &sysdep->stat_linesz, sysdep->stat)) > 0) {
         char * line = sysdep->stat_line;
         const char * token, * value, * next = line;
         ssize_t tok_len, val_len;
         size_t maxlen;
         unsigned int val_idx = 0;
-        int phys;
+        network_iface_t stats;
 
         if (sysdep->stat_line == NULL)
             break ;
 
         if (sysdep->stat_line[linesz - 1] == '\n')
             sysdep->stat_line[--linesz] = 0;
-            
+
         /* /proc/net/dev format: {
          * Inter-|   Receive                                                |  Transmit
          * face  |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed
@@ -167,103 +341,262 @@ sensor_status_t     sysdep_network_get(
         if (tok_len == 0 || *next == 0)
             continue ;
 
-        phys = (strncasecmp(token, "lo", tok_len) != 0);
+        memset(&stats, 0, sizeof(stats));
+        if ((size_t) tok_len >= sizeof(stats.name))
+            tok_len = sizeof(stats.name) - 1;
+        memcpy(stats.name, token, tok_len);
+        stats.name[tok_len] = 0;
 
         /* get values */
         while((val_len = strtok_ro_r(&value, " ", &next, &maxlen, 0)) > 0 || *next) {
-            //uint64_t lo_ibytes = 0;
-            //uint64_t lo_obytes = 0;
-            uint64_t ibytes;
-            uint64_t obytes;
+            TYPE_SENSOR_VALUE_ULONG * field = NULL;
 
             if (val_len == 0)
                 continue ;
             switch (val_idx) {
-                case 0:
-                    /* received bytes */
-                    ibytes = strtoul(value, NULL, 0);
-                    total_ibytes += ibytes;
-                    if (phys)
-                        phy_ibytes += ibytes;
-                    break ;
-                case 1:
-                    /* received packets */
-                    break ;
-                case 2:
-                    /* receive errors */
-                    break ;
-                case 3:
-                    /* receive drops */
-                    break ;
-                case 4:
-                    /* receive fifo */
-                    break ;
-                case 5:
-                    /* receive frame */
-                    break ;
-                case 6:
-                    /* receive compressed */
-                    break ;
-                case 7:
-                    /* receive multicast */
-                    break ;
-                case 8:
-                    /* sent bytes */
-                    obytes = strtoul(value, NULL, 0);
-                    total_obytes += obytes;
-                    if (phys)
-                        phy_obytes += obytes;
-                    break ;
-                case 9:
-                    /* sent packets */
-                    break ;
-                case 10:
-                    /* send errs */
-                    break ;
-                case 11:
-                    /* send drops */
-                    break ;
-                case 12:
-                    /* send fifos */
-                    break ;
-                case 13:
-                    /* send colls */
-                    break ;
-                case 14:
-                    /* send carrier */
-                    break ;
-                case 15:
-                    /* send compressed */
-                    break ;
+                case 0:  field = &stats.ibytes;   break ; /* received bytes */
+                case 1:  field = &stats.ipackets; break ; /* received packets */
+                case 2:  field = &stats.ierrors;  break ; /* receive errors */
+                case 3:  field = &stats.idrops;   break ; /* receive drops */
+                /* 4..7: receive fifo, frame, compressed, multicast */
+                case 8:  field = &stats.obytes;   break ; /* sent bytes */
+                case 9:  field = &stats.opackets; break ; /* sent packets */
+                case 10: field = &stats.oerrors;  break ; /* send errs */
+                case 11: field = &stats.odrops;   break ; /* send drops */
+                /* 12..15: send fifos, colls, carrier, compressed */
             }
+            if (field != NULL)
+                *field = strtoul(value, NULL, 0);
 
             ++val_idx;
         }
-            ; /* nothing */
-        if (val_len == 0)
-            continue ;
+
+        net_linux_store(family, sysdep, &stats, strcmp(stats.name, "lo") != 0, collect);
     }
 
-    if (elapsed == NULL) {
-        data->ibytespersec = 0;
-        data->obytespersec = 0;
-        data->phy_ibytespersec = 0;
-        data->phy_obytespersec = 0;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+static sensor_status_t net_linux_handle_event(sensor_common_event_t * event, void * user_data) {
+    sensor_family_t *   family = (sensor_family_t *) user_data;
+    network_priv_t *    priv = (family->priv);
+    net_linux_t *       sysdep = (net_linux_t *) priv->sysdep;
+
+    // Only net devices are processed. Please ensure that the call to
+    // linux_common_udev_monitor_update() in sysdep_network_init() below matches
+    // with this check, otherwise the queue won't be emptied.
+    if (event->type != CQT_DEVICE || event->u.dev.type == NULL
+    ||  fnmatch(NET_UDEV_SUBSYSTEM "/*", event->u.dev.type, FNM_CASEFOLD) != 0) {
+        return SENSOR_NOT_SUPPORTED;
+    }
+
+    LOG_DEBUG(family->log, "queue: processing interface %s event: %s (%s)",
+              event->u.dev.action == CDA_ADD ? "add" : "remove", event->u.dev.name, event->u.dev.type);
+
+    /* the set of interfaces is rebuilt from the next pass */
+    sysdep->changed = 1;
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_network_support(sensor_family_t * family, const char * label) {
+    (void) label;
+    (void) family;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_network_init(sensor_family_t * family) {
+    network_priv_t *priv = (family->priv);
+    net_linux_t *   sysdep;
+
+    if (priv->sysdep != NULL) {
+        return SENSOR_SUCCESS;
+    }
+
+    priv->sysdep = calloc(1, sizeof(net_linux_t));
+    if (priv->sysdep == NULL) {
+        LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
+        errno=ENOMEM;
+        return SENSOR_ERROR;
+    }
+
+    sysdep = priv->sysdep;
+    sysdep->nl_fd = -1;
+    sysdep->stat_line = NULL;
+    sysdep->stat_linesz = 0;
+
+    /* netlink gives the live interfaces, not the ones of sensor_init_sysroot() */
+    if (*sensor_sysroot(family) != 0
+    ||  (sysdep->nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE)) < 0
+    ||  (sysdep->nl_buf = malloc(NET_NETLINK_BUFSZ_MIN)) == NULL) {
+        LOG_VERBOSE(family->log, "cannot use netlink, using %s", NET_DEV_FILE);
+        if (sysdep->nl_fd >= 0)
+            close(sysdep->nl_fd);
+        sysdep->nl_fd = -1;
     } else {
-        data->ibytespersec = (((total_ibytes - data->ibytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->obytespersec = (((total_obytes - data->obytes) * 1000)
-                                / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_ibytespersec = (((phy_ibytes - data->phy_ibytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
-        data->phy_obytespersec = (((phy_obytes - data->phy_obytes) * 1000)
-                                    / (elapsed->tv_sec * 1000 + elapsed->tv_usec / 1000));
+        sysdep->nl_bufsz = NET_NETLINK_BUFSZ_MIN;
+    }
+    if (sysdep->nl_fd < 0 && (sysdep->stat = net_linux_procfs_open(family)) == NULL) {
+        LOG_ERROR(family->log, "error while openning %s", NET_DEV_FILE);
+        errno=ENOENT;
+        return SENSOR_ERROR;
     }
 
-    data->ibytes = total_ibytes;
-    data->obytes = total_obytes;
-    data->phy_ibytes = phy_ibytes;
-    data->phy_obytes = phy_obytes;
+    if (*sensor_sysroot(family) == 0
+    &&  linux_common_udev_monitor_update(
+            sensor_family_common(family->sctx),
+            NET_UDEV_SUBSYSTEM,
+            NULL,
+            NULL) == SENSOR_SUCCESS) {
+        sysdep->monitored = 1;
+    } else {
+        LOG_VERBOSE(family->log, "cannot monitor udev %s, interfaces checked by updates only",
+                    NET_UDEV_SUBSYSTEM);
+    }
+
+    /* first pass: get the set of interfaces, used when sensors are listed */
+    sysdep->changed = 1;
+    if (sysdep_network_get(family, &(priv->network_data), NULL) == SENSOR_ERROR) {
+        return SENSOR_ERROR;
+    }
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_network_destroy(sensor_family_t * family) {
+    network_priv_t * priv = (network_priv_t *) family->priv;
+
+    if (priv != NULL && priv->sysdep != NULL) {
+        net_linux_t * sysdep = (net_linux_t *) priv->sysdep;
+
+        if (sysdep->nl_fd >= 0) {
+            close(sysdep->nl_fd);
+            sysdep->nl_fd = -1;
+        }
+        if (sysdep->nl_buf != NULL)
+            free(sysdep->nl_buf);
+        if (sysdep->stat != NULL) {
+            fclose(sysdep->stat);
+            sysdep->stat = NULL;
+        }
+        if (sysdep->stat_line != NULL)
+            free(sysdep->stat_line);
+        sysdep->stat_line = NULL;
+        if (sysdep->next != NULL)
+            free(sysdep->next);
+        priv->sysdep = NULL;
+        free(sysdep);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** give the interfaces collected during the pass to network_priv_t.iface_next
+ * if they differ from the current ones */
+static sensor_status_t net_linux_update_ifaces(sensor_family_t * family, net_linux_t * sysdep) {
+    network_priv_t *    priv = (network_priv_t *) family->priv;
+    network_iface_t *   next;
+    unsigned int        i;
+
+    sysdep->changed = 0;
+    if (sysdep->nb_next == priv->nb_ifaces) {
+        for (i = 0; i < priv->nb_ifaces; ++i) {
+            if (sysdep->next[i].ifindex != priv->iface_data[i].ifindex
+            ||  strcmp(sysdep->next[i].name, priv->iface_data[i].name) != 0)
+                break ;
+        }
+        if (i == priv->nb_ifaces && priv->iface_next == NULL) {
+            return SENSOR_SUCCESS;
+        }
+    }
+    if (sysdep->nb_next == 0) {
+        next = NULL;
+    } else if ((next = malloc(sysdep->nb_next * sizeof(*next))) == NULL) {
+        LOG_WARN(family->log, "%s(): cannot allocate interfaces", __func__);
+        sysdep->changed = 1;
+        return SENSOR_ERROR;
+    } else {
+        memcpy(next, sysdep->next, sysdep->nb_next * sizeof(*next));
+    }
+    if (priv->iface_next != NULL)
+        free(priv->iface_next);
+    priv->iface_next = next;
+    priv->nb_ifaces_next = sysdep->nb_next;
+
+    LOG_VERBOSE(family->log, "set of interfaces changed (%u -> %u)",
+                priv->nb_ifaces, sysdep->nb_next);
+
+    return SENSOR_RELOAD_FAMILY;
+}
+
+/* ************************************************************************ */
+sensor_status_t     sysdep_network_get(
+                        sensor_family_t *   family,
+                        network_data_t *    data,
+                        struct timeval *    elapsed) {
+    network_priv_t *priv = (family->priv);
+    net_linux_t *   sysdep = priv->sysdep;
+    sensor_status_t ret;
+    int             collect;
+
+    if (priv->sysdep == NULL) {
+        LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
+        errno = EFAULT;
+        return SENSOR_ERROR;
+    }
+
+    if (sysdep->monitored) {
+        sensor_common_queue_process(family->sctx, net_linux_handle_event, family);
+    }
+
+    collect = sysdep->changed;
+    sysdep->nb_next = 0;
+    sysdep->hint = 0;
+    sysdep->matched = 0;
+    sysdep->unknown = 0;
+    sysdep->total_ibytes = 0;
+    sysdep->total_obytes = 0;
+    sysdep->phy_ibytes = 0;
+    sysdep->phy_obytes = 0;
+
+    ret = SENSOR_ERROR;
+    if (sysdep->nl_fd >= 0) {
+        ret = net_linux_netlink_get(family, sysdep, collect);
+    }
+    if (ret != SENSOR_SUCCESS) {
+        /* the dump could have been partially read */
+        sysdep->nb_next = 0;
+        sysdep->hint = 0;
+        sysdep->matched = 0;
+        sysdep->unknown = 0;
+        sysdep->total_ibytes = 0;
+        sysdep->total_obytes = 0;
+        sysdep->phy_ibytes = 0;
+        sysdep->phy_obytes = 0;
+        if ((ret = net_linux_procfs_get(family, sysdep, collect)) != SENSOR_SUCCESS) {
+            return ret;
+        }
+    }
+
+    /* rates are computed by the family */
+    (void) elapsed;
+    data->ibytes = sysdep->total_ibytes;
+    data->obytes = sysdep->total_obytes;
+    data->phy_ibytes = sysdep->phy_ibytes;
+    data->phy_obytes = sysdep->phy_obytes;
+
+    if (collect) {
+        return net_linux_update_ifaces(family, sysdep);
+    }
+    /* without udev events (no udev, no udevd in containers, netns moves),
+     * interfaces changes are seen by the pass itself */
+    if (sysdep->unknown > 0 || sysdep->matched != priv->nb_ifaces) {
+        sysdep->changed = 1;
+    }
 
     return SENSOR_SUCCESS;
 }
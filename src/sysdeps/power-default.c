@@ -21,9 +21,26 @@
  */
 #include "libvsensors/sensor.h"
 
+#include "power_private.h"
+
 sensor_status_t sysdep_power_support(sensor_family_t * family, const char * label) {
     (void)family;
     (void)label;
     return SENSOR_ERROR;
 }
 
+sensor_status_t sysdep_power_init(sensor_family_t * family) {
+    (void)family;
+    return SENSOR_ERROR;
+}
+
+sensor_status_t sysdep_power_get(sensor_family_t * family) {
+    (void)family;
+    return SENSOR_ERROR;
+}
+
+sensor_status_t sysdep_power_destroy(sensor_family_t * family) {
+    (void)family;
+    return SENSOR_SUCCESS;
+}
+
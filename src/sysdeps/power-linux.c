@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2020 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * power linux implementation for Generic Sensor Management Library.
+ */
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "vlib/util.h"
+
+#include "power_private.h"
+#include "sensor_private.h"
+
+/* ************************************************************************ */
+#ifndef POWER_SUPPLY_DIR
+#define POWER_SUPPLY_DIR        "/sys/class/power_supply"
+#endif
+#ifndef POWERCAP_DIR
+#define POWERCAP_DIR            "/sys/class/powercap"
+#endif
+#define POWERCAP_RAPL_PREFIX    "intel-rapl"
+
+/** power_supply files read at each update */
+typedef enum {
+    PLF_ONLINE = 0,
+    PLF_CAPACITY,
+    PLF_STATUS,
+    PLF_POWER_NOW,
+    PLF_CURRENT_NOW,
+    PLF_VOLTAGE_NOW,
+    PLF_NB
+} power_linux_file_t;
+
+static const char * s_power_supply_files[PLF_NB] = {
+    "online", "capacity", "status", "power_now", "current_now", "voltage_now"
+};
+
+typedef struct {
+    int             fds[PLF_NB];
+} power_linux_supply_t;
+
+typedef struct {
+    /* persistent fds, read with pread(), same indexes as priv->supplies and priv->energies */
+    power_linux_supply_t *  supplies;
+    int *                   energy_fds;
+} sysdep_t;
+
+/* ************************************************************************ */
+/** read a sysfs attribute with a persistent fd, without the ending newline */
+static ssize_t power_linux_pread(int fd, char * buf, size_t size) {
+    ssize_t n;
+
+    while ((n = pread(fd, buf, size - 1, 0)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+    if (n < 0)
+        return -1;
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+        --n;
+    buf[n] = 0;
+    return n;
+}
+
+static int power_linux_pread_ull(int fd, unsigned long long * value) {
+    char    buf[32];
+    char *  end;
+
+    if (fd < 0 || power_linux_pread(fd, buf, sizeof(buf)) <= 0)
+        return 0;
+    errno = 0;
+    *value = strtoull(buf, &end, 10);
+    return errno == 0 && end != buf;
+}
+
+/** power_linux_pread_ull() counting the reads done */
+static int power_linux_get_ull(int fd, unsigned long long * value, unsigned int * reads) {
+    if (fd < 0)
+        return 0;
+    ++(*reads);
+    return power_linux_pread_ull(fd, value);
+}
+
+/** read once a sysfs attribute of dir/name */
+static ssize_t power_linux_read_file(const char * dir, const char * name, const char * file,
+                                     char * buf, size_t size) {
+    char    path[PATH_MAX];
+    ssize_t n;
+    int     fd;
+
+    snprintf(path, sizeof(path), "%s/%s/%s", dir, name, file);
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    n = power_linux_pread(fd, buf, size);
+    close(fd);
+    return n;
+}
+
+static int power_linux_open(const char * dir, const char * name, const char * file) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s/%s", dir, name, file);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* ************************************************************************ */
+/** add the supplies of POWER_SUPPLY_DIR */
+static void power_linux_init_supplies(sensor_family_t * family) {
+    power_priv_t *  priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    struct dirent * dirent;
+    DIR *           dir;
+    char            root[PATH_MAX];
+
+    snprintf(root, sizeof(root), "%s%s", sensor_sysroot(family), POWER_SUPPLY_DIR);
+    if ((dir = opendir(root)) == NULL) {
+        LOG_VERBOSE(family->log, "cannot open %s: %s", root, strerror(errno));
+        return ;
+    }
+    while ((dirent = readdir(dir)) != NULL) {
+        power_linux_supply_t    sys_supply;
+        power_supply_t          supply;
+        void *                  ptr;
+
+        if (*dirent->d_name == '.' || strlen(dirent->d_name) >= sizeof(supply.name))
+            continue ;
+
+        memset(&supply, 0, sizeof(supply));
+        str0cpy(supply.name, dirent->d_name, sizeof(supply.name));
+        for (unsigned int i = 0; i < PLF_NB; ++i) {
+            sys_supply.fds[i] = power_linux_open(root, dirent->d_name, s_power_supply_files[i]);
+        }
+        if (sys_supply.fds[PLF_ONLINE] >= 0)
+            supply.flags |= PSF_ONLINE;
+        if (sys_supply.fds[PLF_CAPACITY] >= 0)
+            supply.flags |= PSF_CAPACITY;
+        if (sys_supply.fds[PLF_STATUS] >= 0)
+            supply.flags |= PSF_CHARGING;
+        if (sys_supply.fds[PLF_POWER_NOW] >= 0
+        ||  (sys_supply.fds[PLF_CURRENT_NOW] >= 0 && sys_supply.fds[PLF_VOLTAGE_NOW] >= 0))
+            supply.flags |= PSF_WATTS;
+
+        if (supply.flags == PSF_NONE
+        ||  (ptr = realloc(priv->supplies, (priv->nb_supplies + 1) * sizeof(*priv->supplies))) == NULL
+        ||  (priv->supplies = ptr, 0)
+        ||  (ptr = realloc(sysdep->supplies, (priv->nb_supplies + 1) * sizeof(*sysdep->supplies))) == NULL) {
+            for (unsigned int i = 0; i < PLF_NB; ++i) {
+                if (sys_supply.fds[i] >= 0)
+                    close(sys_supply.fds[i]);
+            }
+            continue ;
+        }
+        sysdep->supplies = ptr;
+        sysdep->supplies[priv->nb_supplies] = sys_supply;
+        priv->supplies[priv->nb_supplies++] = supply;
+        LOG_VERBOSE(family->log, "added power supply %s", supply.name);
+    }
+    closedir(dir);
+}
+
+/* ************************************************************************ */
+/** add the RAPL zones of POWERCAP_DIR: intel-rapl:<package>[:<subzone>] */
+static void power_linux_init_energies(sensor_family_t * family) {
+    power_priv_t *  priv = (family->priv);
+    sysdep_t *      sysdep = (sysdep_t *) priv->sysdep;
+    struct dirent * dirent;
+    DIR *           dir;
+    char            root[PATH_MAX];
+
+    snprintf(root, sizeof(root), "%s%s", sensor_sysroot(family), POWERCAP_DIR);
+    if ((dir = opendir(root)) == NULL) {
+        LOG_VERBOSE(family->log, "cannot open %s: %s", root, strerror(errno));
+        return ;
+    }
+    while ((dirent = readdir(dir)) != NULL) {
+        power_energy_t          energy;
+        char                    zone[POWER_NAME_SZ / 2], parent[POWER_NAME_SZ / 2];
+        char                    buf[32];
+        const char *            sep;
+        unsigned long long      max;
+        void *                  ptr;
+        int                     fd;
+
+        /* the control type directory (intel-rapl) has no energy counter */
+        if (strncmp(dirent->d_name, POWERCAP_RAPL_PREFIX, PTR_COUNT(POWERCAP_RAPL_PREFIX) - 1) != 0
+        ||  (sep = strchr(dirent->d_name, ':')) == NULL) {
+            continue ;
+        }
+        if ((fd = power_linux_open(root, dirent->d_name, "energy_uj")) < 0) {
+            /* energy_uj is only readable by root on recent kernels */
+            LOG_VERBOSE(family->log, "cannot open %s/%s/energy_uj: %s",
+                        root, dirent->d_name, strerror(errno));
+            continue ;
+        }
+        if (power_linux_read_file(root, dirent->d_name, "name", zone, sizeof(zone)) <= 0)
+            str0cpy(zone, dirent->d_name, sizeof(zone));
+
+        memset(&energy, 0, sizeof(energy));
+        if ((sep = strrchr(dirent->d_name, ':')) != strchr(dirent->d_name, ':')) {
+            /* subzone: prefixed by the name of its package */
+            char pkg[PATH_MAX];
+
+            snprintf(pkg, sizeof(pkg), "%.*s", (int) (sep - dirent->d_name), dirent->d_name);
+            if (power_linux_read_file(root, pkg, "name", parent, sizeof(parent)) <= 0)
+                str0cpy(parent, pkg, sizeof(parent));
+            snprintf(energy.name, sizeof(energy.name), "%s %s", parent, zone);
+        } else {
+            str0cpy(energy.name, zone, sizeof(energy.name));
+        }
+        /* other control types (intel-rapl-mmio) can have the same zone names */
+        for (unsigned int i = 0; i < priv->nb_energies; ++i) {
+            if (strcmp(priv->energies[i].name, energy.name) == 0) {
+                str0cpy(energy.name, dirent->d_name, sizeof(energy.name));
+                break ;
+            }
+        }
+        if (power_linux_read_file(root, dirent->d_name, "max_energy_range_uj", buf, sizeof(buf)) > 0
+        &&  (max = strtoull(buf, NULL, 10)) > 0) {
+            energy.max_energy_uj = max;
+        } else {
+            energy.max_energy_uj = UINT64_MAX;
+        }
+
+        if ((ptr = realloc(priv->energies, (priv->nb_energies + 1) * sizeof(*priv->energies))) == NULL
+        ||  (priv->energies = ptr, 0)
+        ||  (ptr = realloc(sysdep->energy_fds, (priv->nb_energies + 1) * sizeof(*sysdep->energy_fds))) == NULL) {
+            close(fd);
+            continue ;
+        }
+        sysdep->energy_fds = ptr;
+        sysdep->energy_fds[priv->nb_energies] = fd;
+        energy.rate = (sensor_rate_t) SENSOR_RATE_INITIALIZER;
+        priv->energies[priv->nb_energies++] = energy;
+        LOG_VERBOSE(family->log, "added energy counter %s (%s), max %llu uJ",
+                    energy.name, dirent->d_name, (unsigned long long) energy.max_energy_uj);
+    }
+    closedir(dir);
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_power_support(sensor_family_t * family, const char * label) {
+    (void)family;
+    (void)label;
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_power_init(sensor_family_t * family) {
+    power_priv_t *  priv = (family->priv);
+
+    if (priv->sysdep != NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if ((priv->sysdep = calloc(1, sizeof(sysdep_t))) == NULL) {
+        LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
+        errno = ENOMEM;
+        return SENSOR_ERROR;
+    }
+
+    power_linux_init_supplies(family);
+    power_linux_init_energies(family);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_power_destroy(sensor_family_t * family) {
+    power_priv_t * priv = (power_priv_t *) family->priv;
+
+    if (priv != NULL && priv->sysdep != NULL) {
+        sysdep_t * sysdep = (sysdep_t *) priv->sysdep;
+
+        for (unsigned int i = 0; sysdep->supplies != NULL && i < priv->nb_supplies; ++i) {
+            for (unsigned int i_file = 0; i_file < PLF_NB; ++i_file) {
+                if (sysdep->supplies[i].fds[i_file] >= 0)
+                    close(sysdep->supplies[i].fds[i_file]);
+            }
+        }
+        for (unsigned int i = 0; sysdep->energy_fds != NULL && i < priv->nb_energies; ++i) {
+            close(sysdep->energy_fds[i]);
+        }
+        if (sysdep->supplies != NULL)
+            free(sysdep->supplies);
+        if (sysdep->energy_fds != NULL)
+            free(sysdep->energy_fds);
+
+        priv->sysdep = NULL;
+        free(sysdep);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_power_get(sensor_family_t * family) {
+    power_priv_t *      priv = (family->priv);
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    unsigned long long  value, voltage;
+    unsigned int        reads = 0;
+
+    if (sysdep == NULL) {
+        LOG_ERROR(family->log, "error, bad %s sysdep data", family->info->name);
+        errno = EFAULT;
+        return SENSOR_ERROR;
+    }
+
+    for (unsigned int i = 0; i < priv->nb_supplies; ++i) {
+        power_supply_t *    supply = &(priv->supplies[i]);
+        const int *         fds = sysdep->supplies[i].fds;
+        char                buf[32];
+
+        if (power_linux_get_ull(fds[PLF_ONLINE], &value, &reads))
+            supply->online = value != 0;
+        if (power_linux_get_ull(fds[PLF_CAPACITY], &value, &reads))
+            supply->capacity = value > 100 ? 100 : value;
+        if (fds[PLF_STATUS] >= 0) {
+            ++reads;
+            if (power_linux_pread(fds[PLF_STATUS], buf, sizeof(buf)) > 0)
+                supply->charging = strcasecmp(buf, "Charging") == 0;
+        }
+        /* power_now in uW, or current_now in uA and voltage_now in uV */
+        if (power_linux_get_ull(fds[PLF_POWER_NOW], &value, &reads)) {
+            supply->watts = value / 1000000.0;
+        } else if (power_linux_get_ull(fds[PLF_CURRENT_NOW], &value, &reads)
+               &&  power_linux_get_ull(fds[PLF_VOLTAGE_NOW], &voltage, &reads)) {
+            supply->watts = ((double) value * (double) voltage) / 1000000000000.0;
+        }
+    }
+    for (unsigned int i = 0; i < priv->nb_energies; ++i) {
+        if (power_linux_get_ull(sysdep->energy_fds[i], &value, &reads)) {
+            priv->energies[i].energy_uj = value;
+        } else {
+            LOG_DEBUG(family->log, "cannot read energy of %s", priv->energies[i].name);
+        }
+    }
+    sensor_family_stats_reads(family, reads);
+
+    return SENSOR_SUCCESS;
+}
+
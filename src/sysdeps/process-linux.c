@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2023 Vincent Sallaberry
+ * libvsensors <https://github.com/vsallaberry/libvsensors>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/* ------------------------------------------------------------------------
+ * per-process linux implementation for Generic Sensor Management Library.
+ * /proc is listed with getdents64() on a cached directory fd, and each
+ * <pid>/stat is opened relative to it. Processes seen in several scans keep
+ * their stat file opened, a scan then only costs a pread() for them.
+ */
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "libvsensors/sensor.h"
+#include "vlib/util.h"
+
+#include "process_private.h"
+#include "sensor_private.h"
+
+/* ************************************************************************ */
+#define PROCESS_PROC_DIR            "/proc"
+/** scans a process must be seen in before its stat file stays opened */
+#define PROCESS_LINUX_PERSIST_SCANS 2
+/** maximum number of stat files kept opened, and part of RLIMIT_NOFILE used */
+#define PROCESS_LINUX_MAX_FDS       1024
+#define PROCESS_LINUX_RLIMIT_DIV    4
+/** size of the getdents64() buffer and of a <pid>/stat file read */
+#define PROCESS_LINUX_DENTS_SZ      32768
+#define PROCESS_LINUX_STAT_SZ       1024
+
+/** getdents64() entry */
+struct process_linux_dirent64 {
+    uint64_t        d_ino;
+    int64_t         d_off;
+    unsigned short  d_reclen;
+    unsigned char   d_type;
+    char            d_name[];
+};
+
+/** a process known by the previous scan */
+typedef struct {
+    pid_t           pid;
+    int             fd;         /* opened <pid>/stat, or -1 */
+    unsigned int    nb_scans;   /* number of scans it was seen in */
+    uint64_t        cpu_ticks;  /* utime + stime */
+} process_entry_t;
+
+typedef struct {
+    int                 proc_fd;
+    long                clk_tck;
+    uint64_t            page_size;
+    unsigned int        max_fds;
+    unsigned int        nb_fds;
+    /* entries sorted by pid, and the ones being built by the current scan */
+    process_entry_t *   entries;
+    unsigned int        nb_entries;
+    unsigned int        alloc_entries;
+    process_entry_t *   next;
+    unsigned int        alloc_next;
+    char                dents[PROCESS_LINUX_DENTS_SZ] __attribute__ ((aligned(8)));
+} sysdep_t;
+
+/* ************************************************************************ */
+sensor_status_t sysdep_process_support(sensor_family_t * family, const char * label) {
+    char path[PATH_MAX];
+    (void)label;
+
+    snprintf(path, sizeof(path), "%s%s/self/stat", sensor_sysroot(family), PROCESS_PROC_DIR);
+    return access(path, R_OK) == 0 ? SENSOR_SUCCESS : SENSOR_NOT_SUPPORTED;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_process_destroy(sensor_family_t * family) {
+    process_priv_t * priv = (process_priv_t *) family->priv;
+
+    if (priv != NULL && priv->sysdep != NULL) {
+        sysdep_t * sysdep = (sysdep_t *) priv->sysdep;
+
+        for (unsigned int i = 0; i < sysdep->nb_entries; ++i) {
+            if (sysdep->entries[i].fd >= 0)
+                close(sysdep->entries[i].fd);
+        }
+        if (sysdep->entries != NULL)
+            free(sysdep->entries);
+        if (sysdep->next != NULL)
+            free(sysdep->next);
+        if (sysdep->proc_fd >= 0)
+            close(sysdep->proc_fd);
+        priv->sysdep = NULL;
+        free(sysdep);
+    }
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_process_init(sensor_family_t * family) {
+    process_priv_t *    priv = (process_priv_t *) family->priv;
+    char                path[PATH_MAX];
+    struct rlimit       rlim;
+    sysdep_t *          sysdep;
+    long                page_size;
+
+    if (priv->sysdep != NULL) {
+        return SENSOR_SUCCESS;
+    }
+    if ((sysdep = calloc(1, sizeof(sysdep_t))) == NULL) {
+        LOG_ERROR(family->log, "error, cannot malloc %s sysdep data", family->info->name);
+        return SENSOR_ERROR;
+    }
+    priv->sysdep = sysdep;
+
+    snprintf(path, sizeof(path), "%s%s", sensor_sysroot(family), PROCESS_PROC_DIR);
+    if ((sysdep->proc_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+        LOG_WARN(family->log, "cannot open %s: %s", path, strerror(errno));
+        sysdep_process_destroy(family);
+        return SENSOR_ERROR;
+    }
+    if ((sysdep->clk_tck = sysconf(_SC_CLK_TCK)) <= 0)
+        sysdep->clk_tck = 100;
+    sysdep->page_size = (page_size = sysconf(_SC_PAGESIZE)) > 0 ? page_size : 4096;
+
+    sysdep->max_fds = PROCESS_LINUX_MAX_FDS;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY
+    &&  rlim.rlim_cur / PROCESS_LINUX_RLIMIT_DIV < sysdep->max_fds) {
+        sysdep->max_fds = rlim.rlim_cur / PROCESS_LINUX_RLIMIT_DIV;
+    }
+    LOG_VERBOSE(family->log, "%u process stat files can stay opened", sysdep->max_fds);
+
+    return SENSOR_SUCCESS;
+}
+
+/* ************************************************************************ */
+/** value of the field index of a stat line, after the ") " ending the name
+ * (field 2): the first one is the state (field 3) */
+static uint64_t process_linux_stat_field(const char ** pfields, unsigned int * pindex,
+                                         unsigned int index) {
+    const char *    s = *pfields;
+    uint64_t        value = 0;
+
+    for ( ; *pindex < index; ++(*pindex)) {
+        while (*s != ' ' && *s != 0)
+            ++s;
+        if (*s == 0)
+            break ;
+        ++s;
+    }
+    for ( ; *s >= '0' && *s <= '9'; ++s) {
+        value = value * 10 + (*s - '0');
+    }
+    *pfields = s;
+    return value;
+}
+
+/* ************************************************************************ */
+/** parse <pid>/stat without allocation: "pid (name) state ppid ... utime(14)
+ * stime(15) ... rss(24) ...", the name can contain spaces and parentheses */
+static int process_linux_parse_stat(const char * buf, process_stat_t * stat,
+                                    uint64_t * cpu_ticks, uint64_t page_size) {
+    const char *    name = strchr(buf, '(');
+    const char *    end = strrchr(buf, ')');
+    const char *    fields;
+    unsigned int    index = 3;
+    size_t          len;
+
+    if (name == NULL || end == NULL || end < name || end[1] != ' ') {
+        return -1;
+    }
+    ++name;
+    len = (size_t) (end - name) < sizeof(stat->name) - 1 ? (size_t) (end - name) : sizeof(stat->name) - 1;
+    memcpy(stat->name, name, len);
+    stat->name[len] = 0;
+
+    fields = end + 2;
+    *cpu_ticks = process_linux_stat_field(&fields, &index, 14);
+    *cpu_ticks += process_linux_stat_field(&fields, &index, 15);
+    stat->rss = process_linux_stat_field(&fields, &index, 24) * page_size;
+
+    return 0;
+}
+
+/* ************************************************************************ */
+/** read <pid>/stat with the entry fd, or opened for this read */
+static ssize_t process_linux_read_stat(sensor_family_t * family, process_entry_t * entry,
+                                       const char * pid_name, char * buf, size_t size) {
+    sysdep_t *  sysdep = (sysdep_t *) ((process_priv_t *) family->priv)->sysdep;
+    char        path[32];
+    ssize_t     n;
+    int         fd = entry->fd;
+
+    if (fd >= 0) {
+        while ((n = pread(fd, buf, size - 1, 0)) < 0 && errno == EINTR)
+            ; /* nothing but loop */
+        if (n > 0) {
+            buf[n] = 0;
+            return n;
+        }
+        /* the process exited, and its pid may have been reused */
+        close(fd);
+        entry->fd = -1;
+        --(sysdep->nb_fds);
+        entry->nb_scans = 0;
+    }
+    snprintf(path, sizeof(path), "%s/stat", pid_name);
+    if ((fd = openat(sysdep->proc_fd, path, O_RDONLY | O_CLOEXEC)) < 0) {
+        return -1;
+    }
+    while ((n = pread(fd, buf, size - 1, 0)) < 0 && errno == EINTR)
+        ; /* nothing but loop */
+    if (n > 0 && entry->nb_scans >= PROCESS_LINUX_PERSIST_SCANS && sysdep->nb_fds < sysdep->max_fds) {
+        /* long-lived process: next reads only cost a pread() */
+        entry->fd = fd;
+        ++(sysdep->nb_fds);
+    } else {
+        close(fd);
+    }
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = 0;
+    return n;
+}
+
+/* ************************************************************************ */
+/** entry of pid in the previous scan, hint being the expected index */
+static process_entry_t * process_linux_entry_find(sysdep_t * sysdep, pid_t pid,
+                                                  unsigned int * hint) {
+    unsigned int lo = 0, hi = sysdep->nb_entries;
+
+    /* /proc gives increasing pids: the next entry is usually the one */
+    if (*hint < sysdep->nb_entries && sysdep->entries[*hint].pid == pid) {
+        return &(sysdep->entries[(*hint)++]);
+    }
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if (sysdep->entries[mid].pid == pid) {
+            *hint = mid + 1;
+            return &(sysdep->entries[mid]);
+        }
+        if (sysdep->entries[mid].pid < pid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+/* ************************************************************************ */
+static int process_linux_entry_cmp(const void * va, const void * vb) {
+    const process_entry_t * a = (const process_entry_t *) va;
+    const process_entry_t * b = (const process_entry_t *) vb;
+
+    return a->pid < b->pid ? -1 : (a->pid > b->pid);
+}
+
+/* ************************************************************************ */
+sensor_status_t sysdep_process_scan(sensor_family_t * family) {
+    process_priv_t *    priv = (process_priv_t *) family->priv;
+    sysdep_t *          sysdep = (sysdep_t *) priv->sysdep;
+    char                buf[PROCESS_LINUX_STAT_SZ];
+    unsigned int        nb_next = 0, hint = 0, reads = 0;
+    int                 sorted = 1;
+    long                n;
+
+    if (lseek(sysdep->proc_fd, 0, SEEK_SET) < 0) {
+        return SENSOR_ERROR;
+    }
+    while ((n = syscall(SYS_getdents64, sysdep->proc_fd, sysdep->dents, sizeof(sysdep->dents))) > 0) {
+        ++reads;
+        for (long off = 0; off < n; /* no_incr */) {
+            struct process_linux_dirent64 * dent
+                = (struct process_linux_dirent64 *) (sysdep->dents + off);
+            process_entry_t *   entry, * old;
+            process_stat_t      stat;
+            uint64_t            cpu_ticks;
+            pid_t               pid = 0;
+            const char *        s;
+
+            off += dent->d_reclen;
+            for (s = dent->d_name; *s >= '0' && *s <= '9'; ++s)
+                pid = pid * 10 + (*s - '0');
+            if (*s != 0 || pid <= 0) {
+                continue ;
+            }
+            if (nb_next == sysdep->alloc_next) {
+                unsigned int        alloc = sysdep->alloc_next ? sysdep->alloc_next * 2 : 512;
+                process_entry_t *   next = realloc(sysdep->next, alloc * sizeof(*next));
+
+                if (next == NULL) {
+                    LOG_WARN(family->log, "cannot allocate process entries: %s", strerror(errno));
+                    break ;
+                }
+                sysdep->next = next;
+                sysdep->alloc_next = alloc;
+            }
+            entry = &(sysdep->next[nb_next]);
+            if ((old = process_linux_entry_find(sysdep, pid, &hint)) != NULL) {
+                *entry = *old;
+                old->fd = -1;
+            } else {
+                entry->pid = pid;
+                entry->fd = -1;
+                entry->nb_scans = 0;
+            }
+            if (process_linux_read_stat(family, entry, dent->d_name, buf, sizeof(buf)) < 0
+            ||  process_linux_parse_stat(buf, &stat, &cpu_ticks, sysdep->page_size) != 0) {
+                /* exited */
+                if (entry->fd >= 0) {
+                    close(entry->fd);
+                    --(sysdep->nb_fds);
+                }
+                continue ;
+            }
+            ++reads;
+            /* no cpu usage known before the first scan of the process */
+            stat.pid = pid;
+            stat.cpu_ns = entry->nb_scans == 0 || cpu_ticks < entry->cpu_ticks ? 0
+                          : ((cpu_ticks - entry->cpu_ticks) * 1000000000ULL) / sysdep->clk_tck;
+            entry->cpu_ticks = cpu_ticks;
+            ++(entry->nb_scans);
+            if (nb_next > 0 && sysdep->next[nb_next - 1].pid > pid)
+                sorted = 0;
+            ++nb_next;
+
+            process_found(family, &stat);
+        }
+    }
+    if (n < 0) {
+        LOG_WARN(family->log, "getdents64(%s): %s", PROCESS_PROC_DIR, strerror(errno));
+    }
+
+    /* processes not seen anymore */
+    for (unsigned int i = 0; i < sysdep->nb_entries; ++i) {
+        if (sysdep->entries[i].fd >= 0) {
+            close(sysdep->entries[i].fd);
+            --(sysdep->nb_fds);
+        }
+    }
+    if (!sorted) {
+        qsort(sysdep->next, nb_next, sizeof(*sysdep->next), process_linux_entry_cmp);
+    }
+    /* swap: entries of this scan become the previous ones */
+    {
+        process_entry_t *   entries = sysdep->entries;
+        unsigned int        alloc = sysdep->alloc_entries;
+
+        sysdep->entries = sysdep->next;
+        sysdep->alloc_entries = sysdep->alloc_next;
+        sysdep->nb_entries = nb_next;
+        sysdep->next = entries;
+        sysdep->alloc_next = alloc;
+    }
+    sensor_family_stats_reads(family, reads);
+
+    return n < 0 ? SENSOR_ERROR : SENSOR_SUCCESS;
+}
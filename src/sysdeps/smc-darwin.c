@@ -413,6 +413,56 @@ int             sysdep_smc_readkey(
     return value_size;
 }
 
+/* ************************************************************************ */
+int             sysdep_smc_readkeys(
+                    unsigned int    nb_keys,
+                    const uint32_t * keys,
+                    void ***        key_infos,
+                    void *          output_buffers,
+                    int *           value_sizes,
+                    void *          smc_handle,
+                    log_t *         log)
+{
+    io_connect_t            io_connection = (io_connect_t)((unsigned long)smc_handle);
+    kern_return_t           result;
+    SMCKeyData_t            input_data;
+    SMCKeyData_t *          output_data = (SMCKeyData_t *) output_buffers;
+    int                     nb_read = 0;
+
+    /* AppleSMC has no multi-key command: the (cached) key infos are reused and
+     * the READ_BYTES calls are issued back-to-back with the same input data */
+    memset(&input_data, 0, sizeof(SMCKeyData_t));
+    input_data.data8 = SMC_CMD_READ_BYTES;
+
+    for (unsigned int i = 0; i < nb_keys; ++i) {
+        void ** key_info = key_infos[i];
+
+        if (key_info == NULL || *key_info == NULL) {
+            /* first read of this key: get its key info */
+            if ((value_sizes[i] = sysdep_smc_readkey(keys[i], NULL, key_info, &(output_data[i]),
+                                                     smc_handle, log)) >= 0)
+                ++nb_read;
+            continue ;
+        }
+        input_data.keyInfo = *((SMCKeyData_keyInfo_t *) *key_info);
+        input_data.key = keys[i];
+
+        result = sysdep_smc_call(SMC_IOSERVICE_KERNEL_INDEX, &input_data,
+                                 &(output_data[i]), io_connection, log);
+        if (result != kIOReturnSuccess) {
+            LOG_DEBUG(log, "key '%x': cannot read bytes: %s",
+                      keys[i], sysdep_smc_mach_error_string(result));
+            errno = sysdep_smc_kernreturn_to_errno(result);
+            value_sizes[i] = SMC_ERROR;
+            continue ;
+        }
+        value_sizes[i] = input_data.keyInfo.dataSize;
+        ++nb_read;
+    }
+
+    return nb_read;
+}
+
 /* ************************************************************************ */
 int             sysdep_smc_writekey(
                     uint32_t        key,
@@ -555,3 +605,50 @@ int sysdep_smc_readindex(
     return input_data.keyInfo.dataSize;
 }
 
+
+/* ************************************************************************ */
+int sysdep_smc_keyinfo(
+        uint32_t    key,
+        uint32_t    index,
+        void **     key_info,
+        void *      smc_handle,
+        log_t *     log) {
+    (void)key;
+    (void)index;
+    (void)smc_handle;
+    (void)log;
+
+    if (key_info == NULL)
+        return SMC_ERROR;
+    /* key info is fetched on first sysdep_smc_readkey() */
+    *key_info = NULL;
+
+    return SMC_SUCCESS;
+}
+
+/* ************************************************************************ */
+int sysdep_smc_fingerprint(
+        uint32_t *  fingerprint,
+        void *      smc_handle,
+        log_t *     log) {
+    const uint32_t  key_rev = ((uint32_t)'R' << 24) | ((uint32_t)'E' << 16)
+                              | ((uint32_t)'V' << 8) | (uint32_t)' ';
+    SMCKeyData_t    output_data;
+    uint32_t        hash = 2166136261U;
+    int             value_size;
+
+    /* the SMC firmware revision identifies the key catalog */
+    if ((value_size = sysdep_smc_readkey(key_rev, NULL, NULL, &output_data,
+                                         smc_handle, log)) <= 0) {
+        return SMC_ERROR;
+    }
+    if ((size_t) value_size > sizeof(output_data.bytes))
+        value_size = sizeof(output_data.bytes);
+    for (int i = 0; i < value_size; ++i) {
+        hash ^= output_data.bytes[i];
+        hash *= 16777619U;
+    }
+    *fingerprint = hash;
+
+    return SMC_SUCCESS;
+}
@@ -61,6 +61,24 @@ int                 sysdep_smc_readkey(
     return SENSOR_ERROR;
 }
 
+int                 sysdep_smc_readkeys(
+                        unsigned int    nb_keys,
+                        const uint32_t * keys,
+                        void ***        key_infos,
+                        void *          output_buffers,
+                        int *           value_sizes,
+                        void *          smc_handle,
+                        log_t *         log) {
+    (void)nb_keys;
+    (void)keys;
+    (void)key_infos;
+    (void)output_buffers;
+    (void)value_sizes;
+    (void)smc_handle;
+    (void)log;
+    return SENSOR_ERROR;
+}
+
 int                 sysdep_smc_readindex(
                         uint32_t        index,
                         uint32_t *      value_key,
@@ -98,3 +116,27 @@ int             sysdep_smc_writekey(
     (void)log;
     return SENSOR_ERROR;
 }
+
+int                 sysdep_smc_keyinfo(
+                        uint32_t        key,
+                        uint32_t        index,
+                        void **         key_info,
+                        void *          smc_handle,
+                        log_t *         log) {
+    (void)key;
+    (void)index;
+    (void)key_info;
+    (void)smc_handle;
+    (void)log;
+    return SENSOR_ERROR;
+}
+
+int                 sysdep_smc_fingerprint(
+                        uint32_t *      fingerprint,
+                        void *          smc_handle,
+                        log_t *         log) {
+    (void)fingerprint;
+    (void)smc_handle;
+    (void)log;
+    return SENSOR_ERROR;
+}
@@ -38,6 +38,9 @@
 # define SMC_LINUX_DIR      "/sys/devices/platform"
 #endif
 #define SMC_LINUX_PATTERN   "applesmc*"
+#ifndef SMC_LINUX_DMI_DIR
+# define SMC_LINUX_DMI_DIR  "/sys/class/dmi/id"
+#endif
 
 #define SMC_LINUX_BUF_SZ    1024
 
@@ -48,10 +51,23 @@ static struct { /*uint32_t key*/const char * key; const char * procfile; }
     { 0, NULL } // last
 };
 
+/** persistent fds of applesmc files, read with pread() at offset 0 */
+typedef enum {
+    SLF_KEY_NAME = 0,
+    SLF_KEY_TYPE,
+    SLF_KEY_DATA,
+    SLF_KEY_COUNT,
+    SLF_NB
+} smc_linux_file_t;
+
+static const char * s_smc_linux_files[SLF_NB] = {
+    "key_at_index_name", "key_at_index_type", "key_at_index_data", "key_count"
+};
+
 typedef struct {
     int dir_fd;
     int keyidx_fd;
-    int keydata_fd;
+    int fds[SLF_NB];
 } priv_t;
 
 typedef struct {
@@ -114,17 +130,44 @@ static int smc_linux_open_file(int * p_dirfd, const char * name, int write, log_
 }
 
 static int smc_linux_select_index(priv_t * priv, uint32_t index, log_t * log) {
-    if (priv->keyidx_fd < 0 || lseek(priv->keyidx_fd, 0, SEEK_SET) == (off_t) -1) {
+    char    buf[16];
+    int     len = snprintf(buf, sizeof(buf), "%u", index);
+
+    /* one pwrite on the persistent fd, reopened only if it fails (driver reloaded) */
+    if (priv->keyidx_fd < 0 || pwrite(priv->keyidx_fd, buf, len, 0) != len) {
         if (priv->keyidx_fd >= 0)
             close(priv->keyidx_fd);
         priv->keyidx_fd = smc_linux_open_file(&priv->dir_fd, "key_at_index", 1, log);
-    }
-    if (priv->keyidx_fd < 0 || dprintf(priv->keyidx_fd, "%u", index) <= 0) {
-        LOG_VERBOSE(log, "cannot write to %s/%s/%s: %s.", SMC_LINUX_DIR, SMC_LINUX_PATTERN, "key_at_index", strerror(errno));
-        return SENSOR_ERROR;
+        if (priv->keyidx_fd < 0 || pwrite(priv->keyidx_fd, buf, len, 0) != len) {
+            LOG_VERBOSE(log, "cannot write to %s/%s/%s: %s.", SMC_LINUX_DIR, SMC_LINUX_PATTERN, "key_at_index", strerror(errno));
+            return SENSOR_ERROR;
+        }
     }
     return SENSOR_SUCCESS;
 }
+
+/** read a file with its persistent fd, opened on first use, without the ending newline */
+static ssize_t smc_linux_read_file(priv_t * priv, smc_linux_file_t file,
+                                   char * buf, size_t bufsz, log_t * log) {
+    int *   pfd = &(priv->fds[file]);
+    ssize_t n = -1;
+
+    if (*pfd < 0 || (n = pread(*pfd, buf, bufsz - 1, 0)) < 0) {
+        if (*pfd >= 0)
+            close(*pfd);
+        if ((*pfd = smc_linux_open_file(&priv->dir_fd, s_smc_linux_files[file], 0, log)) >= 0)
+            n = pread(*pfd, buf, bufsz - 1, 0);
+    }
+    if (n <= 0) {
+        LOG_VERBOSE(log, "cannot read %s: %s", s_smc_linux_files[file], n < 0 ? strerror(errno) : "empty");
+        return -1;
+    }
+    buf[n] = 0;
+    if (buf[n-1] == '\n') {
+        buf[--n] = 0;
+    }
+    return n;
+}
     
 /** sensor API sysdep_smc_open() */
 int sysdep_smc_open(void ** psmc_handle, log_t *log,
@@ -153,7 +196,9 @@ int sysdep_smc_open(void ** psmc_handle, log_t *log,
                         "/bin/chmod g+w \\\"$file\\\"; /bin/chgrp <user_group> \\\"$file\\\"'\"");
         LOG_WARN(log, "no SMC sensor can be found without write access on key_at_index");
     }
-    priv->keydata_fd = -1;
+    for (unsigned int i = 0; i < SLF_NB; ++i) {
+        priv->fds[i] = -1;
+    }
     *bufsize = SMC_LINUX_BUF_SZ;
     *value_offset = 0;
 
@@ -172,8 +217,10 @@ int                 sysdep_smc_close(void * smc_handle, log_t *log) {
         close(priv->dir_fd);
     if (priv->keyidx_fd >= 0)
         close(priv->keyidx_fd);
-    if (priv->keydata_fd >= 0)
-        close(priv->keydata_fd);
+    for (unsigned int i = 0; i < SLF_NB; ++i) {
+        if (priv->fds[i] >= 0)
+            close(priv->fds[i]);
+    }
     
     free(priv);
     
@@ -191,7 +238,6 @@ int                 sysdep_smc_readindex(
                         log_t *         log) {
     priv_t *        priv = (priv_t *) smc_handle;
     ssize_t         n;
-    int             key_fd;
     int             ret = -1;
     char *          buf = output_buffer;
     const size_t    bufsz = SMC_LINUX_BUF_SZ;
@@ -211,46 +257,25 @@ int                 sysdep_smc_readindex(
     }
     
     if (value_key != NULL) {
-        key_fd = smc_linux_open_file(&priv->dir_fd, "key_at_index_name", 0, log);
-        if (key_fd < 0 || (n = read(key_fd, buf, bufsz-1)) <= 0) {
-            close(key_fd);
-            LOG_VERBOSE(log, "cannot open key_at_index_name for index %u", index);
+        if ((n = smc_linux_read_file(priv, SLF_KEY_NAME, buf, bufsz, log)) < 0) {
+            LOG_VERBOSE(log, "cannot read key_at_index_name for index %u", index);
             return SENSOR_ERROR;
         }
-        buf[n] = 0;
-        if (buf[n-1] == '\n') {
-            buf[--n] = 0;
-        }
         *value_key = _str32toul(buf, n, 10);
-        close(key_fd);
     }
-    
+
     if (value_type != NULL) {
-        key_fd = smc_linux_open_file(&priv->dir_fd, "key_at_index_type", 0, log);
-        if (key_fd < 0 || (n = read(key_fd, buf, bufsz-1)) <= 0) {
-            close(key_fd);
-            LOG_VERBOSE(log, "cannot open key_at_index_type for index %u", index);
+        if ((n = smc_linux_read_file(priv, SLF_KEY_TYPE, buf, bufsz, log)) < 0) {
+            LOG_VERBOSE(log, "cannot read key_at_index_type for index %u", index);
             return SENSOR_ERROR;
         }
-        buf[n] = 0;
-        if (buf[n-1] == '\n') {
-            buf[--n] = 0;
-        }
         *value_type = _str32toul(buf, n, 10);
-        close(key_fd);
     }
-        
-    if (priv->keydata_fd < 0 || lseek(priv->keydata_fd, 0, SEEK_SET) == (off_t) -1) {
-        close(priv->keydata_fd);
-        priv->keydata_fd = smc_linux_open_file(&priv->dir_fd, "key_at_index_data", 0, log);
-    }
-    if (priv->keydata_fd < 0 || (n = read(priv->keydata_fd, buf, bufsz-1)) <= 0) {
-        LOG_VERBOSE(log, "cannot read data for index %u: %s", index, strerror(errno));
+
+    if ((n = smc_linux_read_file(priv, SLF_KEY_DATA, buf, bufsz, log)) < 0) {
+        LOG_VERBOSE(log, "cannot read data for index %u", index);
         return SENSOR_ERROR;
     }
-    if (buf[n-1] == '\n') {
-        buf[--n] = 0;
-    }
     ret = n;
     
     (void)key_info;
@@ -269,40 +294,99 @@ int                 sysdep_smc_readkey(
     priv_t * priv = (priv_t *) smc_handle;
 
     if (key_info != NULL && *key_info != NULL) {
-        return sysdep_smc_readindex(((keyinfo_t *) *key_info)->key_index, NULL, NULL, key_info, output_buffer, smc_handle, log);
+        return sysdep_smc_readindex(((keyinfo_t *) *key_info)->key_index, NULL, value_type,
+                                    key_info, output_buffer, smc_handle, log);
     }
     
     if (key == SMC_TYPE("#KEY")) {
-        int fd = smc_linux_open_file(&priv->dir_fd, "key_count", 0, log);
-        FILE * f;
-        char * line = NULL;
-        size_t line_cap = 0;
-        ssize_t len;
-        
-        if (fd < 0 || (f = fdopen(fd, "r")) == NULL) {
-            close(fd);
+        char        line[32];
+        uint16_t    u16;
+
+        if (smc_linux_read_file(priv, SLF_KEY_COUNT, line, sizeof(line), log) < 0) {
             return SENSOR_ERROR;
         }
-        if ((len = getline(&line, &line_cap, f)) > 0) {
-            if (line[len-1] == '\n')
-                line[--len] = 0;
-            uint16_t u16;
-            u16 = htons(strtol(line, NULL, 10));
-            memcpy(output_buffer, &u16, sizeof(u16));
-            *value_type = SMC_TYPE("ui16");
-            len = sizeof(u16);
-            //strncpy(output_buffer, line, len);
-            //*value_type = SMC_TYPE("ch8*");
-        }
-        if (line != NULL)
-            free(line);
-        fclose(f);
-        return len;
+        u16 = htons(strtol(line, NULL, 10));
+        memcpy(output_buffer, &u16, sizeof(u16));
+        *value_type = SMC_TYPE("ui16");
+        return sizeof(u16);
     }
     (void)key_info;
     return SENSOR_ERROR;
 }
 
+/** sensor API sysdep_smc_readkeys() */
+int                 sysdep_smc_readkeys(
+                        unsigned int    nb_keys,
+                        const uint32_t * keys,
+                        void ***        key_infos,
+                        void *          output_buffers,
+                        int *           value_sizes,
+                        void *          smc_handle,
+                        log_t *         log) {
+    char *  buf = output_buffers;
+    int     nb_read = 0;
+
+    /* applesmc has no multi-key read: one select and one pread per key */
+    for (unsigned int i = 0; i < nb_keys; ++i, buf += SMC_LINUX_BUF_SZ) {
+        value_sizes[i] = sysdep_smc_readkey(keys[i], NULL, key_infos[i], buf, smc_handle, log);
+        if (value_sizes[i] >= 0)
+            ++nb_read;
+    }
+    return nb_read;
+}
+
+/** sensor API sysdep_smc_keyinfo() */
+int                 sysdep_smc_keyinfo(
+                        uint32_t        key,
+                        uint32_t        index,
+                        void **         key_info,
+                        void *          smc_handle,
+                        log_t *         log) {
+    keyinfo_t * pinfo;
+    (void)key;
+    (void)smc_handle;
+
+    if (key_info == NULL)
+        return SENSOR_ERROR;
+    if ((pinfo = *key_info = malloc(sizeof(keyinfo_t))) == NULL) {
+        LOG_WARN(log, "cannot malloc smc linux keyinfo_t");
+        return SENSOR_ERROR;
+    }
+    pinfo->key_index = index;
+
+    return SENSOR_SUCCESS;
+}
+
+/** sensor API sysdep_smc_fingerprint() */
+int                 sysdep_smc_fingerprint(
+                        uint32_t *      fingerprint,
+                        void *          smc_handle,
+                        log_t *         log) {
+    static const char * const dmi_files[] = {
+        SMC_LINUX_DMI_DIR "/product_name",
+        SMC_LINUX_DMI_DIR "/bios_version",
+        SMC_LINUX_DMI_DIR "/bios_date",
+    };
+    char        buf[256];
+    uint32_t    hash = 0;
+    ssize_t     n;
+    int         fd;
+    (void)smc_handle;
+
+    for (unsigned int i = 0; i < sizeof(dmi_files) / sizeof(*dmi_files); ++i) {
+        if ((fd = open(dmi_files[i], O_RDONLY)) < 0) {
+            LOG_VERBOSE(log, "cannot open %s: %s", dmi_files[i], strerror(errno));
+            return SENSOR_ERROR;
+        }
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+            hash = _smc_hash(hash, buf, n);
+        close(fd);
+    }
+    *fingerprint = hash;
+
+    return SENSOR_SUCCESS;
+}
+
 /** sensor API sysdep_smc_writekey() */
 int             sysdep_smc_writekey(
                     uint32_t        key,